@@ -214,8 +214,10 @@ public:
 			max_ms = ms > max_ms ? ms : max_ms;
 			sum_ms += ms;
 			sum_ms_samples++;
+#ifndef USE_HEADLESS_BENCHMARK
 			btScalar mean_ms = (btScalar)sum_ms/(btScalar)sum_ms_samples;
 			printf("%d rays in %d ms %d %d %f\n", NUMRAYS * frame_counter, ms, min_ms, max_ms, mean_ms);
+#endif //USE_HEADLESS_BENCHMARK
 			ms = 0;
 			frame_counter = 0;
 		}
@@ -0,0 +1,365 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+///AppHeadlessBenchmark runs the scenes of the BenchmarkDemo for a fixed number of steps, without rendering,
+///and writes the frame times, the time spent in every BT_PROFILE scope, the number of allocations
+///and the peak memory use of the process as JSON or CSV, so that runs can be compared by a script.
+///The phase times come from CProfileManager, which only records the scopes of the main thread.
+///The allocation counts only cover btAlignedAlloc/btAlignedFree, not new/delete or malloc.
+///--body-state-pool runs the worlds with btDiscreteDynamicsWorld::setUseBodyStatePool, to compare the
+///predictUnconstraintMotion and integrateTransforms phases with the per-body integration.
+///
+///usage: AppHeadlessBenchmark [--steps N] [--scene 1..7] [--format json|csv] [--output file] [--trace file] [--body-state-pool]
+
+#include "BenchmarkDemo.h"
+#include "btBulletDynamicsCommon.h"
+#include "LinearMath/btQuickprof.h"
+#include "LinearMath/btAlignedAllocator.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "psapi.lib")
+#endif
+#else
+#include <sys/resource.h>
+#endif
+
+#define NUM_SCENES 7
+
+extern bool gDisableDeactivation;
+extern int gNumAlignedAllocs;
+extern int gNumAlignedFree;
+
+static const char* gSceneNames[NUM_SCENES] = {"3000 fall", "1000 stack", "136 ragdolls","1000 convex", "prim-trimesh", "convex-trimesh","raytests"};
+
+///written at the top of the output, so the numbers aren't read as more than they are
+static const char* gPhaseNote = "phase times are measured on the main thread only, work of other threads is not included";
+static const char* gAllocNote = "allocation counts only cover btAlignedAlloc/btAlignedFree";
+
+///time spent in a BT_PROFILE scope, the path is the list of enclosing scopes separated by '/'
+struct	PhaseResult
+{
+	char	m_path[512];
+	int		m_calls;
+	float	m_totalTime;
+};
+
+struct	SceneResult
+{
+	int		m_scene;
+	int		m_numSteps;
+	float	m_totalTime;
+	float	m_minFrameTime;
+	float	m_maxFrameTime;
+	int		m_initAllocs;
+	int		m_stepAllocs;
+	int		m_stepFrees;
+	btAlignedObjectArray<PhaseResult>	m_phases;
+};
+
+///peak resident memory of the process in kilobytes, or -1 if it is not known on this platform
+static long	getPeakMemoryKb()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return long(counters.PeakWorkingSetSize/1024);
+	return -1;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return -1;
+#ifdef __APPLE__
+	return long(usage.ru_maxrss/1024);
+#else
+	return long(usage.ru_maxrss);
+#endif
+#endif
+}
+
+static void	gatherPhases(CProfileIterator* profileIterator, const char* parentPath, btAlignedObjectArray<PhaseResult>& phases)
+{
+	int numChildren = 0;
+	for (profileIterator->First(); !profileIterator->Is_Done(); profileIterator->Next())
+	{
+		PhaseResult phase;
+		if (parentPath[0])
+			sprintf(phase.m_path, "%.250s/%.250s", parentPath, profileIterator->Get_Current_Name());
+		else
+			sprintf(phase.m_path, "%.250s", profileIterator->Get_Current_Name());
+		phase.m_calls = profileIterator->Get_Current_Total_Calls();
+		phase.m_totalTime = profileIterator->Get_Current_Total_Time();
+		phases.push_back(phase);
+		numChildren++;
+	}
+	int firstPhase = phases.size() - numChildren;
+	for (int i=0;i<numChildren;i++)
+	{
+		char path[512];
+		strcpy(path, phases[firstPhase+i].m_path);
+		profileIterator->Enter_Child(i);
+		gatherPhases(profileIterator, path, phases);
+		profileIterator->Enter_Parent();
+	}
+}
+
+///stepSimulation resets the profile tree, so the tree of every frame is added to the totals of the scene
+static void	accumulatePhases(SceneResult& result)
+{
+	btAlignedObjectArray<PhaseResult> framePhases;
+	CProfileIterator* profileIterator = CProfileManager::Get_Iterator();
+	gatherPhases(profileIterator, "", framePhases);
+	CProfileManager::Release_Iterator(profileIterator);
+
+	for (int i=0;i<framePhases.size();i++)
+	{
+		const PhaseResult& framePhase = framePhases[i];
+		int index = 0;
+		while (index < result.m_phases.size() && strcmp(result.m_phases[index].m_path, framePhase.m_path))
+			index++;
+		if (index < result.m_phases.size())
+		{
+			result.m_phases[index].m_calls += framePhase.m_calls;
+			result.m_phases[index].m_totalTime += framePhase.m_totalTime;
+		} else
+		{
+			result.m_phases.push_back(framePhase);
+		}
+	}
+}
+
+static void	runScene(int scene, int numSteps, bool useBodyStatePool, SceneResult& result)
+{
+	result.m_scene = scene;
+	result.m_numSteps = numSteps;
+	result.m_totalTime = 0.f;
+	result.m_minFrameTime = BT_LARGE_FLOAT;
+	result.m_maxFrameTime = 0.f;
+
+	int allocs = gNumAlignedAllocs;
+	BenchmarkDemo* demo = new BenchmarkDemo(scene);
+	demo->initPhysics();
+	btDynamicsWorld* world = demo->getDynamicsWorld();
+	if (useBodyStatePool && world && world->getWorldType() == BT_DISCRETE_DYNAMICS_WORLD)
+		static_cast<btDiscreteDynamicsWorld*>(world)->setUseBodyStatePool(true);
+	result.m_initAllocs = gNumAlignedAllocs - allocs;
+
+	allocs = gNumAlignedAllocs;
+	int frees = gNumAlignedFree;
+	CProfileManager::Reset();
+	btClock frameClock;
+	for (int i=0;i<numSteps;i++)
+	{
+		frameClock.reset();
+		demo->clientMoveAndDisplay();
+		float frameTime = float(frameClock.getTimeMicroseconds())*0.001f;
+		result.m_totalTime += frameTime;
+		result.m_minFrameTime = btMin(result.m_minFrameTime, frameTime);
+		result.m_maxFrameTime = btMax(result.m_maxFrameTime, frameTime);
+
+		//don't count the allocations of the benchmark itself
+		int reportAllocs = gNumAlignedAllocs;
+		int reportFrees = gNumAlignedFree;
+		accumulatePhases(result);
+		allocs += gNumAlignedAllocs - reportAllocs;
+		frees += gNumAlignedFree - reportFrees;
+	}
+	result.m_stepAllocs = gNumAlignedAllocs - allocs;
+	result.m_stepFrees = gNumAlignedFree - frees;
+
+	delete demo;
+}
+
+static void	writeJson(FILE* file, const btAlignedObjectArray<SceneResult*>& results, bool useBodyStatePool)
+{
+	fprintf(file, "{\n\"notes\": [\"%s\", \"%s\"],\n", gPhaseNote, gAllocNote);
+	fprintf(file, "\"body_state_pool\": %s,\n", useBodyStatePool ? "true" : "false");
+	fprintf(file, "\"peak_memory_kb\": %ld,\n\"scenes\": [", getPeakMemoryKb());
+	for (int s=0;s<results.size();s++)
+	{
+		const SceneResult& r = *results[s];
+		fprintf(file, "%s\n{\"scene\": %d, \"name\": \"%s\", \"steps\": %d,\n", s ? "," : "", r.m_scene, gSceneNames[r.m_scene-1], r.m_numSteps);
+		fprintf(file, " \"total_ms\": %.3f, \"mean_frame_ms\": %.3f, \"min_frame_ms\": %.3f, \"max_frame_ms\": %.3f,\n",
+			r.m_totalTime, r.m_totalTime/float(r.m_numSteps), r.m_minFrameTime, r.m_maxFrameTime);
+		fprintf(file, " \"init_allocs\": %d, \"step_allocs\": %d, \"step_frees\": %d,\n", r.m_initAllocs, r.m_stepAllocs, r.m_stepFrees);
+		fprintf(file, " \"phases\": [");
+		for (int p=0;p<r.m_phases.size();p++)
+		{
+			const PhaseResult& phase = r.m_phases[p];
+			fprintf(file, "%s\n  {\"path\": \"%s\", \"calls\": %d, \"total_ms\": %.3f, \"ms_per_frame\": %.4f}", p ? "," : "",
+				phase.m_path, phase.m_calls, phase.m_totalTime, phase.m_totalTime/float(r.m_numSteps));
+		}
+		fprintf(file, "\n ]}");
+	}
+	fprintf(file, "\n]\n}\n");
+}
+
+static void	writeCsv(FILE* file, const btAlignedObjectArray<SceneResult*>& results, bool useBodyStatePool)
+{
+	//one metric per line, so two runs can be compared with diff or joined on the first two columns
+	fprintf(file, "# %s\n# %s\n", gPhaseNote, gAllocNote);
+	fprintf(file, "scene,metric,value\n");
+	for (int s=0;s<results.size();s++)
+	{
+		const SceneResult& r = *results[s];
+		const char* name = gSceneNames[r.m_scene-1];
+		fprintf(file, "%s,steps,%d\n", name, r.m_numSteps);
+		fprintf(file, "%s,total_ms,%.3f\n", name, r.m_totalTime);
+		fprintf(file, "%s,mean_frame_ms,%.3f\n", name, r.m_totalTime/float(r.m_numSteps));
+		fprintf(file, "%s,min_frame_ms,%.3f\n", name, r.m_minFrameTime);
+		fprintf(file, "%s,max_frame_ms,%.3f\n", name, r.m_maxFrameTime);
+		fprintf(file, "%s,init_allocs,%d\n", name, r.m_initAllocs);
+		fprintf(file, "%s,step_allocs,%d\n", name, r.m_stepAllocs);
+		fprintf(file, "%s,step_frees,%d\n", name, r.m_stepFrees);
+		for (int p=0;p<r.m_phases.size();p++)
+		{
+			const PhaseResult& phase = r.m_phases[p];
+			fprintf(file, "%s,calls:%s,%d\n", name, phase.m_path, phase.m_calls);
+			fprintf(file, "%s,ms_per_frame:%s,%.4f\n", name, phase.m_path, phase.m_totalTime/float(r.m_numSteps));
+		}
+	}
+	fprintf(file, "all,body_state_pool,%d\n", useBodyStatePool ? 1 : 0);
+	fprintf(file, "all,peak_memory_kb,%ld\n", getPeakMemoryKb());
+}
+
+static void	printUsage()
+{
+	fprintf(stderr, "usage: AppHeadlessBenchmark [--steps N] [--scene 1..%d] [--format json|csv] [--output file] [--trace file] [--body-state-pool]\n", NUM_SCENES);
+	fprintf(stderr, "  --scene can be given more than once, by default all scenes are run\n");
+	fprintf(stderr, "  --format is json (the default) or csv\n");
+	fprintf(stderr, "  --trace writes the BT_PROFILE events of all threads in the Chrome trace format\n");
+	fprintf(stderr, "  --body-state-pool damps and integrates the bodies with the SoA body state pool\n");
+	fprintf(stderr, "  the phase times only cover the main thread, the allocation counts only btAlignedAlloc\n");
+}
+
+int main(int argc,char** argv)
+{
+	int numSteps = 200;
+	bool csv = false;
+	const char* outputFileName = 0;
+	const char* traceFileName = 0;
+	bool useBodyStatePool = false;
+	btAlignedObjectArray<int> scenes;
+
+	for (int i=1;i<argc;i++)
+	{
+		bool hasValue = (i+1<argc);
+		if (!strcmp(argv[i], "--steps") && hasValue)
+		{
+			numSteps = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--scene") && hasValue)
+		{
+			scenes.push_back(atoi(argv[++i]));
+		} else if (!strcmp(argv[i], "--format") && hasValue)
+		{
+			const char* format = argv[++i];
+			if (!strcmp(format, "csv"))
+			{
+				csv = true;
+			} else if (!strcmp(format, "json"))
+			{
+				csv = false;
+			} else
+			{
+				fprintf(stderr, "unknown format %s\n", format);
+				printUsage();
+				return 1;
+			}
+		} else if (!strcmp(argv[i], "--output") && hasValue)
+		{
+			outputFileName = argv[++i];
+		} else if (!strcmp(argv[i], "--trace") && hasValue)
+		{
+			traceFileName = argv[++i];
+		} else if (!strcmp(argv[i], "--body-state-pool"))
+		{
+			useBodyStatePool = true;
+		} else
+		{
+			printUsage();
+			return 1;
+		}
+	}
+	if (numSteps <= 0)
+	{
+		printUsage();
+		return 1;
+	}
+	if (scenes.size() == 0)
+	{
+		for (int s=1;s<=NUM_SCENES;s++)
+			scenes.push_back(s);
+	}
+	for (int s=0;s<scenes.size();s++)
+	{
+		if (scenes[s] < 1 || scenes[s] > NUM_SCENES)
+		{
+			printUsage();
+			return 1;
+		}
+	}
+
+	gDisableDeactivation = true;
+	if (traceFileName)
+		btProfileTimeline::enable();
+
+	btAlignedObjectArray<SceneResult*> results;
+	for (int s=0;s<scenes.size();s++)
+	{
+		fprintf(stderr, "running %s (%d steps)\n", gSceneNames[scenes[s]-1], numSteps);
+		SceneResult* result = new SceneResult;
+		runScene(scenes[s], numSteps, useBodyStatePool, *result);
+		results.push_back(result);
+	}
+
+	int exitCode = 0;
+	FILE* file = outputFileName ? fopen(outputFileName, "w") : stdout;
+	if (file)
+	{
+		if (csv)
+			writeCsv(file, results, useBodyStatePool);
+		else
+			writeJson(file, results, useBodyStatePool);
+		if (file != stdout)
+			fclose(file);
+	} else
+	{
+		fprintf(stderr, "can't write %s\n", outputFileName);
+		exitCode = 1;
+	}
+
+	if (traceFileName)
+	{
+		if (!btProfileTimeline::writeChromeTrace(traceFileName))
+		{
+			fprintf(stderr, "can't write %s\n", traceFileName);
+			exitCode = 1;
+		}
+		btProfileTimeline::releaseMemory();
+	}
+
+	for (int s=0;s<results.size();s++)
+		delete results[s];
+	CProfileManager::CleanupMemory();
+	return exitCode;
+}
+
@@ -0,0 +1,19 @@
+project "AppHeadlessBenchmark"
+
+kind "ConsoleApp"
+
+defines {"USE_HEADLESS_BENCHMARK"}
+
+includedirs {"../../src", "../Benchmarks"}
+
+links {
+	"BulletDynamics","BulletCollision", "LinearMath"
+}
+
+language "C++"
+
+files {
+	"HeadlessBenchmark.cpp",
+	"../Benchmarks/BenchmarkDemo.cpp",
+	"../Benchmarks/BenchmarkDemo.h",
+}
@@ -14,6 +14,8 @@ subject to the following restrictions:
 */
 
 
+//the kernels with barriers (the bitonic sort and kFindCellStart) run on the CPU in MiniCL builds, see ParticlesDemo.cpp
+#define MINICL_IGNORE_BARRIERS
 #include <MiniCL/cl_MiniCL_Defs.h>
 
 #define MSTRINGIFY(A) A
@@ -19,6 +19,7 @@ subject to the following restrictions:
 
 #include "btBulletDynamicsCommon.h"
 #include "BulletCollision/Gimpact/btGImpactShape.h"
+#include "LinearMath/btMappedFile.h"
 
 
 
@@ -50,6 +51,16 @@ bool	btBulletWorldImporter::loadFile( const char* fileName)
 }
 
 
+bool	btBulletWorldImporter::loadFileMapped( const char* fileName)
+{
+	btMappedFile file;
+	if (!file.open(fileName,btMappedFile::MAP_COPY_ON_WRITE))
+		return false;
+
+	//the converted objects don't point into the file, so it can be unmapped afterwards
+	return loadFileFromMemory((char*)file.getData(),(int)file.getSize());
+}
+
 
 bool	btBulletWorldImporter::loadFileFromMemory( char* memoryBuffer, int len)
 {
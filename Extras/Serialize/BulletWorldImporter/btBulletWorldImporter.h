@@ -49,6 +49,10 @@ public:
 
 	bool	loadFile(const char* fileName);
 
+	///same as loadFile, but maps the file copy-on-write instead of reading it into a heap buffer. The parser still patches the
+	///pages it touches and the objects are still converted, so this only saves the read and the extra copy of the file.
+	bool	loadFileMapped(const char* fileName);
+
 	///the memoryBuffer might be modified (for example if endian swaps are necessary)
 	bool	loadFileFromMemory(char *memoryBuffer, int len);
 
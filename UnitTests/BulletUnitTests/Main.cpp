@@ -9,11 +9,61 @@
 #include "TestLinearMath.h"
 #include "TestPolarDecomposition.h"
 #include "TestCholeskyDecomposition.h"
+#include "TestDiscreteDynamicsWorldMt.h"
+#include "TestBatchedContactSolver.h"
+#include "TestDbvtBroadphaseParallel.h"
+#include "TestProfileTimeline.h"
+#include "TestRigidBodyStatePool.h"
+#include "TestCollisionWorldAabbs.h"
+#include "TestRayTestBatch.h"
+#include "TestOpenAddressingPairCache.h"
+#include "TestQuantizedBvhSah.h"
+#include "TestTriangleMeshBlob.h"
+#include "TestTiledHeightfield.h"
+#include "TestHeightfieldRaycast.h"
+#include "TestGImpactTrimesh.h"
+#include "TestManifoldReduction.h"
+#include "TestCompoundCompound.h"
+#include "TestCompoundShapeUpdates.h"
+#include "TestSoftBodySolverMt.h"
+#include "TestBatchedCcd.h"
+#include "TestPredictiveContacts.h"
+#include "TestStackAlloc.h"
+#ifdef USE_BULLET_MULTITHREADED
+#include "TestMiniCL.h"
+#include "TestParallelConstraintSolver.h"
+#include "TestThreadPoolSupport.h"
+#endif //USE_BULLET_MULTITHREADED
 
   CPPUNIT_TEST_SUITE_REGISTRATION( TestLinearMath );
   CPPUNIT_TEST_SUITE_REGISTRATION( TestBulletOnly );
   CPPUNIT_TEST_SUITE_REGISTRATION( TestPolarDecomposition );
   CPPUNIT_TEST_SUITE_REGISTRATION( TestCholeskyDecomposition );
+  CPPUNIT_TEST_SUITE_REGISTRATION( TestDiscreteDynamicsWorldMt );
+  CPPUNIT_TEST_SUITE_REGISTRATION( TestBatchedContactSolver );
+  CPPUNIT_TEST_SUITE_REGISTRATION( TestDbvtBroadphaseParallel );
+  CPPUNIT_TEST_SUITE_REGISTRATION( TestProfileTimeline );
+  CPPUNIT_TEST_SUITE_REGISTRATION( TestRigidBodyStatePool );
+  CPPUNIT_TEST_SUITE_REGISTRATION( TestCollisionWorldAabbs );
+  CPPUNIT_TEST_SUITE_REGISTRATION( TestRayTestBatch );
+  CPPUNIT_TEST_SUITE_REGISTRATION( TestOpenAddressingPairCache );
+  CPPUNIT_TEST_SUITE_REGISTRATION( TestQuantizedBvhSah );
+  CPPUNIT_TEST_SUITE_REGISTRATION( TestTriangleMeshBlob );
+  CPPUNIT_TEST_SUITE_REGISTRATION( TestTiledHeightfield );
+  CPPUNIT_TEST_SUITE_REGISTRATION( TestHeightfieldRaycast );
+  CPPUNIT_TEST_SUITE_REGISTRATION( TestGImpactTrimesh );
+  CPPUNIT_TEST_SUITE_REGISTRATION( TestManifoldReduction );
+  CPPUNIT_TEST_SUITE_REGISTRATION( TestCompoundCompound );
+  CPPUNIT_TEST_SUITE_REGISTRATION( TestCompoundShapeUpdates );
+  CPPUNIT_TEST_SUITE_REGISTRATION( TestSoftBodySolverMt );
+  CPPUNIT_TEST_SUITE_REGISTRATION( TestBatchedCcd );
+  CPPUNIT_TEST_SUITE_REGISTRATION( TestPredictiveContacts );
+  CPPUNIT_TEST_SUITE_REGISTRATION( TestStackAlloc );
+#ifdef USE_BULLET_MULTITHREADED
+  CPPUNIT_TEST_SUITE_REGISTRATION( TestMiniCL );
+  CPPUNIT_TEST_SUITE_REGISTRATION( TestParallelConstraintSolver );
+  CPPUNIT_TEST_SUITE_REGISTRATION( TestThreadPoolSupport );
+#endif //USE_BULLET_MULTITHREADED
 
 
 
@@ -0,0 +1,233 @@
+#ifndef TESTBATCHEDCCD_HAS_BEEN_INCLUDED
+#define TESTBATCHEDCCD_HAS_BEEN_INCLUDED
+
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+#include "TestSupport.h"
+
+#include "btBulletDynamicsCommon.h"
+#include "LinearMath/btThreads.h"
+
+// ---------------------------------------------------------------------------
+
+class TestBatchedCcd : public CppUnit::TestFixture
+{
+	enum
+	{
+		NUM_PROJECTILES = 40
+	};
+
+	///fast spheres shot at a thin static wall, the wall is a box at x=0, 0.1 thick
+	struct Scene
+	{
+		btDefaultCollisionConfiguration	mCollisionConfig;
+		btCollisionDispatcher			mDispatcher;
+		btDbvtBroadphase				mBroadphase;
+		btSequentialImpulseConstraintSolver	mSolver;
+		btDiscreteDynamicsWorld			mWorld;
+		btBoxShape						mWallShape;
+		btSphereShape					mSphereShape;
+		btRigidBody*					mWall;
+		btAlignedObjectArray<btRigidBody*>	mProjectiles;
+
+		Scene()
+			:mDispatcher( &mCollisionConfig ),
+			mWorld( &mDispatcher, &mBroadphase, &mSolver, &mCollisionConfig ),
+			mWallShape( btVector3( btScalar(0.05), 20, 20 ) ),
+			mSphereShape( btScalar(0.1) )
+		{
+			mWorld.setGravity( btVector3( 0, 0, 0 ) );
+			btRigidBody::btRigidBodyConstructionInfo wallInfo( 0, 0, &mWallShape );
+			wallInfo.m_startWorldTransform.setIdentity();
+			mWall = new btRigidBody( wallInfo );
+			mWorld.addRigidBody( mWall );
+
+			btVector3 inertia;
+			mSphereShape.calculateLocalInertia( 1, inertia );
+			for (int i=0;i<NUM_PROJECTILES;i++)
+			{
+				btRigidBody::btRigidBodyConstructionInfo info( 1, 0, &mSphereShape, inertia );
+				info.m_startWorldTransform.setIdentity();
+				info.m_startWorldTransform.setOrigin( btVector3( btScalar(-3)-btScalar(i%3), btScalar(i/8)*2-5, btScalar(i%8)*2-7 ) );
+				btRigidBody* body = new btRigidBody( info );
+				//a few m/s to a few hundred m/s, the fast ones move several times the wall thickness per step
+				body->setLinearVelocity( btVector3( btScalar(5+(i*37)%300), btScalar(i%5)-2, 0 ) );
+				body->setCcdMotionThreshold( btScalar(0.05) );
+				body->setCcdSweptSphereRadius( btScalar(0.08) );
+				mWorld.addRigidBody( body );
+				mProjectiles.push_back( body );
+			}
+		}
+
+		~Scene()
+		{
+			for (int i=0;i<mProjectiles.size();i++)
+			{
+				mWorld.removeRigidBody( mProjectiles[i] );
+				delete mProjectiles[i];
+			}
+			mWorld.removeRigidBody( mWall );
+			delete mWall;
+		}
+
+		void step( int numSteps )
+		{
+			for (int i=0;i<numSteps;i++)
+				mWorld.stepSimulation( btScalar(1.)/btScalar(60.), 0 );
+		}
+
+		///the projectiles that ended up behind the wall
+		int countTunneled() const
+		{
+			int count = 0;
+			for (int i=0;i<mProjectiles.size();i++)
+			{
+				if (mProjectiles[i]->getWorldTransform().getOrigin().getX() > 0)
+					count++;
+			}
+			return count;
+		}
+	};
+
+	static void checkSameProjectiles( const Scene& a, const Scene& b )
+	{
+		for (int i=0;i<a.mProjectiles.size();i++)
+		{
+			CPPUNIT_ASSERT( a.mProjectiles[i]->getWorldTransform().getOrigin() == b.mProjectiles[i]->getWorldTransform().getOrigin() );
+			CPPUNIT_ASSERT( a.mProjectiles[i]->getLinearVelocity() == b.mProjectiles[i]->getLinearVelocity() );
+		}
+	}
+
+	struct CollectProxies : public btBroadphaseAabbBatchCallback
+	{
+		btAlignedObjectArray<int> mPairs;
+		void process( const btBroadphaseProxy* proxy, int boxIndex )
+		{
+			mPairs.push_back( boxIndex*1000+proxy->getUid() );
+		}
+	};
+
+	struct CollectBoxProxies : public btBroadphaseAabbCallback
+	{
+		btAlignedObjectArray<int>* mPairs;
+		int mBoxIndex;
+		bool process( const btBroadphaseProxy* proxy )
+		{
+			mPairs->push_back( mBoxIndex*1000+proxy->getUid() );
+			return true;
+		}
+	};
+
+	struct IntLess
+	{
+		bool operator() ( int a, int b ) const
+		{
+			return a < b;
+		}
+	};
+
+public:
+
+	void setUp()
+	{
+	}
+
+	void tearDown()
+	{
+		btSetTaskScheduler( 0 );
+	}
+
+	void testAabbTestBatch()
+	{
+		btDbvtBroadphase broadphase;
+		btAxisSweep3 sweep( btVector3( -100, -100, -100 ), btVector3( 100, 100, 100 ) );
+		btBroadphaseInterface* broadphases[2] = { &broadphase, &sweep };
+		for (int b=0;b<2;b++)
+		{
+			for (int i=0;i<200;i++)
+			{
+				btVector3 center( btScalar((i*7)%20)-10, btScalar((i*13)%20)-10, btScalar((i*3)%20)-10 );
+				broadphases[b]->createProxy( center-btVector3( 1, 1, 1 ), center+btVector3( 1, 1, 1 ), BOX_SHAPE_PROXYTYPE, 0, 1, -1, 0, 0 );
+			}
+			broadphases[b]->calculateOverlappingPairs( 0 );
+		}
+
+		btAlignedObjectArray<btVector3> aabbMins, aabbMaxs;
+		for (int i=0;i<30;i++)
+		{
+			btVector3 center( btScalar((i*11)%24)-12, btScalar((i*5)%24)-12, btScalar((i*17)%24)-12 );
+			aabbMins.push_back( center-btVector3( btScalar(i%4), 1, 2 ) );
+			aabbMaxs.push_back( center+btVector3( 1, btScalar(i%3), 2 ) );
+		}
+
+		for (int b=0;b<2;b++)
+		{
+			//the same proxies as one aabbTest per box
+			CollectProxies batch;
+			broadphases[b]->aabbTestBatch( &aabbMins[0], &aabbMaxs[0], aabbMins.size(), batch );
+			btAlignedObjectArray<int> expected;
+			CollectBoxProxies single;
+			single.mPairs = &expected;
+			for (int i=0;i<aabbMins.size();i++)
+			{
+				single.mBoxIndex = i;
+				broadphases[b]->aabbTest( aabbMins[i], aabbMaxs[i], single );
+			}
+			CPPUNIT_ASSERT( expected.size() > aabbMins.size() );
+			batch.mPairs.quickSort( IntLess() );
+			expected.quickSort( IntLess() );
+			CPPUNIT_ASSERT_EQUAL( expected.size(), batch.mPairs.size() );
+			for (int i=0;i<expected.size();i++)
+				CPPUNIT_ASSERT_EQUAL( expected[i], batch.mPairs[i] );
+		}
+	}
+
+	void testMatchesSerialCcd()
+	{
+		//the projectiles don't get close to each other, so the batched stage finds the same hits
+		Scene serial;
+		Scene batched;
+		batched.mWorld.setUseBatchedCcd( true );
+		CPPUNIT_ASSERT( batched.mWorld.getUseBatchedCcd() );
+		serial.step( 30 );
+		batched.step( 30 );
+		checkSameProjectiles( serial, batched );
+		CPPUNIT_ASSERT_EQUAL( 0, batched.countTunneled() );
+
+		//without CCD the fast ones pass through the wall
+		Scene discrete;
+		discrete.mWorld.getDispatchInfo().m_useContinuous = false;
+		discrete.step( 30 );
+		CPPUNIT_ASSERT( discrete.countTunneled() > 0 );
+	}
+
+	void testThreadCountDeterminism()
+	{
+		Scene reference;
+		reference.mWorld.setUseBatchedCcd( true );
+		reference.step( 30 );
+
+		TestThreadPool threads;
+		if (threads.skipWithoutThreads( "TestBatchedCcd::testThreadCountDeterminism" ))
+			return;
+		Scene scene;
+		scene.mWorld.setUseBatchedCcd( true );
+		scene.step( 30 );
+		Scene pooled;
+		pooled.mWorld.setUseBatchedCcd( true );
+		pooled.mWorld.setUseBodyStatePool( true );
+		pooled.step( 30 );
+
+		checkSameProjectiles( reference, scene );
+		CPPUNIT_ASSERT_EQUAL( 0, scene.countTunneled() );
+		CPPUNIT_ASSERT_EQUAL( 0, pooled.countTunneled() );
+	}
+
+	CPPUNIT_TEST_SUITE(TestBatchedCcd);
+	CPPUNIT_TEST(testAabbTestBatch);
+	CPPUNIT_TEST(testMatchesSerialCcd);
+	CPPUNIT_TEST(testThreadCountDeterminism);
+	CPPUNIT_TEST_SUITE_END();
+};
+
+#endif
@@ -0,0 +1,178 @@
+#ifndef TESTBATCHEDCONTACTSOLVER_HAS_BEEN_INCLUDED
+#define TESTBATCHEDCONTACTSOLVER_HAS_BEEN_INCLUDED
+
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+
+#include "btBulletDynamicsCommon.h"
+
+// ---------------------------------------------------------------------------
+
+class TestBatchedContactSolver : public CppUnit::TestFixture
+{
+	enum
+	{
+		NUM_STACKS = 4,
+		STACK_HEIGHT = 6,
+		NUM_STEPS = 120,
+		NUM_BOXES = 12
+	};
+
+	void runScene( int solverMode, btAlignedObjectArray<btVector3>& result )
+	{
+		btDefaultCollisionConfiguration collisionConfig;
+		btCollisionDispatcher dispatcher( &collisionConfig );
+		btDbvtBroadphase broadphase;
+		btSequentialImpulseConstraintSolver solver;
+		btDiscreteDynamicsWorld world( &dispatcher, &broadphase, &solver, &collisionConfig );
+		world.setGravity( btVector3( 0, -10, 0 ));
+		world.getSolverInfo().m_solverMode = solverMode;
+
+		btBoxShape groundShape( btVector3( 50, 1, 50 ) );
+		btBoxShape boxShape( btVector3( 0.5, 0.5, 0.5 ) );
+		btAlignedObjectArray<btRigidBody*> bodies;
+
+		for (int i=0;i<NUM_STACKS*STACK_HEIGHT+1;i++)
+		{
+			bool ground = (i==0);
+			btScalar mass = ground ? 0 : 1;
+			btVector3 inertia( 0, 0, 0 );
+			btTransform tr;
+			tr.setIdentity();
+			if (ground)
+			{
+				tr.setOrigin( btVector3( 0, -1, 0 ) );
+			} else
+			{
+				int s = (i-1)/STACK_HEIGHT;
+				int h = (i-1)%STACK_HEIGHT;
+				tr.setOrigin( btVector3( btScalar(s)*3, btScalar(h)*1.01+0.5, 0 ) );
+				boxShape.calculateLocalInertia( mass, inertia );
+			}
+			btRigidBody::btRigidBodyConstructionInfo info( mass, 0, ground ? (btCollisionShape*)&groundShape : (btCollisionShape*)&boxShape, inertia );
+			info.m_startWorldTransform = tr;
+			btRigidBody* body = new btRigidBody( info );
+			world.addRigidBody( body );
+			bodies.push_back( body );
+		}
+
+		for (int i=0;i<NUM_STEPS;i++)
+			world.stepSimulation( btScalar(1.)/btScalar(60.), 0 );
+
+		result.resize( bodies.size() );
+		for (int i=0;i<bodies.size();i++)
+		{
+			result[i] = bodies[i]->getWorldTransform().getOrigin();
+			world.removeRigidBody( bodies[i] );
+			delete bodies[i];
+		}
+	}
+
+	///tilted boxes with linear and angular factors fall on the ground apart from each other,
+	///so the rows of a box are solved in the same order with and without batches
+	void runFactorScene( int solverMode, btAlignedObjectArray<btTransform>& result )
+	{
+		btDefaultCollisionConfiguration collisionConfig;
+		btCollisionDispatcher dispatcher( &collisionConfig );
+		btDbvtBroadphase broadphase;
+		btSequentialImpulseConstraintSolver solver;
+		btDiscreteDynamicsWorld world( &dispatcher, &broadphase, &solver, &collisionConfig );
+		world.setGravity( btVector3( 0, -10, 0 ));
+		world.getSolverInfo().m_solverMode = solverMode;
+
+		btBoxShape groundShape( btVector3( 50, 1, 50 ) );
+		btBoxShape boxShape( btVector3( 0.5, 0.3, 0.4 ) );
+		btAlignedObjectArray<btRigidBody*> bodies;
+
+		btRigidBody::btRigidBodyConstructionInfo groundInfo( 0, 0, &groundShape );
+		groundInfo.m_startWorldTransform.setIdentity();
+		groundInfo.m_startWorldTransform.setOrigin( btVector3( 0, -1, 0 ) );
+		btRigidBody* ground = new btRigidBody( groundInfo );
+		world.addRigidBody( ground );
+
+		for (int i=0;i<NUM_BOXES;i++)
+		{
+			btVector3 inertia;
+			boxShape.calculateLocalInertia( 1, inertia );
+			btRigidBody::btRigidBodyConstructionInfo info( 1, 0, &boxShape, inertia );
+			info.m_startWorldTransform.setIdentity();
+			info.m_startWorldTransform.setRotation( btQuaternion( btVector3( 1, btScalar(i), 2 ).normalized(), btScalar(0.3)+btScalar(i)*btScalar(0.2) ) );
+			info.m_startWorldTransform.setOrigin( btVector3( btScalar(i%4)*3, btScalar(1)+btScalar(i)*btScalar(0.1), btScalar(i/4)*3 ) );
+			btRigidBody* body = new btRigidBody( info );
+			body->setLinearFactor( btVector3( btScalar(0.5), 1, btScalar(0.8) ) );
+			body->setAngularFactor( btVector3( btScalar(0.3), 1, btScalar(0.6) ) );
+			body->setLinearVelocity( btVector3( 1, 0, btScalar(-0.5) ) );
+			body->setAngularVelocity( btVector3( 0, 2, 1 ) );
+			world.addRigidBody( body );
+			bodies.push_back( body );
+		}
+
+		for (int i=0;i<NUM_STEPS;i++)
+			world.stepSimulation( btScalar(1.)/btScalar(60.), 0 );
+
+		result.resize( bodies.size() );
+		for (int i=0;i<bodies.size();i++)
+		{
+			result[i] = bodies[i]->getWorldTransform();
+			world.removeRigidBody( bodies[i] );
+			delete bodies[i];
+		}
+		world.removeRigidBody( ground );
+		delete ground;
+	}
+
+public:
+
+	void setUp()
+	{
+	}
+
+	void tearDown()
+	{
+	}
+
+	void testStacksMatchUnbatched()
+	{
+		int solverMode = SOLVER_USE_WARMSTARTING | SOLVER_SIMD | SOLVER_USE_2_FRICTION_DIRECTIONS;
+		btAlignedObjectArray<btVector3> unbatched, batched;
+		runScene( solverMode, unbatched );
+		runScene( solverMode | SOLVER_BATCH_CONTACT_CONSTRAINTS, batched );
+
+		CPPUNIT_ASSERT_EQUAL( unbatched.size(), batched.size() );
+		for (int i=1;i<batched.size();i++)
+		{
+			//the rows are solved in a different order, so only expect the stacks to come to rest at the same place
+			CPPUNIT_ASSERT( (batched[i]-unbatched[i]).length() < btScalar(0.05) );
+		}
+		//the top box is still on top of its stack
+		CPPUNIT_ASSERT( batched[STACK_HEIGHT].getY() > btScalar(STACK_HEIGHT-1) );
+	}
+
+	void testFactorsMatchUnbatched()
+	{
+		//the unbatched rows without SOLVER_SIMD apply the impulses with btSolverBody::internalApplyImpulse
+		int solverMode = SOLVER_USE_WARMSTARTING | SOLVER_USE_2_FRICTION_DIRECTIONS;
+		btAlignedObjectArray<btTransform> unbatched, batched;
+		runFactorScene( solverMode, unbatched );
+		runFactorScene( solverMode | SOLVER_BATCH_CONTACT_CONSTRAINTS, batched );
+
+		CPPUNIT_ASSERT_EQUAL( unbatched.size(), batched.size() );
+		btScalar maxError = 0;
+		for (int i=0;i<batched.size();i++)
+		{
+			maxError = btMax( maxError, (batched[i].getOrigin()-unbatched[i].getOrigin()).length() );
+			maxError = btMax( maxError, (batched[i].getRotation()-unbatched[i].getRotation()).length() );
+			//the boxes landed
+			CPPUNIT_ASSERT( batched[i].getOrigin().getY() < btScalar(0.6) );
+		}
+		//only the rounding differs, the batches compute the dot products in another order (without the factors the error is above 1)
+		CPPUNIT_ASSERT( maxError < btScalar(2e-3) );
+	}
+
+	CPPUNIT_TEST_SUITE(TestBatchedContactSolver);
+	CPPUNIT_TEST(testStacksMatchUnbatched);
+	CPPUNIT_TEST(testFactorsMatchUnbatched);
+	CPPUNIT_TEST_SUITE_END();
+};
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef TESTCOLLISIONWORLDAABBS_HAS_BEEN_INCLUDED
+#define TESTCOLLISIONWORLDAABBS_HAS_BEEN_INCLUDED
+
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+#include "TestSupport.h"
+
+#include "btBulletCollisionCommon.h"
+#include "LinearMath/btThreads.h"
+
+// ---------------------------------------------------------------------------
+
+class TestCollisionWorldAabbs : public CppUnit::TestFixture
+{
+	enum
+	{
+		NUM_OBJECTS = 203
+	};
+
+	btDefaultCollisionConfiguration*	mCollisionConfig;
+	btCollisionDispatcher*				mDispatcher;
+	btDbvtBroadphase*					mBroadphase;
+	btCollisionWorld*					mWorld;
+	btBoxShape*							mBoxShape;
+	btSphereShape*						mSphereShape;
+	btCylinderShape*					mCylinderShape;
+	btAlignedObjectArray<btCollisionObject*>	mObjects;
+
+	void checkAabb( btCollisionObject* colObj )
+	{
+		btVector3 expectedMin, expectedMax;
+		colObj->getCollisionShape()->getAabb( colObj->getWorldTransform(), expectedMin, expectedMax );
+		btVector3 contactThreshold( gContactBreakingThreshold, gContactBreakingThreshold, gContactBreakingThreshold );
+		expectedMin -= contactThreshold;
+		expectedMax += contactThreshold;
+
+		btVector3 aabbMin, aabbMax;
+		mBroadphase->getAabb( colObj->getBroadphaseHandle(), aabbMin, aabbMax );
+		CPPUNIT_ASSERT( (aabbMin-expectedMin).length() < btScalar(1e-5) );
+		CPPUNIT_ASSERT( (aabbMax-expectedMax).length() < btScalar(1e-5) );
+	}
+
+public:
+
+	void setUp()
+	{
+		mCollisionConfig = new btDefaultCollisionConfiguration();
+		mDispatcher = new btCollisionDispatcher( mCollisionConfig );
+		mBroadphase = new btDbvtBroadphase();
+		mWorld = new btCollisionWorld( mDispatcher, mBroadphase, mCollisionConfig );
+		mBoxShape = new btBoxShape( btVector3( 0.5, 1, 1.5 ) );
+		mSphereShape = new btSphereShape( 0.75 );
+		mCylinderShape = new btCylinderShape( btVector3( 0.5, 1, 0.5 ) );
+
+		for (int i=0;i<NUM_OBJECTS;i++)
+		{
+			btTransform tr;
+			tr.setIdentity();
+			tr.setOrigin( btVector3( btScalar(i%10)*4, btScalar(i/10)*4, 0 ) );
+			tr.setRotation( btQuaternion( btVector3( 1, btScalar(i%7), 2 ).normalized(), btScalar(i)*0.1 ) );
+			btCollisionObject* colObj = new btCollisionObject();
+			colObj->setWorldTransform( tr );
+			//more boxes than other shapes, and a number of boxes that isn't a multiple of the batch size
+			colObj->setCollisionShape( (i%3==2) ? (btCollisionShape*)mSphereShape : (i%5==4) ? (btCollisionShape*)mCylinderShape : (btCollisionShape*)mBoxShape );
+			mWorld->addCollisionObject( colObj );
+			mObjects.push_back( colObj );
+		}
+	}
+
+	void tearDown()
+	{
+		btSetTaskScheduler( 0 );
+		for (int i=0;i<mObjects.size();i++)
+		{
+			mWorld->removeCollisionObject( mObjects[i] );
+			delete mObjects[i];
+		}
+		mObjects.clear();
+		delete mWorld;
+		delete mBroadphase;
+		delete mDispatcher;
+		delete mCollisionConfig;
+		delete mBoxShape;
+		delete mSphereShape;
+		delete mCylinderShape;
+	}
+
+	void testUpdateAabbs()
+	{
+		{
+			TestThreadPool threads;
+			mWorld->updateAabbs();
+		}
+
+		for (int i=0;i<mObjects.size();i++)
+		{
+			checkAabb( mObjects[i] );
+		}
+	}
+
+	void testSkipUnchangedAabbs()
+	{
+		mWorld->setSkipUnchangedAabbs( true );
+		mWorld->updateAabbs();
+
+		//an object that didn't move keeps its broadphase AABB, even if it is wrong
+		btVector3 bogusMin( -100, -100, -100 ), bogusMax( 100, 100, 100 );
+		mBroadphase->setAabb( mObjects[0]->getBroadphaseHandle(), bogusMin, bogusMax, mDispatcher );
+		//objects that moved are updated
+		mObjects[1]->getWorldTransform().getOrigin() += btVector3( 0, 0, 3 );
+		mObjects[2]->getWorldTransform().getOrigin() += btVector3( 0, 0, 3 );
+		mWorld->updateAabbs();
+
+		btVector3 aabbMin, aabbMax;
+		mBroadphase->getAabb( mObjects[0]->getBroadphaseHandle(), aabbMin, aabbMax );
+		CPPUNIT_ASSERT( aabbMin == bogusMin && aabbMax == bogusMax );
+		checkAabb( mObjects[1] );
+		checkAabb( mObjects[2] );
+
+		//without skipping, all objects are updated
+		mWorld->setSkipUnchangedAabbs( false );
+		mWorld->updateAabbs();
+		checkAabb( mObjects[0] );
+	}
+
+	CPPUNIT_TEST_SUITE(TestCollisionWorldAabbs);
+	CPPUNIT_TEST(testUpdateAabbs);
+	CPPUNIT_TEST(testSkipUnchangedAabbs);
+	CPPUNIT_TEST_SUITE_END();
+};
+
+#endif
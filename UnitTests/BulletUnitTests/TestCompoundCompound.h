@@ -0,0 +1,243 @@
+#ifndef TESTCOMPOUNDCOMPOUND_HAS_BEEN_INCLUDED
+#define TESTCOMPOUNDCOMPOUND_HAS_BEEN_INCLUDED
+
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+
+#include "btBulletDynamicsCommon.h"
+#include "BulletCollision/CollisionDispatch/btCompoundCompoundCollisionAlgorithm.h"
+
+// ---------------------------------------------------------------------------
+
+class TestCompoundCompound : public CppUnit::TestFixture
+{
+	enum
+	{
+		GRID_SIZE = 8
+	};
+
+	///a GRID_SIZE x GRID_SIZE plate of small boxes
+	static btCompoundShape* createPlate( btBoxShape* boxShape, bool useTree )
+	{
+		btCompoundShape* plate = new btCompoundShape( useTree );
+		for (int x=0;x<GRID_SIZE;x++)
+		{
+			for (int z=0;z<GRID_SIZE;z++)
+			{
+				btTransform child;
+				child.setIdentity();
+				child.setOrigin( btVector3( btScalar(x)-btScalar(GRID_SIZE-1)*btScalar(0.5), 0, btScalar(z)-btScalar(GRID_SIZE-1)*btScalar(0.5) ) );
+				child.setRotation( btQuaternion( btVector3( 0, 1, 0 ), btScalar(x*GRID_SIZE+z)*btScalar(0.1) ) );
+				plate->addChildShape( child, boxShape );
+			}
+		}
+		return plate;
+	}
+
+	struct Scene
+	{
+		btDefaultCollisionConfiguration	mCollisionConfig;
+		btCollisionDispatcher			mDispatcher;
+		btDbvtBroadphase				mBroadphase;
+		btCollisionWorld				mWorld;
+		btBoxShape						mBoxShape;
+		btCompoundShape*				mPlate0;
+		btCompoundShape*				mPlate1;
+		btCollisionObject				mObject0;
+		btCollisionObject				mObject1;
+
+		Scene( bool useTree )
+			:mDispatcher( &mCollisionConfig ),
+			mWorld( &mDispatcher, &mBroadphase, &mCollisionConfig ),
+			mBoxShape( btVector3( btScalar(0.45), btScalar(0.2), btScalar(0.45) ) )
+		{
+			mPlate0 = createPlate( &mBoxShape, useTree );
+			mPlate1 = createPlate( &mBoxShape, useTree );
+			mObject0.setCollisionShape( mPlate0 );
+			mObject1.setCollisionShape( mPlate1 );
+			mObject1.setWorldTransform( placement( btScalar(0.) ) );
+			//not static, so that the dispatcher doesn't warn about static-static pairs
+			mObject1.setCollisionFlags( 0 );
+			mWorld.addCollisionObject( &mObject0 );
+			mWorld.addCollisionObject( &mObject1 );
+		}
+
+		~Scene()
+		{
+			mWorld.removeCollisionObject( &mObject0 );
+			mWorld.removeCollisionObject( &mObject1 );
+			delete mPlate0;
+			delete mPlate1;
+		}
+
+		///plate 1 rests on plate 0, shifted by half a box and turned a bit
+		static btTransform placement( btScalar offset )
+		{
+			btTransform tr;
+			tr.setIdentity();
+			tr.setOrigin( btVector3( btScalar(0.5)+offset, btScalar(0.38), btScalar(0.3) ) );
+			tr.setRotation( btQuaternion( btVector3( 0, 1, 0 ), btScalar(0.2) ) );
+			return tr;
+		}
+
+		btCompoundCompoundCollisionAlgorithm* getAlgorithm()
+		{
+			btBroadphasePairArray& pairs = mBroadphase.getOverlappingPairCache()->getOverlappingPairArray();
+			CPPUNIT_ASSERT_EQUAL( 1, pairs.size() );
+			CPPUNIT_ASSERT( pairs[0].m_algorithm );
+			return static_cast<btCompoundCompoundCollisionAlgorithm*>( pairs[0].m_algorithm );
+		}
+
+		///the child pairs whose world space AABBs overlap
+		int countOverlappingChildPairs()
+		{
+			int count = 0;
+			for (int i=0;i<mPlate0->getNumChildShapes();i++)
+			{
+				btVector3 aabbMin0, aabbMax0;
+				mPlate0->getChildShape(i)->getAabb( mObject0.getWorldTransform()*mPlate0->getChildTransform(i), aabbMin0, aabbMax0 );
+				for (int j=0;j<mPlate1->getNumChildShapes();j++)
+				{
+					btVector3 aabbMin1, aabbMax1;
+					mPlate1->getChildShape(j)->getAabb( mObject1.getWorldTransform()*mPlate1->getChildTransform(j), aabbMin1, aabbMax1 );
+					if (TestAabbAgainstAabb2( aabbMin0, aabbMax0, aabbMin1, aabbMax1 ))
+						count++;
+				}
+			}
+			return count;
+		}
+
+		int countContacts()
+		{
+			int count = 0;
+			for (int i=0;i<mDispatcher.getNumManifolds();i++)
+				count += mDispatcher.getManifoldByIndexInternal(i)->getNumContacts();
+			return count;
+		}
+	};
+
+public:
+
+	void setUp()
+	{
+	}
+
+	void tearDown()
+	{
+	}
+
+	void testChildPairs()
+	{
+		Scene tree( true );
+		Scene bruteForce( false );
+		tree.mWorld.performDiscreteCollisionDetection();
+		bruteForce.mWorld.performDiscreteCollisionDetection();
+
+		btCompoundCompoundCollisionAlgorithm* algorithm = tree.getAlgorithm();
+		int expected = tree.countOverlappingChildPairs();
+		CPPUNIT_ASSERT( expected > GRID_SIZE*GRID_SIZE );
+		CPPUNIT_ASSERT_EQUAL( expected, algorithm->getNumChildPairs() );
+		CPPUNIT_ASSERT_EQUAL( expected, bruteForce.getAlgorithm()->getNumChildPairs() );
+		for (int i=0;i<algorithm->getNumChildPairs();i++)
+		{
+			const btCompoundChildPair* pair = algorithm->getChildPair(i);
+			CPPUNIT_ASSERT( pair->m_algorithm );
+			CPPUNIT_ASSERT( pair->m_index0 >= 0 && pair->m_index0 < GRID_SIZE*GRID_SIZE );
+			CPPUNIT_ASSERT( pair->m_index1 >= 0 && pair->m_index1 < GRID_SIZE*GRID_SIZE );
+		}
+
+		//the same contacts with and without the trees
+		CPPUNIT_ASSERT( tree.countContacts() > GRID_SIZE*GRID_SIZE );
+		CPPUNIT_ASSERT_EQUAL( bruteForce.countContacts(), tree.countContacts() );
+	}
+
+	void testPersistentPairs()
+	{
+		Scene scene( true );
+		scene.mWorld.performDiscreteCollisionDetection();
+		btCompoundCompoundCollisionAlgorithm* algorithm = scene.getAlgorithm();
+		int numPairs = algorithm->getNumChildPairs();
+		btAlignedObjectArray<const btCollisionAlgorithm*> childAlgorithms;
+		for (int i=0;i<numPairs;i++)
+			childAlgorithms.push_back( algorithm->getChildPair(i)->m_algorithm );
+
+		//a small motion keeps the pairs and their algorithms
+		scene.mObject1.setWorldTransform( Scene::placement( btScalar(0.01) ) );
+		scene.mWorld.performDiscreteCollisionDetection();
+		CPPUNIT_ASSERT( algorithm == scene.getAlgorithm() );
+		CPPUNIT_ASSERT_EQUAL( numPairs, algorithm->getNumChildPairs() );
+		for (int i=0;i<numPairs;i++)
+			CPPUNIT_ASSERT( childAlgorithms[i] == algorithm->getChildPair(i)->m_algorithm );
+
+		//pairs that stopped overlapping are kept for gCompoundCompoundPairRemovalDelay frames
+		scene.mObject1.setWorldTransform( Scene::placement( btScalar(0.5) ) );
+		int expected = scene.countOverlappingChildPairs();
+		CPPUNIT_ASSERT( expected != numPairs );
+		for (int frame=0;frame<gCompoundCompoundPairRemovalDelay;frame++)
+		{
+			scene.mWorld.performDiscreteCollisionDetection();
+			CPPUNIT_ASSERT( algorithm->getNumChildPairs() > expected );
+		}
+		scene.mWorld.performDiscreteCollisionDetection();
+		CPPUNIT_ASSERT_EQUAL( expected, algorithm->getNumChildPairs() );
+
+		//a moved child keeps its index, its pairs time out like the others
+		btTransform child = scene.mPlate0->getChildTransform( 0 );
+		child.getOrigin() += btVector3( 0, btScalar(-10.), 0 );
+		scene.mPlate0->updateChildTransform( 0, child );
+		for (int frame=0;frame<=gCompoundCompoundPairRemovalDelay;frame++)
+			scene.mWorld.performDiscreteCollisionDetection();
+		CPPUNIT_ASSERT_EQUAL( scene.countOverlappingChildPairs(), algorithm->getNumChildPairs() );
+		for (int i=0;i<algorithm->getNumChildPairs();i++)
+			CPPUNIT_ASSERT( algorithm->getChildPair(i)->m_index0 != 0 );
+
+		//removing a child changes the indices and rebuilds the cache
+		scene.mPlate1->removeChildShapeByIndex( 5 );
+		scene.mWorld.performDiscreteCollisionDetection();
+		CPPUNIT_ASSERT_EQUAL( scene.countOverlappingChildPairs(), algorithm->getNumChildPairs() );
+	}
+
+	void testCompoundStack()
+	{
+		btDefaultCollisionConfiguration collisionConfig;
+		btCollisionDispatcher dispatcher( &collisionConfig );
+		btDbvtBroadphase broadphase;
+		btSequentialImpulseConstraintSolver solver;
+		btDiscreteDynamicsWorld world( &dispatcher, &broadphase, &solver, &collisionConfig );
+		world.setGravity( btVector3( 0, -10, 0 ) );
+
+		btBoxShape boxShape( btVector3( btScalar(0.45), btScalar(0.2), btScalar(0.45) ) );
+		btCompoundShape* ground = createPlate( &boxShape, true );
+		btCompoundShape* plate = createPlate( &boxShape, true );
+
+		btRigidBody groundBody( 0, 0, ground );
+		btVector3 inertia;
+		plate->calculateLocalInertia( 1, inertia );
+		btRigidBody::btRigidBodyConstructionInfo info( 1, 0, plate, inertia );
+		info.m_startWorldTransform = Scene::placement( btScalar(0.) );
+		info.m_startWorldTransform.getOrigin() += btVector3( 0, btScalar(0.5), 0 );
+		btRigidBody plateBody( info );
+		world.addRigidBody( &groundBody );
+		world.addRigidBody( &plateBody );
+
+		for (int i=0;i<120;i++)
+			world.stepSimulation( btScalar(1.)/btScalar(60.), 0 );
+
+		//the plate rests on the ground plate: the boxes are 0.4 high
+		CPPUNIT_ASSERT( btFabs( plateBody.getWorldTransform().getOrigin().getY()-btScalar(0.4) ) < btScalar(0.05) );
+		CPPUNIT_ASSERT( plateBody.getLinearVelocity().length() < btScalar(0.1) );
+
+		world.removeRigidBody( &plateBody );
+		world.removeRigidBody( &groundBody );
+		delete plate;
+		delete ground;
+	}
+
+	CPPUNIT_TEST_SUITE(TestCompoundCompound);
+	CPPUNIT_TEST(testChildPairs);
+	CPPUNIT_TEST(testPersistentPairs);
+	CPPUNIT_TEST(testCompoundStack);
+	CPPUNIT_TEST_SUITE_END();
+};
+
+#endif
@@ -0,0 +1,260 @@
+#ifndef TESTCOMPOUNDSHAPEUPDATES_HAS_BEEN_INCLUDED
+#define TESTCOMPOUNDSHAPEUPDATES_HAS_BEEN_INCLUDED
+
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+#include "TestSupport.h"
+
+#include "btBulletCollisionCommon.h"
+#include "BulletCollision/BroadphaseCollision/btDbvt.h"
+#include "LinearMath/btThreads.h"
+
+// ---------------------------------------------------------------------------
+
+class TestCompoundShapeUpdates : public CppUnit::TestFixture
+{
+	enum
+	{
+		NUM_CHILDREN = 200
+	};
+
+	btBoxShape* mBoxShape;
+
+	static btTransform childTransform( int i, btScalar phase )
+	{
+		btTransform tr;
+		tr.setIdentity();
+		tr.setOrigin( btVector3( btScalar(i%10)*2, btSin( btScalar(i)*btScalar(0.3)+phase )*3, btScalar(i/10)*2 ) );
+		tr.setRotation( btQuaternion( btVector3( 1, 1, 0 ).normalized(), btScalar(i)*btScalar(0.1)+phase ) );
+		return tr;
+	}
+
+	struct CollectLeaves : btDbvt::ICollide
+	{
+		btAlignedObjectArray<int> mIndices;
+		void Process( const btDbvtNode* leaf )
+		{
+			mIndices.push_back( leaf->dataAsInt );
+		}
+	};
+
+	struct IntLess
+	{
+		bool operator() ( int a, int b ) const
+		{
+			return a < b;
+		}
+	};
+
+	///the tree has a leaf with the exact bounds of every child, and a query finds the same children as a brute force test
+	static void checkTree( const btCompoundShape& compound )
+	{
+		const btDbvt* tree = compound.getDynamicAabbTree();
+		CPPUNIT_ASSERT( !compound.hasPendingChildUpdates() );
+		CPPUNIT_ASSERT_EQUAL( compound.getNumChildShapes(), tree->m_leaves );
+
+		btVector3 queryMin( btScalar(3.), btScalar(-2.), btScalar(3.) );
+		btVector3 queryMax( btScalar(9.), btScalar(2.), btScalar(11.) );
+		btAlignedObjectArray<int> expected;
+		for (int i=0;i<compound.getNumChildShapes();i++)
+		{
+			btVector3 aabbMin, aabbMax;
+			compound.getChildShape(i)->getAabb( compound.getChildTransform(i), aabbMin, aabbMax );
+			const btDbvtNode* node = const_cast<btCompoundShape&>(compound).getChildList()[i].m_node;
+			CPPUNIT_ASSERT( node );
+			CPPUNIT_ASSERT_EQUAL( i, node->dataAsInt );
+			CPPUNIT_ASSERT( node->volume.Mins() == aabbMin );
+			CPPUNIT_ASSERT( node->volume.Maxs() == aabbMax );
+			if (TestAabbAgainstAabb2( aabbMin, aabbMax, queryMin, queryMax ))
+				expected.push_back( i );
+		}
+		CollectLeaves collector;
+		tree->collideTV( tree->m_root, btDbvtVolume::FromMM( queryMin, queryMax ), collector );
+		collector.mIndices.quickSort( IntLess() );
+		CPPUNIT_ASSERT( expected.size() > 0 );
+		CPPUNIT_ASSERT_EQUAL( expected.size(), collector.mIndices.size() );
+		for (int i=0;i<expected.size();i++)
+			CPPUNIT_ASSERT_EQUAL( expected[i], collector.mIndices[i] );
+	}
+
+	static void checkSameAabb( const btCompoundShape& a, const btCompoundShape& b )
+	{
+		btTransform tr;
+		tr.setIdentity();
+		btVector3 minA, maxA, minB, maxB;
+		a.getAabb( tr, minA, maxA );
+		b.getAabb( tr, minB, maxB );
+		CPPUNIT_ASSERT( minA == minB );
+		CPPUNIT_ASSERT( maxA == maxB );
+	}
+
+	struct QueryLoop : public btIParallelForBody
+	{
+		const btCompoundShape* mCompound;
+		btVector3* mAabbMin;
+
+		void forLoop( int iBegin, int iEnd ) const
+		{
+			for (int i=iBegin;i<iEnd;i++)
+			{
+				btTransform tr;
+				tr.setIdentity();
+				btVector3 aabbMax;
+				mCompound->getAabb( tr, mAabbMin[i], aabbMax );
+			}
+		}
+	};
+
+public:
+
+	void setUp()
+	{
+		mBoxShape = new btBoxShape( btVector3( btScalar(0.5), btScalar(0.3), btScalar(0.8) ) );
+	}
+
+	void tearDown()
+	{
+		btSetTaskScheduler( 0 );
+		delete mBoxShape;
+	}
+
+	void testDeferredTransforms()
+	{
+		btCompoundShape reference, batched;
+		for (int i=0;i<NUM_CHILDREN;i++)
+		{
+			reference.addChildShape( childTransform( i, 0 ), mBoxShape );
+			batched.addChildShape( childTransform( i, 0 ), mBoxShape );
+		}
+
+		//move all children: the tree is rebuilt
+		btAlignedObjectArray<int> indices;
+		btAlignedObjectArray<btTransform> transforms;
+		for (int i=0;i<NUM_CHILDREN;i++)
+		{
+			reference.updateChildTransform( i, childTransform( i, 1 ) );
+			indices.push_back( i );
+			transforms.push_back( childTransform( i, 1 ) );
+		}
+		int revision = batched.getUpdateRevision();
+		batched.updateChildTransforms( &indices[0], &transforms[0], indices.size() );
+		CPPUNIT_ASSERT_EQUAL( revision, batched.getUpdateRevision() );
+		CPPUNIT_ASSERT( batched.hasPendingChildUpdates() );
+		checkSameAabb( reference, batched );
+		CPPUNIT_ASSERT( !batched.hasPendingChildUpdates() );
+		checkTree( batched );
+
+		//move a few children, twice: the leaves are updated
+		indices.resize( 0 );
+		transforms.resize( 0 );
+		for (int i=0;i<NUM_CHILDREN;i+=20)
+		{
+			indices.push_back( i );
+			transforms.push_back( childTransform( i, 5 ) );
+			indices.push_back( i );
+			transforms.push_back( childTransform( i, 2 ) );
+			reference.updateChildTransform( i, childTransform( i, 2 ) );
+		}
+		batched.updateChildTransforms( &indices[0], &transforms[0], indices.size() );
+		checkTree( batched );
+		checkSameAabb( reference, batched );
+	}
+
+	void testBulkAddRemove()
+	{
+		btCompoundShape reference, batched;
+		btAlignedObjectArray<btTransform> transforms;
+		btAlignedObjectArray<btCollisionShape*> shapes;
+		for (int i=0;i<NUM_CHILDREN;i++)
+		{
+			reference.addChildShape( childTransform( i, 0 ), mBoxShape );
+			transforms.push_back( childTransform( i, 0 ) );
+			shapes.push_back( mBoxShape );
+		}
+		int revision = batched.getUpdateRevision();
+		batched.addChildShapes( &transforms[0], &shapes[0], NUM_CHILDREN );
+		CPPUNIT_ASSERT( batched.getUpdateRevision() != revision );
+		CPPUNIT_ASSERT_EQUAL( int(NUM_CHILDREN), batched.getNumChildShapes() );
+		checkSameAabb( reference, batched );
+		checkTree( batched );
+
+		//a few children: the leaves are removed from the tree
+		int few[4] = { 7, 3, 150, 7 };
+		revision = batched.getUpdateRevision();
+		batched.removeChildShapesByIndex( few, 4 );
+		CPPUNIT_ASSERT( batched.getUpdateRevision() != revision );
+		CPPUNIT_ASSERT_EQUAL( int(NUM_CHILDREN)-3, batched.getNumChildShapes() );
+		checkTree( batched );
+
+		//the remaining children keep their order
+		int expectedIndex = 0;
+		for (int i=0;i<batched.getNumChildShapes();i++,expectedIndex++)
+		{
+			while (expectedIndex==3 || expectedIndex==7 || expectedIndex==150)
+				expectedIndex++;
+			CPPUNIT_ASSERT( batched.getChildTransform(i).getOrigin() == childTransform( expectedIndex, 0 ).getOrigin() );
+		}
+
+		//most children: the tree is rebuilt from the remaining ones
+		btAlignedObjectArray<int> many;
+		for (int i=0;i<batched.getNumChildShapes();i++)
+		{
+			if (i%3)
+				many.push_back( i );
+		}
+		int numLeft = batched.getNumChildShapes()-many.size();
+		batched.removeChildShapesByIndex( &many[0], many.size() );
+		CPPUNIT_ASSERT_EQUAL( numLeft, batched.getNumChildShapes() );
+		checkTree( batched );
+
+		btCompoundShape remaining;
+		for (int i=0;i<batched.getNumChildShapes();i++)
+			remaining.addChildShape( batched.getChildTransform(i), batched.getChildShape(i) );
+		checkSameAabb( remaining, batched );
+	}
+
+	void testConcurrentQueries()
+	{
+		TestThreadPool threads;
+		if (threads.skipWithoutThreads( "TestCompoundShapeUpdates::testConcurrentQueries" ))
+			return;
+
+		btCompoundShape reference, batched;
+		btAlignedObjectArray<int> indices;
+		btAlignedObjectArray<btTransform> transforms;
+		for (int i=0;i<NUM_CHILDREN;i++)
+		{
+			reference.addChildShape( childTransform( i, 3 ), mBoxShape );
+			batched.addChildShape( childTransform( i, 0 ), mBoxShape );
+			indices.push_back( i );
+			transforms.push_back( childTransform( i, 3 ) );
+		}
+		btTransform tr;
+		tr.setIdentity();
+		btVector3 expectedMin, expectedMax;
+		reference.getAabb( tr, expectedMin, expectedMax );
+
+		for (int pass=0;pass<10;pass++)
+		{
+			batched.updateChildTransforms( &indices[0], &transforms[0], indices.size() );
+			//every thread finds pending updates, only one of them applies them
+			btAlignedObjectArray<btVector3> aabbMin;
+			aabbMin.resize( 64 );
+			QueryLoop loop;
+			loop.mCompound = &batched;
+			loop.mAabbMin = &aabbMin[0];
+			btParallelFor( 0, aabbMin.size(), 1, loop );
+			for (int i=0;i<aabbMin.size();i++)
+				CPPUNIT_ASSERT( aabbMin[i] == expectedMin );
+		}
+		checkTree( batched );
+	}
+
+	CPPUNIT_TEST_SUITE(TestCompoundShapeUpdates);
+	CPPUNIT_TEST(testDeferredTransforms);
+	CPPUNIT_TEST(testBulkAddRemove);
+	CPPUNIT_TEST(testConcurrentQueries);
+	CPPUNIT_TEST_SUITE_END();
+};
+
+#endif
@@ -0,0 +1,183 @@
+#ifndef TESTDBVTBROADPHASEPARALLEL_HAS_BEEN_INCLUDED
+#define TESTDBVTBROADPHASEPARALLEL_HAS_BEEN_INCLUDED
+
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+#include "TestSupport.h"
+
+#include "btBulletCollisionCommon.h"
+#include "LinearMath/btThreads.h"
+
+// ---------------------------------------------------------------------------
+
+class TestDbvtBroadphaseParallel : public TestRandomFixture
+{
+	enum
+	{
+		NUM_PROXIES = 1500,
+		NUM_FRAMES = 10
+	};
+
+	struct Result
+	{
+		btAlignedObjectArray<int> mPairs;
+		int mMissingPairs;
+	};
+
+	void runScene( bool parallel, Result& result )
+	{
+		btDbvtBroadphase broadphase;
+		broadphase.setParallelCollide( parallel );
+		broadphase.setVelocityPrediction( btScalar(0.5) );
+
+		btAlignedObjectArray<btBroadphaseProxy*> proxies;
+		btAlignedObjectArray<btVector3> centers, extents;
+		mSeed = 1234;
+		for (int i=0;i<NUM_PROXIES;i++)
+		{
+			btVector3 center( rand01()*40, rand01()*40, rand01()*40 );
+			btVector3 extent( rand01()+0.25, rand01()+0.25, rand01()+0.25 );
+			centers.push_back( center );
+			extents.push_back( extent );
+			proxies.push_back( broadphase.createProxy( center-extent, center+extent, BOX_SHAPE_PROXYTYPE, 0, 1, -1, 0, 0 ) );
+		}
+
+		for (int f=0;f<NUM_FRAMES;f++)
+		{
+			for (int i=0;i<NUM_PROXIES;i++)
+			{
+				//most proxies move a little, some teleport, and some don't move so they end up in the fixed set
+				if (i%5==0)
+					continue;
+				if (i%97==f)
+					centers[i] = btVector3( rand01()*40, rand01()*40, rand01()*40 );
+				else
+					centers[i] += btVector3( rand01()-0.5, rand01()-0.5, rand01()-0.5 )*btScalar(0.4);
+				broadphase.setAabb( proxies[i], centers[i]-extents[i], centers[i]+extents[i], 0 );
+			}
+			broadphase.calculateOverlappingPairs( 0 );
+		}
+
+		//every pair of overlapping AABBs must be in the pair cache
+		btOverlappingPairCache* pairCache = broadphase.getOverlappingPairCache();
+		result.mMissingPairs = 0;
+		for (int i=0;i<NUM_PROXIES;i++)
+		{
+			for (int j=i+1;j<NUM_PROXIES;j++)
+			{
+				if (TestAabbAgainstAabb2( proxies[i]->m_aabbMin, proxies[i]->m_aabbMax, proxies[j]->m_aabbMin, proxies[j]->m_aabbMax ) &&
+					!pairCache->findPair( proxies[i], proxies[j] ))
+				{
+					result.mMissingPairs++;
+				}
+			}
+		}
+
+		const btBroadphasePairArray& pairs = pairCache->getOverlappingPairArray();
+		for (int i=0;i<pairs.size();i++)
+		{
+			result.mPairs.push_back( pairs[i].m_pProxy0->getUid() );
+			result.mPairs.push_back( pairs[i].m_pProxy1->getUid() );
+		}
+
+		for (int i=0;i<NUM_PROXIES;i++)
+			broadphase.destroyProxy( proxies[i], 0 );
+	}
+
+	struct CountCallback : public btBroadphaseAabbCallback
+	{
+		const btBroadphaseProxy* mProxy;
+		int mCount;
+
+		virtual bool process( const btBroadphaseProxy* proxy )
+		{
+			if (proxy == mProxy)
+				mCount++;
+			return true;
+		}
+	};
+
+	///returns the number of internal nodes whose volume doesn't contain the volumes of their children
+	static int countStaleNodes( const btDbvtNode* node )
+	{
+		if (!node || node->isleaf())
+			return 0;
+		int stale = (node->volume.Contain( node->childs[0]->volume ) && node->volume.Contain( node->childs[1]->volume )) ? 0 : 1;
+		return stale+countStaleNodes( node->childs[0] )+countStaleNodes( node->childs[1] );
+	}
+
+public:
+
+	void setUp()
+	{
+	}
+
+	void tearDown()
+	{
+		btSetTaskScheduler( 0 );
+	}
+
+	void testParallelCollide()
+	{
+		Result sequential;
+		runScene( false, sequential );
+		CPPUNIT_ASSERT_EQUAL( 0, sequential.mMissingPairs );
+
+		Result parallelSingleThread;
+		btSetTaskScheduler( btGetSequentialTaskScheduler() );
+		runScene( true, parallelSingleThread );
+		CPPUNIT_ASSERT_EQUAL( 0, parallelSingleThread.mMissingPairs );
+
+		TestThreadPool threads;
+		if (threads.skipWithoutThreads( "TestDbvtBroadphaseParallel::testParallelCollide" ))
+			return;
+		Result parallel;
+		runScene( true, parallel );
+		CPPUNIT_ASSERT_EQUAL( 0, parallel.mMissingPairs );
+
+		//the pair array doesn't depend on the number of threads
+		CPPUNIT_ASSERT_EQUAL( parallelSingleThread.mPairs.size(), parallel.mPairs.size() );
+		for (int i=0;i<parallel.mPairs.size();i++)
+		{
+			CPPUNIT_ASSERT_EQUAL( parallelSingleThread.mPairs[i], parallel.mPairs[i] );
+		}
+	}
+
+	void testQueryAfterSetAabb()
+	{
+		btDbvtBroadphase broadphase;
+		broadphase.setParallelCollide( true );
+		btAlignedObjectArray<btBroadphaseProxy*> proxies;
+		mSeed = 99;
+		for (int i=0;i<NUM_PROXIES;i++)
+		{
+			btVector3 center( rand01()*40, rand01()*40, rand01()*40 );
+			proxies.push_back( broadphase.createProxy( center-btVector3( 1, 1, 1 ), center+btVector3( 1, 1, 1 ), BOX_SHAPE_PROXYTYPE, 0, 1, -1, 0, 0 ) );
+		}
+		broadphase.calculateOverlappingPairs( 0 );
+
+		//setAabb only grows the leaves, the next query refits the tree by itself, also in release builds
+		for (int i=0;i<NUM_PROXIES;i+=3)
+		{
+			btVector3 center( rand01()*40, rand01()*40+50, rand01()*40 );
+			broadphase.setAabb( proxies[i], center-btVector3( 1, 1, 1 ), center+btVector3( 1, 1, 1 ), 0 );
+		}
+		CountCallback cb;
+		cb.mProxy = proxies[3];
+		cb.mCount = 0;
+		broadphase.aabbTest( proxies[3]->m_aabbMin, proxies[3]->m_aabbMax, cb );
+		CPPUNIT_ASSERT_EQUAL( 1, cb.mCount );
+		CPPUNIT_ASSERT( !broadphase.m_needrefit );
+		CPPUNIT_ASSERT_EQUAL( 0, countStaleNodes( broadphase.m_sets[0].m_root ) );
+
+		for (int i=0;i<NUM_PROXIES;i++)
+			broadphase.destroyProxy( proxies[i], 0 );
+	}
+
+	CPPUNIT_TEST_SUITE(TestDbvtBroadphaseParallel);
+	CPPUNIT_TEST(testParallelCollide);
+	CPPUNIT_TEST(testQueryAfterSetAabb);
+	CPPUNIT_TEST_SUITE_END();
+};
+
+#endif
@@ -0,0 +1,273 @@
+#ifndef TESTDISCRETEDYNAMICSWORLDMT_HAS_BEEN_INCLUDED
+#define TESTDISCRETEDYNAMICSWORLDMT_HAS_BEEN_INCLUDED
+
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+#include "TestSupport.h"
+
+#include "btBulletDynamicsCommon.h"
+#include "BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h"
+#include "BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h"
+#include "LinearMath/btThreads.h"
+
+#include <string.h>
+
+// ---------------------------------------------------------------------------
+
+class TestDiscreteDynamicsWorldMt : public CppUnit::TestFixture
+{
+	enum
+	{
+		NUM_STACKS = 24,
+		STACK_HEIGHT = 5,
+		NUM_STEPS = 60,
+		NUM_WIDE_THREADS = 6,
+		NUM_ITEMS = 4000
+	};
+
+	struct Scene
+	{
+		btDefaultCollisionConfiguration*	mCollisionConfig;
+		btCollisionDispatcherMt*			mCollisionDispatch;
+		btDbvtBroadphase*					mBroadphase;
+		btDiscreteDynamicsWorldMt*			mWorld;
+		btBoxShape*							mGroundShape;
+		btBoxShape*							mBoxShape;
+		btCylinderShape*					mCylinderShape;
+		btAlignedObjectArray<btRigidBody*>	mBodies;
+
+		Scene()
+		{
+			mCollisionConfig = new btDefaultCollisionConfiguration;
+			mCollisionDispatch = new btCollisionDispatcherMt( mCollisionConfig, 4 );
+			mBroadphase = new btDbvtBroadphase();
+			mWorld = new btDiscreteDynamicsWorldMt( mCollisionDispatch, mBroadphase, 0, mCollisionConfig );
+			mWorld->setGravity( btVector3( 0, -10, 0 ));
+			//small batches, so that every stack is an island of its own
+			mWorld->getSolverInfo().m_minimumSolverBatchSize = 1;
+
+			mGroundShape = new btBoxShape( btVector3( 100, 1, 100 ) );
+			mBoxShape = new btBoxShape( btVector3( 0.5, 0.5, 0.5 ) );
+			mCylinderShape = new btCylinderShape( btVector3( 0.4, 0.5, 0.4 ) );
+
+			btTransform tr;
+			tr.setIdentity();
+			tr.setOrigin( btVector3( 0, -1, 0 ) );
+			addBody( 0, tr, mGroundShape );
+
+			//independent stacks of boxes: each stack is a separate simulation island
+			for (int s=0;s<NUM_STACKS;s++)
+			{
+				for (int h=0;h<STACK_HEIGHT;h++)
+				{
+					tr.setOrigin( btVector3( btScalar(s%6)*4-10, btScalar(h)*1.02+0.5, btScalar(s/6)*4-8 ) );
+					tr.setRotation( btQuaternion( btVector3( 0, 1, 0 ), btScalar(0.1)*h ) );
+					addBody( 1, tr, mBoxShape );
+				}
+				//a cylinder on top, so that the stack also has a pair that goes through GJK
+				tr.setOrigin( btVector3( btScalar(s%6)*4-10, btScalar(STACK_HEIGHT)*1.02+0.5, btScalar(s/6)*4-8 ) );
+				addBody( 1, tr, mCylinderShape );
+			}
+		}
+
+		~Scene()
+		{
+			for (int i=0;i<mBodies.size();i++)
+			{
+				mWorld->removeRigidBody( mBodies[i] );
+				delete mBodies[i];
+			}
+			delete mWorld;
+			delete mCylinderShape;
+			delete mBoxShape;
+			delete mGroundShape;
+			delete mBroadphase;
+			delete mCollisionDispatch;
+			delete mCollisionConfig;
+		}
+
+		void addBody( btScalar mass, const btTransform& tr, btCollisionShape* shape )
+		{
+			btVector3 inertia( 0, 0, 0 );
+			if (mass>0)
+				shape->calculateLocalInertia( mass, inertia );
+			btRigidBody::btRigidBodyConstructionInfo info( mass, 0, shape, inertia );
+			info.m_startWorldTransform = tr;
+			btRigidBody* body = new btRigidBody( info );
+			mWorld->addRigidBody( body );
+			mBodies.push_back( body );
+		}
+
+		void simulate( btAlignedObjectArray<btTransform>& result, int& numManifolds )
+		{
+			for (int i=0;i<NUM_STEPS;i++)
+				mWorld->stepSimulation( btScalar(1.)/btScalar(60.), 0 );
+			numManifolds = mCollisionDispatch->getNumManifolds();
+
+			result.resize( mBodies.size() );
+			for (int i=0;i<mBodies.size();i++)
+				result[i] = mBodies[i]->getWorldTransform();
+		}
+	};
+
+	void runScene( btAlignedObjectArray<btTransform>& result, int& numManifolds )
+	{
+		Scene scene;
+		scene.simulate( result, numManifolds );
+	}
+
+	static void checkSameResults( const btAlignedObjectArray<btTransform>& a, const btAlignedObjectArray<btTransform>& b )
+	{
+		CPPUNIT_ASSERT_EQUAL( a.size(), b.size() );
+		for (int i=0;i<a.size();i++)
+		{
+			CPPUNIT_ASSERT( memcmp( &a[i], &b[i], sizeof(btTransform) ) == 0 );
+		}
+	}
+
+	///WideTaskScheduler claims more threads than the sequential scheduler, but runs the loops on the calling thread
+	class WideTaskScheduler : public btITaskScheduler
+	{
+	public:
+		WideTaskScheduler() : btITaskScheduler( "Wide" ) {}
+
+		virtual int		getMaxNumThreads() const	{ return NUM_WIDE_THREADS; }
+		virtual int		getNumThreads() const		{ return NUM_WIDE_THREADS; }
+		virtual void	setNumThreads( int numThreads ) { (void)numThreads; }
+
+		virtual void	parallelFor( int iBegin, int iEnd, int grainSize, const btIParallelForBody& body )
+		{
+			(void)grainSize;
+			body.forLoop( iBegin, iEnd );
+		}
+	};
+
+	///records the thread index of every item
+	struct ThreadIndexBody : public btIParallelForBody
+	{
+		unsigned int*	mIndices;
+
+		void forLoop( int iBegin, int iEnd ) const
+		{
+			for (int i=iBegin;i<iEnd;i++)
+			{
+				mIndices[i] = btGetCurrentThreadIndex();
+				//some work, so that the items are spread over the threads
+				volatile int sum = 0;
+				for (int k=0;k<2000;k++)
+					sum += k;
+			}
+		}
+	};
+
+public:
+
+	void setUp()
+	{
+	}
+
+	void tearDown()
+	{
+		btSetTaskScheduler( 0 );
+	}
+
+	void testDeterminism()
+	{
+		btAlignedObjectArray<btTransform> sequentialResult;
+		int sequentialManifolds = 0;
+		btSetTaskScheduler( btGetSequentialTaskScheduler() );
+		runScene( sequentialResult, sequentialManifolds );
+
+		TestThreadPool threads;
+		if (threads.skipWithoutThreads( "TestDiscreteDynamicsWorldMt::testDeterminism" ))
+			return;
+		btAlignedObjectArray<btTransform> parallelResult;
+		int parallelManifolds = 0;
+		runScene( parallelResult, parallelManifolds );
+
+		CPPUNIT_ASSERT_EQUAL( sequentialManifolds, parallelManifolds );
+		CPPUNIT_ASSERT_EQUAL( sequentialResult.size(), parallelResult.size() );
+		for (int i=0;i<sequentialResult.size();i++)
+		{
+			CPPUNIT_ASSERT( memcmp( &sequentialResult[i], &parallelResult[i], sizeof(btTransform) ) == 0 );
+		}
+		//the boxes came to rest on the ground instead of falling through
+		CPPUNIT_ASSERT( parallelResult[1].getOrigin().getY() > btScalar(0.4) );
+	}
+
+	void testSolverPool()
+	{
+		btAlignedObjectArray<btTransform> sequentialResult, grownResult, wrappedResult;
+		int sequentialManifolds = 0, grownManifolds = 0, wrappedManifolds = 0;
+		btSetTaskScheduler( btGetSequentialTaskScheduler() );
+		runScene( sequentialResult, sequentialManifolds );
+
+		WideTaskScheduler wideScheduler;
+		{
+			Scene scene;
+			btConstraintSolverPoolMt* solverPool = static_cast<btConstraintSolverPoolMt*>( scene.mWorld->getConstraintSolver() );
+			CPPUNIT_ASSERT_EQUAL( 1, solverPool->getNumSolvers() );
+			//a task scheduler with more threads than the one the world was built with
+			btSetTaskScheduler( &wideScheduler );
+			scene.simulate( grownResult, grownManifolds );
+			CPPUNIT_ASSERT_EQUAL( int(NUM_WIDE_THREADS), solverPool->getNumSolvers() );
+		}
+		{
+			btSequentialImpulseConstraintSolver solver;
+			Scene scene;
+			//a single solver is wrapped in a pool of one, which solves one island at a time
+			scene.mWorld->setConstraintSolver( &solver );
+			CPPUNIT_ASSERT( scene.mWorld->getConstraintSolver() != &solver );
+			btConstraintSolverPoolMt* solverPool = static_cast<btConstraintSolverPoolMt*>( scene.mWorld->getConstraintSolver() );
+			scene.simulate( wrappedResult, wrappedManifolds );
+			CPPUNIT_ASSERT_EQUAL( 1, solverPool->getNumSolvers() );
+		}
+		btSetTaskScheduler( 0 );
+
+		CPPUNIT_ASSERT_EQUAL( sequentialManifolds, grownManifolds );
+		CPPUNIT_ASSERT_EQUAL( sequentialManifolds, wrappedManifolds );
+		checkSameResults( sequentialResult, grownResult );
+		checkSameResults( sequentialResult, wrappedResult );
+	}
+
+	void testThreadIndices()
+	{
+		unsigned int mainIndex = btGetCurrentThreadIndex();
+		btAlignedObjectArray<unsigned int> indices;
+		indices.resize( NUM_ITEMS );
+		ThreadIndexBody body;
+		body.mIndices = &indices[0];
+
+		int numIndices = 0;
+		for (int pool=0;pool<3;pool++)
+		{
+			TestThreadPool threads;
+			if (threads.skipWithoutThreads( "TestDiscreteDynamicsWorldMt::testThreadIndices" ))
+				return;
+			//the workers of a new pool take the indices the workers of the previous one gave back
+			if (pool==0)
+				numIndices = btGetNumThreadIndices();
+			CPPUNIT_ASSERT_EQUAL( numIndices, btGetNumThreadIndices() );
+
+			btParallelFor( 0, NUM_ITEMS, 16, body );
+			int numOnMainThread = 0;
+			for (int i=0;i<NUM_ITEMS;i++)
+			{
+				CPPUNIT_ASSERT( int(indices[i]) < numIndices );
+				if (indices[i]==mainIndex)
+					numOnMainThread++;
+			}
+			//the workers don't share the index of the main thread
+			CPPUNIT_ASSERT( numOnMainThread < NUM_ITEMS );
+			CPPUNIT_ASSERT_EQUAL( mainIndex, btGetCurrentThreadIndex() );
+		}
+	}
+
+	CPPUNIT_TEST_SUITE(TestDiscreteDynamicsWorldMt);
+	CPPUNIT_TEST(testDeterminism);
+	CPPUNIT_TEST(testSolverPool);
+	CPPUNIT_TEST(testThreadIndices);
+	CPPUNIT_TEST_SUITE_END();
+};
+
+#endif
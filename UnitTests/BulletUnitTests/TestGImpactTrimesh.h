@@ -0,0 +1,325 @@
+#ifndef TESTGIMPACTTRIMESH_HAS_BEEN_INCLUDED
+#define TESTGIMPACTTRIMESH_HAS_BEEN_INCLUDED
+
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+#include "TestSupport.h"
+
+#include "btBulletCollisionCommon.h"
+#include "BulletCollision/Gimpact/btGImpactShape.h"
+#include "BulletCollision/Gimpact/btGImpactCollisionAlgorithm.h"
+#include "LinearMath/btThreads.h"
+
+// ---------------------------------------------------------------------------
+
+class TestGImpactTrimesh : public TestRandomFixture
+{
+	enum
+	{
+		GRID_SIZE = 48,
+		NUM_BATCH_TESTS = 20000
+	};
+
+	///a bumpy grid of GRID_SIZE x GRID_SIZE quads in the xz plane
+	struct Mesh
+	{
+		btAlignedObjectArray<btScalar> mVertices;
+		btAlignedObjectArray<int> mIndices;
+		btTriangleIndexVertexArray* mArray;
+		btGImpactMeshShape* mShape;
+
+		Mesh( btScalar phase )
+		{
+			int numVerts = GRID_SIZE+1;
+			for (int z=0;z<numVerts;z++)
+			{
+				for (int x=0;x<numVerts;x++)
+				{
+					mVertices.push_back( btScalar(x)-btScalar(GRID_SIZE)*btScalar(0.5) );
+					mVertices.push_back( btSin( btScalar(x)*btScalar(0.4)+phase )*btCos( btScalar(z)*btScalar(0.3) ) );
+					mVertices.push_back( btScalar(z)-btScalar(GRID_SIZE)*btScalar(0.5) );
+				}
+			}
+			for (int z=0;z<GRID_SIZE;z++)
+			{
+				for (int x=0;x<GRID_SIZE;x++)
+				{
+					int i0 = z*numVerts+x;
+					mIndices.push_back( i0 ); mIndices.push_back( i0+numVerts ); mIndices.push_back( i0+1 );
+					mIndices.push_back( i0+1 ); mIndices.push_back( i0+numVerts ); mIndices.push_back( i0+numVerts+1 );
+				}
+			}
+			mArray = new btTriangleIndexVertexArray( mIndices.size()/3, &mIndices[0], 3*sizeof(int), mVertices.size()/3, &mVertices[0], 3*sizeof(btScalar) );
+			mShape = new btGImpactMeshShape( mArray );
+			mShape->updateBound();
+		}
+
+		~Mesh()
+		{
+			delete mShape;
+			delete mArray;
+		}
+
+		///move the vertices up and down without leaving the quantization bounds of the tree
+		void deform( btScalar phase )
+		{
+			for (int i=1;i<mVertices.size();i+=3)
+				mVertices[i] = btScalar(0.8)*btSin( btScalar(i)*btScalar(0.01)+phase );
+			mShape->postUpdate();
+		}
+	};
+
+	struct Contact
+	{
+		btVector3 mPoint;
+		btVector3 mNormal;
+		btScalar mDepth;
+		int mIndex0;
+		int mIndex1;
+	};
+
+	///records the contacts instead of adding them to the manifold
+	struct RecordingResult : public btManifoldResult
+	{
+		btAlignedObjectArray<Contact> mContacts;
+
+		RecordingResult( const btCollisionObjectWrapper* body0Wrap, const btCollisionObjectWrapper* body1Wrap )
+			:btManifoldResult( body0Wrap, body1Wrap )
+		{
+		}
+
+		virtual void addContactPoint( const btVector3& normalOnBInWorld, const btVector3& pointInWorld, btScalar depth )
+		{
+			Contact c;
+			c.mPoint = pointInWorld;
+			c.mNormal = normalOnBInWorld;
+			c.mDepth = depth;
+			c.mIndex0 = m_index0;
+			c.mIndex1 = m_index1;
+			mContacts.push_back( c );
+		}
+	};
+
+	///exposes the serial refit
+	struct RefitBvh : public btGImpactQuantizedBvh
+	{
+		void refitSerial()
+		{
+			refit_nodes( 0, getNodeCount() );
+		}
+	};
+
+	///the contacts of the serial triangle loop of btGImpactCollisionAlgorithm::collide_sat_triangles
+	static void referenceContacts( const btGImpactMeshShapePart* part0, const btTransform& trans0, const btGImpactMeshShapePart* part1, const btTransform& trans1, btAlignedObjectArray<Contact>& contacts )
+	{
+		btPairSet pairset;
+		btGImpactBoxSet::find_collision( part0->getBoxSet(), trans0, part1->getBoxSet(), trans1, pairset );
+		part0->lockChildShapes();
+		part1->lockChildShapes();
+		btPrimitiveTriangle ptri0, ptri1;
+		GIM_TRIANGLE_CONTACT contact_data;
+		for (int i=0;i<pairset.size();i++)
+		{
+			part0->getPrimitiveTriangle( pairset[i].m_index1, ptri0 );
+			part1->getPrimitiveTriangle( pairset[i].m_index2, ptri1 );
+			ptri0.applyTransform( trans0 );
+			ptri1.applyTransform( trans1 );
+			ptri0.buildTriPlane();
+			ptri1.buildTriPlane();
+			if (ptri0.overlap_test_conservative( ptri1 ) && ptri0.find_triangle_collision_clip_method( ptri1, contact_data ))
+			{
+				int j = contact_data.m_point_count;
+				while (j--)
+				{
+					Contact c;
+					c.mPoint = contact_data.m_points[j];
+					c.mNormal = contact_data.m_separating_normal;
+					c.mDepth = -contact_data.m_penetration_depth;
+					c.mIndex0 = pairset[i].m_index1;
+					c.mIndex1 = pairset[i].m_index2;
+					contacts.push_back( c );
+				}
+			}
+		}
+		part0->unlockChildShapes();
+		part1->unlockChildShapes();
+	}
+
+	void checkContacts( Mesh& mesh0, const btTransform& trans0, Mesh& mesh1, const btTransform& trans1 )
+	{
+		btDefaultCollisionConfiguration config;
+		btCollisionDispatcher dispatcher( &config );
+		btGImpactCollisionAlgorithm::registerAlgorithm( &dispatcher );
+
+		btCollisionObject obj0, obj1;
+		obj0.setCollisionShape( mesh0.mShape );
+		obj0.setWorldTransform( trans0 );
+		obj1.setCollisionShape( mesh1.mShape );
+		obj1.setWorldTransform( trans1 );
+		btCollisionObjectWrapper wrap0( 0, mesh0.mShape, &obj0, trans0 );
+		btCollisionObjectWrapper wrap1( 0, mesh1.mShape, &obj1, trans1 );
+
+		btCollisionAlgorithm* algorithm = dispatcher.findAlgorithm( &wrap0, &wrap1 );
+		RecordingResult result( &wrap0, &wrap1 );
+		btDispatcherInfo info;
+		algorithm->processCollision( &wrap0, &wrap1, info, &result );
+		algorithm->~btCollisionAlgorithm();
+		dispatcher.freeCollisionAlgorithm( algorithm );
+
+		btAlignedObjectArray<Contact> expected;
+		referenceContacts( mesh0.mShape->getMeshPart( 0 ), trans0, mesh1.mShape->getMeshPart( 0 ), trans1, expected );
+		CPPUNIT_ASSERT( expected.size() > 100 );
+		CPPUNIT_ASSERT_EQUAL( expected.size(), result.mContacts.size() );
+		for (int i=0;i<expected.size();i++)
+		{
+			const Contact& a = expected[i];
+			const Contact& b = result.mContacts[i];
+			CPPUNIT_ASSERT_EQUAL( a.mIndex0, b.mIndex0 );
+			CPPUNIT_ASSERT_EQUAL( a.mIndex1, b.mIndex1 );
+			CPPUNIT_ASSERT_EQUAL( a.mDepth, b.mDepth );
+			CPPUNIT_ASSERT( a.mPoint == b.mPoint );
+			CPPUNIT_ASSERT( a.mNormal == b.mNormal );
+		}
+	}
+
+public:
+
+	void setUp()
+	{
+		mSeed = 5;
+	}
+
+	void tearDown()
+	{
+		btSetTaskScheduler( 0 );
+	}
+
+	void testBatchCulling()
+	{
+		//pairs of small triangles near each other, many of them close to touching
+		btTrianglePairBatch batch;
+		btPrimitiveTriangle tri0[BT_TRIANGLE_PAIR_BATCH_SIZE], tri1[BT_TRIANGLE_PAIR_BATCH_SIZE];
+		int numAccepted = 0, numExtra = 0;
+		for (int t=0;t<NUM_BATCH_TESTS;t+=BT_TRIANGLE_PAIR_BATCH_SIZE)
+		{
+			for (int k=0;k<BT_TRIANGLE_PAIR_BATCH_SIZE;k++)
+			{
+				btVector3 center = randVector( 200 );
+				for (int v=0;v<3;v++)
+				{
+					tri0[k].m_vertices[v] = center+randVector( 2 );
+					tri1[k].m_vertices[v] = center+randVector( 2 );
+				}
+				//a nearly flat triangle or a triangle just above the plane of the other one
+				if (t%3 == 1)
+				{
+					tri1[k].m_vertices[2] = (tri1[k].m_vertices[0]+tri1[k].m_vertices[1])*btScalar(0.5);
+				}
+				tri0[k].buildTriPlane();
+				if (t%3 == 2)
+				{
+					btVector3 normal( tri0[k].m_plane[0], tri0[k].m_plane[1], tri0[k].m_plane[2] );
+					for (int v=0;v<3;v++)
+						tri1[k].m_vertices[v] += normal*(btScalar(0.02)-tri0[k].m_plane.dot( tri1[k].m_vertices[v] )+tri0[k].m_plane[3]+rand01()*btScalar(0.01));
+				}
+				tri1[k].buildTriPlane();
+				batch.setPair( k, tri0[k], tri1[k] );
+			}
+			int mask = batch.overlapTestConservative();
+			for (int k=0;k<BT_TRIANGLE_PAIR_BATCH_SIZE;k++)
+			{
+				bool overlap = tri0[k].overlap_test_conservative( tri1[k] );
+				bool accepted = (mask & (1<<k)) != 0;
+				//never rejects a pair the scalar test accepts
+				CPPUNIT_ASSERT( accepted || !overlap );
+				if (accepted)
+					numAccepted++;
+				//the tolerance only matters for the pairs close to touching
+				if (accepted && !overlap && t%3 == 0)
+					numExtra++;
+			}
+		}
+		CPPUNIT_ASSERT( numAccepted > NUM_BATCH_TESTS/10 );
+		CPPUNIT_ASSERT( numAccepted < NUM_BATCH_TESTS );
+		CPPUNIT_ASSERT( numExtra < NUM_BATCH_TESTS/300 );
+	}
+
+	void testContactsMatchSerialLoop()
+	{
+		Mesh mesh0( 0 ), mesh1( btScalar(1.3) );
+		btTransform trans0( btQuaternion( btVector3( 0, 1, 0 ), btScalar(0.3) ), btVector3( btScalar(0.2), 0, btScalar(0.1) ) );
+		btTransform trans1( btQuaternion( btVector3( 1, 0, 0 ), btScalar(0.05) ), btVector3( btScalar(1.5), btScalar(0.1), btScalar(-2.) ) );
+
+		checkContacts( mesh0, trans0, mesh1, trans1 );
+
+		TestThreadPool threads;
+		if (threads.skipWithoutThreads( "TestGImpactTrimesh::testContactsMatchSerialLoop" ))
+			return;
+		checkContacts( mesh0, trans0, mesh1, trans1 );
+
+		//deformed meshes refit their trees
+		mesh0.deform( btScalar(0.5) );
+		mesh1.deform( btScalar(2.) );
+		mesh0.mShape->updateBound();
+		mesh1.mShape->updateBound();
+		checkContacts( mesh0, trans0, mesh1, trans1 );
+	}
+
+	void testParallelRefit()
+	{
+		Mesh mesh( 0 );
+		btGImpactMeshShapePart* part = mesh.mShape->getMeshPart( 0 );
+		btPrimitiveManagerBase* manager = const_cast<btPrimitiveManagerBase*>( part->getPrimitiveManager() );
+		part->lockChildShapes();
+		RefitBvh parallel, serial;
+		parallel.setPrimitiveManager( manager );
+		serial.setPrimitiveManager( manager );
+		parallel.buildSet();
+		serial.buildSet();
+		part->unlockChildShapes();
+		CPPUNIT_ASSERT( parallel.getNodeCount() > 8*GIM_QUANTIZED_BVH_REFIT_SUBTREE_NODES );
+
+		mesh.deform( btScalar(0.7) );
+		TestThreadPool threads;
+		if (threads.skipWithoutThreads( "TestGImpactTrimesh::testParallelRefit" ))
+			return;
+		part->lockChildShapes();
+		parallel.update();
+		serial.refitSerial();
+		part->unlockChildShapes();
+
+		for (int i=0;i<serial.getNodeCount();i++)
+		{
+			const BT_QUANTIZED_BVH_NODE* a = serial.get_node_pointer( i );
+			const BT_QUANTIZED_BVH_NODE* b = parallel.get_node_pointer( i );
+			CPPUNIT_ASSERT_EQUAL( a->m_escapeIndexOrDataIndex, b->m_escapeIndexOrDataIndex );
+			for (int axis=0;axis<3;axis++)
+			{
+				CPPUNIT_ASSERT_EQUAL( a->m_quantizedAabbMin[axis], b->m_quantizedAabbMin[axis] );
+				CPPUNIT_ASSERT_EQUAL( a->m_quantizedAabbMax[axis], b->m_quantizedAabbMax[axis] );
+			}
+		}
+
+		//the leaves match the deformed triangles
+		part->lockChildShapes();
+		for (int i=0;i<parallel.getNodeCount();i++)
+		{
+			if (!parallel.isLeafNode( i ))
+				continue;
+			btAABB expected, bound;
+			manager->get_primitive_box( parallel.getNodeData( i ), expected );
+			parallel.getNodeBound( i, bound );
+			CPPUNIT_ASSERT( (bound.m_min-expected.m_min).length2() < btScalar(1e-4) );
+			CPPUNIT_ASSERT( (bound.m_max-expected.m_max).length2() < btScalar(1e-4) );
+		}
+		part->unlockChildShapes();
+	}
+
+	CPPUNIT_TEST_SUITE(TestGImpactTrimesh);
+	CPPUNIT_TEST(testBatchCulling);
+	CPPUNIT_TEST(testContactsMatchSerialLoop);
+	CPPUNIT_TEST(testParallelRefit);
+	CPPUNIT_TEST_SUITE_END();
+};
+
+#endif
@@ -0,0 +1,281 @@
+#ifndef TESTHEIGHTFIELDRAYCAST_HAS_BEEN_INCLUDED
+#define TESTHEIGHTFIELDRAYCAST_HAS_BEEN_INCLUDED
+
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+#include "TestSupport.h"
+
+#include "btBulletCollisionCommon.h"
+#include "BulletCollision/CollisionShapes/btHeightfieldTerrainShape.h"
+#include "BulletCollision/CollisionShapes/btTiledHeightfieldTerrainShape.h"
+#include "BulletCollision/NarrowPhaseCollision/btRaycastCallback.h"
+
+// ---------------------------------------------------------------------------
+
+class TestHeightfieldRaycast : public TestRandomFixture
+{
+	enum
+	{
+		GRID_WIDTH = 65,
+		GRID_LENGTH = 48,
+		NUM_RAYS = 300,
+		NUM_CASTS = 60
+	};
+
+	btAlignedObjectArray<btScalar> mHeights;
+
+	struct ClosestHitCallback : public btTriangleRaycastCallback
+	{
+		ClosestHitCallback( const btVector3& from, const btVector3& to )
+			:btTriangleRaycastCallback( from, to )
+		{
+		}
+		virtual btScalar reportHit( const btVector3&, btScalar hitFraction, int, int )
+		{
+			return hitFraction;
+		}
+	};
+
+	struct ClosestCastCallback : public btTriangleConvexcastCallback
+	{
+		ClosestCastCallback( const btConvexShape* shape, const btTransform& from, const btTransform& to )
+			:btTriangleConvexcastCallback( shape, from, to, btTransform::getIdentity(), 0 )
+		{
+		}
+		virtual btScalar reportHit( const btVector3&, const btVector3&, btScalar hitFraction, int, int )
+		{
+			m_hitFraction = hitFraction;
+			return hitFraction;
+		}
+	};
+
+	static btScalar raycastReference( const btHeightfieldTerrainShape* shape, const btVector3& from, const btVector3& to )
+	{
+		ClosestHitCallback cb( from, to );
+		btVector3 aabbMin = from, aabbMax = from;
+		aabbMin.setMin( to );
+		aabbMax.setMax( to );
+		shape->processAllTriangles( &cb, aabbMin, aabbMax );
+		return cb.m_hitFraction;
+	}
+
+	static btScalar convexcastReference( const btHeightfieldTerrainShape* shape, const btConvexShape* castShape, const btVector3& from, const btVector3& to )
+	{
+		btTransform fromTrans( btQuaternion::getIdentity(), from );
+		btTransform toTrans( btQuaternion::getIdentity(), to );
+		ClosestCastCallback cb( castShape, fromTrans, toTrans );
+		btVector3 boxMin, boxMax;
+		castShape->getAabb( btTransform::getIdentity(), boxMin, boxMax );
+		btVector3 aabbMin = from, aabbMax = from;
+		aabbMin.setMin( to );
+		aabbMax.setMax( to );
+		shape->processAllTriangles( &cb, aabbMin+boxMin, aabbMax+boxMax );
+		return cb.m_hitFraction;
+	}
+
+	static btScalar convexcast( const btHeightfieldTerrainShape* shape, const btConvexShape* castShape, const btVector3& from, const btVector3& to )
+	{
+		btTransform fromTrans( btQuaternion::getIdentity(), from );
+		btTransform toTrans( btQuaternion::getIdentity(), to );
+		ClosestCastCallback cb( castShape, fromTrans, toTrans );
+		btVector3 boxMin, boxMax;
+		castShape->getAabb( btTransform::getIdentity(), boxMin, boxMax );
+		shape->performConvexcast( &cb, from, to, boxMin, boxMax );
+		return cb.m_hitFraction;
+	}
+
+	///a ray from above the terrain to below it, along the up axis or slanted, or a long ray across the terrain
+	void randomRay( const btVector3& aabbMin, const btVector3& aabbMax, int upAxis, int r, btVector3& from, btVector3& to )
+	{
+		btVector3 extent = aabbMax-aabbMin;
+		btVector3 center = (aabbMin+aabbMax)*btScalar(0.5);
+		from = center+randVector( btScalar(1.2) )*extent;
+		to = center+randVector( btScalar(1.2) )*extent;
+		from[upAxis] = aabbMax[upAxis]+btScalar(2.);
+		to[upAxis] = aabbMin[upAxis]-btScalar(2.);
+		if (r%3 == 1)
+		{
+			to = from+randVector( btScalar(0.2) )*extent;
+			to[upAxis] = aabbMin[upAxis]-btScalar(2.);
+		}
+		if (r%3 == 2)
+		{
+			to = from;
+			to[upAxis] = aabbMin[upAxis]-btScalar(2.);
+		}
+		if (r%7 == 0)
+			btSwap( from, to );
+	}
+
+public:
+
+	void setUp()
+	{
+		mSeed = 11;
+		mHeights.resize( GRID_WIDTH*GRID_LENGTH );
+		for (int j=0;j<GRID_LENGTH;j++)
+		{
+			for (int x=0;x<GRID_WIDTH;x++)
+			{
+				//ridges with noise and a deep pit
+				btScalar h = btScalar(8.)+btScalar(5.)*btSin( btScalar(x)*btScalar(0.3) )*btCos( btScalar(j)*btScalar(0.2) )+rand01()*btScalar(3.);
+				if (x > 40 && x < 46 && j > 10 && j < 16)
+					h = btScalar(-6.);
+				mHeights[j*GRID_WIDTH+x] = h;
+			}
+		}
+	}
+
+	void tearDown()
+	{
+	}
+
+	void testRaycastMatchesTriangles()
+	{
+		int numHits = 0;
+		for (int upAxis=0;upAxis<3;upAxis++)
+		{
+			for (int variant=0;variant<3;variant++)
+			{
+				btHeightfieldTerrainShape shape( GRID_WIDTH, GRID_LENGTH, &mHeights[0], 1, -10, 20, upAxis, PHY_FLOAT, variant == 1 );
+				shape.setUseDiamondSubdivision( variant == 2 );
+				shape.setLocalScaling( variant == 0 ? btVector3( 1, 1, 1 ) : btVector3( btScalar(1.5), btScalar(0.5), btScalar(2.) ) );
+				btVector3 aabbMin, aabbMax;
+				shape.getAabb( btTransform::getIdentity(), aabbMin, aabbMax );
+
+				for (int r=0;r<NUM_RAYS;r++)
+				{
+					btVector3 from, to;
+					randomRay( aabbMin, aabbMax, upAxis, r, from, to );
+					btScalar expected = raycastReference( &shape, from, to );
+
+					//all cells along the ray, a hit on an edge shared by two triangles can differ by rounding
+					ClosestHitCallback cb( from, to );
+					shape.performRaycast( &cb, from, to );
+					CPPUNIT_ASSERT_DOUBLES_EQUAL( expected, cb.m_hitFraction, 1e-5 );
+
+					//with the early-out at the closest hit
+					ClosestHitCallback closest( from, to );
+					shape.performRaycast( &closest, from, to, &closest.m_hitFraction );
+					CPPUNIT_ASSERT_EQUAL( cb.m_hitFraction, closest.m_hitFraction );
+					if (expected < btScalar(1.))
+						numHits++;
+				}
+			}
+		}
+		CPPUNIT_ASSERT( numHits > NUM_RAYS*9/2 );
+	}
+
+	void testConvexcastMatchesTriangles()
+	{
+		btBoxShape box( btVector3( btScalar(1.5), btScalar(0.5), btScalar(2.5) ) );
+		btSphereShape sphere( btScalar(0.8) );
+		int numHits = 0;
+		for (int upAxis=0;upAxis<3;upAxis++)
+		{
+			btHeightfieldTerrainShape shape( GRID_WIDTH, GRID_LENGTH, &mHeights[0], 1, -10, 20, upAxis, PHY_FLOAT, false );
+			shape.setLocalScaling( btVector3( btScalar(1.5), btScalar(0.5), btScalar(2.) ) );
+			btVector3 aabbMin, aabbMax;
+			shape.getAabb( btTransform::getIdentity(), aabbMin, aabbMax );
+			for (int c=0;c<NUM_CASTS;c++)
+			{
+				btVector3 from, to;
+				randomRay( aabbMin, aabbMax, upAxis, c, from, to );
+				const btConvexShape* castShape = c%2 ? (const btConvexShape*)&box : (const btConvexShape*)&sphere;
+				btScalar expected = convexcastReference( &shape, castShape, from, to );
+				CPPUNIT_ASSERT_DOUBLES_EQUAL( expected, convexcast( &shape, castShape, from, to ), 1e-3 );
+				if (expected < btScalar(1.))
+					numHits++;
+			}
+		}
+		CPPUNIT_ASSERT( numHits > NUM_CASTS*3/2 );
+
+		//the tiled shape visits the tiles the box touches
+		struct Provider : public btHeightfieldTileProvider
+		{
+			const btAlignedObjectArray<btScalar>* mHeights;
+			virtual bool loadTile( int tileX, int tileY, int tileSize, btScalar* heights )
+			{
+				for (int y=0;y<=tileSize;y++)
+				{
+					for (int x=0;x<=tileSize;x++)
+					{
+						int gx = tileX*tileSize+x;
+						int gy = tileY*tileSize+y;
+						if (gx < GRID_WIDTH && gy < GRID_LENGTH)
+							heights[y*(tileSize+1)+x] = (*mHeights)[gy*GRID_WIDTH+gx];
+					}
+				}
+				return true;
+			}
+		};
+		Provider provider;
+		provider.mHeights = &mHeights;
+		btHeightfieldTerrainShape reference( GRID_WIDTH, GRID_LENGTH, &mHeights[0], 1, -10, 20, 1, PHY_FLOAT, false );
+		btTiledHeightfieldTerrainShape tiled( GRID_WIDTH, GRID_LENGTH, 8, &provider, -10, 20, 1, false );
+		btVector3 aabbMin, aabbMax;
+		reference.getAabb( btTransform::getIdentity(), aabbMin, aabbMax );
+		for (int c=0;c<NUM_CASTS;c++)
+		{
+			btVector3 from, to;
+			randomRay( aabbMin, aabbMax, 1, c, from, to );
+			const btConvexShape* castShape = c%2 ? (const btConvexShape*)&box : (const btConvexShape*)&sphere;
+			CPPUNIT_ASSERT_DOUBLES_EQUAL( convexcastReference( &reference, castShape, from, to ), convexcast( &tiled, castShape, from, to ), 1e-3 );
+
+			ClosestHitCallback cb( from, to );
+			tiled.performRaycast( &cb, from, to, &cb.m_hitFraction );
+			CPPUNIT_ASSERT_EQUAL( raycastReference( &reference, from, to ), cb.m_hitFraction );
+		}
+	}
+
+	void testCollisionWorldQueries()
+	{
+		btDefaultCollisionConfiguration config;
+		btCollisionDispatcher dispatcher( &config );
+		btDbvtBroadphase broadphase;
+		btCollisionWorld world( &dispatcher, &broadphase, &config );
+
+		btHeightfieldTerrainShape shape( GRID_WIDTH, GRID_LENGTH, &mHeights[0], 1, -10, 20, 1, PHY_FLOAT, true );
+		shape.setLocalScaling( btVector3( 2, 1, 2 ) );
+		btTransform trans( btQuaternion( btVector3( 0, 1, 0 ), btScalar(0.4) ), btVector3( 5, -3, 7 ) );
+		btCollisionObject object;
+		object.setCollisionShape( &shape );
+		object.setWorldTransform( trans );
+		world.addCollisionObject( &object );
+		world.updateAabbs();
+
+		btVector3 aabbMin, aabbMax;
+		shape.getAabb( btTransform::getIdentity(), aabbMin, aabbMax );
+		btSphereShape sphere( btScalar(1.) );
+		int numHits = 0;
+		for (int r=0;r<NUM_CASTS;r++)
+		{
+			btVector3 from, to;
+			randomRay( aabbMin, aabbMax, 1, r, from, to );
+
+			btCollisionWorld::ClosestRayResultCallback rayResult( trans*from, trans*to );
+			world.rayTest( trans*from, trans*to, rayResult );
+			btScalar expected = raycastReference( &shape, from, to );
+			CPPUNIT_ASSERT_DOUBLES_EQUAL( expected, rayResult.m_closestHitFraction, 1e-4 );
+			CPPUNIT_ASSERT_EQUAL( expected < btScalar(1.), rayResult.hasHit() );
+			if (rayResult.hasHit())
+				numHits++;
+
+			btTransform fromTrans( btQuaternion::getIdentity(), trans*from );
+			btTransform toTrans( btQuaternion::getIdentity(), trans*to );
+			btCollisionWorld::ClosestConvexResultCallback castResult( fromTrans.getOrigin(), toTrans.getOrigin() );
+			world.convexSweepTest( &sphere, fromTrans, toTrans, castResult );
+			CPPUNIT_ASSERT_DOUBLES_EQUAL( convexcastReference( &shape, &sphere, from, to ), castResult.m_closestHitFraction, 1e-3 );
+		}
+		CPPUNIT_ASSERT( numHits > NUM_CASTS/2 );
+		world.removeCollisionObject( &object );
+	}
+
+	CPPUNIT_TEST_SUITE(TestHeightfieldRaycast);
+	CPPUNIT_TEST(testRaycastMatchesTriangles);
+	CPPUNIT_TEST(testConvexcastMatchesTriangles);
+	CPPUNIT_TEST(testCollisionWorldQueries);
+	CPPUNIT_TEST_SUITE_END();
+};
+
+#endif
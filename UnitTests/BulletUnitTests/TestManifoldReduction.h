@@ -0,0 +1,307 @@
+#ifndef TESTMANIFOLDREDUCTION_HAS_BEEN_INCLUDED
+#define TESTMANIFOLDREDUCTION_HAS_BEEN_INCLUDED
+
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+#include "TestSupport.h"
+
+#include "btBulletDynamicsCommon.h"
+#include "BulletCollision/NarrowPhaseCollision/btManifoldReduction.h"
+#include "BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h"
+#include "BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h"
+#include "LinearMath/btThreads.h"
+
+#include <string.h>
+
+// ---------------------------------------------------------------------------
+
+class TestManifoldReduction : public CppUnit::TestFixture
+{
+	enum
+	{
+		NUM_PLATES = 6,
+		NUM_STEPS = 120
+	};
+
+	///add a point between (body0,body1), flipped when the manifold is between (body1,body0)
+	static void addPoint( btPersistentManifold& manifold, const btCollisionObject* body0, const btVector3& positionOnB, btScalar distance )
+	{
+		btVector3 normal( 0, 1, 0 );
+		btVector3 positionOnA = positionOnB + normal*distance;
+		if (manifold.getBody0() == body0)
+		{
+			btManifoldPoint pt( positionOnA, positionOnB, normal, distance );
+			pt.m_positionWorldOnA = positionOnA;
+			pt.m_positionWorldOnB = positionOnB;
+			manifold.addManifoldPoint( pt );
+		} else
+		{
+			btManifoldPoint pt( positionOnB, positionOnA, -normal, distance );
+			pt.m_positionWorldOnA = positionOnB;
+			pt.m_positionWorldOnB = positionOnA;
+			manifold.addManifoldPoint( pt );
+		}
+	}
+
+	///a 3x3 grid of boxes on the ground, with or without manifold reduction
+	static void runPlates( bool useMt, bool useManifoldReduction, btAlignedObjectArray<btTransform>& result, int& numReducedPairs, int& maxReducedPoints, int& maxManifoldsPerPair )
+	{
+		btDefaultCollisionConfiguration collisionConfig;
+		btCollisionDispatcher* dispatcher = useMt ? new btCollisionDispatcherMt( &collisionConfig, 4 ) : new btCollisionDispatcher( &collisionConfig );
+		btDbvtBroadphase broadphase;
+		btSequentialImpulseConstraintSolver solver;
+		btDiscreteDynamicsWorld* world = useMt ?
+			new btDiscreteDynamicsWorldMt( dispatcher, &broadphase, 0, &collisionConfig ) :
+			new btDiscreteDynamicsWorld( dispatcher, &broadphase, &solver, &collisionConfig );
+		world->setGravity( btVector3( 0, -10, 0 ));
+		world->getSolverInfo().m_minimumSolverBatchSize = 1;
+		world->setUseManifoldReduction( useManifoldReduction );
+		CPPUNIT_ASSERT_EQUAL( useManifoldReduction, world->getManifoldReduction() != 0 );
+
+		btBoxShape groundShape( btVector3( 50, 1, 50 ) );
+		btBoxShape tileShape( btVector3( btScalar(0.5), btScalar(0.1), btScalar(0.5) ) );
+		btCompoundShape plateShape;
+		for (int x=0;x<3;x++)
+		{
+			for (int z=0;z<3;z++)
+			{
+				btTransform child;
+				child.setIdentity();
+				child.setOrigin( btVector3( btScalar(x-1), 0, btScalar(z-1) ) );
+				plateShape.addChildShape( child, &tileShape );
+			}
+		}
+
+		btAlignedObjectArray<btRigidBody*> bodies;
+		for (int i=0;i<NUM_PLATES+1;i++)
+		{
+			bool ground = (i==0);
+			btScalar mass = ground ? 0 : 1;
+			btVector3 inertia( 0, 0, 0 );
+			btTransform tr;
+			tr.setIdentity();
+			if (ground)
+			{
+				tr.setOrigin( btVector3( 0, -1, 0 ) );
+			} else
+			{
+				tr.setOrigin( btVector3( btScalar(i)*5-15, btScalar(0.3), 0 ) );
+				tr.setRotation( btQuaternion( btVector3( 1, 0, btScalar(i) ).normalized(), btScalar(0.05) ) );
+				plateShape.calculateLocalInertia( mass, inertia );
+			}
+			btRigidBody::btRigidBodyConstructionInfo info( mass, 0, ground ? (btCollisionShape*)&groundShape : (btCollisionShape*)&plateShape, inertia );
+			info.m_startWorldTransform = tr;
+			btRigidBody* body = new btRigidBody( info );
+			world->addRigidBody( body );
+			bodies.push_back( body );
+		}
+
+		for (int i=0;i<NUM_STEPS;i++)
+			world->stepSimulation( btScalar(1.)/btScalar(60.), 0 );
+
+		numReducedPairs = 0;
+		maxReducedPoints = 0;
+		if (world->getManifoldReduction())
+		{
+			btManifoldReduction* reduction = world->getManifoldReduction();
+			numReducedPairs = reduction->getNumReducedPairs();
+			for (int i=0;i<numReducedPairs;i++)
+				maxReducedPoints = btMax( maxReducedPoints, reduction->getReducedManifold(i)->getNumContacts() );
+		}
+		//the narrowphase manifolds between the plate and the ground
+		maxManifoldsPerPair = 0;
+		for (int i=1;i<bodies.size();i++)
+		{
+			int numManifolds = 0;
+			for (int m=0;m<dispatcher->getNumManifolds();m++)
+			{
+				btPersistentManifold* manifold = dispatcher->getManifoldByIndexInternal( m );
+				if (manifold->getNumContacts() && (manifold->getBody0() == bodies[i] || manifold->getBody1() == bodies[i]))
+					numManifolds++;
+			}
+			maxManifoldsPerPair = btMax( maxManifoldsPerPair, numManifolds );
+		}
+
+		result.resize( bodies.size() );
+		for (int i=0;i<bodies.size();i++)
+			result[i] = bodies[i]->getWorldTransform();
+
+		if (world->getManifoldReduction() && numReducedPairs)
+		{
+			//removing the broadphase pairs of a plate releases its manifolds, and its reduced pair with them
+			btManifoldReduction* reduction = world->getManifoldReduction();
+			broadphase.getOverlappingPairCache()->removeOverlappingPairsContainingProxy( bodies[1]->getBroadphaseHandle(), dispatcher );
+			CPPUNIT_ASSERT_EQUAL( numReducedPairs-1, reduction->getNumReducedPairs() );
+			//and so does removing an object
+			world->removeRigidBody( bodies[2] );
+			CPPUNIT_ASSERT_EQUAL( numReducedPairs-2, reduction->getNumReducedPairs() );
+			world->removeRigidBody( bodies[0] );
+			CPPUNIT_ASSERT_EQUAL( 0, reduction->getNumReducedPairs() );
+		}
+		for (int i=0;i<bodies.size();i++)
+		{
+			if (bodies[i]->isInWorld())
+				world->removeRigidBody( bodies[i] );
+			delete bodies[i];
+		}
+		delete world;
+		delete dispatcher;
+	}
+
+public:
+
+	void setUp()
+	{
+	}
+
+	void tearDown()
+	{
+		btSetTaskScheduler( 0 );
+	}
+
+	void testReducePair()
+	{
+		btCollisionObject a, b, c;
+		btPersistentManifold ab( &a, &b, 0, btScalar(0.02), btScalar(0.) );
+		btPersistentManifold ba( &b, &a, 0, btScalar(0.02), btScalar(0.02) );
+		btPersistentManifold ac( &a, &c, 0, btScalar(0.02), btScalar(0.02) );
+
+		addPoint( ab, &a, btVector3( -1, 0, -1 ), btScalar(-0.01) );
+		addPoint( ab, &a, btVector3( 1, 0, -1 ), btScalar(-0.02) );
+		addPoint( ab, &a, btVector3( 0, 0, 0 ), btScalar(-0.05) );
+		addPoint( ba, &a, btVector3( 1, 0, 1 ), btScalar(-0.01) );
+		addPoint( ba, &a, btVector3( -1, 0, 1 ), btScalar(-0.015) );
+		//merged with the point at (1,0,1), and deeper
+		addPoint( ba, &a, btVector3( btScalar(1.005), 0, 1 ), btScalar(-0.03) );
+		addPoint( ac, &a, btVector3( 5, 0, 0 ), btScalar(-0.01) );
+		addPoint( ac, &a, btVector3( 6, 0, 0 ), btScalar(-0.01) );
+		//beyond the processing threshold
+		addPoint( ab, &a, btVector3( 0, 0, -1 ), btScalar(0.01) );
+
+		btManifoldReduction reduction;
+		reduction.setMaxPoints( 100 );
+		CPPUNIT_ASSERT_EQUAL( int(MANIFOLD_CACHE_SIZE), reduction.getMaxPoints() );
+		reduction.setMaxPoints( 4 );
+
+		btPersistentManifold* manifolds[3] = { &ab, &ba, &ac };
+		reduction.reduceManifolds( manifolds, 3 );
+		CPPUNIT_ASSERT_EQUAL( 1, reduction.getNumReducedPairs() );
+		btPersistentManifold* reduced = reduction.getReducedManifold( 0 );
+		CPPUNIT_ASSERT( reduced->getBody0() == &a );
+		CPPUNIT_ASSERT( reduced->getBody1() == &b );
+		CPPUNIT_ASSERT_EQUAL( 4, reduced->getNumContacts() );
+
+		//the deepest point comes first, the other points are the corners that are farthest apart
+		CPPUNIT_ASSERT_EQUAL( btScalar(-0.05), reduced->getContactPoint(0).getDistance() );
+		bool hasMergedPoint = false;
+		for (int i=0;i<reduced->getNumContacts();i++)
+		{
+			const btManifoldPoint& pt = reduced->getContactPoint(i);
+			CPPUNIT_ASSERT( pt.m_normalWorldOnB.dot( btVector3( 0, 1, 0 ) ) > btScalar(0.99) );
+			CPPUNIT_ASSERT( pt.m_positionWorldOnA.getY() < pt.m_positionWorldOnB.getY() );
+			CPPUNIT_ASSERT( pt.getDistance() < 0 );
+			hasMergedPoint = hasMergedPoint || pt.getDistance() == btScalar(-0.03);
+			CPPUNIT_ASSERT( pt.getDistance() != btScalar(-0.01) || pt.m_positionWorldOnB.getZ() != 1 );
+			for (int j=0;j<i;j++)
+				CPPUNIT_ASSERT( (pt.m_positionWorldOnB-reduced->getContactPoint(j).m_positionWorldOnB).length() > btScalar(1.) );
+		}
+		CPPUNIT_ASSERT( hasMergedPoint );
+
+		//the reduced manifold takes the place of the first manifold of the pair
+		btAlignedObjectArray<btPersistentManifold*> substituted;
+		reduction.substituteManifolds( manifolds, 3, substituted );
+		CPPUNIT_ASSERT_EQUAL( 2, substituted.size() );
+		CPPUNIT_ASSERT( substituted[0] == reduced );
+		CPPUNIT_ASSERT( substituted[1] == &ac );
+		btPersistentManifold* reversed[3] = { &ac, &ba, &ab };
+		substituted.resize( 0 );
+		reduction.substituteManifolds( reversed, 3, substituted );
+		CPPUNIT_ASSERT_EQUAL( 2, substituted.size() );
+		CPPUNIT_ASSERT( substituted[0] == &ac );
+		CPPUNIT_ASSERT( substituted[1] == reduced );
+
+		//warm starting: the impulses stay with the points in the next frame
+		for (int i=0;i<reduced->getNumContacts();i++)
+		{
+			reduced->getContactPoint(i).m_appliedImpulse = btScalar(i+1);
+			reduced->getContactPoint(i).m_appliedImpulseLateral1 = btScalar(i+10);
+		}
+		reduction.reduceManifolds( manifolds, 3 );
+		CPPUNIT_ASSERT_EQUAL( 1, reduction.getNumReducedPairs() );
+		CPPUNIT_ASSERT( reduction.getReducedManifold( 0 ) == reduced );
+		for (int i=0;i<reduced->getNumContacts();i++)
+		{
+			CPPUNIT_ASSERT_EQUAL( btScalar(i+1), reduced->getContactPoint(i).m_appliedImpulse );
+			CPPUNIT_ASSERT_EQUAL( btScalar(i+10), reduced->getContactPoint(i).m_appliedImpulseLateral1 );
+			CPPUNIT_ASSERT_EQUAL( 1, reduced->getContactPoint(i).getLifeTime() );
+		}
+		//the narrowphase manifolds are unchanged
+		CPPUNIT_ASSERT_EQUAL( btScalar(0.), ab.getContactPoint(0).m_appliedImpulse );
+		CPPUNIT_ASSERT_EQUAL( 4, ab.getNumContacts() );
+
+		//once the pair has a single manifold it is not reduced anymore
+		ba.clearManifold();
+		reduction.reduceManifolds( manifolds, 3 );
+		CPPUNIT_ASSERT_EQUAL( 0, reduction.getNumReducedPairs() );
+		substituted.resize( 0 );
+		reduction.substituteManifolds( manifolds, 3, substituted );
+		CPPUNIT_ASSERT_EQUAL( 3, substituted.size() );
+
+		//the dispatcher reports released manifolds, the pair goes with the last of its manifolds
+		addPoint( ba, &a, btVector3( 1, 0, 1 ), btScalar(-0.01) );
+		reduction.reduceManifolds( manifolds, 3 );
+		CPPUNIT_ASSERT_EQUAL( 1, reduction.getNumReducedPairs() );
+		reduction.removeManifold( &ba );
+		reduction.removeManifold( &ac );
+		CPPUNIT_ASSERT_EQUAL( 1, reduction.getNumReducedPairs() );
+		reduction.removeManifold( &ab );
+		CPPUNIT_ASSERT_EQUAL( 0, reduction.getNumReducedPairs() );
+	}
+
+	void testCompoundPlates()
+	{
+		btAlignedObjectArray<btTransform> full, reduced;
+		int numReducedPairs, maxReducedPoints, maxManifoldsPerPair;
+		runPlates( false, false, full, numReducedPairs, maxReducedPoints, maxManifoldsPerPair );
+		CPPUNIT_ASSERT_EQUAL( 0, numReducedPairs );
+		runPlates( false, true, reduced, numReducedPairs, maxReducedPoints, maxManifoldsPerPair );
+
+		//every plate lies on the ground with several child manifolds, the solver got one manifold of at most 4 points
+		CPPUNIT_ASSERT_EQUAL( int(NUM_PLATES), numReducedPairs );
+		CPPUNIT_ASSERT( maxManifoldsPerPair > 1 );
+		CPPUNIT_ASSERT( maxReducedPoints >= 3 && maxReducedPoints <= 4 );
+		for (int i=1;i<reduced.size();i++)
+		{
+			CPPUNIT_ASSERT( btFabs( reduced[i].getOrigin().getY()-full[i].getOrigin().getY() ) < btScalar(0.02) );
+			CPPUNIT_ASSERT( btFabs( reduced[i].getBasis().getColumn(1).getY() ) > btScalar(0.999) );
+		}
+	}
+
+	void testMtDeterminism()
+	{
+		btAlignedObjectArray<btTransform> sequentialResult, parallelResult;
+		int numReducedPairs, maxReducedPoints, maxManifoldsPerPair;
+		btSetTaskScheduler( btGetSequentialTaskScheduler() );
+		runPlates( true, true, sequentialResult, numReducedPairs, maxReducedPoints, maxManifoldsPerPair );
+		CPPUNIT_ASSERT_EQUAL( int(NUM_PLATES), numReducedPairs );
+
+		TestThreadPool threads;
+		if (threads.skipWithoutThreads( "TestManifoldReduction::testMtDeterminism" ))
+			return;
+		runPlates( true, true, parallelResult, numReducedPairs, maxReducedPoints, maxManifoldsPerPair );
+
+		CPPUNIT_ASSERT_EQUAL( sequentialResult.size(), parallelResult.size() );
+		for (int i=0;i<sequentialResult.size();i++)
+		{
+			CPPUNIT_ASSERT( memcmp( &sequentialResult[i], &parallelResult[i], sizeof(btTransform) ) == 0 );
+		}
+	}
+
+	CPPUNIT_TEST_SUITE(TestManifoldReduction);
+	CPPUNIT_TEST(testReducePair);
+	CPPUNIT_TEST(testCompoundPlates);
+	CPPUNIT_TEST(testMtDeterminism);
+	CPPUNIT_TEST_SUITE_END();
+};
+
+#endif
@@ -0,0 +1,50 @@
+//The MiniCL kernels of TestMiniCL.h, cl_MiniCL_Defs.h defines macros that don't mix with the other tests
+
+#include "MiniCL/cl_MiniCL_Defs.h"
+
+__kernel void TestMiniCLSaxpy(float a, __global const float* x, __global float* y GUID_ARG)
+{
+	int i = get_global_id(0);
+	y[i] = a*x[i]+y[i];
+}
+
+MINICL_REGISTER(TestMiniCLSaxpy)
+
+//registered without a range launcher, like the kernels of older MiniCL programs
+__kernel void TestMiniCLSquare(__global int* data GUID_ARG)
+{
+	int i = get_global_id(0);
+	data[i] *= data[i];
+}
+
+static MiniCLKernelDesc TestMiniCLSquareDesc((void*)TestMiniCLSquare, "TestMiniCLSquare");
+
+//a work group shares its values through __local memory, like the batches of the SIMD-aware soft body kernels:
+//reversed gets the values of the group in reverse order, and groupSum the sum of the values of the group
+__kernel void TestMiniCLGroupSum(__global const int* values, __global int* groupIds, __global int* reversed, __global int* groupSum, __local int* scratch GUID_ARG)
+{
+	MINICL_BARRIER_BEGIN
+	{
+		groupIds[get_global_id(0)] = get_group_id(0);
+		scratch[get_local_id(0)] = values[get_global_id(0)];
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+	{
+		int localSize = get_local_size(0);
+		reversed[get_global_id(0)] = scratch[localSize-1-get_local_id(0)];
+		if (get_local_id(0) == 0)
+		{
+			int sum = 0;
+			for (int i=0;i<localSize;i++)
+				sum += scratch[i];
+			scratch[localSize] = sum;
+		}
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+	{
+		groupSum[get_global_id(0)] = scratch[get_local_size(0)];
+	}
+	MINICL_BARRIER_END
+}
+
+MINICL_REGISTER(TestMiniCLGroupSum)
@@ -0,0 +1,196 @@
+#ifndef TESTMINICL_HAS_BEEN_INCLUDED
+#define TESTMINICL_HAS_BEEN_INCLUDED
+
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+#include "TestSupport.h"
+
+#include "MiniCL/cl.h"
+#include "MiniCL/MiniCLTaskScheduler.h"
+#include "LinearMath/btAlignedObjectArray.h"
+#include "LinearMath/btThreads.h"
+
+// ---------------------------------------------------------------------------
+
+class TestMiniCL : public CppUnit::TestFixture
+{
+	enum
+	{
+		NUM_WORK_ITEMS = 1001,
+		NUM_GROUP_WORK_ITEMS = 1024
+	};
+
+	///runs the kernels of TestMiniCL.cpp on the context and checks the results
+	static void runKernels( cl_context context, const size_t* localWorkSize )
+	{
+		cl_int err = 0;
+		cl_command_queue queue = clCreateCommandQueue( context, 0, 0, &err );
+		cl_program program = clCreateProgramWithSource( context, 0, 0, 0, &err );
+
+		btAlignedObjectArray<float> x, y;
+		btAlignedObjectArray<int> data;
+		for (int i=0;i<NUM_WORK_ITEMS;i++)
+		{
+			x.push_back( float(i)*0.5f );
+			y.push_back( 1000.f-float(i) );
+			data.push_back( i-500 );
+		}
+		cl_mem xBuffer = clCreateBuffer( context, CL_MEM_READ_ONLY|CL_MEM_COPY_HOST_PTR, sizeof(float)*NUM_WORK_ITEMS, &x[0], &err );
+		cl_mem yBuffer = clCreateBuffer( context, CL_MEM_READ_WRITE|CL_MEM_COPY_HOST_PTR, sizeof(float)*NUM_WORK_ITEMS, &y[0], &err );
+		cl_mem dataBuffer = clCreateBuffer( context, CL_MEM_READ_WRITE|CL_MEM_COPY_HOST_PTR, sizeof(int)*NUM_WORK_ITEMS, &data[0], &err );
+
+		//a float argument is passed by value, not as a pointer sized integer
+		cl_kernel saxpy = clCreateKernel( program, "TestMiniCLSaxpy", &err );
+		CPPUNIT_ASSERT_EQUAL( CL_SUCCESS, err );
+		float a = 3.f;
+		clSetKernelArg( saxpy, 0, sizeof(float), &a );
+		clSetKernelArg( saxpy, 1, sizeof(cl_mem), &xBuffer );
+		clSetKernelArg( saxpy, 2, sizeof(cl_mem), &yBuffer );
+		size_t globalWorkSize = NUM_WORK_ITEMS;
+		clEnqueueNDRangeKernel( queue, saxpy, 1, 0, &globalWorkSize, localWorkSize, 0, 0, 0 );
+		//the kernels run in order
+		clEnqueueNDRangeKernel( queue, saxpy, 1, 0, &globalWorkSize, localWorkSize, 0, 0, 0 );
+
+		cl_kernel square = clCreateKernel( program, "TestMiniCLSquare", &err );
+		CPPUNIT_ASSERT_EQUAL( CL_SUCCESS, err );
+		clSetKernelArg( square, 0, sizeof(cl_mem), &dataBuffer );
+		clEnqueueNDRangeKernel( queue, square, 1, 0, &globalWorkSize, localWorkSize, 0, 0, 0 );
+
+		btAlignedObjectArray<float> result;
+		btAlignedObjectArray<int> squares;
+		result.resize( NUM_WORK_ITEMS );
+		squares.resize( NUM_WORK_ITEMS );
+		clEnqueueReadBuffer( queue, yBuffer, CL_TRUE, 0, sizeof(float)*NUM_WORK_ITEMS, &result[0], 0, 0, 0 );
+		clEnqueueReadBuffer( queue, dataBuffer, CL_TRUE, 0, sizeof(int)*NUM_WORK_ITEMS, &squares[0], 0, 0, 0 );
+		for (int i=0;i<NUM_WORK_ITEMS;i++)
+		{
+			float expected = a*x[i]+y[i];
+			expected = a*x[i]+expected;
+			CPPUNIT_ASSERT( btFabs( result[i]-expected ) <= btFabs( expected )*1e-6f );
+			CPPUNIT_ASSERT_EQUAL( (i-500)*(i-500), squares[i] );
+		}
+
+		clReleaseKernel( saxpy );
+		clReleaseKernel( square );
+		clReleaseMemObject( xBuffer );
+		clReleaseMemObject( yBuffer );
+		clReleaseMemObject( dataBuffer );
+		clReleaseProgram( program );
+		clReleaseCommandQueue( queue );
+	}
+
+	///runs TestMiniCLGroupSum, a kernel with __local memory and barriers, in work groups of localSize work items
+	static void runGroupKernel( cl_context context, int localSize )
+	{
+		cl_int err = 0;
+		cl_command_queue queue = clCreateCommandQueue( context, 0, 0, &err );
+		cl_program program = clCreateProgramWithSource( context, 0, 0, 0, &err );
+
+		btAlignedObjectArray<int> values;
+		for (int i=0;i<NUM_GROUP_WORK_ITEMS;i++)
+			values.push_back( (i*7919)%1000-500 );
+		size_t bufferSize = sizeof(int)*NUM_GROUP_WORK_ITEMS;
+		cl_mem valueBuffer = clCreateBuffer( context, CL_MEM_READ_ONLY|CL_MEM_COPY_HOST_PTR, bufferSize, &values[0], &err );
+		cl_mem groupIdBuffer = clCreateBuffer( context, CL_MEM_WRITE_ONLY, bufferSize, 0, &err );
+		cl_mem reversedBuffer = clCreateBuffer( context, CL_MEM_WRITE_ONLY, bufferSize, 0, &err );
+		cl_mem groupSumBuffer = clCreateBuffer( context, CL_MEM_WRITE_ONLY, bufferSize, 0, &err );
+
+		cl_kernel groupSum = clCreateKernel( program, "TestMiniCLGroupSum", &err );
+		CPPUNIT_ASSERT_EQUAL( CL_SUCCESS, err );
+		clSetKernelArg( groupSum, 0, sizeof(cl_mem), &valueBuffer );
+		clSetKernelArg( groupSum, 1, sizeof(cl_mem), &groupIdBuffer );
+		clSetKernelArg( groupSum, 2, sizeof(cl_mem), &reversedBuffer );
+		clSetKernelArg( groupSum, 3, sizeof(cl_mem), &groupSumBuffer );
+		//the values of a group and their sum
+		clSetKernelArg( groupSum, 4, sizeof(int)*(localSize+1), 0 );
+		size_t globalWorkSize = NUM_GROUP_WORK_ITEMS;
+		size_t localWorkSize = localSize;
+		clEnqueueNDRangeKernel( queue, groupSum, 1, 0, &globalWorkSize, &localWorkSize, 0, 0, 0 );
+
+		btAlignedObjectArray<int> groupIds, reversed, sums;
+		groupIds.resize( NUM_GROUP_WORK_ITEMS );
+		reversed.resize( NUM_GROUP_WORK_ITEMS );
+		sums.resize( NUM_GROUP_WORK_ITEMS );
+		clEnqueueReadBuffer( queue, groupIdBuffer, CL_TRUE, 0, bufferSize, &groupIds[0], 0, 0, 0 );
+		clEnqueueReadBuffer( queue, reversedBuffer, CL_TRUE, 0, bufferSize, &reversed[0], 0, 0, 0 );
+		clEnqueueReadBuffer( queue, groupSumBuffer, CL_TRUE, 0, bufferSize, &sums[0], 0, 0, 0 );
+		for (int first=0;first<NUM_GROUP_WORK_ITEMS;first+=localSize)
+		{
+			int sum = 0;
+			for (int i=0;i<localSize;i++)
+				sum += values[first+i];
+			for (int i=0;i<localSize;i++)
+			{
+				CPPUNIT_ASSERT_EQUAL( first/localSize, groupIds[first+i] );
+				CPPUNIT_ASSERT_EQUAL( values[first+localSize-1-i], reversed[first+i] );
+				CPPUNIT_ASSERT_EQUAL( sum, sums[first+i] );
+			}
+		}
+
+		clReleaseKernel( groupSum );
+		clReleaseMemObject( valueBuffer );
+		clReleaseMemObject( groupIdBuffer );
+		clReleaseMemObject( reversedBuffer );
+		clReleaseMemObject( groupSumBuffer );
+		clReleaseProgram( program );
+		clReleaseCommandQueue( queue );
+	}
+
+public:
+
+	void setUp()
+	{
+	}
+
+	void tearDown()
+	{
+		btSetTaskScheduler( 0 );
+	}
+
+	void testDebugDevice()
+	{
+		cl_int err = 0;
+		cl_context context = clCreateContextFromType( 0, CL_DEVICE_TYPE_DEBUG, 0, 0, &err );
+		CPPUNIT_ASSERT( ((MiniCLTaskScheduler*)context)->getThreadSupportInterface() );
+		runKernels( context, 0 );
+		runGroupKernel( context, 16 );
+		clReleaseContext( context );
+	}
+
+	void testTaskScheduler()
+	{
+		TestThreadPool threads;
+		if (threads.skipWithoutThreads( "TestMiniCL::testTaskScheduler" ))
+			return;
+
+		cl_int err = 0;
+		cl_context context = clCreateContextFromType( 0, CL_DEVICE_TYPE_ALL, 0, 0, &err );
+		//no threads of its own when a thread pool is installed, the kernels run on its threads
+		CPPUNIT_ASSERT( !((MiniCLTaskScheduler*)context)->getThreadSupportInterface() );
+		runKernels( context, 0 );
+		size_t localWorkSize = 16;
+		runKernels( context, &localWorkSize );
+		runGroupKernel( context, 16 );
+		runGroupKernel( context, 64 );
+		clReleaseContext( context );
+	}
+
+	void testNoTaskScheduler()
+	{
+		//without a task scheduler, MiniCL uses a btThreadSupportInterface
+		cl_int err = 0;
+		cl_context context = clCreateContextFromType( 0, CL_DEVICE_TYPE_ALL, 0, 0, &err );
+		CPPUNIT_ASSERT( ((MiniCLTaskScheduler*)context)->getThreadSupportInterface() );
+		runKernels( context, 0 );
+		runGroupKernel( context, 64 );
+		clReleaseContext( context );
+	}
+
+	CPPUNIT_TEST_SUITE(TestMiniCL);
+	CPPUNIT_TEST(testDebugDevice);
+	CPPUNIT_TEST(testTaskScheduler);
+	CPPUNIT_TEST(testNoTaskScheduler);
+	CPPUNIT_TEST_SUITE_END();
+};
+
+#endif
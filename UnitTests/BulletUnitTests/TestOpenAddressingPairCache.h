@@ -0,0 +1,212 @@
+#ifndef TESTOPENADDRESSINGPAIRCACHE_HAS_BEEN_INCLUDED
+#define TESTOPENADDRESSINGPAIRCACHE_HAS_BEEN_INCLUDED
+
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+#include "TestSupport.h"
+
+#include "btBulletCollisionCommon.h"
+#include "BulletCollision/BroadphaseCollision/btOpenAddressingPairCache.h"
+#include "LinearMath/btThreads.h"
+
+// ---------------------------------------------------------------------------
+
+class TestOpenAddressingPairCache : public TestRandomFixture
+{
+	enum
+	{
+		NUM_PROXIES = 300,
+		NUM_OPERATIONS = 20000,
+		NUM_CONCURRENT_PAIRS = 6000
+	};
+
+	btAlignedObjectArray<btBroadphaseProxy*> mProxies;
+
+	void checkSamePairs( btOverlappingPairCache& reference, btOpenAddressingPairCache& cache )
+	{
+		CPPUNIT_ASSERT_EQUAL( reference.getNumOverlappingPairs(), cache.getNumOverlappingPairs() );
+		const btBroadphasePairArray& pairs = reference.getOverlappingPairArray();
+		for (int i=0;i<pairs.size();i++)
+		{
+			btBroadphasePair* pair = cache.findPair( pairs[i].m_pProxy1, pairs[i].m_pProxy0 );
+			CPPUNIT_ASSERT( pair != 0 );
+			CPPUNIT_ASSERT( *pair == pairs[i] );
+		}
+	}
+
+	struct InsertLoop : public btIParallelForBody
+	{
+		btOpenAddressingPairCache* mCache;
+		const btAlignedObjectArray<btBroadphaseProxy*>* mPairs;
+
+		void forLoop( int iBegin, int iEnd ) const
+		{
+			for (int i=iBegin;i<iEnd;i++)
+			{
+				mCache->addOverlappingPairConcurrent( (*mPairs)[i*2], (*mPairs)[i*2+1] );
+			}
+		}
+	};
+
+	void insertConcurrent( btOpenAddressingPairCache& cache, btAlignedObjectArray<btBroadphaseProxy*>& pairs )
+	{
+		//every pair is added three times, some of them are already in the cache
+		mSeed = 777;
+		for (int i=0;i<NUM_PROXIES/2;i++)
+			cache.addOverlappingPair( mProxies[i], mProxies[i+1] );
+		for (int i=0;i<NUM_CONCURRENT_PAIRS;i++)
+		{
+			int a = randInt( NUM_PROXIES );
+			int b = (a+1+randInt( NUM_PROXIES-1 ))%NUM_PROXIES;
+			for (int j=0;j<3;j++)
+			{
+				pairs.push_back( mProxies[(j&1) ? a : b] );
+				pairs.push_back( mProxies[(j&1) ? b : a] );
+			}
+		}
+		InsertLoop loop;
+		loop.mCache = &cache;
+		loop.mPairs = &pairs;
+		cache.beginConcurrentInsert( pairs.size()/2 );
+		btParallelFor( 0, pairs.size()/2, 64, loop );
+		cache.endConcurrentInsert();
+	}
+
+public:
+
+	void setUp()
+	{
+		for (int i=0;i<NUM_PROXIES;i++)
+		{
+			btBroadphaseProxy* proxy = new btBroadphaseProxy( btVector3( 0, 0, 0 ), btVector3( 1, 1, 1 ), 0, 1, -1 );
+			proxy->m_uniqueId = i+2;
+			mProxies.push_back( proxy );
+		}
+	}
+
+	void tearDown()
+	{
+		btSetTaskScheduler( 0 );
+		for (int i=0;i<mProxies.size();i++)
+			delete mProxies[i];
+		mProxies.clear();
+	}
+
+	void testMatchesHashedPairCache()
+	{
+		btHashedOverlappingPairCache reference;
+		btOpenAddressingPairCache cache;
+		mSeed = 1234;
+		for (int i=0;i<NUM_OPERATIONS;i++)
+		{
+			//add more than remove, so the tables grow and have removed slots
+			btBroadphaseProxy* proxy0 = mProxies[randInt( NUM_PROXIES/4 )];
+			btBroadphaseProxy* proxy1 = mProxies[NUM_PROXIES/4+randInt( NUM_PROXIES*3/4 )];
+			if (randInt( 3 ))
+			{
+				btBroadphasePair* pair = cache.addOverlappingPair( proxy0, proxy1 );
+				CPPUNIT_ASSERT( pair != 0 );
+				CPPUNIT_ASSERT( *pair == *reference.addOverlappingPair( proxy0, proxy1 ) );
+			} else
+			{
+				reference.removeOverlappingPair( proxy1, proxy0, 0 );
+				cache.removeOverlappingPair( proxy1, proxy0, 0 );
+			}
+			CPPUNIT_ASSERT_EQUAL( reference.findPair( proxy0, proxy1 ) != 0, cache.findPair( proxy0, proxy1 ) != 0 );
+		}
+		checkSamePairs( reference, cache );
+
+		for (int i=0;i<NUM_PROXIES/8;i++)
+		{
+			reference.removeOverlappingPairsContainingProxy( mProxies[i], 0 );
+			cache.removeOverlappingPairsContainingProxy( mProxies[i], 0 );
+		}
+		checkSamePairs( reference, cache );
+
+		cache.sortOverlappingPairs( 0 );
+		checkSamePairs( reference, cache );
+	}
+
+	void testConcurrentInsert()
+	{
+		btAlignedObjectArray<btBroadphaseProxy*> pairs;
+
+		btOpenAddressingPairCache sequential;
+		insertConcurrent( sequential, pairs );
+
+		TestThreadPool threads;
+		if (threads.skipWithoutThreads( "TestOpenAddressingPairCache::testConcurrentInsert" ))
+			return;
+		btOpenAddressingPairCache parallel;
+		pairs.resize( 0 );
+		insertConcurrent( parallel, pairs );
+
+		//no duplicates, and the same pair array as with a single thread
+		btHashedOverlappingPairCache reference;
+		for (int i=0;i<NUM_PROXIES/2;i++)
+			reference.addOverlappingPair( mProxies[i], mProxies[i+1] );
+		for (int i=0;i<pairs.size();i+=2)
+			reference.addOverlappingPair( pairs[i], pairs[i+1] );
+		checkSamePairs( reference, parallel );
+		CPPUNIT_ASSERT_EQUAL( sequential.getNumOverlappingPairs(), parallel.getNumOverlappingPairs() );
+		for (int i=0;i<parallel.getNumOverlappingPairs();i++)
+		{
+			CPPUNIT_ASSERT( sequential.getOverlappingPairArray()[i] == parallel.getOverlappingPairArray()[i] );
+		}
+
+		//the table stays usable after the concurrent insertion
+		for (int i=0;i<pairs.size();i+=2)
+		{
+			reference.removeOverlappingPair( pairs[i], pairs[i+1], 0 );
+			parallel.removeOverlappingPair( pairs[i], pairs[i+1], 0 );
+		}
+		checkSamePairs( reference, parallel );
+	}
+
+	void testDbvtParallelCollide()
+	{
+		TestThreadPool threads;
+		if (threads.skipWithoutThreads( "TestOpenAddressingPairCache::testDbvtParallelCollide" ))
+			return;
+		btOpenAddressingPairCache* pairCache = new btOpenAddressingPairCache();
+		{
+			btDbvtBroadphase broadphase( pairCache );
+			broadphase.setParallelCollide( true );
+			btAlignedObjectArray<btBroadphaseProxy*> proxies;
+			mSeed = 99;
+			for (int i=0;i<1000;i++)
+			{
+				btVector3 center( rand01()*30, rand01()*30, rand01()*30 );
+				btVector3 extent( rand01()+0.3, rand01()+0.3, rand01()+0.3 );
+				proxies.push_back( broadphase.createProxy( center-extent, center+extent, BOX_SHAPE_PROXYTYPE, 0, 1, -1, 0, 0 ) );
+			}
+			for (int f=0;f<3;f++)
+				broadphase.calculateOverlappingPairs( 0 );
+
+			int numOverlaps = 0;
+			for (int i=0;i<proxies.size();i++)
+			{
+				for (int j=i+1;j<proxies.size();j++)
+				{
+					if (TestAabbAgainstAabb2( proxies[i]->m_aabbMin, proxies[i]->m_aabbMax, proxies[j]->m_aabbMin, proxies[j]->m_aabbMax ))
+					{
+						numOverlaps++;
+						CPPUNIT_ASSERT( pairCache->findPair( proxies[i], proxies[j] ) != 0 );
+					}
+				}
+			}
+			CPPUNIT_ASSERT_EQUAL( numOverlaps, pairCache->getNumOverlappingPairs() );
+			for (int i=0;i<proxies.size();i++)
+				broadphase.destroyProxy( proxies[i], 0 );
+		}
+		delete pairCache;
+	}
+
+	CPPUNIT_TEST_SUITE(TestOpenAddressingPairCache);
+	CPPUNIT_TEST(testMatchesHashedPairCache);
+	CPPUNIT_TEST(testConcurrentInsert);
+	CPPUNIT_TEST(testDbvtParallelCollide);
+	CPPUNIT_TEST_SUITE_END();
+};
+
+#endif
@@ -0,0 +1,296 @@
+#ifndef TESTPARALLELCONSTRAINTSOLVER_HAS_BEEN_INCLUDED
+#define TESTPARALLELCONSTRAINTSOLVER_HAS_BEEN_INCLUDED
+
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+#include "TestSupport.h"
+
+#include "btBulletDynamicsCommon.h"
+#include "BulletCollision/CollisionDispatch/btSimulationIslandManager.h"
+#include "BulletMultiThreaded/btParallelConstraintSolver.h"
+#include "LinearMath/btThreads.h"
+
+// ---------------------------------------------------------------------------
+
+class TestParallelConstraintSolver : public CppUnit::TestFixture
+{
+	///checks the phases before the rows are released
+	class CheckedSolver : public btParallelConstraintSolver
+	{
+	public:
+		int		mNumParallelPhases;
+		int		mMaxContactPhases;
+		int		mMaxParallelContactPhases;
+		bool	mPhasesValid;
+
+		CheckedSolver()
+			:mNumParallelPhases( 0 ),
+			mMaxContactPhases( 0 ),
+			mMaxParallelContactPhases( 0 ),
+			mPhasesValid( true )
+		{
+		}
+
+		void checkPhases( const btSolverPhases& phases, const btConstraintArray& rows )
+		{
+			btAlignedObjectArray<int> rowUsed;
+			rowUsed.resize( rows.size(), 0 );
+			btAlignedObjectArray<int> bodyPhase;
+			bodyPhase.resize( m_tmpSolverBodyPool.size(), -1 );
+			for (int phase=0;phase<phases.getNumPhases();phase++)
+			{
+				for (int g=phases.m_phaseStarts[phase];g<phases.m_phaseStarts[phase+1];g++)
+				{
+					const btSolverRowGroup& group = phases.m_groups[g];
+					for (int i=group.m_firstRow;i<group.m_firstRow+group.m_numRows;i++)
+					{
+						rowUsed[i]++;
+						if (rows[i].m_solverBodyIdA != rows[group.m_firstRow].m_solverBodyIdA || rows[i].m_solverBodyIdB != rows[group.m_firstRow].m_solverBodyIdB)
+							mPhasesValid = false;
+					}
+					if (phase >= phases.m_numParallelPhases)
+						continue;
+					//the groups of a parallel phase don't share a dynamic body
+					int ids[2] = { rows[group.m_firstRow].m_solverBodyIdA, rows[group.m_firstRow].m_solverBodyIdB };
+					for (int k=0;k<2;k++)
+					{
+						if (isSharedSolverBody( ids[k] ))
+							continue;
+						if (bodyPhase[ids[k]] == phase)
+							mPhasesValid = false;
+						bodyPhase[ids[k]] = phase;
+					}
+				}
+			}
+			for (int i=0;i<rows.size();i++)
+			{
+				if (rowUsed[i] != 1)
+					mPhasesValid = false;
+			}
+			mNumParallelPhases += phases.m_numParallelPhases;
+		}
+
+		virtual btScalar solveGroupCacheFriendlyFinish( btCollisionObject** bodies, int numBodies, const btContactSolverInfo& infoGlobal )
+		{
+			//a solveGroup without rows keeps the phases of the previous one
+			if (!m_tmpSolverContactConstraintPool.size() && !m_tmpSolverNonContactConstraintPool.size())
+				return btParallelConstraintSolver::solveGroupCacheFriendlyFinish( bodies, numBodies, infoGlobal );
+			checkPhases( m_contactPhases, m_tmpSolverContactConstraintPool );
+			checkPhases( m_frictionPhases, m_tmpSolverContactFrictionConstraintPool );
+			checkPhases( m_jointPhases, m_tmpSolverNonContactConstraintPool );
+			mMaxContactPhases = btMax( mMaxContactPhases, getContactPhases().getNumPhases() );
+			mMaxParallelContactPhases = btMax( mMaxParallelContactPhases, getContactPhases().m_numParallelPhases );
+			return btParallelConstraintSolver::solveGroupCacheFriendlyFinish( bodies, numBodies, infoGlobal );
+		}
+	};
+
+	///stacks of boxes on a static ground and on a kinematic slab, a bouncing ball and a chain of joints
+	struct Scene
+	{
+		btDefaultCollisionConfiguration	mCollisionConfig;
+		btCollisionDispatcher			mDispatcher;
+		btDbvtBroadphase				mBroadphase;
+		btDiscreteDynamicsWorld			mWorld;
+		btBoxShape						mGroundShape;
+		btBoxShape						mBoxShape;
+		btSphereShape					mBallShape;
+		btAlignedObjectArray<btRigidBody*>	mBodies;
+		btAlignedObjectArray<btRigidBody*>	mStackBoxes;
+		btAlignedObjectArray<btTypedConstraint*>	mConstraints;
+		btRigidBody*					mBall;
+
+		Scene( btConstraintSolver* solver, int stacksPerSide )
+			:mDispatcher( &mCollisionConfig ),
+			mWorld( &mDispatcher, &mBroadphase, solver, &mCollisionConfig ),
+			mGroundShape( btVector3( 50, 1, 50 ) ),
+			mBoxShape( btVector3( btScalar(0.5), btScalar(0.5), btScalar(0.5) ) ),
+			mBallShape( btScalar(0.5) )
+		{
+			mWorld.getSimulationIslandManager()->setSplitIslands( false );
+			mWorld.setGravity( btVector3( 0, -10, 0 ) );
+
+			addBody( 0, &mGroundShape, btVector3( 0, -1, 0 ) )->setRestitution( 1 );
+			//a kinematic slab under the first row of stacks
+			btRigidBody* slab = addBody( 0, &mGroundShape, btVector3( 0, -1, -70 ) );
+			slab->setCollisionFlags( slab->getCollisionFlags()|btCollisionObject::CF_KINEMATIC_OBJECT );
+			slab->setActivationState( DISABLE_DEACTIVATION );
+
+			for (int i=0;i<stacksPerSide*stacksPerSide;i++)
+			{
+				btScalar x = btScalar(i%stacksPerSide)*3-20;
+				btScalar z = i<stacksPerSide ? btScalar(-70) : btScalar(i/stacksPerSide)*3-20;
+				for (int j=0;j<4;j++)
+					mStackBoxes.push_back( addBody( 1, &mBoxShape, btVector3( x, btScalar(0.5)+btScalar(j), z ) ) );
+			}
+
+			mBall = addBody( 1, &mBallShape, btVector3( 30, 5, 30 ) );
+			mBall->setRestitution( btScalar(0.8) );
+
+			//a chain hanging from a point in the air, and a hinged box at its end
+			btRigidBody* prev = 0;
+			for (int i=0;i<6;i++)
+			{
+				btRigidBody* link = addBody( 1, &mBoxShape, btVector3( btScalar(-30)+btScalar(i)*btScalar(1.2), 20, 30 ) );
+				btTypedConstraint* constraint;
+				if (!prev)
+					constraint = new btPoint2PointConstraint( *link, btVector3( btScalar(-0.6), 0, 0 ) );
+				else if (i<5)
+					constraint = new btPoint2PointConstraint( *prev, *link, btVector3( btScalar(0.6), 0, 0 ), btVector3( btScalar(-0.6), 0, 0 ) );
+				else
+					constraint = new btHingeConstraint( *prev, *link, btVector3( btScalar(0.6), 0, 0 ), btVector3( btScalar(-0.6), 0, 0 ), btVector3( 0, 0, 1 ), btVector3( 0, 0, 1 ) );
+				mWorld.addConstraint( constraint, true );
+				mConstraints.push_back( constraint );
+				prev = link;
+			}
+		}
+
+		btRigidBody* addBody( btScalar mass, btCollisionShape* shape, const btVector3& origin )
+		{
+			btVector3 inertia( 0, 0, 0 );
+			if (mass)
+				shape->calculateLocalInertia( mass, inertia );
+			btRigidBody::btRigidBodyConstructionInfo info( mass, 0, shape, inertia );
+			info.m_startWorldTransform.setIdentity();
+			info.m_startWorldTransform.setOrigin( origin );
+			btRigidBody* body = new btRigidBody( info );
+			mWorld.addRigidBody( body );
+			mBodies.push_back( body );
+			return body;
+		}
+
+		~Scene()
+		{
+			for (int i=0;i<mConstraints.size();i++)
+			{
+				mWorld.removeConstraint( mConstraints[i] );
+				delete mConstraints[i];
+			}
+			for (int i=0;i<mBodies.size();i++)
+			{
+				mWorld.removeRigidBody( mBodies[i] );
+				delete mBodies[i];
+			}
+		}
+
+		void step( int numSteps )
+		{
+			for (int i=0;i<numSteps;i++)
+				mWorld.stepSimulation( btScalar(1.)/btScalar(60.), 0 );
+		}
+	};
+
+	static void checkSameBodies( const Scene& a, const Scene& b )
+	{
+		CPPUNIT_ASSERT_EQUAL( a.mBodies.size(), b.mBodies.size() );
+		for (int i=0;i<a.mBodies.size();i++)
+		{
+			CPPUNIT_ASSERT( a.mBodies[i]->getWorldTransform().getOrigin() == b.mBodies[i]->getWorldTransform().getOrigin() );
+			CPPUNIT_ASSERT( a.mBodies[i]->getLinearVelocity() == b.mBodies[i]->getLinearVelocity() );
+			CPPUNIT_ASSERT( a.mBodies[i]->getAngularVelocity() == b.mBodies[i]->getAngularVelocity() );
+		}
+	}
+
+	///the pivots of the point to point constraints are still together
+	static void checkChain( const Scene& scene )
+	{
+		for (int i=0;i<scene.mConstraints.size();i++)
+		{
+			const btPoint2PointConstraint* p2p = dynamic_cast<const btPoint2PointConstraint*>( scene.mConstraints[i] );
+			if (!p2p)
+				continue;
+			btVector3 pivotA = p2p->getRigidBodyA().getWorldTransform()*p2p->getPivotInA();
+			btVector3 pivotB = p2p->getRigidBodyB().getWorldTransform()*p2p->getPivotInB();
+			if (i==0)
+				pivotB = p2p->getPivotInB();
+			CPPUNIT_ASSERT( (pivotA-pivotB).length() < btScalar(0.05) );
+		}
+	}
+
+public:
+
+	void setUp()
+	{
+	}
+
+	void tearDown()
+	{
+		btSetTaskScheduler( 0 );
+	}
+
+	void testSmallSceneMatchesSequentialSolver()
+	{
+		btSequentialImpulseConstraintSolver sequentialSolver;
+		CheckedSolver solver;
+		Scene reference( &sequentialSolver, 1 );
+		Scene scene( &solver, 1 );
+		reference.step( 90 );
+		scene.step( 90 );
+
+		//too few groups for a parallel phase, everything is solved in order
+		CPPUNIT_ASSERT( solver.mPhasesValid );
+		CPPUNIT_ASSERT_EQUAL( 0, solver.mNumParallelPhases );
+		CPPUNIT_ASSERT( solver.mMaxContactPhases > 0 );
+		checkSameBodies( reference, scene );
+	}
+
+	void testLargeScene()
+	{
+		btSequentialImpulseConstraintSolver sequentialSolver;
+		CheckedSolver solver;
+		Scene reference( &sequentialSolver, 6 );
+		Scene scene( &solver, 6 );
+		reference.step( 60 );
+		scene.step( 60 );
+
+		CPPUNIT_ASSERT( solver.mPhasesValid );
+		CPPUNIT_ASSERT( solver.mNumParallelPhases > 0 );
+		CPPUNIT_ASSERT( solver.mMaxParallelContactPhases > 1 );
+
+		//the stacks rest on the ground and the slab like with the sequential solver
+		for (int i=0;i<scene.mStackBoxes.size();i++)
+		{
+			btVector3 delta = scene.mStackBoxes[i]->getWorldTransform().getOrigin()-reference.mStackBoxes[i]->getWorldTransform().getOrigin();
+			CPPUNIT_ASSERT( delta.length() < btScalar(0.02) );
+		}
+		CPPUNIT_ASSERT( btFabs( scene.mStackBoxes[3]->getWorldTransform().getOrigin().getY()-btScalar(3.5) ) < btScalar(0.05) );
+		//the ball only touches the ground, its rows are solved in the same order: restitution and split impulse give the same bounce
+		CPPUNIT_ASSERT( scene.mBall->getWorldTransform().getOrigin() == reference.mBall->getWorldTransform().getOrigin() );
+		CPPUNIT_ASSERT( scene.mBall->getLinearVelocity() == reference.mBall->getLinearVelocity() );
+		checkChain( scene );
+
+		//the joint rows are the same in every step, their phases are reused in place
+		const btParallelConstraintSolver::btSolverPhases& jointPhases = solver.getJointPhases();
+		CPPUNIT_ASSERT( jointPhases.m_groups.size() > 0 );
+		const btParallelConstraintSolver::btSolverRowGroup* jointGroups = &jointPhases.m_groups[0];
+		int numJointPhases = jointPhases.getNumPhases();
+		scene.step( 1 );
+		CPPUNIT_ASSERT( jointGroups == &jointPhases.m_groups[0] );
+		CPPUNIT_ASSERT_EQUAL( numJointPhases, jointPhases.getNumPhases() );
+	}
+
+	void testThreadCountDeterminism()
+	{
+		btParallelConstraintSolver referenceSolver;
+		Scene reference( &referenceSolver, 6 );
+		reference.step( 60 );
+
+		TestThreadPool threads;
+		if (threads.skipWithoutThreads( "TestParallelConstraintSolver::testThreadCountDeterminism" ))
+			return;
+		btParallelConstraintSolver solver;
+		solver.setGroupGrainSize( 1 );
+		Scene scene( &solver, 6 );
+		scene.step( 60 );
+
+		checkSameBodies( reference, scene );
+		checkChain( scene );
+	}
+
+	CPPUNIT_TEST_SUITE(TestParallelConstraintSolver);
+	CPPUNIT_TEST(testSmallSceneMatchesSequentialSolver);
+	CPPUNIT_TEST(testLargeScene);
+	CPPUNIT_TEST(testThreadCountDeterminism);
+	CPPUNIT_TEST_SUITE_END();
+};
+
+#endif
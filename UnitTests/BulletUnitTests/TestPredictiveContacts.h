@@ -0,0 +1,191 @@
+#ifndef TESTPREDICTIVECONTACTS_HAS_BEEN_INCLUDED
+#define TESTPREDICTIVECONTACTS_HAS_BEEN_INCLUDED
+
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+#include "TestSupport.h"
+
+#include "btBulletDynamicsCommon.h"
+#include "LinearMath/btThreads.h"
+
+// ---------------------------------------------------------------------------
+
+class TestPredictiveContacts : public CppUnit::TestFixture
+{
+	enum
+	{
+		NUM_PROJECTILES = 40
+	};
+
+	///gives access to the predictive manifolds of the last step
+	class World : public btDiscreteDynamicsWorld
+	{
+	public:
+		World( btDispatcher* dispatcher, btBroadphaseInterface* broadphase, btConstraintSolver* solver, btCollisionConfiguration* collisionConfig )
+			:btDiscreteDynamicsWorld( dispatcher, broadphase, solver, collisionConfig )
+		{
+		}
+
+		const btAlignedObjectArray<btPersistentManifold*>& getPredictiveManifolds() const
+		{
+			return m_predictiveManifolds;
+		}
+	};
+
+	///fast spheres and boxes shot at a thin static wall and at a row of dynamic boxes behind it
+	struct Scene
+	{
+		btDefaultCollisionConfiguration	mCollisionConfig;
+		btCollisionDispatcher			mDispatcher;
+		btDbvtBroadphase				mBroadphase;
+		btSequentialImpulseConstraintSolver	mSolver;
+		World							mWorld;
+		btBoxShape						mWallShape;
+		btSphereShape					mSphereShape;
+		btBoxShape						mBoxShape;
+		btAlignedObjectArray<btRigidBody*>	mBodies;
+
+		Scene( bool batched )
+			:mDispatcher( &mCollisionConfig ),
+			mWorld( &mDispatcher, &mBroadphase, &mSolver, &mCollisionConfig ),
+			mWallShape( btVector3( btScalar(0.05), 20, 20 ) ),
+			mSphereShape( btScalar(0.1) ),
+			mBoxShape( btVector3( btScalar(0.1), btScalar(0.1), btScalar(0.1) ) )
+		{
+			mWorld.setGravity( btVector3( 0, 0, 0 ) );
+			mWorld.setUseBatchedCcd( batched );
+			btRigidBody::btRigidBodyConstructionInfo wallInfo( 0, 0, &mWallShape );
+			wallInfo.m_startWorldTransform.setIdentity();
+			mBodies.push_back( new btRigidBody( wallInfo ) );
+
+			for (int i=0;i<NUM_PROJECTILES;i++)
+			{
+				btConvexShape* shape = (i%4) ? (btConvexShape*)&mSphereShape : (btConvexShape*)&mBoxShape;
+				btVector3 inertia;
+				shape->calculateLocalInertia( 1, inertia );
+				btRigidBody::btRigidBodyConstructionInfo info( 1, 0, shape, inertia );
+				info.m_startWorldTransform.setIdentity();
+				info.m_startWorldTransform.setOrigin( btVector3( btScalar(-1)-btScalar(i%3), btScalar(i/8)*2-5, btScalar(i%8)*2-7 ) );
+				btRigidBody* body = new btRigidBody( info );
+				body->setLinearVelocity( btVector3( btScalar(5+(i*37)%300), btScalar(i%5)-2, 0 ) );
+				body->setCcdMotionThreshold( btScalar(0.05) );
+				body->setCcdSweptSphereRadius( btScalar(0.08) );
+				mBodies.push_back( body );
+			}
+			//slow boxes on the other side of the wall, moving towards it
+			for (int i=0;i<8;i++)
+			{
+				btVector3 inertia;
+				mBoxShape.calculateLocalInertia( 1, inertia );
+				btRigidBody::btRigidBodyConstructionInfo info( 1, 0, &mBoxShape, inertia );
+				info.m_startWorldTransform.setIdentity();
+				info.m_startWorldTransform.setOrigin( btVector3( btScalar(0.5), btScalar(i)-4, 1 ) );
+				btRigidBody* body = new btRigidBody( info );
+				body->setLinearVelocity( btVector3( -30, 0, 0 ) );
+				body->setCcdMotionThreshold( btScalar(0.05) );
+				body->setCcdSweptSphereRadius( btScalar(0.08) );
+				mBodies.push_back( body );
+			}
+			for (int i=0;i<mBodies.size();i++)
+				mWorld.addRigidBody( mBodies[i] );
+		}
+
+		~Scene()
+		{
+			for (int i=0;i<mBodies.size();i++)
+			{
+				mWorld.removeRigidBody( mBodies[i] );
+				delete mBodies[i];
+			}
+		}
+
+		void step( int numSteps )
+		{
+			for (int i=0;i<numSteps;i++)
+				mWorld.stepSimulation( btScalar(1.)/btScalar(60.), 0 );
+		}
+	};
+
+	///the same predictive contacts, in the same order
+	static void checkSamePredictiveContacts( const Scene& a, const Scene& b )
+	{
+		const btAlignedObjectArray<btPersistentManifold*>& manifoldsA = a.mWorld.getPredictiveManifolds();
+		const btAlignedObjectArray<btPersistentManifold*>& manifoldsB = b.mWorld.getPredictiveManifolds();
+		CPPUNIT_ASSERT_EQUAL( manifoldsA.size(), manifoldsB.size() );
+		for (int i=0;i<manifoldsA.size();i++)
+		{
+			const btPersistentManifold* manifoldA = manifoldsA[i];
+			const btPersistentManifold* manifoldB = manifoldsB[i];
+			CPPUNIT_ASSERT_EQUAL( a.mBodies.findLinearSearch( (btRigidBody*)manifoldA->getBody0() ), b.mBodies.findLinearSearch( (btRigidBody*)manifoldB->getBody0() ) );
+			CPPUNIT_ASSERT_EQUAL( a.mBodies.findLinearSearch( (btRigidBody*)manifoldA->getBody1() ), b.mBodies.findLinearSearch( (btRigidBody*)manifoldB->getBody1() ) );
+			CPPUNIT_ASSERT_EQUAL( manifoldA->getNumContacts(), manifoldB->getNumContacts() );
+			for (int j=0;j<manifoldA->getNumContacts();j++)
+			{
+				const btManifoldPoint& ptA = manifoldA->getContactPoint( j );
+				const btManifoldPoint& ptB = manifoldB->getContactPoint( j );
+				CPPUNIT_ASSERT( ptA.m_localPointB == ptB.m_localPointB );
+				CPPUNIT_ASSERT( ptA.m_normalWorldOnB == ptB.m_normalWorldOnB );
+				CPPUNIT_ASSERT( ptA.getDistance() == ptB.getDistance() );
+				CPPUNIT_ASSERT( ptA.m_combinedFriction == ptB.m_combinedFriction );
+			}
+		}
+	}
+
+	static void checkSameBodies( const Scene& a, const Scene& b )
+	{
+		for (int i=0;i<a.mBodies.size();i++)
+		{
+			CPPUNIT_ASSERT( a.mBodies[i]->getWorldTransform().getOrigin() == b.mBodies[i]->getWorldTransform().getOrigin() );
+			CPPUNIT_ASSERT( a.mBodies[i]->getLinearVelocity() == b.mBodies[i]->getLinearVelocity() );
+		}
+	}
+
+public:
+
+	void setUp()
+	{
+	}
+
+	void tearDown()
+	{
+		btSetTaskScheduler( 0 );
+	}
+
+	void testMatchesSerialContacts()
+	{
+		Scene serial( false );
+		Scene batched( true );
+		serial.step( 1 );
+		batched.step( 1 );
+		//the fast projectiles and the boxes behind the wall are heading for a hit
+		CPPUNIT_ASSERT( serial.mWorld.getPredictiveManifolds().size() > NUM_PROJECTILES/2 );
+		checkSamePredictiveContacts( serial, batched );
+	}
+
+	void testThreadCountDeterminism()
+	{
+		Scene reference( true );
+		reference.step( 1 );
+
+		TestThreadPool threads;
+		if (threads.skipWithoutThreads( "TestPredictiveContacts::testThreadCountDeterminism" ))
+			return;
+		Scene scene( true );
+		scene.step( 1 );
+		checkSamePredictiveContacts( reference, scene );
+
+		//the contacts are solved in the same order, so the bodies move the same
+		reference.step( 20 );
+		scene.step( 20 );
+
+		checkSamePredictiveContacts( reference, scene );
+		checkSameBodies( reference, scene );
+	}
+
+	CPPUNIT_TEST_SUITE(TestPredictiveContacts);
+	CPPUNIT_TEST(testMatchesSerialContacts);
+	CPPUNIT_TEST(testThreadCountDeterminism);
+	CPPUNIT_TEST_SUITE_END();
+};
+
+#endif
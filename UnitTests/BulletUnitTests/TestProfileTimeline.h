@@ -0,0 +1,169 @@
+#ifndef TESTPROFILETIMELINE_HAS_BEEN_INCLUDED
+#define TESTPROFILETIMELINE_HAS_BEEN_INCLUDED
+
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+#include "TestSupport.h"
+
+#include "LinearMath/btQuickprof.h"
+#include "LinearMath/btThreads.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// ---------------------------------------------------------------------------
+
+class TestProfileTimeline : public CppUnit::TestFixture
+{
+	struct ProfiledLoop : public btIParallelForBody
+	{
+		void forLoop( int iBegin, int iEnd ) const
+		{
+			BT_PROFILE( "ProfiledLoop" );
+			for (int i=iBegin;i<iEnd;i++)
+			{
+				BT_PROFILE( "ProfiledItem" );
+			}
+		}
+	};
+
+	///looks for a child of the root of the CProfileManager tree
+	bool hasTreeNode( const char* name )
+	{
+		bool found = false;
+		CProfileIterator* iterator = CProfileManager::Get_Iterator();
+		for (iterator->First();!iterator->Is_Done();iterator->Next())
+		{
+			if (strcmp( iterator->Get_Current_Name(), name ) == 0)
+				found = true;
+		}
+		CProfileManager::Release_Iterator( iterator );
+		return found;
+	}
+
+	int countEvents( int threadIndex, int type, const char* name = 0 )
+	{
+		int count = 0;
+		for (int i=0;i<btProfileTimeline::getNumEvents( threadIndex );i++)
+		{
+			const btProfileEvent& ev = btProfileTimeline::getEvent( threadIndex, i );
+			if (ev.m_type == type && (!name || strcmp( ev.m_name, name ) == 0))
+				count++;
+		}
+		return count;
+	}
+
+public:
+
+	void setUp()
+	{
+	}
+
+	void tearDown()
+	{
+		CProfileManager::Set_Enabled( true );
+		btProfileTimeline::releaseMemory();
+		btSetTaskScheduler( 0 );
+	}
+
+	void testDisabled()
+	{
+		{
+			BT_PROFILE( "NotRecorded" );
+		}
+		CPPUNIT_ASSERT_EQUAL( 0, btProfileTimeline::getNumEvents( 0 ) );
+	}
+
+	void testTreeDisabled()
+	{
+		CProfileManager::Set_Enabled( false );
+		{
+			BT_PROFILE( "NotInTree" );
+		}
+		CPPUNIT_ASSERT( !hasTreeNode( "NotInTree" ) );
+
+		//the timeline still records with the tree disabled
+		btProfileTimeline::enable();
+		{
+			BT_PROFILE( "NotInTree" );
+		}
+		btProfileTimeline::disable();
+		CPPUNIT_ASSERT_EQUAL( 1, countEvents( btGetCurrentThreadIndex(), btProfileTimeline::BT_PROFILE_EVENT_BEGIN, "NotInTree" ) );
+		CPPUNIT_ASSERT( !hasTreeNode( "NotInTree" ) );
+
+		CProfileManager::Set_Enabled( true );
+		{
+			BT_PROFILE( "InTree" );
+		}
+		CPPUNIT_ASSERT( hasTreeNode( "InTree" ) );
+	}
+
+	void testAllThreads()
+	{
+		TestThreadPool threads;
+		if (threads.skipWithoutThreads( "TestProfileTimeline::testAllThreads" ))
+			return;
+		btProfileTimeline::enable();
+		{
+			BT_PROFILE( "Outer" );
+			btParallelFor( 0, 64, 4, ProfiledLoop() );
+		}
+		CProfileManager::Increment_Frame_Counter();
+		btProfileTimeline::disable();
+
+		//every scope has a begin and an end, on whatever thread ran it
+		int numBegin = 0, numEnd = 0, numItems = 0;
+		for (int t=0;t<BT_MAX_THREAD_COUNT;t++)
+		{
+			numBegin += countEvents( t, btProfileTimeline::BT_PROFILE_EVENT_BEGIN );
+			numEnd += countEvents( t, btProfileTimeline::BT_PROFILE_EVENT_END );
+			numItems += countEvents( t, btProfileTimeline::BT_PROFILE_EVENT_BEGIN, "ProfiledItem" );
+			for (int i=1;i<btProfileTimeline::getNumEvents( t );i++)
+			{
+				CPPUNIT_ASSERT( btProfileTimeline::getEvent( t, i-1 ).m_ticks <= btProfileTimeline::getEvent( t, i ).m_ticks );
+			}
+		}
+		CPPUNIT_ASSERT_EQUAL( 64, numItems );
+		CPPUNIT_ASSERT_EQUAL( numBegin, numEnd );
+		CPPUNIT_ASSERT_EQUAL( 1, countEvents( 0, btProfileTimeline::BT_PROFILE_EVENT_FRAME ) );
+		CPPUNIT_ASSERT( strcmp( btProfileTimeline::getEvent( 0, 0 ).m_name, "Outer" ) == 0 );
+
+		const char* fileName = "TestProfileTimeline.json";
+		CPPUNIT_ASSERT( btProfileTimeline::writeChromeTrace( fileName ) );
+		FILE* file = fopen( fileName, "r" );
+		CPPUNIT_ASSERT( file != 0 );
+		char line[256];
+		int numLines = 0;
+		while (fgets( line, sizeof(line), file ))
+			numLines++;
+		fclose( file );
+		remove( fileName );
+		//the opening line, one line per event and the closing line
+		CPPUNIT_ASSERT_EQUAL( 2+numBegin+numEnd+1, numLines );
+	}
+
+	void testRingBuffer()
+	{
+		btProfileTimeline::enable( 10 );
+		for (int i=0;i<100;i++)
+		{
+			BT_PROFILE( "Wrapped" );
+		}
+		btProfileTimeline::disable();
+		//the capacity is rounded up to 16, only the most recent events are kept
+		CPPUNIT_ASSERT_EQUAL( 16, btProfileTimeline::getNumEvents( 0 ) );
+		CPPUNIT_ASSERT_EQUAL( int(btProfileTimeline::BT_PROFILE_EVENT_END), btProfileTimeline::getEvent( 0, 15 ).m_type );
+
+		btProfileTimeline::clear();
+		CPPUNIT_ASSERT_EQUAL( 0, btProfileTimeline::getNumEvents( 0 ) );
+	}
+
+	CPPUNIT_TEST_SUITE(TestProfileTimeline);
+	CPPUNIT_TEST(testDisabled);
+	CPPUNIT_TEST(testTreeDisabled);
+	CPPUNIT_TEST(testAllThreads);
+	CPPUNIT_TEST(testRingBuffer);
+	CPPUNIT_TEST_SUITE_END();
+};
+
+#endif
@@ -0,0 +1,201 @@
+#ifndef TESTQUANTIZEDBVHSAH_HAS_BEEN_INCLUDED
+#define TESTQUANTIZEDBVHSAH_HAS_BEEN_INCLUDED
+
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+#include "TestSupport.h"
+
+#include "btBulletCollisionCommon.h"
+#include "BulletCollision/NarrowPhaseCollision/btRaycastCallback.h"
+#include "LinearMath/btThreads.h"
+
+// ---------------------------------------------------------------------------
+
+class TestQuantizedBvhSah : public TestRandomFixture
+{
+	enum
+	{
+		NUM_CLUSTERS = 20,
+		CLUSTER_SIZE = 400,
+		GRID_SIZE = 40,
+		NUM_RAYS = 300,
+		NUM_BOXES = 50
+	};
+
+	btTriangleMesh* mMesh;
+
+	struct ClosestTriangleCallback : public btTriangleRaycastCallback
+	{
+		ClosestTriangleCallback( const btVector3& from, const btVector3& to )
+			:btTriangleRaycastCallback( from, to )
+		{
+		}
+		virtual btScalar reportHit( const btVector3&, btScalar hitFraction, int, int )
+		{
+			return hitFraction;
+		}
+	};
+
+	struct CountTrianglesCallback : public btTriangleCallback
+	{
+		btAlignedObjectArray<int> mCounts;
+		virtual void processTriangle( btVector3*, int, int triangleIndex )
+		{
+			mCounts[triangleIndex]++;
+		}
+	};
+
+	btScalar calcSahCost( btOptimizedBvh* bvh )
+	{
+		btScalar cost = 0;
+		QuantizedNodeArray& nodes = bvh->getQuantizedNodeArray();
+		for (int i=0;i<bvh->getQuantizedNodeArray().size();i++)
+		{
+			if (nodes[i].isLeafNode() || !nodes[i].getEscapeIndex())
+				continue;
+			btVector3 d = bvh->unQuantize( nodes[i].m_quantizedAabbMax )-bvh->unQuantize( nodes[i].m_quantizedAabbMin );
+			cost += d.getX()*d.getY()+d.getY()*d.getZ()+d.getZ()*d.getX();
+		}
+		return cost;
+	}
+
+	btBvhTriangleMeshShape* createShape( bool quantized, btQuantizedBvh::btBuildMode buildMode )
+	{
+		btBvhTriangleMeshShape* shape = new btBvhTriangleMeshShape( mMesh, quantized, false );
+		shape->buildOptimizedBvh( buildMode );
+		return shape;
+	}
+
+public:
+
+	void setUp()
+	{
+		//clusters of small triangles above a ground grid
+		mMesh = new btTriangleMesh();
+		mSeed = 42;
+		for (int c=0;c<NUM_CLUSTERS;c++)
+		{
+			btVector3 center = randVector( 80 )+btVector3( 0, 45, 0 );
+			for (int i=0;i<CLUSTER_SIZE;i++)
+			{
+				btVector3 v = center+randVector( 6 );
+				mMesh->addTriangle( v, v+randVector( 1 ), v+randVector( 1 ) );
+			}
+		}
+		for (int i=0;i<GRID_SIZE;i++)
+		{
+			for (int j=0;j<GRID_SIZE;j++)
+			{
+				btVector3 v00( btScalar(i*2-GRID_SIZE), 0, btScalar(j*2-GRID_SIZE) );
+				mMesh->addTriangle( v00, v00+btVector3( 2, 0, 0 ), v00+btVector3( 2, 0, 2 ) );
+				mMesh->addTriangle( v00, v00+btVector3( 2, 0, 2 ), v00+btVector3( 0, 0, 2 ) );
+			}
+		}
+	}
+
+	void tearDown()
+	{
+		btSetTaskScheduler( 0 );
+		delete mMesh;
+	}
+
+	void testSahMatchesMeanSplit()
+	{
+		btBvhTriangleMeshShape* meanShape = createShape( true, btQuantizedBvh::BUILD_MEAN_SPLIT );
+		btBvhTriangleMeshShape* sahShape = createShape( true, btQuantizedBvh::BUILD_BINNED_SAH );
+		btBvhTriangleMeshShape* sahShapeNoQuantization = createShape( false, btQuantizedBvh::BUILD_BINNED_SAH );
+
+
+		//same layout as the mean split build
+		btOptimizedBvh* meanBvh = meanShape->getOptimizedBvh();
+		btOptimizedBvh* sahBvh = sahShape->getOptimizedBvh();
+		int numTriangles = mMesh->getNumTriangles();
+		CPPUNIT_ASSERT_EQUAL( 2*numTriangles, sahBvh->getQuantizedNodeArray().size() );
+		CPPUNIT_ASSERT_EQUAL( 0, sahBvh->getQuantizedNodeArray()[0].getEscapeIndex()-(2*numTriangles-1) );
+		CPPUNIT_ASSERT( sahBvh->getSubtreeInfoArray().size() > 1 );
+		for (int i=0;i<sahBvh->getSubtreeInfoArray().size();i++)
+		{
+			const btBvhSubtreeInfo& subtree = sahBvh->getSubtreeInfoArray()[i];
+			CPPUNIT_ASSERT( subtree.m_subtreeSize*int(sizeof(btQuantizedBvhNode)) <= MAX_SUBTREE_SIZE_IN_BYTES );
+			const btQuantizedBvhNode& root = sahBvh->getQuantizedNodeArray()[subtree.m_rootNodeIndex];
+			CPPUNIT_ASSERT_EQUAL( subtree.m_subtreeSize, root.isLeafNode() ? 1 : root.getEscapeIndex() );
+		}
+
+		//the SAH tree has less internal node area
+		CPPUNIT_ASSERT( calcSahCost( sahBvh ) < calcSahCost( meanBvh ) );
+
+		//rays hit the same closest triangle
+		mSeed = 7;
+		btBvhTriangleMeshShape* shapes[2] = { sahShape, sahShapeNoQuantization };
+		int numHits = 0;
+		for (int r=0;r<NUM_RAYS;r++)
+		{
+			btVector3 from = randVector( 120 )+btVector3( 0, 80, 0 );
+			btVector3 to = randVector( 120 )-btVector3( 0, 20, 0 );
+			ClosestTriangleCallback reference( from, to );
+			meanShape->performRaycast( &reference, from, to );
+			if (reference.m_hitFraction < btScalar(1.))
+				numHits++;
+			for (int s=0;s<2;s++)
+			{
+				ClosestTriangleCallback cb( from, to );
+				shapes[s]->performRaycast( &cb, from, to );
+				CPPUNIT_ASSERT( btFabs( cb.m_hitFraction-reference.m_hitFraction ) < btScalar(1e-6) );
+			}
+		}
+		CPPUNIT_ASSERT( numHits > NUM_RAYS/4 );
+
+		//box queries report the same triangles, also using the subtree headers
+		sahBvh->setTraversalMode( btQuantizedBvh::TRAVERSAL_STACKLESS_CACHE_FRIENDLY );
+		for (int b=0;b<NUM_BOXES;b++)
+		{
+			btVector3 center = randVector( 100 )+btVector3( 0, 40, 0 );
+			btVector3 extent( rand01()*10, rand01()*10, rand01()*10 );
+			CountTrianglesCallback reference, cb;
+			reference.mCounts.resize( numTriangles, 0 );
+			cb.mCounts.resize( numTriangles, 0 );
+			meanShape->processAllTriangles( &reference, center-extent, center+extent );
+			sahShape->processAllTriangles( &cb, center-extent, center+extent );
+			for (int i=0;i<numTriangles;i++)
+			{
+				CPPUNIT_ASSERT_EQUAL( reference.mCounts[i], cb.mCounts[i] );
+			}
+		}
+
+		delete meanShape;
+		delete sahShape;
+		delete sahShapeNoQuantization;
+	}
+
+	void testThreadCountDeterminism()
+	{
+		TestThreadPool threads;
+		if (threads.skipWithoutThreads( "TestQuantizedBvhSah::testThreadCountDeterminism" ))
+			return;
+		btBvhTriangleMeshShape* sahShapeMt = createShape( true, btQuantizedBvh::BUILD_BINNED_SAH );
+		btSetTaskScheduler( btGetSequentialTaskScheduler() );
+		btBvhTriangleMeshShape* sahShape = createShape( true, btQuantizedBvh::BUILD_BINNED_SAH );
+
+		//the same tree for any number of threads
+		btOptimizedBvh* sahBvh = sahShape->getOptimizedBvh();
+		btOptimizedBvh* sahBvhMt = sahShapeMt->getOptimizedBvh();
+		int numTriangles = mMesh->getNumTriangles();
+		CPPUNIT_ASSERT_EQUAL( sahBvh->getSubtreeInfoArray().size(), sahBvhMt->getSubtreeInfoArray().size() );
+		CPPUNIT_ASSERT( memcmp( &sahBvh->getQuantizedNodeArray()[0], &sahBvhMt->getQuantizedNodeArray()[0], sizeof(btQuantizedBvhNode)*(2*numTriangles-1) )==0 );
+		for (int i=0;i<sahBvh->getSubtreeInfoArray().size();i++)
+		{
+			CPPUNIT_ASSERT_EQUAL( sahBvh->getSubtreeInfoArray()[i].m_rootNodeIndex, sahBvhMt->getSubtreeInfoArray()[i].m_rootNodeIndex );
+			CPPUNIT_ASSERT_EQUAL( sahBvh->getSubtreeInfoArray()[i].m_subtreeSize, sahBvhMt->getSubtreeInfoArray()[i].m_subtreeSize );
+		}
+
+		delete sahShape;
+		delete sahShapeMt;
+	}
+
+	CPPUNIT_TEST_SUITE(TestQuantizedBvhSah);
+	CPPUNIT_TEST(testSahMatchesMeanSplit);
+	CPPUNIT_TEST(testThreadCountDeterminism);
+	CPPUNIT_TEST_SUITE_END();
+};
+
+#endif
@@ -0,0 +1,233 @@
+#ifndef TESTRAYTESTBATCH_HAS_BEEN_INCLUDED
+#define TESTRAYTESTBATCH_HAS_BEEN_INCLUDED
+
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+#include "TestSupport.h"
+
+#include "btBulletDynamicsCommon.h"
+#include "BulletSoftBody/btSoftRigidDynamicsWorld.h"
+#include "BulletSoftBody/btSoftBodyRigidBodyCollisionConfiguration.h"
+#include "BulletSoftBody/btSoftBodyHelpers.h"
+#include "LinearMath/btThreads.h"
+
+// ---------------------------------------------------------------------------
+
+class TestRayTestBatch : public TestRandomFixture
+{
+	enum
+	{
+		GRID_SIZE = 16,
+		NUM_OBJECTS = 40,
+		NUM_RAYS = 403
+	};
+
+	void compareWithRayTest( btBroadphaseInterface* broadphase )
+	{
+		btDefaultCollisionConfiguration collisionConfig;
+		btCollisionDispatcher dispatcher( &collisionConfig );
+		btCollisionWorld world( &dispatcher, broadphase, &collisionConfig );
+
+		//a bumpy triangle mesh ground
+		btTriangleMesh mesh;
+		for (int i=0;i<GRID_SIZE;i++)
+		{
+			for (int j=0;j<GRID_SIZE;j++)
+			{
+				btVector3 v00( btScalar(i), btSin(btScalar(i+j)), btScalar(j) );
+				btVector3 v10( btScalar(i+1), btSin(btScalar(i+1+j)), btScalar(j) );
+				btVector3 v01( btScalar(i), btSin(btScalar(i+j+1)), btScalar(j+1) );
+				btVector3 v11( btScalar(i+1), btSin(btScalar(i+j+2)), btScalar(j+1) );
+				mesh.addTriangle( v00, v10, v11 );
+				mesh.addTriangle( v00, v11, v01 );
+			}
+		}
+		btBvhTriangleMeshShape groundShape( &mesh, true );
+		btCollisionObject ground;
+		ground.setCollisionShape( &groundShape );
+		btTransform groundTrans;
+		groundTrans.setIdentity();
+		groundTrans.setOrigin( btVector3( -btScalar(GRID_SIZE/2), -2, -btScalar(GRID_SIZE/2) ) );
+		ground.setWorldTransform( groundTrans );
+		world.addCollisionObject( &ground );
+
+		btBoxShape boxShape( btVector3( 0.5, 0.3, 0.4 ) );
+		btSphereShape sphereShape( 0.6 );
+		btCollisionObject objects[NUM_OBJECTS];
+		mSeed = 4321;
+		for (int i=0;i<NUM_OBJECTS;i++)
+		{
+			btTransform tr;
+			tr.setIdentity();
+			tr.setRotation( btQuaternion( btVector3( rand01(), 1, rand01() ).normalized(), rand01()*SIMD_2_PI ) );
+			tr.setOrigin( btVector3( rand01()*12-6, rand01()*4, rand01()*12-6 ) );
+			objects[i].setWorldTransform( tr );
+			objects[i].setCollisionShape( (i&1) ? (btCollisionShape*)&sphereShape : (btCollisionShape*)&boxShape );
+			world.addCollisionObject( &objects[i] );
+		}
+		world.updateAabbs();
+		//a single AABB update leaves the tree of a parallel collide btDbvtBroadphase to be refit before the queries
+		btTransform moved = objects[0].getWorldTransform();
+		moved.getOrigin() += btVector3( 3, 0, -2 );
+		objects[0].setWorldTransform( moved );
+		world.updateSingleAabb( &objects[0] );
+
+		//coherent bundles of rays pointing down, and some random ones
+		btAlignedObjectArray<btVector3> rayFrom, rayTo;
+		for (int i=0;i<NUM_RAYS;i++)
+		{
+			if (i%8<6)
+			{
+				btVector3 from( rand01()*14-7, 8, rand01()*14-7 );
+				rayFrom.push_back( from );
+				rayTo.push_back( from+btVector3( rand01()-0.5, -20, rand01()-0.5 ) );
+			} else
+			{
+				rayFrom.push_back( btVector3( rand01()*20-10, rand01()*10, rand01()*20-10 ) );
+				rayTo.push_back( btVector3( rand01()*20-10, rand01()*10-5, rand01()*20-10 ) );
+			}
+		}
+
+		btAlignedObjectArray<btCollisionWorld::RayTestBatchResult> results;
+		results.resize( NUM_RAYS );
+		world.rayTestBatch( &rayFrom[0], &rayTo[0], NUM_RAYS, &results[0] );
+
+		int numHits = 0;
+		for (int i=0;i<NUM_RAYS;i++)
+		{
+			btCollisionWorld::ClosestRayResultCallback cb( rayFrom[i], rayTo[i] );
+			world.rayTest( rayFrom[i], rayTo[i], cb );
+			CPPUNIT_ASSERT_EQUAL( cb.hasHit(), results[i].m_collisionObject != 0 );
+			if (cb.hasHit())
+			{
+				numHits++;
+				CPPUNIT_ASSERT( btFabs( cb.m_closestHitFraction-results[i].m_hitFraction ) < btScalar(1e-5) );
+				CPPUNIT_ASSERT( (cb.m_hitPointWorld-results[i].m_hitPointWorld).length() < btScalar(1e-3) );
+				CPPUNIT_ASSERT( (cb.m_hitNormalWorld-results[i].m_hitNormalWorld).length() < btScalar(1e-3) );
+				CPPUNIT_ASSERT( cb.m_collisionObject == results[i].m_collisionObject );
+				if (results[i].m_collisionObject == &ground)
+				{
+					CPPUNIT_ASSERT( results[i].m_triangleIndex >= 0 );
+				}
+			} else
+			{
+				CPPUNIT_ASSERT_EQUAL( btScalar(1.), results[i].m_hitFraction );
+			}
+		}
+		//the downward rays all hit the ground or an object
+		CPPUNIT_ASSERT( numHits >= NUM_RAYS*3/4 );
+
+		for (int i=0;i<NUM_OBJECTS;i++)
+			world.removeCollisionObject( &objects[i] );
+		world.removeCollisionObject( &ground );
+	}
+
+	///a cloth above a box, btSoftRigidDynamicsWorld tests the cloth faces in rayTest and rayTestBatch
+	void compareSoftBodyWithRayTest()
+	{
+		btSoftBodyRigidBodyCollisionConfiguration collisionConfig;
+		btCollisionDispatcher dispatcher( &collisionConfig );
+		btDbvtBroadphase broadphase;
+		btSequentialImpulseConstraintSolver solver;
+		btSoftRigidDynamicsWorld world( &dispatcher, &broadphase, &solver, &collisionConfig );
+
+		btBoxShape groundShape( btVector3( 10, 1, 10 ) );
+		btCollisionObject ground;
+		ground.setCollisionShape( &groundShape );
+		btTransform groundTrans;
+		groundTrans.setIdentity();
+		groundTrans.setOrigin( btVector3( 0, -1, 0 ) );
+		ground.setWorldTransform( groundTrans );
+		world.addCollisionObject( &ground );
+
+		btSoftBody* cloth = btSoftBodyHelpers::CreatePatch( world.getWorldInfo(),
+			btVector3( -3, 2, -3 ), btVector3( 3, 2, -3 ), btVector3( -3, 2, 3 ), btVector3( 3, 2, 3 ),
+			9, 9, 0, true );
+		cloth->setTotalMass( 1 );
+		world.addSoftBody( cloth );
+		world.stepSimulation( btScalar(1.)/btScalar(60.), 0 );
+
+		mSeed = 8765;
+		btAlignedObjectArray<btVector3> rayFrom, rayTo;
+		for (int i=0;i<NUM_RAYS;i++)
+		{
+			btVector3 from( rand01()*10-5, 6, rand01()*10-5 );
+			rayFrom.push_back( from );
+			rayTo.push_back( from+btVector3( rand01()-0.5, -10, rand01()-0.5 ) );
+		}
+
+		btAlignedObjectArray<btCollisionWorld::RayTestBatchResult> results;
+		results.resize( NUM_RAYS );
+		world.rayTestBatch( &rayFrom[0], &rayTo[0], NUM_RAYS, &results[0] );
+
+		int numClothHits = 0;
+		for (int i=0;i<NUM_RAYS;i++)
+		{
+			btCollisionWorld::ClosestRayResultCallback cb( rayFrom[i], rayTo[i] );
+			world.rayTest( rayFrom[i], rayTo[i], cb );
+			CPPUNIT_ASSERT( cb.hasHit() );
+			CPPUNIT_ASSERT( cb.m_collisionObject == results[i].m_collisionObject );
+			CPPUNIT_ASSERT( btFabs( cb.m_closestHitFraction-results[i].m_hitFraction ) < btScalar(1e-5) );
+			CPPUNIT_ASSERT( (cb.m_hitNormalWorld-results[i].m_hitNormalWorld).length() < btScalar(1e-3) );
+			if (results[i].m_collisionObject == cloth)
+				numClothHits++;
+		}
+		//the cloth covers a third of the rays
+		CPPUNIT_ASSERT( numClothHits >= NUM_RAYS/4 );
+		CPPUNIT_ASSERT( numClothHits < NUM_RAYS );
+
+		world.removeSoftBody( cloth );
+		delete cloth;
+		world.removeCollisionObject( &ground );
+	}
+
+public:
+
+	void setUp()
+	{
+	}
+
+	void tearDown()
+	{
+		btSetTaskScheduler( 0 );
+	}
+
+	void testDbvtBroadphase()
+	{
+		btDbvtBroadphase broadphase;
+		compareWithRayTest( &broadphase );
+
+		TestThreadPool threads;
+		if (threads.skipWithoutThreads( "TestRayTestBatch::testDbvtBroadphase" ))
+			return;
+		btDbvtBroadphase broadphaseMt;
+		compareWithRayTest( &broadphaseMt );
+		btDbvtBroadphase broadphaseParallelCollide;
+		broadphaseParallelCollide.setParallelCollide( true );
+		compareWithRayTest( &broadphaseParallelCollide );
+	}
+
+	void testBroadphaseFallback()
+	{
+		btSimpleBroadphase broadphase;
+		compareWithRayTest( &broadphase );
+	}
+
+	void testSoftRigidWorld()
+	{
+		compareSoftBodyWithRayTest();
+
+		TestThreadPool threads;
+		if (threads.skipWithoutThreads( "TestRayTestBatch::testSoftRigidWorld" ))
+			return;
+		compareSoftBodyWithRayTest();
+	}
+
+	CPPUNIT_TEST_SUITE(TestRayTestBatch);
+	CPPUNIT_TEST(testDbvtBroadphase);
+	CPPUNIT_TEST(testBroadphaseFallback);
+	CPPUNIT_TEST(testSoftRigidWorld);
+	CPPUNIT_TEST_SUITE_END();
+};
+
+#endif
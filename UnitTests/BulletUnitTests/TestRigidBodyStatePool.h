@@ -0,0 +1,116 @@
+#ifndef TESTRIGIDBODYSTATEPOOL_HAS_BEEN_INCLUDED
+#define TESTRIGIDBODYSTATEPOOL_HAS_BEEN_INCLUDED
+
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+
+#include "btBulletDynamicsCommon.h"
+
+// ---------------------------------------------------------------------------
+
+class TestRigidBodyStatePool : public CppUnit::TestFixture
+{
+	enum
+	{
+		NUM_BODIES = 11,
+		NUM_STEPS = 60
+	};
+
+	void runScene( bool useBodyStatePool, btAlignedObjectArray<btTransform>& result, btAlignedObjectArray<btVector3>& velocities )
+	{
+		btDefaultCollisionConfiguration collisionConfig;
+		btCollisionDispatcher dispatcher( &collisionConfig );
+		btDbvtBroadphase broadphase;
+		btSequentialImpulseConstraintSolver solver;
+		btDiscreteDynamicsWorld world( &dispatcher, &broadphase, &solver, &collisionConfig );
+		world.setGravity( btVector3( 0, -10, 0 ));
+		world.setUseBodyStatePool( useBodyStatePool );
+		CPPUNIT_ASSERT_EQUAL( useBodyStatePool, world.getUseBodyStatePool() );
+
+		btBoxShape groundShape( btVector3( 50, 1, 50 ) );
+		btBoxShape boxShape( btVector3( 0.3, 0.5, 0.7 ) );
+		btAlignedObjectArray<btRigidBody*> bodies;
+
+		for (int i=0;i<NUM_BODIES+1;i++)
+		{
+			bool ground = (i==0);
+			btScalar mass = ground ? 0 : btScalar(i);
+			btVector3 inertia( 0, 0, 0 );
+			btTransform tr;
+			tr.setIdentity();
+			if (ground)
+			{
+				tr.setOrigin( btVector3( 0, -1, 0 ) );
+			} else
+			{
+				//spread out so that only the low bodies touch the ground during the run
+				tr.setOrigin( btVector3( btScalar(i)*3, btScalar(i%4)*6+1, 0 ) );
+				tr.setRotation( btQuaternion( btVector3( 1, btScalar(i), 2 ).normalized(), btScalar(i)*0.3 ) );
+				boxShape.calculateLocalInertia( mass, inertia );
+			}
+			btRigidBody::btRigidBodyConstructionInfo info( mass, 0, ground ? (btCollisionShape*)&groundShape : (btCollisionShape*)&boxShape, inertia );
+			info.m_startWorldTransform = tr;
+			if (!ground)
+			{
+				info.m_linearDamping = btScalar(i%3)*0.1;
+				info.m_angularDamping = btScalar(i%2)*0.2;
+				info.m_additionalDamping = (i==5);
+			}
+			btRigidBody* body = new btRigidBody( info );
+			if (!ground)
+			{
+				body->setLinearVelocity( btVector3( 1, btScalar(i)*0.5, -1 ) );
+				body->setAngularVelocity( btVector3( btScalar(i), 2, -btScalar(i)*0.5 ) );
+			}
+			world.addRigidBody( body );
+			bodies.push_back( body );
+		}
+
+		for (int i=0;i<NUM_STEPS;i++)
+			world.stepSimulation( btScalar(1.)/btScalar(60.), 0 );
+
+		result.resizeNoInitialize( bodies.size() );
+		velocities.resizeNoInitialize( bodies.size() );
+		for (int i=0;i<bodies.size();i++)
+		{
+			result[i] = bodies[i]->getWorldTransform();
+			velocities[i] = bodies[i]->getAngularVelocity();
+			world.removeRigidBody( bodies[i] );
+			delete bodies[i];
+		}
+	}
+
+public:
+
+	void setUp()
+	{
+	}
+
+	void tearDown()
+	{
+	}
+
+	void testMatchesPerBodyIntegration()
+	{
+		btAlignedObjectArray<btTransform> perBody, pooled;
+		btAlignedObjectArray<btVector3> perBodyVelocities, pooledVelocities;
+		runScene( false, perBody, perBodyVelocities );
+		runScene( true, pooled, pooledVelocities );
+
+		CPPUNIT_ASSERT_EQUAL( perBody.size(), pooled.size() );
+		for (int i=1;i<pooled.size();i++)
+		{
+			//the pool only changes the rounding of the integration, the differences measured after 60 steps
+			//are below 1e-6 for the positions and the rotations and 2e-5 for the angular velocities
+			CPPUNIT_ASSERT( (pooled[i].getOrigin()-perBody[i].getOrigin()).length() < btScalar(1e-4) );
+			CPPUNIT_ASSERT( btFabs( pooled[i].getRotation().dot( perBody[i].getRotation() ) ) > btScalar(1.-1e-5) );
+			CPPUNIT_ASSERT( (pooledVelocities[i]-perBodyVelocities[i]).length() < btScalar(1e-3) );
+		}
+	}
+
+	CPPUNIT_TEST_SUITE(TestRigidBodyStatePool);
+	CPPUNIT_TEST(testMatchesPerBodyIntegration);
+	CPPUNIT_TEST_SUITE_END();
+};
+
+#endif
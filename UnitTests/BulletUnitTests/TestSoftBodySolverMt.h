@@ -0,0 +1,256 @@
+#ifndef TESTSOFTBODYSOLVERMT_HAS_BEEN_INCLUDED
+#define TESTSOFTBODYSOLVERMT_HAS_BEEN_INCLUDED
+
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+#include "TestSupport.h"
+
+#include "btBulletDynamicsCommon.h"
+#include "BulletSoftBody/btSoftRigidDynamicsWorld.h"
+#include "BulletSoftBody/btSoftBodyRigidBodyCollisionConfiguration.h"
+#include "BulletSoftBody/btSoftBodyHelpers.h"
+#include "BulletSoftBody/btDefaultSoftBodySolverMt.h"
+#include "LinearMath/btThreads.h"
+
+// ---------------------------------------------------------------------------
+
+class TestSoftBodySolverMt : public CppUnit::TestFixture
+{
+	struct Scene
+	{
+		btSoftBodyRigidBodyCollisionConfiguration	mCollisionConfig;
+		btCollisionDispatcher						mDispatcher;
+		btDbvtBroadphase							mBroadphase;
+		btSequentialImpulseConstraintSolver			mSolver;
+		btSoftRigidDynamicsWorld					mWorld;
+		btBoxShape									mGroundShape;
+		btBoxShape									mBoxShape;
+		btRigidBody*								mGround;
+		btRigidBody*								mBox;
+		btAlignedObjectArray<btSoftBody*>			mCloths;
+
+		Scene( btSoftBodySolver* softBodySolver )
+			:mDispatcher( &mCollisionConfig ),
+			mWorld( &mDispatcher, &mBroadphase, &mSolver, &mCollisionConfig, softBodySolver ),
+			mGroundShape( btVector3( 20, 1, 20 ) ),
+			mBoxShape( btVector3( btScalar(0.2), btScalar(0.2), btScalar(0.2) ) ),
+			mGround( 0 ),
+			mBox( 0 )
+		{
+			btTransform tr;
+			tr.setIdentity();
+			tr.setOrigin( btVector3( 0, -1, 0 ) );
+			btRigidBody::btRigidBodyConstructionInfo groundInfo( 0, 0, &mGroundShape );
+			groundInfo.m_startWorldTransform = tr;
+			mGround = new btRigidBody( groundInfo );
+			mWorld.addRigidBody( mGround );
+		}
+
+		~Scene()
+		{
+			for (int i=0;i<mCloths.size();i++)
+			{
+				mWorld.removeSoftBody( mCloths[i] );
+				delete mCloths[i];
+			}
+			if (mBox)
+			{
+				mWorld.removeRigidBody( mBox );
+				delete mBox;
+			}
+			mWorld.removeRigidBody( mGround );
+			delete mGround;
+		}
+
+		///a square cloth of res x res nodes, falling on the ground
+		btSoftBody* addCloth( const btVector3& center, btScalar halfSize, int res )
+		{
+			btSoftBody* cloth = btSoftBodyHelpers::CreatePatch( mWorld.getWorldInfo(),
+				center+btVector3( -halfSize, 0, -halfSize ),
+				center+btVector3( halfSize, 0, -halfSize ),
+				center+btVector3( -halfSize, 0, halfSize ),
+				center+btVector3( halfSize, 0, halfSize ),
+				res, res, 0, true );
+			cloth->generateBendingConstraints( 2 );
+			cloth->getCollisionShape()->setMargin( btScalar(0.05) );
+			cloth->setTotalMass( 1 );
+			mWorld.addSoftBody( cloth );
+			mCloths.push_back( cloth );
+			return cloth;
+		}
+
+		///a cloth with a corner anchored to a dynamic box
+		void addAnchoredCloth( const btVector3& center )
+		{
+			btVector3 inertia;
+			mBoxShape.calculateLocalInertia( 1, inertia );
+			btRigidBody::btRigidBodyConstructionInfo boxInfo( 1, 0, &mBoxShape, inertia );
+			boxInfo.m_startWorldTransform.setIdentity();
+			boxInfo.m_startWorldTransform.setOrigin( center+btVector3( -1, btScalar(0.3), -1 ) );
+			mBox = new btRigidBody( boxInfo );
+			mWorld.addRigidBody( mBox );
+			btSoftBody* cloth = addCloth( center, 1, 9 );
+			cloth->appendAnchor( 0, mBox );
+		}
+
+		void step( int numSteps )
+		{
+			for (int i=0;i<numSteps;i++)
+				mWorld.stepSimulation( btScalar(1.)/btScalar(60.), 0 );
+		}
+	};
+
+	///the same scenes give the same node positions
+	static void checkSameNodes( Scene& a, Scene& b )
+	{
+		CPPUNIT_ASSERT_EQUAL( a.mCloths.size(), b.mCloths.size() );
+		for (int i=0;i<a.mCloths.size();i++)
+		{
+			const btSoftBody* clothA = a.mCloths[i];
+			const btSoftBody* clothB = b.mCloths[i];
+			CPPUNIT_ASSERT_EQUAL( clothA->m_nodes.size(), clothB->m_nodes.size() );
+			for (int j=0;j<clothA->m_nodes.size();j++)
+			{
+				CPPUNIT_ASSERT( clothA->m_nodes[j].m_x == clothB->m_nodes[j].m_x );
+				CPPUNIT_ASSERT( clothA->m_nodes[j].m_v == clothB->m_nodes[j].m_v );
+			}
+		}
+		if (a.mBox)
+			CPPUNIT_ASSERT( a.mBox->getWorldTransform().getOrigin() == b.mBox->getWorldTransform().getOrigin() );
+	}
+
+	static void buildScene( Scene& scene, bool largeCloth )
+	{
+		for (int i=0;i<6;i++)
+			scene.addCloth( btVector3( btScalar(i%3)*3-3, btScalar(1.)+btScalar(i)*btScalar(0.1), btScalar(i/3)*3-2 ), 1, 9 );
+		scene.addAnchoredCloth( btVector3( 0, 2, 5 ) );
+		if (largeCloth)
+			scene.addCloth( btVector3( 0, 3, 0 ), 5, 40 );
+	}
+
+	struct LinkLess
+	{
+		bool operator() ( const btVector3& a, const btVector3& b ) const
+		{
+			if (a.x() != b.x())
+				return a.x() < b.x();
+			return a.y() < b.y();
+		}
+	};
+
+public:
+
+	void setUp()
+	{
+	}
+
+	void tearDown()
+	{
+		btSetTaskScheduler( 0 );
+	}
+
+	void testMatchesDefaultSolver()
+	{
+		TestThreadPool threads;
+
+		btDefaultSoftBodySolver defaultSolver;
+		btDefaultSoftBodySolverMt solverMt;
+		Scene reference( &defaultSolver );
+		Scene scene( &solverMt );
+		buildScene( reference, false );
+		buildScene( scene, false );
+		reference.step( 60 );
+		scene.step( 60 );
+
+		//no soft body is large enough to be batched, and they don't depend on each other: the results are the same
+		for (int i=0;i<scene.mCloths.size();i++)
+			CPPUNIT_ASSERT( !solverMt.getLinkBatches( scene.mCloths[i] ) );
+		checkSameNodes( reference, scene );
+		//the cloths are lying on the ground
+		CPPUNIT_ASSERT( btFabs( scene.mCloths[0]->m_nodes[40].m_x.getY() ) < btScalar(0.2) );
+	}
+
+	void testLinkBatches()
+	{
+		btDefaultSoftBodySolverMt solverMt;
+		Scene scene( &solverMt );
+		btSoftBody* cloth = scene.addCloth( btVector3( 0, 3, 0 ), 5, 40 );
+		CPPUNIT_ASSERT( cloth->m_links.size() >= solverMt.getMinLinksForBatching() );
+
+		btAlignedObjectArray<btVector3> links;
+		for (int i=0;i<cloth->m_links.size();i++)
+			links.push_back( btVector3( btScalar(cloth->m_links[i].m_n[0]-&cloth->m_nodes[0]), btScalar(cloth->m_links[i].m_n[1]-&cloth->m_nodes[0]), 0 ) );
+		scene.step( 1 );
+
+		const btDefaultSoftBodySolverMt::btSoftBodyLinkBatches* batches = solverMt.getLinkBatches( cloth );
+		CPPUNIT_ASSERT( batches );
+		CPPUNIT_ASSERT( batches->m_numBatches > 1 );
+		CPPUNIT_ASSERT( batches->m_numBatches <= btDefaultSoftBodySolverMt::MAX_LINK_BATCHES );
+		CPPUNIT_ASSERT_EQUAL( 0, batches->m_batchStarts[0] );
+		CPPUNIT_ASSERT_EQUAL( cloth->m_links.size(), batches->m_batchStarts[batches->m_numBatches] );
+
+		//the links of a batch don't share nodes
+		btAlignedObjectArray<int> lastBatch;
+		lastBatch.resize( cloth->m_nodes.size(), -1 );
+		for (int b=0;b<batches->m_numBatches;b++)
+		{
+			for (int i=batches->m_batchStarts[b];i<batches->m_batchStarts[b+1];i++)
+			{
+				for (int k=0;k<2;k++)
+				{
+					int node = int(cloth->m_links[i].m_n[k]-&cloth->m_nodes[0]);
+					CPPUNIT_ASSERT( lastBatch[node] != b );
+					lastBatch[node] = b;
+				}
+			}
+		}
+
+		//the links were only reordered
+		btAlignedObjectArray<btVector3> sortedLinks;
+		for (int i=0;i<cloth->m_links.size();i++)
+			sortedLinks.push_back( btVector3( btScalar(cloth->m_links[i].m_n[0]-&cloth->m_nodes[0]), btScalar(cloth->m_links[i].m_n[1]-&cloth->m_nodes[0]), 0 ) );
+		links.quickSort( LinkLess() );
+		sortedLinks.quickSort( LinkLess() );
+		CPPUNIT_ASSERT_EQUAL( links.size(), sortedLinks.size() );
+		for (int i=0;i<links.size();i++)
+			CPPUNIT_ASSERT( links[i] == sortedLinks[i] );
+
+		//the batches are kept while the links don't change
+		scene.step( 1 );
+		CPPUNIT_ASSERT( batches == solverMt.getLinkBatches( cloth ) );
+		CPPUNIT_ASSERT_EQUAL( cloth->m_links.size(), batches->m_numLinks );
+	}
+
+	void testThreadCountDeterminism()
+	{
+		btDefaultSoftBodySolverMt sequentialSolver;
+		btDefaultSoftBodySolverMt solverMt;
+		Scene reference( &sequentialSolver );
+		Scene scene( &solverMt );
+		buildScene( reference, true );
+		buildScene( scene, true );
+		reference.step( 60 );
+
+		TestThreadPool threads;
+		if (threads.skipWithoutThreads( "TestSoftBodySolverMt::testThreadCountDeterminism" ))
+			return;
+		scene.step( 60 );
+
+		checkSameNodes( reference, scene );
+		btSoftBody* largeCloth = scene.mCloths[scene.mCloths.size()-1];
+		CPPUNIT_ASSERT( solverMt.getLinkBatches( largeCloth ) );
+		for (int i=0;i<largeCloth->m_nodes.size();i++)
+		{
+			const btVector3& x = largeCloth->m_nodes[i].m_x;
+			CPPUNIT_ASSERT( x.getY() > btScalar(-0.2) && x.getY() < btScalar(3.) );
+		}
+	}
+
+	CPPUNIT_TEST_SUITE(TestSoftBodySolverMt);
+	CPPUNIT_TEST(testMatchesDefaultSolver);
+	CPPUNIT_TEST(testLinkBatches);
+	CPPUNIT_TEST(testThreadCountDeterminism);
+	CPPUNIT_TEST_SUITE_END();
+};
+
+#endif
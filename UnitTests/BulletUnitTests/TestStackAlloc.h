@@ -0,0 +1,315 @@
+#ifndef TESTSTACKALLOC_HAS_BEEN_INCLUDED
+#define TESTSTACKALLOC_HAS_BEEN_INCLUDED
+
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+#include "TestSupport.h"
+
+#include "btBulletDynamicsCommon.h"
+#include "LinearMath/btStackAlloc.h"
+#include "LinearMath/btThreads.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// ---------------------------------------------------------------------------
+
+class TestStackAlloc : public CppUnit::TestFixture
+{
+	enum
+	{
+		NUM_ITEMS = 2000,
+		NUM_COMPOUNDS = 12,
+		NUM_SPHERES = 6
+	};
+
+	static int& getNumAllocations()
+	{
+		static int numAllocations = 0;
+		return numAllocations;
+	}
+
+	static void* countingAlloc( size_t size )
+	{
+		getNumAllocations()++;
+		return malloc( size );
+	}
+
+	static void countingFree( void* ptr )
+	{
+		free( ptr );
+	}
+
+	static bool isAligned( const void* ptr )
+	{
+		return (size_t(ptr)&15) == 0;
+	}
+
+	///solves without the stack allocator, so the solver pools stay on the heap
+	class HeapConstraintSolver : public btSequentialImpulseConstraintSolver
+	{
+	public:
+		virtual btScalar solveGroup(btCollisionObject** bodies,int numBodies,btPersistentManifold** manifold,int numManifolds,btTypedConstraint** constraints,int numConstraints,const btContactSolverInfo& info, btIDebugDraw* debugDrawer, btStackAlloc* stackAlloc,btDispatcher* dispatcher)
+		{
+			(void)stackAlloc;
+			return btSequentialImpulseConstraintSolver::solveGroup( bodies, numBodies, manifold, numManifolds, constraints, numConstraints, info, debugDrawer, 0, dispatcher );
+		}
+	};
+
+	///stacks of two compounds on a box, so that there are compound-convex and compound-compound pairs, and a chain of spheres
+	struct Scene
+	{
+		btDefaultCollisionConfiguration	mCollisionConfig;
+		btCollisionDispatcher			mDispatcher;
+		btDbvtBroadphase				mBroadphase;
+		btSequentialImpulseConstraintSolver*	mSolver;
+		btDiscreteDynamicsWorld*		mWorld;
+		btBoxShape						mGroundShape;
+		btBoxShape						mBoxShape;
+		btSphereShape					mSphereShape;
+		btSphereShape					mChildSphereShape;
+		btCompoundShape					mCompoundShape;
+		btAlignedObjectArray<btRigidBody*>	mBodies;
+		btAlignedObjectArray<btTypedConstraint*>	mConstraints;
+
+		Scene( bool useStackAlloc )
+			:mDispatcher( &mCollisionConfig ),
+			mGroundShape( btVector3( 20, 1, 20 ) ),
+			mBoxShape( btVector3( btScalar(0.5), btScalar(0.25), btScalar(0.25) ) ),
+			mSphereShape( btScalar(0.3) ),
+			mChildSphereShape( btScalar(0.2) )
+		{
+			mSolver = useStackAlloc ? new btSequentialImpulseConstraintSolver : new HeapConstraintSolver;
+			mWorld = new btDiscreteDynamicsWorld( &mDispatcher, &mBroadphase, mSolver, &mCollisionConfig );
+			mWorld->setGravity( btVector3( 0, -10, 0 ) );
+
+			btTransform tr;
+			tr.setIdentity();
+			tr.setOrigin( btVector3( btScalar(-0.5), 0, 0 ) );
+			mCompoundShape.addChildShape( tr, &mBoxShape );
+			tr.setOrigin( btVector3( btScalar(0.5), 0, 0 ) );
+			tr.setRotation( btQuaternion( btVector3( 0, 1, 0 ), SIMD_HALF_PI ) );
+			mCompoundShape.addChildShape( tr, &mBoxShape );
+			tr.setIdentity();
+			mCompoundShape.addChildShape( tr, &mChildSphereShape );
+
+			tr.setIdentity();
+			tr.setOrigin( btVector3( 0, -1, 0 ) );
+			addBody( 0, tr, &mGroundShape );
+			for (int i=0;i<NUM_COMPOUNDS;i++)
+			{
+				int stack = i/2;
+				tr.setOrigin( btVector3( btScalar(stack%3)*3-3, btScalar(0.26)+btScalar(i%2)*btScalar(0.52), btScalar(stack/3)*3-3 ) );
+				tr.setRotation( btQuaternion( btVector3( 0, 1, 0 ), btScalar(0.3)+btScalar(i%2)*btScalar(0.8) ) );
+				addBody( 1, tr, &mCompoundShape );
+			}
+			tr.setIdentity();
+			for (int i=0;i<NUM_SPHERES;i++)
+			{
+				tr.setOrigin( btVector3( btScalar(i)-btScalar(2.5), btScalar(2), btScalar(6) ) );
+				addBody( 1, tr, &mSphereShape );
+			}
+			//a chain of spheres, so that the solver also has non-contact rows
+			for (int i=1;i<NUM_SPHERES;i++)
+			{
+				btRigidBody* bodyA = mBodies[NUM_COMPOUNDS+i];
+				btRigidBody* bodyB = mBodies[NUM_COMPOUNDS+i+1];
+				btTypedConstraint* constraint = new btPoint2PointConstraint( *bodyA, *bodyB, btVector3( btScalar(0.5), 0, 0 ), btVector3( btScalar(-0.5), 0, 0 ) );
+				mWorld->addConstraint( constraint, true );
+				mConstraints.push_back( constraint );
+			}
+		}
+
+		~Scene()
+		{
+			for (int i=0;i<mConstraints.size();i++)
+			{
+				mWorld->removeConstraint( mConstraints[i] );
+				delete mConstraints[i];
+			}
+			for (int i=0;i<mBodies.size();i++)
+			{
+				mWorld->removeRigidBody( mBodies[i] );
+				delete mBodies[i];
+			}
+			delete mWorld;
+			delete mSolver;
+		}
+
+		void addBody( btScalar mass, const btTransform& tr, btCollisionShape* shape )
+		{
+			btVector3 inertia( 0, 0, 0 );
+			if (mass>0)
+				shape->calculateLocalInertia( mass, inertia );
+			btRigidBody::btRigidBodyConstructionInfo info( mass, 0, shape, inertia );
+			info.m_startWorldTransform = tr;
+			btRigidBody* body = new btRigidBody( info );
+			//the solver keeps running on the resting pile, and the damping lets it come to rest quickly
+			body->setActivationState( DISABLE_DEACTIVATION );
+			body->setDamping( btScalar(0.2), btScalar(0.8) );
+			mWorld->addRigidBody( body );
+			mBodies.push_back( body );
+		}
+
+		void step( int numSteps )
+		{
+			for (int i=0;i<numSteps;i++)
+				mWorld->stepSimulation( btScalar(1.)/btScalar(60.), 0 );
+		}
+	};
+
+	struct ThreadArenaBody : public btIParallelForBody
+	{
+		btThreadStackAlloc*	mThreadStackAlloc;
+		int*				mResults;
+
+		void forLoop( int iBegin, int iEnd ) const
+		{
+			for (int i=iBegin;i<iEnd;i++)
+			{
+				btStackAlloc* stackAlloc = mThreadStackAlloc->getStackAlloc();
+				btBlock* block = stackAlloc->beginBlock();
+				int n = 1+i%61;
+				int* values = (int*)stackAlloc->allocate( sizeof(int)*n );
+				for (int k=0;k<n;k++)
+					values[k] = i+k;
+				//a nested block, its allocations overlap the released ones of the previous items
+				btBlock* nested = stackAlloc->beginBlock();
+				int* scratch = (int*)stackAlloc->allocate( sizeof(int)*(n+3) );
+				for (int k=0;k<n+3;k++)
+					scratch[k] = -1;
+				stackAlloc->endBlock( nested );
+				int sum = 0;
+				for (int k=0;k<n;k++)
+					sum += values[k]-k;
+				mResults[i] = sum/n;
+				stackAlloc->endBlock( block );
+			}
+		}
+	};
+
+public:
+
+	void setUp()
+	{
+	}
+
+	void tearDown()
+	{
+		btAlignedAllocSetCustom( 0, 0 );
+		btSetTaskScheduler( 0 );
+	}
+
+	void testGrowAndReset()
+	{
+		btStackAlloc stackAlloc( 64 );
+		for (int frame=0;frame<3;frame++)
+		{
+			btBlock* block = stackAlloc.beginBlock();
+			unsigned char* a = stackAlloc.allocate( 20 );
+			btBlock* nested = stackAlloc.beginBlock();
+			unsigned char* b = stackAlloc.allocate( 1000 );
+			unsigned char* c = stackAlloc.allocate( 3 );
+			CPPUNIT_ASSERT( isAligned( a ) && isAligned( b ) && isAligned( c ) );
+			memset( a, 1, 20 );
+			memset( b, 2, 1000 );
+			memset( c, 3, 3 );
+			CPPUNIT_ASSERT_EQUAL( 1, int(a[19]) );
+			CPPUNIT_ASSERT_EQUAL( 2, int(b[999]) );
+			//only the first frame doesn't fit
+			CPPUNIT_ASSERT_EQUAL( frame==0, stackAlloc.getOverflowMemory() > 0 );
+			stackAlloc.endBlock( nested );
+			int available = stackAlloc.getAvailableMemory();
+			//the released memory is handed out again
+			btBlock* again = stackAlloc.beginBlock();
+			CPPUNIT_ASSERT( stackAlloc.allocate( 16 ) != 0 );
+			stackAlloc.endBlock( again );
+			CPPUNIT_ASSERT_EQUAL( available, stackAlloc.getAvailableMemory() );
+			stackAlloc.endBlock( block );
+			CPPUNIT_ASSERT_EQUAL( 0, stackAlloc.getOverflowMemory() );
+			CPPUNIT_ASSERT( stackAlloc.getPeakMemory() >= 20+1000+3 );
+
+			stackAlloc.reset();
+			CPPUNIT_ASSERT( stackAlloc.getAvailableMemory() >= 20+1000+3 );
+		}
+	}
+
+	void testThreadStackAlloc()
+	{
+		TestThreadPool threads;
+		if (threads.skipWithoutThreads( "TestStackAlloc::testThreadStackAlloc" ))
+			return;
+
+		btStackAlloc mainStackAlloc( 0 );
+		btThreadStackAlloc threadStackAlloc( &mainStackAlloc );
+		CPPUNIT_ASSERT( threadStackAlloc.getStackAlloc() == &mainStackAlloc );
+
+		btAlignedObjectArray<int> results;
+		results.resize( NUM_ITEMS );
+		ThreadArenaBody body;
+		body.mThreadStackAlloc = &threadStackAlloc;
+		body.mResults = &results[0];
+		for (int frame=0;frame<3;frame++)
+		{
+			for (int i=0;i<NUM_ITEMS;i++)
+				results[i] = -1;
+			btParallelFor( 0, NUM_ITEMS, 8, body );
+			for (int i=0;i<NUM_ITEMS;i++)
+				CPPUNIT_ASSERT_EQUAL( i, results[i] );
+			for (int t=0;t<BT_MAX_THREAD_COUNT;t++)
+			{
+				btStackAlloc* stackAlloc = threadStackAlloc.getStackAlloc( t );
+				if (stackAlloc)
+				{
+					CPPUNIT_ASSERT_EQUAL( 0, stackAlloc->getOverflowMemory() );
+					for (int u=t+1;u<BT_MAX_THREAD_COUNT;u++)
+						CPPUNIT_ASSERT( stackAlloc != threadStackAlloc.getStackAlloc( u ) );
+				}
+			}
+			threadStackAlloc.reset();
+		}
+	}
+
+	void testSameResultsAsHeapPools()
+	{
+		Scene heap( false );
+		Scene arena( true );
+		heap.step( 90 );
+		arena.step( 90 );
+		for (int i=0;i<arena.mBodies.size();i++)
+		{
+			CPPUNIT_ASSERT( heap.mBodies[i]->getWorldTransform().getOrigin() == arena.mBodies[i]->getWorldTransform().getOrigin() );
+			CPPUNIT_ASSERT( heap.mBodies[i]->getWorldTransform().getBasis() == arena.mBodies[i]->getWorldTransform().getBasis() );
+			CPPUNIT_ASSERT( heap.mBodies[i]->getLinearVelocity() == arena.mBodies[i]->getLinearVelocity() );
+		}
+		//the pile is resting on the ground
+		CPPUNIT_ASSERT( arena.mBodies[1]->getWorldTransform().getOrigin().getY() > 0 );
+		CPPUNIT_ASSERT( arena.mBodies[1]->getWorldTransform().getOrigin().getY() < 1 );
+	}
+
+	void testNoHeapAllocationsInSteadyState()
+	{
+		Scene scene( true );
+		scene.step( 90 );
+		CPPUNIT_ASSERT( scene.mDispatcher.getNumManifolds() > NUM_COMPOUNDS );
+
+		getNumAllocations() = 0;
+		btAlignedAllocSetCustom( countingAlloc, countingFree );
+		scene.step( 30 );
+		btAlignedAllocSetCustom( 0, 0 );
+		CPPUNIT_ASSERT_EQUAL( 0, getNumAllocations() );
+
+		btStackAlloc* stackAlloc = scene.mCollisionConfig.getStackAllocator();
+		CPPUNIT_ASSERT( stackAlloc->getPeakMemory() > 0 );
+		CPPUNIT_ASSERT_EQUAL( 0, stackAlloc->getOverflowMemory() );
+	}
+
+	CPPUNIT_TEST_SUITE(TestStackAlloc);
+	CPPUNIT_TEST(testGrowAndReset);
+	CPPUNIT_TEST(testThreadStackAlloc);
+	CPPUNIT_TEST(testSameResultsAsHeapPools);
+	CPPUNIT_TEST(testNoHeapAllocationsInSteadyState);
+	CPPUNIT_TEST_SUITE_END();
+};
+
+#endif
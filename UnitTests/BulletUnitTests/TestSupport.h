@@ -0,0 +1,80 @@
+#ifndef TESTSUPPORT_HAS_BEEN_INCLUDED
+#define TESTSUPPORT_HAS_BEEN_INCLUDED
+
+#include <stdio.h>
+
+#include "cppunit/TestFixture.h"
+
+#include "LinearMath/btVector3.h"
+#include "LinearMath/btThreads.h"
+
+// ---------------------------------------------------------------------------
+
+///TestRandomFixture is a test fixture with a small linear congruential generator, seeded through mSeed.
+///The sequence is the same on every platform, unlike rand().
+class TestRandomFixture : public CppUnit::TestFixture
+{
+protected:
+	unsigned int mSeed;
+
+	unsigned int randBits()
+	{
+		mSeed = mSeed*1664525u+1013904223u;
+		return mSeed>>8;
+	}
+
+	int randInt( int n )
+	{
+		return int(randBits()%unsigned(n));
+	}
+
+	btScalar rand01()
+	{
+		return btScalar(randBits())/btScalar(1<<24);
+	}
+
+	btVector3 randVector( btScalar scale )
+	{
+		return btVector3( rand01()-btScalar(0.5), rand01()-btScalar(0.5), rand01()-btScalar(0.5) )*scale;
+	}
+};
+
+// ---------------------------------------------------------------------------
+
+///TestThreadPool installs the default task scheduler with numThreads threads while it is in scope.
+///Bullet built without BULLET2_MULTITHREADING has no thread pool, the sequential scheduler stays installed.
+class TestThreadPool
+{
+	btITaskScheduler* mScheduler;
+
+public:
+	TestThreadPool( int numThreads = 4 )
+		:mScheduler( btCreateDefaultTaskScheduler( numThreads ) )
+	{
+		if (mScheduler)
+			btSetTaskScheduler( mScheduler );
+	}
+
+	~TestThreadPool()
+	{
+		btSetTaskScheduler( 0 );
+		delete mScheduler;
+	}
+
+	bool isAvailable() const
+	{
+		return mScheduler != 0;
+	}
+
+	///reports the test as skipped when there is no thread pool, so that it returns instead of
+	///passing by comparing a sequential run with itself
+	bool skipWithoutThreads( const char* testName ) const
+	{
+		if (mScheduler)
+			return false;
+		printf( "\n%s skipped: no thread pool, build with BULLET2_MULTITHREADING\n", testName );
+		return true;
+	}
+};
+
+#endif //TESTSUPPORT_HAS_BEEN_INCLUDED
@@ -0,0 +1,393 @@
+#ifndef TESTTHREADPOOLSUPPORT_HAS_BEEN_INCLUDED
+#define TESTTHREADPOOLSUPPORT_HAS_BEEN_INCLUDED
+
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+
+#include "btBulletDynamicsCommon.h"
+#include "BulletMultiThreaded/btThreadPoolSupport.h"
+#include "BulletMultiThreaded/SequentialThreadSupport.h"
+#include "BulletMultiThreaded/SpuGatheringCollisionDispatcher.h"
+#include "BulletMultiThreaded/SpuNarrowPhaseCollisionTask/SpuGatheringCollisionTask.h"
+#include "BulletCollision/CollisionDispatch/btSimulationIslandManager.h"
+#include "BulletMultiThreaded/btParallelConstraintSolver.h"
+
+// ---------------------------------------------------------------------------
+
+class TestThreadPoolSupport : public CppUnit::TestFixture
+{
+	enum
+	{
+		NUM_THREADS = 4,
+		NUM_TASKS = 1000,
+		NUM_ROUNDS = 20,
+		NUM_LOCKS = 100
+	};
+
+	struct TaskDesc
+	{
+		int				mInput;
+		int				mOutput;
+		int				mNumRuns;
+		void*			mLsMemory;
+		btBarrier*		mBarrier;
+		btCriticalSection*	mCriticalSection;
+		int*			mCounter;
+		int				mNumFailures;
+	};
+
+	static void* createLsMemory()
+	{
+		int* scratch = new int[16];
+		for (int i=0;i<16;i++)
+			scratch[i] = 0;
+		return scratch;
+	}
+
+	static void deleteLsMemory( btThreadSupportInterface& threadSupport )
+	{
+		for (int i=0;i<threadSupport.getNumTasks();i++)
+			delete[] (int*)threadSupport.getThreadLocalMemory( i );
+	}
+
+	static void squareTask( void* userPtr, void* lsMemory )
+	{
+		TaskDesc* desc = (TaskDesc*)userPtr;
+		desc->mOutput = desc->mInput*desc->mInput;
+		desc->mNumRuns++;
+		desc->mLsMemory = lsMemory;
+		//the scratch memory belongs to the thread, no lock needed
+		((int*)lsMemory)[0]++;
+	}
+
+	static void countTask( void* userPtr, void* lsMemory )
+	{
+		(void)lsMemory;
+		TaskDesc* desc = (TaskDesc*)userPtr;
+		int numTasks = desc->mBarrier->getMaxCount();
+		for (int r=0;r<NUM_ROUNDS;r++)
+		{
+			for (int i=0;i<NUM_LOCKS;i++)
+			{
+				desc->mCriticalSection->lock();
+				(*desc->mCounter)++;
+				desc->mCriticalSection->setSharedParam( 0, desc->mCriticalSection->getSharedParam( 0 )+1 );
+				desc->mCriticalSection->unlock();
+			}
+			desc->mBarrier->sync();
+			//every task has finished the round
+			if (*desc->mCounter != (r+1)*numTasks*NUM_LOCKS)
+				desc->mNumFailures++;
+			desc->mBarrier->sync();
+		}
+	}
+
+	///runs NUM_TASKS tasks the way the collision dispatcher does, at most one per task id at a time
+	static void runTasks( btThreadPoolSupport& threadSupport )
+	{
+		btAlignedObjectArray<TaskDesc> descs;
+		descs.resize( NUM_TASKS );
+		btAlignedObjectArray<int> taskDescs;
+		taskDescs.resize( threadSupport.getNumTasks(), -1 );
+		int numRunBefore = 0;
+		for (int t=0;t<threadSupport.getNumTasks();t++)
+			numRunBefore += threadSupport.getNumTasksRun( t );
+
+		for (int i=0;i<NUM_TASKS;i++)
+		{
+			descs[i].mInput = i-300;
+			descs[i].mOutput = 0;
+			descs[i].mNumRuns = 0;
+			descs[i].mLsMemory = 0;
+			unsigned int taskId = unsigned(i);
+			if (i >= threadSupport.getNumTasks())
+			{
+				unsigned int status;
+				threadSupport.waitForResponse( &taskId, &status );
+				CPPUNIT_ASSERT( int(taskId) < threadSupport.getNumTasks() );
+				CPPUNIT_ASSERT( taskDescs[taskId] >= 0 );
+			}
+			taskDescs[taskId] = i;
+			threadSupport.sendRequest( 1, (ppu_address_t)&descs[i], taskId );
+		}
+		for (int t=0;t<threadSupport.getNumTasks();t++)
+		{
+			unsigned int taskId, status;
+			threadSupport.waitForResponse( &taskId, &status );
+		}
+
+		for (int i=0;i<NUM_TASKS;i++)
+		{
+			CPPUNIT_ASSERT_EQUAL( 1, descs[i].mNumRuns );
+			CPPUNIT_ASSERT_EQUAL( (i-300)*(i-300), descs[i].mOutput );
+		}
+		//the last task of every id ran with the memory of its thread
+		for (int t=0;t<threadSupport.getNumTasks();t++)
+			CPPUNIT_ASSERT( descs[taskDescs[t]].mLsMemory == threadSupport.getThreadLocalMemory( t ) );
+
+		int numRun = 0;
+		for (int t=0;t<threadSupport.getNumTasks();t++)
+			numRun += threadSupport.getNumTasksRun( t );
+		CPPUNIT_ASSERT_EQUAL( int(NUM_TASKS), numRun-numRunBefore );
+	}
+
+	///several tasks queued on every worker before the first response
+	static void runQueuedTasks( btThreadPoolSupport& threadSupport, int tasksPerThread )
+	{
+		int numTasks = threadSupport.getNumTasks()*tasksPerThread;
+		btAlignedObjectArray<TaskDesc> descs;
+		descs.resize( numTasks );
+		for (int i=0;i<numTasks;i++)
+		{
+			descs[i].mInput = i;
+			descs[i].mNumRuns = 0;
+			threadSupport.sendRequest( 1, (ppu_address_t)&descs[i], unsigned(i) );
+		}
+		btAlignedObjectArray<int> numResponses;
+		numResponses.resize( threadSupport.getNumTasks(), 0 );
+		for (int i=0;i<numTasks;i++)
+		{
+			unsigned int taskId, status;
+			threadSupport.waitForResponse( &taskId, &status );
+			CPPUNIT_ASSERT( int(taskId) < numTasks );
+			numResponses[taskId % threadSupport.getNumTasks()]++;
+		}
+		for (int t=0;t<threadSupport.getNumTasks();t++)
+			CPPUNIT_ASSERT_EQUAL( tasksPerThread, numResponses[t] );
+		for (int i=0;i<numTasks;i++)
+		{
+			CPPUNIT_ASSERT_EQUAL( 1, descs[i].mNumRuns );
+			CPPUNIT_ASSERT_EQUAL( i*i, descs[i].mOutput );
+			CPPUNIT_ASSERT( descs[i].mLsMemory == threadSupport.getThreadLocalMemory( i ) );
+		}
+	}
+
+	static void runCountTasks( btThreadPoolSupport& threadSupport )
+	{
+		btBarrier* barrier = threadSupport.createBarrier();
+		btCriticalSection* criticalSection = threadSupport.createCriticalSection();
+		CPPUNIT_ASSERT_EQUAL( threadSupport.getNumTasks(), barrier->getMaxCount() );
+		criticalSection->setSharedParam( 0, 0 );
+		int counter = 0;
+
+		btAlignedObjectArray<TaskDesc> descs;
+		descs.resize( threadSupport.getNumTasks() );
+		for (int t=0;t<threadSupport.getNumTasks();t++)
+		{
+			descs[t].mBarrier = barrier;
+			descs[t].mCriticalSection = criticalSection;
+			descs[t].mCounter = &counter;
+			descs[t].mNumFailures = 0;
+			threadSupport.sendRequest( 1, (ppu_address_t)&descs[t], unsigned(t) );
+		}
+		for (int t=0;t<threadSupport.getNumTasks();t++)
+		{
+			unsigned int taskId, status;
+			threadSupport.waitForResponse( &taskId, &status );
+		}
+
+		int expected = threadSupport.getNumTasks()*NUM_ROUNDS*NUM_LOCKS;
+		CPPUNIT_ASSERT_EQUAL( expected, counter );
+		CPPUNIT_ASSERT_EQUAL( unsigned(expected), criticalSection->getSharedParam( 0 ) );
+		for (int t=0;t<threadSupport.getNumTasks();t++)
+			CPPUNIT_ASSERT_EQUAL( 0, descs[t].mNumFailures );
+
+		threadSupport.deleteBarrier( barrier );
+		threadSupport.deleteCriticalSection( criticalSection );
+	}
+
+	///stacks of boxes on a static ground
+	struct Scene
+	{
+		btDefaultCollisionConfiguration	mCollisionConfig;
+		btCollisionDispatcher*			mDispatcher;
+		btDbvtBroadphase				mBroadphase;
+		btConstraintSolver*				mSolver;
+		btDiscreteDynamicsWorld*		mWorld;
+		btBoxShape						mGroundShape;
+		btBoxShape						mBoxShape;
+		btAlignedObjectArray<btRigidBody*>	mBodies;
+
+		Scene( btThreadSupportInterface* collisionThreads, btThreadSupportInterface* solverThreads )
+			:mGroundShape( btVector3( 50, 1, 50 ) ),
+			mBoxShape( btVector3( btScalar(0.5), btScalar(0.5), btScalar(0.5) ) )
+		{
+			if (collisionThreads)
+				mDispatcher = new SpuGatheringCollisionDispatcher( collisionThreads, collisionThreads->getNumTasks(), &mCollisionConfig );
+			else
+				mDispatcher = new btCollisionDispatcher( &mCollisionConfig );
+			if (solverThreads)
+				mSolver = new btParallelConstraintSolver( solverThreads );
+			else
+				mSolver = new btSequentialImpulseConstraintSolver;
+			mWorld = new btDiscreteDynamicsWorld( mDispatcher, &mBroadphase, mSolver, &mCollisionConfig );
+			//the threaded btParallelConstraintSolver needs all bodies, the static ones too, in one group
+			if (solverThreads)
+				mWorld->getSimulationIslandManager()->setSplitIslands( false );
+
+			btRigidBody::btRigidBodyConstructionInfo groundInfo( 0, 0, &mGroundShape );
+			groundInfo.m_startWorldTransform.setIdentity();
+			groundInfo.m_startWorldTransform.setOrigin( btVector3( 0, -1, 0 ) );
+			addBody( new btRigidBody( groundInfo ) );
+
+			btVector3 inertia;
+			mBoxShape.calculateLocalInertia( 1, inertia );
+			for (int s=0;s<8;s++)
+			{
+				for (int i=0;i<5;i++)
+				{
+					btRigidBody::btRigidBodyConstructionInfo info( 1, 0, &mBoxShape, inertia );
+					info.m_startWorldTransform.setIdentity();
+					info.m_startWorldTransform.setOrigin( btVector3( btScalar(s%4)*3-4, btScalar(0.5)+btScalar(i)*btScalar(1.01), btScalar(s/4)*3-1 ) );
+					addBody( new btRigidBody( info ) );
+				}
+			}
+		}
+
+		~Scene()
+		{
+			for (int i=0;i<mBodies.size();i++)
+			{
+				mWorld->removeRigidBody( mBodies[i] );
+				delete mBodies[i];
+			}
+			delete mWorld;
+			delete mSolver;
+			delete mDispatcher;
+		}
+
+		void addBody( btRigidBody* body )
+		{
+			mWorld->addRigidBody( body );
+			mBodies.push_back( body );
+		}
+
+		void step( int numSteps )
+		{
+			for (int i=0;i<numSteps;i++)
+				mWorld->stepSimulation( btScalar(1.)/btScalar(60.), 0 );
+		}
+	};
+
+public:
+
+	void setUp()
+	{
+	}
+
+	void tearDown()
+	{
+	}
+
+	void testTasks()
+	{
+		btThreadPoolSupport threadSupport( btThreadPoolSupport::ThreadConstructionInfo( "TestThreadPool", squareTask, createLsMemory, NUM_THREADS ) );
+		CPPUNIT_ASSERT( threadSupport.isStarted() );
+		CPPUNIT_ASSERT_EQUAL( int(NUM_THREADS), threadSupport.getNumTasks() );
+		for (int t=1;t<threadSupport.getNumTasks();t++)
+			CPPUNIT_ASSERT( threadSupport.getThreadLocalMemory( t ) != threadSupport.getThreadLocalMemory( t-1 ) );
+
+		runTasks( threadSupport );
+		runQueuedTasks( threadSupport, 3 );
+		int numRun = 0;
+		for (int t=0;t<threadSupport.getNumTasks();t++)
+		{
+			//the tasks counted in the scratch memory of their thread
+			CPPUNIT_ASSERT_EQUAL( threadSupport.getNumTasksRun( t ), ((int*)threadSupport.getThreadLocalMemory( t ))[0] );
+			numRun += threadSupport.getNumTasksRun( t );
+		}
+		CPPUNIT_ASSERT_EQUAL( int(NUM_TASKS)+NUM_THREADS*3, numRun );
+
+		//the threads can be stopped and started again, the thread local memory stays
+		void* lsMemory = threadSupport.getThreadLocalMemory( 0 );
+		threadSupport.stopSPU();
+		CPPUNIT_ASSERT( !threadSupport.isStarted() );
+		threadSupport.startSPU();
+		CPPUNIT_ASSERT( threadSupport.isStarted() );
+		CPPUNIT_ASSERT( lsMemory == threadSupport.getThreadLocalMemory( 0 ) );
+		runTasks( threadSupport );
+
+		threadSupport.stopSPU();
+		deleteLsMemory( threadSupport );
+	}
+
+	void testParking()
+	{
+		//without spinning, every idle thread parks right away, and pinned threads run on the processors they are pinned to
+		btThreadPoolSupport threadSupport( btThreadPoolSupport::ThreadConstructionInfo( "TestThreadPool", squareTask, createLsMemory, NUM_THREADS, 0, true ) );
+		CPPUNIT_ASSERT_EQUAL( 0, threadSupport.getSpinCount() );
+		runTasks( threadSupport );
+		runQueuedTasks( threadSupport, 64 );
+		//more tasks than the task and completion queues hold, sendRequest has to wait for tasks to finish
+		runQueuedTasks( threadSupport, 1000 );
+#if defined (__linux__) || defined (_WIN32)
+		for (int t=0;t<threadSupport.getNumTasks();t++)
+			CPPUNIT_ASSERT( threadSupport.getThreadProcessor( t ) >= 0 );
+#endif
+		threadSupport.stopSPU();
+		deleteLsMemory( threadSupport );
+	}
+
+	void testBarrierAndCriticalSection()
+	{
+		int spinCounts[2] = { 4096, 0 };
+		for (int i=0;i<2;i++)
+		{
+			btThreadPoolSupport threadSupport( btThreadPoolSupport::ThreadConstructionInfo( "TestThreadPool", countTask, createLsMemory, NUM_THREADS, spinCounts[i] ) );
+			runCountTasks( threadSupport );
+			runCountTasks( threadSupport );
+			threadSupport.stopSPU();
+			deleteLsMemory( threadSupport );
+		}
+	}
+
+	void testCollisionDispatcher()
+	{
+		SequentialThreadSupport::SequentialThreadConstructionInfo sequentialInfo( "TestCollision", processCollisionTask, createCollisionLocalStoreMemory );
+		SequentialThreadSupport* sequential = new SequentialThreadSupport( sequentialInfo );
+		btThreadPoolSupport* pool = new btThreadPoolSupport( btThreadPoolSupport::ThreadConstructionInfo( "TestCollision", processCollisionTask, createCollisionLocalStoreMemory, NUM_THREADS ) );
+		{
+			//every pair is processed by one task, so the contacts don't depend on the threads
+			Scene reference( sequential, 0 );
+			Scene scene( pool, 0 );
+			reference.step( 60 );
+			scene.step( 60 );
+			for (int i=0;i<scene.mBodies.size();i++)
+			{
+				CPPUNIT_ASSERT( reference.mBodies[i]->getWorldTransform().getOrigin() == scene.mBodies[i]->getWorldTransform().getOrigin() );
+				CPPUNIT_ASSERT( reference.mBodies[i]->getWorldTransform().getBasis() == scene.mBodies[i]->getWorldTransform().getBasis() );
+			}
+			//the stacks are standing
+			CPPUNIT_ASSERT( scene.mBodies[5]->getWorldTransform().getOrigin().getY() > btScalar(4.) );
+		}
+		delete pool;
+		delete sequential;
+		deleteCollisionLocalStoreMemory();
+	}
+
+	void testParallelConstraintSolver()
+	{
+		btThreadPoolSupport* pool = new btThreadPoolSupport( btThreadPoolSupport::ThreadConstructionInfo( "TestSolver", SolverThreadFunc, SolverlsMemoryFunc, NUM_THREADS ) );
+		{
+			Scene scene( 0, pool );
+			scene.step( 60 );
+			for (int i=1;i<scene.mBodies.size();i++)
+			{
+				const btVector3& origin = scene.mBodies[i]->getWorldTransform().getOrigin();
+				CPPUNIT_ASSERT( origin.getY() > btScalar(0.3) && origin.getY() < btScalar(5.) );
+			}
+			CPPUNIT_ASSERT( scene.mBodies[5]->getWorldTransform().getOrigin().getY() > btScalar(4.) );
+		}
+		delete pool;
+	}
+
+	CPPUNIT_TEST_SUITE(TestThreadPoolSupport);
+	CPPUNIT_TEST(testTasks);
+	CPPUNIT_TEST(testParking);
+	CPPUNIT_TEST(testBarrierAndCriticalSection);
+	CPPUNIT_TEST(testCollisionDispatcher);
+	CPPUNIT_TEST(testParallelConstraintSolver);
+	CPPUNIT_TEST_SUITE_END();
+};
+
+#endif
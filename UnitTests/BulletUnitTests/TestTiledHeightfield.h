@@ -0,0 +1,371 @@
+#ifndef TESTTILEDHEIGHTFIELD_HAS_BEEN_INCLUDED
+#define TESTTILEDHEIGHTFIELD_HAS_BEEN_INCLUDED
+
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+#include "TestSupport.h"
+
+#include "btBulletCollisionCommon.h"
+#include "BulletCollision/CollisionShapes/btHeightfieldTerrainShape.h"
+#include "BulletCollision/CollisionShapes/btTiledHeightfieldTerrainShape.h"
+#include "BulletCollision/NarrowPhaseCollision/btRaycastCallback.h"
+#include "LinearMath/btThreads.h"
+
+// ---------------------------------------------------------------------------
+
+class TestTiledHeightfield : public TestRandomFixture
+{
+	enum
+	{
+		GRID_SIZE = 129,
+		TILE_SIZE = 16,
+		NUM_TILES = 8,
+		NUM_BOXES = 100,
+		NUM_RAYS = 400
+	};
+
+	btAlignedObjectArray<btScalar> mHeights;
+
+	///serves the tiles from the full height array, one tile can be marked as missing
+	struct TileProvider : public btHeightfieldTileProvider
+	{
+		const btAlignedObjectArray<btScalar>* mHeights;
+		volatile int mNumLoads;
+		volatile int mNumEvictions;
+		int mMissingTile;
+		bool mReportRanges;
+
+		virtual bool loadTile( int tileX, int tileY, int tileSize, btScalar* heights )
+		{
+			btAtomicFetchAdd( &mNumLoads, 1 );
+			if (tileY*NUM_TILES+tileX == mMissingTile)
+				return false;
+			for (int y=0;y<=tileSize;y++)
+			{
+				for (int x=0;x<=tileSize;x++)
+				{
+					int gx = tileX*tileSize+x;
+					int gy = tileY*tileSize+y;
+					if (gx < GRID_SIZE && gy < GRID_SIZE)
+						heights[y*(tileSize+1)+x] = (*mHeights)[gy*GRID_SIZE+gx];
+				}
+			}
+			return true;
+		}
+
+		virtual bool getTileHeightRange( int, int, btScalar& minHeight, btScalar& maxHeight )
+		{
+			if (!mReportRanges)
+				return false;
+			//all tiles of the test terrain are between 0 and 20
+			minHeight = 0;
+			maxHeight = 20;
+			return true;
+		}
+
+		virtual void tileEvicted( int, int )
+		{
+			btAtomicFetchAdd( &mNumEvictions, 1 );
+		}
+	};
+
+	///makes the protected height lookup of the shape callable from the test
+	struct ExposedTiledShape : public btTiledHeightfieldTerrainShape
+	{
+		ExposedTiledShape( TileProvider* provider, btScalar minHeight, btScalar maxHeight )
+			:btTiledHeightfieldTerrainShape( GRID_SIZE, GRID_SIZE, TILE_SIZE, provider, minHeight, maxHeight, 1, false )
+		{
+		}
+
+		btScalar getHeight( int x, int y ) const
+		{
+			return getRawHeightFieldValue( x, y );
+		}
+	};
+
+	///records the vertices of the reported triangles per cell
+	struct CellCallback : public btTriangleCallback
+	{
+		btAlignedObjectArray<int> mCounts;
+		btAlignedObjectArray<btVector3> mVertices;
+		btVector3 mAabbMin, mAabbMax;
+		bool mOnlyOverlapping;
+
+		CellCallback( const btVector3& aabbMin, const btVector3& aabbMax, bool onlyOverlapping )
+			:mAabbMin( aabbMin ), mAabbMax( aabbMax ), mOnlyOverlapping( onlyOverlapping )
+		{
+			mCounts.resize( (GRID_SIZE-1)*(GRID_SIZE-1), 0 );
+			mVertices.resize( (GRID_SIZE-1)*(GRID_SIZE-1)*6, btVector3( 0, 0, 0 ) );
+		}
+
+		virtual void processTriangle( btVector3* triangle, int x, int j )
+		{
+			if (mOnlyOverlapping)
+			{
+				btVector3 triMin = triangle[0], triMax = triangle[0];
+				triMin.setMin( triangle[1] ); triMin.setMin( triangle[2] );
+				triMax.setMax( triangle[1] ); triMax.setMax( triangle[2] );
+				if (!TestAabbAgainstAabb2( triMin, triMax, mAabbMin, mAabbMax ))
+					return;
+			}
+			int cell = j*(GRID_SIZE-1)+x;
+			int first = mCounts[cell]*3;
+			if (first < 6)
+			{
+				for (int i=0;i<3;i++)
+					mVertices[cell*6+first+i] = triangle[i];
+			}
+			mCounts[cell]++;
+		}
+	};
+
+	struct ClosestHitCallback : public btTriangleRaycastCallback
+	{
+		ClosestHitCallback( const btVector3& from, const btVector3& to )
+			:btTriangleRaycastCallback( from, to )
+		{
+		}
+		virtual btScalar reportHit( const btVector3&, btScalar hitFraction, int, int )
+		{
+			return hitFraction;
+		}
+	};
+
+	static btScalar raycastReference( const btHeightfieldTerrainShape* shape, const btVector3& from, const btVector3& to )
+	{
+		ClosestHitCallback cb( from, to );
+		btVector3 aabbMin = from, aabbMax = from;
+		aabbMin.setMin( to );
+		aabbMax.setMax( to );
+		shape->processAllTriangles( &cb, aabbMin, aabbMax );
+		return cb.m_hitFraction;
+	}
+
+	struct RaycastLoop : public btIParallelForBody
+	{
+		const btTiledHeightfieldTerrainShape* mShape;
+		const btAlignedObjectArray<btVector3>* mRays;
+		btAlignedObjectArray<btScalar>* mFractions;
+
+		void forLoop( int iBegin, int iEnd ) const
+		{
+			for (int i=iBegin;i<iEnd;i++)
+			{
+				ClosestHitCallback cb( (*mRays)[i*2], (*mRays)[i*2+1] );
+				mShape->performRaycast( &cb, (*mRays)[i*2], (*mRays)[i*2+1] );
+				(*mFractions)[i] = cb.m_hitFraction;
+			}
+		}
+	};
+
+	void initProvider( TileProvider& provider )
+	{
+		provider.mHeights = &mHeights;
+		provider.mNumLoads = 0;
+		provider.mNumEvictions = 0;
+		provider.mMissingTile = -1;
+		provider.mReportRanges = false;
+	}
+
+	void createRays( btAlignedObjectArray<btVector3>& rays )
+	{
+		mSeed = 7;
+		for (int r=0;r<NUM_RAYS;r++)
+		{
+			//long rays across the terrain, steep rays and vertical rays
+			btVector3 from = randVector( 180 )+btVector3( 0, 30, 0 );
+			btVector3 to = randVector( 180 )-btVector3( 0, 30, 0 );
+			if (r%4 == 1)
+				to = from+randVector( 20 )-btVector3( 0, 60, 0 );
+			if (r%4 == 2)
+				to = from-btVector3( 0, 60, 0 );
+			rays.push_back( from );
+			rays.push_back( to );
+		}
+	}
+
+public:
+
+	void setUp()
+	{
+		mSeed = 42;
+		mHeights.resize( GRID_SIZE*GRID_SIZE );
+		for (int y=0;y<GRID_SIZE;y++)
+		{
+			for (int x=0;x<GRID_SIZE;x++)
+			{
+				//rolling hills with some noise and a flat plateau
+				btScalar h = btScalar(10.)+btScalar(6.)*btSin( btScalar(x)*btScalar(0.07) )*btCos( btScalar(y)*btScalar(0.05) )+rand01()*btScalar(2.);
+				if (x > 90 && y > 90)
+					h = btScalar(18.);
+				mHeights[y*GRID_SIZE+x] = h;
+			}
+		}
+	}
+
+	void tearDown()
+	{
+		btSetTaskScheduler( 0 );
+	}
+
+	void testMatchesHeightfield()
+	{
+		btHeightfieldTerrainShape reference( GRID_SIZE, GRID_SIZE, &mHeights[0], 1, 0, 20, 1, PHY_FLOAT, false );
+		TileProvider provider;
+		initProvider( provider );
+		btTiledHeightfieldTerrainShape tiled( GRID_SIZE, GRID_SIZE, TILE_SIZE, &provider, 0, 20, 1, false );
+		tiled.setMaxResidentTiles( 4 );
+		btVector3 scaling( 2, 1, 2 );
+		reference.setLocalScaling( scaling );
+		tiled.setLocalScaling( scaling );
+		CPPUNIT_ASSERT_EQUAL( int(NUM_TILES), tiled.getNumTilesX() );
+
+		btTransform identity;
+		identity.setIdentity();
+		btVector3 refMin, refMax, tiledMin, tiledMax;
+		reference.getAabb( identity, refMin, refMax );
+		tiled.getAabb( identity, tiledMin, tiledMax );
+		CPPUNIT_ASSERT( (refMin-tiledMin).length2() == btScalar(0.) && (refMax-tiledMax).length2() == btScalar(0.) );
+
+		//box queries: the tiled shape reports every triangle that overlaps the box, with the same vertices, and no other cells
+		mSeed = 3;
+		for (int b=0;b<NUM_BOXES;b++)
+		{
+			btVector3 center = randVector( 260 );
+			btVector3 extent( rand01()*30, rand01()*8, rand01()*30 );
+			CellCallback all( center-extent, center+extent, false );
+			CellCallback overlapping( center-extent, center+extent, true );
+			CellCallback cb( center-extent, center+extent, false );
+			reference.processAllTriangles( &all, center-extent, center+extent );
+			reference.processAllTriangles( &overlapping, center-extent, center+extent );
+			tiled.processAllTriangles( &cb, center-extent, center+extent );
+			for (int cell=0;cell<all.mCounts.size();cell++)
+			{
+				if (overlapping.mCounts[cell])
+					CPPUNIT_ASSERT_EQUAL( 2, cb.mCounts[cell] );
+				if (!all.mCounts[cell])
+					CPPUNIT_ASSERT_EQUAL( 0, cb.mCounts[cell] );
+				if (cb.mCounts[cell])
+				{
+					for (int i=0;i<6;i++)
+						CPPUNIT_ASSERT( (cb.mVertices[cell*6+i]-all.mVertices[cell*6+i]).length2() == btScalar(0.) );
+				}
+			}
+			CPPUNIT_ASSERT( tiled.getNumResidentTiles() <= 4 );
+		}
+
+		//rays find the same closest hit
+		btAlignedObjectArray<btVector3> rays;
+		createRays( rays );
+		int numHits = 0;
+		for (int r=0;r<NUM_RAYS;r++)
+		{
+			btScalar expected = raycastReference( &reference, rays[r*2], rays[r*2+1] );
+			ClosestHitCallback cb( rays[r*2], rays[r*2+1] );
+			tiled.performRaycast( &cb, rays[r*2], rays[r*2+1] );
+			CPPUNIT_ASSERT_EQUAL( expected, cb.m_hitFraction );
+			if (expected < btScalar(1.))
+				numHits++;
+		}
+		CPPUNIT_ASSERT( numHits > NUM_RAYS/4 );
+
+		//tiles were streamed in and out
+		CPPUNIT_ASSERT( tiled.getNumResidentTiles() <= 4 );
+		CPPUNIT_ASSERT( provider.mNumLoads > NUM_TILES*NUM_TILES );
+		CPPUNIT_ASSERT_EQUAL( int(provider.mNumLoads)-tiled.getNumResidentTiles(), int(provider.mNumEvictions) );
+		tiled.evictAllTiles();
+		CPPUNIT_ASSERT_EQUAL( 0, tiled.getNumResidentTiles() );
+		CPPUNIT_ASSERT_EQUAL( int(provider.mNumLoads), int(provider.mNumEvictions) );
+	}
+
+	void testStreaming()
+	{
+		TileProvider provider;
+		initProvider( provider );
+		provider.mReportRanges = true;
+		provider.mMissingTile = 9;
+		btTiledHeightfieldTerrainShape tiled( GRID_SIZE, GRID_SIZE, TILE_SIZE, &provider, -50, 50, 1, false );
+
+		//a box above the height range of the tiles doesn't load them
+		CellCallback cb( btVector3( -100, 35, -100 ), btVector3( 100, 40, 100 ), false );
+		tiled.processAllTriangles( &cb, btVector3( -100, 35, -100 ), btVector3( 100, 40, 100 ) );
+		CPPUNIT_ASSERT_EQUAL( 0, int(provider.mNumLoads) );
+
+		//a missing tile is a hole, its cells have no triangles
+		CellCallback all( btVector3( -100, -50, -100 ), btVector3( 100, 50, 100 ), false );
+		tiled.processAllTriangles( &all, btVector3( -100, -50, -100 ), btVector3( 100, 50, 100 ) );
+		CPPUNIT_ASSERT_EQUAL( NUM_TILES*NUM_TILES, int(provider.mNumLoads) );
+		for (int j=0;j<GRID_SIZE-1;j++)
+		{
+			for (int x=0;x<GRID_SIZE-1;x++)
+			{
+				bool missing = x/TILE_SIZE == 1 && j/TILE_SIZE == 1;
+				CPPUNIT_ASSERT_EQUAL( missing ? 0 : 2, all.mCounts[j*(GRID_SIZE-1)+x] );
+			}
+		}
+
+		//the missing tile is not kept, it is asked for again and fills the hole once the provider has it
+		CPPUNIT_ASSERT_EQUAL( NUM_TILES*NUM_TILES-1, tiled.getNumResidentTiles() );
+		CPPUNIT_ASSERT_EQUAL( 1, int(provider.mNumEvictions) );
+		provider.mMissingTile = -1;
+		CellCallback filled( btVector3( -100, -50, -100 ), btVector3( 100, 50, 100 ), false );
+		tiled.processAllTriangles( &filled, btVector3( -100, -50, -100 ), btVector3( 100, 50, 100 ) );
+		CPPUNIT_ASSERT_EQUAL( NUM_TILES*NUM_TILES+1, int(provider.mNumLoads) );
+		CPPUNIT_ASSERT_EQUAL( NUM_TILES*NUM_TILES, tiled.getNumResidentTiles() );
+		for (int c=0;c<(GRID_SIZE-1)*(GRID_SIZE-1);c++)
+		{
+			CPPUNIT_ASSERT_EQUAL( 2, filled.mCounts[c] );
+		}
+	}
+
+	void testMissingTileHeight()
+	{
+		TileProvider provider;
+		initProvider( provider );
+		provider.mMissingTile = 9;
+		ExposedTiledShape tiled( &provider, -50, 50 );
+
+		//a vertex of a tile that can't be loaded is at the bottom of the height range, like the cells of the hole
+		CPPUNIT_ASSERT_EQUAL( btScalar(-50.), tiled.getHeight( TILE_SIZE+3, TILE_SIZE+5 ) );
+		CPPUNIT_ASSERT_EQUAL( 0, tiled.getNumResidentTiles() );
+		CPPUNIT_ASSERT_EQUAL( mHeights[2*GRID_SIZE+3], tiled.getHeight( 3, 2 ) );
+	}
+
+	void testParallelRaycast()
+	{
+		btHeightfieldTerrainShape reference( GRID_SIZE, GRID_SIZE, &mHeights[0], 1, 0, 20, 1, PHY_FLOAT, false );
+		TileProvider provider;
+		initProvider( provider );
+		btTiledHeightfieldTerrainShape tiled( GRID_SIZE, GRID_SIZE, TILE_SIZE, &provider, 0, 20, 1, false );
+		//less tiles than threads, so tiles in use are not evicted and loads are waited for
+		tiled.setMaxResidentTiles( 2 );
+
+		btAlignedObjectArray<btVector3> rays;
+		createRays( rays );
+		btAlignedObjectArray<btScalar> fractions;
+		fractions.resize( NUM_RAYS, btScalar(-1.) );
+
+		TestThreadPool threads;
+		if (threads.skipWithoutThreads( "TestTiledHeightfield::testParallelRaycast" ))
+			return;
+		RaycastLoop loop;
+		loop.mShape = &tiled;
+		loop.mRays = &rays;
+		loop.mFractions = &fractions;
+		btParallelFor( 0, NUM_RAYS, 8, loop );
+
+		for (int r=0;r<NUM_RAYS;r++)
+		{
+			CPPUNIT_ASSERT_EQUAL( raycastReference( &reference, rays[r*2], rays[r*2+1] ), fractions[r] );
+		}
+	}
+
+	CPPUNIT_TEST_SUITE(TestTiledHeightfield);
+	CPPUNIT_TEST(testMatchesHeightfield);
+	CPPUNIT_TEST(testStreaming);
+	CPPUNIT_TEST(testMissingTileHeight);
+	CPPUNIT_TEST(testParallelRaycast);
+	CPPUNIT_TEST_SUITE_END();
+};
+
+#endif
@@ -0,0 +1,431 @@
+#ifndef TESTTRIANGLEMESHBLOB_HAS_BEEN_INCLUDED
+#define TESTTRIANGLEMESHBLOB_HAS_BEEN_INCLUDED
+
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+#include "TestSupport.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "btBulletCollisionCommon.h"
+#include "BulletCollision/CollisionShapes/btTriangleMeshBlob.h"
+#include "BulletCollision/CollisionDispatch/btInternalEdgeUtility.h"
+#include "BulletCollision/NarrowPhaseCollision/btRaycastCallback.h"
+
+// ---------------------------------------------------------------------------
+
+class TestTriangleMeshBlob : public TestRandomFixture
+{
+	enum
+	{
+		GRID_SIZE = 30,
+		NUM_RAYS = 300
+	};
+
+	btTriangleMesh* mMesh;
+
+	struct ClosestTriangleCallback : public btTriangleRaycastCallback
+	{
+		int mTriangleIndex;
+		ClosestTriangleCallback( const btVector3& from, const btVector3& to )
+			:btTriangleRaycastCallback( from, to ),
+			mTriangleIndex( -1 )
+		{
+		}
+		virtual btScalar reportHit( const btVector3&, btScalar hitFraction, int, int triangleIndex )
+		{
+			mTriangleIndex = triangleIndex;
+			return hitFraction;
+		}
+	};
+
+	///offsets of the protected node and subtree counts in the btQuantizedBvh header of a blob
+	struct BvhHeaderOffsets : public btOptimizedBvh
+	{
+		int nodeCountOffset() const
+		{
+			return int( (const char*)&m_curNodeIndex-(const char*)this );
+		}
+		int subtreeCountOffset() const
+		{
+			return int( (const char*)&m_subtreeHeaderCount-(const char*)this );
+		}
+	};
+
+	static btTriangleMeshBlobMesh& meshAt( btAlignedObjectArray<char>& data, int offset )
+	{
+		return *(btTriangleMeshBlobMesh*)&data[offset];
+	}
+
+	static int& intAt( btAlignedObjectArray<char>& data, int offset )
+	{
+		return *(int*)&data[offset];
+	}
+
+	static int offsetInFile( const void* ptr, const btMappedFile& file )
+	{
+		return int( (const char*)ptr-(const char*)file.getData() );
+	}
+
+	static void readFile( btAlignedObjectArray<char>& data )
+	{
+		btMappedFile mapped;
+		CPPUNIT_ASSERT( mapped.open( "TestTriangleMeshBlob.bin" ) );
+		data.resize( mapped.getSize() );
+		memcpy( &data[0], mapped.getData(), mapped.getSize() );
+	}
+
+	static bool writeAndLoad( btTriangleMeshBlob& blob, const btAlignedObjectArray<char>& data, int size )
+	{
+		FILE* file = fopen( "TestTriangleMeshBlob.bin", "wb" );
+		fwrite( &data[0], 1, size, file );
+		fclose( file );
+		return blob.loadFile( "TestTriangleMeshBlob.bin" );
+	}
+
+	static bool isInside( const void* ptr, const btMappedFile& file )
+	{
+		const char* data = (const char*)file.getData();
+		return (const char*)ptr >= data && (const char*)ptr < data+file.getSize();
+	}
+
+public:
+
+	void setUp()
+	{
+		//a bumpy height grid, so the internal edge info has convex and concave edges
+		mMesh = new btTriangleMesh();
+		mSeed = 42;
+		btScalar heights[GRID_SIZE+1][GRID_SIZE+1];
+		for (int i=0;i<=GRID_SIZE;i++)
+		{
+			for (int j=0;j<=GRID_SIZE;j++)
+			{
+				heights[i][j] = rand01();
+			}
+		}
+		for (int i=0;i<GRID_SIZE;i++)
+		{
+			for (int j=0;j<GRID_SIZE;j++)
+			{
+				btVector3 v00( btScalar(i*2-GRID_SIZE), heights[i][j], btScalar(j*2-GRID_SIZE) );
+				btVector3 v10( btScalar(i*2+2-GRID_SIZE), heights[i+1][j], btScalar(j*2-GRID_SIZE) );
+				btVector3 v11( btScalar(i*2+2-GRID_SIZE), heights[i+1][j+1], btScalar(j*2+2-GRID_SIZE) );
+				btVector3 v01( btScalar(i*2-GRID_SIZE), heights[i][j+1], btScalar(j*2+2-GRID_SIZE) );
+				mMesh->addTriangle( v00, v10, v11 );
+				mMesh->addTriangle( v00, v11, v01 );
+			}
+		}
+	}
+
+	void tearDown()
+	{
+		delete mMesh;
+		remove( "TestTriangleMeshBlob.bin" );
+	}
+
+	void testMappedShapeMatchesOriginal()
+	{
+		btBvhTriangleMeshShape* shape = new btBvhTriangleMeshShape( mMesh, true );
+		btTriangleInfoMap* infoMap = new btTriangleInfoMap();
+		btGenerateInternalEdgeInfo( shape, infoMap );
+		CPPUNIT_ASSERT( infoMap->size() > 0 );
+		CPPUNIT_ASSERT( btTriangleMeshBlob::writeFile( "TestTriangleMeshBlob.bin", shape ) );
+
+		btTriangleMeshBlob blob;
+		CPPUNIT_ASSERT( blob.loadFile( "TestTriangleMeshBlob.bin" ) );
+		btBvhTriangleMeshShape* mappedShape = blob.getCollisionShape();
+		CPPUNIT_ASSERT( mappedShape != 0 );
+		CPPUNIT_ASSERT( mappedShape->getTriangleInfoMap() == blob.getTriangleInfoMap() );
+		CPPUNIT_ASSERT( (mappedShape->getLocalAabbMin()-shape->getLocalAabbMin()).length2() == btScalar(0.) );
+		CPPUNIT_ASSERT( (mappedShape->getLocalAabbMax()-shape->getLocalAabbMax()).length2() == btScalar(0.) );
+
+		//the mesh, the BVH nodes and the triangle info point into the mapping
+		const btMappedFile& file = blob.getMappedFile();
+		const btIndexedMesh& mesh = blob.getMeshInterface()->getIndexedMeshArray()[0];
+		CPPUNIT_ASSERT_EQUAL( mMesh->getNumTriangles(), mesh.m_numTriangles );
+		CPPUNIT_ASSERT( isInside( mesh.m_vertexBase, file ) );
+		CPPUNIT_ASSERT( isInside( mesh.m_triangleIndexBase, file ) );
+		CPPUNIT_ASSERT( isInside( blob.getOptimizedBvh(), file ) );
+		QuantizedNodeArray& nodes = shape->getOptimizedBvh()->getQuantizedNodeArray();
+		QuantizedNodeArray& mappedNodes = blob.getOptimizedBvh()->getQuantizedNodeArray();
+		CPPUNIT_ASSERT_EQUAL( 2*mMesh->getNumTriangles()-1, mappedNodes.size() );
+		CPPUNIT_ASSERT( memcmp( &nodes[0], &mappedNodes[0], mappedNodes.size()*sizeof(btQuantizedBvhNode) )==0 );
+		CPPUNIT_ASSERT( isInside( &mappedNodes[0], file ) );
+		CPPUNIT_ASSERT( isInside( blob.getTriangleInfoMap()->getAtIndex( 0 ), file ) );
+
+		//same triangle info
+		btTriangleInfoMap* mappedInfoMap = blob.getTriangleInfoMap();
+		CPPUNIT_ASSERT_EQUAL( infoMap->size(), mappedInfoMap->size() );
+		for (int t=0;t<mMesh->getNumTriangles();t++)
+		{
+			int hash = t;
+			btTriangleInfo* info = infoMap->find( hash );
+			btTriangleInfo* mappedInfo = mappedInfoMap->find( hash );
+			CPPUNIT_ASSERT_EQUAL( info == 0, mappedInfo == 0 );
+			if (info)
+			{
+				CPPUNIT_ASSERT_EQUAL( info->m_flags, mappedInfo->m_flags );
+				CPPUNIT_ASSERT_EQUAL( info->m_edgeV0V1Angle, mappedInfo->m_edgeV0V1Angle );
+				CPPUNIT_ASSERT_EQUAL( info->m_edgeV1V2Angle, mappedInfo->m_edgeV1V2Angle );
+				CPPUNIT_ASSERT_EQUAL( info->m_edgeV2V0Angle, mappedInfo->m_edgeV2V0Angle );
+			}
+		}
+
+		//rays hit the same closest triangle
+		mSeed = 7;
+		int numHits = 0;
+		for (int r=0;r<NUM_RAYS;r++)
+		{
+			btVector3 from = randVector( 60 )+btVector3( 0, 30, 0 );
+			btVector3 to = randVector( 60 )-btVector3( 0, 30, 0 );
+			ClosestTriangleCallback reference( from, to );
+			ClosestTriangleCallback cb( from, to );
+			shape->performRaycast( &reference, from, to );
+			mappedShape->performRaycast( &cb, from, to );
+			CPPUNIT_ASSERT_EQUAL( reference.mTriangleIndex, cb.mTriangleIndex );
+			CPPUNIT_ASSERT_EQUAL( reference.m_hitFraction, cb.m_hitFraction );
+			if (reference.mTriangleIndex >= 0)
+				numHits++;
+		}
+		CPPUNIT_ASSERT( numHits > NUM_RAYS/4 );
+
+		//refit writes to private copies of the pages, the file keeps the original BVH
+		blob.getOptimizedBvh()->refit( blob.getMeshInterface(), shape->getLocalAabbMin(), shape->getLocalAabbMax() );
+		btTriangleMeshBlob otherBlob;
+		CPPUNIT_ASSERT( otherBlob.loadFile( "TestTriangleMeshBlob.bin" ) );
+		CPPUNIT_ASSERT( otherBlob.getMappedFile().getData() != file.getData() );
+
+		blob.release();
+		CPPUNIT_ASSERT( !file.isOpen() );
+		CPPUNIT_ASSERT( blob.getCollisionShape() == 0 );
+
+		delete shape;
+		delete infoMap;
+	}
+
+	void testRejectsInvalidFiles()
+	{
+		btTriangleMeshBlob blob;
+		CPPUNIT_ASSERT( !blob.loadFile( "TestTriangleMeshBlob.missing" ) );
+
+		FILE* file = fopen( "TestTriangleMeshBlob.bin", "wb" );
+		char garbage[256];
+		for (int i=0;i<256;i++)
+		{
+			garbage[i] = char(i);
+		}
+		fwrite( garbage, 1, sizeof(garbage), file );
+		fclose( file );
+
+		btMappedFile mapped;
+		CPPUNIT_ASSERT( mapped.open( "TestTriangleMeshBlob.bin" ) );
+		CPPUNIT_ASSERT_EQUAL( 256u, mapped.getSize() );
+		CPPUNIT_ASSERT( memcmp( mapped.getData(), garbage, sizeof(garbage) )==0 );
+		mapped.close();
+
+		CPPUNIT_ASSERT( !blob.loadFile( "TestTriangleMeshBlob.bin" ) );
+		CPPUNIT_ASSERT( blob.getCollisionShape() == 0 );
+		CPPUNIT_ASSERT( !blob.getMappedFile().isOpen() );
+	}
+
+	void testRejectsCorruptedBlobs()
+	{
+		btBvhTriangleMeshShape* shape = new btBvhTriangleMeshShape( mMesh, true );
+		CPPUNIT_ASSERT( btTriangleMeshBlob::writeFile( "TestTriangleMeshBlob.bin", shape ) );
+		delete shape;
+
+		btAlignedObjectArray<char> original;
+		readFile( original );
+		const btTriangleMeshBlobHeader& header = *(const btTriangleMeshBlobHeader*)&original[0];
+		const int meshOffset = header.m_meshesOffset;
+
+		btTriangleMeshBlob blob;
+		CPPUNIT_ASSERT( writeAndLoad( blob, original, original.size() ) );
+		blob.release();
+
+		//truncated inside the BVH, inside the vertex array and inside the header
+		CPPUNIT_ASSERT( !writeAndLoad( blob, original, original.size()-16 ) );
+		CPPUNIT_ASSERT( !writeAndLoad( blob, original, header.m_bvhOffset-16 ) );
+		CPPUNIT_ASSERT( !writeAndLoad( blob, original, sizeof(btTriangleMeshBlobHeader)/2 ) );
+
+		//counts whose byte size wraps around in 32 bits, or that are negative
+		btAlignedObjectArray<char> corrupted;
+		corrupted.copyFromArray( original );
+		meshAt( corrupted, meshOffset ).m_numTriangles = 0x40000000;
+		CPPUNIT_ASSERT( !writeAndLoad( blob, corrupted, corrupted.size() ) );
+		corrupted.copyFromArray( original );
+		meshAt( corrupted, meshOffset ).m_numVertices = -1;
+		CPPUNIT_ASSERT( !writeAndLoad( blob, corrupted, corrupted.size() ) );
+		corrupted.copyFromArray( original );
+		meshAt( corrupted, meshOffset ).m_triangleIndexStride = -12;
+		CPPUNIT_ASSERT( !writeAndLoad( blob, corrupted, corrupted.size() ) );
+		corrupted.copyFromArray( original );
+		((btTriangleMeshBlobHeader*)&corrupted[0])->m_numMeshes = 0x10000000;
+		CPPUNIT_ASSERT( !writeAndLoad( blob, corrupted, corrupted.size() ) );
+		corrupted.copyFromArray( original );
+		((btTriangleMeshBlobHeader*)&corrupted[0])->m_bvhSize = 0xfffffff0u;
+		CPPUNIT_ASSERT( !writeAndLoad( blob, corrupted, corrupted.size() ) );
+
+		//stride smaller than a triangle, unknown scalar type, misaligned array
+		corrupted.copyFromArray( original );
+		meshAt( corrupted, meshOffset ).m_vertexStride = 4;
+		CPPUNIT_ASSERT( !writeAndLoad( blob, corrupted, corrupted.size() ) );
+		corrupted.copyFromArray( original );
+		meshAt( corrupted, meshOffset ).m_indexType = PHY_FIXEDPOINT88;
+		CPPUNIT_ASSERT( !writeAndLoad( blob, corrupted, corrupted.size() ) );
+		corrupted.copyFromArray( original );
+		meshAt( corrupted, meshOffset ).m_vertexOffset += 2;
+		CPPUNIT_ASSERT( !writeAndLoad( blob, corrupted, corrupted.size() ) );
+
+		//an index past the vertex array
+		corrupted.copyFromArray( original );
+		int* indices = (int*)&corrupted[meshAt( corrupted, meshOffset ).m_triangleIndexOffset];
+		indices[4] = meshAt( corrupted, meshOffset ).m_numVertices;
+		CPPUNIT_ASSERT( !writeAndLoad( blob, corrupted, corrupted.size() ) );
+		CPPUNIT_ASSERT( blob.getCollisionShape() == 0 );
+		CPPUNIT_ASSERT( !blob.getMappedFile().isOpen() );
+	}
+
+	void testRejectsCorruptedBvh()
+	{
+		btBvhTriangleMeshShape* shape = new btBvhTriangleMeshShape( mMesh, true );
+		CPPUNIT_ASSERT( btTriangleMeshBlob::writeFile( "TestTriangleMeshBlob.bin", shape ) );
+		delete shape;
+
+		btAlignedObjectArray<char> original;
+		readFile( original );
+		const int bvhOffset = ((const btTriangleMeshBlobHeader*)&original[0])->m_bvhOffset;
+		BvhHeaderOffsets bvhHeader;
+		const int nodeCountOffset = bvhOffset+bvhHeader.nodeCountOffset();
+		const int subtreeCountOffset = bvhOffset+bvhHeader.subtreeCountOffset();
+
+		btTriangleMeshBlob blob;
+		CPPUNIT_ASSERT( writeAndLoad( blob, original, original.size() ) );
+		const btMappedFile& file = blob.getMappedFile();
+		const QuantizedNodeArray& nodes = blob.getOptimizedBvh()->getQuantizedNodeArray();
+		const int numNodes = nodes.size();
+		const int nodesOffset = offsetInFile( &nodes[0], file );
+		const int subtreesOffset = offsetInFile( &blob.getOptimizedBvh()->getSubtreeInfoArray()[0], file );
+		CPPUNIT_ASSERT( !nodes[0].isLeafNode() && !nodes[1].isLeafNode() );
+		int leaf = 0;
+		while (!nodes[leaf].isLeafNode())
+			leaf++;
+		const int escapeOffset = int( (const char*)&nodes[0].m_escapeIndexOrTriangleIndex-(const char*)&nodes[0] );
+		blob.release();
+		CPPUNIT_ASSERT_EQUAL( numNodes, intAt( original, nodeCountOffset ) );
+		#define NODE_ESCAPE(index) intAt( corrupted, nodesOffset+(index)*int(sizeof(btQuantizedBvhNode))+escapeOffset )
+
+		//node and subtree counts whose byte size wraps around in 32 bits (deSerializeInPlace asserts on the ones that don't wrap)
+		btAlignedObjectArray<char> corrupted;
+		corrupted.copyFromArray( original );
+		intAt( corrupted, nodeCountOffset ) = 0x10000000;
+		CPPUNIT_ASSERT( !writeAndLoad( blob, corrupted, corrupted.size() ) );
+		corrupted.copyFromArray( original );
+		intAt( corrupted, nodeCountOffset ) = -1;
+		CPPUNIT_ASSERT( !writeAndLoad( blob, corrupted, corrupted.size() ) );
+		corrupted.copyFromArray( original );
+		intAt( corrupted, subtreeCountOffset ) = 0x08000000;
+		CPPUNIT_ASSERT( !writeAndLoad( blob, corrupted, corrupted.size() ) );
+
+		//escape indices past the end of the tree, that can't be negated, or that don't match the children
+		corrupted.copyFromArray( original );
+		NODE_ESCAPE( 0 ) = -(numNodes+1);
+		CPPUNIT_ASSERT( !writeAndLoad( blob, corrupted, corrupted.size() ) );
+		corrupted.copyFromArray( original );
+		NODE_ESCAPE( 0 ) = int( 0x80000000u );
+		CPPUNIT_ASSERT( !writeAndLoad( blob, corrupted, corrupted.size() ) );
+		corrupted.copyFromArray( original );
+		NODE_ESCAPE( 1 ) = -1;
+		CPPUNIT_ASSERT( !writeAndLoad( blob, corrupted, corrupted.size() ) );
+		corrupted.copyFromArray( original );
+		NODE_ESCAPE( 1 ) -= 2;
+		CPPUNIT_ASSERT( !writeAndLoad( blob, corrupted, corrupted.size() ) );
+
+		//a leaf with a triangle index past its mesh, or a part that doesn't exist
+		corrupted.copyFromArray( original );
+		NODE_ESCAPE( leaf ) = mMesh->getNumTriangles();
+		CPPUNIT_ASSERT( !writeAndLoad( blob, corrupted, corrupted.size() ) );
+		corrupted.copyFromArray( original );
+		NODE_ESCAPE( leaf ) = 1<<(31-MAX_NUM_PARTS_IN_BITS);
+		CPPUNIT_ASSERT( !writeAndLoad( blob, corrupted, corrupted.size() ) );
+		#undef NODE_ESCAPE
+
+		//a subtree outside the node array
+		corrupted.copyFromArray( original );
+		btBvhSubtreeInfo* subtree = (btBvhSubtreeInfo*)&corrupted[subtreesOffset];
+		subtree->m_rootNodeIndex = numNodes-subtree->m_subtreeSize+1;
+		CPPUNIT_ASSERT( !writeAndLoad( blob, corrupted, corrupted.size() ) );
+		corrupted.copyFromArray( original );
+		subtree = (btBvhSubtreeInfo*)&corrupted[subtreesOffset];
+		subtree->m_subtreeSize = 0;
+		CPPUNIT_ASSERT( !writeAndLoad( blob, corrupted, corrupted.size() ) );
+
+		CPPUNIT_ASSERT( blob.getCollisionShape() == 0 );
+		CPPUNIT_ASSERT( writeAndLoad( blob, original, original.size() ) );
+	}
+
+	void testRejectsCorruptedTriangleInfoMap()
+	{
+		btBvhTriangleMeshShape* shape = new btBvhTriangleMeshShape( mMesh, true );
+		btTriangleInfoMap* infoMap = new btTriangleInfoMap();
+		btGenerateInternalEdgeInfo( shape, infoMap );
+		CPPUNIT_ASSERT( btTriangleMeshBlob::writeFile( "TestTriangleMeshBlob.bin", shape ) );
+		delete shape;
+		delete infoMap;
+
+		btAlignedObjectArray<char> original;
+		readFile( original );
+		const int mapOffset = ((const btTriangleMeshBlobHeader*)&original[0])->m_triangleInfoMapOffset;
+		const btTriangleInfoMapInPlaceData layout = *(const btTriangleInfoMapInPlaceData*)&original[mapOffset];
+		const int hashTableOffset = mapOffset+int( layout.getHashTableOffset() );
+		const int nextOffset = mapOffset+int( layout.getNextOffset() );
+		CPPUNIT_ASSERT( mapOffset > 0 && layout.m_numValues > 0 );
+		int bucket = 0;
+		while (intAt( original, hashTableOffset+bucket*4 ) == BT_HASH_NULL)
+			bucket++;
+		const int value = intAt( original, hashTableOffset+bucket*4 );
+
+		btTriangleMeshBlob blob;
+		CPPUNIT_ASSERT( writeAndLoad( blob, original, original.size() ) );
+		CPPUNIT_ASSERT( blob.getTriangleInfoMap() != 0 );
+		blob.release();
+
+		//sizes that wrap around in 32 bits
+		btAlignedObjectArray<char> corrupted;
+		corrupted.copyFromArray( original );
+		btTriangleInfoMapInPlaceData* corruptedLayout = (btTriangleInfoMapInPlaceData*)&corrupted[mapOffset];
+		corruptedLayout->m_hashTableSize = corruptedLayout->m_nextSize = corruptedLayout->m_valueCapacity = 0x40000000;
+		CPPUNIT_ASSERT( !writeAndLoad( blob, corrupted, corrupted.size() ) );
+
+		//a hash table that doesn't match the capacity
+		corrupted.copyFromArray( original );
+		corruptedLayout = (btTriangleInfoMapInPlaceData*)&corrupted[mapOffset];
+		corruptedLayout->m_hashTableSize = layout.m_valueCapacity/2;
+		CPPUNIT_ASSERT( !writeAndLoad( blob, corrupted, corrupted.size() ) );
+
+		//hash table and next entries past the values, and a chain that loops
+		corrupted.copyFromArray( original );
+		intAt( corrupted, hashTableOffset+bucket*4 ) = layout.m_numValues;
+		CPPUNIT_ASSERT( !writeAndLoad( blob, corrupted, corrupted.size() ) );
+		corrupted.copyFromArray( original );
+		intAt( corrupted, nextOffset ) = -2;
+		CPPUNIT_ASSERT( !writeAndLoad( blob, corrupted, corrupted.size() ) );
+		corrupted.copyFromArray( original );
+		intAt( corrupted, nextOffset+value*4 ) = value;
+		CPPUNIT_ASSERT( !writeAndLoad( blob, corrupted, corrupted.size() ) );
+
+		CPPUNIT_ASSERT( blob.getCollisionShape() == 0 );
+	}
+
+	CPPUNIT_TEST_SUITE(TestTriangleMeshBlob);
+	CPPUNIT_TEST(testMappedShapeMatchesOriginal);
+	CPPUNIT_TEST(testRejectsInvalidFiles);
+	CPPUNIT_TEST(testRejectsCorruptedBlobs);
+	CPPUNIT_TEST(testRejectsCorruptedBvh);
+	CPPUNIT_TEST(testRejectsCorruptedTriangleInfoMap);
+	CPPUNIT_TEST_SUITE_END();
+};
+
+#endif
@@ -195,4 +195,5 @@ end
 	include "../Test"
 	include "../Demos/HelloWorld"
 	include "../Demos/Benchmarks"
+	include "../Demos/HeadlessBenchmark"
 	
@@ -20,6 +20,7 @@ subject to the following restrictions:
 
 struct btDispatcherInfo;
 class btDispatcher;
+struct btRayPacket;
 #include "btBroadphaseProxy.h"
 
 class btOverlappingPairCache;
@@ -43,6 +44,34 @@ struct	btBroadphaseRayCallback : public btBroadphaseAabbCallback
 	virtual ~btBroadphaseRayCallback() {}
 };
 
+///btBroadphaseRayPacketCallback receives the proxies hit by the rays of a btRayPacket, see btBroadphaseInterface::rayTestPacket
+struct	btBroadphaseRayPacketCallback
+{
+	virtual ~btBroadphaseRayPacketCallback() {}
+	///rayMask has a bit set for each ray of the packet that hits the proxy AABB, process can lower the m_lambdaMax of those rays
+	virtual void	process(const btBroadphaseProxy* proxy, unsigned int rayMask) = 0;
+};
+
+///btBroadphaseAabbBatchCallback receives the proxies that overlap the boxes of btBroadphaseInterface::aabbTestBatch
+struct	btBroadphaseAabbBatchCallback
+{
+	virtual ~btBroadphaseAabbBatchCallback() {}
+	virtual void	process(const btBroadphaseProxy* proxy, int boxIndex) = 0;
+};
+
+///forwards the proxies of a single aabbTest to a btBroadphaseAabbBatchCallback
+struct	btBroadphaseAabbBatchAdapter : public btBroadphaseAabbCallback
+{
+	btBroadphaseAabbBatchCallback*	m_callback;
+	int		m_boxIndex;
+
+	virtual bool	process(const btBroadphaseProxy* proxy)
+	{
+		m_callback->process(proxy,m_boxIndex);
+		return true;
+	}
+};
+
 #include "LinearMath/btVector3.h"
 
 ///The btBroadphaseInterface class provides an interface to detect aabb-overlapping object pairs.
@@ -58,10 +87,47 @@ public:
 	virtual void	setAabb(btBroadphaseProxy* proxy,const btVector3& aabbMin,const btVector3& aabbMax, btDispatcher* dispatcher)=0;
 	virtual void	getAabb(btBroadphaseProxy* proxy,btVector3& aabbMin, btVector3& aabbMax ) const =0;
 
+	///setAabbs updates a batch of proxies, in the given order. The default implementation calls setAabb for each proxy.
+	virtual void	setAabbs(btBroadphaseProxy* const* proxies,const btVector3* aabbMins,const btVector3* aabbMaxs,int numProxies, btDispatcher* dispatcher)
+	{
+		for (int i=0;i<numProxies;i++)
+		{
+			setAabb(proxies[i],aabbMins[i],aabbMaxs[i],dispatcher);
+		}
+	}
+
 	virtual void	rayTest(const btVector3& rayFrom,const btVector3& rayTo, btBroadphaseRayCallback& rayCallback, const btVector3& aabbMin=btVector3(0,0,0), const btVector3& aabbMax = btVector3(0,0,0)) = 0;
 
 	virtual void	aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback) = 0;
 
+	///aabbTestBatch reports the proxies that overlap each of the boxes, in no particular order. The default implementation calls aabbTest for each box.
+	virtual void	aabbTestBatch(const btVector3* aabbMins, const btVector3* aabbMaxs, int numBoxes, btBroadphaseAabbBatchCallback& callback)
+	{
+		btBroadphaseAabbBatchAdapter adapter;
+		adapter.m_callback = &callback;
+		for (int i=0;i<numBoxes;i++)
+		{
+			adapter.m_boxIndex = i;
+			aabbTest(aabbMins[i],aabbMaxs[i],adapter);
+		}
+	}
+
+	///refitIfNeeded brings deferred updates of the acceleration structure up to date (see btDbvtBroadphase::setParallelCollide).
+	///rayTest, aabbTest, aabbTestBatch and rayTestPacket don't modify an up to date broadphase, so several threads can query it at once
+	///after refitIfNeeded was called. btCollisionWorld::updateAabbs and btDiscreteDynamicsWorld::stepSimulation call it.
+	virtual void	refitIfNeeded()
+	{
+	}
+
+	///rayTestPacket is optional, it returns false when the broadphase can't test the packet.
+	///Implementations don't modify the broadphase, so that several threads can test packets at once.
+	virtual bool	rayTestPacket(btRayPacket& packet, btBroadphaseRayPacketCallback& callback)
+	{
+		(void)packet;
+		(void)callback;
+		return false;
+	}
+
 	///calculateOverlappingPairs is optional: incremental algorithms (sweep and prune) might do it during the set aabb
 	virtual void	calculateOverlappingPairs(btDispatcher* dispatcher)=0;
 
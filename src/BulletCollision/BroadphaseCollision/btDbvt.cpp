@@ -431,6 +431,7 @@ void			btDbvt::clear()
 	m_lkhd		=	-1;
 	m_stkStack.clear();
 	m_opath		=	0;
+	m_leaves	=	0;
 	
 }
 
@@ -232,6 +232,7 @@ struct	btDbvt
 		DBVT_VIRTUAL void	Process(const btDbvtNode* n,btScalar)			{ Process(n); }
 		DBVT_VIRTUAL bool	Descent(const btDbvtNode*)					{ return(true); }
 		DBVT_VIRTUAL bool	AllLeaves(const btDbvtNode*)					{ return(true); }
+		DBVT_VIRTUAL void	ProcessRayPacket(const btDbvtNode* n,unsigned int)	{ Process(n); }
 	};
 	/* IWriter	*/ 
 	struct	IWriter
@@ -325,6 +326,12 @@ struct	btDbvt
 		void		collideTV(	const btDbvtNode* root,
 		const btDbvtVolume& volume,
 		DBVT_IPOLICY) const;
+	///collideTVNoStackAlloc is collideTV with a stack provided by the caller, it only allocates memory when the stack has to grow
+	DBVT_PREFIX
+		void		collideTVNoStackAlloc(	const btDbvtNode* root,
+		const btDbvtVolume& volume,
+		btAlignedObjectArray<const btDbvtNode*>& stack,
+		DBVT_IPOLICY) const;
 	///rayTest is a re-entrant ray test, and can be called in parallel as long as the btAlignedAlloc is thread-safe (uses locking etc)
 	///rayTest is slower than rayTestInternal, because it builds a local stack, using memory allocations, and it recomputes signs/rayDirectionInverses each time
 	DBVT_PREFIX
@@ -344,6 +351,12 @@ struct	btDbvt
 								const btVector3& aabbMin,
 								const btVector3& aabbMax,
 								DBVT_IPOLICY) const;
+	///rayTestPacket traverses the tree once for all rays of the packet, and calls policy.ProcessRayPacket with the mask of the rays that hit the leaf.
+	///The policy can lower packet.m_lambdaMax to prune the rest of the traversal. It is re-entrant, and only allocates memory for very deep trees.
+	DBVT_PREFIX
+		static void		rayTestPacket(	const btDbvtNode* root,
+								btRayPacket& packet,
+								DBVT_IPOLICY);
 
 	DBVT_PREFIX
 		static void		collideKDOP(const btDbvtNode* root,
@@ -950,6 +963,38 @@ inline void		btDbvt::collideTV(	const btDbvtNode* root,
 		}
 }
 
+//
+DBVT_PREFIX
+inline void		btDbvt::collideTVNoStackAlloc(	const btDbvtNode* root,
+								  const btDbvtVolume& vol,
+								  btAlignedObjectArray<const btDbvtNode*>& stack,
+								  DBVT_IPOLICY) const
+{
+	DBVT_CHECKTYPE
+		if(root)
+		{
+			ATTRIBUTE_ALIGNED16(btDbvtVolume)		volume(vol);
+			stack.resize(0);
+			stack.push_back(root);
+			do	{
+				const btDbvtNode*	n=stack[stack.size()-1];
+				stack.pop_back();
+				if(Intersect(n->volume,volume))
+				{
+					if(n->isinternal())
+					{
+						stack.push_back(n->childs[0]);
+						stack.push_back(n->childs[1]);
+					}
+					else
+					{
+						policy.Process(n);
+					}
+				}
+			} while(stack.size()>0);
+		}
+}
+
 DBVT_PREFIX
 inline void		btDbvt::rayTestInternal(	const btDbvtNode* root,
 								const btVector3& rayFrom,
@@ -1071,6 +1116,50 @@ inline void		btDbvt::rayTest(	const btDbvtNode* root,
 		}
 }
 
+//
+DBVT_PREFIX
+inline void		btDbvt::rayTestPacket(	const btDbvtNode* root,
+									btRayPacket& packet,
+									DBVT_IPOLICY)
+{
+	DBVT_CHECKTYPE
+		if(root)
+		{
+			const btDbvtNode*						localStack[DOUBLE_STACKSIZE];
+			btAlignedObjectArray<const btDbvtNode*>	heapStack;
+			const btDbvtNode**						stack=localStack;
+			int										capacity=DOUBLE_STACKSIZE;
+			int										depth=1;
+			stack[0]=root;
+			do	{
+				const btDbvtNode*	node=stack[--depth];
+				const unsigned int	mask=btRayPacketAabb(packet,node->volume.Mins(),node->volume.Maxs());
+				if(mask)
+				{
+					if(node->isinternal())
+					{
+						if(depth+2>capacity)
+						{
+							heapStack.resize(capacity*2);
+							if(stack==localStack)
+							{
+								for(int i=0;i<depth;++i) heapStack[i]=localStack[i];
+							}
+							stack=&heapStack[0];
+							capacity=heapStack.size();
+						}
+						stack[depth++]=node->childs[0];
+						stack[depth++]=node->childs[1];
+					}
+					else
+					{
+						policy.ProcessRayPacket(node,mask);
+					}
+				}
+			} while(depth);
+		}
+}
+
 //
 DBVT_PREFIX
 inline void		btDbvt::collideKDOP(const btDbvtNode* root,
@@ -16,6 +16,7 @@ subject to the following restrictions:
 ///btDbvtBroadphase implementation by Nathanael Presson
 
 #include "btDbvtBroadphase.h"
+#include "LinearMath/btThreads.h"
 
 //
 // Profiling
@@ -84,6 +85,41 @@ static inline void	clear(T& value)
 	value=zerodummy;
 }
 
+//
+static inline bool	growleaf(btDbvtNode* leaf,btDbvtVolume& volume,const btVector3& velocity)
+{
+	if(leaf->volume.Contain(volume)) return(false);
+#ifdef DBVT_BP_MARGIN
+	volume.Expand(btVector3(DBVT_BP_MARGIN,DBVT_BP_MARGIN,DBVT_BP_MARGIN));
+#endif
+	volume.SignedExpand(velocity);
+	leaf->volume=volume;
+	return(true);
+}
+
+//
+static void			refitsubtree(btDbvtNode* root)
+{
+	/* post order walk along the parent links, so deep trees don't overflow the stack	*/ 
+	btDbvtNode*	node=root;
+	for(;;)
+	{
+		while(node->isinternal()) node=node->childs[0];
+		for(;;)
+		{
+			if(node==root) return;
+			btDbvtNode*	parent=node->parent;
+			if(node==parent->childs[0])
+			{
+				node=parent->childs[1];
+				break;
+			}
+			Merge(parent->childs[0]->volume,parent->childs[1]->volume,parent->volume);
+			node=parent;
+		}
+	}
+}
+
 //
 // Colliders
 //
@@ -114,6 +150,81 @@ struct	btDbvtTreeCollider : btDbvt::ICollide
 	}
 };
 
+/* Pair collector, used by the tasks of collideParallel	*/ 
+struct	btDbvtPairCollector : btDbvt::ICollide
+{
+	btDbvtProxyPairArray*	pairs;
+	btDbvtPairCollector(btDbvtProxyPairArray* p) : pairs(p) {}
+	void	Process(const btDbvtNode* na,const btDbvtNode* nb)
+	{
+		if(na!=nb)
+		{
+			btDbvtProxyPair&	pair=pairs->expandNonInitializing();
+			pair.proxy0=(btDbvtProxy*)na->data;
+			pair.proxy1=(btDbvtProxy*)nb->data;
+#if DBVT_BP_SORTPAIRS
+			if(pair.proxy0->m_uniqueId>pair.proxy1->m_uniqueId) 
+				btSwap(pair.proxy0,pair.proxy1);
+#endif
+		}
+	}
+};
+
+//
+// Parallel loops
+//
+
+struct	btDbvtRefitLoop : btIParallelForBody
+{
+	btDbvtNode**	m_nodes;
+	void	forLoop(int iBegin,int iEnd) const
+	{
+		for(int i=iBegin;i<iEnd;++i)
+		{
+			refitsubtree(m_nodes[i]);
+		}
+	}
+};
+
+struct	btDbvtCollideLoop : btIParallelForBody
+{
+	btDbvtBroadphase*	m_broadphase;
+	void	forLoop(int iBegin,int iEnd) const
+	{
+		const int				thread=(int)btGetCurrentThreadIndex();
+		btAssert(thread<m_broadphase->m_threadpairs.size());
+		btDbvtProxyPairArray&	pairs=m_broadphase->m_threadpairs[thread];
+		btDbvtPairCollector		collector(&pairs);
+		for(int i=iBegin;i<iEnd;++i)
+		{
+			btDbvtBroadphase::btDbvtCollideTask&	task=m_broadphase->m_collidetasks[i];
+			task.thread	=	thread;
+			task.begin	=	pairs.size();
+			//collideTT uses a local stack, so several threads can traverse the same trees
+			m_broadphase->m_sets[0].collideTT(task.a,task.b,collector);
+			task.end	=	pairs.size();
+		}
+	}
+};
+
+struct	btDbvtPairInsertLoop : btIParallelForBody
+{
+	btDbvtBroadphase*	m_broadphase;
+	void	forLoop(int iBegin,int iEnd) const
+	{
+		btOverlappingPairCache*	paircache=m_broadphase->m_paircache;
+		for(int i=iBegin;i<iEnd;++i)
+		{
+			const btDbvtBroadphase::btDbvtCollideTask&	task=m_broadphase->m_collidetasks[i];
+			const btDbvtProxyPairArray&	pairs=m_broadphase->m_threadpairs[task.thread];
+			for(int j=task.begin;j<task.end;++j)
+			{
+				paircache->addOverlappingPairConcurrent(pairs[j].proxy0,pairs[j].proxy1);
+			}
+		}
+	}
+};
+
 //
 // btDbvtBroadphase
 //
@@ -123,6 +234,8 @@ btDbvtBroadphase::btDbvtBroadphase(btOverlappingPairCache* paircache)
 {
 	m_deferedcollide	=	false;
 	m_needcleanup		=	true;
+	m_parallelcollide	=	false;
+	m_needrefit			=	false;
 	m_releasepaircache	=	(paircache!=0)?false:true;
 	m_prediction		=	0;
 	m_stageCurrent		=	0;
@@ -178,7 +291,7 @@ btBroadphaseProxy*				btDbvtBroadphase::createProxy(	const btVector3& aabbMin,
 	proxy->m_uniqueId	=	++m_gid;
 	proxy->leaf			=	m_sets[0].insert(aabb,proxy);
 	listappend(proxy,m_stageRoots[m_stageCurrent]);
-	if(!m_deferedcollide)
+	if(!m_deferedcollide&&!m_parallelcollide)
 	{
 		btDbvtTreeCollider	collider(this);
 		collider.proxy=proxy;
@@ -228,6 +341,9 @@ void	btDbvtBroadphase::rayTest(const btVector3& rayFrom,const btVector3& rayTo,
 {
 	BroadphaseRayTester callback(rayCallback);
 
+	/* a single threaded query after setAabb refits here, concurrent queries need refitIfNeeded (or a world step) first	*/ 
+	refitIfNeeded();
+
 	m_sets[0].rayTestInternal(	m_sets[0].m_root,
 		rayFrom,
 		rayTo,
@@ -250,6 +366,30 @@ void	btDbvtBroadphase::rayTest(const btVector3& rayFrom,const btVector3& rayTo,
 
 }
 
+struct	BroadphaseRayPacketTester : btDbvt::ICollide
+{
+	btBroadphaseRayPacketCallback& m_rayCallback;
+	BroadphaseRayPacketTester(btBroadphaseRayPacketCallback& orgCallback)
+		:m_rayCallback(orgCallback)
+	{
+	}
+	void					ProcessRayPacket(const btDbvtNode* leaf,unsigned int rayMask)
+	{
+		btDbvtProxy*	proxy=(btDbvtProxy*)leaf->data;
+		m_rayCallback.process(proxy,rayMask);
+	}
+};
+
+bool	btDbvtBroadphase::rayTestPacket(btRayPacket& packet, btBroadphaseRayPacketCallback& rayCallback)
+{
+	refitIfNeeded();
+
+	BroadphaseRayPacketTester callback(rayCallback);
+	btDbvt::rayTestPacket(m_sets[0].m_root,packet,callback);
+	btDbvt::rayTestPacket(m_sets[1].m_root,packet,callback);
+	return true;
+}
+
 
 struct	BroadphaseAabbTester : btDbvt::ICollide
 {
@@ -269,6 +409,8 @@ void	btDbvtBroadphase::aabbTest(const btVector3& aabbMin,const btVector3& aabbMa
 {
 	BroadphaseAabbTester callback(aabbCallback);
 
+	refitIfNeeded();
+
 	const ATTRIBUTE_ALIGNED16(btDbvtVolume)	bounds=btDbvtVolume::FromMM(aabbMin,aabbMax);
 		//process all children, that overlap with  the given AABB bounds
 	m_sets[0].collideTV(m_sets[0].m_root,bounds,callback);
@@ -276,6 +418,41 @@ void	btDbvtBroadphase::aabbTest(const btVector3& aabbMin,const btVector3& aabbMa
 
 }
 
+struct	BroadphaseAabbBatchTester : btDbvt::ICollide
+{
+	btBroadphaseAabbBatchCallback& m_aabbCallback;
+	BroadphaseAabbBatchTester(btBroadphaseAabbBatchCallback& orgCallback)
+		:m_aabbCallback(orgCallback)
+	{
+	}
+	void					Process(const btDbvtNode* box,const btDbvtNode* leaf)
+	{
+		btDbvtProxy*	proxy=(btDbvtProxy*)leaf->data;
+		m_aabbCallback.process(proxy,box->dataAsInt);
+	}
+};
+
+void	btDbvtBroadphase::aabbTestBatch(const btVector3* aabbMins,const btVector3* aabbMaxs,int numBoxes,btBroadphaseAabbBatchCallback& aabbCallback)
+{
+	if (numBoxes<2)
+	{
+		btBroadphaseInterface::aabbTestBatch(aabbMins,aabbMaxs,numBoxes,aabbCallback);
+		return;
+	}
+
+	refitIfNeeded();
+
+	btDbvt boxes;
+	for (int i=0;i<numBoxes;i++)
+	{
+		const ATTRIBUTE_ALIGNED16(btDbvtVolume)	bounds=btDbvtVolume::FromMM(aabbMins[i],aabbMaxs[i]);
+		boxes.insert(bounds,0)->dataAsInt = i;
+	}
+	BroadphaseAabbBatchTester callback(aabbCallback);
+	boxes.collideTT(boxes.m_root,m_sets[0].m_root,callback);
+	boxes.collideTT(boxes.m_root,m_sets[1].m_root,callback);
+}
+
 
 
 //
@@ -308,7 +485,16 @@ void							btDbvtBroadphase::setAabb(		btBroadphaseProxy* absproxy,
 				if(delta[0]<0) velocity[0]=-velocity[0];
 				if(delta[1]<0) velocity[1]=-velocity[1];
 				if(delta[2]<0) velocity[2]=-velocity[2];
-				if	(
+				if(m_parallelcollide)
+				{/* Only the leaf, its parents are refit in collide	*/ 
+					if(growleaf(proxy->leaf,aabb,velocity))
+					{
+						++m_updates_done;
+						docollide=true;
+						m_needrefit=true;
+					}
+				}
+				else if	(
 #ifdef DBVT_BP_MARGIN				
 					m_sets[0].update(proxy->leaf,aabb,velocity,DBVT_BP_MARGIN)
 #else
@@ -335,7 +521,7 @@ void							btDbvtBroadphase::setAabb(		btBroadphaseProxy* absproxy,
 		if(docollide)
 		{
 			m_needcleanup=true;
-			if(!m_deferedcollide)
+			if(!m_deferedcollide&&!m_parallelcollide)
 			{
 				btDbvtTreeCollider	collider(this);
 				m_sets[1].collideTTpersistentStack(m_sets[1].m_root,proxy->leaf,collider);
@@ -345,6 +531,27 @@ void							btDbvtBroadphase::setAabb(		btBroadphaseProxy* absproxy,
 	}
 }
 
+//
+void							btDbvtBroadphase::setAabbs(		btBroadphaseProxy* const* proxies,
+														  const btVector3* aabbMins,
+														  const btVector3* aabbMaxs,
+														  int numProxies,
+														  btDispatcher* dispatcher)
+{
+	for(int i=0;i<numProxies;++i)
+	{
+		btDbvtBroadphase::setAabb(proxies[i],aabbMins[i],aabbMaxs[i],dispatcher);
+	}
+	/* refit once per batch, so the queries don't have to	*/ 
+	refitIfNeeded();
+}
+
+//
+void							btDbvtBroadphase::refitIfNeeded()
+{
+	if(m_needrefit) refit();
+}
+
 
 //
 void							btDbvtBroadphase::setAabbForceUpdate(		btBroadphaseProxy* absproxy,
@@ -377,7 +584,7 @@ void							btDbvtBroadphase::setAabbForceUpdate(		btBroadphaseProxy* absproxy,
 	if(docollide)
 	{
 		m_needcleanup=true;
-		if(!m_deferedcollide)
+		if(!m_deferedcollide&&!m_parallelcollide)
 		{
 			btDbvtTreeCollider	collider(this);
 			m_sets[1].collideTTpersistentStack(m_sets[1].m_root,proxy->leaf,collider);
@@ -507,6 +714,11 @@ void							btDbvtBroadphase::collide(btDispatcher* dispatcher)
 
 
 	SPC(m_profiling.m_total);
+	/* refit				*/ 
+	if(m_needrefit)
+	{
+		refit();
+	}
 	/* optimize				*/ 
 	m_sets[0].optimizeIncremental(1+(m_sets[0].m_leaves*m_dupdates)/100);
 	if(m_fixedleft)
@@ -541,6 +753,18 @@ void							btDbvtBroadphase::collide(btDispatcher* dispatcher)
 		m_needcleanup=true;
 	}
 	/* collide dynamics		*/ 
+	if(m_parallelcollide)
+	{
+		{
+			SPC(m_profiling.m_fdcollide);
+			collideParallel(m_sets[0].m_root,m_sets[1].m_root);
+		}
+		{
+			SPC(m_profiling.m_ddcollide);
+			collideParallel(m_sets[0].m_root,m_sets[0].m_root);
+		}
+	}
+	else
 	{
 		btDbvtTreeCollider	collider(this);
 		if(m_deferedcollide)
@@ -592,6 +816,176 @@ void							btDbvtBroadphase::collide(btDispatcher* dispatcher)
 	m_updates_call/=2;
 }
 
+//
+void							btDbvtBroadphase::refit()
+{
+	m_needrefit=false;
+	btDbvtNode*	root=m_sets[0].m_root;
+	if(!root) return;
+	if(m_sets[0].m_leaves<DBVT_BP_PARALLEL_MINLEAVES)
+	{
+		refitsubtree(root);
+		return;
+	}
+	/* split breadth first, [0,first) are the ancestors of the subtrees [first,size)	*/ 
+	m_refitnodes.resize(0);
+	m_refitnodes.push_back(root);
+	int	first=0;
+	while((m_refitnodes.size()-first)<DBVT_BP_PARALLEL_TASKCOUNT && first<m_refitnodes.size())
+	{
+		btDbvtNode*	node=m_refitnodes[first++];
+		if(node->isinternal())
+		{
+			m_refitnodes.push_back(node->childs[0]);
+			m_refitnodes.push_back(node->childs[1]);
+		}
+	}
+	/* refit the subtrees			*/ 
+	if(first<m_refitnodes.size())
+	{
+		btDbvtRefitLoop	loop;
+		loop.m_nodes=&m_refitnodes[0];
+		btParallelFor(first,m_refitnodes.size(),1,loop);
+	}
+	/* then their ancestors, children before parents	*/ 
+	for(int i=first-1;i>=0;--i)
+	{
+		btDbvtNode*	node=m_refitnodes[i];
+		if(node->isinternal())
+		{
+			Merge(node->childs[0]->volume,node->childs[1]->volume,node->volume);
+		}
+	}
+}
+
+//
+void							btDbvtBroadphase::collideParallel(const btDbvtNode* root0,const btDbvtNode* root1)
+{
+	if(!root0||!root1) return;
+	if(m_sets[0].m_leaves<DBVT_BP_PARALLEL_MINLEAVES)
+	{
+		btDbvtTreeCollider	collider(this);
+		m_sets[0].collideTTpersistentStack(root0,root1,collider);
+		return;
+	}
+	/* split the traversal level by level, the same way collideTT descends	*/ 
+	m_collidetasks.resize(0);
+	btDbvtCollideTask	root;
+	root.a=root0;
+	root.b=root1;
+	m_collidetasks.push_back(root);
+	bool	expanded=true;
+	while(expanded && m_collidetasks.size()<DBVT_BP_PARALLEL_TASKCOUNT)
+	{
+		expanded=false;
+		const int	ni=m_collidetasks.size();
+		int			nj=0;
+		for(int i=0;i<ni;++i)
+		{
+			const btDbvtNode*	a=m_collidetasks[i].a;
+			const btDbvtNode*	b=m_collidetasks[i].b;
+			const btDbvtNode*	childs[4][2];
+			int					count=0;
+			if(a==b)
+			{
+				if(a->isinternal())
+				{
+					childs[0][0]=a->childs[0];childs[0][1]=a->childs[0];
+					childs[1][0]=a->childs[1];childs[1][1]=a->childs[1];
+					childs[2][0]=a->childs[0];childs[2][1]=a->childs[1];
+					count=3;
+				}
+			}
+			else if(Intersect(a->volume,b->volume))
+			{
+				if(a->isinternal()&&b->isinternal())
+				{
+					childs[0][0]=a->childs[0];childs[0][1]=b->childs[0];
+					childs[1][0]=a->childs[1];childs[1][1]=b->childs[0];
+					childs[2][0]=a->childs[0];childs[2][1]=b->childs[1];
+					childs[3][0]=a->childs[1];childs[3][1]=b->childs[1];
+					count=4;
+				}
+				else if(a->isinternal())
+				{
+					childs[0][0]=a->childs[0];childs[0][1]=b;
+					childs[1][0]=a->childs[1];childs[1][1]=b;
+					count=2;
+				}
+				else if(b->isinternal())
+				{
+					childs[0][0]=a;childs[0][1]=b->childs[0];
+					childs[1][0]=a;childs[1][1]=b->childs[1];
+					count=2;
+				}
+				else
+				{/* Overlapping leaves, can't be split further	*/ 
+					childs[0][0]=a;childs[0][1]=b;
+					count=1;
+				}
+			}
+			/* replace the task by its children, removed tasks are compacted	*/ 
+			for(int j=0;j<count;++j)
+			{
+				btDbvtCollideTask	task;
+				task.a=childs[j][0];
+				task.b=childs[j][1];
+				if(j==0)
+					m_collidetasks[nj++]=task;
+				else
+					m_collidetasks.push_back(task);
+			}
+			expanded|=(count>1);
+		}
+		/* move the appended children next to the kept tasks	*/ 
+		const int	na=m_collidetasks.size()-ni;
+		for(int k=0;k<na;++k)
+		{
+			m_collidetasks[nj+k]=m_collidetasks[ni+k];
+		}
+		m_collidetasks.resize(nj+na);
+	}
+	if(m_collidetasks.size()==0) return;
+	/* collide the tasks, each thread collects pairs in its own buffer	*/ 
+	m_threadpairs.resize(btGetNumThreadIndices());
+	btDbvtCollideLoop	loop;
+	loop.m_broadphase=this;
+	btParallelFor(0,m_collidetasks.size(),1,loop);
+	if(m_paircache->supportsConcurrentInsert())
+	{
+		/* the pair cache sorts the new pairs, so it doesn't depend on the scheduling either	*/ 
+		int	numpairs=0;
+		for(int i=0;i<m_collidetasks.size();++i)
+		{
+			numpairs+=m_collidetasks[i].end-m_collidetasks[i].begin;
+		}
+		m_paircache->beginConcurrentInsert(numpairs);
+		btDbvtPairInsertLoop	insertloop;
+		insertloop.m_broadphase=this;
+		btParallelFor(0,m_collidetasks.size(),1,insertloop);
+		m_paircache->endConcurrentInsert();
+		m_newpairs+=numpairs;
+	}
+	else
+	{
+		/* merge the pairs in task order, so the pair cache doesn't depend on the scheduling	*/ 
+		for(int i=0;i<m_collidetasks.size();++i)
+		{
+			const btDbvtCollideTask&	task=m_collidetasks[i];
+			const btDbvtProxyPairArray&	pairs=m_threadpairs[task.thread];
+			for(int j=task.begin;j<task.end;++j)
+			{
+				m_paircache->addOverlappingPair(pairs[j].proxy0,pairs[j].proxy1);
+				++m_newpairs;
+			}
+		}
+	}
+	for(int i=0;i<m_threadpairs.size();++i)
+	{
+		m_threadpairs[i].resize(0);
+	}
+}
+
 //
 void							btDbvtBroadphase::optimize()
 {
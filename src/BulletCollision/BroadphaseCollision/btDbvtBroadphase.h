@@ -30,6 +30,8 @@ subject to the following restrictions:
 #define DBVT_BP_ACCURATESLEEPING		0
 #define DBVT_BP_ENABLE_BENCHMARK		0
 #define DBVT_BP_MARGIN					(btScalar)0.05
+#define DBVT_BP_PARALLEL_TASKCOUNT		128	/* Minimum number of tasks a parallel refit/collide is split into	*/
+#define DBVT_BP_PARALLEL_MINLEAVES		256	/* Smaller trees are refit/collided sequentially	*/
 
 #if DBVT_BP_PROFILE
 #define	DBVT_BP_PROFILING_RATE	256
@@ -56,9 +58,22 @@ struct btDbvtProxy : btBroadphaseProxy
 
 typedef btAlignedObjectArray<btDbvtProxy*>	btDbvtProxyArray;
 
+//
+// btDbvtProxyPair
+//
+struct btDbvtProxyPair
+{
+	btDbvtProxy*	proxy0;
+	btDbvtProxy*	proxy1;
+};
+
+typedef btAlignedObjectArray<btDbvtProxyPair>	btDbvtProxyPairArray;
+
 ///The btDbvtBroadphase implements a broadphase using two dynamic AABB bounding volume hierarchies/trees (see btDbvt).
 ///One tree is used for static/non-moving objects, and another tree is used for dynamic objects. Objects can move from one tree to the other.
 ///This is a very fast broadphase, especially for very dynamic worlds where many objects are moving. Its insert/add and remove of objects is generally faster than the sweep and prune broadphases btAxisSweep3 and bt32BitAxisSweep3.
+///With setParallelCollide(true), setAabb only updates the leaves, and collide refits the dynamic tree and collides the trees using btParallelFor.
+///setAabbs refits at the end of the batch. After single setAabb calls the next query refits, so refitIfNeeded has to be called before queries run on several threads.
 struct	btDbvtBroadphase : btBroadphaseInterface
 {
 	/* Config		*/ 
@@ -87,6 +102,19 @@ struct	btDbvtBroadphase : btBroadphaseInterface
 	bool					m_releasepaircache;			// Release pair cache on delete
 	bool					m_deferedcollide;			// Defere dynamic/static collision to collide call
 	bool					m_needcleanup;				// Need to run cleanup?
+	bool					m_parallelcollide;			// Refit and collide the trees in collide, using btParallelFor
+	bool					m_needrefit;				// Leaves of the dynamic set moved without updating their parents
+	struct	btDbvtCollideTask
+	{
+		const btDbvtNode*	a;
+		const btDbvtNode*	b;
+		int					thread;
+		int					begin;
+		int					end;
+	};
+	btAlignedObjectArray<btDbvtCollideTask>		m_collidetasks;		// Node pairs collided by the tasks of collideParallel
+	btAlignedObjectArray<btDbvtProxyPairArray>	m_threadpairs;		// Pairs found by each thread, merged into the pair cache in task order
+	btAlignedObjectArray<btDbvtNode*>			m_refitnodes;		// Subtree roots and their ancestors, see refit
 #if DBVT_BP_PROFILE
 	btClock					m_clock;
 	struct	{
@@ -102,13 +130,23 @@ struct	btDbvtBroadphase : btBroadphaseInterface
 	~btDbvtBroadphase();
 	void							collide(btDispatcher* dispatcher);
 	void							optimize();
+	///recompute the volumes of the internal nodes of the dynamic set, in parallel for large trees
+	void							refit();
+	///collide two subtrees, the traversal is split in tasks that are processed by btParallelFor
+	void							collideParallel(const btDbvtNode* root0,const btDbvtNode* root1);
 	
 	/* btBroadphaseInterface Implementation	*/
 	btBroadphaseProxy*				createProxy(const btVector3& aabbMin,const btVector3& aabbMax,int shapeType,void* userPtr,short int collisionFilterGroup,short int collisionFilterMask,btDispatcher* dispatcher,void* multiSapProxy);
 	virtual void					destroyProxy(btBroadphaseProxy* proxy,btDispatcher* dispatcher);
 	virtual void					setAabb(btBroadphaseProxy* proxy,const btVector3& aabbMin,const btVector3& aabbMax,btDispatcher* dispatcher);
+	virtual void					setAabbs(btBroadphaseProxy* const* proxies,const btVector3* aabbMins,const btVector3* aabbMaxs,int numProxies,btDispatcher* dispatcher);
 	virtual void					rayTest(const btVector3& rayFrom,const btVector3& rayTo, btBroadphaseRayCallback& rayCallback, const btVector3& aabbMin=btVector3(0,0,0), const btVector3& aabbMax = btVector3(0,0,0));
 	virtual void					aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback);
+	///collides a temporary tree of the boxes with both sets, instead of a traversal per box
+	virtual void					aabbTestBatch(const btVector3* aabbMins, const btVector3* aabbMaxs, int numBoxes, btBroadphaseAabbBatchCallback& callback);
+	virtual bool					rayTestPacket(btRayPacket& packet, btBroadphaseRayPacketCallback& callback);
+	///refit the dynamic set after setAabb in parallel collide mode, so that concurrent queries don't have to
+	virtual void					refitIfNeeded();
 
 	virtual void					getAabb(btBroadphaseProxy* proxy,btVector3& aabbMin, btVector3& aabbMax ) const;
 	virtual	void					calculateOverlappingPairs(btDispatcher* dispatcher);
@@ -132,6 +170,17 @@ struct	btDbvtBroadphase : btBroadphaseInterface
 		return m_prediction;
 	}
 
+	///in parallel collide mode, new overlapping pairs are only found in collide (like m_deferedcollide).
+	///When the pair cache supports concurrent insertion (btOpenAddressingPairCache), the threads also add the new pairs.
+	void	setParallelCollide(bool parallelCollide)
+	{
+		m_parallelcollide = parallelCollide;
+	}
+	bool	getParallelCollide() const
+	{
+		return m_parallelcollide;
+	}
+
 	///this setAabbForceUpdate is similar to setAabb but always forces the aabb update. 
 	///it is not part of the btBroadphaseInterface but specific to btDbvtBroadphase.
 	///it bypasses certain optimizations that prevent aabb updates (when the aabb shrinks), see
@@ -14,9 +14,17 @@ subject to the following restrictions:
 */
 
 #include "btDispatcher.h"
+#include "LinearMath/btStackAlloc.h"
 
 btDispatcher::~btDispatcher()
 {
 
 }
 
+btStackAlloc*	btDispatcherInfo::getStackAllocator() const
+{
+	if (m_threadStackAllocator)
+		return m_threadStackAllocator->getStackAlloc();
+	return m_stackAllocator;
+}
+
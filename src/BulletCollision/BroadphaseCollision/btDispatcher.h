@@ -26,7 +26,9 @@ struct btCollisionObjectWrapper;
 
 class btPersistentManifold;
 class btStackAlloc;
+class btThreadStackAlloc;
 class btPoolAllocator;
+class btManifoldReduction;
 
 struct btDispatcherInfo
 {
@@ -48,7 +50,8 @@ struct btDispatcherInfo
 		m_allowedCcdPenetration(btScalar(0.04)),
 		m_useConvexConservativeDistanceUtil(false),
 		m_convexConservativeDistanceThreshold(0.0f),
-		m_stackAllocator(0)
+		m_stackAllocator(0),
+		m_threadStackAllocator(0)
 	{
 
 	}
@@ -65,6 +68,11 @@ struct btDispatcherInfo
 	bool		m_useConvexConservativeDistanceUtil;
 	btScalar	m_convexConservativeDistanceThreshold;
 	btStackAlloc*	m_stackAllocator;
+	///when set, each thread of the task scheduler uses its own stack allocator, see getStackAllocator
+	btThreadStackAlloc*	m_threadStackAllocator;
+
+	///the stack allocator for temporary memory of the calling thread
+	btStackAlloc*	getStackAllocator() const;
 };
 
 ///The btDispatcher interface class can be used in combination with broadphase to dispatch calculations for overlapping pairs.
@@ -104,6 +112,12 @@ public:
 
 	virtual	void freeCollisionAlgorithm(void* ptr) = 0;
 
+	///releaseManifold reports the released manifolds to the manifold reduction (see btManifoldReduction::removeManifold), 0 to stop it
+	virtual void	setManifoldReduction(btManifoldReduction* manifoldReduction)
+	{
+		(void)manifoldReduction;
+	}
+
 };
 
 
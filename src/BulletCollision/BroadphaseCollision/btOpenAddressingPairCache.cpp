@@ -0,0 +1,420 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btOpenAddressingPairCache.h"
+
+#include "btDispatcher.h"
+#include "btCollisionAlgorithm.h"
+#include "LinearMath/btAlignedAllocator.h"
+#include "LinearMath/btThreads.h"
+
+#include <new>
+
+//values of m_hash
+#define BT_PAIR_SLOT_EMPTY 0
+#define BT_PAIR_SLOT_REMOVED 1
+
+//values of m_pairIndex that are not a pair index: the pair of an empty slot is pending,
+//a slot gets a lost pair when addOverlappingPairConcurrent was called too often
+#define BT_PAIR_INDEX_PENDING -1
+#define BT_PAIR_INDEX_LOST -2
+
+#define BT_PAIR_CACHE_MIN_BUCKETS 4
+
+extern int gOverlappingPairs;
+
+btOpenAddressingPairCache::btOpenAddressingPairCache()
+	:m_overlapFilterCallback(0),
+	m_ghostPairCallback(0),
+	m_buckets(0),
+	m_numBuckets(0),
+	m_numRemovedSlots(0),
+	m_concurrentFirstPair(0),
+	m_concurrentMaxPairs(0),
+	m_concurrentNumPairs(0),
+	m_concurrentInsert(false)
+{
+	m_overlappingPairArray.reserve(2);
+	rebuildTable(BT_PAIR_CACHE_MIN_BUCKETS);
+}
+
+btOpenAddressingPairCache::~btOpenAddressingPairCache()
+{
+	btAlignedFree(m_buckets);
+}
+
+void	btOpenAddressingPairCache::rebuildTable(int numBuckets)
+{
+	btAssert((numBuckets & (numBuckets-1)) == 0);
+	if (numBuckets != m_numBuckets)
+	{
+		btAlignedFree(m_buckets);
+		m_buckets = (btPairCacheBucket*)btAlignedAlloc(sizeof(btPairCacheBucket)*numBuckets,64);
+		m_numBuckets = numBuckets;
+	}
+	for (int b=0;b<m_numBuckets;b++)
+	{
+		for (int s=0;s<BT_PAIR_BUCKET_SIZE;s++)
+		{
+			m_buckets[b].m_hash[s] = BT_PAIR_SLOT_EMPTY;
+			m_buckets[b].m_pairIndex[s] = BT_PAIR_INDEX_PENDING;
+		}
+	}
+	m_numRemovedSlots = 0;
+
+	for (int i=0;i<m_overlappingPairArray.size();i++)
+	{
+		const btBroadphasePair& pair = m_overlappingPairArray[i];
+		insertSlot(getHash(pair.m_pProxy0,pair.m_pProxy1),i);
+	}
+}
+
+void	btOpenAddressingPairCache::reserveSlots(int numNewPairs)
+{
+	//keep the table at most half full, counting the removed slots
+	int numSlots = m_numBuckets*BT_PAIR_BUCKET_SIZE;
+	if ((m_overlappingPairArray.size()+m_numRemovedSlots+numNewPairs)*2 <= numSlots)
+		return;
+
+	int numBuckets = BT_PAIR_CACHE_MIN_BUCKETS;
+	while (numBuckets*BT_PAIR_BUCKET_SIZE < (m_overlappingPairArray.size()+numNewPairs)*2)
+	{
+		numBuckets *= 2;
+	}
+	rebuildTable(numBuckets);
+}
+
+void	btOpenAddressingPairCache::insertSlot(int hash, int pairIndex)
+{
+	//only used for pairs that are not in the table yet, so the first free slot will do
+	int bucket = hash & (m_numBuckets-1);
+	for (;;)
+	{
+		btPairCacheBucket& b = m_buckets[bucket];
+		for (int s=0;s<BT_PAIR_BUCKET_SIZE;s++)
+		{
+			if (b.m_hash[s] == BT_PAIR_SLOT_EMPTY || b.m_hash[s] == BT_PAIR_SLOT_REMOVED)
+			{
+				if (b.m_hash[s] == BT_PAIR_SLOT_REMOVED)
+					m_numRemovedSlots--;
+				b.m_hash[s] = hash;
+				b.m_pairIndex[s] = pairIndex;
+				return;
+			}
+		}
+		bucket = (bucket+1) & (m_numBuckets-1);
+	}
+}
+
+bool	btOpenAddressingPairCache::findSlot(const btBroadphaseProxy* proxy0, const btBroadphaseProxy* proxy1, int hash, int& bucket, int& slot) const
+{
+	bucket = hash & (m_numBuckets-1);
+	for (;;)
+	{
+		const btPairCacheBucket& b = m_buckets[bucket];
+		for (int s=0;s<BT_PAIR_BUCKET_SIZE;s++)
+		{
+			//slots are filled in order and never emptied, so an empty slot ends the probe sequence
+			if (b.m_hash[s] == BT_PAIR_SLOT_EMPTY)
+				return false;
+			if (b.m_hash[s] == hash && b.m_pairIndex[s] >= 0 && equalsPair(b.m_pairIndex[s],proxy0,proxy1))
+			{
+				slot = s;
+				return true;
+			}
+		}
+		bucket = (bucket+1) & (m_numBuckets-1);
+	}
+}
+
+void	btOpenAddressingPairCache::findSlotOfPairIndex(int pairIndex, int& bucket, int& slot) const
+{
+	const btBroadphasePair& pair = m_overlappingPairArray[pairIndex];
+	int hash = getHash(pair.m_pProxy0,pair.m_pProxy1);
+	bucket = hash & (m_numBuckets-1);
+	for (;;)
+	{
+		const btPairCacheBucket& b = m_buckets[bucket];
+		for (int s=0;s<BT_PAIR_BUCKET_SIZE;s++)
+		{
+			btAssert(b.m_hash[s] != BT_PAIR_SLOT_EMPTY);
+			if (b.m_hash[s] == hash && b.m_pairIndex[s] == pairIndex)
+			{
+				slot = s;
+				return;
+			}
+		}
+		bucket = (bucket+1) & (m_numBuckets-1);
+	}
+}
+
+btBroadphasePair*	btOpenAddressingPairCache::addOverlappingPair(btBroadphaseProxy* proxy0,btBroadphaseProxy* proxy1)
+{
+	btAssert(!m_concurrentInsert);
+	gAddedPairs++;
+
+	if (!needsBroadphaseCollision(proxy0,proxy1))
+		return 0;
+
+	if (proxy0->m_uniqueId>proxy1->m_uniqueId)
+		btSwap(proxy0,proxy1);
+
+	int hash = getHash(proxy0,proxy1);
+	int bucket,slot;
+	if (findSlot(proxy0,proxy1,hash,bucket,slot))
+	{
+		return &m_overlappingPairArray[m_buckets[bucket].m_pairIndex[slot]];
+	}
+
+	reserveSlots(1);
+
+	int pairIndex = m_overlappingPairArray.size();
+	void* mem = &m_overlappingPairArray.expandNonInitializing();
+
+	//this is where we add an actual pair, so also call the 'ghost'
+	if (m_ghostPairCallback)
+		m_ghostPairCallback->addOverlappingPair(proxy0,proxy1);
+
+	btBroadphasePair* pair = new (mem) btBroadphasePair(*proxy0,*proxy1);
+	pair->m_algorithm = 0;
+	pair->m_internalTmpValue = 0;
+
+	insertSlot(hash,pairIndex);
+	return pair;
+}
+
+void*	btOpenAddressingPairCache::removeOverlappingPair(btBroadphaseProxy* proxy0,btBroadphaseProxy* proxy1,btDispatcher* dispatcher)
+{
+	btAssert(!m_concurrentInsert);
+	gRemovePairs++;
+
+	if (proxy0->m_uniqueId>proxy1->m_uniqueId)
+		btSwap(proxy0,proxy1);
+
+	int bucket,slot;
+	if (!findSlot(proxy0,proxy1,getHash(proxy0,proxy1),bucket,slot))
+		return 0;
+
+	int pairIndex = m_buckets[bucket].m_pairIndex[slot];
+	btBroadphasePair& pair = m_overlappingPairArray[pairIndex];
+	cleanOverlappingPair(pair,dispatcher);
+	void* userData = pair.m_internalInfo1;
+
+	m_buckets[bucket].m_hash[slot] = BT_PAIR_SLOT_REMOVED;
+	m_buckets[bucket].m_pairIndex[slot] = BT_PAIR_INDEX_PENDING;
+	m_numRemovedSlots++;
+
+	if (m_ghostPairCallback)
+		m_ghostPairCallback->removeOverlappingPair(proxy0,proxy1,dispatcher);
+
+	//move the last pair into the spot of the removed pair, only its slot needs to be updated
+	int lastPairIndex = m_overlappingPairArray.size()-1;
+	if (pairIndex != lastPairIndex)
+	{
+		int lastBucket,lastSlot;
+		findSlotOfPairIndex(lastPairIndex,lastBucket,lastSlot);
+		m_buckets[lastBucket].m_pairIndex[lastSlot] = pairIndex;
+		m_overlappingPairArray[pairIndex] = m_overlappingPairArray[lastPairIndex];
+	}
+	m_overlappingPairArray.pop_back();
+
+	return userData;
+}
+
+btBroadphasePair*	btOpenAddressingPairCache::findPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1)
+{
+	btAtomicFetchAdd(&gFindPairs,1);
+	if (proxy0->m_uniqueId>proxy1->m_uniqueId)
+		btSwap(proxy0,proxy1);
+
+	int bucket,slot;
+	if (!findSlot(proxy0,proxy1,getHash(proxy0,proxy1),bucket,slot))
+		return 0;
+	return &m_overlappingPairArray[m_buckets[bucket].m_pairIndex[slot]];
+}
+
+void	btOpenAddressingPairCache::cleanOverlappingPair(btBroadphasePair& pair,btDispatcher* dispatcher)
+{
+	if (pair.m_algorithm)
+	{
+		pair.m_algorithm->~btCollisionAlgorithm();
+		dispatcher->freeCollisionAlgorithm(pair.m_algorithm);
+		pair.m_algorithm=0;
+	}
+}
+
+void	btOpenAddressingPairCache::cleanProxyFromPairs(btBroadphaseProxy* proxy,btDispatcher* dispatcher)
+{
+	for (int i=0;i<m_overlappingPairArray.size();i++)
+	{
+		btBroadphasePair& pair = m_overlappingPairArray[i];
+		if (pair.m_pProxy0 == proxy || pair.m_pProxy1 == proxy)
+		{
+			cleanOverlappingPair(pair,dispatcher);
+		}
+	}
+}
+
+void	btOpenAddressingPairCache::removeOverlappingPairsContainingProxy(btBroadphaseProxy* proxy,btDispatcher* dispatcher)
+{
+	for (int i=0;i<m_overlappingPairArray.size();)
+	{
+		btBroadphasePair& pair = m_overlappingPairArray[i];
+		if (pair.m_pProxy0 == proxy || pair.m_pProxy1 == proxy)
+		{
+			//the last pair moves to i
+			removeOverlappingPair(pair.m_pProxy0,pair.m_pProxy1,dispatcher);
+		} else
+		{
+			i++;
+		}
+	}
+}
+
+void	btOpenAddressingPairCache::processAllOverlappingPairs(btOverlapCallback* callback,btDispatcher* dispatcher)
+{
+	for (int i=0;i<m_overlappingPairArray.size();)
+	{
+		btBroadphasePair* pair = &m_overlappingPairArray[i];
+		if (callback->processOverlap(*pair))
+		{
+			removeOverlappingPair(pair->m_pProxy0,pair->m_pProxy1,dispatcher);
+
+			gOverlappingPairs--;
+		} else
+		{
+			i++;
+		}
+	}
+}
+
+void	btOpenAddressingPairCache::sortOverlappingPairs(btDispatcher* dispatcher)
+{
+	(void)dispatcher;
+	m_overlappingPairArray.quickSort(btBroadphasePairSortPredicate());
+	rebuildTable(m_numBuckets);
+}
+
+void	btOpenAddressingPairCache::beginConcurrentInsert(int maxNewPairs)
+{
+	btAssert(!m_concurrentInsert);
+	reserveSlots(maxNewPairs);
+	m_concurrentFirstPair = m_overlappingPairArray.size();
+	m_concurrentMaxPairs = maxNewPairs;
+	m_concurrentNumPairs = 0;
+	m_overlappingPairArray.resize(m_concurrentFirstPair+maxNewPairs);
+	m_concurrentInsert = true;
+}
+
+btBroadphasePair*	btOpenAddressingPairCache::addOverlappingPairConcurrent(btBroadphaseProxy* proxy0,btBroadphaseProxy* proxy1)
+{
+	btAssert(m_concurrentInsert);
+	if (!needsBroadphaseCollision(proxy0,proxy1))
+		return 0;
+
+	if (proxy0->m_uniqueId>proxy1->m_uniqueId)
+		btSwap(proxy0,proxy1);
+
+	//Slots only go from empty to used during concurrent insertion, and all threads probe in the same order.
+	//A thread claims the first empty slot with a compare and swap of the hash, and publishes the pair index when the pair is written.
+	//The threads that find the hash in a slot wait for the pair index and compare the pair, so a pair is never added twice.
+	int hash = getHash(proxy0,proxy1);
+	int bucket = hash & (m_numBuckets-1);
+	for (;;)
+	{
+		btPairCacheBucket& b = m_buckets[bucket];
+		for (int s=0;s<BT_PAIR_BUCKET_SIZE;s++)
+		{
+			int slotHash = btAtomicLoad(&b.m_hash[s]);
+			if (slotHash == BT_PAIR_SLOT_EMPTY)
+			{
+				slotHash = btAtomicCompareExchange(&b.m_hash[s],BT_PAIR_SLOT_EMPTY,hash);
+				if (slotHash == BT_PAIR_SLOT_EMPTY)
+				{
+					int newPair = btAtomicFetchAdd(&m_concurrentNumPairs,1);
+					if (newPair >= m_concurrentMaxPairs)
+					{
+						btAssert(0);
+						btAtomicStore(&b.m_pairIndex[s],BT_PAIR_INDEX_LOST);
+						return 0;
+					}
+					int pairIndex = m_concurrentFirstPair+newPair;
+					btBroadphasePair* pair = new (&m_overlappingPairArray[pairIndex]) btBroadphasePair(*proxy0,*proxy1);
+					pair->m_algorithm = 0;
+					//remember the slot, endConcurrentInsert moves the pairs
+					pair->m_internalTmpValue = bucket*BT_PAIR_BUCKET_SIZE+s;
+					btAtomicStore(&b.m_pairIndex[s],pairIndex);
+					return pair;
+				}
+			}
+			if (slotHash == hash)
+			{
+				int pairIndex;
+				while ((pairIndex = btAtomicLoad(&b.m_pairIndex[s])) == BT_PAIR_INDEX_PENDING)
+				{
+					btSpinPause();
+				}
+				if (pairIndex >= 0 && equalsPair(pairIndex,proxy0,proxy1))
+				{
+					return &m_overlappingPairArray[pairIndex];
+				}
+			}
+		}
+		bucket = (bucket+1) & (m_numBuckets-1);
+	}
+}
+
+void	btOpenAddressingPairCache::endConcurrentInsert()
+{
+	btAssert(m_concurrentInsert);
+	m_concurrentInsert = false;
+
+	int numNewPairs = m_concurrentNumPairs;
+	if (numNewPairs > m_concurrentMaxPairs)
+	{
+		//the slots of the lost pairs are marked as removed
+		for (int b=0;b<m_numBuckets;b++)
+		{
+			for (int s=0;s<BT_PAIR_BUCKET_SIZE;s++)
+			{
+				if (m_buckets[b].m_pairIndex[s] == BT_PAIR_INDEX_LOST)
+				{
+					m_buckets[b].m_hash[s] = BT_PAIR_SLOT_REMOVED;
+					m_buckets[b].m_pairIndex[s] = BT_PAIR_INDEX_PENDING;
+					m_numRemovedSlots++;
+				}
+			}
+		}
+		numNewPairs = m_concurrentMaxPairs;
+	}
+
+	int firstPair = m_concurrentFirstPair;
+	m_overlappingPairArray.resize(firstPair+numNewPairs);
+	if (numNewPairs > 1)
+	{
+		m_overlappingPairArray.quickSortInternal(btBroadphasePairSortPredicate(),firstPair,firstPair+numNewPairs-1);
+	}
+	for (int i=firstPair;i<firstPair+numNewPairs;i++)
+	{
+		btBroadphasePair& pair = m_overlappingPairArray[i];
+		int slot = pair.m_internalTmpValue;
+		m_buckets[slot/BT_PAIR_BUCKET_SIZE].m_pairIndex[slot%BT_PAIR_BUCKET_SIZE] = i;
+		pair.m_internalTmpValue = 0;
+
+		if (m_ghostPairCallback)
+			m_ghostPairCallback->addOverlappingPair(pair.m_pProxy0,pair.m_pProxy1);
+	}
+	gAddedPairs += numNewPairs;
+}
@@ -0,0 +1,182 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_OPEN_ADDRESSING_PAIR_CACHE_H
+#define BT_OPEN_ADDRESSING_PAIR_CACHE_H
+
+#include "btOverlappingPairCache.h"
+
+#define BT_PAIR_BUCKET_SIZE 8
+
+///btPairCacheBucket is one cache line of the hash table of btOpenAddressingPairCache.
+///m_hash is 0 for an empty slot, 1 for a removed slot, and the hash of the pair otherwise. m_pairIndex is the index of the pair in the pair array.
+ATTRIBUTE_ALIGNED64(struct) btPairCacheBucket
+{
+	volatile int	m_hash[BT_PAIR_BUCKET_SIZE];
+	volatile int	m_pairIndex[BT_PAIR_BUCKET_SIZE];
+};
+
+///btOpenAddressingPairCache is an alternative to btHashedOverlappingPairCache that uses open addressing instead of chaining.
+///The hash table is an array of cache line sized buckets that are probed linearly, a lookup usually touches a single cache line
+///of the table and no other array than the pair array. Removed slots are marked and reused, the table is rebuilt when it gets too full.
+///The pairs are stored in a contiguous btBroadphasePairArray, like the other pair caches.
+///It also supports concurrent insertion (see beginConcurrentInsert), used by btDbvtBroadphase in parallel collide mode to add the pairs from several threads without a lock.
+class btOpenAddressingPairCache : public btOverlappingPairCache
+{
+	btBroadphasePairArray	m_overlappingPairArray;
+	btOverlapFilterCallback*	m_overlapFilterCallback;
+	btOverlappingPairCallback*	m_ghostPairCallback;
+
+	btPairCacheBucket*	m_buckets;
+	int			m_numBuckets;
+	int			m_numRemovedSlots;
+
+	//concurrent insertion
+	int			m_concurrentFirstPair;
+	int			m_concurrentMaxPairs;
+	volatile int	m_concurrentNumPairs;
+	bool		m_concurrentInsert;
+
+	static SIMD_FORCE_INLINE int	getHash(const btBroadphaseProxy* proxy0, const btBroadphaseProxy* proxy1)
+	{
+		unsigned int key = (unsigned int)proxy0->m_uniqueId * 0x9E3779B1u ^ (unsigned int)proxy1->m_uniqueId * 0x85EBCA77u;
+		key ^= key >> 15;
+		key *= 0x2C1B3C6Du;
+		key ^= key >> 12;
+		//0 and 1 mark empty and removed slots
+		int hash = int(key & 0x7fffffff);
+		return hash < 2 ? hash + 2 : hash;
+	}
+
+	SIMD_FORCE_INLINE bool	equalsPair(int pairIndex, const btBroadphaseProxy* proxy0, const btBroadphaseProxy* proxy1) const
+	{
+		const btBroadphasePair& pair = m_overlappingPairArray[pairIndex];
+		return pair.m_pProxy0 == proxy0 && pair.m_pProxy1 == proxy1;
+	}
+
+	///find the slot of the pair, returns false when it is not in the table
+	bool	findSlot(const btBroadphaseProxy* proxy0, const btBroadphaseProxy* proxy1, int hash, int& bucket, int& slot) const;
+
+	///find the slot that points to pairIndex
+	void	findSlotOfPairIndex(int pairIndex, int& bucket, int& slot) const;
+
+	void	insertSlot(int hash, int pairIndex);
+
+	void	rebuildTable(int numBuckets);
+
+	///rebuild the table when it can't take numNewPairs more pairs without going over half full
+	void	reserveSlots(int numNewPairs);
+
+public:
+
+	btOpenAddressingPairCache();
+	virtual ~btOpenAddressingPairCache();
+
+	SIMD_FORCE_INLINE bool needsBroadphaseCollision(btBroadphaseProxy* proxy0,btBroadphaseProxy* proxy1) const
+	{
+		if (m_overlapFilterCallback)
+			return m_overlapFilterCallback->needBroadphaseCollision(proxy0,proxy1);
+
+		bool collides = (proxy0->m_collisionFilterGroup & proxy1->m_collisionFilterMask) != 0;
+		collides = collides && (proxy1->m_collisionFilterGroup & proxy0->m_collisionFilterMask);
+
+		return collides;
+	}
+
+	virtual btBroadphasePair*	addOverlappingPair(btBroadphaseProxy* proxy0,btBroadphaseProxy* proxy1);
+
+	virtual void*	removeOverlappingPair(btBroadphaseProxy* proxy0,btBroadphaseProxy* proxy1,btDispatcher* dispatcher);
+
+	virtual void	removeOverlappingPairsContainingProxy(btBroadphaseProxy* proxy,btDispatcher* dispatcher);
+
+	virtual btBroadphasePair*	findPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1);
+
+	virtual	void	cleanOverlappingPair(btBroadphasePair& pair,btDispatcher* dispatcher);
+
+	virtual void	cleanProxyFromPairs(btBroadphaseProxy* proxy,btDispatcher* dispatcher);
+
+	virtual void	processAllOverlappingPairs(btOverlapCallback*,btDispatcher* dispatcher);
+
+	///sort the pair array, the collision algorithms of the pairs are kept
+	virtual void	sortOverlappingPairs(btDispatcher* dispatcher);
+
+	virtual btBroadphasePair*	getOverlappingPairArrayPtr()
+	{
+		return &m_overlappingPairArray[0];
+	}
+
+	virtual const btBroadphasePair*	getOverlappingPairArrayPtr() const
+	{
+		return &m_overlappingPairArray[0];
+	}
+
+	virtual btBroadphasePairArray&	getOverlappingPairArray()
+	{
+		return m_overlappingPairArray;
+	}
+
+	const btBroadphasePairArray&	getOverlappingPairArray() const
+	{
+		return m_overlappingPairArray;
+	}
+
+	virtual int	getNumOverlappingPairs() const
+	{
+		return m_overlappingPairArray.size();
+	}
+
+	btOverlapFilterCallback* getOverlapFilterCallback()
+	{
+		return m_overlapFilterCallback;
+	}
+
+	virtual void setOverlapFilterCallback(btOverlapFilterCallback* callback)
+	{
+		m_overlapFilterCallback = callback;
+	}
+
+	virtual bool	hasDeferredRemoval()
+	{
+		return false;
+	}
+
+	virtual	void	setInternalGhostPairCallback(btOverlappingPairCallback* ghostPairCallback)
+	{
+		m_ghostPairCallback = ghostPairCallback;
+	}
+
+	virtual bool	supportsConcurrentInsert() const
+	{
+		return true;
+	}
+
+	///reserve the pair array and the hash table for maxNewPairs more pairs, and switch to concurrent insertion
+	virtual void	beginConcurrentInsert(int maxNewPairs);
+
+	///same as addOverlappingPair, but can be called from several threads at once between beginConcurrentInsert and endConcurrentInsert.
+	///The overlap filter callback must be thread safe. The internal ghost pair callback is only called by endConcurrentInsert.
+	virtual btBroadphasePair*	addOverlappingPairConcurrent(btBroadphaseProxy* proxy0,btBroadphaseProxy* proxy1);
+
+	///the new pairs are sorted, so the pair array doesn't depend on the order in which the threads added them.
+	///The pointers returned by addOverlappingPairConcurrent are not valid after this call.
+	virtual void	endConcurrentInsert();
+
+	int		getNumBuckets() const
+	{
+		return m_numBuckets;
+	}
+};
+
+#endif //BT_OPEN_ADDRESSING_PAIR_CACHE_H
@@ -20,6 +20,7 @@ subject to the following restrictions:
 #include "btDispatcher.h"
 #include "btCollisionAlgorithm.h"
 #include "LinearMath/btAabbUtil2.h"
+#include "LinearMath/btThreads.h"
 
 #include <stdio.h>
 
@@ -135,7 +136,8 @@ void	btHashedOverlappingPairCache::removeOverlappingPairsContainingProxy(btBroad
 
 btBroadphasePair* btHashedOverlappingPairCache::findPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1)
 {
-	gFindPairs++;
+	//findPair doesn't modify the cache, so it can be called from parallel callbacks (for example the CCD sweeps of btDiscreteDynamicsWorld)
+	btAtomicFetchAdd(&gFindPairs,1);
 	if(proxy0->m_uniqueId>proxy1->m_uniqueId) 
 		btSwap(proxy0,proxy1);
 	int proxyId1 = proxy0->getUid();
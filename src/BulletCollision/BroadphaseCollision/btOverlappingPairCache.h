@@ -86,6 +86,30 @@ public:
 
 	virtual void	sortOverlappingPairs(btDispatcher* dispatcher) = 0;
 
+	///returns true when the pair cache supports addOverlappingPairConcurrent, see btOpenAddressingPairCache
+	virtual bool	supportsConcurrentInsert() const
+	{
+		return false;
+	}
+
+	///beginConcurrentInsert prepares room for at most maxNewPairs calls to addOverlappingPairConcurrent.
+	///Between beginConcurrentInsert and endConcurrentInsert, addOverlappingPairConcurrent is the only method that can be called, from any number of threads.
+	virtual void	beginConcurrentInsert(int maxNewPairs)
+	{
+		(void)maxNewPairs;
+	}
+
+	virtual btBroadphasePair*	addOverlappingPairConcurrent(btBroadphaseProxy* proxy0,btBroadphaseProxy* proxy1)
+	{
+		(void)proxy0;
+		(void)proxy1;
+		btAssert(0);
+		return 0;
+	}
+
+	virtual void	endConcurrentInsert()
+	{
+	}
 
 };
 
@@ -18,15 +18,26 @@ subject to the following restrictions:
 #include "LinearMath/btAabbUtil2.h"
 #include "LinearMath/btIDebugDraw.h"
 #include "LinearMath/btSerializer.h"
+#include "LinearMath/btThreads.h"
 
 #define RAYAABB2
 
+///number of bins per axis of the binned SAH build
+#define BT_BVH_SAH_BINS 16
+///deeper nodes of the SAH build use the mean split, which keeps the tree balanced
+#define BT_BVH_SAH_MAX_DEPTH 64
+///the SAH build splits the top of the tree level by level until it has this many subtrees, which are then built in parallel
+#define BT_BVH_SAH_TASK_COUNT 64
+///smaller ranges are built by a single thread
+#define BT_BVH_SAH_MIN_TASK_LEAVES 1024
+
 btQuantizedBvh::btQuantizedBvh() : 
 					m_bulletVersion(BT_BULLET_VERSION),
 					m_useQuantization(false), 
 					//m_traversalMode(TRAVERSAL_STACKLESS_CACHE_FRIENDLY)
 					m_traversalMode(TRAVERSAL_STACKLESS)
 					//m_traversalMode(TRAVERSAL_RECURSIVE)
+					,m_buildMode(BUILD_MEAN_SPLIT)
 					,m_subtreeHeaderCount(0) //PCK: add this line
 {
 	m_bvhAabbMin.setValue(-SIMD_INFINITY,-SIMD_INFINITY,-SIMD_INFINITY);
@@ -52,9 +63,7 @@ void btQuantizedBvh::buildInternal()
 
 	}
 
-	m_curNodeIndex = 0;
-
-	buildTree(0,numLeafNodes);
+	buildTreeFromLeafNodes(numLeafNodes);
 
 	///if the entire tree is small then subtree size, we need to create a header info for the tree
 	if(m_useQuantization && !m_SubtreeHeaders.size())
@@ -309,6 +318,341 @@ int	btQuantizedBvh::calcSplittingAxis(int startIndex,int endIndex)
 }
 
 
+void	btQuantizedBvh::buildTreeFromLeafNodes(int numLeafNodes)
+{
+	m_curNodeIndex = 0;
+	if (m_buildMode == BUILD_BINNED_SAH && numLeafNodes > 0)
+	{
+		buildTreeSah(numLeafNodes);
+	} else
+	{
+		buildTree(0,numLeafNodes);
+	}
+}
+
+struct	btBvhSahBin
+{
+	btVector3	m_aabbMin;
+	btVector3	m_aabbMax;
+	int			m_count;
+
+	void	clear()
+	{
+		m_aabbMin.setValue(btScalar(BT_LARGE_FLOAT),btScalar(BT_LARGE_FLOAT),btScalar(BT_LARGE_FLOAT));
+		m_aabbMax.setValue(btScalar(-BT_LARGE_FLOAT),btScalar(-BT_LARGE_FLOAT),btScalar(-BT_LARGE_FLOAT));
+		m_count = 0;
+	}
+	void	merge(const btBvhSahBin& other)
+	{
+		m_aabbMin.setMin(other.m_aabbMin);
+		m_aabbMax.setMax(other.m_aabbMax);
+		m_count += other.m_count;
+	}
+	btScalar	halfArea() const
+	{
+		if (!m_count)
+			return btScalar(0.);
+		btVector3 d = m_aabbMax-m_aabbMin;
+		return d.getX()*d.getY()+d.getY()*d.getZ()+d.getZ()*d.getX();
+	}
+};
+
+SIMD_FORCE_INLINE int	btSahBinIndex(btScalar center, btScalar centerMin, btScalar binScale)
+{
+	int bin = int((center-centerMin)*binScale);
+	return btMax(0,btMin(bin,BT_BVH_SAH_BINS-1));
+}
+
+int	btQuantizedBvh::buildSahNode(int startIndex,int endIndex,int nodeIndex,int depth,btVector3* centers)
+{
+	int i,b;
+	int numIndices = endIndex-startIndex;
+	btAssert(numIndices>1);
+
+	btVector3 centerMin(btScalar(BT_LARGE_FLOAT),btScalar(BT_LARGE_FLOAT),btScalar(BT_LARGE_FLOAT));
+	btVector3 centerMax(btScalar(-BT_LARGE_FLOAT),btScalar(-BT_LARGE_FLOAT),btScalar(-BT_LARGE_FLOAT));
+	for (i=startIndex;i<endIndex;i++)
+	{
+		centerMin.setMin(centers[i]);
+		centerMax.setMax(centers[i]);
+	}
+	btVector3 centerExtent = centerMax-centerMin;
+
+	//bin the leaf nodes by center along the axis with the largest center extent only, binning all 3 axes finds slightly
+	//better splits but makes the build slower than the mean split. All leaf nodes end up in the bins, so they also give the node AABB.
+	int bestAxis = centerExtent.maxAxis();
+	bool useSah = depth < BT_BVH_SAH_MAX_DEPTH && numIndices > 2 && centerExtent[bestAxis] > SIMD_EPSILON;
+	btScalar binScale = useSah ? btScalar(BT_BVH_SAH_BINS)/centerExtent[bestAxis] : btScalar(0.);
+	btBvhSahBin bins[BT_BVH_SAH_BINS];
+	for (b=0;b<BT_BVH_SAH_BINS;b++)
+	{
+		bins[b].clear();
+	}
+	for (i=startIndex;i<endIndex;i++)
+	{
+		btBvhSahBin& bin = bins[btSahBinIndex(centers[i][bestAxis],centerMin[bestAxis],binScale)];
+		bin.m_aabbMin.setMin(getAabbMin(i));
+		bin.m_aabbMax.setMax(getAabbMax(i));
+		bin.m_count++;
+	}
+
+	btBvhSahBin node;
+	node.clear();
+	for (b=0;b<BT_BVH_SAH_BINS;b++)
+	{
+		node.merge(bins[b]);
+	}
+	setInternalNodeAabbMin(nodeIndex,node.m_aabbMin);
+	setInternalNodeAabbMax(nodeIndex,node.m_aabbMax);
+	//a subtree of n leaf nodes has 2n-1 nodes
+	setInternalNodeEscapeIndex(nodeIndex,2*numIndices-1);
+
+	if (numIndices==2)
+		return startIndex+1;
+
+	//the cost of a split after bin b is area(left)*count(left)+area(right)*count(right)
+	int bestBin = -1;
+	if (useSah)
+	{
+		btScalar bestCost = SIMD_INFINITY;
+		btScalar rightCost[BT_BVH_SAH_BINS];
+		btBvhSahBin right;
+		right.clear();
+		for (b=BT_BVH_SAH_BINS-1;b>0;b--)
+		{
+			right.merge(bins[b]);
+			rightCost[b] = right.halfArea()*btScalar(right.m_count);
+		}
+		btBvhSahBin left;
+		left.clear();
+		for (b=0;b<BT_BVH_SAH_BINS-1;b++)
+		{
+			left.merge(bins[b]);
+			if (!left.m_count || left.m_count==numIndices)
+				continue;
+			btScalar cost = left.halfArea()*btScalar(left.m_count)+rightCost[b+1];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestBin = b;
+			}
+		}
+	}
+
+	int splitIndex = startIndex;
+	if (bestBin>=0)
+	{
+		for (i=startIndex;i<endIndex;i++)
+		{
+			if (btSahBinIndex(centers[i][bestAxis],centerMin[bestAxis],binScale) <= bestBin)
+			{
+				swapLeafNodes(i,splitIndex);
+				btSwap(centers[i],centers[splitIndex]);
+				splitIndex++;
+			}
+		}
+	} else
+	{
+		//all centers in one bin, or a very deep node: split at the mean along the largest extent, like sortAndCalcSplittingIndex
+		int splitAxis = bestAxis;
+		btScalar splitValue = btScalar(0.);
+		for (i=startIndex;i<endIndex;i++)
+		{
+			splitValue += centers[i][splitAxis];
+		}
+		splitValue /= btScalar(numIndices);
+		for (i=startIndex;i<endIndex;i++)
+		{
+			if (centers[i][splitAxis] > splitValue)
+			{
+				swapLeafNodes(i,splitIndex);
+				btSwap(centers[i],centers[splitIndex]);
+				splitIndex++;
+			}
+		}
+		int rangeBalancedIndices = numIndices/3;
+		if ((splitIndex<=(startIndex+rangeBalancedIndices)) || (splitIndex >=(endIndex-1-rangeBalancedIndices)))
+		{
+			splitIndex = startIndex+(numIndices>>1);
+		}
+	}
+	btAssert(splitIndex>startIndex && splitIndex<endIndex);
+	return splitIndex;
+}
+
+struct	btQuantizedBvh::btBvhBuildTask
+{
+	int	m_startIndex;
+	int	m_endIndex;
+	int	m_nodeIndex;
+	int	m_depth;
+};
+
+int	btQuantizedBvh::splitSahTask(const btBvhBuildTask& task, btBvhBuildTask* childTasks, btVector3* centers)
+{
+	if (task.m_endIndex-task.m_startIndex==1)
+	{
+		assignInternalNodeFromLeafNode(task.m_nodeIndex,task.m_startIndex);
+		return 0;
+	}
+	int splitIndex = buildSahNode(task.m_startIndex,task.m_endIndex,task.m_nodeIndex,task.m_depth,centers);
+
+	childTasks[0].m_startIndex = task.m_startIndex;
+	childTasks[0].m_endIndex = splitIndex;
+	childTasks[0].m_nodeIndex = task.m_nodeIndex+1;
+	childTasks[0].m_depth = task.m_depth+1;
+
+	childTasks[1].m_startIndex = splitIndex;
+	childTasks[1].m_endIndex = task.m_endIndex;
+	childTasks[1].m_nodeIndex = task.m_nodeIndex+2*(splitIndex-task.m_startIndex);
+	childTasks[1].m_depth = task.m_depth+1;
+	return 2;
+}
+
+void	btQuantizedBvh::buildSubtreeSah(const btBvhBuildTask& task, btVector3* centers)
+{
+	btBvhBuildTask childTasks[2];
+	if (splitSahTask(task,childTasks,centers))
+	{
+		buildSubtreeSah(childTasks[0],centers);
+		buildSubtreeSah(childTasks[1],centers);
+	}
+}
+
+struct	btBvhSahSplitLoop : public btIParallelForBody
+{
+	btQuantizedBvh*	m_bvh;
+	const btQuantizedBvh::btBvhBuildTask*	m_tasks;
+	btQuantizedBvh::btBvhBuildTask*	m_childTasks;
+	int*	m_numChildTasks;
+	btVector3*	m_centers;
+
+	void	forLoop(int iBegin, int iEnd) const
+	{
+		for (int i=iBegin;i<iEnd;i++)
+		{
+			m_numChildTasks[i] = m_bvh->splitSahTask(m_tasks[i],&m_childTasks[i*2],m_centers);
+		}
+	}
+};
+
+struct	btBvhSahSubtreeLoop : public btIParallelForBody
+{
+	btQuantizedBvh*	m_bvh;
+	const btQuantizedBvh::btBvhBuildTask*	m_tasks;
+	btVector3*	m_centers;
+
+	void	forLoop(int iBegin, int iEnd) const
+	{
+		for (int i=iBegin;i<iEnd;i++)
+		{
+			m_bvh->buildSubtreeSah(m_tasks[i],m_centers);
+		}
+	}
+};
+
+void	btQuantizedBvh::buildTreeSah(int numLeafNodes)
+{
+	btAlignedObjectArray<btBvhBuildTask>	tasks;
+	btAlignedObjectArray<btBvhBuildTask>	childTasks;
+	btAlignedObjectArray<btBvhBuildTask>	subtreeTasks;
+	btAlignedObjectArray<int>	numChildTasks;
+
+	//the centers of the leaf nodes, they are sorted along with the leaf nodes
+	btAlignedObjectArray<btVector3>	centers;
+	centers.resize(numLeafNodes);
+	for (int i=0;i<numLeafNodes;i++)
+	{
+		centers[i] = btScalar(0.5)*(getAabbMax(i)+getAabbMin(i));
+	}
+
+	btBvhBuildTask root;
+	root.m_startIndex = 0;
+	root.m_endIndex = numLeafNodes;
+	root.m_nodeIndex = 0;
+	root.m_depth = 0;
+	tasks.push_back(root);
+
+	//split the top of the tree level by level, each level in parallel
+	while (tasks.size() && tasks.size()+subtreeTasks.size() < BT_BVH_SAH_TASK_COUNT)
+	{
+		int i,j;
+		int numSplitTasks = 0;
+		for (i=0;i<tasks.size();i++)
+		{
+			if (tasks[i].m_endIndex-tasks[i].m_startIndex < BT_BVH_SAH_MIN_TASK_LEAVES)
+			{
+				subtreeTasks.push_back(tasks[i]);
+			} else
+			{
+				tasks[numSplitTasks++] = tasks[i];
+			}
+		}
+		tasks.resize(numSplitTasks);
+		if (!numSplitTasks)
+			break;
+
+		childTasks.resize(numSplitTasks*2);
+		numChildTasks.resize(numSplitTasks);
+		btBvhSahSplitLoop splitLoop;
+		splitLoop.m_bvh = this;
+		splitLoop.m_tasks = &tasks[0];
+		splitLoop.m_childTasks = &childTasks[0];
+		splitLoop.m_numChildTasks = &numChildTasks[0];
+		splitLoop.m_centers = &centers[0];
+		btParallelFor(0,numSplitTasks,1,splitLoop);
+
+		tasks.resize(0);
+		for (i=0;i<numSplitTasks;i++)
+		{
+			for (j=0;j<numChildTasks[i];j++)
+			{
+				tasks.push_back(childTasks[i*2+j]);
+			}
+		}
+	}
+	for (int i=0;i<tasks.size();i++)
+	{
+		subtreeTasks.push_back(tasks[i]);
+	}
+
+	if (subtreeTasks.size())
+	{
+		btBvhSahSubtreeLoop subtreeLoop;
+		subtreeLoop.m_bvh = this;
+		subtreeLoop.m_tasks = &subtreeTasks[0];
+		subtreeLoop.m_centers = &centers[0];
+		btParallelFor(0,subtreeTasks.size(),1,subtreeLoop);
+	}
+
+	m_curNodeIndex = 2*numLeafNodes-1;
+
+	if (m_useQuantization)
+	{
+		buildSubtreeHeaders(0);
+	}
+}
+
+void	btQuantizedBvh::buildSubtreeHeaders(int nodeIndex)
+{
+	const btQuantizedBvhNode& node = m_quantizedContiguousNodes[nodeIndex];
+	if (node.isLeafNode())
+		return;
+	//only nodes larger than a subtree add headers for their children
+	int escapeIndex = node.getEscapeIndex();
+	if (escapeIndex * static_cast<int>(sizeof(btQuantizedBvhNode)) <= MAX_SUBTREE_SIZE_IN_BYTES)
+		return;
+
+	int leftChildNodexIndex = nodeIndex+1;
+	const btQuantizedBvhNode& leftChildNode = m_quantizedContiguousNodes[leftChildNodexIndex];
+	int rightChildNodexIndex = leftChildNodexIndex + (leftChildNode.isLeafNode() ? 1 : leftChildNode.getEscapeIndex());
+
+	buildSubtreeHeaders(leftChildNodexIndex);
+	buildSubtreeHeaders(rightChildNodexIndex);
+	updateSubtreeHeaders(leftChildNodexIndex,rightChildNodexIndex);
+}
+
+
 
 void	btQuantizedBvh::reportAabbOverlappingNodex(btNodeOverlapCallback* nodeCallback,const btVector3& aabbMin,const btVector3& aabbMax) const
 {
@@ -787,6 +1131,59 @@ void	btQuantizedBvh::reportBoxCastOverlappingNodex(btNodeOverlapCallback* nodeCa
 }
 
 
+void	btQuantizedBvh::reportRayPacketOverlappingNodex(btRayPacketNodeOverlapCallback* nodeCallback, btRayPacket& packet) const
+{
+	//stackless walk, like walkStacklessQuantizedTreeAgainstRay and walkStacklessTreeAgainstRay
+	int curIndex = 0;
+	while (curIndex < m_curNodeIndex)
+	{
+		btVector3 aabbMin,aabbMax;
+		bool isLeafNode;
+		int escapeIndex;
+		int partId = 0, triangleIndex = 0;
+		if (m_useQuantization)
+		{
+			const btQuantizedBvhNode& node = m_quantizedContiguousNodes[curIndex];
+			aabbMin = unQuantize(node.m_quantizedAabbMin);
+			aabbMax = unQuantize(node.m_quantizedAabbMax);
+			isLeafNode = node.isLeafNode();
+			if (isLeafNode)
+			{
+				partId = node.getPartId();
+				triangleIndex = node.getTriangleIndex();
+				escapeIndex = 1;
+			} else
+			{
+				escapeIndex = node.getEscapeIndex();
+			}
+		} else
+		{
+			const btOptimizedBvhNode& node = m_contiguousNodes[curIndex];
+			aabbMin = node.m_aabbMinOrg;
+			aabbMax = node.m_aabbMaxOrg;
+			isLeafNode = (node.m_escapeIndex == -1);
+			partId = node.m_subPart;
+			triangleIndex = node.m_triangleIndex;
+			escapeIndex = node.m_escapeIndex;
+		}
+
+		unsigned int rayMask = btRayPacketAabb(packet,aabbMin,aabbMax);
+		if (isLeafNode && rayMask)
+		{
+			nodeCallback->processNode(partId,triangleIndex,rayMask);
+		}
+
+		if (rayMask || isLeafNode)
+		{
+			curIndex++;
+		} else
+		{
+			curIndex += escapeIndex;
+		}
+	}
+}
+
+
 void	btQuantizedBvh::swapLeafNodes(int i,int splitIndex)
 {
 	if (m_useQuantization)
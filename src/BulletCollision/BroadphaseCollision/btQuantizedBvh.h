@@ -17,6 +17,7 @@ subject to the following restrictions:
 #define BT_QUANTIZED_BVH_H
 
 class btSerializer;
+struct btRayPacket;
 
 //#define DEBUG_CHECK_DEQUANTIZATION 1
 #ifdef DEBUG_CHECK_DEQUANTIZATION
@@ -157,6 +158,16 @@ public:
 	virtual void processNode(int subPart, int triangleIndex) = 0;
 };
 
+///btRayPacketNodeOverlapCallback receives the leaf nodes hit by the rays of a btRayPacket, see btQuantizedBvh::reportRayPacketOverlappingNodex
+class btRayPacketNodeOverlapCallback
+{
+public:
+	virtual ~btRayPacketNodeOverlapCallback() {};
+
+	///rayMask has a bit set for each ray of the packet that hits the node AABB
+	virtual void processNode(int subPart, int triangleIndex, unsigned int rayMask) = 0;
+};
+
 #include "LinearMath/btAlignedAllocator.h"
 #include "LinearMath/btAlignedObjectArray.h"
 
@@ -181,6 +192,15 @@ public:
 		TRAVERSAL_RECURSIVE
 	};
 
+	enum btBuildMode
+	{
+		///split at the mean of the centers along the axis with the largest variance
+		BUILD_MEAN_SPLIT = 0,
+		///split using the surface area heuristic evaluated on BT_BVH_SAH_BINS bins along the axis with the largest extent of the centers,
+		///the subtrees are built in parallel using btParallelFor. It builds faster than the mean split, also on a single thread.
+		BUILD_BINNED_SAH
+	};
+
 protected:
 
 
@@ -202,6 +222,7 @@ protected:
 	QuantizedNodeArray	m_quantizedContiguousNodes;
 	
 	btTraversalMode	m_traversalMode;
+	btBuildMode		m_buildMode;
 	BvhSubtreeInfoArray		m_SubtreeHeaders;
 
 	//This is only used for serialization so we don't have to add serialization directly to btAlignedObjectArray
@@ -308,6 +329,30 @@ protected:
 	int	calcSplittingAxis(int startIndex,int endIndex);
 
 	int	sortAndCalcSplittingIndex(int startIndex,int endIndex,int splitAxis);
+
+	///build the tree from the leaf nodes using m_buildMode, the contiguous node array must be resized to 2*numLeafNodes
+	void	buildTreeFromLeafNodes(int numLeafNodes);
+
+	///binned SAH build, the subtree of numLeafNodes leaf nodes uses exactly 2*numLeafNodes-1 contiguous nodes, so the subtrees can be written in parallel
+	void	buildTreeSah(int numLeafNodes);
+
+	///write the internal node and sort the leaf nodes of the range for the SAH build, returns the split index
+	int		buildSahNode(int startIndex,int endIndex,int nodeIndex,int depth,btVector3* centers);
+
+	///add the subtree headers in the same order as buildTree does
+	void	buildSubtreeHeaders(int nodeIndex);
+
+	///a range of leaf nodes and the index of its subtree root, used by the parallel loops of the SAH build (see btQuantizedBvh.cpp)
+	struct	btBvhBuildTask;
+	friend struct btBvhSahSplitLoop;
+	friend struct btBvhSahSubtreeLoop;
+
+	///write the node of the task, returns the number of child tasks (0 for a leaf, 2 otherwise).
+	///centers are the centers of the leaf nodes, they are sorted along with the leaf nodes
+	int		splitSahTask(const btBvhBuildTask& task, btBvhBuildTask* childTasks, btVector3* centers);
+
+	///build the whole subtree of the task
+	void	buildSubtreeSah(const btBvhBuildTask& task, btVector3* centers);
 	
 	void	walkStacklessTree(btNodeOverlapCallback* nodeCallback,const btVector3& aabbMin,const btVector3& aabbMax) const;
 
@@ -348,6 +393,8 @@ public:
 	void	reportAabbOverlappingNodex(btNodeOverlapCallback* nodeCallback,const btVector3& aabbMin,const btVector3& aabbMax) const;
 	void	reportRayOverlappingNodex (btNodeOverlapCallback* nodeCallback, const btVector3& raySource, const btVector3& rayTarget) const;
 	void	reportBoxCastOverlappingNodex(btNodeOverlapCallback* nodeCallback, const btVector3& raySource, const btVector3& rayTarget, const btVector3& aabbMin,const btVector3& aabbMax) const;
+	///walks the tree once for all rays of the packet, the callback can lower packet.m_lambdaMax to prune the rest of the walk
+	void	reportRayPacketOverlappingNodex(btRayPacketNodeOverlapCallback* nodeCallback, btRayPacket& packet) const;
 
 		SIMD_FORCE_INLINE void quantize(unsigned short* out, const btVector3& point,int isMax) const
 	{
@@ -446,6 +493,16 @@ public:
 		m_traversalMode = traversalMode;
 	}
 
+	///setBuildMode chooses the splitting strategy of the next build, both modes produce the same node and subtree layout
+	void	setBuildMode(btBuildMode buildMode)
+	{
+		m_buildMode = buildMode;
+	}
+	btBuildMode	getBuildMode() const
+	{
+		return m_buildMode;
+	}
+
 
 	SIMD_FORCE_INLINE QuantizedNodeArray&	getQuantizedNodeArray()
 	{	
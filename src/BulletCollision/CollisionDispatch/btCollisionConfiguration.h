@@ -19,6 +19,7 @@ subject to the following restrictions:
 struct btCollisionAlgorithmCreateFunc;
 
 class btStackAlloc;
+class btThreadStackAlloc;
 class btPoolAllocator;
 
 ///btCollisionConfiguration allows to configure Bullet collision detection
@@ -40,6 +41,12 @@ public:
 
 	virtual btStackAlloc*	getStackAllocator() = 0;
 
+	///the stack allocators of the threads of the task scheduler, 0 if the collision world and solver only use getStackAllocator
+	virtual btThreadStackAlloc*	getThreadStackAllocator()
+	{
+		return 0;
+	}
+
 	virtual btCollisionAlgorithmCreateFunc* getCollisionAlgorithmCreateFunc(int proxyType0,int proxyType1) =0;
 
 };
@@ -26,6 +26,7 @@ subject to the following restrictions:
 #include "LinearMath/btPoolAllocator.h"
 #include "BulletCollision/CollisionDispatch/btCollisionConfiguration.h"
 #include "BulletCollision/CollisionDispatch/btCollisionObjectWrapper.h"
+#include "BulletCollision/NarrowPhaseCollision/btManifoldReduction.h"
 
 int gNumManifold = 0;
 
@@ -36,7 +37,8 @@ int gNumManifold = 0;
 
 btCollisionDispatcher::btCollisionDispatcher (btCollisionConfiguration* collisionConfiguration): 
 m_dispatcherFlags(btCollisionDispatcher::CD_USE_RELATIVE_CONTACT_BREAKING_THRESHOLD),
-	m_collisionConfiguration(collisionConfiguration)
+	m_collisionConfiguration(collisionConfiguration),
+	m_manifoldReduction(0)
 {
 	int i;
 
@@ -121,6 +123,8 @@ void btCollisionDispatcher::releaseManifold(btPersistentManifold* manifold)
 	gNumManifold--;
 
 	//printf("releaseManifold: gNumManifold %d\n",gNumManifold);
+	if (m_manifoldReduction)
+		m_manifoldReduction->removeManifold(manifold);
 	clearManifold(manifold);
 
 	int findIndex = manifold->m_index1a;
@@ -61,6 +61,8 @@ protected:
 
 	btCollisionConfiguration*	m_collisionConfiguration;
 
+	btManifoldReduction*	m_manifoldReduction;
+
 
 public:
 
@@ -165,6 +167,11 @@ public:
 		return m_persistentManifoldPoolAllocator;
 	}
 
+	virtual void	setManifoldReduction(btManifoldReduction* manifoldReduction)
+	{
+		m_manifoldReduction = manifoldReduction;
+	}
+
 };
 
 #endif //BT_COLLISION__DISPATCHER_H
@@ -0,0 +1,346 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "btCollisionDispatcherMt.h"
+
+#include "BulletCollision/BroadphaseCollision/btCollisionAlgorithm.h"
+#include "BulletCollision/BroadphaseCollision/btOverlappingPairCache.h"
+#include "BulletCollision/CollisionShapes/btCollisionShape.h"
+#include "BulletCollision/CollisionDispatch/btCollisionObject.h"
+#include "BulletCollision/CollisionDispatch/btCollisionConfiguration.h"
+#include "BulletCollision/NarrowPhaseCollision/btManifoldReduction.h"
+#include "LinearMath/btPoolAllocator.h"
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btQuickprof.h"
+
+extern int gNumManifold;
+
+
+///sorts the manifolds created during a dispatch on pair index, then on creation order within the pair
+class btNewManifoldSortPredicate
+{
+public:
+	bool operator() ( const btCollisionDispatcherMt::btNewManifold& lhs, const btCollisionDispatcherMt::btNewManifold& rhs ) const
+	{
+		if (lhs.m_pairIndex != rhs.m_pairIndex)
+			return lhs.m_pairIndex < rhs.m_pairIndex;
+		return lhs.m_sequence < rhs.m_sequence;
+	}
+};
+
+///sorts the manifolds released during a dispatch on their index in the manifold array
+class btReleasedManifoldSortPredicate
+{
+public:
+	bool operator() ( const btPersistentManifold* lhs, const btPersistentManifold* rhs ) const
+	{
+		return lhs->m_index1a < rhs->m_index1a;
+	}
+};
+
+
+btCollisionDispatcherMt::btCollisionDispatcherMt(btCollisionConfiguration* collisionConfiguration, int grainSize)
+:btCollisionDispatcher(collisionConfiguration),
+m_batchUpdating(false),
+m_grainSize(grainSize)
+{
+	initThreadLocalData(1);
+}
+
+btCollisionDispatcherMt::~btCollisionDispatcherMt()
+{
+	for (int i=0;i<m_threadLocalData.size();i++)
+	{
+		btThreadLocalDispatchData* data = m_threadLocalData[i];
+		if (data->m_ownsPools)
+		{
+			data->m_collisionAlgorithmPool->~btPoolAllocator();
+			btAlignedFree(data->m_collisionAlgorithmPool);
+			data->m_persistentManifoldPool->~btPoolAllocator();
+			btAlignedFree(data->m_persistentManifoldPool);
+		}
+		data->~btThreadLocalDispatchData();
+		btAlignedFree(data);
+	}
+}
+
+void btCollisionDispatcherMt::initThreadLocalData(int numThreads)
+{
+	//thread 0 uses the pools of the collision configuration, the other threads get pools of the same size
+	while (m_threadLocalData.size() < numThreads)
+	{
+		void* mem = btAlignedAlloc(sizeof(btThreadLocalDispatchData),16);
+		btThreadLocalDispatchData* data = new (mem) btThreadLocalDispatchData();
+		if (m_threadLocalData.size()==0)
+		{
+			data->m_collisionAlgorithmPool = m_collisionAlgorithmPoolAllocator;
+			data->m_persistentManifoldPool = m_persistentManifoldPoolAllocator;
+			data->m_ownsPools = false;
+		} else
+		{
+			void* algorithmMem = btAlignedAlloc(sizeof(btPoolAllocator),16);
+			data->m_collisionAlgorithmPool = new (algorithmMem) btPoolAllocator(m_collisionAlgorithmPoolAllocator->getElementSize(),m_collisionAlgorithmPoolAllocator->getMaxCount());
+			void* manifoldMem = btAlignedAlloc(sizeof(btPoolAllocator),16);
+			data->m_persistentManifoldPool = new (manifoldMem) btPoolAllocator(m_persistentManifoldPoolAllocator->getElementSize(),m_persistentManifoldPoolAllocator->getMaxCount());
+			data->m_ownsPools = true;
+		}
+		data->m_currentPairIndex = 0;
+		data->m_manifoldSequence = 0;
+		m_threadLocalData.push_back(data);
+	}
+}
+
+btCollisionDispatcherMt::btThreadLocalDispatchData* btCollisionDispatcherMt::getThreadLocalData()
+{
+	unsigned int threadIndex = btGetCurrentThreadIndex();
+	btAssert(int(threadIndex) < m_threadLocalData.size());
+	return m_threadLocalData[int(threadIndex) < m_threadLocalData.size() ? threadIndex : 0];
+}
+
+
+btPersistentManifold*	btCollisionDispatcherMt::getNewManifold(const btCollisionObject* body0,const btCollisionObject* body1)
+{
+	if (!m_batchUpdating)
+	{
+		return btCollisionDispatcher::getNewManifold(body0,body1);
+	}
+
+#if BT_THREADSAFE
+	btAtomicFetchAdd(&gNumManifold,1);
+#else
+	gNumManifold++;
+#endif
+
+	//optional relative contact breaking threshold, turned on by default (use setDispatcherFlags to switch off feature for improved performance)
+	btScalar contactBreakingThreshold =  (m_dispatcherFlags & btCollisionDispatcher::CD_USE_RELATIVE_CONTACT_BREAKING_THRESHOLD) ?
+		btMin(body0->getCollisionShape()->getContactBreakingThreshold(gContactBreakingThreshold) , body1->getCollisionShape()->getContactBreakingThreshold(gContactBreakingThreshold))
+		: gContactBreakingThreshold ;
+
+	btScalar contactProcessingThreshold = btMin(body0->getContactProcessingThreshold(),body1->getContactProcessingThreshold());
+
+	btThreadLocalDispatchData* data = getThreadLocalData();
+	void* mem = 0;
+	if (data->m_persistentManifoldPool->getFreeCount())
+	{
+		mem = data->m_persistentManifoldPool->allocate(sizeof(btPersistentManifold));
+	} else
+	{
+		//we got a pool memory overflow, by default we fallback to dynamically allocate memory. If we require a contiguous contact pool then assert.
+		if ((m_dispatcherFlags&CD_DISABLE_CONTACTPOOL_DYNAMIC_ALLOCATION)==0)
+		{
+			mem = btAlignedAlloc(sizeof(btPersistentManifold),16);
+		} else
+		{
+			btAssert(0);
+			//make sure to increase the m_defaultMaxPersistentManifoldPoolSize in the btDefaultCollisionConstructionInfo/btDefaultCollisionConfiguration
+			return 0;
+		}
+	}
+	btPersistentManifold* manifold = new(mem) btPersistentManifold (body0,body1,0,contactBreakingThreshold,contactProcessingThreshold);
+
+	//the manifold is added to m_manifoldsPtr after the dispatch, see mergeManifoldUpdates
+	manifold->m_index1a = -1;
+	btNewManifold newManifold;
+	newManifold.m_manifold = manifold;
+	newManifold.m_pairIndex = data->m_currentPairIndex;
+	newManifold.m_sequence = data->m_manifoldSequence++;
+	data->m_newManifolds.push_back(newManifold);
+
+	return manifold;
+}
+
+void btCollisionDispatcherMt::freeManifoldMemory(btPersistentManifold* manifold)
+{
+	manifold->~btPersistentManifold();
+	for (int i=0;i<m_threadLocalData.size();i++)
+	{
+		btPoolAllocator* pool = m_threadLocalData[i]->m_persistentManifoldPool;
+		if (pool->validPtr(manifold))
+		{
+			pool->freeMemory(manifold);
+			return;
+		}
+	}
+	btAlignedFree(manifold);
+}
+
+void btCollisionDispatcherMt::releaseManifold(btPersistentManifold* manifold)
+{
+	if (m_batchUpdating)
+	{
+		btThreadLocalDispatchData* data = getThreadLocalData();
+		if (manifold->m_index1a < 0)
+		{
+			//created during this dispatch, and by this thread, since a manifold is only used by one pair
+			for (int i=data->m_newManifolds.size()-1;i>=0;i--)
+			{
+				if (data->m_newManifolds[i].m_manifold == manifold)
+				{
+					data->m_newManifolds.swap(i,data->m_newManifolds.size()-1);
+					data->m_newManifolds.pop_back();
+					break;
+				}
+			}
+#if BT_THREADSAFE
+			btAtomicFetchAdd(&gNumManifold,-1);
+#else
+			gNumManifold--;
+#endif
+			clearManifold(manifold);
+			freeManifoldMemory(manifold);
+		} else
+		{
+			//removing it from m_manifoldsPtr would reorder the array, so defer it until the end of the dispatch
+			data->m_releasedManifolds.push_back(manifold);
+		}
+		return;
+	}
+
+	gNumManifold--;
+
+	if (m_manifoldReduction)
+		m_manifoldReduction->removeManifold(manifold);
+	clearManifold(manifold);
+
+	int findIndex = manifold->m_index1a;
+	btAssert(findIndex < m_manifoldsPtr.size());
+	m_manifoldsPtr.swap(findIndex,m_manifoldsPtr.size()-1);
+	m_manifoldsPtr[findIndex]->m_index1a = findIndex;
+	m_manifoldsPtr.pop_back();
+
+	freeManifoldMemory(manifold);
+}
+
+
+void* btCollisionDispatcherMt::allocateCollisionAlgorithm(int size)
+{
+	//other threads may free into this pool, but only this thread allocates from it, so the free count can only grow meanwhile
+	btPoolAllocator* pool = getThreadLocalData()->m_collisionAlgorithmPool;
+	if (pool->getFreeCount())
+	{
+		return pool->allocate(size);
+	}
+
+	//warn user for overflow?
+	return	btAlignedAlloc(static_cast<size_t>(size), 16);
+}
+
+void btCollisionDispatcherMt::freeCollisionAlgorithm(void* ptr)
+{
+	for (int i=0;i<m_threadLocalData.size();i++)
+	{
+		btPoolAllocator* pool = m_threadLocalData[i]->m_collisionAlgorithmPool;
+		if (pool->validPtr(ptr))
+		{
+			pool->freeMemory(ptr);
+			return;
+		}
+	}
+	btAlignedFree(ptr);
+}
+
+
+void btCollisionDispatcherMt::processPairs(btBroadphasePair* pairs, int iBegin, int iEnd, const btDispatcherInfo& dispatchInfo)
+{
+	btThreadLocalDispatchData* data = getThreadLocalData();
+	for (int i=iBegin;i<iEnd;i++)
+	{
+		data->m_currentPairIndex = i;
+		(*m_nearCallback)(pairs[i],*this,dispatchInfo);
+	}
+}
+
+void btCollisionDispatcherMt::mergeManifoldUpdates()
+{
+	int i,j;
+
+	//release the manifolds in order of their index, so the resulting array doesn't depend on which thread released what
+	m_sortedReleasedManifolds.resize(0);
+	for (i=0;i<m_threadLocalData.size();i++)
+	{
+		btThreadLocalDispatchData* data = m_threadLocalData[i];
+		for (j=0;j<data->m_releasedManifolds.size();j++)
+		{
+			m_sortedReleasedManifolds.push_back(data->m_releasedManifolds[j]);
+		}
+		data->m_releasedManifolds.resize(0);
+	}
+	m_sortedReleasedManifolds.quickSort(btReleasedManifoldSortPredicate());
+	for (i=0;i<m_sortedReleasedManifolds.size();i++)
+	{
+		releaseManifold(m_sortedReleasedManifolds[i]);
+	}
+
+	//append the new manifolds in pair order
+	m_sortedNewManifolds.resize(0);
+	for (i=0;i<m_threadLocalData.size();i++)
+	{
+		btThreadLocalDispatchData* data = m_threadLocalData[i];
+		for (j=0;j<data->m_newManifolds.size();j++)
+		{
+			m_sortedNewManifolds.push_back(data->m_newManifolds[j]);
+		}
+		data->m_newManifolds.resize(0);
+		data->m_manifoldSequence = 0;
+	}
+	m_sortedNewManifolds.quickSort(btNewManifoldSortPredicate());
+	for (i=0;i<m_sortedNewManifolds.size();i++)
+	{
+		btPersistentManifold* manifold = m_sortedNewManifolds[i].m_manifold;
+		manifold->m_index1a = m_manifoldsPtr.size();
+		m_manifoldsPtr.push_back(manifold);
+	}
+}
+
+
+struct btDispatchPairsLoop : public btIParallelForBody
+{
+	btCollisionDispatcherMt*	m_dispatcher;
+	btBroadphasePair*			m_pairs;
+	const btDispatcherInfo*		m_dispatchInfo;
+
+	void	forLoop(int iBegin, int iEnd) const
+	{
+		m_dispatcher->processPairs(m_pairs,iBegin,iEnd,*m_dispatchInfo);
+	}
+};
+
+void	btCollisionDispatcherMt::dispatchAllCollisionPairs(btOverlappingPairCache* pairCache,const btDispatcherInfo& dispatchInfo,btDispatcher* dispatcher)
+{
+	//the time of impact is a reduction over all pairs, keep that sequential
+	if (dispatchInfo.m_dispatchFunc != btDispatcherInfo::DISPATCH_DISCRETE)
+	{
+		btCollisionDispatcher::dispatchAllCollisionPairs(pairCache,dispatchInfo,dispatcher);
+		return;
+	}
+
+	int numPairs = pairCache->getNumOverlappingPairs();
+	if (!numPairs)
+		return;
+
+	initThreadLocalData(btGetNumThreadIndices());
+
+	btDispatchPairsLoop loop;
+	loop.m_dispatcher = this;
+	loop.m_pairs = pairCache->getOverlappingPairArrayPtr();
+	loop.m_dispatchInfo = &dispatchInfo;
+
+	m_batchUpdating = true;
+	btParallelFor(0,numPairs,m_grainSize,loop);
+	m_batchUpdating = false;
+
+	mergeManifoldUpdates();
+}
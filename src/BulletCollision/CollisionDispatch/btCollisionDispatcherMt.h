@@ -0,0 +1,91 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_COLLISION_DISPATCHER_MT_H
+#define BT_COLLISION_DISPATCHER_MT_H
+
+#include "btCollisionDispatcher.h"
+
+///btCollisionDispatcherMt processes the overlapping pairs in parallel, using btParallelFor.
+///Each thread allocates collision algorithms and manifolds from its own btPoolAllocator (thread 0 uses the pools of the collision configuration).
+///Manifolds that are created or released while the pairs are processed are added to/removed from the manifold array afterwards,
+///sorted on pair index, so the manifold array doesn't depend on the number of threads or on scheduling.
+///The near callback, and the collision algorithms it runs, are called concurrently for different pairs.
+///Continuous (time of impact) dispatch is processed sequentially.
+class btCollisionDispatcherMt : public btCollisionDispatcher
+{
+public:
+	struct	btNewManifold
+	{
+		btPersistentManifold*	m_manifold;
+		int						m_pairIndex;
+		int						m_sequence;		///< creation order within the thread
+	};
+
+	struct	btThreadLocalDispatchData
+	{
+		btPoolAllocator*	m_collisionAlgorithmPool;
+		btPoolAllocator*	m_persistentManifoldPool;
+		bool				m_ownsPools;
+		int					m_currentPairIndex;
+		int					m_manifoldSequence;
+		btAlignedObjectArray<btNewManifold>			m_newManifolds;
+		btAlignedObjectArray<btPersistentManifold*>	m_releasedManifolds;
+	};
+
+protected:
+
+	btAlignedObjectArray<btThreadLocalDispatchData*>	m_threadLocalData;
+	btAlignedObjectArray<btNewManifold>				m_sortedNewManifolds;
+	btAlignedObjectArray<btPersistentManifold*>		m_sortedReleasedManifolds;
+	bool	m_batchUpdating;
+	int		m_grainSize;
+
+	btThreadLocalDispatchData*	getThreadLocalData();
+	void	initThreadLocalData(int numThreads);
+	void	freeManifoldMemory(btPersistentManifold* manifold);
+	void	mergeManifoldUpdates();
+
+public:
+
+	///grainSize is the number of pairs processed by one task
+	btCollisionDispatcherMt(btCollisionConfiguration* collisionConfiguration, int grainSize = 40);
+
+	virtual ~btCollisionDispatcherMt();
+
+	virtual btPersistentManifold*	getNewManifold(const btCollisionObject* body0,const btCollisionObject* body1);
+
+	virtual void releaseManifold(btPersistentManifold* manifold);
+
+	virtual void	dispatchAllCollisionPairs(btOverlappingPairCache* pairCache,const btDispatcherInfo& dispatchInfo,btDispatcher* dispatcher);
+
+	virtual	void* allocateCollisionAlgorithm(int size);
+
+	virtual	void freeCollisionAlgorithm(void* ptr);
+
+	///process the pairs [iBegin,iEnd), called from the worker threads
+	void	processPairs(btBroadphasePair* pairs, int iBegin, int iEnd, const btDispatcherInfo& dispatchInfo);
+
+	int		getGrainSize() const
+	{
+		return m_grainSize;
+	}
+	void	setGrainSize(int grainSize)
+	{
+		m_grainSize = grainSize;
+	}
+};
+
+#endif //BT_COLLISION_DISPATCHER_MT_H
@@ -38,9 +38,11 @@ btCollisionObject::btCollisionObject()
 		m_hitFraction(btScalar(1.)),
 		m_ccdSweptSphereRadius(btScalar(0.)),
 		m_ccdMotionThreshold(btScalar(0.)),
-		m_checkCollideWith(false)
+		m_checkCollideWith(false),
+		m_aabbCollisionShape(0)
 {
 	m_worldTransform.setIdentity();
+	m_aabbWorldTransform.setIdentity();
 }
 
 btCollisionObject::~btCollisionObject()
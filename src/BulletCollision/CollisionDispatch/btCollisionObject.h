@@ -106,6 +106,10 @@ protected:
 	/// If some object should have elaborate collision filtering by sub-classes
 	int			m_checkCollideWith;
 
+	///transform and collision shape used by the last AABB update of btCollisionWorld, see btCollisionWorld::setSkipUnchangedAabbs
+	btTransform				m_aabbWorldTransform;
+	const btCollisionShape*	m_aabbCollisionShape;
+
 	virtual bool	checkCollideWithOverride(const btCollisionObject* /* co */) const
 	{
 		return true;
@@ -303,6 +307,25 @@ public:
 		m_worldTransform = worldTrans;
 	}
 
+	///returns true when the world transform and the collision shape didn't change since the last setAabbUpToDate(true)
+	///changes inside the collision shape (scaling, margin, child shapes) are not detected
+	bool	isAabbUpToDate() const
+	{
+		return (m_aabbCollisionShape == m_collisionShape) && (m_aabbWorldTransform == m_worldTransform);
+	}
+
+	void	setAabbUpToDate(bool upToDate)
+	{
+		if (upToDate)
+		{
+			m_aabbWorldTransform = m_worldTransform;
+			m_aabbCollisionShape = m_collisionShape;
+		} else
+		{
+			m_aabbCollisionShape = 0;
+		}
+	}
+
 
 	SIMD_FORCE_INLINE btBroadphaseProxy*	getBroadphaseHandle()
 	{
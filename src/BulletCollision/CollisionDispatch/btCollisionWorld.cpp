@@ -21,6 +21,7 @@ subject to the following restrictions:
 #include "BulletCollision/NarrowPhaseCollision/btGjkEpaPenetrationDepthSolver.h"
 #include "BulletCollision/CollisionShapes/btSphereShape.h" //for raycasting
 #include "BulletCollision/CollisionShapes/btBvhTriangleMeshShape.h" //for raycasting
+#include "BulletCollision/CollisionShapes/btHeightfieldTerrainShape.h" //for raycasting
 #include "BulletCollision/NarrowPhaseCollision/btRaycastCallback.h"
 #include "BulletCollision/CollisionShapes/btCompoundShape.h"
 #include "BulletCollision/NarrowPhaseCollision/btSubSimplexConvexCast.h"
@@ -31,6 +32,7 @@ subject to the following restrictions:
 #include "BulletCollision/BroadphaseCollision/btDbvt.h"
 #include "LinearMath/btAabbUtil2.h"
 #include "LinearMath/btQuickprof.h"
+#include "LinearMath/btThreads.h"
 #include "LinearMath/btStackAlloc.h"
 #include "LinearMath/btSerializer.h"
 #include "BulletCollision/CollisionShapes/btConvexPolyhedron.h"
@@ -71,10 +73,12 @@ btCollisionWorld::btCollisionWorld(btDispatcher* dispatcher,btBroadphaseInterfac
 :m_dispatcher1(dispatcher),
 m_broadphasePairCache(pairCache),
 m_debugDrawer(0),
-m_forceUpdateAllAabbs(true)
+m_forceUpdateAllAabbs(true),
+m_skipUnchangedAabbs(false)
 {
 	m_stackAlloc = collisionConfiguration->getStackAllocator();
 	m_dispatchInfo.m_stackAllocator = m_stackAlloc;
+	m_dispatchInfo.m_threadStackAllocator = collisionConfiguration->getThreadStackAllocator();
 }
 
 
@@ -127,6 +131,8 @@ void	btCollisionWorld::addCollisionObject(btCollisionObject* collisionObject,sho
 	btVector3	minAabb;
 	btVector3	maxAabb;
 	collisionObject->getCollisionShape()->getAabb(trans,minAabb,maxAabb);
+	//the proxy AABB doesn't include the contact threshold yet
+	collisionObject->setAabbUpToDate(false);
 
 	int type = collisionObject->getCollisionShape()->getShapeType();
 	collisionObject->setBroadphaseHandle( getBroadphase()->createProxy(
@@ -147,54 +153,186 @@ void	btCollisionWorld::addCollisionObject(btCollisionObject* collisionObject,sho
 
 
 
-void	btCollisionWorld::updateSingleAabb(btCollisionObject* colObj)
+///same as btCollisionShape::getAabb, without the virtual call for spheres
+static SIMD_FORCE_INLINE void	btShapeAabb(const btCollisionShape* shape, const btTransform& trans, btVector3& minAabb, btVector3& maxAabb)
 {
-	btVector3 minAabb,maxAabb;
-	colObj->getCollisionShape()->getAabb(colObj->getWorldTransform(), minAabb,maxAabb);
+	if (shape->getShapeType() == SPHERE_SHAPE_PROXYTYPE)
+	{
+		btScalar radius = static_cast<const btSphereShape*>(shape)->getRadius();
+		btVector3 extent(radius,radius,radius);
+		minAabb = trans.getOrigin() - extent;
+		maxAabb = trans.getOrigin() + extent;
+	} else
+	{
+		shape->getAabb(trans,minAabb,maxAabb);
+	}
+}
+
+///dynamic rigid bodies include their predicted motion in their AABB when continuous collision detection is used
+static SIMD_FORCE_INLINE bool	btUseInterpolationAabb(const btCollisionObject* colObj, bool useContinuous)
+{
+	return useContinuous && colObj->getInternalType()==btCollisionObject::CO_RIGID_BODY && !colObj->isStaticOrKinematicObject();
+}
+
+static void	btComputeObjectAabb(const btCollisionObject* colObj, bool useContinuous, btVector3& minAabb, btVector3& maxAabb)
+{
+	btShapeAabb(colObj->getCollisionShape(),colObj->getWorldTransform(), minAabb,maxAabb);
 	//need to increase the aabb for contact thresholds
 	btVector3 contactThreshold(gContactBreakingThreshold,gContactBreakingThreshold,gContactBreakingThreshold);
 	minAabb -= contactThreshold;
 	maxAabb += contactThreshold;
 
-	if(getDispatchInfo().m_useContinuous && colObj->getInternalType()==btCollisionObject::CO_RIGID_BODY && !colObj->isStaticOrKinematicObject())
+	if(btUseInterpolationAabb(colObj,useContinuous))
 	{
 		btVector3 minAabb2,maxAabb2;
-		colObj->getCollisionShape()->getAabb(colObj->getInterpolationWorldTransform(),minAabb2,maxAabb2);
+		btShapeAabb(colObj->getCollisionShape(),colObj->getInterpolationWorldTransform(),minAabb2,maxAabb2);
 		minAabb2 -= contactThreshold;
 		maxAabb2 += contactThreshold;
 		minAabb.setMin(minAabb2);
 		maxAabb.setMax(maxAabb2);
 	}
+}
 
-	btBroadphaseInterface* bp = (btBroadphaseInterface*)m_broadphasePairCache;
+#define BT_BOX_AABB_BATCH_SIZE 4
 
-	//moving objects should be moderately sized, probably something wrong if not
-	if ( colObj->isStaticObject() || ((maxAabb-minAabb).length2() < btScalar(1e12)))
+///computes the AABBs of up to BT_BOX_AABB_BATCH_SIZE box shapes at once, in SoA layout.
+///same as btBoxShape::getAabb (btTransformAabb) followed by the contact threshold of btComputeObjectAabb
+static void	btComputeBoxAabbs(btCollisionObject* const* objects, const int* indices, int numBoxes, btVector3* aabbMins, btVector3* aabbMaxs)
+{
+	btAssert(numBoxes>0 && numBoxes<=BT_BOX_AABB_BATCH_SIZE);
+	ATTRIBUTE_ALIGNED16(btScalar	absBasis[9][BT_BOX_AABB_BATCH_SIZE]);
+	ATTRIBUTE_ALIGNED16(btScalar	origin[3][BT_BOX_AABB_BATCH_SIZE]);
+	ATTRIBUTE_ALIGNED16(btScalar	halfExtents[3][BT_BOX_AABB_BATCH_SIZE]);
+	ATTRIBUTE_ALIGNED16(btScalar	aabbMin[3][BT_BOX_AABB_BATCH_SIZE]);
+	ATTRIBUTE_ALIGNED16(btScalar	aabbMax[3][BT_BOX_AABB_BATCH_SIZE]);
+
+	for (int lane=0;lane<BT_BOX_AABB_BATCH_SIZE;lane++)
 	{
-		bp->setAabb(colObj->getBroadphaseHandle(),minAabb,maxAabb, m_dispatcher1);
-	} else
+		//unused lanes repeat the first box
+		const btCollisionObject* colObj = objects[indices[lane<numBoxes ? lane : 0]];
+		const btBoxShape* box = static_cast<const btBoxShape*>(colObj->getCollisionShape());
+		const btTransform& trans = colObj->getWorldTransform();
+		btScalar margin = box->getMargin();
+		btVector3 halfExtentsWithMargin = box->getHalfExtentsWithoutMargin()+btVector3(margin,margin,margin);
+		for (int row=0;row<3;row++)
+		{
+			absBasis[row*3+0][lane] = btFabs(trans.getBasis()[row].getX());
+			absBasis[row*3+1][lane] = btFabs(trans.getBasis()[row].getY());
+			absBasis[row*3+2][lane] = btFabs(trans.getBasis()[row].getZ());
+			origin[row][lane] = trans.getOrigin()[row];
+			halfExtents[row][lane] = halfExtentsWithMargin[row];
+		}
+	}
+
+#if defined (BT_USE_SSE) && !defined (BT_USE_DOUBLE_PRECISION)
+	const __m128 threshold = _mm_set1_ps(gContactBreakingThreshold);
+	const __m128 hx = _mm_load_ps(halfExtents[0]);
+	const __m128 hy = _mm_load_ps(halfExtents[1]);
+	const __m128 hz = _mm_load_ps(halfExtents[2]);
+	for (int row=0;row<3;row++)
 	{
-		//something went wrong, investigate
-		//this assert is unwanted in 3D modelers (danger of loosing work)
-		colObj->setActivationState(DISABLE_SIMULATION);
+		__m128 extent = _mm_mul_ps(_mm_load_ps(absBasis[row*3+0]),hx);
+		extent = _mm_add_ps(extent,_mm_mul_ps(_mm_load_ps(absBasis[row*3+1]),hy));
+		extent = _mm_add_ps(extent,_mm_mul_ps(_mm_load_ps(absBasis[row*3+2]),hz));
+		__m128 center = _mm_load_ps(origin[row]);
+		_mm_store_ps(aabbMin[row],_mm_sub_ps(_mm_sub_ps(center,extent),threshold));
+		_mm_store_ps(aabbMax[row],_mm_add_ps(_mm_add_ps(center,extent),threshold));
+	}
+#else
+	for (int row=0;row<3;row++)
+	{
+		for (int lane=0;lane<BT_BOX_AABB_BATCH_SIZE;lane++)
+		{
+			btScalar extent = absBasis[row*3+0][lane]*halfExtents[0][lane] + absBasis[row*3+1][lane]*halfExtents[1][lane] + absBasis[row*3+2][lane]*halfExtents[2][lane];
+			aabbMin[row][lane] = (origin[row][lane]-extent)-gContactBreakingThreshold;
+			aabbMax[row][lane] = (origin[row][lane]+extent)+gContactBreakingThreshold;
+		}
+	}
+#endif
 
-		static bool reportMe = true;
-		if (reportMe && m_debugDrawer)
+	for (int lane=0;lane<numBoxes;lane++)
+	{
+		aabbMins[indices[lane]].setValue(aabbMin[0][lane],aabbMin[1][lane],aabbMin[2][lane]);
+		aabbMaxs[indices[lane]].setValue(aabbMax[0][lane],aabbMax[1][lane],aabbMax[2][lane]);
+	}
+}
+
+///the work items are the batches of boxes followed by the other objects
+struct	btUpdateAabbsLoop : public btIParallelForBody
+{
+	btCollisionObject* const*	m_objects;
+	const int*			m_boxes;
+	int					m_numBoxes;
+	int					m_numBoxBatches;
+	const int*			m_others;
+	bool				m_useContinuous;
+	btVector3*			m_aabbMins;
+	btVector3*			m_aabbMaxs;
+
+	void	forLoop(int iBegin, int iEnd) const
+	{
+		for (int i=iBegin;i<iEnd;i++)
 		{
-			reportMe = false;
-			m_debugDrawer->reportErrorWarning("Overflow in AABB, object removed from simulation");
-			m_debugDrawer->reportErrorWarning("If you can reproduce this, please email bugs@continuousphysics.com\n");
-			m_debugDrawer->reportErrorWarning("Please include above information, your Platform, version of OS.\n");
-			m_debugDrawer->reportErrorWarning("Thanks.\n");
+			if (i<m_numBoxBatches)
+			{
+				int first = i*BT_BOX_AABB_BATCH_SIZE;
+				btComputeBoxAabbs(m_objects,&m_boxes[first],btMin(m_numBoxes-first,int(BT_BOX_AABB_BATCH_SIZE)),m_aabbMins,m_aabbMaxs);
+			} else
+			{
+				int index = m_others[i-m_numBoxBatches];
+				btComputeObjectAabb(m_objects[index],m_useContinuous,m_aabbMins[index],m_aabbMaxs[index]);
+			}
 		}
 	}
+};
+
+bool	btCollisionWorld::validateAabb(btCollisionObject* colObj, const btVector3& minAabb, const btVector3& maxAabb)
+{
+	//moving objects should be moderately sized, probably something wrong if not
+	if ( colObj->isStaticObject() || ((maxAabb-minAabb).length2() < btScalar(1e12)))
+	{
+		return true;
+	}
+
+	//something went wrong, investigate
+	//this assert is unwanted in 3D modelers (danger of loosing work)
+	colObj->setActivationState(DISABLE_SIMULATION);
+
+	static bool reportMe = true;
+	if (reportMe && m_debugDrawer)
+	{
+		reportMe = false;
+		m_debugDrawer->reportErrorWarning("Overflow in AABB, object removed from simulation");
+		m_debugDrawer->reportErrorWarning("If you can reproduce this, please email bugs@continuousphysics.com\n");
+		m_debugDrawer->reportErrorWarning("Please include above information, your Platform, version of OS.\n");
+		m_debugDrawer->reportErrorWarning("Thanks.\n");
+	}
+	return false;
+}
+
+void	btCollisionWorld::updateSingleAabb(btCollisionObject* colObj)
+{
+	btVector3 minAabb,maxAabb;
+	btComputeObjectAabb(colObj,getDispatchInfo().m_useContinuous,minAabb,maxAabb);
+
+	btBroadphaseInterface* bp = (btBroadphaseInterface*)m_broadphasePairCache;
+
+	if (validateAabb(colObj,minAabb,maxAabb))
+	{
+		bp->setAabb(colObj->getBroadphaseHandle(),minAabb,maxAabb, m_dispatcher1);
+		colObj->setAabbUpToDate(true);
+	}
 }
 
 void	btCollisionWorld::updateAabbs()
 {
 	BT_PROFILE("updateAabbs");
 
-	btTransform predictedTrans;
+	bool useContinuous = getDispatchInfo().m_useContinuous;
+
+	m_aabbUpdateObjects.resize(0);
+	m_aabbUpdateBoxes.resize(0);
+	m_aabbUpdateOthers.resize(0);
 	for ( int i=0;i<m_collisionObjects.size();i++)
 	{
 		btCollisionObject* colObj = m_collisionObjects[i];
@@ -202,9 +340,61 @@ void	btCollisionWorld::updateAabbs()
 		//only update aabb of active objects
 		if (m_forceUpdateAllAabbs || colObj->isActive())
 		{
-			updateSingleAabb(colObj);
+			bool useInterpolationAabb = btUseInterpolationAabb(colObj,useContinuous);
+			//the AABB of a soft body depends on its nodes, and the predicted motion of an active rigid body isn't part of the up-to-date check
+			if (m_skipUnchangedAabbs && colObj->getInternalType()!=btCollisionObject::CO_SOFT_BODY &&
+				!(useInterpolationAabb && colObj->isActive()) && colObj->isAabbUpToDate())
+			{
+				continue;
+			}
+
+			int index = m_aabbUpdateObjects.size();
+			m_aabbUpdateObjects.push_back(colObj);
+			if (colObj->getCollisionShape()->getShapeType()==BOX_SHAPE_PROXYTYPE && !useInterpolationAabb)
+				m_aabbUpdateBoxes.push_back(index);
+			else
+				m_aabbUpdateOthers.push_back(index);
 		}
 	}
+
+	int numObjects = m_aabbUpdateObjects.size();
+	if (!numObjects)
+	{
+		//updateSingleAabb may have left a refit for the queries
+		m_broadphasePairCache->refitIfNeeded();
+		return;
+	}
+
+	m_aabbUpdateMins.resize(numObjects);
+	m_aabbUpdateMaxs.resize(numObjects);
+	m_aabbUpdateProxies.resize(numObjects);
+
+	btUpdateAabbsLoop loop;
+	loop.m_objects = &m_aabbUpdateObjects[0];
+	loop.m_boxes = m_aabbUpdateBoxes.size() ? &m_aabbUpdateBoxes[0] : 0;
+	loop.m_numBoxes = m_aabbUpdateBoxes.size();
+	loop.m_numBoxBatches = (m_aabbUpdateBoxes.size()+BT_BOX_AABB_BATCH_SIZE-1)/BT_BOX_AABB_BATCH_SIZE;
+	loop.m_others = m_aabbUpdateOthers.size() ? &m_aabbUpdateOthers[0] : 0;
+	loop.m_useContinuous = useContinuous;
+	loop.m_aabbMins = &m_aabbUpdateMins[0];
+	loop.m_aabbMaxs = &m_aabbUpdateMaxs[0];
+	btParallelFor(0,loop.m_numBoxBatches+m_aabbUpdateOthers.size(),64,loop);
+
+	//skip the invalid AABBs, and hand the others to the broadphase in the original object order
+	int numProxies = 0;
+	for (int i=0;i<numObjects;i++)
+	{
+		btCollisionObject* colObj = m_aabbUpdateObjects[i];
+		if (validateAabb(colObj,m_aabbUpdateMins[i],m_aabbUpdateMaxs[i]))
+		{
+			m_aabbUpdateProxies[numProxies] = colObj->getBroadphaseHandle();
+			m_aabbUpdateMins[numProxies] = m_aabbUpdateMins[i];
+			m_aabbUpdateMaxs[numProxies] = m_aabbUpdateMaxs[i];
+			numProxies++;
+			colObj->setAabbUpToDate(true);
+		}
+	}
+	m_broadphasePairCache->setAabbs(&m_aabbUpdateProxies[0],&m_aabbUpdateMins[0],&m_aabbUpdateMaxs[0],numProxies,m_dispatcher1);
 }
 
 
@@ -220,6 +410,12 @@ void	btCollisionWorld::performDiscreteCollisionDetection()
 
 	btDispatcherInfo& dispatchInfo = getDispatchInfo();
 
+	///the stack allocators hold the temporary memory of one step, resetting them grows them to the peak usage of the previous step
+	if (dispatchInfo.m_threadStackAllocator)
+		dispatchInfo.m_threadStackAllocator->reset();
+	else if (m_stackAlloc)
+		m_stackAlloc->reset();
+
 	updateAabbs();
 
 	computeOverlappingPairs();
@@ -442,7 +638,15 @@ void	btCollisionWorld::rayTestSingleInternal(const btTransform& rayFromTrans,con
 				btVector3 rayAabbMaxLocal = rayFromLocal;
 				rayAabbMaxLocal.setMax(rayToLocal);
 
-				concaveShape->processAllTriangles(&rcb,rayAabbMinLocal,rayAabbMaxLocal);
+				if (collisionShape->getShapeType()==TERRAIN_SHAPE_PROXYTYPE)
+				{
+					//walk the cells along the ray, and stop at the closest hit
+					const btHeightfieldTerrainShape* heightfieldShape = static_cast<const btHeightfieldTerrainShape*>(concaveShape);
+					heightfieldShape->performRaycast(&rcb,rayFromLocal,rayToLocal,&rcb.m_hitFraction);
+				} else
+				{
+					concaveShape->processAllTriangles(&rcb,rayAabbMinLocal,rayAabbMaxLocal);
+				}
 			}
 		} else {
 			//			BT_PROFILE("rayTestCompound");
@@ -778,7 +982,15 @@ void	btCollisionWorld::objectQuerySingleInternal(const btConvexShape* castShape,
 					rayAabbMaxLocal.setMax(convexToLocal);
 					rayAabbMinLocal += boxMinLocal;
 					rayAabbMaxLocal += boxMaxLocal;
-					concaveShape->processAllTriangles(&tccb,rayAabbMinLocal,rayAabbMaxLocal);
+					if (collisionShape->getShapeType()==TERRAIN_SHAPE_PROXYTYPE)
+					{
+						//only the cells that the moving box touches
+						const btHeightfieldTerrainShape* heightfieldShape = static_cast<const btHeightfieldTerrainShape*>(concaveShape);
+						heightfieldShape->performConvexcast(&tccb,convexFromLocal,convexToLocal,boxMinLocal,boxMaxLocal);
+					} else
+					{
+						concaveShape->processAllTriangles(&tccb,rayAabbMinLocal,rayAabbMaxLocal);
+					}
 				}
 			}
 		} else {
@@ -932,6 +1144,269 @@ void	btCollisionWorld::rayTest(const btVector3& rayFromWorld, const btVector3& r
 }
 
 
+///btBatchRayResultCallback is a ClosestRayResultCallback that stores its hit in a RayTestBatchResult
+struct btBatchRayResultCallback : public btCollisionWorld::RayResultCallback
+{
+	btVector3	m_rayFromWorld;
+	btVector3	m_rayToWorld;
+	btTransform	m_rayFromTrans;
+	btTransform	m_rayToTrans;
+	btCollisionWorld::RayTestBatchResult*	m_result;
+
+	void	init(const btVector3& rayFromWorld, const btVector3& rayToWorld, btCollisionWorld::RayTestBatchResult* result, short int collisionFilterGroup, short int collisionFilterMask)
+	{
+		m_rayFromWorld = rayFromWorld;
+		m_rayToWorld = rayToWorld;
+		m_rayFromTrans.setIdentity();
+		m_rayFromTrans.setOrigin(rayFromWorld);
+		m_rayToTrans.setIdentity();
+		m_rayToTrans.setOrigin(rayToWorld);
+		m_collisionFilterGroup = collisionFilterGroup;
+		m_collisionFilterMask = collisionFilterMask;
+
+		m_result = result;
+		m_result->m_collisionObject = 0;
+		m_result->m_hitFraction = btScalar(1.);
+		m_result->m_hitPointWorld = rayToWorld;
+		m_result->m_hitNormalWorld.setValue(0,0,0);
+		m_result->m_shapePart = -1;
+		m_result->m_triangleIndex = -1;
+	}
+
+	virtual	btScalar	addSingleResult(btCollisionWorld::LocalRayResult& rayResult,bool normalInWorldSpace)
+	{
+		//caller already does the filter on the m_closestHitFraction
+		btAssert(rayResult.m_hitFraction <= m_closestHitFraction);
+
+		m_closestHitFraction = rayResult.m_hitFraction;
+		m_collisionObject = rayResult.m_collisionObject;
+		m_result->m_collisionObject = rayResult.m_collisionObject;
+		m_result->m_hitFraction = rayResult.m_hitFraction;
+		if (normalInWorldSpace)
+		{
+			m_result->m_hitNormalWorld = rayResult.m_hitNormalLocal;
+		} else
+		{
+			///need to transform normal into worldspace
+			m_result->m_hitNormalWorld = m_collisionObject->getWorldTransform().getBasis()*rayResult.m_hitNormalLocal;
+		}
+		m_result->m_hitPointWorld.setInterpolate3(m_rayFromWorld,m_rayToWorld,rayResult.m_hitFraction);
+		m_result->m_shapePart = rayResult.m_localShapeInfo ? rayResult.m_localShapeInfo->m_shapePart : -1;
+		m_result->m_triangleIndex = rayResult.m_localShapeInfo ? rayResult.m_localShapeInfo->m_triangleIndex : -1;
+		return rayResult.m_hitFraction;
+	}
+};
+
+///same as the BridgeTriangleRaycastCallback of rayTestSingleInternal, for btBvhTriangleMeshShape::performRaycastPacket
+struct btBatchTriangleRaycastCallback : public btTriangleRaycastCallback
+{
+	btBatchRayResultCallback*	m_resultCallback;
+	const btCollisionObject*	m_collisionObject;
+
+	btBatchTriangleRaycastCallback()
+		:btTriangleRaycastCallback(btVector3(0,0,0),btVector3(0,0,0))
+	{
+	}
+
+	virtual btScalar reportHit(const btVector3& hitNormalLocal, btScalar hitFraction, int partId, int triangleIndex )
+	{
+		btCollisionWorld::LocalShapeInfo	shapeInfo;
+		shapeInfo.m_shapePart = partId;
+		shapeInfo.m_triangleIndex = triangleIndex;
+
+		btVector3 hitNormalWorld = m_collisionObject->getWorldTransform().getBasis() * hitNormalLocal;
+
+		btCollisionWorld::LocalRayResult rayResult
+			(m_collisionObject,
+			&shapeInfo,
+			hitNormalWorld,
+			hitFraction);
+
+		bool	normalInWorldSpace = true;
+		return m_resultCallback->addSingleResult(rayResult,normalInWorldSpace);
+	}
+};
+
+///btRayTestBatchPacket tests the objects reported by the broadphase against the rays of one packet of rayTestBatch
+struct btRayTestBatchPacket : public btBroadphaseRayPacketCallback
+{
+	btRayPacket					m_packet;
+	btBatchRayResultCallback	m_resultCallbacks[BT_RAY_PACKET_SIZE];
+	btCollisionWorld::RayTestSingleFunc	m_rayTestSingle;
+
+	virtual void	process(const btBroadphaseProxy* proxy, unsigned int rayMask)
+	{
+		btCollisionObject*	collisionObject = (btCollisionObject*)proxy->m_clientObject;
+
+		//only perform raycast if filterMask matches, and the ray didn't stop yet, see btSingleRayCallback::process
+		unsigned int mask = 0;
+		int numRays = 0;
+		for (int i=0;i<BT_RAY_PACKET_SIZE;i++)
+		{
+			if ((rayMask & (1u<<i)) && m_resultCallbacks[i].m_closestHitFraction > btScalar(0.f) &&
+				m_resultCallbacks[i].needsCollision(collisionObject->getBroadphaseHandle()))
+			{
+				mask |= 1u<<i;
+				numRays++;
+			}
+		}
+		if (!numRays)
+			return;
+
+		const btCollisionShape* collisionShape = collisionObject->getCollisionShape();
+		const btTransform& colObjWorldTransform = collisionObject->getWorldTransform();
+		if (numRays>1 && collisionShape->getShapeType()==TRIANGLE_MESH_SHAPE_PROXYTYPE)
+		{
+			//one walk of the bvh for all rays
+			btBvhTriangleMeshShape* triangleMesh = (btBvhTriangleMeshShape*)collisionShape;
+			btTransform worldTocollisionObject = colObjWorldTransform.inverse();
+			btBatchTriangleRaycastCallback triangleCallbacks[BT_RAY_PACKET_SIZE];
+			btTriangleRaycastCallback* triangleCallbackPtrs[BT_RAY_PACKET_SIZE];
+			int numMeshRays = 0;
+			for (int i=0;i<BT_RAY_PACKET_SIZE;i++)
+			{
+				if (mask & (1u<<i))
+				{
+					btBatchTriangleRaycastCallback& rcb = triangleCallbacks[numMeshRays];
+					rcb.m_from = worldTocollisionObject * m_resultCallbacks[i].m_rayFromWorld;
+					rcb.m_to = worldTocollisionObject * m_resultCallbacks[i].m_rayToWorld;
+					rcb.m_flags = m_resultCallbacks[i].m_flags;
+					rcb.m_hitFraction = m_resultCallbacks[i].m_closestHitFraction;
+					rcb.m_resultCallback = &m_resultCallbacks[i];
+					rcb.m_collisionObject = collisionObject;
+					triangleCallbackPtrs[numMeshRays++] = &rcb;
+				}
+			}
+			triangleMesh->performRaycastPacket(triangleCallbackPtrs,numMeshRays);
+		} else
+		{
+			for (int i=0;i<BT_RAY_PACKET_SIZE;i++)
+			{
+				if (mask & (1u<<i))
+				{
+					m_rayTestSingle(m_resultCallbacks[i].m_rayFromTrans,m_resultCallbacks[i].m_rayToTrans,
+						collisionObject,
+						collisionShape,
+						colObjWorldTransform,
+						m_resultCallbacks[i]);
+				}
+			}
+		}
+
+		//the closest hits prune the rest of the traversal
+		for (int i=0;i<BT_RAY_PACKET_SIZE;i++)
+		{
+			if (mask & (1u<<i))
+			{
+				m_packet.m_lambdaMax[i] = m_resultCallbacks[i].m_closestHitFraction;
+			}
+		}
+	}
+};
+
+///btRayTestBatchSingleRay traverses the broadphase with one ray of a packet, for broadphases without a packet traversal (the btBroadphaseInterface default)
+struct btRayTestBatchSingleRay : public btBroadphaseRayCallback
+{
+	btRayTestBatchPacket&	m_packet;
+	int						m_ray;
+
+	btRayTestBatchSingleRay(btRayTestBatchPacket& packet,int ray,const btVector3& rayFromWorld,const btVector3& rayToWorld)
+		:m_packet(packet),
+		m_ray(ray)
+	{
+		//same as btSingleRayCallback
+		btVector3 rayDir = (rayToWorld-rayFromWorld);
+		rayDir.normalize ();
+		m_rayDirectionInverse[0] = rayDir[0] == btScalar(0.0) ? btScalar(BT_LARGE_FLOAT) : btScalar(1.0) / rayDir[0];
+		m_rayDirectionInverse[1] = rayDir[1] == btScalar(0.0) ? btScalar(BT_LARGE_FLOAT) : btScalar(1.0) / rayDir[1];
+		m_rayDirectionInverse[2] = rayDir[2] == btScalar(0.0) ? btScalar(BT_LARGE_FLOAT) : btScalar(1.0) / rayDir[2];
+		m_signs[0] = m_rayDirectionInverse[0] < 0.0;
+		m_signs[1] = m_rayDirectionInverse[1] < 0.0;
+		m_signs[2] = m_rayDirectionInverse[2] < 0.0;
+		m_lambda_max = rayDir.dot(rayToWorld-rayFromWorld);
+	}
+
+	virtual bool	process(const btBroadphaseProxy* proxy)
+	{
+		///terminate further ray tests, once the closestHitFraction reached zero
+		if (m_packet.m_resultCallbacks[m_ray].m_closestHitFraction == btScalar(0.f))
+			return false;
+
+		//not every broadphase culls the proxies by their AABB (btSimpleBroadphase reports all of them)
+		unsigned int rayMask = btRayPacketAabb(m_packet.m_packet,proxy->m_aabbMin,proxy->m_aabbMax) & (1u<<m_ray);
+		if (rayMask)
+		{
+			m_packet.process(proxy,rayMask);
+		}
+		return true;
+	}
+};
+
+struct btRayTestBatchLoop : public btIParallelForBody
+{
+	btBroadphaseInterface*	m_broadphase;
+	btCollisionWorld::RayTestSingleFunc	m_rayTestSingle;
+	const btVector3*	m_rayFromWorld;
+	const btVector3*	m_rayToWorld;
+	int			m_numRays;
+	btCollisionWorld::RayTestBatchResult*	m_results;
+	short int	m_collisionFilterGroup;
+	short int	m_collisionFilterMask;
+
+	void	forLoop(int iBegin, int iEnd) const
+	{
+		for (int p=iBegin;p<iEnd;p++)
+		{
+			btRayTestBatchPacket packet;
+			packet.m_rayTestSingle = m_rayTestSingle;
+			int firstRay = p*BT_RAY_PACKET_SIZE;
+			int numRays = btMin(int(BT_RAY_PACKET_SIZE),m_numRays-firstRay);
+			for (int i=0;i<numRays;i++)
+			{
+				int ray = firstRay+i;
+				packet.m_resultCallbacks[i].init(m_rayFromWorld[ray],m_rayToWorld[ray],&m_results[ray],m_collisionFilterGroup,m_collisionFilterMask);
+				packet.m_packet.setRay(i,m_rayFromWorld[ray],m_rayToWorld[ray]);
+			}
+			if (!m_broadphase->rayTestPacket(packet.m_packet,packet))
+			{
+				//the broadphase has no packet traversal (the btBroadphaseInterface default), traverse it once per ray
+				for (int i=0;i<numRays;i++)
+				{
+					int ray = firstRay+i;
+					btRayTestBatchSingleRay rayCB(packet,i,m_rayFromWorld[ray],m_rayToWorld[ray]);
+					m_broadphase->rayTest(m_rayFromWorld[ray],m_rayToWorld[ray],rayCB);
+				}
+			}
+		}
+	}
+};
+
+void	btCollisionWorld::rayTestBatch(const btVector3* rayFromWorld, const btVector3* rayToWorld, int numRays, RayTestBatchResult* results,
+									  short int collisionFilterGroup, short int collisionFilterMask) const
+{
+	rayTestBatchInternal(rayFromWorld,rayToWorld,numRays,results,collisionFilterGroup,collisionFilterMask,&btCollisionWorld::rayTestSingle);
+}
+
+void	btCollisionWorld::rayTestBatchInternal(const btVector3* rayFromWorld, const btVector3* rayToWorld, int numRays, RayTestBatchResult* results,
+									  short int collisionFilterGroup, short int collisionFilterMask, RayTestSingleFunc rayTestSingleFunc) const
+{
+	BT_PROFILE("rayTestBatch");
+	//the packets are tested from several threads, the broadphase has to be up to date before
+	m_broadphasePairCache->refitIfNeeded();
+	btRayTestBatchLoop loop;
+	loop.m_broadphase = m_broadphasePairCache;
+	loop.m_rayTestSingle = rayTestSingleFunc;
+	loop.m_rayFromWorld = rayFromWorld;
+	loop.m_rayToWorld = rayToWorld;
+	loop.m_numRays = numRays;
+	loop.m_results = results;
+	loop.m_collisionFilterGroup = collisionFilterGroup;
+	loop.m_collisionFilterMask = collisionFilterMask;
+	int numPackets = (numRays+BT_RAY_PACKET_SIZE-1)/BT_RAY_PACKET_SIZE;
+	btParallelFor(0,numPackets,8,loop);
+}
+
+
 struct btSingleSweepCallback : public btBroadphaseRayCallback
 {
 
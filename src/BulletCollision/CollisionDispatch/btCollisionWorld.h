@@ -101,8 +101,22 @@ protected:
 	///it is true by default, because it is error-prone (setting the position of static objects wouldn't update their AABB)
 	bool m_forceUpdateAllAabbs;
 
+	///m_skipUnchangedAabbs skips the AABB update of objects whose transform and collision shape didn't change, see setSkipUnchangedAabbs
+	bool m_skipUnchangedAabbs;
+
+	///temporary arrays of updateAabbs, the objects are updated in batches and the broadphase gets all new AABBs in one setAabbs call
+	btAlignedObjectArray<btCollisionObject*>	m_aabbUpdateObjects;
+	btAlignedObjectArray<int>					m_aabbUpdateBoxes;
+	btAlignedObjectArray<int>					m_aabbUpdateOthers;
+	btAlignedObjectArray<btBroadphaseProxy*>	m_aabbUpdateProxies;
+	btAlignedObjectArray<btVector3>				m_aabbUpdateMins;
+	btAlignedObjectArray<btVector3>				m_aabbUpdateMaxs;
+
 	void	serializeCollisionObjects(btSerializer* serializer);
 
+	///returns false and disables the object when its AABB is too large to be valid
+	bool	validateAabb(btCollisionObject* colObj, const btVector3& minAabb, const btVector3& maxAabb);
+
 public:
 
 	//this constructor doesn't own the dispatcher and paircache/broadphase
@@ -143,6 +157,8 @@ public:
 
 	void	updateSingleAabb(btCollisionObject* colObj);
 
+	///updateAabbs computes the AABBs of the active objects (of all objects when getForceUpdateAllAabbs is true) using btParallelFor.
+	///The AABBs of box shapes are computed in SIMD batches, and the broadphase is updated with one btBroadphaseInterface::setAabbs call.
 	virtual void	updateAabbs();
 
 	///the computeOverlappingPairs is usually already called by performDiscreteCollisionDetection (or stepSimulation)
@@ -440,6 +456,41 @@ public:
 	/// This allows for several queries: first hit, all hits, any hit, dependent on the value returned by the callback.
 	virtual void rayTest(const btVector3& rayFromWorld, const btVector3& rayToWorld, RayResultCallback& resultCallback) const; 
 
+	///RayTestBatchResult is the closest hit of one ray of rayTestBatch, m_collisionObject is 0 when the ray didn't hit anything
+	struct	RayTestBatchResult
+	{
+		const btCollisionObject*	m_collisionObject;
+		btScalar	m_hitFraction;
+		btVector3	m_hitPointWorld;
+		btVector3	m_hitNormalWorld;
+		///shape part and triangle index of triangle mesh hits, -1 otherwise
+		int			m_shapePart;
+		int			m_triangleIndex;
+	};
+
+	/// rayTestBatch finds the closest hit of each ray, like rayTest with a ClosestRayResultCallback, and stores it in results[i].
+	/// The rays are tested in packets of BT_RAY_PACKET_SIZE consecutive rays: each packet traverses the broadphase and the bvh of btBvhTriangleMeshShape once.
+	/// The packets are spread over the threads using btParallelFor. Rays with nearby origins and similar directions make the best packets.
+	/// A derived world that overrides rayTest should override rayTestBatch too, see btSoftRigidDynamicsWorld.
+	virtual void	rayTestBatch(const btVector3* rayFromWorld, const btVector3* rayToWorld, int numRays, RayTestBatchResult* results,
+						 short int collisionFilterGroup=btBroadphaseProxy::DefaultFilter, short int collisionFilterMask=btBroadphaseProxy::AllFilter) const;
+
+	///RayTestSingleFunc tests one ray against one object for rayTestBatch, like rayTestSingle
+	typedef void (*RayTestSingleFunc)(const btTransform& rayFromTrans,const btTransform& rayToTrans,
+					  btCollisionObject* collisionObject,
+					  const btCollisionShape* collisionShape,
+					  const btTransform& colObjWorldTransform,
+					  RayResultCallback& resultCallback);
+
+protected:
+
+	///rayTestBatchInternal is rayTestBatch with the ray test of the objects that aren't triangle meshes replaced by rayTestSingleFunc.
+	///rayTestSingleFunc is called from several threads at the same time.
+	void	rayTestBatchInternal(const btVector3* rayFromWorld, const btVector3* rayToWorld, int numRays, RayTestBatchResult* results,
+						 short int collisionFilterGroup, short int collisionFilterMask, RayTestSingleFunc rayTestSingleFunc) const;
+
+public:
+
 	/// convexTest performs a swept convex cast on all objects in the btCollisionWorld, and calls the resultCallback
 	/// This allows for several queries: first hit, all hits, any hit, dependent on the value return by the callback.
 	void    convexSweepTest (const btConvexShape* castShape, const btTransform& from, const btTransform& to, ConvexResultCallback& resultCallback,  btScalar allowedCcdPenetration = btScalar(0.)) const;
@@ -513,6 +564,18 @@ public:
 		m_forceUpdateAllAabbs = forceUpdateAllAabbs;
 	}
 
+	bool	getSkipUnchangedAabbs() const
+	{
+		return m_skipUnchangedAabbs;
+	}
+	///when enabled, updateAabbs skips the objects whose world transform and collision shape didn't change since their last AABB update.
+	///it is false by default: after changing a collision shape in place (scaling, margin, child shapes), call updateSingleAabb for its objects.
+	///soft bodies are always updated.
+	void	setSkipUnchangedAabbs(bool skipUnchangedAabbs)
+	{
+		m_skipUnchangedAabbs = skipUnchangedAabbs;
+	}
+
 	///Preliminary serialization test for Bullet 2.76. Loading those files requires a separate parser (Bullet/Demos/SerializeDemo)
 	virtual	void	serialize(btSerializer* serializer);
 
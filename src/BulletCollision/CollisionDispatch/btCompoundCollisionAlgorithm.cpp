@@ -19,6 +19,7 @@ subject to the following restrictions:
 #include "BulletCollision/BroadphaseCollision/btDbvt.h"
 #include "LinearMath/btIDebugDraw.h"
 #include "LinearMath/btAabbUtil2.h"
+#include "LinearMath/btStackAlloc.h"
 #include "btManifoldResult.h"
 #include "BulletCollision/CollisionDispatch/btCollisionObjectWrapper.h"
 
@@ -233,6 +234,14 @@ void btCompoundCollisionAlgorithm::processCollision (const btCollisionObjectWrap
 	{
 		int i;
 		btManifoldArray manifoldArray;
+		//the array only grows on the heap when a child has more manifolds than fit in the stack allocator block
+		btStackAlloc* stackAlloc = dispatchInfo.getStackAllocator();
+		btBlock* block = stackAlloc ? stackAlloc->beginBlock() : 0;
+		if (block)
+		{
+			const int capacity = 16;
+			manifoldArray.initializeFromBuffer(stackAlloc->allocate(sizeof(btPersistentManifold*)*capacity),0,capacity);
+		}
 		for (i=0;i<m_childCollisionAlgorithms.size();i++)
 		{
 			if (m_childCollisionAlgorithms[i])
@@ -250,6 +259,11 @@ void btCompoundCollisionAlgorithm::processCollision (const btCollisionObjectWrap
 				manifoldArray.resize(0);
 			}
 		}
+		if (block)
+		{
+			manifoldArray.initializeFromBuffer(0,0,0);
+			stackAlloc->endBlock(block);
+		}
 	}
 
 	if (tree)
@@ -262,7 +276,21 @@ void btCompoundCollisionAlgorithm::processCollision (const btCollisionObjectWrap
 
 		const ATTRIBUTE_ALIGNED16(btDbvtVolume)	bounds=btDbvtVolume::FromMM(localAabbMin,localAabbMax);
 		//process all children, that overlap with  the given AABB bounds
-		tree->collideTV(tree->m_root,bounds,callback);
+		//the traversal stack comes from the stack allocator, the child algorithms can use it too while the block is open
+		btAlignedObjectArray<const btDbvtNode*> stack;
+		btStackAlloc* stackAlloc = dispatchInfo.getStackAllocator();
+		btBlock* block = stackAlloc ? stackAlloc->beginBlock() : 0;
+		if (block)
+		{
+			const int capacity = btDbvt::SIMPLE_STACKSIZE;
+			stack.initializeFromBuffer(stackAlloc->allocate(sizeof(const btDbvtNode*)*capacity),0,capacity);
+		}
+		tree->collideTVNoStackAlloc(tree->m_root,bounds,stack,callback);
+		if (block)
+		{
+			stack.initializeFromBuffer(0,0,0);
+			stackAlloc->endBlock(block);
+		}
 
 	} else
 	{
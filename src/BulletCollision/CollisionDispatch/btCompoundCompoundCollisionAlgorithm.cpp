@@ -0,0 +1,299 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "BulletCollision/CollisionDispatch/btCompoundCompoundCollisionAlgorithm.h"
+#include "BulletCollision/CollisionDispatch/btCollisionObject.h"
+#include "BulletCollision/CollisionShapes/btCompoundShape.h"
+#include "LinearMath/btAabbUtil2.h"
+#include "LinearMath/btStackAlloc.h"
+#include "btManifoldResult.h"
+#include "BulletCollision/CollisionDispatch/btCollisionObjectWrapper.h"
+
+int gCompoundCompoundPairRemovalDelay = 4;
+
+btCompoundCompoundCollisionAlgorithm::btCompoundCompoundCollisionAlgorithm( const btCollisionAlgorithmConstructionInfo& ci,const btCollisionObjectWrapper* body0Wrap,const btCollisionObjectWrapper* body1Wrap)
+:btActivatingCollisionAlgorithm(ci,body0Wrap,body1Wrap),
+m_sharedManifold(ci.m_manifold),
+m_timeStamp(0)
+{
+	btAssert (body0Wrap->getCollisionShape()->isCompound());
+	btAssert (body1Wrap->getCollisionShape()->isCompound());
+
+	m_compoundShapeRevision0 = static_cast<const btCompoundShape*>(body0Wrap->getCollisionShape())->getUpdateRevision();
+	m_compoundShapeRevision1 = static_cast<const btCompoundShape*>(body1Wrap->getCollisionShape())->getUpdateRevision();
+}
+
+btCompoundCompoundCollisionAlgorithm::~btCompoundCompoundCollisionAlgorithm()
+{
+	removeChildAlgorithms();
+}
+
+void	btCompoundCompoundCollisionAlgorithm::removeChildAlgorithms()
+{
+	for (int i=0;i<m_childPairs.size();i++)
+	{
+		btCollisionAlgorithm* algorithm = m_childPairs.getAtIndex(i)->m_algorithm;
+		if (algorithm)
+		{
+			algorithm->~btCollisionAlgorithm();
+			m_dispatcher->freeCollisionAlgorithm(algorithm);
+		}
+	}
+	m_childPairs.clear();
+}
+
+void	btCompoundCompoundCollisionAlgorithm::removeStalePairs()
+{
+	//btHashMap::remove moves the last pair into the removed slot, so iterate backwards
+	for (int i=m_childPairs.size()-1;i>=0;i--)
+	{
+		const btCompoundChildPair* pair = m_childPairs.getAtIndex(i);
+		if (m_timeStamp-pair->m_timeStamp > gCompoundCompoundPairRemovalDelay)
+		{
+			btCollisionAlgorithm* algorithm = pair->m_algorithm;
+			m_childPairs.remove(btCompoundChildPairKey(pair->m_index0,pair->m_index1));
+			if (algorithm)
+			{
+				algorithm->~btCollisionAlgorithm();
+				m_dispatcher->freeCollisionAlgorithm(algorithm);
+			}
+		}
+	}
+}
+
+struct	btCompoundCompoundLeafCallback
+{
+	const btCollisionObjectWrapper* m_compound0ColObjWrap;
+	const btCollisionObjectWrapper* m_compound1ColObjWrap;
+	btDispatcher* m_dispatcher;
+	const btDispatcherInfo& m_dispatchInfo;
+	btManifoldResult*	m_resultOut;
+	btHashMap<btCompoundChildPairKey,btCompoundChildPair>&	m_childPairs;
+	btPersistentManifold*	m_sharedManifold;
+	int		m_timeStamp;
+	int		m_numProcessedPairs;
+
+	btCompoundCompoundLeafCallback (const btCollisionObjectWrapper* compound0ObjWrap,const btCollisionObjectWrapper* compound1ObjWrap,btDispatcher* dispatcher,const btDispatcherInfo& dispatchInfo,btManifoldResult* resultOut,
+		btHashMap<btCompoundChildPairKey,btCompoundChildPair>& childPairs,btPersistentManifold* sharedManifold,int timeStamp)
+		:m_compound0ColObjWrap(compound0ObjWrap),m_compound1ColObjWrap(compound1ObjWrap),m_dispatcher(dispatcher),m_dispatchInfo(dispatchInfo),m_resultOut(resultOut),
+		m_childPairs(childPairs),
+		m_sharedManifold(sharedManifold),
+		m_timeStamp(timeStamp),
+		m_numProcessedPairs(0)
+	{
+	}
+
+	btCompoundCompoundLeafCallback& operator=(btCompoundCompoundLeafCallback& other)
+	{
+		btAssert(0);
+		(void)other;
+		return *this;
+	}
+
+	void	ProcessChildPair(int index0, int index1)
+	{
+		const btCompoundShape* compoundShape0 = static_cast<const btCompoundShape*>(m_compound0ColObjWrap->getCollisionShape());
+		const btCompoundShape* compoundShape1 = static_cast<const btCompoundShape*>(m_compound1ColObjWrap->getCollisionShape());
+		btAssert(index0>=0 && index0<compoundShape0->getNumChildShapes());
+		btAssert(index1>=0 && index1<compoundShape1->getNumChildShapes());
+
+		const btCollisionShape* childShape0 = compoundShape0->getChildShape(index0);
+		const btCollisionShape* childShape1 = compoundShape1->getChildShape(index1);
+		btTransform	newChildWorldTrans0 = m_compound0ColObjWrap->getWorldTransform()*compoundShape0->getChildTransform(index0);
+		btTransform	newChildWorldTrans1 = m_compound1ColObjWrap->getWorldTransform()*compoundShape1->getChildTransform(index1);
+
+		//the tree traversal is conservative, perform an exact AABB check first
+		btVector3 aabbMin0,aabbMax0,aabbMin1,aabbMax1;
+		childShape0->getAabb(newChildWorldTrans0,aabbMin0,aabbMax0);
+		childShape1->getAabb(newChildWorldTrans1,aabbMin1,aabbMax1);
+		if (!TestAabbAgainstAabb2(aabbMin0,aabbMax0,aabbMin1,aabbMax1))
+			return;
+
+		btCollisionObjectWrapper compoundWrap0(m_compound0ColObjWrap,childShape0,m_compound0ColObjWrap->getCollisionObject(),newChildWorldTrans0);
+		btCollisionObjectWrapper compoundWrap1(m_compound1ColObjWrap,childShape1,m_compound1ColObjWrap->getCollisionObject(),newChildWorldTrans1);
+
+		btCompoundChildPairKey key(index0,index1);
+		btCompoundChildPair* pair = m_childPairs.find(key);
+		if (!pair)
+		{
+			btCompoundChildPair newPair;
+			newPair.m_index0 = index0;
+			newPair.m_index1 = index1;
+			newPair.m_timeStamp = m_timeStamp;
+			newPair.m_algorithm = m_dispatcher->findAlgorithm(&compoundWrap0,&compoundWrap1,m_sharedManifold);
+			m_childPairs.insert(key,newPair);
+			pair = m_childPairs.find(key);
+		}
+		pair->m_timeStamp = m_timeStamp;
+		m_numProcessedPairs++;
+
+		const btCollisionObjectWrapper* tmpWrap0 = m_resultOut->getBody0Wrap();
+		const btCollisionObjectWrapper* tmpWrap1 = m_resultOut->getBody1Wrap();
+
+		///detect swapping case
+		if (m_resultOut->getBody0Internal() == m_compound0ColObjWrap->getCollisionObject())
+		{
+			m_resultOut->setBody0Wrap(&compoundWrap0);
+			m_resultOut->setBody1Wrap(&compoundWrap1);
+			m_resultOut->setShapeIdentifiersA(-1,index0);
+			m_resultOut->setShapeIdentifiersB(-1,index1);
+		} else
+		{
+			m_resultOut->setBody0Wrap(&compoundWrap1);
+			m_resultOut->setBody1Wrap(&compoundWrap0);
+			m_resultOut->setShapeIdentifiersA(-1,index1);
+			m_resultOut->setShapeIdentifiersB(-1,index0);
+		}
+
+		pair->m_algorithm->processCollision(&compoundWrap0,&compoundWrap1,m_dispatchInfo,m_resultOut);
+
+		m_resultOut->setBody0Wrap(tmpWrap0);
+		m_resultOut->setBody1Wrap(tmpWrap1);
+	}
+};
+
+///same as btDbvt::collideTT, but tree1 lives in another space: xform1To0 transforms from the space of tree1 into the space of tree0
+static void	btCollideCompoundTrees(const btDbvtNode* root0, const btDbvtNode* root1, const btTransform& xform1To0, btAlignedObjectArray<btDbvt::sStkNN>& stack, btCompoundCompoundLeafCallback& callback)
+{
+	stack.resize(0);
+	stack.push_back(btDbvt::sStkNN(root0,root1));
+	while (stack.size())
+	{
+		btDbvt::sStkNN p = stack[stack.size()-1];
+		stack.pop_back();
+
+		btVector3 aabbMin1,aabbMax1;
+		btTransformAabb(p.b->volume.Mins(),p.b->volume.Maxs(),btScalar(0.),xform1To0,aabbMin1,aabbMax1);
+		if (!TestAabbAgainstAabb2(p.a->volume.Mins(),p.a->volume.Maxs(),aabbMin1,aabbMax1))
+			continue;
+
+		if (p.a->isinternal())
+		{
+			if (p.b->isinternal())
+			{
+				stack.push_back(btDbvt::sStkNN(p.a->childs[0],p.b->childs[0]));
+				stack.push_back(btDbvt::sStkNN(p.a->childs[1],p.b->childs[0]));
+				stack.push_back(btDbvt::sStkNN(p.a->childs[0],p.b->childs[1]));
+				stack.push_back(btDbvt::sStkNN(p.a->childs[1],p.b->childs[1]));
+			} else
+			{
+				stack.push_back(btDbvt::sStkNN(p.a->childs[0],p.b));
+				stack.push_back(btDbvt::sStkNN(p.a->childs[1],p.b));
+			}
+		} else
+		{
+			if (p.b->isinternal())
+			{
+				stack.push_back(btDbvt::sStkNN(p.a,p.b->childs[0]));
+				stack.push_back(btDbvt::sStkNN(p.a,p.b->childs[1]));
+			} else
+			{
+				callback.ProcessChildPair(p.a->dataAsInt,p.b->dataAsInt);
+			}
+		}
+	}
+}
+
+void btCompoundCompoundCollisionAlgorithm::processCollision (const btCollisionObjectWrapper* body0Wrap,const btCollisionObjectWrapper* body1Wrap,const btDispatcherInfo& dispatchInfo,btManifoldResult* resultOut)
+{
+	btAssert (body0Wrap->getCollisionShape()->isCompound());
+	btAssert (body1Wrap->getCollisionShape()->isCompound());
+	const btCompoundShape* compoundShape0 = static_cast<const btCompoundShape*>(body0Wrap->getCollisionShape());
+	const btCompoundShape* compoundShape1 = static_cast<const btCompoundShape*>(body1Wrap->getCollisionShape());
+
+	///the child indices of the cached pairs are only valid while the compound shapes are unchanged
+	if (compoundShape0->getUpdateRevision() != m_compoundShapeRevision0 || compoundShape1->getUpdateRevision() != m_compoundShapeRevision1)
+	{
+		removeChildAlgorithms();
+		m_compoundShapeRevision0 = compoundShape0->getUpdateRevision();
+		m_compoundShapeRevision1 = compoundShape1->getUpdateRevision();
+	}
+
+	///we need to refresh all contact manifolds, also of the pairs that don't overlap anymore
+	{
+		btManifoldArray manifoldArray;
+		//the array only grows on the heap when a child pair has more manifolds than fit in the stack allocator block
+		btStackAlloc* stackAlloc = dispatchInfo.getStackAllocator();
+		btBlock* block = stackAlloc ? stackAlloc->beginBlock() : 0;
+		if (block)
+		{
+			const int capacity = 16;
+			manifoldArray.initializeFromBuffer(stackAlloc->allocate(sizeof(btPersistentManifold*)*capacity),0,capacity);
+		}
+		for (int i=0;i<m_childPairs.size();i++)
+		{
+			btCollisionAlgorithm* algorithm = m_childPairs.getAtIndex(i)->m_algorithm;
+			if (algorithm)
+			{
+				algorithm->getAllContactManifolds(manifoldArray);
+				for (int m=0;m<manifoldArray.size();m++)
+				{
+					if (manifoldArray[m]->getNumContacts())
+					{
+						resultOut->setPersistentManifold(manifoldArray[m]);
+						resultOut->refreshContactPoints();
+						resultOut->setPersistentManifold(0);
+					}
+				}
+				manifoldArray.resize(0);
+			}
+		}
+		if (block)
+		{
+			manifoldArray.initializeFromBuffer(0,0,0);
+			stackAlloc->endBlock(block);
+		}
+	}
+
+	m_timeStamp++;
+	btCompoundCompoundLeafCallback callback(body0Wrap,body1Wrap,m_dispatcher,dispatchInfo,resultOut,m_childPairs,m_sharedManifold,m_timeStamp);
+
+	const btDbvt* tree0 = compoundShape0->getDynamicAabbTree();
+	const btDbvt* tree1 = compoundShape1->getDynamicAabbTree();
+	if (tree0 && tree1)
+	{
+		if (tree0->m_root && tree1->m_root)
+		{
+			btTransform xform1To0 = body0Wrap->getWorldTransform().inverse()*body1Wrap->getWorldTransform();
+			btCollideCompoundTrees(tree0->m_root,tree1->m_root,xform1To0,m_stack,callback);
+		}
+	} else
+	{
+		//iterate over all child pairs, ProcessChildPair performs an AABB check
+		for (int i=0;i<compoundShape0->getNumChildShapes();i++)
+		{
+			for (int j=0;j<compoundShape1->getNumChildShapes();j++)
+			{
+				callback.ProcessChildPair(i,j);
+			}
+		}
+	}
+
+	//every cached pair got a new time stamp when all of them still overlap
+	if (callback.m_numProcessedPairs != m_childPairs.size())
+	{
+		removeStalePairs();
+	}
+}
+
+btScalar	btCompoundCompoundCollisionAlgorithm::calculateTimeOfImpact(btCollisionObject* body0,btCollisionObject* body1,const btDispatcherInfo& dispatchInfo,btManifoldResult* resultOut)
+{
+	//not supported, like btCompoundCollisionAlgorithm
+	(void)body0;
+	(void)body1;
+	(void)dispatchInfo;
+	(void)resultOut;
+	return btScalar(1.);
+}
@@ -0,0 +1,133 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_COMPOUND_COMPOUND_COLLISION_ALGORITHM_H
+#define BT_COMPOUND_COMPOUND_COLLISION_ALGORITHM_H
+
+#include "btActivatingCollisionAlgorithm.h"
+#include "BulletCollision/BroadphaseCollision/btDispatcher.h"
+#include "BulletCollision/BroadphaseCollision/btBroadphaseInterface.h"
+
+#include "BulletCollision/NarrowPhaseCollision/btPersistentManifold.h"
+#include "btCollisionCreateFunc.h"
+#include "LinearMath/btAlignedObjectArray.h"
+#include "LinearMath/btHashMap.h"
+#include "BulletCollision/BroadphaseCollision/btDbvt.h"
+class btDispatcher;
+class btCollisionObject;
+class btCompoundShape;
+
+///number of frames a child pair is kept after its AABBs stopped overlapping, so that pairs that touch on and off don't create and destroy their algorithm every frame
+extern int gCompoundCompoundPairRemovalDelay;
+
+///btCompoundChildPairKey identifies a pair of child shapes by their indices in the two compound shapes
+struct btCompoundChildPairKey
+{
+	int	m_index0;
+	int	m_index1;
+
+	btCompoundChildPairKey(int index0, int index1)
+		:m_index0(index0),
+		m_index1(index1)
+	{
+	}
+
+	bool equals(const btCompoundChildPairKey& other) const
+	{
+		return m_index0 == other.m_index0 && m_index1 == other.m_index1;
+	}
+
+	SIMD_FORCE_INLINE unsigned int getHash() const
+	{
+		unsigned int key = (unsigned int)m_index0 * 0x9E3779B1u ^ (unsigned int)m_index1 * 0x85EBCA77u;
+		key ^= key >> 15;
+		return key;
+	}
+};
+
+///btCompoundChildPair is a cached pair of overlapping child shapes. m_timeStamp is the last frame in which their AABBs overlapped.
+struct btCompoundChildPair
+{
+	int		m_index0;
+	int		m_index1;
+	int		m_timeStamp;
+	btCollisionAlgorithm*	m_algorithm;
+};
+
+/// btCompoundCompoundCollisionAlgorithm supports collision between two btCompoundShape.
+/// The overlapping child pairs are found by traversing the two dynamic AABB trees of the compounds against each other (brute force when a compound has no tree).
+/// The child pairs and their collision algorithms are kept in a hash map across frames, a pair that stopped overlapping is only removed
+/// after gCompoundCompoundPairRemovalDelay frames, so large compounds resting on each other don't churn the child algorithms.
+class btCompoundCompoundCollisionAlgorithm  : public btActivatingCollisionAlgorithm
+{
+	btHashMap<btCompoundChildPairKey,btCompoundChildPair>	m_childPairs;
+
+	class btPersistentManifold*	m_sharedManifold;
+
+	int	m_compoundShapeRevision0;//to keep track of changes, so that the child pairs can be updated
+	int	m_compoundShapeRevision1;
+
+	int	m_timeStamp;
+
+	btAlignedObjectArray<btDbvt::sStkNN>	m_stack;
+
+	void	removeChildAlgorithms();
+
+	///remove the pairs that haven't overlapped during the last gCompoundCompoundPairRemovalDelay frames
+	void	removeStalePairs();
+
+public:
+
+	btCompoundCompoundCollisionAlgorithm( const btCollisionAlgorithmConstructionInfo& ci,const btCollisionObjectWrapper* body0Wrap,const btCollisionObjectWrapper* body1Wrap);
+
+	virtual ~btCompoundCompoundCollisionAlgorithm();
+
+	virtual void processCollision (const btCollisionObjectWrapper* body0Wrap,const btCollisionObjectWrapper* body1Wrap,const btDispatcherInfo& dispatchInfo,btManifoldResult* resultOut);
+
+	btScalar	calculateTimeOfImpact(btCollisionObject* body0,btCollisionObject* body1,const btDispatcherInfo& dispatchInfo,btManifoldResult* resultOut);
+
+	virtual	void	getAllContactManifolds(btManifoldArray&	manifoldArray)
+	{
+		for (int i=0;i<m_childPairs.size();i++)
+		{
+			btCollisionAlgorithm* algorithm = m_childPairs.getAtIndex(i)->m_algorithm;
+			if (algorithm)
+				algorithm->getAllContactManifolds(manifoldArray);
+		}
+	}
+
+	///the number of cached child pairs, including the pairs that are waiting for their removal
+	int		getNumChildPairs() const
+	{
+		return m_childPairs.size();
+	}
+
+	const btCompoundChildPair*	getChildPair(int i) const
+	{
+		return m_childPairs.getAtIndex(i);
+	}
+
+	struct CreateFunc :public 	btCollisionAlgorithmCreateFunc
+	{
+		virtual	btCollisionAlgorithm* CreateCollisionAlgorithm(btCollisionAlgorithmConstructionInfo& ci, const btCollisionObjectWrapper* body0Wrap,const btCollisionObjectWrapper* body1Wrap)
+		{
+			void* mem = ci.m_dispatcher1->allocateCollisionAlgorithm(sizeof(btCompoundCompoundCollisionAlgorithm));
+			return new(mem) btCompoundCompoundCollisionAlgorithm(ci,body0Wrap,body1Wrap);
+		}
+	};
+
+};
+
+#endif //BT_COMPOUND_COMPOUND_COLLISION_ALGORITHM_H
@@ -59,6 +59,8 @@ protected:
 	btStackAlloc*	m_stackAlloc;
 	bool	m_ownsStackAllocator;
 
+	btThreadStackAlloc*	m_threadStackAlloc;
+
 	btPoolAllocator*	m_persistentManifoldPool;
 	bool	m_ownsPersistentManifoldPool;
 
@@ -76,6 +78,7 @@ protected:
 	btCollisionAlgorithmCreateFunc*	m_swappedConvexConcaveCreateFunc;
 	btCollisionAlgorithmCreateFunc*	m_compoundCreateFunc;
 	btCollisionAlgorithmCreateFunc*	m_swappedCompoundCreateFunc;
+	btCollisionAlgorithmCreateFunc*	m_compoundCompoundCreateFunc;
 	btCollisionAlgorithmCreateFunc* m_emptyCreateFunc;
 	btCollisionAlgorithmCreateFunc* m_sphereSphereCF;
 	btCollisionAlgorithmCreateFunc* m_sphereBoxCF;
@@ -110,6 +113,11 @@ public:
 		return m_stackAlloc;
 	}
 
+	virtual btThreadStackAlloc*	getThreadStackAllocator()
+	{
+		return m_threadStackAlloc;
+	}
+
 	virtual	btVoronoiSimplexSolver*	getSimplexSolver()
 	{
 		return m_simplexSolver;
@@ -17,6 +17,8 @@ subject to the following restrictions:
 
 #include "BulletCollision/CollisionShapes/btBvhTriangleMeshShape.h"
 #include "BulletCollision/CollisionShapes/btOptimizedBvh.h"
+#include "BulletCollision/NarrowPhaseCollision/btRaycastCallback.h"
+#include "LinearMath/btAabbUtil2.h"
 #include "LinearMath/btSerializer.h"
 
 ///Bvh Concave triangle mesh is a static-triangle mesh shape with Bounding Volume Hierarchy optimization.
@@ -159,6 +161,91 @@ void	btBvhTriangleMeshShape::performRaycast (btTriangleCallback* callback, const
 	m_bvh->reportRayOverlappingNodex(&myNodeCallback,raySource,rayTarget);
 }
 
+void	btBvhTriangleMeshShape::performRaycastPacket (btTriangleRaycastCallback* const* callbacks, int numRays)
+{
+	struct	MyNodeOverlapCallback : public btRayPacketNodeOverlapCallback
+	{
+		btStridingMeshInterface*	m_meshInterface;
+		btTriangleRaycastCallback* const* m_callbacks;
+		btRayPacket&	m_packet;
+
+		MyNodeOverlapCallback(btTriangleRaycastCallback* const* callbacks,btStridingMeshInterface* meshInterface,btRayPacket& packet)
+			:m_meshInterface(meshInterface),
+			m_callbacks(callbacks),
+			m_packet(packet)
+		{
+		}
+				
+		virtual void processNode(int nodeSubPart, int nodeTriangleIndex, unsigned int rayMask)
+		{
+			btVector3 m_triangle[3];
+			const unsigned char *vertexbase;
+			int numverts;
+			PHY_ScalarType type;
+			int stride;
+			const unsigned char *indexbase;
+			int indexstride;
+			int numfaces;
+			PHY_ScalarType indicestype;
+
+			m_meshInterface->getLockedReadOnlyVertexIndexBase(
+				&vertexbase,
+				numverts,
+				type,
+				stride,
+				&indexbase,
+				indexstride,
+				numfaces,
+				indicestype,
+				nodeSubPart);
+
+			unsigned int* gfxbase = (unsigned int*)(indexbase+nodeTriangleIndex*indexstride);
+			btAssert(indicestype==PHY_INTEGER||indicestype==PHY_SHORT);
+	
+			const btVector3& meshScaling = m_meshInterface->getScaling();
+			for (int j=2;j>=0;j--)
+			{
+				int graphicsindex = indicestype==PHY_SHORT?((unsigned short*)gfxbase)[j]:gfxbase[j];
+				
+				if (type == PHY_FLOAT)
+				{
+					float* graphicsbase = (float*)(vertexbase+graphicsindex*stride);
+					
+					m_triangle[j] = btVector3(graphicsbase[0]*meshScaling.getX(),graphicsbase[1]*meshScaling.getY(),graphicsbase[2]*meshScaling.getZ());		
+				}
+				else
+				{
+					double* graphicsbase = (double*)(vertexbase+graphicsindex*stride);
+					
+					m_triangle[j] = btVector3(btScalar(graphicsbase[0])*meshScaling.getX(),btScalar(graphicsbase[1])*meshScaling.getY(),btScalar(graphicsbase[2])*meshScaling.getZ());		
+				}
+			}
+
+			/* Perform ray vs. triangle collision for each ray that reached the node, and stop the rays at their closest hit */
+			for (int i=0;i<BT_RAY_PACKET_SIZE;i++)
+			{
+				if (rayMask & (1u<<i))
+				{
+					m_callbacks[i]->processTriangle(m_triangle,nodeSubPart,nodeTriangleIndex);
+					m_packet.m_lambdaMax[i] = m_callbacks[i]->m_hitFraction;
+				}
+			}
+			m_meshInterface->unLockReadOnlyVertexBase(nodeSubPart);
+		}
+	};
+
+	btAssert(numRays<=BT_RAY_PACKET_SIZE);
+	btRayPacket packet;
+	for (int i=0;i<numRays;i++)
+	{
+		packet.setRay(i,callbacks[i]->m_from,callbacks[i]->m_to,callbacks[i]->m_hitFraction);
+	}
+
+	MyNodeOverlapCallback	myNodeCallback(callbacks,m_meshInterface,packet);
+
+	m_bvh->reportRayPacketOverlappingNodex(&myNodeCallback,packet);
+}
+
 void	btBvhTriangleMeshShape::performConvexcast (btTriangleCallback* callback, const btVector3& raySource, const btVector3& rayTarget, const btVector3& aabbMin, const btVector3& aabbMax)
 {
 	struct	MyNodeOverlapCallback : public btNodeOverlapCallback
@@ -338,6 +425,11 @@ void   btBvhTriangleMeshShape::setLocalScaling(const btVector3& scaling)
 }
 
 void   btBvhTriangleMeshShape::buildOptimizedBvh()
+{
+	buildOptimizedBvh(m_bvh ? m_bvh->getBuildMode() : btQuantizedBvh::BUILD_MEAN_SPLIT);
+}
+
+void   btBvhTriangleMeshShape::buildOptimizedBvh(btQuantizedBvh::btBuildMode buildMode)
 {
 	if (m_ownsBvh)
 	{
@@ -347,6 +439,7 @@ void   btBvhTriangleMeshShape::buildOptimizedBvh()
 	///m_localAabbMin/m_localAabbMax is already re-calculated in btTriangleMeshShape. We could just scale aabb, but this needs some more work
 	void* mem = btAlignedAlloc(sizeof(btOptimizedBvh),16);
 	m_bvh = new(mem) btOptimizedBvh();
+	m_bvh->setBuildMode(buildMode);
 	//rebuild the bvh...
 	m_bvh->build(m_meshInterface,m_useQuantizedAabbCompression,m_localAabbMin,m_localAabbMax);
 	m_ownsBvh = true;
@@ -21,6 +21,8 @@ subject to the following restrictions:
 #include "LinearMath/btAlignedAllocator.h"
 #include "btTriangleInfoMap.h"
 
+class btTriangleRaycastCallback;
+
 ///The btBvhTriangleMeshShape is a static-triangle mesh shape with several optimizations, such as bounding volume hierarchy and cache friendly traversal for PlayStation 3 Cell SPU. It is recommended to enable useQuantizedAabbCompression for better memory usage.
 ///It takes a triangle mesh as input, for example a btTriangleMesh or btTriangleIndexVertexArray. The btBvhTriangleMeshShape class allows for triangle mesh deformations by a refit or partialRefit method.
 ///Instead of building the bounding volume hierarchy acceleration structure, it is also possible to serialize (save) and deserialize (load) the structure from disk.
@@ -55,6 +57,9 @@ public:
 
 	
 	void performRaycast (btTriangleCallback* callback, const btVector3& raySource, const btVector3& rayTarget);
+	///performRaycastPacket is performRaycast for up to BT_RAY_PACKET_SIZE rays, using one walk of the bvh.
+	///The rays are the m_from and m_to of the callbacks, and each ray stops searching beyond the m_hitFraction of its callback.
+	void performRaycastPacket (btTriangleRaycastCallback* const* callbacks, int numRays);
 	void performConvexcast (btTriangleCallback* callback, const btVector3& boxSource, const btVector3& boxTarget, const btVector3& boxMin, const btVector3& boxMax);
 
 	virtual void	processAllTriangles(btTriangleCallback* callback,const btVector3& aabbMin,const btVector3& aabbMax) const;
@@ -77,8 +82,12 @@ public:
 
 	void	setOptimizedBvh(btOptimizedBvh* bvh, const btVector3& localScaling=btVector3(1,1,1));
 
+	///rebuild the bvh, using the build mode of the current bvh
 	void    buildOptimizedBvh();
 
+	///rebuild the bvh using the given build mode, see btQuantizedBvh::setBuildMode
+	void    buildOptimizedBvh(btQuantizedBvh::btBuildMode buildMode);
+
 	bool	usesQuantizedAabbCompression() const
 	{
 		return	m_useQuantizedAabbCompression;
@@ -24,6 +24,7 @@ m_localAabbMax(btScalar(-BT_LARGE_FLOAT),btScalar(-BT_LARGE_FLOAT),btScalar(-BT_
 m_dynamicAabbTree(0),
 m_updateRevision(1),
 m_collisionMargin(btScalar(0.)),
+m_pendingChildUpdates(0),
 m_localScaling(btScalar(1.),btScalar(1.),btScalar(1.))
 {
 	m_shapeType = COMPOUND_SHAPE_PROXYTYPE;
@@ -105,8 +106,154 @@ void	btCompoundShape::updateChildTransform(int childIndex, const btTransform& ne
 	}
 }
 
+void	btCompoundShape::updateChildTransforms(const int* childIndices, const btTransform* newChildTransforms, int numChildren)
+{
+	for (int i=0;i<numChildren;i++)
+	{
+		btAssert(childIndices[i]>=0 && childIndices[i]<m_children.size());
+		m_children[childIndices[i]].m_transform = newChildTransforms[i];
+		if (m_dynamicAabbTree)
+			m_dirtyChildren.push_back(childIndices[i]);
+	}
+	btAtomicStore(&m_pendingChildUpdates,1);
+}
+
+void	btCompoundShape::addChildShapes(const btTransform* localTransforms, btCollisionShape* const* shapes, int numShapes)
+{
+	m_updateRevision++;
+	m_children.reserve(m_children.size()+numShapes);
+	for (int i=0;i<numShapes;i++)
+	{
+		btCompoundShapeChild child;
+		child.m_node = 0;
+		child.m_transform = localTransforms[i];
+		child.m_childShape = shapes[i];
+		child.m_childShapeType = shapes[i]->getShapeType();
+		child.m_childMargin = shapes[i]->getMargin();
+		//the leaf is inserted by flushChildUpdates
+		if (m_dynamicAabbTree)
+			m_dirtyChildren.push_back(m_children.size());
+		m_children.push_back(child);
+	}
+	btAtomicStore(&m_pendingChildUpdates,1);
+}
+
+void	btCompoundShape::removeChildShapesByIndex(const int* childShapeIndices, int numIndices)
+{
+	//the pending updates refer to the current indices
+	flushChildUpdates();
+	m_updateRevision++;
+
+	int numChildren = m_children.size();
+	btAlignedObjectArray<int> removed;
+	removed.resize(numChildren);
+	int i;
+	for (i=0;i<numChildren;i++)
+		removed[i] = 0;
+	int numRemoved = 0;
+	for (i=0;i<numIndices;i++)
+	{
+		btAssert(childShapeIndices[i]>=0 && childShapeIndices[i]<numChildren);
+		numRemoved += removed[childShapeIndices[i]] ? 0 : 1;
+		removed[childShapeIndices[i]] = 1;
+	}
+
+	//when many children go, building a new tree from the remaining ones is cheaper than removing the leaves one by one
+	bool rebuildTree = m_dynamicAabbTree && numRemoved*4 > numChildren;
+	if (rebuildTree)
+	{
+		m_dynamicAabbTree->clear();
+	}
+
+	int numKept = 0;
+	for (i=0;i<numChildren;i++)
+	{
+		if (removed[i])
+		{
+			if (m_dynamicAabbTree && !rebuildTree)
+				m_dynamicAabbTree->remove(m_children[i].m_node);
+			continue;
+		}
+		m_children[numKept] = m_children[i];
+		if (rebuildTree)
+		{
+			m_children[numKept].m_node = 0;
+			m_dirtyChildren.push_back(numKept);
+		} else if (m_dynamicAabbTree)
+		{
+			m_children[numKept].m_node->dataAsInt = numKept;
+		}
+		numKept++;
+	}
+	m_children.resize(numKept);
+	btAtomicStore(&m_pendingChildUpdates,1);
+}
+
+///sort the dirty child indices, so that duplicates are next to each other
+struct btCompoundChildIndexLess
+{
+	bool operator() (int lhs, int rhs) const
+	{
+		return lhs < rhs;
+	}
+};
+
+void	btCompoundShape::flushChildUpdates()
+{
+	if (!btAtomicLoad(&m_pendingChildUpdates))
+		return;
+
+	//several threads can query the same shape, the first one does the update
+	btMutexLock(&m_childUpdateMutex);
+	if (btAtomicLoad(&m_pendingChildUpdates))
+	{
+		if (m_dynamicAabbTree && m_dirtyChildren.size())
+		{
+			m_dirtyChildren.quickSort(btCompoundChildIndexLess());
+			int numDirty = 0;
+			for (int i=0;i<m_dirtyChildren.size();i++)
+			{
+				if (!i || m_dirtyChildren[i]!=m_dirtyChildren[i-1])
+					m_dirtyChildren[numDirty++] = m_dirtyChildren[i];
+			}
+			m_dirtyChildren.resize(numDirty);
+
+			//set the leaf volumes and build the tree again, instead of refitting it for every leaf
+			bool rebuildTree = numDirty*4 > m_children.size();
+			for (int i=0;i<numDirty;i++)
+			{
+				int index = m_dirtyChildren[i];
+				btCompoundShapeChild& child = m_children[index];
+				btVector3 localAabbMin,localAabbMax;
+				child.m_childShape->getAabb(child.m_transform,localAabbMin,localAabbMax);
+				ATTRIBUTE_ALIGNED16(btDbvtVolume)	bounds=btDbvtVolume::FromMM(localAabbMin,localAabbMax);
+				if (!child.m_node)
+				{
+					child.m_node = m_dynamicAabbTree->insert(bounds,(void*)(size_t)index);
+				} else if (rebuildTree)
+				{
+					child.m_node->volume = bounds;
+				} else
+				{
+					m_dynamicAabbTree->update(child.m_node,bounds);
+				}
+			}
+			if (rebuildTree)
+			{
+				m_dynamicAabbTree->optimizeTopDown();
+			}
+		}
+		m_dirtyChildren.resize(0);
+		recalculateLocalAabb();
+		btAtomicStore(&m_pendingChildUpdates,0);
+	}
+	btMutexUnlock(&m_childUpdateMutex);
+}
+
 void btCompoundShape::removeChildShapeByIndex(int childShapeIndex)
 {
+	//the pending updates refer to the current indices
+	flushChildUpdates();
 	m_updateRevision++;
 	btAssert(childShapeIndex >=0 && childShapeIndex < m_children.size());
 	if (m_dynamicAabbTree)
@@ -166,6 +313,8 @@ void btCompoundShape::recalculateLocalAabb()
 ///getAabb's default implementation is brute force, expected derived classes to implement a fast dedicated version
 void btCompoundShape::getAabb(const btTransform& trans,btVector3& aabbMin,btVector3& aabbMax) const
 {
+	flushPendingChildUpdates();
+
 	btVector3 localHalfExtents = btScalar(0.5)*(m_localAabbMax-m_localAabbMin);
 	btVector3 localCenter = btScalar(0.5)*(m_localAabbMax+m_localAabbMin);
 	
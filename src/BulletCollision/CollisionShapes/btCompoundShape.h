@@ -23,6 +23,7 @@ subject to the following restrictions:
 #include "LinearMath/btMatrix3x3.h"
 #include "btCollisionMargin.h"
 #include "LinearMath/btAlignedObjectArray.h"
+#include "LinearMath/btThreads.h"
 
 //class btOptimizedBvh;
 struct btDbvt;
@@ -51,6 +52,8 @@ SIMD_FORCE_INLINE bool operator==(const btCompoundShapeChild& c1, const btCompou
 /// It has an (optional) dynamic aabb tree to accelerate early rejection tests. 
 /// @todo: This aabb tree can also be use to speed up ray tests on btCompoundShape, see http://code.google.com/p/bullet/issues/detail?id=25
 /// Currently, removal of child shapes is only supported when disabling the aabb tree (pass 'false' in the constructor of btCompoundShape)
+/// The batched updates (updateChildTransforms, addChildShapes, removeChildShapesByIndex) defer the local aabb and the dynamic aabb tree
+/// until the next getAabb/getDynamicAabbTree or flushChildUpdates, which updates them in a single pass.
 ATTRIBUTE_ALIGNED16(class) btCompoundShape	: public btCollisionShape
 {
 	btAlignedObjectArray<btCompoundShapeChild> m_children;
@@ -64,6 +67,19 @@ ATTRIBUTE_ALIGNED16(class) btCompoundShape	: public btCollisionShape
 
 	btScalar	m_collisionMargin;
 
+	//deferred updates of the batched API
+	volatile int					m_pendingChildUpdates;
+	btAlignedObjectArray<int>		m_dirtyChildren;
+	btSpinMutex						m_childUpdateMutex;
+
+	SIMD_FORCE_INLINE void	flushPendingChildUpdates() const
+	{
+		if (btAtomicLoad(&m_pendingChildUpdates))
+		{
+			const_cast<btCompoundShape*>(this)->flushChildUpdates();
+		}
+	}
+
 protected:
 	btVector3	m_localScaling;
 
@@ -81,6 +97,12 @@ public:
 
 	void removeChildShapeByIndex(int childShapeindex);
 
+	///add several children, the local aabb and the dynamic aabb tree are updated by the next query
+	void	addChildShapes(const btTransform* localTransforms, btCollisionShape* const* shapes, int numShapes);
+
+	///remove several children in one pass. Unlike removeChildShapeByIndex, the remaining children keep their order
+	void	removeChildShapesByIndex(const int* childShapeIndices, int numIndices);
+
 
 	int		getNumChildShapes() const
 	{
@@ -108,6 +130,18 @@ public:
 	///set a new transform for a child, and update internal data structures (local aabb and dynamic tree)
 	void	updateChildTransform(int childIndex, const btTransform& newChildTransform, bool shouldRecalculateLocalAabb = true);
 
+	///set new transforms for several children, the local aabb and the dynamic tree are updated by the next query
+	void	updateChildTransforms(const int* childIndices, const btTransform* newChildTransforms, int numChildren);
+
+	///apply the deferred updates of the batched API now. The queries call it, so usually there is no need to.
+	///When many children changed the dynamic aabb tree is rebuilt instead of updating the leaves one by one.
+	void	flushChildUpdates();
+
+	bool	hasPendingChildUpdates() const
+	{
+		return btAtomicLoad(&m_pendingChildUpdates) != 0;
+	}
+
 
 	btCompoundShapeChild* getChildList()
 	{
@@ -145,11 +179,13 @@ public:
 
 	const btDbvt*	getDynamicAabbTree() const
 	{
+		flushPendingChildUpdates();
 		return m_dynamicAabbTree;
 	}
 	
 	btDbvt*	getDynamicAabbTree()
 	{
+		flushPendingChildUpdates();
 		return m_dynamicAabbTree;
 	}
 
@@ -26,6 +26,7 @@ btScalar heightScale, btScalar minHeight, btScalar maxHeight,int upAxis,
 PHY_ScalarType hdt, bool flipQuadEdges
 )
 {
+	btAssert(heightfieldData && "null heightfield data");
 	initialize(heightStickWidth, heightStickLength, heightfieldData,
 	           heightScale, minHeight, maxHeight, upAxis, hdt,
 	           flipQuadEdges);
@@ -44,6 +45,7 @@ btHeightfieldTerrainShape::btHeightfieldTerrainShape(int heightStickWidth, int h
 	// So to preserve legacy behavior, heightScale = maxHeight / 65535
 	btScalar heightScale = maxHeight / 65535;
 
+	btAssert(heightfieldData && "null heightfield data");
 	initialize(heightStickWidth, heightStickLength, heightfieldData,
 	           heightScale, minHeight, maxHeight, upAxis, hdt,
 	           flipQuadEdges);
@@ -51,6 +53,16 @@ btHeightfieldTerrainShape::btHeightfieldTerrainShape(int heightStickWidth, int h
 
 
 
+btHeightfieldTerrainShape::btHeightfieldTerrainShape(int heightStickWidth, int heightStickLength,btScalar minHeight,btScalar maxHeight,int upAxis,bool flipQuadEdges)
+{
+	// the derived shape overrides getRawHeightFieldValue
+	initialize(heightStickWidth, heightStickLength, 0,
+	           btScalar(1.), minHeight, maxHeight, upAxis, PHY_FLOAT,
+	           flipQuadEdges);
+}
+
+
+
 void btHeightfieldTerrainShape::initialize
 (
 int heightStickWidth, int heightStickLength, const void* heightfieldData,
@@ -61,7 +73,6 @@ PHY_ScalarType hdt, bool flipQuadEdges
 	// validation
 	btAssert(heightStickWidth > 1 && "bad width");
 	btAssert(heightStickLength > 1 && "bad length");
-	btAssert(heightfieldData && "null heightfield data");
 	// btAssert(heightScale) -- do we care?  Trust caller here
 	btAssert(minHeight <= maxHeight && "bad min/max height");
 	btAssert(upAxis >= 0 && upAxis < 3 &&
@@ -193,8 +204,13 @@ void	btHeightfieldTerrainShape::getVertex(int x,int y,btVector3& vertex) const
 	btAssert(x<m_heightStickWidth);
 	btAssert(y<m_heightStickLength);
 
-	btScalar	height = getRawHeightFieldValue(x,y);
+	getVertex(x,y,getRawHeightFieldValue(x,y),vertex);
+}
+
 
+
+void	btHeightfieldTerrainShape::getVertex(int x,int y,btScalar height,btVector3& vertex) const
+{
 	switch (m_upAxis)
 	{
 	case 0:
@@ -360,32 +376,8 @@ void	btHeightfieldTerrainShape::processAllTriangles(btTriangleCallback* callback
 	{
 		for(int x=startX; x<endX; x++)
 		{
-			btVector3 vertices[3];
-			if (m_flipQuadEdges || (m_useDiamondSubdivision && !((j+x) & 1))|| (m_useZigzagSubdivision  && !(j & 1)))
-			{
-        //first triangle
-        getVertex(x,j,vertices[0]);
-        getVertex(x+1,j,vertices[1]);
-        getVertex(x+1,j+1,vertices[2]);
-        callback->processTriangle(vertices,x,j);
-        //second triangle
-        getVertex(x,j,vertices[0]);
-        getVertex(x+1,j+1,vertices[1]);
-        getVertex(x,j+1,vertices[2]);
-        callback->processTriangle(vertices,x,j);				
-			} else
-			{
-        //first triangle
-        getVertex(x,j,vertices[0]);
-        getVertex(x,j+1,vertices[1]);
-        getVertex(x+1,j,vertices[2]);
-        callback->processTriangle(vertices,x,j);
-        //second triangle
-        getVertex(x+1,j,vertices[0]);
-        getVertex(x,j+1,vertices[1]);
-        getVertex(x+1,j+1,vertices[2]);
-        callback->processTriangle(vertices,x,j);
-			}
+			processQuad(callback,x,j,getRawHeightFieldValue(x,j),getRawHeightFieldValue(x+1,j),
+				getRawHeightFieldValue(x,j+1),getRawHeightFieldValue(x+1,j+1));
 		}
 	}
 
@@ -393,6 +385,250 @@ void	btHeightfieldTerrainShape::processAllTriangles(btTriangleCallback* callback
 
 }
 
+
+
+void	btHeightfieldTerrainShape::processQuad(btTriangleCallback* callback,int x,int j,btScalar h00,btScalar h10,btScalar h01,btScalar h11) const
+{
+	btVector3 vertices[3];
+	if (m_flipQuadEdges || (m_useDiamondSubdivision && !((j+x) & 1))|| (m_useZigzagSubdivision  && !(j & 1)))
+	{
+		//first triangle
+		getVertex(x,j,h00,vertices[0]);
+		getVertex(x+1,j,h10,vertices[1]);
+		getVertex(x+1,j+1,h11,vertices[2]);
+		callback->processTriangle(vertices,x,j);
+		//second triangle
+		getVertex(x,j,h00,vertices[0]);
+		getVertex(x+1,j+1,h11,vertices[1]);
+		getVertex(x,j+1,h01,vertices[2]);
+		callback->processTriangle(vertices,x,j);
+	} else
+	{
+		//first triangle
+		getVertex(x,j,h00,vertices[0]);
+		getVertex(x,j+1,h01,vertices[1]);
+		getVertex(x+1,j,h10,vertices[2]);
+		callback->processTriangle(vertices,x,j);
+		//second triangle
+		getVertex(x+1,j,h10,vertices[0]);
+		getVertex(x,j+1,h01,vertices[1]);
+		getVertex(x+1,j+1,h11,vertices[2]);
+		callback->processTriangle(vertices,x,j);
+	}
+}
+
+void	btHeightfieldTerrainShape::getGridPoint(const btVector3& localPoint,btScalar gridPoint[3]) const
+{
+	int axisX,axisJ;
+	getGridAxes(axisX,axisJ);
+	btVector3 point = localPoint/m_localScaling+m_localOrigin;
+	gridPoint[0] = point[axisX];
+	gridPoint[1] = point[axisJ];
+	gridPoint[2] = point[m_upAxis];
+}
+
+
+
+bool	btHeightfieldTerrainShape::clipRay(const btScalar from[3],const btScalar dir[3],const btScalar boxMin[3],const btScalar boxMax[3],btScalar& tMin,btScalar& tMax)
+{
+	for (int i=0;i<3;i++)
+	{
+		if (dir[i] == btScalar(0.))
+		{
+			if (from[i] < boxMin[i] || from[i] > boxMax[i])
+				return false;
+			continue;
+		}
+		btScalar invDir = btScalar(1.)/dir[i];
+		btScalar t0 = (boxMin[i]-from[i])*invDir;
+		btScalar t1 = (boxMax[i]-from[i])*invDir;
+		if (t0 > t1)
+			btSwap(t0,t1);
+		tMin = btMax(tMin,t0);
+		tMax = btMin(tMax,t1);
+		if (tMin > tMax)
+			return false;
+	}
+	return true;
+}
+
+
+
+/// walk the cells along the ray
+/**
+  basic algorithm:
+    - convert the ray to grid space (x and j in cells, raw height) and clip it to the heightfield box
+    - step from cell to cell at the next x or j grid line the ray crosses (Amanatides-Woo DDA)
+    - skip the cells whose height range is out of the height range of the ray inside the cell
+ */
+void	btHeightfieldTerrainShape::performRaycast(btTriangleCallback* callback,const btVector3& raySource,const btVector3& rayTarget,const btScalar* closestHitFraction) const
+{
+	btScalar from[3],to[3],dir[3];
+	getGridPoint(raySource,from);
+	getGridPoint(rayTarget,to);
+	for (int i=0;i<3;i++)
+		dir[i] = to[i]-from[i];
+
+	btScalar tMin = btScalar(0.);
+	btScalar tMax = btScalar(1.);
+	btScalar boxMin[3] = {btScalar(0.),btScalar(0.),m_minHeight};
+	btScalar boxMax[3] = {m_width,m_length,m_maxHeight};
+	if (!clipRay(from,dir,boxMin,boxMax,tMin,tMax))
+		return;
+
+	//tolerance for the height test of a cell
+	btScalar heightTolerance = (m_maxHeight-m_minHeight)*btScalar(1e-5)+SIMD_EPSILON;
+
+	int x = btMax(0,btMin(int(from[0]+dir[0]*tMin),m_heightStickWidth-2));
+	int j = btMax(0,btMin(int(from[1]+dir[1]*tMin),m_heightStickLength-2));
+	int stepX = dir[0] > btScalar(0.) ? 1 : -1;
+	int stepJ = dir[1] > btScalar(0.) ? 1 : -1;
+	btScalar nextX = SIMD_INFINITY;
+	btScalar nextJ = SIMD_INFINITY;
+	btScalar deltaX = SIMD_INFINITY;
+	btScalar deltaJ = SIMD_INFINITY;
+	if (dir[0] != btScalar(0.))
+	{
+		nextX = (btScalar(x+(stepX > 0 ? 1 : 0))-from[0])/dir[0];
+		deltaX = btScalar(1.)/btFabs(dir[0]);
+	}
+	if (dir[1] != btScalar(0.))
+	{
+		nextJ = (btScalar(j+(stepJ > 0 ? 1 : 0))-from[1])/dir[1];
+		deltaJ = btScalar(1.)/btFabs(dir[1]);
+	}
+
+	btScalar tEnter = tMin;
+	for (;;)
+	{
+		btScalar tExit = btMin(btMin(nextX,nextJ),tMax);
+
+		btScalar h00 = getRawHeightFieldValue(x,j);
+		btScalar h10 = getRawHeightFieldValue(x+1,j);
+		btScalar h01 = getRawHeightFieldValue(x,j+1);
+		btScalar h11 = getRawHeightFieldValue(x+1,j+1);
+		btScalar rayHeightEnter = from[2]+dir[2]*tEnter;
+		btScalar rayHeightExit = from[2]+dir[2]*tExit;
+		btScalar rayMinHeight = btMin(rayHeightEnter,rayHeightExit)-heightTolerance;
+		btScalar rayMaxHeight = btMax(rayHeightEnter,rayHeightExit)+heightTolerance;
+		if (rayMaxHeight >= btMin(btMin(h00,h10),btMin(h01,h11)) && rayMinHeight <= btMax(btMax(h00,h10),btMax(h01,h11)))
+		{
+			processQuad(callback,x,j,h00,h10,h01,h11);
+		}
+
+		if (tExit >= tMax)
+			break;
+		//the remaining cells are beyond the closest hit
+		if (closestHitFraction && *closestHitFraction < tExit)
+			break;
+
+		if (nextX < nextJ)
+		{
+			x += stepX;
+			nextX += deltaX;
+		} else
+		{
+			j += stepJ;
+			nextJ += deltaJ;
+		}
+		if (x < 0 || x >= m_heightStickWidth-1 || j < 0 || j >= m_heightStickLength-1)
+			break;
+		tEnter = tExit;
+	}
+}
+
+
+
+static inline int btFloorToInt(btScalar x)
+{
+	int i = int(x);
+	return btScalar(i) > x ? i-1 : i;
+}
+
+
+
+/// process the cells touched by a moving box
+/**
+  The rows of cells that the box touches are visited one by one. For each row, the time interval in which the box overlaps the row gives
+  the range of cells in the row, and for each cell, the time interval in which the box overlaps the cell gives the height range
+  of the box to test against the heights of the cell.
+ */
+void	btHeightfieldTerrainShape::performConvexcast(btTriangleCallback* callback,const btVector3& boxSource,const btVector3& boxTarget,const btVector3& boxMin,const btVector3& boxMax) const
+{
+	btScalar from[3],to[3],dir[3];
+	getGridPoint(boxSource,from);
+	getGridPoint(boxTarget,to);
+	for (int i=0;i<3;i++)
+		dir[i] = to[i]-from[i];
+
+	//box extents relative to its center in grid space, including the margin of the triangles
+	int axisX,axisJ;
+	getGridAxes(axisX,axisJ);
+	int axes[3] = {axisX,axisJ,m_upAxis};
+	btScalar extentMin[3],extentMax[3];
+	for (int i=0;i<3;i++)
+	{
+		btScalar e0 = (boxMin[axes[i]]-getMargin())/m_localScaling[axes[i]];
+		btScalar e1 = (boxMax[axes[i]]+getMargin())/m_localScaling[axes[i]];
+		extentMin[i] = btMin(e0,e1);
+		extentMax[i] = btMax(e0,e1);
+	}
+
+	btScalar tMin = btScalar(0.);
+	btScalar tMax = btScalar(1.);
+	btScalar clipMin[3] = {-extentMax[0],-extentMax[1],m_minHeight-extentMax[2]};
+	btScalar clipMax[3] = {m_width-extentMin[0],m_length-extentMin[1],m_maxHeight-extentMin[2]};
+	if (!clipRay(from,dir,clipMin,clipMax,tMin,tMax))
+		return;
+
+	btScalar startJ = from[1]+dir[1]*tMin;
+	btScalar endJ = from[1]+dir[1]*tMax;
+	int firstRow = btMax(0,btFloorToInt(btMin(startJ,endJ)+extentMin[1]));
+	int lastRow = btMin(m_heightStickLength-2,btFloorToInt(btMax(startJ,endJ)+extentMax[1]));
+
+	for (int j=firstRow;j<=lastRow;j++)
+	{
+		//the time interval in which the box overlaps the row
+		btScalar rowMin[3] = {-SIMD_INFINITY,btScalar(j)-extentMax[1],-SIMD_INFINITY};
+		btScalar rowMax[3] = {SIMD_INFINITY,btScalar(j+1)-extentMin[1],SIMD_INFINITY};
+		btScalar rowTMin = tMin;
+		btScalar rowTMax = tMax;
+		if (!clipRay(from,dir,rowMin,rowMax,rowTMin,rowTMax))
+			continue;
+
+		btScalar rowStartX = from[0]+dir[0]*rowTMin;
+		btScalar rowEndX = from[0]+dir[0]*rowTMax;
+		int firstX = btMax(0,btFloorToInt(btMin(rowStartX,rowEndX)+extentMin[0]));
+		int lastX = btMin(m_heightStickWidth-2,btFloorToInt(btMax(rowStartX,rowEndX)+extentMax[0]));
+
+		for (int x=firstX;x<=lastX;x++)
+		{
+			//the height range of the box while it overlaps the cell
+			btScalar cellMin[3] = {btScalar(x)-extentMax[0],-SIMD_INFINITY,-SIMD_INFINITY};
+			btScalar cellMax[3] = {btScalar(x+1)-extentMin[0],SIMD_INFINITY,SIMD_INFINITY};
+			btScalar cellTMin = rowTMin;
+			btScalar cellTMax = rowTMax;
+			if (!clipRay(from,dir,cellMin,cellMax,cellTMin,cellTMax))
+				continue;
+
+			btScalar h00 = getRawHeightFieldValue(x,j);
+			btScalar h10 = getRawHeightFieldValue(x+1,j);
+			btScalar h01 = getRawHeightFieldValue(x,j+1);
+			btScalar h11 = getRawHeightFieldValue(x+1,j+1);
+			btScalar heightEnter = from[2]+dir[2]*cellTMin;
+			btScalar heightExit = from[2]+dir[2]*cellTMax;
+			btScalar boxMinHeight = btMin(heightEnter,heightExit)+extentMin[2];
+			btScalar boxMaxHeight = btMax(heightEnter,heightExit)+extentMax[2];
+			if (boxMaxHeight >= btMin(btMin(h00,h10),btMin(h01,h11)) && boxMinHeight <= btMax(btMax(h00,h10),btMax(h01,h11)))
+			{
+				processQuad(callback,x,j,h00,h10,h01,h11);
+			}
+		}
+	}
+}
+
+
+
 void	btHeightfieldTerrainShape::calculateLocalInertia(btScalar ,btVector3& inertia) const
 {
 	//moving concave objects not supported
@@ -103,6 +103,24 @@ protected:
 	virtual btScalar	getRawHeightFieldValue(int x,int y) const;
 	void		quantizeWithClamp(int* out, const btVector3& point,int isMax) const;
 	void		getVertex(int x,int y,btVector3& vertex) const;
+	///the vertex at grid point (x,y) for the given raw height
+	void		getVertex(int x,int y,btScalar rawHeight,btVector3& vertex) const;
+
+	///report the two triangles of the grid cell (x,j), given the raw heights at (x,j), (x+1,j), (x,j+1) and (x+1,j+1)
+	void		processQuad(btTriangleCallback* callback,int x,int j,btScalar h00,btScalar h10,btScalar h01,btScalar h11) const;
+
+	///the local axes along the x and j grid directions, the third one is m_upAxis
+	void		getGridAxes(int& axisX,int& axisJ) const
+	{
+		axisX = m_upAxis == 0 ? 1 : 0;
+		axisJ = m_upAxis == 2 ? 1 : 2;
+	}
+
+	///convert a point in local space to grid space: x and j in cells, and the raw height
+	void		getGridPoint(const btVector3& localPoint,btScalar gridPoint[3]) const;
+
+	///slab test of the ray from + t*dir against a box, tMin and tMax are narrowed to the overlap
+	static bool	clipRay(const btScalar from[3],const btScalar dir[3],const btScalar boxMin[3],const btScalar boxMax[3],btScalar& tMin,btScalar& tMax);
 
 
 
@@ -116,6 +134,11 @@ protected:
 	                btScalar minHeight, btScalar maxHeight, int upAxis,
 	                PHY_ScalarType heightDataType, bool flipQuadEdges);
 
+	///constructor for derived shapes that provide the heights by overriding getRawHeightFieldValue, there is no heightfield array
+	btHeightfieldTerrainShape(int heightStickWidth,int heightStickLength,
+	                          btScalar minHeight, btScalar maxHeight,
+	                          int upAxis, bool flipQuadEdges);
+
 public:
 	
 	BT_DECLARE_ALIGNED_ALLOCATOR();
@@ -153,6 +176,14 @@ public:
 
 	virtual void	processAllTriangles(btTriangleCallback* callback,const btVector3& aabbMin,const btVector3& aabbMax) const;
 
+	///report the triangles of the cells along the ray from raySource to rayTarget (in local space), in the order the ray crosses them (grid DDA).
+	///Cells whose heights are out of the height range of the ray inside the cell are skipped. If closestHitFraction is given,
+	///for example the m_hitFraction of a btTriangleRaycastCallback, the traversal stops at the first cell beyond it.
+	virtual void	performRaycast(btTriangleCallback* callback,const btVector3& raySource,const btVector3& rayTarget,const btScalar* closestHitFraction=0) const;
+
+	///report the triangles of the cells that a box from boxMin to boxMax touches while it moves from boxSource to boxTarget
+	virtual void	performConvexcast(btTriangleCallback* callback,const btVector3& boxSource,const btVector3& boxTarget,const btVector3& boxMin,const btVector3& boxMax) const;
+
 	virtual void	calculateLocalInertia(btScalar mass,btVector3& inertia) const;
 
 	virtual void	setLocalScaling(const btVector3& scaling);
@@ -0,0 +1,552 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btTiledHeightfieldTerrainShape.h"
+
+///a box query, or a ray or moving box in grid space: x and j along the grid axes in cells, and the raw height
+struct btTiledHeightfieldTerrainShape::btHeightfieldQuery
+{
+	btTriangleCallback*	m_callback;
+	bool		m_isRay;
+
+	//box query, cells startX <= x < endX and startJ <= j < endJ
+	int			m_startX;
+	int			m_endX;
+	int			m_startJ;
+	int			m_endJ;
+	btScalar	m_minHeight;
+	btScalar	m_maxHeight;
+
+	//ray from + t*dir, tMin <= t <= tMax, with a box from extentMin to extentMax around it for a convex cast
+	btScalar	m_from[3];
+	btScalar	m_dir[3];
+	btScalar	m_tMin;
+	btScalar	m_tMax;
+	btScalar	m_extentMin[3];
+	btScalar	m_extentMax[3];
+
+	///does the query overlap the cells x0 <= x < x1, j0 <= j < j1 with heights from minHeight to maxHeight
+	bool	overlaps(int x0, int x1, int j0, int j1, btScalar minHeight, btScalar maxHeight) const
+	{
+		if (!m_isRay)
+		{
+			return x0 < m_endX && x1 > m_startX && j0 < m_endJ && j1 > m_startJ &&
+				maxHeight >= m_minHeight && minHeight <= m_maxHeight;
+		}
+		btScalar boxMin[3] = {btScalar(x0)-m_extentMax[0],btScalar(j0)-m_extentMax[1],minHeight-m_extentMax[2]};
+		btScalar boxMax[3] = {btScalar(x1)-m_extentMin[0],btScalar(j1)-m_extentMin[1],maxHeight-m_extentMin[2]};
+		btScalar tMin = m_tMin;
+		btScalar tMax = m_tMax;
+		return btHeightfieldTerrainShape::clipRay(m_from,m_dir,boxMin,boxMax,tMin,tMax);
+	}
+};
+
+btTiledHeightfieldTerrainShape::btTiledHeightfieldTerrainShape(int heightStickWidth, int heightStickLength, int tileSize,
+															   btHeightfieldTileProvider* tileProvider,
+															   btScalar minHeight, btScalar maxHeight,
+															   int upAxis, bool flipQuadEdges)
+:btHeightfieldTerrainShape(heightStickWidth,heightStickLength,minHeight,maxHeight,upAxis,flipQuadEdges),
+m_tileProvider(tileProvider),
+m_tileSize(tileSize),
+m_maxResidentTiles(64),
+m_useCounter(0)
+{
+	btAssert(tileProvider);
+	btAssert(tileSize >= BT_HEIGHTFIELD_LEAF_BLOCK_SIZE && (tileSize & (tileSize-1)) == 0 && "tile size should be a power of two");
+
+	m_numTilesX = (heightStickWidth-1+tileSize-1)/tileSize;
+	m_numTilesY = (heightStickLength-1+tileSize-1)/tileSize;
+	m_tiles.resize(m_numTilesX*m_numTilesY,0);
+
+	int offset = 0;
+	for (int blocks = tileSize/BT_HEIGHTFIELD_LEAF_BLOCK_SIZE;blocks>0;blocks>>=1)
+	{
+		m_levelOffsets.push_back(offset);
+		offset += 2*blocks*blocks;
+	}
+	m_levelOffsets.push_back(offset);
+}
+
+btTiledHeightfieldTerrainShape::~btTiledHeightfieldTerrainShape()
+{
+	int i;
+	for (i=0;i<m_residentTiles.size();i++)
+	{
+		btAssert(m_residentTiles[i]->m_pinCount == 0);
+		delete m_residentTiles[i];
+	}
+	for (i=0;i<m_freeTiles.size();i++)
+	{
+		delete m_freeTiles[i];
+	}
+}
+
+void	btTiledHeightfieldTerrainShape::buildBlockMinMax(btHeightfieldTile* tile) const
+{
+	tile->m_blockMinMax.resize(m_levelOffsets[m_levelOffsets.size()-1]);
+
+	//leaf blocks, including the points on their border
+	int numBlocks = m_tileSize/BT_HEIGHTFIELD_LEAF_BLOCK_SIZE;
+	btScalar* minMax = &tile->m_blockMinMax[0];
+	for (int by=0;by<numBlocks;by++)
+	{
+		for (int bx=0;bx<numBlocks;bx++)
+		{
+			btScalar minHeight = getTileHeight(tile,bx*BT_HEIGHTFIELD_LEAF_BLOCK_SIZE,by*BT_HEIGHTFIELD_LEAF_BLOCK_SIZE);
+			btScalar maxHeight = minHeight;
+			for (int y=by*BT_HEIGHTFIELD_LEAF_BLOCK_SIZE;y<=(by+1)*BT_HEIGHTFIELD_LEAF_BLOCK_SIZE;y++)
+			{
+				for (int x=bx*BT_HEIGHTFIELD_LEAF_BLOCK_SIZE;x<=(bx+1)*BT_HEIGHTFIELD_LEAF_BLOCK_SIZE;x++)
+				{
+					btScalar height = getTileHeight(tile,x,y);
+					minHeight = btMin(minHeight,height);
+					maxHeight = btMax(maxHeight,height);
+				}
+			}
+			minMax[2*(by*numBlocks+bx)] = minHeight;
+			minMax[2*(by*numBlocks+bx)+1] = maxHeight;
+		}
+	}
+
+	//the parents merge their 4 children
+	for (int level=1;level<m_levelOffsets.size()-1;level++)
+	{
+		const btScalar* childMinMax = &tile->m_blockMinMax[m_levelOffsets[level-1]];
+		int numChildBlocks = numBlocks;
+		numBlocks >>= 1;
+		minMax = &tile->m_blockMinMax[m_levelOffsets[level]];
+		for (int by=0;by<numBlocks;by++)
+		{
+			for (int bx=0;bx<numBlocks;bx++)
+			{
+				const btScalar* c00 = &childMinMax[2*((2*by)*numChildBlocks+2*bx)];
+				const btScalar* c10 = c00+2;
+				const btScalar* c01 = c00+2*numChildBlocks;
+				const btScalar* c11 = c01+2;
+				minMax[2*(by*numBlocks+bx)] = btMin(btMin(c00[0],c10[0]),btMin(c01[0],c11[0]));
+				minMax[2*(by*numBlocks+bx)+1] = btMax(btMax(c00[1],c10[1]),btMax(c01[1],c11[1]));
+			}
+		}
+	}
+}
+
+btTiledHeightfieldTerrainShape::btHeightfieldTile*	btTiledHeightfieldTerrainShape::acquireTile(int tileX, int tileY) const
+{
+	int tileIndex = tileY*m_numTilesX+tileX;
+	btAlignedObjectArray<int> evictedTiles;
+
+	btMutexLock(&m_tileMutex);
+	btHeightfieldTile* tile = m_tiles[tileIndex];
+	if (tile)
+	{
+		tile->m_pinCount++;
+		tile->m_lastUsed = ++m_useCounter;
+		btMutexUnlock(&m_tileMutex);
+
+		//another thread may still be loading it
+		while (btAtomicLoad(&tile->m_state) == TILE_LOADING)
+		{
+			btSpinPause();
+		}
+	}
+	else
+	{
+		//drop the least recently used tiles that are not in use
+		while (m_residentTiles.size() >= m_maxResidentTiles)
+		{
+			int lru = -1;
+			for (int i=0;i<m_residentTiles.size();i++)
+			{
+				if (m_residentTiles[i]->m_pinCount == 0 && (lru < 0 || m_residentTiles[i]->m_lastUsed < m_residentTiles[lru]->m_lastUsed))
+					lru = i;
+			}
+			if (lru < 0)
+				break;
+			btHeightfieldTile* evicted = m_residentTiles[lru];
+			evictedTiles.push_back(evicted->m_tileIndex);
+			removeResidentTile(evicted);
+		}
+
+		if (m_freeTiles.size())
+		{
+			tile = m_freeTiles[m_freeTiles.size()-1];
+			m_freeTiles.pop_back();
+		} else
+		{
+			tile = new btHeightfieldTile();
+		}
+		tile->m_tileIndex = tileIndex;
+		tile->m_pinCount = 1;
+		tile->m_lastUsed = ++m_useCounter;
+		btAtomicStore(&tile->m_state,TILE_LOADING);
+		m_tiles[tileIndex] = tile;
+		m_residentTiles.push_back(tile);
+		btMutexUnlock(&m_tileMutex);
+
+		//load outside of the lock, other threads wait only for this tile
+		for (int i=0;i<evictedTiles.size();i++)
+		{
+			m_tileProvider->tileEvicted(evictedTiles[i]%m_numTilesX,evictedTiles[i]/m_numTilesX);
+		}
+		tile->m_heights.resize((m_tileSize+1)*(m_tileSize+1));
+		for (int i=0;i<tile->m_heights.size();i++)
+		{
+			tile->m_heights[i] = m_minHeight;
+		}
+		bool loaded = m_tileProvider->loadTile(tileX,tileY,m_tileSize,&tile->m_heights[0]);
+		if (loaded)
+		{
+			buildBlockMinMax(tile);
+		}
+		btAtomicStore(&tile->m_state,loaded ? TILE_LOADED : TILE_MISSING);
+	}
+
+	if (btAtomicLoad(&tile->m_state) == TILE_MISSING)
+	{
+		releaseTile(tile);
+		return 0;
+	}
+	return tile;
+}
+
+void	btTiledHeightfieldTerrainShape::releaseTile(btHeightfieldTile* tile) const
+{
+	int evictedTile = -1;
+
+	btMutexLock(&m_tileMutex);
+	btAssert(tile->m_pinCount > 0);
+	tile->m_pinCount--;
+	//a missing tile is not cached, so the provider is asked again once it can deliver the tile
+	if (tile->m_pinCount == 0 && btAtomicLoad(&tile->m_state) == TILE_MISSING)
+	{
+		evictedTile = tile->m_tileIndex;
+		removeResidentTile(tile);
+	}
+	btMutexUnlock(&m_tileMutex);
+
+	if (evictedTile >= 0)
+	{
+		m_tileProvider->tileEvicted(evictedTile%m_numTilesX,evictedTile/m_numTilesX);
+	}
+}
+
+void	btTiledHeightfieldTerrainShape::removeResidentTile(btHeightfieldTile* tile) const
+{
+	btAssert(tile->m_pinCount == 0);
+	int index = m_residentTiles.findLinearSearch(tile);
+	btAssert(index < m_residentTiles.size());
+	m_residentTiles.swap(index,m_residentTiles.size()-1);
+	m_residentTiles.pop_back();
+	m_tiles[tile->m_tileIndex] = 0;
+	m_freeTiles.push_back(tile);
+}
+
+int		btTiledHeightfieldTerrainShape::getNumResidentTiles() const
+{
+	btMutexLock(&m_tileMutex);
+	int numResidentTiles = m_residentTiles.size();
+	btMutexUnlock(&m_tileMutex);
+	return numResidentTiles;
+}
+
+void	btTiledHeightfieldTerrainShape::evictAllTiles()
+{
+	btAlignedObjectArray<int> evictedTiles;
+
+	btMutexLock(&m_tileMutex);
+	for (int i=m_residentTiles.size()-1;i>=0;i--)
+	{
+		btHeightfieldTile* tile = m_residentTiles[i];
+		if (tile->m_pinCount == 0)
+		{
+			m_tiles[tile->m_tileIndex] = 0;
+			evictedTiles.push_back(tile->m_tileIndex);
+			m_residentTiles.swap(i,m_residentTiles.size()-1);
+			m_residentTiles.pop_back();
+			delete tile;
+		}
+	}
+	for (int i=0;i<m_freeTiles.size();i++)
+	{
+		delete m_freeTiles[i];
+	}
+	m_freeTiles.clear();
+	btMutexUnlock(&m_tileMutex);
+
+	for (int i=0;i<evictedTiles.size();i++)
+	{
+		m_tileProvider->tileEvicted(evictedTiles[i]%m_numTilesX,evictedTiles[i]/m_numTilesX);
+	}
+}
+
+void	btTiledHeightfieldTerrainShape::getTileHeightRange(int tileX, int tileY, btScalar& minHeight, btScalar& maxHeight) const
+{
+	if (!m_tileProvider->getTileHeightRange(tileX,tileY,minHeight,maxHeight))
+	{
+		minHeight = m_minHeight;
+		maxHeight = m_maxHeight;
+	}
+}
+
+btScalar	btTiledHeightfieldTerrainShape::getRawHeightFieldValue(int x,int y) const
+{
+	int tileX = btMin(x/m_tileSize,m_numTilesX-1);
+	int tileY = btMin(y/m_tileSize,m_numTilesY-1);
+
+	//the traversal reads the heights of the tile it pinned in processTileRange, this is only used for single vertices (getVertex).
+	//A loaded tile can't be evicted or refilled while the mutex is held, so a resident tile is read with one lock and no pin.
+	btMutexLock(&m_tileMutex);
+	const btHeightfieldTile* resident = m_tiles[tileY*m_numTilesX+tileX];
+	if (resident && btAtomicLoad(&resident->m_state) == TILE_LOADED)
+	{
+		btScalar height = getTileHeight(resident,x-tileX*m_tileSize,y-tileY*m_tileSize);
+		btMutexUnlock(&m_tileMutex);
+		return height;
+	}
+	btMutexUnlock(&m_tileMutex);
+
+	btHeightfieldTile* tile = acquireTile(tileX,tileY);
+	//the cells of a tile that can't be loaded are holes, its vertices are at the bottom of the height range like its filled heights
+	if (!tile)
+		return m_minHeight;
+	btScalar height = getTileHeight(tile,x-tileX*m_tileSize,y-tileY*m_tileSize);
+	releaseTile(tile);
+	return height;
+}
+
+void	btTiledHeightfieldTerrainShape::processBlock(const btHeightfieldTile* tile, int tileX, int tileY, int level, int blockX, int blockY, const btHeightfieldQuery& query) const
+{
+	int blockSize = BT_HEIGHTFIELD_LEAF_BLOCK_SIZE<<level;
+	int localX0 = blockX*blockSize;
+	int localY0 = blockY*blockSize;
+	int x0 = tileX*m_tileSize+localX0;
+	int j0 = tileY*m_tileSize+localY0;
+	int x1 = btMin(x0+blockSize,m_heightStickWidth-1);
+	int j1 = btMin(j0+blockSize,m_heightStickLength-1);
+	if (x0 >= x1 || j0 >= j1)
+		return;
+
+	int numBlocks = (m_tileSize/BT_HEIGHTFIELD_LEAF_BLOCK_SIZE)>>level;
+	const btScalar* minMax = &tile->m_blockMinMax[m_levelOffsets[level]+2*(blockY*numBlocks+blockX)];
+	if (!query.overlaps(x0,x1,j0,j1,minMax[0],minMax[1]))
+		return;
+
+	if (level > 0)
+	{
+		processBlock(tile,tileX,tileY,level-1,2*blockX,2*blockY,query);
+		processBlock(tile,tileX,tileY,level-1,2*blockX+1,2*blockY,query);
+		processBlock(tile,tileX,tileY,level-1,2*blockX,2*blockY+1,query);
+		processBlock(tile,tileX,tileY,level-1,2*blockX+1,2*blockY+1,query);
+		return;
+	}
+
+	for (int j=j0;j<j1;j++)
+	{
+		int localY = j-tileY*m_tileSize;
+		for (int x=x0;x<x1;x++)
+		{
+			int localX = x-tileX*m_tileSize;
+			btScalar h00 = getTileHeight(tile,localX,localY);
+			btScalar h10 = getTileHeight(tile,localX+1,localY);
+			btScalar h01 = getTileHeight(tile,localX,localY+1);
+			btScalar h11 = getTileHeight(tile,localX+1,localY+1);
+			btScalar minHeight = btMin(btMin(h00,h10),btMin(h01,h11));
+			btScalar maxHeight = btMax(btMax(h00,h10),btMax(h01,h11));
+			if (query.overlaps(x,x+1,j,j+1,minHeight,maxHeight))
+			{
+				processQuad(query.m_callback,x,j,h00,h10,h01,h11);
+			}
+		}
+	}
+}
+
+void	btTiledHeightfieldTerrainShape::processTileRange(const btHeightfieldQuery& query, int tileX, int tileY) const
+{
+	//reject the tile before streaming it in
+	btScalar minHeight,maxHeight;
+	getTileHeightRange(tileX,tileY,minHeight,maxHeight);
+	int x0 = tileX*m_tileSize;
+	int j0 = tileY*m_tileSize;
+	if (!query.overlaps(x0,btMin(x0+m_tileSize,m_heightStickWidth-1),j0,btMin(j0+m_tileSize,m_heightStickLength-1),minHeight,maxHeight))
+		return;
+
+	btHeightfieldTile* tile = acquireTile(tileX,tileY);
+	if (tile)
+	{
+		processBlock(tile,tileX,tileY,m_levelOffsets.size()-2,0,0,query);
+		releaseTile(tile);
+	}
+}
+
+void	btTiledHeightfieldTerrainShape::processAllTriangles(btTriangleCallback* callback,const btVector3& aabbMin,const btVector3& aabbMax) const
+{
+	// same grid range as btHeightfieldTerrainShape::processAllTriangles
+	btVector3	localAabbMin = aabbMin*btVector3(1.f/m_localScaling[0],1.f/m_localScaling[1],1.f/m_localScaling[2]);
+	btVector3	localAabbMax = aabbMax*btVector3(1.f/m_localScaling[0],1.f/m_localScaling[1],1.f/m_localScaling[2]);
+	localAabbMin += m_localOrigin;
+	localAabbMax += m_localOrigin;
+
+	int	quantizedAabbMin[3];
+	int	quantizedAabbMax[3];
+	quantizeWithClamp(quantizedAabbMin, localAabbMin,0);
+	quantizeWithClamp(quantizedAabbMax, localAabbMax,1);
+
+	int axisX,axisJ;
+	getGridAxes(axisX,axisJ);
+
+	btHeightfieldQuery query;
+	query.m_callback = callback;
+	query.m_isRay = false;
+	query.m_startX = btMax(quantizedAabbMin[axisX]-1,0);
+	query.m_endX = btMin(quantizedAabbMax[axisX]+1,m_heightStickWidth-1);
+	query.m_startJ = btMax(quantizedAabbMin[axisJ]-1,0);
+	query.m_endJ = btMin(quantizedAabbMax[axisJ]+1,m_heightStickLength-1);
+	query.m_minHeight = localAabbMin[m_upAxis];
+	query.m_maxHeight = localAabbMax[m_upAxis];
+	if (query.m_startX >= query.m_endX || query.m_startJ >= query.m_endJ)
+		return;
+
+	int endTileX = (query.m_endX-1)/m_tileSize;
+	int endTileY = (query.m_endJ-1)/m_tileSize;
+	for (int tileY=query.m_startJ/m_tileSize;tileY<=endTileY;tileY++)
+	{
+		for (int tileX=query.m_startX/m_tileSize;tileX<=endTileX;tileX++)
+		{
+			processTileRange(query,tileX,tileY);
+		}
+	}
+}
+
+void	btTiledHeightfieldTerrainShape::performRaycast(btTriangleCallback* callback, const btVector3& raySource, const btVector3& rayTarget, const btScalar* closestHitFraction) const
+{
+	btHeightfieldQuery query;
+	query.m_callback = callback;
+	query.m_isRay = true;
+	btScalar to[3];
+	getGridPoint(raySource,query.m_from);
+	getGridPoint(rayTarget,to);
+	for (int i=0;i<3;i++)
+	{
+		query.m_dir[i] = to[i]-query.m_from[i];
+		query.m_extentMin[i] = btScalar(0.);
+		query.m_extentMax[i] = btScalar(0.);
+	}
+	query.m_tMin = btScalar(0.);
+	query.m_tMax = btScalar(1.);
+
+	//clip the ray to the heightfield
+	btScalar boxMin[3] = {btScalar(0.),btScalar(0.),m_minHeight};
+	btScalar boxMax[3] = {m_width,m_length,m_maxHeight};
+	if (!clipRay(query.m_from,query.m_dir,boxMin,boxMax,query.m_tMin,query.m_tMax))
+		return;
+
+	//walk the tiles along the ray
+	btScalar tileSize = btScalar(m_tileSize);
+	btScalar startX = query.m_from[0]+query.m_dir[0]*query.m_tMin;
+	btScalar startJ = query.m_from[1]+query.m_dir[1]*query.m_tMin;
+	int tileX = btMax(0,btMin(int(startX/tileSize),m_numTilesX-1));
+	int tileY = btMax(0,btMin(int(startJ/tileSize),m_numTilesY-1));
+
+	int stepX = query.m_dir[0] > btScalar(0.) ? 1 : -1;
+	int stepY = query.m_dir[1] > btScalar(0.) ? 1 : -1;
+	btScalar nextX = SIMD_INFINITY;
+	btScalar nextY = SIMD_INFINITY;
+	btScalar deltaX = SIMD_INFINITY;
+	btScalar deltaY = SIMD_INFINITY;
+	if (query.m_dir[0] != btScalar(0.))
+	{
+		nextX = (btScalar(tileX+(stepX > 0 ? 1 : 0))*tileSize-query.m_from[0])/query.m_dir[0];
+		deltaX = tileSize/btFabs(query.m_dir[0]);
+	}
+	if (query.m_dir[1] != btScalar(0.))
+	{
+		nextY = (btScalar(tileY+(stepY > 0 ? 1 : 0))*tileSize-query.m_from[1])/query.m_dir[1];
+		deltaY = tileSize/btFabs(query.m_dir[1]);
+	}
+
+	for (;;)
+	{
+		processTileRange(query,tileX,tileY);
+		//the remaining tiles are beyond the closest hit
+		if (closestHitFraction && *closestHitFraction < btMin(nextX,nextY))
+			break;
+		if (nextX < nextY)
+		{
+			if (nextX > query.m_tMax)
+				break;
+			tileX += stepX;
+			nextX += deltaX;
+		} else
+		{
+			if (nextY > query.m_tMax)
+				break;
+			tileY += stepY;
+			nextY += deltaY;
+		}
+		if (tileX < 0 || tileX >= m_numTilesX || tileY < 0 || tileY >= m_numTilesY)
+			break;
+	}
+}
+
+void	btTiledHeightfieldTerrainShape::performConvexcast(btTriangleCallback* callback, const btVector3& boxSource, const btVector3& boxTarget, const btVector3& boxMin, const btVector3& boxMax) const
+{
+	btHeightfieldQuery query;
+	query.m_callback = callback;
+	query.m_isRay = true;
+	btScalar to[3];
+	getGridPoint(boxSource,query.m_from);
+	getGridPoint(boxTarget,to);
+
+	//box extents relative to its center in grid space, including the margin of the triangles
+	int axisX,axisJ;
+	getGridAxes(axisX,axisJ);
+	int axes[3] = {axisX,axisJ,m_upAxis};
+	for (int i=0;i<3;i++)
+	{
+		query.m_dir[i] = to[i]-query.m_from[i];
+		btScalar e0 = (boxMin[axes[i]]-getMargin())/m_localScaling[axes[i]];
+		btScalar e1 = (boxMax[axes[i]]+getMargin())/m_localScaling[axes[i]];
+		query.m_extentMin[i] = btMin(e0,e1);
+		query.m_extentMax[i] = btMax(e0,e1);
+	}
+	query.m_tMin = btScalar(0.);
+	query.m_tMax = btScalar(1.);
+
+	btScalar clipMin[3] = {-query.m_extentMax[0],-query.m_extentMax[1],m_minHeight-query.m_extentMax[2]};
+	btScalar clipMax[3] = {m_width-query.m_extentMin[0],m_length-query.m_extentMin[1],m_maxHeight-query.m_extentMin[2]};
+	if (!clipRay(query.m_from,query.m_dir,clipMin,clipMax,query.m_tMin,query.m_tMax))
+		return;
+
+	//the tiles in the swept area, each of them is tested against the moving box before it is loaded
+	btScalar sweptMin[2],sweptMax[2];
+	for (int i=0;i<2;i++)
+	{
+		btScalar start = query.m_from[i]+query.m_dir[i]*query.m_tMin;
+		btScalar end = query.m_from[i]+query.m_dir[i]*query.m_tMax;
+		sweptMin[i] = btMin(start,end)+query.m_extentMin[i];
+		sweptMax[i] = btMax(start,end)+query.m_extentMax[i];
+	}
+	int startTileX = btMax(0,int(btMax(sweptMin[0],btScalar(0.)))/m_tileSize);
+	int endTileX = btMin(m_numTilesX-1,int(btMax(sweptMax[0],btScalar(0.)))/m_tileSize);
+	int startTileY = btMax(0,int(btMax(sweptMin[1],btScalar(0.)))/m_tileSize);
+	int endTileY = btMin(m_numTilesY-1,int(btMax(sweptMax[1],btScalar(0.)))/m_tileSize);
+	for (int tileY=startTileY;tileY<=endTileY;tileY++)
+	{
+		for (int tileX=startTileX;tileX<=endTileX;tileX++)
+		{
+			processTileRange(query,tileX,tileY);
+		}
+	}
+}
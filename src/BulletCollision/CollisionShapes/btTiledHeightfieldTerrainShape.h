@@ -0,0 +1,167 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_TILED_HEIGHTFIELD_TERRAIN_SHAPE_H
+#define BT_TILED_HEIGHTFIELD_TERRAIN_SHAPE_H
+
+#include "btHeightfieldTerrainShape.h"
+#include "LinearMath/btAlignedObjectArray.h"
+#include "LinearMath/btThreads.h"
+
+///the cells of a quadtree leaf block, per side
+#define BT_HEIGHTFIELD_LEAF_BLOCK_SIZE 4
+
+///btHeightfieldTileProvider streams the heights of a btTiledHeightfieldTerrainShape in and out.
+///It is called from the thread that queries the shape, so it has to be thread safe when the shape is used from several threads.
+class btHeightfieldTileProvider
+{
+public:
+	virtual ~btHeightfieldTileProvider() {}
+
+	///fill the raw heights of tile (tileX,tileY): (tileSize+1)*(tileSize+1) values, row by row, for the grid points
+	///tileX*tileSize ... tileX*tileSize+tileSize and tileY*tileSize ... tileY*tileSize+tileSize. Neighbouring tiles share their border points.
+	///Points beyond the end of the heightfield can be left alone. Return false if the tile is not available, it has no triangles then.
+	virtual bool	loadTile(int tileX, int tileY, int tileSize, btScalar* heights) = 0;
+
+	///optionally report the height range of a tile before it is loaded, so queries that miss the range don't stream it in
+	virtual bool	getTileHeightRange(int tileX, int tileY, btScalar& minHeight, btScalar& maxHeight)
+	{
+		(void)tileX; (void)tileY; (void)minHeight; (void)maxHeight;
+		return false;
+	}
+
+	///called when a tile was dropped from the cache
+	virtual void	tileEvicted(int tileX, int tileY)
+	{
+		(void)tileX; (void)tileY;
+	}
+};
+
+///btTiledHeightfieldTerrainShape is a heightfield that keeps only some square tiles of the heights in memory.
+///The tiles are loaded on demand through a btHeightfieldTileProvider and the least recently used tiles are dropped when more than
+///the maximum number of resident tiles are loaded, so huge terrains don't need the whole height array in memory.
+///Every tile has a min/max quadtree of its heights, processAllTriangles and performRaycast skip the blocks outside the height range
+///of the query. performRaycast walks the tiles along the ray (grid DDA) and the quadtree blocks and cells that the ray crosses,
+///performConvexcast does the same for the tiles, blocks and cells that a moving box touches.
+///The triangles, vertices and part/triangle indices are the same as for a btHeightfieldTerrainShape with the same heights.
+ATTRIBUTE_ALIGNED16(class) btTiledHeightfieldTerrainShape : public btHeightfieldTerrainShape
+{
+	enum btTileState
+	{
+		TILE_LOADING=0,
+		TILE_LOADED,
+		TILE_MISSING
+	};
+
+	struct btHeightfieldTile
+	{
+		btAlignedObjectArray<btScalar>	m_heights;
+		///min and max height of the quadtree blocks, for all levels starting at the leaf blocks
+		btAlignedObjectArray<btScalar>	m_blockMinMax;
+		int				m_tileIndex;
+		int				m_pinCount;
+		unsigned int	m_lastUsed;
+		volatile int	m_state;
+	};
+
+	struct btHeightfieldQuery;
+
+	btHeightfieldTileProvider*	m_tileProvider;
+	int		m_tileSize;
+	int		m_numTilesX;
+	int		m_numTilesY;
+	int		m_maxResidentTiles;
+	///number of quadtree levels and the offset of each level in m_blockMinMax
+	btAlignedObjectArray<int>	m_levelOffsets;
+
+	mutable btAlignedObjectArray<btHeightfieldTile*>	m_tiles;
+	mutable btAlignedObjectArray<btHeightfieldTile*>	m_residentTiles;
+	mutable btAlignedObjectArray<btHeightfieldTile*>	m_freeTiles;
+	mutable unsigned int	m_useCounter;
+	mutable btSpinMutex		m_tileMutex;
+
+	btHeightfieldTile*	acquireTile(int tileX, int tileY) const;
+	void				releaseTile(btHeightfieldTile* tile) const;
+	///drop a tile that is not in use from the cache, with the tile mutex held
+	void				removeResidentTile(btHeightfieldTile* tile) const;
+	void				buildBlockMinMax(btHeightfieldTile* tile) const;
+	///the height range of a tile that is not loaded
+	void				getTileHeightRange(int tileX, int tileY, btScalar& minHeight, btScalar& maxHeight) const;
+
+	SIMD_FORCE_INLINE btScalar	getTileHeight(const btHeightfieldTile* tile, int localX, int localY) const
+	{
+		return tile->m_heights[localY*(m_tileSize+1)+localX];
+	}
+
+	void	processBlock(const btHeightfieldTile* tile, int tileX, int tileY, int level, int blockX, int blockY, const btHeightfieldQuery& query) const;
+	void	processTileRange(const btHeightfieldQuery& query, int tileX, int tileY) const;
+
+protected:
+
+	virtual btScalar	getRawHeightFieldValue(int x,int y) const;
+
+public:
+
+	BT_DECLARE_ALIGNED_ALLOCATOR();
+
+	///tileSize is the number of cells per tile side, a power of two of at least BT_HEIGHTFIELD_LEAF_BLOCK_SIZE.
+	///The heights are raw heights like PHY_FLOAT data of btHeightfieldTerrainShape, minHeight and maxHeight bound all of them.
+	btTiledHeightfieldTerrainShape(int heightStickWidth, int heightStickLength, int tileSize,
+	                               btHeightfieldTileProvider* tileProvider,
+	                               btScalar minHeight, btScalar maxHeight,
+	                               int upAxis, bool flipQuadEdges);
+
+	virtual ~btTiledHeightfieldTerrainShape();
+
+	virtual void	processAllTriangles(btTriangleCallback* callback,const btVector3& aabbMin,const btVector3& aabbMax) const;
+
+	///report the triangles of the cells that the ray from raySource to rayTarget (in local space of the shape) may hit.
+	///The tiles are visited in the order the ray crosses them, and the traversal stops at the first tile beyond closestHitFraction.
+	virtual void	performRaycast(btTriangleCallback* callback, const btVector3& raySource, const btVector3& rayTarget, const btScalar* closestHitFraction=0) const;
+
+	virtual void	performConvexcast(btTriangleCallback* callback, const btVector3& boxSource, const btVector3& boxTarget, const btVector3& boxMin, const btVector3& boxMax) const;
+
+	///tiles that are in use by a query are never dropped, so the cache can temporarily hold more tiles
+	void	setMaxResidentTiles(int maxResidentTiles)
+	{
+		m_maxResidentTiles = maxResidentTiles;
+	}
+	int		getMaxResidentTiles() const
+	{
+		return m_maxResidentTiles;
+	}
+
+	int		getNumResidentTiles() const;
+
+	///drop all tiles that are not in use, for example after the provider's data changed
+	void	evictAllTiles();
+
+	int		getTileSize() const
+	{
+		return m_tileSize;
+	}
+	int		getNumTilesX() const
+	{
+		return m_numTilesX;
+	}
+	int		getNumTilesY() const
+	{
+		return m_numTilesY;
+	}
+
+	virtual const char*	getName()const {return "TILEDHEIGHTFIELD";}
+};
+
+#endif //BT_TILED_HEIGHTFIELD_TERRAIN_SHAPE_H
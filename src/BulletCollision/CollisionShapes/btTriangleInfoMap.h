@@ -83,6 +83,60 @@ struct	btTriangleInfoMap : public btInternalTriangleInfoMap
 
 	void	deSerialize(struct btTriangleInfoMapData& data);
 
+	///size of the in-place layout written by serializeInPlace
+	unsigned	calculateSerializeBufferSizeInPlace() const;
+
+	///copy the settings and the hash map arrays into a 16 byte aligned buffer, in native endianness
+	bool	serializeInPlace(void* o_alignedDataBuffer, unsigned i_dataBufferSize) const;
+
+	///point the hash map arrays into a buffer written by serializeInPlace, without copying them.
+	///The buffer has to stay valid and writable while the map is used. Adding triangle info moves the arrays to the heap.
+	bool	deSerializeInPlace(void* i_alignedDataBuffer, unsigned i_dataBufferSize);
+
+};
+
+///header of the in-place layout of btTriangleInfoMap, followed by the hash table, next, value and key arrays at 16 byte aligned offsets.
+///The value and key arrays are stored with their full capacity, because the hash map masks the hash with the capacity.
+///The offsets are computed in 64 bits, so that the counts read from a corrupted buffer can't wrap around.
+struct	btTriangleInfoMapInPlaceData
+{
+	btScalar	m_convexEpsilon;
+	btScalar	m_planarEpsilon;
+	btScalar	m_equalVertexThreshold;
+	btScalar	m_edgeDistanceThreshold;
+	btScalar	m_maxEdgeAngleThreshold;
+	btScalar	m_zeroAreaThreshold;
+
+	int		m_hashTableSize;
+	int		m_nextSize;
+	int		m_numValues;
+	int		m_valueCapacity;
+
+	SIMD_FORCE_INLINE static unsigned long long	align16(unsigned long long size)
+	{
+		return (size + 15) & ~15ull;
+	}
+
+	SIMD_FORCE_INLINE unsigned long long	getHashTableOffset() const
+	{
+		return align16(sizeof(btTriangleInfoMapInPlaceData));
+	}
+	SIMD_FORCE_INLINE unsigned long long	getNextOffset() const
+	{
+		return getHashTableOffset() + align16((unsigned long long)m_hashTableSize*sizeof(int));
+	}
+	SIMD_FORCE_INLINE unsigned long long	getValueOffset() const
+	{
+		return getNextOffset() + align16((unsigned long long)m_nextSize*sizeof(int));
+	}
+	SIMD_FORCE_INLINE unsigned long long	getKeyOffset() const
+	{
+		return getValueOffset() + align16((unsigned long long)m_valueCapacity*sizeof(btTriangleInfo));
+	}
+	SIMD_FORCE_INLINE unsigned long long	getTotalSize() const
+	{
+		return getKeyOffset() + align16((unsigned long long)m_valueCapacity*sizeof(btHashInt));
+	}
 };
 
 ///those fields have to be float and not btScalar for the serialization to work properly
@@ -238,4 +292,95 @@ SIMD_FORCE_INLINE	void	btTriangleInfoMap::deSerialize(btTriangleInfoMapData& tma
 }
 
 
+SIMD_FORCE_INLINE	unsigned	btTriangleInfoMap::calculateSerializeBufferSizeInPlace() const
+{
+	btTriangleInfoMapInPlaceData layout;
+	layout.m_hashTableSize = m_hashTable.size();
+	layout.m_nextSize = m_next.size();
+	layout.m_numValues = m_valueArray.size();
+	layout.m_valueCapacity = m_valueArray.capacity();
+	return unsigned(layout.getTotalSize());
+}
+
+SIMD_FORCE_INLINE	bool	btTriangleInfoMap::serializeInPlace(void* o_alignedDataBuffer, unsigned i_dataBufferSize) const
+{
+	if (!o_alignedDataBuffer || i_dataBufferSize < calculateSerializeBufferSizeInPlace())
+		return false;
+
+	unsigned char* buffer = (unsigned char*)o_alignedDataBuffer;
+	memset(buffer,0,calculateSerializeBufferSizeInPlace());
+
+	btTriangleInfoMapInPlaceData* layout = (btTriangleInfoMapInPlaceData*)buffer;
+	layout->m_convexEpsilon = m_convexEpsilon;
+	layout->m_planarEpsilon = m_planarEpsilon;
+	layout->m_equalVertexThreshold = m_equalVertexThreshold;
+	layout->m_edgeDistanceThreshold = m_edgeDistanceThreshold;
+	layout->m_maxEdgeAngleThreshold = m_maxEdgeAngleThreshold;
+	layout->m_zeroAreaThreshold = m_zeroAreaThreshold;
+	layout->m_hashTableSize = m_hashTable.size();
+	layout->m_nextSize = m_next.size();
+	layout->m_numValues = m_valueArray.size();
+	layout->m_valueCapacity = m_valueArray.capacity();
+
+	if (layout->m_hashTableSize)
+		memcpy(buffer+layout->getHashTableOffset(),&m_hashTable[0],layout->m_hashTableSize*sizeof(int));
+	if (layout->m_nextSize)
+		memcpy(buffer+layout->getNextOffset(),&m_next[0],layout->m_nextSize*sizeof(int));
+	if (layout->m_numValues)
+	{
+		memcpy(buffer+layout->getValueOffset(),&m_valueArray[0],layout->m_numValues*sizeof(btTriangleInfo));
+		memcpy(buffer+layout->getKeyOffset(),&m_keyArray[0],layout->m_numValues*sizeof(btHashInt));
+	}
+	return true;
+}
+
+SIMD_FORCE_INLINE	bool	btTriangleInfoMap::deSerializeInPlace(void* i_alignedDataBuffer, unsigned i_dataBufferSize)
+{
+	if (!i_alignedDataBuffer || i_dataBufferSize < sizeof(btTriangleInfoMapInPlaceData))
+		return false;
+
+	unsigned char* buffer = (unsigned char*)i_alignedDataBuffer;
+	const btTriangleInfoMapInPlaceData* layout = (const btTriangleInfoMapInPlaceData*)buffer;
+	if (layout->m_hashTableSize < 0 || layout->m_nextSize < 0 || layout->m_numValues < 0 || layout->m_valueCapacity < layout->m_numValues)
+		return false;
+	//the hash map grows the hash table and next arrays with the value capacity, and masks the hash with it
+	if (layout->m_hashTableSize != layout->m_valueCapacity || layout->m_nextSize != layout->m_valueCapacity)
+		return false;
+	if (layout->getTotalSize() > i_dataBufferSize)
+		return false;
+
+	//find follows the hash table and next entries without checks, they have to be BT_HASH_NULL or a value index,
+	//and a chain can't visit more entries than there are values (which would be a cycle)
+	const int* hashTable = (const int*)(buffer+layout->getHashTableOffset());
+	const int* next = (const int*)(buffer+layout->getNextOffset());
+	int i;
+	for (i=0;i<layout->m_numValues;i++)
+	{
+		if (next[i] != BT_HASH_NULL && (next[i] < 0 || next[i] >= layout->m_numValues))
+			return false;
+	}
+	int numVisited = 0;
+	for (i=0;i<layout->m_hashTableSize;i++)
+	{
+		for (int index = hashTable[i]; index != BT_HASH_NULL; index = next[index])
+		{
+			if (index < 0 || index >= layout->m_numValues || ++numVisited > layout->m_numValues)
+				return false;
+		}
+	}
+
+	m_convexEpsilon = layout->m_convexEpsilon;
+	m_planarEpsilon = layout->m_planarEpsilon;
+	m_equalVertexThreshold = layout->m_equalVertexThreshold;
+	m_edgeDistanceThreshold = layout->m_edgeDistanceThreshold;
+	m_maxEdgeAngleThreshold = layout->m_maxEdgeAngleThreshold;
+	m_zeroAreaThreshold = layout->m_zeroAreaThreshold;
+
+	m_hashTable.initializeFromBuffer(buffer+layout->getHashTableOffset(),layout->m_hashTableSize,layout->m_hashTableSize);
+	m_next.initializeFromBuffer(buffer+layout->getNextOffset(),layout->m_nextSize,layout->m_nextSize);
+	m_valueArray.initializeFromBuffer(buffer+layout->getValueOffset(),layout->m_numValues,layout->m_valueCapacity);
+	m_keyArray.initializeFromBuffer(buffer+layout->getKeyOffset(),layout->m_numValues,layout->m_valueCapacity);
+	return true;
+}
+
 #endif //_BT_TRIANGLE_INFO_MAP_H
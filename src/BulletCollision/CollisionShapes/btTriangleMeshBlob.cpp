@@ -0,0 +1,429 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btTriangleMeshBlob.h"
+#include "btBvhTriangleMeshShape.h"
+#include "btTriangleIndexVertexArray.h"
+#include "btOptimizedBvh.h"
+#include "btTriangleInfoMap.h"
+#include "LinearMath/btAlignedAllocator.h"
+#include "LinearMath/btAlignedObjectArray.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const char gTriangleMeshBlobMagic[8] = {'B','T','M','E','S','H','B','L'};
+
+static unsigned	btBlobAlign16(unsigned size)
+{
+	return (size + 15) & ~15u;
+}
+
+static int	btBlobIndexSize(PHY_ScalarType indexType)
+{
+	switch (indexType)
+	{
+	case PHY_INTEGER:
+		return sizeof(int);
+	case PHY_SHORT:
+		return sizeof(short);
+	case PHY_UCHAR:
+		return sizeof(unsigned char);
+	default:
+		return 0;
+	}
+}
+
+static int	btBlobVertexComponentSize(PHY_ScalarType vertexType)
+{
+	switch (vertexType)
+	{
+	case PHY_FLOAT:
+		return sizeof(float);
+	case PHY_DOUBLE:
+		return sizeof(double);
+	default:
+		return 0;
+	}
+}
+
+///true if [offset, offset+length) lies inside a blob of the given size, computed without wrapping
+static bool	btBlobRangeInside(unsigned long long offset, unsigned long long length, unsigned long long size)
+{
+	return offset <= size && length <= size - offset;
+}
+
+///the writer places every array at a 16 byte aligned offset, the mapping itself is page aligned
+static bool	btBlobIsAligned16(unsigned offset)
+{
+	return (offset & 15u) == 0;
+}
+
+static bool	btBlobIsValidMesh(const btTriangleMeshBlobMesh& mesh, const unsigned char* data, unsigned size)
+{
+	int indexSize = btBlobIndexSize((PHY_ScalarType)mesh.m_indexType);
+	int componentSize = btBlobVertexComponentSize((PHY_ScalarType)mesh.m_vertexType);
+	if (!indexSize || !componentSize)
+		return false;
+	if (mesh.m_numTriangles < 0 || mesh.m_numVertices < 0)
+		return false;
+	if (mesh.m_triangleIndexStride < 3*indexSize || (mesh.m_triangleIndexStride % indexSize) != 0 ||
+		mesh.m_vertexStride < 3*componentSize || (mesh.m_vertexStride % componentSize) != 0)
+		return false;
+	if (!btBlobIsAligned16(mesh.m_triangleIndexOffset) || !btBlobIsAligned16(mesh.m_vertexOffset))
+		return false;
+	if (!btBlobRangeInside(mesh.m_triangleIndexOffset,(unsigned long long)mesh.m_numTriangles*(unsigned long long)mesh.m_triangleIndexStride,size) ||
+		!btBlobRangeInside(mesh.m_vertexOffset,(unsigned long long)mesh.m_numVertices*(unsigned long long)mesh.m_vertexStride,size))
+		return false;
+
+	//the triangle callbacks index the vertex array without checks, so this reads the index array once
+	const unsigned char* indexBase = data+mesh.m_triangleIndexOffset;
+	unsigned numVertices = (unsigned)mesh.m_numVertices;
+	for (int i=0;i<mesh.m_numTriangles;i++)
+	{
+		const unsigned char* triangle = indexBase+(size_t)i*mesh.m_triangleIndexStride;
+		for (int j=0;j<3;j++)
+		{
+			unsigned index;
+			switch (mesh.m_indexType)
+			{
+			case PHY_INTEGER:
+				index = (unsigned)((const int*)triangle)[j];
+				break;
+			case PHY_SHORT:
+				index = ((const unsigned short*)triangle)[j];
+				break;
+			default:
+				index = triangle[j];
+				break;
+			}
+			if (index >= numVertices)
+				return false;
+		}
+	}
+	return true;
+}
+
+///number of nodes in the subtree of a node, the escape index of an internal node
+static long long	btBlobNodeSpan(const btQuantizedBvhNode& node)
+{
+	return node.isLeafNode() ? 1 : -(long long)node.m_escapeIndexOrTriangleIndex;
+}
+
+///deSerializeInPlace only points the node and subtree arrays into the blob, so their counts are checked against the BVH size here.
+///The traversals follow the escape indices and the triangle callbacks use the leaf part and triangle indices without checks.
+static bool	btBlobIsValidBvh(btOptimizedBvh* bvh, unsigned bvhSize, const btTriangleMeshBlobMesh* meshes, int numMeshes)
+{
+	if (!bvh->isQuantized())
+		return false;
+	const QuantizedNodeArray& nodes = bvh->getQuantizedNodeArray();
+	const BvhSubtreeInfoArray& subtrees = bvh->getSubtreeInfoArray();
+	int numNodes = nodes.size();
+	int numSubtrees = subtrees.size();
+	if (numNodes < 0 || numSubtrees < 0)
+		return false;
+	unsigned long long size = sizeof(btQuantizedBvh) + btQuantizedBvh::getAlignmentSerializationPadding() +
+		(unsigned long long)numNodes*sizeof(btQuantizedBvhNode) + (unsigned long long)numSubtrees*sizeof(btBvhSubtreeInfo);
+	if (size > bvhSize)
+		return false;
+
+	//the root spans the whole tree, and every internal node spans itself and its two children
+	if (numNodes && btBlobNodeSpan(nodes[0]) != numNodes)
+		return false;
+	for (int i=0;i<numNodes;i++)
+	{
+		const btQuantizedBvhNode& node = nodes[i];
+		if (node.isLeafNode())
+		{
+			int part = node.getPartId();
+			if (part >= numMeshes || node.getTriangleIndex() >= meshes[part].m_numTriangles)
+				return false;
+			continue;
+		}
+		long long span = btBlobNodeSpan(node);
+		if (span < 3 || i+span > numNodes)
+			return false;
+		long long leftSpan = btBlobNodeSpan(nodes[i+1]);
+		if (leftSpan < 1 || 1+leftSpan >= span)
+			return false;
+		if (1+leftSpan+btBlobNodeSpan(nodes[i+1+int(leftSpan)]) != span)
+			return false;
+	}
+
+	for (int i=0;i<numSubtrees;i++)
+	{
+		const btBvhSubtreeInfo& subtree = subtrees[i];
+		if (subtree.m_rootNodeIndex < 0 || subtree.m_subtreeSize < 1 ||
+			(long long)subtree.m_rootNodeIndex+subtree.m_subtreeSize > numNodes)
+			return false;
+	}
+	return true;
+}
+
+static void	btBlobStoreVector(btScalar* dest, const btVector3& v)
+{
+	dest[0] = v.getX();
+	dest[1] = v.getY();
+	dest[2] = v.getZ();
+	dest[3] = btScalar(0.);
+}
+
+static btVector3	btBlobLoadVector(const btScalar* src)
+{
+	return btVector3(src[0],src[1],src[2]);
+}
+
+btTriangleMeshBlob::btTriangleMeshBlob()
+:m_meshInterface(0),
+m_bvh(0),
+m_triangleInfoMap(0),
+m_shape(0)
+{
+}
+
+btTriangleMeshBlob::~btTriangleMeshBlob()
+{
+	release();
+}
+
+bool	btTriangleMeshBlob::writeFile(const char* fileName, btBvhTriangleMeshShape* shape)
+{
+	btOptimizedBvh* bvh = shape->getOptimizedBvh();
+	if (!bvh || !bvh->isQuantized())
+		return false;
+
+	const btStridingMeshInterface* meshInterface = shape->getMeshInterface();
+	const btTriangleInfoMap* triangleInfoMap = shape->getTriangleInfoMap();
+	int numMeshes = meshInterface->getNumSubParts();
+
+	btTriangleMeshBlobHeader header;
+	memset(&header,0,sizeof(header));
+	memcpy(header.m_magic,gTriangleMeshBlobMagic,sizeof(header.m_magic));
+	header.m_version = BT_TRIANGLE_MESH_BLOB_VERSION;
+	header.m_endianMarker = 1;
+	header.m_scalarSize = sizeof(btScalar);
+	header.m_bvhClassSize = sizeof(btQuantizedBvh);
+	header.m_numMeshes = numMeshes;
+	btBlobStoreVector(header.m_meshScaling,meshInterface->getScaling());
+	btBlobStoreVector(header.m_localScaling,shape->getLocalScaling());
+	btBlobStoreVector(header.m_localAabbMin,shape->getLocalAabbMin());
+	btBlobStoreVector(header.m_localAabbMax,shape->getLocalAabbMax());
+
+	//layout
+	unsigned offset = btBlobAlign16(sizeof(btTriangleMeshBlobHeader));
+	header.m_meshesOffset = offset;
+	offset += btBlobAlign16(numMeshes*sizeof(btTriangleMeshBlobMesh));
+
+	btAlignedObjectArray<btTriangleMeshBlobMesh> meshes;
+	meshes.resize(numMeshes);
+	int part;
+	for (part=0;part<numMeshes;part++)
+	{
+		const unsigned char* vertexBase;
+		const unsigned char* indexBase;
+		int numVertices,vertexStride,indexStride,numTriangles;
+		PHY_ScalarType vertexType,indexType;
+		meshInterface->getLockedReadOnlyVertexIndexBase(&vertexBase,numVertices,vertexType,vertexStride,&indexBase,indexStride,numTriangles,indexType,part);
+		meshInterface->unLockReadOnlyVertexBase(part);
+
+		int indexSize = btBlobIndexSize(indexType);
+		int componentSize = btBlobVertexComponentSize(vertexType);
+		if (!indexSize || !componentSize)
+			return false;
+
+		btTriangleMeshBlobMesh& mesh = meshes[part];
+		mesh.m_numTriangles = numTriangles;
+		mesh.m_triangleIndexStride = 3*indexSize;
+		mesh.m_indexType = indexType;
+		mesh.m_numVertices = numVertices;
+		mesh.m_vertexStride = 3*componentSize;
+		mesh.m_vertexType = vertexType;
+
+		mesh.m_triangleIndexOffset = offset;
+		offset += btBlobAlign16(numTriangles*mesh.m_triangleIndexStride);
+		mesh.m_vertexOffset = offset;
+		offset += btBlobAlign16(numVertices*mesh.m_vertexStride);
+	}
+
+	header.m_bvhOffset = offset;
+	header.m_bvhSize = bvh->calculateSerializeBufferSize();
+	offset += btBlobAlign16(header.m_bvhSize);
+
+	if (triangleInfoMap)
+	{
+		header.m_triangleInfoMapOffset = offset;
+		header.m_triangleInfoMapSize = triangleInfoMap->calculateSerializeBufferSizeInPlace();
+		offset += btBlobAlign16(header.m_triangleInfoMapSize);
+	}
+
+	unsigned char* buffer = (unsigned char*)btAlignedAlloc(offset,16);
+	memset(buffer,0,offset);
+	memcpy(buffer,&header,sizeof(header));
+	if (numMeshes)
+		memcpy(buffer+header.m_meshesOffset,&meshes[0],numMeshes*sizeof(btTriangleMeshBlobMesh));
+
+	//pack the vertex and index arrays, the strides of the source mesh are dropped
+	for (part=0;part<numMeshes;part++)
+	{
+		const unsigned char* vertexBase;
+		const unsigned char* indexBase;
+		int numVertices,vertexStride,indexStride,numTriangles;
+		PHY_ScalarType vertexType,indexType;
+		meshInterface->getLockedReadOnlyVertexIndexBase(&vertexBase,numVertices,vertexType,vertexStride,&indexBase,indexStride,numTriangles,indexType,part);
+
+		const btTriangleMeshBlobMesh& mesh = meshes[part];
+		int i;
+		for (i=0;i<numTriangles;i++)
+		{
+			memcpy(buffer+mesh.m_triangleIndexOffset+i*mesh.m_triangleIndexStride,indexBase+i*indexStride,mesh.m_triangleIndexStride);
+		}
+		for (i=0;i<numVertices;i++)
+		{
+			memcpy(buffer+mesh.m_vertexOffset+i*mesh.m_vertexStride,vertexBase+i*vertexStride,mesh.m_vertexStride);
+		}
+		meshInterface->unLockReadOnlyVertexBase(part);
+	}
+
+	bool ok = bvh->serializeInPlace(buffer+header.m_bvhOffset,header.m_bvhSize,false);
+	if (ok && triangleInfoMap)
+	{
+		ok = triangleInfoMap->serializeInPlace(buffer+header.m_triangleInfoMapOffset,header.m_triangleInfoMapSize);
+	}
+
+	if (ok)
+	{
+		FILE* file = fopen(fileName,"wb");
+		ok = file != 0;
+		if (file)
+		{
+			ok = fwrite(buffer,1,offset,file) == offset;
+			ok = (fclose(file) == 0) && ok;
+		}
+	}
+
+	btAlignedFree(buffer);
+	return ok;
+}
+
+bool	btTriangleMeshBlob::loadFile(const char* fileName)
+{
+	release();
+
+	//copy on write, deSerializeInPlace patches the BVH header
+	if (!m_file.open(fileName,btMappedFile::MAP_COPY_ON_WRITE))
+		return false;
+
+	unsigned char* data = (unsigned char*)m_file.getData();
+	unsigned size = m_file.getSize();
+
+	const btTriangleMeshBlobHeader* header = (const btTriangleMeshBlobHeader*)data;
+	bool valid = size >= sizeof(btTriangleMeshBlobHeader) &&
+		memcmp(header->m_magic,gTriangleMeshBlobMagic,sizeof(header->m_magic)) == 0 &&
+		header->m_version == BT_TRIANGLE_MESH_BLOB_VERSION &&
+		header->m_endianMarker == 1 &&
+		header->m_scalarSize == sizeof(btScalar) &&
+		header->m_bvhClassSize == sizeof(btQuantizedBvh) &&
+		header->m_numMeshes >= 0 &&
+		btBlobIsAligned16(header->m_meshesOffset) &&
+		btBlobRangeInside(header->m_meshesOffset,(unsigned long long)header->m_numMeshes*sizeof(btTriangleMeshBlobMesh),size) &&
+		btBlobIsAligned16(header->m_bvhOffset) &&
+		header->m_bvhSize >= sizeof(btQuantizedBvh) &&
+		btBlobRangeInside(header->m_bvhOffset,header->m_bvhSize,size) &&
+		btBlobIsAligned16(header->m_triangleInfoMapOffset) &&
+		btBlobRangeInside(header->m_triangleInfoMapOffset,header->m_triangleInfoMapSize,size);
+
+	const btTriangleMeshBlobMesh* meshes = (const btTriangleMeshBlobMesh*)(data+header->m_meshesOffset);
+	for (int part=0;valid && part<header->m_numMeshes;part++)
+	{
+		valid = btBlobIsValidMesh(meshes[part],data,size);
+	}
+
+	if (!valid)
+	{
+		m_file.close();
+		return false;
+	}
+
+	m_meshInterface = new btTriangleIndexVertexArray();
+
+	for (int part=0;part<header->m_numMeshes;part++)
+	{
+		const btTriangleMeshBlobMesh& blobMesh = meshes[part];
+		btIndexedMesh mesh;
+		mesh.m_numTriangles = blobMesh.m_numTriangles;
+		mesh.m_triangleIndexBase = data+blobMesh.m_triangleIndexOffset;
+		mesh.m_triangleIndexStride = blobMesh.m_triangleIndexStride;
+		mesh.m_numVertices = blobMesh.m_numVertices;
+		mesh.m_vertexBase = data+blobMesh.m_vertexOffset;
+		mesh.m_vertexStride = blobMesh.m_vertexStride;
+		mesh.m_vertexType = (PHY_ScalarType)blobMesh.m_vertexType;
+		m_meshInterface->addIndexedMesh(mesh,(PHY_ScalarType)blobMesh.m_indexType);
+	}
+	m_meshInterface->setScaling(btBlobLoadVector(header->m_meshScaling));
+
+	btVector3 localScaling = btBlobLoadVector(header->m_localScaling);
+	//the stored AABB already includes the local scaling, the shape only recomputes it (by reading all vertices) for a non unit scaling
+	m_meshInterface->setPremadeAabb(btBlobLoadVector(header->m_localAabbMin),btBlobLoadVector(header->m_localAabbMax));
+
+	m_bvh = btOptimizedBvh::deSerializeInPlace(data+header->m_bvhOffset,header->m_bvhSize,false);
+	if (!m_bvh || !btBlobIsValidBvh(m_bvh,header->m_bvhSize,meshes,header->m_numMeshes))
+	{
+		release();
+		return false;
+	}
+
+	if (header->m_triangleInfoMapSize)
+	{
+		m_triangleInfoMap = new btTriangleInfoMap();
+		if (!m_triangleInfoMap->deSerializeInPlace(data+header->m_triangleInfoMapOffset,header->m_triangleInfoMapSize))
+		{
+			release();
+			return false;
+		}
+	}
+
+	m_shape = new btBvhTriangleMeshShape(m_meshInterface,m_bvh->isQuantized(),false);
+	m_shape->setOptimizedBvh(m_bvh,localScaling);
+	if (m_triangleInfoMap)
+		m_shape->setTriangleInfoMap(m_triangleInfoMap);
+
+	return true;
+}
+
+void	btTriangleMeshBlob::release()
+{
+	if (m_shape)
+	{
+		delete m_shape;
+		m_shape = 0;
+	}
+	if (m_triangleInfoMap)
+	{
+		delete m_triangleInfoMap;
+		m_triangleInfoMap = 0;
+	}
+	if (m_bvh)
+	{
+		//the node arrays point into the mapping and are not freed
+		m_bvh->~btOptimizedBvh();
+		m_bvh = 0;
+	}
+	if (m_meshInterface)
+	{
+		delete m_meshInterface;
+		m_meshInterface = 0;
+	}
+	m_file.close();
+}
@@ -0,0 +1,132 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_TRIANGLE_MESH_BLOB_H
+#define BT_TRIANGLE_MESH_BLOB_H
+
+#include "LinearMath/btMappedFile.h"
+#include "LinearMath/btVector3.h"
+
+class btBvhTriangleMeshShape;
+class btTriangleIndexVertexArray;
+class btOptimizedBvh;
+struct btTriangleInfoMap;
+
+#define BT_TRIANGLE_MESH_BLOB_VERSION 1
+
+///header of a triangle mesh blob file
+struct	btTriangleMeshBlobHeader
+{
+	char	m_magic[8];
+	///BT_TRIANGLE_MESH_BLOB_VERSION
+	int		m_version;
+	///1 written in native endianness, a blob written on a platform with another endianness is rejected
+	int		m_endianMarker;
+	///sizeof(btScalar) and sizeof(btQuantizedBvh) of the platform that wrote the blob
+	int		m_scalarSize;
+	int		m_bvhClassSize;
+
+	int		m_numMeshes;
+	unsigned	m_meshesOffset;
+	unsigned	m_bvhOffset;
+	unsigned	m_bvhSize;
+	unsigned	m_triangleInfoMapOffset;
+	unsigned	m_triangleInfoMapSize;
+
+	btScalar	m_meshScaling[4];
+	btScalar	m_localScaling[4];
+	btScalar	m_localAabbMin[4];
+	btScalar	m_localAabbMax[4];
+};
+
+///one btIndexedMesh in a triangle mesh blob, the offsets are relative to the start of the blob
+struct	btTriangleMeshBlobMesh
+{
+	int		m_numTriangles;
+	unsigned	m_triangleIndexOffset;
+	int		m_triangleIndexStride;
+	int		m_indexType;
+	int		m_numVertices;
+	unsigned	m_vertexOffset;
+	int		m_vertexStride;
+	int		m_vertexType;
+};
+
+///btTriangleMeshBlob stores a btBvhTriangleMeshShape in a single file: the vertex and index arrays, the quantized BVH in the serializeInPlace
+///layout and the optional btTriangleInfoMap. Loading maps the file and points the btTriangleIndexVertexArray, btOptimizedBvh and btTriangleInfoMap
+///into the mapping, the arrays are not copied. They are read once though: loading checks every triangle index against its mesh, every BVH node
+///against the tree and the meshes, and the hash chains of the triangle info map, so that a corrupted file is rejected instead of read out of bounds.
+///Processes that load the same blob share its pages through the page cache, only the page that the in-place deserialization patches
+///(the BVH header) becomes a private copy.
+///A blob with a non-unit local scaling makes the shape recompute its AABB from all vertices, and changing the local scaling of the shape
+///later builds a new BVH on the heap, so the mapped BVH is no longer used.
+///The blob uses the native endianness and layout, like serializeInPlace, so it should be written for the platform that loads it.
+class	btTriangleMeshBlob
+{
+	btMappedFile	m_file;
+
+	btTriangleIndexVertexArray*	m_meshInterface;
+	btOptimizedBvh*				m_bvh;
+	btTriangleInfoMap*			m_triangleInfoMap;
+	btBvhTriangleMeshShape*		m_shape;
+
+	btTriangleMeshBlob(const btTriangleMeshBlob&);
+	btTriangleMeshBlob& operator=(const btTriangleMeshBlob&);
+
+public:
+
+	btTriangleMeshBlob();
+
+	virtual ~btTriangleMeshBlob();
+
+	///write the mesh, BVH and triangle info map of the shape into a blob file. The shape needs a quantized BVH and a float or double mesh
+	///with integer, short or unsigned char indices.
+	static bool	writeFile(const char* fileName, btBvhTriangleMeshShape* shape);
+
+	///map a blob written by writeFile and create the shape. Any previously loaded blob is released.
+	bool	loadFile(const char* fileName);
+
+	///delete the shape and the objects that point into the mapping, and unmap the file
+	void	release();
+
+	///the shape is owned by the blob and valid until release, it uses the mesh interface, BVH and triangle info map of the blob
+	btBvhTriangleMeshShape*	getCollisionShape()
+	{
+		return m_shape;
+	}
+
+	btTriangleIndexVertexArray*	getMeshInterface()
+	{
+		return m_meshInterface;
+	}
+
+	btOptimizedBvh*	getOptimizedBvh()
+	{
+		return m_bvh;
+	}
+
+	///0 if the blob has no triangle info map
+	btTriangleInfoMap*	getTriangleInfoMap()
+	{
+		return m_triangleInfoMap;
+	}
+
+	const btMappedFile&	getMappedFile() const
+	{
+		return m_file;
+	}
+};
+
+#endif //BT_TRIANGLE_MESH_BLOB_H
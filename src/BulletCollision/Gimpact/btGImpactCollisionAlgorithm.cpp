@@ -30,6 +30,7 @@ Concave-Concave Collision
 #include "btGImpactCollisionAlgorithm.h"
 #include "btContactProcessing.h"
 #include "LinearMath/btQuickprof.h"
+#include "LinearMath/btThreads.h"
 
 
 //! Class for accessing the plane equation
@@ -387,71 +388,159 @@ void btGImpactCollisionAlgorithm::collide_gjk_triangles(const btCollisionObjectW
 	shape1->unlockChildShapes();
 }
 
-void btGImpactCollisionAlgorithm::collide_sat_triangles(const btCollisionObjectWrapper* body0Wrap,
-					  const btCollisionObjectWrapper* body1Wrap,
-					  const btGImpactMeshShapePart * shape0,
-					  const btGImpactMeshShapePart * shape1,
-					  const int * pairs, int pair_count)
+//! number of triangle pairs in a work item of collide_sat_triangles
+#define BT_GIMPACT_PAIR_CHUNK_SIZE 64
+
+//! a contact found by collide_sat_triangles, before it is added to the manifold
+struct btGImpactTriangleContact
 {
-	btTransform orgtrans0 = body0Wrap->getWorldTransform();
-	btTransform orgtrans1 = body1Wrap->getWorldTransform();
+	btVector3 m_point;
+	btVector3 m_normal;
+	btScalar m_distance;
+	int m_triface0;
+	int m_triface1;
+};
 
-	btPrimitiveTriangle ptri0;
-	btPrimitiveTriangle ptri1;
-	GIM_TRIANGLE_CONTACT contact_data;
+typedef btAlignedObjectArray<btGImpactTriangleContact> btGImpactTriangleContactArray;
 
-	shape0->lockChildShapes();
-	shape1->lockChildShapes();
+//! the contact arrays of the chunks of collide_sat_triangles, one set per calling thread, reused from call to call.
+//! Nested btParallelFor loops run inline, so a thread is in one collide_sat_triangles at a time.
+static btAlignedObjectArray<btGImpactTriangleContactArray> g_sat_chunk_contacts[BT_MAX_THREAD_COUNT];
 
-	const int * pair_pointer = pairs;
+//! collide the triangle pairs with the clipping method, pairs are culled BT_TRIANGLE_PAIR_BATCH_SIZE at a time with btTrianglePairBatch
+static void bt_collide_sat_triangle_pairs(const btGImpactMeshShapePart * shape0,
+					  const btGImpactMeshShapePart * shape1,
+					  const btTransform & trans0,
+					  const btTransform & trans1,
+					  const int * pairs, int pair_count,
+					  btGImpactTriangleContactArray & contacts)
+{
+	btPrimitiveTriangle ptri0[BT_TRIANGLE_PAIR_BATCH_SIZE];
+	btPrimitiveTriangle ptri1[BT_TRIANGLE_PAIR_BATCH_SIZE];
+	btTrianglePairBatch batch;
+	GIM_TRIANGLE_CONTACT contact_data;
 
-	while(pair_count--)
+	for (int first = 0;first<pair_count;first+=BT_TRIANGLE_PAIR_BATCH_SIZE)
 	{
+		int batch_count = btMin(pair_count-first,int(BT_TRIANGLE_PAIR_BATCH_SIZE));
+		for (int k = 0;k<BT_TRIANGLE_PAIR_BATCH_SIZE;k++)
+		{
+			//unused slots repeat the first pair
+			if(k<batch_count)
+			{
+				const int * pair_pointer = pairs + (first+k)*2;
+				shape0->getPrimitiveTriangle(pair_pointer[0],ptri0[k]);
+				shape1->getPrimitiveTriangle(pair_pointer[1],ptri1[k]);
+				ptri0[k].applyTransform(trans0);
+				ptri1[k].applyTransform(trans1);
+			}
+			batch.setPair(k,ptri0[k<batch_count ? k : 0],ptri1[k<batch_count ? k : 0]);
+		}
 
-		m_triface0 = *(pair_pointer);
-		m_triface1 = *(pair_pointer+1);
-		pair_pointer+=2;
+		int mask = batch.overlapTestConservative();
 
+		for (int k = 0;k<batch_count;k++)
+		{
+			if(!(mask & (1<<k))) continue;
 
-		shape0->getPrimitiveTriangle(m_triface0,ptri0);
-		shape1->getPrimitiveTriangle(m_triface1,ptri1);
+			//build planes
+			ptri0[k].buildTriPlane();
+			ptri1[k].buildTriPlane();
 
-		#ifdef TRI_COLLISION_PROFILING
-		bt_begin_gim02_tri_time();
-		#endif
+			if(ptri0[k].overlap_test_conservative(ptri1[k]))
+			{
+				if(ptri0[k].find_triangle_collision_clip_method(ptri1[k],contact_data))
+				{
+					int j = contact_data.m_point_count;
+					while(j--)
+					{
+						btGImpactTriangleContact & contact = contacts.expandNonInitializing();
+						contact.m_point = contact_data.m_points[j];
+						contact.m_normal = contact_data.m_separating_normal;
+						contact.m_distance = -contact_data.m_penetration_depth;
+						contact.m_triface0 = pairs[(first+k)*2];
+						contact.m_triface1 = pairs[(first+k)*2+1];
+					}
+				}
+			}
+		}
+	}
+}
 
-		ptri0.applyTransform(orgtrans0);
-		ptri1.applyTransform(orgtrans1);
+struct btGImpactSatTrianglesLoop : public btIParallelForBody
+{
+	const btGImpactMeshShapePart * m_shape0;
+	const btGImpactMeshShapePart * m_shape1;
+	btTransform m_trans0;
+	btTransform m_trans1;
+	const int * m_pairs;
+	int m_pair_count;
+	btGImpactTriangleContactArray * m_chunk_contacts;
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		for (int i=iBegin;i<iEnd;i++)
+		{
+			int first = i*BT_GIMPACT_PAIR_CHUNK_SIZE;
+			int count = btMin(m_pair_count-first,int(BT_GIMPACT_PAIR_CHUNK_SIZE));
+			bt_collide_sat_triangle_pairs(m_shape0,m_shape1,m_trans0,m_trans1,m_pairs+first*2,count,m_chunk_contacts[i]);
+		}
+	}
+};
 
+void btGImpactCollisionAlgorithm::collide_sat_triangles(const btCollisionObjectWrapper* body0Wrap,
+					  const btCollisionObjectWrapper* body1Wrap,
+					  const btGImpactMeshShapePart * shape0,
+					  const btGImpactMeshShapePart * shape1,
+					  const int * pairs, int pair_count)
+{
+	shape0->lockChildShapes();
+	shape1->lockChildShapes();
 
-		//build planes
-		ptri0.buildTriPlane();
-		ptri1.buildTriPlane();
-		// test conservative
+	#ifdef TRI_COLLISION_PROFILING
+	bt_begin_gim02_tri_time();
+	#endif
 
+	//the chunks of pairs are collided in parallel, then the contacts are added to the manifold in the order of the pairs
+	int chunk_count = (pair_count+BT_GIMPACT_PAIR_CHUNK_SIZE-1)/BT_GIMPACT_PAIR_CHUNK_SIZE;
+	unsigned int thread = btGetCurrentThreadIndex();
+	btAssert(thread < BT_MAX_THREAD_COUNT);
+	btAlignedObjectArray<btGImpactTriangleContactArray> & chunk_contacts = g_sat_chunk_contacts[thread];
+	if (chunk_contacts.size()<chunk_count)
+	{
+		chunk_contacts.resize(chunk_count);
+	}
+	for (int i=0;i<chunk_count;i++)
+	{
+		chunk_contacts[i].resizeNoInitialize(0);
+	}
 
+	btGImpactSatTrianglesLoop loop;
+	loop.m_shape0 = shape0;
+	loop.m_shape1 = shape1;
+	loop.m_trans0 = body0Wrap->getWorldTransform();
+	loop.m_trans1 = body1Wrap->getWorldTransform();
+	loop.m_pairs = pairs;
+	loop.m_pair_count = pair_count;
+	loop.m_chunk_contacts = &chunk_contacts[0];
+	btParallelFor(0,chunk_count,1,loop);
+
+	#ifdef TRI_COLLISION_PROFILING
+	bt_end_gim02_tri_time();
+	#endif
 
-		if(ptri0.overlap_test_conservative(ptri1))
+	for (int i=0;i<chunk_count;i++)
+	{
+		const btGImpactTriangleContactArray & contacts = chunk_contacts[i];
+		for (int j=0;j<contacts.size();j++)
 		{
-			if(ptri0.find_triangle_collision_clip_method(ptri1,contact_data))
-			{
-
-				int j = contact_data.m_point_count;
-				while(j--)
-				{
-
-					addContactPoint(body0Wrap, body1Wrap,
-								contact_data.m_points[j],
-								contact_data.m_separating_normal,
-								-contact_data.m_penetration_depth);
-				}
-			}
+			m_triface0 = contacts[j].m_triface0;
+			m_triface1 = contacts[j].m_triface1;
+			addContactPoint(body0Wrap, body1Wrap,
+						contacts[j].m_point,
+						contacts[j].m_normal,
+						contacts[j].m_distance);
 		}
-
-		#ifdef TRI_COLLISION_PROFILING
-		bt_end_gim02_tri_time();
-		#endif
-
 	}
 
 	shape0->unlockChildShapes();
@@ -151,6 +151,7 @@ protected:
 				  const btGImpactMeshShapePart * shape1,
 				  const int * pairs, int pair_count);
 
+	//! the pairs are collided in parallel chunks with btParallelFor, the contacts are added in the order of the pairs
 	void collide_sat_triangles(const btCollisionObjectWrapper* body0Wrap,
 					  const btCollisionObjectWrapper* body1Wrap,
 					  const btGImpactMeshShapePart * shape0,
@@ -23,6 +23,7 @@ subject to the following restrictions:
 
 #include "btGImpactQuantizedBvh.h"
 #include "LinearMath/btQuickprof.h"
+#include "LinearMath/btThreads.h"
 
 #ifdef TRI_COLLISION_PROFILING
 btClock g_q_tree_clock;
@@ -244,10 +245,10 @@ void btQuantizedBvhTree::build_tree(
 
 ////////////////////////////////////class btGImpactQuantizedBvh
 
-void btGImpactQuantizedBvh::refit()
+void btGImpactQuantizedBvh::refit_nodes(int first_node, int end_node)
 {
-	int nodecount = getNodeCount();
-	while(nodecount--)
+	int nodecount = end_node;
+	while(nodecount-- > first_node)
 	{
 		if(isLeafNode(nodecount))
 		{
@@ -283,6 +284,65 @@ void btGImpactQuantizedBvh::refit()
 	}
 }
 
+struct btGImpactRefitLoop : public btIParallelForBody
+{
+	btGImpactQuantizedBvh * m_bvh;
+	const int * m_subtrees;
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		for (int i=iBegin;i<iEnd;i++)
+		{
+			int root = m_subtrees[i];
+			int node_count = m_bvh->isLeafNode(root) ? 1 : m_bvh->getEscapeNodeIndex(root);
+			m_bvh->refit_nodes(root,root+node_count);
+		}
+	}
+};
+
+void btGImpactQuantizedBvh::refit()
+{
+	int nodecount = getNodeCount();
+	if(nodecount <= GIM_QUANTIZED_BVH_REFIT_SUBTREE_NODES)
+	{
+		refit_nodes(0,nodecount);
+		return;
+	}
+
+	//split the tree into the top nodes and the subtrees below them, a subtree is a contiguous range of nodes
+	btAlignedObjectArray<int> top_nodes;
+	btAlignedObjectArray<int> subtrees;
+	btAlignedObjectArray<int> stack;
+	stack.push_back(0);
+	while(stack.size())
+	{
+		int node = stack[stack.size()-1];
+		stack.pop_back();
+		if(isLeafNode(node) || getEscapeNodeIndex(node) <= GIM_QUANTIZED_BVH_REFIT_SUBTREE_NODES)
+		{
+			subtrees.push_back(node);
+		}
+		else
+		{
+			top_nodes.push_back(node);
+			stack.push_back(getRightNode(node));
+			stack.push_back(getLeftNode(node));
+		}
+	}
+
+	btGImpactRefitLoop loop;
+	loop.m_bvh = this;
+	loop.m_subtrees = &subtrees[0];
+	btParallelFor(0,subtrees.size(),1,loop);
+
+	//a top node is visited before its children, so the reverse order refits the children first
+	int i = top_nodes.size();
+	while(i--)
+	{
+		refit_nodes(top_nodes[i],top_nodes[i]+1);
+	}
+}
+
 //! this rebuild the entire set
 void btGImpactQuantizedBvh::buildSet()
 {
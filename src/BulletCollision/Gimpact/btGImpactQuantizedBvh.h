@@ -94,6 +94,9 @@ ATTRIBUTE_ALIGNED16	(struct) BT_QUANTIZED_BVH_NODE
 
 
 
+//! size of the subtrees that btGImpactQuantizedBvh::refit hands out to the threads
+#define GIM_QUANTIZED_BVH_REFIT_SUBTREE_NODES 512
+
 class GIM_QUANTIZED_BVH_NODE_ARRAY:public btAlignedObjectArray<BT_QUANTIZED_BVH_NODE>
 {
 };
@@ -230,8 +233,13 @@ protected:
 	btPrimitiveManagerBase * m_primitive_manager;
 
 protected:
-	//stackless refit
+	//! refit the nodes of the subtree [first_node,end_node), the children of a node are refitted before the node
+	void refit_nodes(int first_node, int end_node);
+
+	//stackless refit, the subtrees of up to GIM_QUANTIZED_BVH_REFIT_SUBTREE_NODES nodes are refitted in parallel
 	void refit();
+
+	friend struct btGImpactRefitLoop;
 public:
 
 	//! this constructor doesn't build the tree. you must call	buildSet
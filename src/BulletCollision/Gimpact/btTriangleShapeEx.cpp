@@ -86,6 +86,116 @@ bool btPrimitiveTriangle::overlap_test_conservative(const btPrimitiveTriangle& o
     return true;
 }
 
+///class btTrianglePairBatch
+
+//relative tolerance of the batched plane test, it covers the rounding differences with btPrimitiveTriangle::buildTriPlane
+#define BT_TRIANGLE_PAIR_BATCH_TOLERANCE btScalar(1e-5)
+
+void btTrianglePairBatch::setPair(int pair_index, const btPrimitiveTriangle & tri0, const btPrimitiveTriangle & tri1)
+{
+	for (int v=0;v<3;v++)
+	{
+		for (int axis=0;axis<3;axis++)
+		{
+			m_vertices0[v][axis][pair_index] = tri0.m_vertices[v][axis];
+			m_vertices1[v][axis][pair_index] = tri1.m_vertices[v][axis];
+		}
+	}
+	m_margin[pair_index] = tri0.m_margin + tri1.m_margin;
+}
+
+#if defined (BT_USE_SSE) && !defined (BT_USE_DOUBLE_PRECISION)
+
+//! returns the mask of the pairs where all the vertices of other are above the plane of tri, plus the margin
+static SIMD_FORCE_INLINE __m128 bt_triangle_batch_separated(const btScalar tri[3][3][BT_TRIANGLE_PAIR_BATCH_SIZE],
+	const btScalar other[3][3][BT_TRIANGLE_PAIR_BATCH_SIZE], __m128 margin)
+{
+	__m128 v0[3],e1[3],e2[3];
+	for (int axis=0;axis<3;axis++)
+	{
+		v0[axis] = _mm_load_ps(tri[0][axis]);
+		e1[axis] = _mm_sub_ps(_mm_load_ps(tri[1][axis]),v0[axis]);
+		e2[axis] = _mm_sub_ps(_mm_load_ps(tri[2][axis]),v0[axis]);
+	}
+	__m128 n[3];
+	n[0] = _mm_sub_ps(_mm_mul_ps(e1[1],e2[2]),_mm_mul_ps(e1[2],e2[1]));
+	n[1] = _mm_sub_ps(_mm_mul_ps(e1[2],e2[0]),_mm_mul_ps(e1[0],e2[2]));
+	n[2] = _mm_sub_ps(_mm_mul_ps(e1[0],e2[1]),_mm_mul_ps(e1[1],e2[0]));
+	__m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(n[0],n[0]),_mm_mul_ps(n[1],n[1])),_mm_mul_ps(n[2],n[2])));
+	//degenerate triangles are never separated
+	__m128 valid = _mm_cmpgt_ps(len,_mm_setzero_ps());
+	len = _mm_max_ps(len,_mm_set1_ps(SIMD_EPSILON));
+	for (int axis=0;axis<3;axis++)
+		n[axis] = _mm_div_ps(n[axis],len);
+
+	__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(n[0],v0[0]),_mm_mul_ps(n[1],v0[1])),_mm_mul_ps(n[2],v0[2]));
+	__m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	__m128 scale = _mm_add_ps(_mm_add_ps(_mm_and_ps(v0[0],absMask),_mm_and_ps(v0[1],absMask)),_mm_add_ps(_mm_and_ps(v0[2],absMask),_mm_set1_ps(1.f)));
+	__m128 tolerance = _mm_mul_ps(scale,_mm_set1_ps(BT_TRIANGLE_PAIR_BATCH_TOLERANCE));
+	__m128 limit = _mm_add_ps(_mm_add_ps(d,margin),tolerance);
+
+	__m128 separated = valid;
+	for (int v=0;v<3;v++)
+	{
+		__m128 dist = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(n[0],_mm_load_ps(other[v][0])),
+			_mm_mul_ps(n[1],_mm_load_ps(other[v][1]))),
+			_mm_mul_ps(n[2],_mm_load_ps(other[v][2])));
+		separated = _mm_and_ps(separated,_mm_cmpgt_ps(dist,limit));
+	}
+	return separated;
+}
+
+int btTrianglePairBatch::overlapTestConservative() const
+{
+	__m128 margin = _mm_load_ps(m_margin);
+	__m128 separated = _mm_or_ps(bt_triangle_batch_separated(m_vertices0,m_vertices1,margin),
+		bt_triangle_batch_separated(m_vertices1,m_vertices0,margin));
+	return ~_mm_movemask_ps(separated) & ((1<<BT_TRIANGLE_PAIR_BATCH_SIZE)-1);
+}
+
+#else
+
+static SIMD_FORCE_INLINE bool bt_triangle_batch_separated(const btScalar tri[3][3][BT_TRIANGLE_PAIR_BATCH_SIZE],
+	const btScalar other[3][3][BT_TRIANGLE_PAIR_BATCH_SIZE], btScalar margin, int pair)
+{
+	btVector3 v0(tri[0][0][pair],tri[0][1][pair],tri[0][2][pair]);
+	btVector3 v1(tri[1][0][pair],tri[1][1][pair],tri[1][2][pair]);
+	btVector3 v2(tri[2][0][pair],tri[2][1][pair],tri[2][2][pair]);
+	btVector3 normal = (v1-v0).cross(v2-v0);
+	btScalar len = normal.length();
+	//degenerate triangles are never separated
+	if (len <= btScalar(0.))
+		return false;
+	normal /= len;
+	btScalar d = normal.dot(v0);
+	btScalar scale = btFabs(v0[0])+btFabs(v0[1])+btFabs(v0[2])+btScalar(1.);
+	btScalar limit = d + margin + scale*BT_TRIANGLE_PAIR_BATCH_TOLERANCE;
+	for (int v=0;v<3;v++)
+	{
+		btVector3 point(other[v][0][pair],other[v][1][pair],other[v][2][pair]);
+		if (normal.dot(point) <= limit)
+			return false;
+	}
+	return true;
+}
+
+int btTrianglePairBatch::overlapTestConservative() const
+{
+	int mask = 0;
+	for (int pair=0;pair<BT_TRIANGLE_PAIR_BATCH_SIZE;pair++)
+	{
+		if (!bt_triangle_batch_separated(m_vertices0,m_vertices1,m_margin[pair],pair) &&
+			!bt_triangle_batch_separated(m_vertices1,m_vertices0,m_margin[pair],pair))
+		{
+			mask |= 1<<pair;
+		}
+	}
+	return mask;
+}
+
+#endif //BT_USE_SSE
+
 int btPrimitiveTriangle::clip_triangle(btPrimitiveTriangle & other, btVector3 * clipped_points )
 {
     // edge 0
@@ -127,6 +127,29 @@ public:
 };
 
 
+#define BT_TRIANGLE_PAIR_BATCH_SIZE 4
+
+//! Triangle pairs in SoA layout, for testing several pairs at once
+/*!
+overlapTestConservative does the test of btPrimitiveTriangle::overlap_test_conservative on all the pairs using SSE when available.
+It is meant for culling: the planes are computed with a small tolerance, so it never rejects a pair that
+btPrimitiveTriangle::overlap_test_conservative accepts, but it may accept a few more.
+*/
+ATTRIBUTE_ALIGNED16(struct) btTrianglePairBatch
+{
+	//! vertices of the first and second triangle of each pair, [vertex][axis][pair]
+	btScalar m_vertices0[3][3][BT_TRIANGLE_PAIR_BATCH_SIZE];
+	btScalar m_vertices1[3][3][BT_TRIANGLE_PAIR_BATCH_SIZE];
+	//! sum of the margins of the triangles
+	btScalar m_margin[BT_TRIANGLE_PAIR_BATCH_SIZE];
+
+	void setPair(int pair_index, const btPrimitiveTriangle & tri0, const btPrimitiveTriangle & tri1);
+
+	//! returns a bit mask of the pairs that may collide
+	int overlapTestConservative() const;
+};
+
+
 
 //! Helper class for colliding Bullet Triangle Shapes
 /*!
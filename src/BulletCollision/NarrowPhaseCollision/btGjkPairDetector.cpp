@@ -17,6 +17,7 @@ subject to the following restrictions:
 #include "BulletCollision/CollisionShapes/btConvexShape.h"
 #include "BulletCollision/NarrowPhaseCollision/btSimplexSolverInterface.h"
 #include "BulletCollision/NarrowPhaseCollision/btConvexPenetrationDepthSolver.h"
+#include "LinearMath/btThreads.h"
 
 
 
@@ -98,7 +99,11 @@ void btGjkPairDetector::getClosestPointsNonVirtual(const ClosestPointInput& inpu
 	btScalar marginA = m_marginA;
 	btScalar marginB = m_marginB;
 
+#if BT_THREADSAFE
+	btAtomicFetchAdd(&gNumGjkChecks,1);
+#else
 	gNumGjkChecks++;
+#endif
 
 #ifdef DEBUG_SPU_COLLISION_DETECTION
 	spu_printf("inside gjk\n");
@@ -345,7 +350,11 @@ void btGjkPairDetector::getClosestPointsNonVirtual(const ClosestPointInput& inpu
 				// Penetration depth case.
 				btVector3 tmpPointOnA,tmpPointOnB;
 				
+#if BT_THREADSAFE
+				btAtomicFetchAdd(&gNumDeepPenetrationChecks,1);
+#else
 				gNumDeepPenetrationChecks++;
+#endif
 				m_cachedSeparatingAxis.setZero();
 
 				bool isValid2 = m_penetrationDepthSolver->calcPenDepth( 
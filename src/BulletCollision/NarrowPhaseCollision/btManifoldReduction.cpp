@@ -0,0 +1,366 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btManifoldReduction.h"
+
+///sort the candidate points by depth, the index makes the order unique
+class btSortCandidatePredicate
+{
+	const btAlignedObjectArray<btManifoldPoint>&	m_candidates;
+
+public:
+
+	btSortCandidatePredicate(const btAlignedObjectArray<btManifoldPoint>& candidates)
+		:m_candidates(candidates)
+	{
+	}
+
+	bool operator() (int lhs, int rhs) const
+	{
+		btScalar lhsDistance = m_candidates[lhs].getDistance();
+		btScalar rhsDistance = m_candidates[rhs].getDistance();
+		if (lhsDistance != rhsDistance)
+			return lhsDistance < rhsDistance;
+		return lhs < rhs;
+	}
+};
+
+///express the point of a manifold between (body1,body0) as a point between (body0,body1)
+static void btFlipManifoldPoint(btManifoldPoint& pt)
+{
+	btSwap(pt.m_localPointA,pt.m_localPointB);
+	btSwap(pt.m_positionWorldOnA,pt.m_positionWorldOnB);
+	pt.m_normalWorldOnB = -pt.m_normalWorldOnB;
+	btSwap(pt.m_partId0,pt.m_partId1);
+	btSwap(pt.m_index0,pt.m_index1);
+}
+
+btManifoldReduction::btManifoldReduction()
+:m_maxPoints(4),
+m_clusterRadius(btScalar(0.02)),
+m_clusterNormalCosine(btScalar(0.95))
+{
+}
+
+btManifoldReduction::~btManifoldReduction()
+{
+	clear();
+}
+
+void	btManifoldReduction::setMaxPoints(int maxPoints)
+{
+	m_maxPoints = btMax(1,btMin(maxPoints,int(MANIFOLD_CACHE_SIZE)));
+}
+
+btPersistentManifold*	btManifoldReduction::allocateManifold(const btPersistentManifold* source, const btCollisionObject* body0, const btCollisionObject* body1)
+{
+	void* mem = btAlignedAlloc(sizeof(btPersistentManifold),16);
+	btPersistentManifold* manifold = new(mem) btPersistentManifold(body0,body1,0,source->getContactBreakingThreshold(),source->getContactProcessingThreshold());
+	manifold->m_companionIdA = source->m_companionIdA;
+	manifold->m_companionIdB = source->m_companionIdB;
+	manifold->m_index1a = -1;
+	return manifold;
+}
+
+void	btManifoldReduction::freeManifold(btPersistentManifold* manifold)
+{
+	//the reduced points never own user persistent data, so there is nothing to clear
+	manifold->~btPersistentManifold();
+	btAlignedFree(manifold);
+}
+
+void	btManifoldReduction::clear()
+{
+	for (int i=0;i<m_pairs.size();i++)
+	{
+		freeManifold(m_pairs[i].m_manifold);
+	}
+	m_pairs.clear();
+	m_pairMap.clear();
+	m_sourceMap.clear();
+}
+
+void	btManifoldReduction::removePair(int pairIndex)
+{
+	ReducedPair& pair = m_pairs[pairIndex];
+	freeManifold(pair.m_manifold);
+	m_pairMap.remove(btManifoldPairKey(pair.m_body0,pair.m_body1));
+
+	int lastIndex = m_pairs.size()-1;
+	if (pairIndex != lastIndex)
+	{
+		pair = m_pairs[lastIndex];
+		m_pairMap.insert(btManifoldPairKey(pair.m_body0,pair.m_body1),pairIndex);
+		for (int i=0;i<m_sourceMap.size();i++)
+		{
+			int* source = m_sourceMap.getAtIndex(i);
+			if ((*source>>1) == lastIndex)
+				*source = 2*pairIndex+(*source & 1);
+		}
+	}
+	m_pairs.pop_back();
+}
+
+void	btManifoldReduction::removeManifold(const btPersistentManifold* manifold)
+{
+	const int* source = m_sourceMap.find(btHashPtr(manifold));
+	if (!source)
+		return;
+	int pairIndex = *source>>1;
+	m_sourceMap.remove(btHashPtr(manifold));
+
+	//the objects may be deleted once their last manifold is gone, and new objects may get the same addresses
+	if (--m_pairs[pairIndex].m_numSources == 0)
+		removePair(pairIndex);
+}
+
+void	btManifoldReduction::reducePair(ReducedPair& pair, btPersistentManifold** manifolds, int first, int end)
+{
+	int i,j;
+
+	//gather the contacts of all manifolds, as seen from (body0,body1)
+	m_candidates.resize(0);
+	for (i=first;i<end;i++)
+	{
+		const btPersistentManifold* manifold = manifolds[m_groupManifolds[i]];
+		bool flip = manifold->getBody0() != pair.m_body0;
+		for (j=0;j<manifold->getNumContacts();j++)
+		{
+			const btManifoldPoint& pt = manifold->getContactPoint(j);
+			if (pt.getDistance() > manifold->getContactProcessingThreshold())
+				continue;
+			m_candidates.push_back(pt);
+			btManifoldPoint& candidate = m_candidates[m_candidates.size()-1];
+			candidate.m_userPersistentData = 0;
+			if (flip)
+				btFlipManifoldPoint(candidate);
+		}
+	}
+
+	m_order.resize(m_candidates.size());
+	for (i=0;i<m_candidates.size();i++)
+		m_order[i] = i;
+	m_order.quickSort(btSortCandidatePredicate(m_candidates));
+
+	//greedy clustering, the first (deepest) point of a cluster represents it
+	btScalar radius2 = m_clusterRadius*m_clusterRadius;
+	m_clusters.resize(0);
+	for (i=0;i<m_order.size();i++)
+	{
+		const btManifoldPoint& pt = m_candidates[m_order[i]];
+		bool merged = false;
+		for (j=0;j<m_clusters.size() && !merged;j++)
+		{
+			const btManifoldPoint& rep = m_candidates[m_clusters[j]];
+			merged = (pt.m_positionWorldOnB-rep.m_positionWorldOnB).length2() <= radius2 &&
+				pt.m_normalWorldOnB.dot(rep.m_normalWorldOnB) >= m_clusterNormalCosine;
+		}
+		if (!merged)
+			m_clusters.push_back(m_order[i]);
+	}
+
+	//keep the deepest point, then repeatedly add the point that is farthest from the points kept so far
+	m_selected.resize(0);
+	if (m_clusters.size() <= m_maxPoints)
+	{
+		m_selected = m_clusters;
+	} else
+	{
+		//m_minDistance2[j] is the squared distance of cluster j to the nearest selected point, -1 once it is selected
+		int numClusters = m_clusters.size();
+		m_minDistance2.resize(numClusters);
+		m_selected.push_back(m_clusters[0]);
+		m_minDistance2[0] = btScalar(-1.);
+		for (j=1;j<numClusters;j++)
+			m_minDistance2[j] = (m_candidates[m_clusters[j]].m_positionWorldOnB-m_candidates[m_clusters[0]].m_positionWorldOnB).length2();
+		while (m_selected.size() < m_maxPoints)
+		{
+			int best = 0;
+			for (j=1;j<numClusters;j++)
+			{
+				if (m_minDistance2[j] > m_minDistance2[best])
+					best = j;
+			}
+			const btVector3& bestPosition = m_candidates[m_clusters[best]].m_positionWorldOnB;
+			m_selected.push_back(m_clusters[best]);
+			m_minDistance2[best] = btScalar(-1.);
+			for (j=1;j<numClusters;j++)
+			{
+				if (m_minDistance2[j] >= btScalar(0.))
+					m_minDistance2[j] = btMin(m_minDistance2[j],(m_candidates[m_clusters[j]].m_positionWorldOnB-bestPosition).length2());
+			}
+		}
+	}
+
+	//warm start: take the impulses of the nearest point of the previous reduced manifold
+	btPersistentManifold* manifold = pair.m_manifold;
+	btManifoldPoint previousPoints[MANIFOLD_CACHE_SIZE];
+	bool used[MANIFOLD_CACHE_SIZE];
+	int numPrevious = manifold->getNumContacts();
+	for (i=0;i<numPrevious;i++)
+	{
+		previousPoints[i] = manifold->getContactPoint(i);
+		used[i] = false;
+	}
+	btScalar breaking2 = manifold->getContactBreakingThreshold()*manifold->getContactBreakingThreshold();
+
+	manifold->setNumContacts(m_selected.size());
+	for (i=0;i<m_selected.size();i++)
+	{
+		btManifoldPoint& pt = manifold->getContactPoint(i);
+		pt = m_candidates[m_selected[i]];
+
+		int nearest = -1;
+		btScalar nearestDistance2 = breaking2;
+		for (j=0;j<numPrevious;j++)
+		{
+			btScalar d2 = (previousPoints[j].m_localPointA-pt.m_localPointA).length2();
+			if (!used[j] && d2 < nearestDistance2)
+			{
+				nearestDistance2 = d2;
+				nearest = j;
+			}
+		}
+		if (nearest>=0)
+		{
+			const btManifoldPoint& previous = previousPoints[nearest];
+			used[nearest] = true;
+			pt.m_appliedImpulse = previous.m_appliedImpulse;
+			pt.m_appliedImpulseLateral1 = previous.m_appliedImpulseLateral1;
+			pt.m_appliedImpulseLateral2 = previous.m_appliedImpulseLateral2;
+			pt.m_lateralFrictionInitialized = previous.m_lateralFrictionInitialized;
+			pt.m_lateralFrictionDir1 = previous.m_lateralFrictionDir1;
+			pt.m_lateralFrictionDir2 = previous.m_lateralFrictionDir2;
+			pt.m_lifeTime = previous.m_lifeTime+1;
+		} else
+		{
+			//the impulses of the narrowphase points are never solved while the pair is reduced
+			pt.m_appliedImpulse = btScalar(0.);
+			pt.m_appliedImpulseLateral1 = btScalar(0.);
+			pt.m_appliedImpulseLateral2 = btScalar(0.);
+			pt.m_lateralFrictionInitialized = false;
+			pt.m_lifeTime = 0;
+		}
+	}
+}
+
+void	btManifoldReduction::reduceManifolds(btPersistentManifold** manifolds, int numManifolds)
+{
+	int i;
+
+	//group the manifolds by pair of objects, in the order of their first manifold
+	m_groupMap.clear();
+	m_groupOfManifold.resize(numManifolds);
+	int numGroups = 0;
+	for (i=0;i<numManifolds;i++)
+	{
+		btManifoldPairKey key(manifolds[i]->getBody0(),manifolds[i]->getBody1());
+		int* group = m_groupMap.find(key);
+		if (group)
+		{
+			m_groupOfManifold[i] = *group;
+		} else
+		{
+			m_groupMap.insert(key,numGroups);
+			m_groupOfManifold[i] = numGroups++;
+		}
+	}
+	m_groupStart.resize(numGroups+1);
+	for (i=0;i<=numGroups;i++)
+		m_groupStart[i] = 0;
+	for (i=0;i<numManifolds;i++)
+		m_groupStart[m_groupOfManifold[i]+1]++;
+	for (i=0;i<numGroups;i++)
+		m_groupStart[i+1] += m_groupStart[i];
+	m_groupManifolds.resize(numManifolds);
+	m_order.resize(numGroups);
+	for (i=0;i<numGroups;i++)
+		m_order[i] = m_groupStart[i];
+	for (i=0;i<numManifolds;i++)
+		m_groupManifolds[m_order[m_groupOfManifold[i]]++] = i;
+
+	//m_pairMap still refers to m_previousPairs until the new pairs are built
+	m_previousPairs.copyFromArray(m_pairs);
+	m_pairs.resize(0);
+	m_sourceMap.clear();
+
+	for (int g=0;g<numGroups;g++)
+	{
+		int first = m_groupStart[g];
+		int end = m_groupStart[g+1];
+		int numWithContacts = 0;
+		int numContacts = 0;
+		for (i=first;i<end;i++)
+		{
+			int n = manifolds[m_groupManifolds[i]]->getNumContacts();
+			numWithContacts += n ? 1 : 0;
+			numContacts += n;
+		}
+		if (numWithContacts<2 && numContacts<=m_maxPoints)
+			continue;
+
+		const btPersistentManifold* firstManifold = manifolds[m_groupManifolds[first]];
+		ReducedPair pair;
+		const int* previousIndex = m_pairMap.find(btManifoldPairKey(firstManifold->getBody0(),firstManifold->getBody1()));
+		if (previousIndex && m_previousPairs[*previousIndex].m_manifold)
+		{
+			pair = m_previousPairs[*previousIndex];
+			m_previousPairs[*previousIndex].m_manifold = 0;
+		} else
+		{
+			pair.m_body0 = firstManifold->getBody0();
+			pair.m_body1 = firstManifold->getBody1();
+			pair.m_manifold = allocateManifold(firstManifold,pair.m_body0,pair.m_body1);
+		}
+		reducePair(pair,manifolds,first,end);
+		pair.m_numSources = end-first;
+
+		int pairIndex = m_pairs.size();
+		m_pairs.push_back(pair);
+		for (i=first;i<end;i++)
+		{
+			m_sourceMap.insert(btHashPtr(manifolds[m_groupManifolds[i]]),2*pairIndex+(i==first ? 1 : 0));
+		}
+	}
+
+	//release the reduced manifolds of the pairs that are gone
+	for (i=0;i<m_previousPairs.size();i++)
+	{
+		if (m_previousPairs[i].m_manifold)
+			freeManifold(m_previousPairs[i].m_manifold);
+	}
+	m_previousPairs.resize(0);
+
+	m_pairMap.clear();
+	for (i=0;i<m_pairs.size();i++)
+	{
+		m_pairMap.insert(btManifoldPairKey(m_pairs[i].m_body0,m_pairs[i].m_body1),i);
+	}
+}
+
+void	btManifoldReduction::substituteManifolds(btPersistentManifold** manifolds, int numManifolds, btAlignedObjectArray<btPersistentManifold*>& reducedManifolds) const
+{
+	for (int i=0;i<numManifolds;i++)
+	{
+		const int* source = m_sourceMap.find(btHashPtr(manifolds[i]));
+		if (!source)
+		{
+			reducedManifolds.push_back(manifolds[i]);
+		} else if (*source & 1)
+		{
+			reducedManifolds.push_back(m_pairs[*source>>1].m_manifold);
+		}
+	}
+}
@@ -0,0 +1,174 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_MANIFOLD_REDUCTION_H
+#define BT_MANIFOLD_REDUCTION_H
+
+#include "btPersistentManifold.h"
+#include "LinearMath/btAlignedObjectArray.h"
+#include "LinearMath/btHashMap.h"
+
+class btCollisionObject;
+
+///btManifoldPairKey identifies a pair of collision objects, independent of their order
+struct btManifoldPairKey
+{
+	const void*	m_object0;
+	const void*	m_object1;
+
+	btManifoldPairKey(const void* object0, const void* object1)
+	{
+		//sort the pointers, so that (a,b) and (b,a) are the same key
+		if (object1 < object0)
+		{
+			const void* tmp = object0;
+			object0 = object1;
+			object1 = tmp;
+		}
+		m_object0 = object0;
+		m_object1 = object1;
+	}
+
+	bool equals(const btManifoldPairKey& other) const
+	{
+		return m_object0 == other.m_object0 && m_object1 == other.m_object1;
+	}
+
+	SIMD_FORCE_INLINE unsigned int getHash() const
+	{
+		return btHashPtr(m_object0).getHash() * 31u + btHashPtr(m_object1).getHash();
+	}
+};
+
+///btManifoldReduction merges the contact manifolds of a pair of collision objects into a single manifold with a few representative points.
+///Compound shapes create one manifold per child shape, so a compound lying on the ground can feed the solver many redundant contacts.
+///reduceManifolds is called once per step after the narrowphase: for each pair that has more than one manifold with contacts, the points
+///are clustered (by distance and normal direction), the deepest point of each cluster is kept and, if there are too many clusters,
+///the points that span the largest area are chosen, starting with the deepest one.
+///The reduced manifolds are kept across frames, the applied impulses of a reduced point are carried over to the nearest point of the next frame (warm starting).
+///substituteManifolds replaces the manifolds of the reduced pairs by their reduced manifold in the list that is passed to the constraint solver.
+///The narrowphase manifolds themselves are not modified.
+///The dispatcher reports the manifolds it releases (see btDispatcher::setManifoldReduction), a pair is dropped once all its manifolds are
+///released, so no pair outlives the removal of the broadphase pair or of one of its objects.
+class btManifoldReduction
+{
+	struct ReducedPair
+	{
+		const btCollisionObject*	m_body0;
+		const btCollisionObject*	m_body1;
+		btPersistentManifold*		m_manifold;
+		///the number of narrowphase manifolds of the pair in m_sourceMap
+		int							m_numSources;
+	};
+
+	int			m_maxPoints;
+	btScalar	m_clusterRadius;
+	btScalar	m_clusterNormalCosine;
+
+	btAlignedObjectArray<ReducedPair>			m_pairs;
+	btHashMap<btManifoldPairKey,int>			m_pairMap;
+	///the value is 2*pairIndex+1 for the manifold that gets substituted by the reduced manifold, 2*pairIndex for the other manifolds of the pair
+	btHashMap<btHashPtr,int>					m_sourceMap;
+
+	//temporary data of reduceManifolds
+	btHashMap<btManifoldPairKey,int>			m_groupMap;
+	btAlignedObjectArray<ReducedPair>			m_previousPairs;
+	btAlignedObjectArray<int>					m_groupOfManifold;
+	btAlignedObjectArray<int>					m_groupStart;
+	btAlignedObjectArray<int>					m_groupManifolds;
+	btAlignedObjectArray<btManifoldPoint>		m_candidates;
+	btAlignedObjectArray<int>					m_order;
+	btAlignedObjectArray<int>					m_clusters;
+	btAlignedObjectArray<int>					m_selected;
+	btAlignedObjectArray<btScalar>				m_minDistance2;
+
+	btPersistentManifold*	allocateManifold(const btPersistentManifold* source, const btCollisionObject* body0, const btCollisionObject* body1);
+
+	void	freeManifold(btPersistentManifold* manifold);
+
+	///release the reduced manifold of m_pairs[pairIndex] and remove the pair, the last pair takes its index
+	void	removePair(int pairIndex);
+
+	///reduce the manifolds m_groupManifolds[first..end) into pair.m_manifold
+	void	reducePair(ReducedPair& pair, btPersistentManifold** manifolds, int first, int end);
+
+public:
+
+	btManifoldReduction();
+
+	virtual ~btManifoldReduction();
+
+	///the maximum number of points of a reduced manifold, clamped to [1,MANIFOLD_CACHE_SIZE], 4 by default
+	void	setMaxPoints(int maxPoints);
+
+	int		getMaxPoints() const
+	{
+		return m_maxPoints;
+	}
+
+	///points that are closer than the cluster radius and have similar normals are merged into one
+	void	setClusterRadius(btScalar radius)
+	{
+		m_clusterRadius = radius;
+	}
+
+	btScalar	getClusterRadius() const
+	{
+		return m_clusterRadius;
+	}
+
+	///two points can only be merged when the cosine of the angle between their normals is at least this value
+	void	setClusterNormalCosine(btScalar cosine)
+	{
+		m_clusterNormalCosine = cosine;
+	}
+
+	btScalar	getClusterNormalCosine() const
+	{
+		return m_clusterNormalCosine;
+	}
+
+	///build the reduced manifolds from the narrowphase manifolds, usually all the manifolds of the dispatcher.
+	///The reduced manifolds of pairs that don't need a reduction anymore are released.
+	void	reduceManifolds(btPersistentManifold** manifolds, int numManifolds);
+
+	///append the manifolds to reducedManifolds, replacing the manifolds of the reduced pairs by their reduced manifold.
+	///It only reads the result of reduceManifolds, so it can be called by several threads at once.
+	void	substituteManifolds(btPersistentManifold** manifolds, int numManifolds, btAlignedObjectArray<btPersistentManifold*>& reducedManifolds) const;
+
+	int		getNumReducedPairs() const
+	{
+		return m_pairs.size();
+	}
+
+	btPersistentManifold*	getReducedManifold(int pairIndex)
+	{
+		return m_pairs[pairIndex].m_manifold;
+	}
+
+	const btPersistentManifold*	getReducedManifold(int pairIndex) const
+	{
+		return m_pairs[pairIndex].m_manifold;
+	}
+
+	///called by the dispatcher before it releases a narrowphase manifold, when the broadphase pair or one of its objects is removed.
+	///The reduced pair is removed with the last of its manifolds.
+	void	removeManifold(const btPersistentManifold* manifold);
+
+	///release all reduced manifolds
+	void	clear();
+};
+
+#endif //BT_MANIFOLD_REDUCTION_H
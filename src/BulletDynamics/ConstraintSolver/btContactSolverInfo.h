@@ -29,7 +29,10 @@ enum	btSolverMode
 	SOLVER_CACHE_FRIENDLY = 128,
 	SOLVER_SIMD = 256,
 	SOLVER_INTERLEAVE_CONTACT_AND_FRICTION_CONSTRAINTS = 512,
-	SOLVER_ALLOW_ZERO_LENGTH_FRICTION_DIRECTIONS = 1024
+	SOLVER_ALLOW_ZERO_LENGTH_FRICTION_DIRECTIONS = 1024,
+	///solve the contact and friction rows in batches of 4 rows that don't share a dynamic body, using SSE/NEON if available.
+	///SOLVER_RANDMIZE_ORDER and SOLVER_INTERLEAVE_CONTACT_AND_FRICTION_CONSTRAINTS are ignored for those rows.
+	SOLVER_BATCH_CONTACT_CONSTRAINTS = 2048
 };
 
 struct btContactSolverInfoData
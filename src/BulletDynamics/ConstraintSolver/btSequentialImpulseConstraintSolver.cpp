@@ -26,6 +26,7 @@ subject to the following restrictions:
 #include <new>
 #include "LinearMath/btStackAlloc.h"
 #include "LinearMath/btQuickprof.h"
+#include "LinearMath/btThreads.h"
 //#include "btSolverBody.h"
 //#include "btSolverConstraint.h"
 #include "LinearMath/btAlignedObjectArray.h"
@@ -45,6 +46,13 @@ btSequentialImpulseConstraintSolver::~btSequentialImpulseConstraintSolver()
 {
 }
 
+///binds the array to capacity elements of the stack allocator, it only grows on the heap beyond that
+template <typename T>
+static void	initializeFromStackAlloc(btAlignedObjectArray<T>& array, btStackAlloc* stackAlloc, int capacity)
+{
+	array.initializeFromBuffer(stackAlloc->allocate(sizeof(T)*capacity),0,capacity);
+}
+
 #ifdef USE_SIMD
 #include <emmintrin.h>
 #define btVecSplat(x, e) _mm_shuffle_ps(x, x, _MM_SHUFFLE(e,e,e,e))
@@ -55,6 +63,226 @@ static inline __m128 btSimdDot3( __m128 vec0, __m128 vec1 )
 }
 #endif//USE_SIMD
 
+///btBatchScalar holds one btScalar for each row of a btSolverConstraintBatch
+#if defined (USE_SIMD)
+typedef __m128	btBatchScalar;
+static SIMD_FORCE_INLINE btBatchScalar btBatchLoad(const btScalar* ptr) { return _mm_load_ps(ptr); }
+static SIMD_FORCE_INLINE void btBatchStore(btScalar* ptr, const btBatchScalar& v) { _mm_store_ps(ptr,v); }
+static SIMD_FORCE_INLINE btBatchScalar btBatchAdd(const btBatchScalar& a, const btBatchScalar& b) { return _mm_add_ps(a,b); }
+static SIMD_FORCE_INLINE btBatchScalar btBatchSub(const btBatchScalar& a, const btBatchScalar& b) { return _mm_sub_ps(a,b); }
+static SIMD_FORCE_INLINE btBatchScalar btBatchMul(const btBatchScalar& a, const btBatchScalar& b) { return _mm_mul_ps(a,b); }
+static SIMD_FORCE_INLINE btBatchScalar btBatchMin(const btBatchScalar& a, const btBatchScalar& b) { return _mm_min_ps(a,b); }
+static SIMD_FORCE_INLINE btBatchScalar btBatchMax(const btBatchScalar& a, const btBatchScalar& b) { return _mm_max_ps(a,b); }
+#elif defined (BT_USE_NEON)
+typedef float32x4_t	btBatchScalar;
+static SIMD_FORCE_INLINE btBatchScalar btBatchLoad(const btScalar* ptr) { return vld1q_f32(ptr); }
+static SIMD_FORCE_INLINE void btBatchStore(btScalar* ptr, const btBatchScalar& v) { vst1q_f32(ptr,v); }
+static SIMD_FORCE_INLINE btBatchScalar btBatchAdd(const btBatchScalar& a, const btBatchScalar& b) { return vaddq_f32(a,b); }
+static SIMD_FORCE_INLINE btBatchScalar btBatchSub(const btBatchScalar& a, const btBatchScalar& b) { return vsubq_f32(a,b); }
+static SIMD_FORCE_INLINE btBatchScalar btBatchMul(const btBatchScalar& a, const btBatchScalar& b) { return vmulq_f32(a,b); }
+static SIMD_FORCE_INLINE btBatchScalar btBatchMin(const btBatchScalar& a, const btBatchScalar& b) { return vminq_f32(a,b); }
+static SIMD_FORCE_INLINE btBatchScalar btBatchMax(const btBatchScalar& a, const btBatchScalar& b) { return vmaxq_f32(a,b); }
+#else
+struct btBatchScalar
+{
+	btScalar	m_lanes[BT_SOLVER_BATCH_WIDTH];
+};
+static SIMD_FORCE_INLINE btBatchScalar btBatchLoad(const btScalar* ptr) { btBatchScalar r; for (int i=0;i<BT_SOLVER_BATCH_WIDTH;i++) r.m_lanes[i] = ptr[i]; return r; }
+static SIMD_FORCE_INLINE void btBatchStore(btScalar* ptr, const btBatchScalar& v) { for (int i=0;i<BT_SOLVER_BATCH_WIDTH;i++) ptr[i] = v.m_lanes[i]; }
+static SIMD_FORCE_INLINE btBatchScalar btBatchAdd(const btBatchScalar& a, const btBatchScalar& b) { btBatchScalar r; for (int i=0;i<BT_SOLVER_BATCH_WIDTH;i++) r.m_lanes[i] = a.m_lanes[i]+b.m_lanes[i]; return r; }
+static SIMD_FORCE_INLINE btBatchScalar btBatchSub(const btBatchScalar& a, const btBatchScalar& b) { btBatchScalar r; for (int i=0;i<BT_SOLVER_BATCH_WIDTH;i++) r.m_lanes[i] = a.m_lanes[i]-b.m_lanes[i]; return r; }
+static SIMD_FORCE_INLINE btBatchScalar btBatchMul(const btBatchScalar& a, const btBatchScalar& b) { btBatchScalar r; for (int i=0;i<BT_SOLVER_BATCH_WIDTH;i++) r.m_lanes[i] = a.m_lanes[i]*b.m_lanes[i]; return r; }
+static SIMD_FORCE_INLINE btBatchScalar btBatchMin(const btBatchScalar& a, const btBatchScalar& b) { btBatchScalar r; for (int i=0;i<BT_SOLVER_BATCH_WIDTH;i++) r.m_lanes[i] = btMin(a.m_lanes[i],b.m_lanes[i]); return r; }
+static SIMD_FORCE_INLINE btBatchScalar btBatchMax(const btBatchScalar& a, const btBatchScalar& b) { btBatchScalar r; for (int i=0;i<BT_SOLVER_BATCH_WIDTH;i++) r.m_lanes[i] = btMax(a.m_lanes[i],b.m_lanes[i]); return r; }
+#endif
+
+static SIMD_FORCE_INLINE btBatchScalar btBatchDot3(const btScalar a[3][BT_SOLVER_BATCH_WIDTH], const btScalar b[3][BT_SOLVER_BATCH_WIDTH])
+{
+	btBatchScalar result = btBatchMul(btBatchLoad(a[0]),btBatchLoad(b[0]));
+	result = btBatchAdd(result,btBatchMul(btBatchLoad(a[1]),btBatchLoad(b[1])));
+	return btBatchAdd(result,btBatchMul(btBatchLoad(a[2]),btBatchLoad(b[2])));
+}
+
+///v += a*s
+static SIMD_FORCE_INLINE void btBatchAddScaled3(btScalar v[3][BT_SOLVER_BATCH_WIDTH], const btScalar a[3][BT_SOLVER_BATCH_WIDTH], const btBatchScalar& s)
+{
+	for (int i=0;i<3;i++)
+		btBatchStore(v[i],btBatchAdd(btBatchLoad(v[i]),btBatchMul(btBatchLoad(a[i]),s)));
+}
+
+///v -= a*s
+static SIMD_FORCE_INLINE void btBatchSubScaled3(btScalar v[3][BT_SOLVER_BATCH_WIDTH], const btScalar a[3][BT_SOLVER_BATCH_WIDTH], const btBatchScalar& s)
+{
+	for (int i=0;i<3;i++)
+		btBatchStore(v[i],btBatchSub(btBatchLoad(v[i]),btBatchMul(btBatchLoad(a[i]),s)));
+}
+
+static SIMD_FORCE_INLINE void btBatchSetVector3(btScalar v[3][BT_SOLVER_BATCH_WIDTH], int lane, const btVector3& value)
+{
+	v[0][lane] = value.getX();
+	v[1][lane] = value.getY();
+	v[2][lane] = value.getZ();
+}
+
+static SIMD_FORCE_INLINE btVector3 btBatchGetVector3(const btScalar v[3][BT_SOLVER_BATCH_WIDTH], int lane)
+{
+	return btVector3(v[0][lane],v[1][lane],v[2][lane]);
+}
+
+void btSequentialImpulseConstraintSolver::resolveConstraintBatch(btSolverConstraintBatch& batch)
+{
+	ATTRIBUTE_ALIGNED16(btScalar	deltaLinearVelocityA[3][BT_SOLVER_BATCH_WIDTH]);
+	ATTRIBUTE_ALIGNED16(btScalar	deltaAngularVelocityA[3][BT_SOLVER_BATCH_WIDTH]);
+	ATTRIBUTE_ALIGNED16(btScalar	deltaLinearVelocityB[3][BT_SOLVER_BATCH_WIDTH]);
+	ATTRIBUTE_ALIGNED16(btScalar	deltaAngularVelocityB[3][BT_SOLVER_BATCH_WIDTH]);
+
+	int lane;
+	const btVector3 zero(0,0,0);
+
+	//gather the body velocities into SoA layout, unused lanes get zero velocity
+	for (lane=0;lane<BT_SOLVER_BATCH_WIDTH;lane++)
+	{
+		int idA = batch.m_solverBodyIdA[lane];
+		int idB = batch.m_solverBodyIdB[lane];
+		btBatchSetVector3(deltaLinearVelocityA,lane,idA>=0 ? m_tmpSolverBodyPool[idA].internalGetDeltaLinearVelocity() : zero);
+		btBatchSetVector3(deltaAngularVelocityA,lane,idA>=0 ? m_tmpSolverBodyPool[idA].internalGetDeltaAngularVelocity() : zero);
+		btBatchSetVector3(deltaLinearVelocityB,lane,idB>=0 ? m_tmpSolverBodyPool[idB].internalGetDeltaLinearVelocity() : zero);
+		btBatchSetVector3(deltaAngularVelocityB,lane,idB>=0 ? m_tmpSolverBodyPool[idB].internalGetDeltaAngularVelocity() : zero);
+	}
+
+	btBatchScalar appliedImpulse = btBatchLoad(batch.m_appliedImpulse);
+	btBatchScalar jacDiagABInv = btBatchLoad(batch.m_jacDiagABInv);
+	btBatchScalar deltaImpulse = btBatchSub(btBatchLoad(batch.m_rhs),btBatchMul(appliedImpulse,btBatchLoad(batch.m_cfm)));
+	btBatchScalar deltaVel1Dotn = btBatchAdd(btBatchDot3(batch.m_contactNormal,deltaLinearVelocityA),btBatchDot3(batch.m_relpos1CrossNormal,deltaAngularVelocityA));
+	btBatchScalar deltaVel2Dotn = btBatchSub(btBatchDot3(batch.m_relpos2CrossNormal,deltaAngularVelocityB),btBatchDot3(batch.m_contactNormal,deltaLinearVelocityB));
+	deltaImpulse = btBatchSub(deltaImpulse,btBatchMul(deltaVel1Dotn,jacDiagABInv));
+	deltaImpulse = btBatchSub(deltaImpulse,btBatchMul(deltaVel2Dotn,jacDiagABInv));
+
+	//clamp the accumulated impulse to [lowerLimit,upperLimit]
+	btBatchScalar sum = btBatchAdd(appliedImpulse,deltaImpulse);
+	sum = btBatchMax(btBatchLoad(batch.m_lowerLimit),btBatchMin(btBatchLoad(batch.m_upperLimit),sum));
+	deltaImpulse = btBatchSub(sum,appliedImpulse);
+	btBatchStore(batch.m_appliedImpulse,sum);
+
+	btBatchAddScaled3(deltaLinearVelocityA,batch.m_linearComponentA,deltaImpulse);
+	btBatchAddScaled3(deltaAngularVelocityA,batch.m_angularComponentA,deltaImpulse);
+	btBatchSubScaled3(deltaLinearVelocityB,batch.m_linearComponentB,deltaImpulse);
+	btBatchAddScaled3(deltaAngularVelocityB,batch.m_angularComponentB,deltaImpulse);
+
+	//scatter, the dynamic bodies are unique within a batch, and the velocity of shared (static/kinematic) bodies doesn't change
+	for (lane=0;lane<batch.m_numRows;lane++)
+	{
+		int idA = batch.m_solverBodyIdA[lane];
+		int idB = batch.m_solverBodyIdB[lane];
+		m_tmpSolverBodyPool[idA].internalGetDeltaLinearVelocity() = btBatchGetVector3(deltaLinearVelocityA,lane);
+		m_tmpSolverBodyPool[idA].internalGetDeltaAngularVelocity() = btBatchGetVector3(deltaAngularVelocityA,lane);
+		m_tmpSolverBodyPool[idB].internalGetDeltaLinearVelocity() = btBatchGetVector3(deltaLinearVelocityB,lane);
+		m_tmpSolverBodyPool[idB].internalGetDeltaAngularVelocity() = btBatchGetVector3(deltaAngularVelocityB,lane);
+	}
+}
+
+bool btSequentialImpulseConstraintSolver::isSharedSolverBody(int solverBodyId) const
+{
+	//rows that only share bodies which velocity doesn't change, can be solved in the same batch
+	const btSolverBody& body = m_tmpSolverBodyPool[solverBodyId];
+	if (!body.m_originalBody)
+		return true;
+	return body.m_invMass.isZero() && (body.m_originalBody->getInvInertiaDiagLocal().isZero() || body.m_angularFactor.isZero());
+}
+
+void btSequentialImpulseConstraintSolver::setupConstraintBatches(const btConstraintArray& rows, btConstraintBatchArray& batches, btAlignedObjectArray<int>& rowToBatchLane)
+{
+	//only the last few batches are searched for a free lane, which keeps the colouring linear in the number of rows
+	const int maxOpenBatches = 8;
+	int firstOpenBatch = 0;
+
+	batches.resize(0);
+	rowToBatchLane.resize(rows.size());
+
+	for (int i=0;i<rows.size();i++)
+	{
+		const btSolverConstraint& row = rows[i];
+		int dynamicBodyIdA = isSharedSolverBody(row.m_solverBodyIdA) ? -1 : row.m_solverBodyIdA;
+		int dynamicBodyIdB = isSharedSolverBody(row.m_solverBodyIdB) ? -1 : row.m_solverBodyIdB;
+
+		int b;
+		for (b=firstOpenBatch;b<batches.size();b++)
+		{
+			const btSolverConstraintBatch& batch = batches[b];
+			if (batch.m_numRows == BT_SOLVER_BATCH_WIDTH)
+				continue;
+			bool conflict = false;
+			for (int lane=0;lane<batch.m_numRows && !conflict;lane++)
+			{
+				if (dynamicBodyIdA>=0 && (batch.m_dynamicBodyIdA[lane]==dynamicBodyIdA || batch.m_dynamicBodyIdB[lane]==dynamicBodyIdA))
+					conflict = true;
+				if (dynamicBodyIdB>=0 && (batch.m_dynamicBodyIdA[lane]==dynamicBodyIdB || batch.m_dynamicBodyIdB[lane]==dynamicBodyIdB))
+					conflict = true;
+			}
+			if (!conflict)
+				break;
+		}
+
+		if (b==batches.size())
+		{
+			//open a new batch, the unused lanes are zero, and don't change any body
+			btSolverConstraintBatch& batch = batches.expand();
+			memset(&batch,0,sizeof(btSolverConstraintBatch));
+			for (int lane=0;lane<BT_SOLVER_BATCH_WIDTH;lane++)
+			{
+				batch.m_solverBodyIdA[lane] = -1;
+				batch.m_solverBodyIdB[lane] = -1;
+				batch.m_dynamicBodyIdA[lane] = -1;
+				batch.m_dynamicBodyIdB[lane] = -1;
+				batch.m_rowIndex[lane] = -1;
+				batch.m_frictionIndex[lane] = -1;
+			}
+		}
+
+		btSolverConstraintBatch& batch = batches[b];
+		int lane = batch.m_numRows++;
+		const btSolverBody& bodyA = m_tmpSolverBodyPool[row.m_solverBodyIdA];
+		const btSolverBody& bodyB = m_tmpSolverBodyPool[row.m_solverBodyIdB];
+		const btVector3 zero(0,0,0);
+
+		btBatchSetVector3(batch.m_contactNormal,lane,row.m_contactNormal);
+		btBatchSetVector3(batch.m_relpos1CrossNormal,lane,row.m_relpos1CrossNormal);
+		btBatchSetVector3(batch.m_relpos2CrossNormal,lane,row.m_relpos2CrossNormal);
+		//the impulse is applied like btSolverBody::internalApplyImpulse: scaled by the linear and angular factors, and not at all without an original body
+		btBatchSetVector3(batch.m_linearComponentA,lane,bodyA.m_originalBody ? row.m_contactNormal*bodyA.m_invMass*bodyA.m_linearFactor : zero);
+		btBatchSetVector3(batch.m_linearComponentB,lane,bodyB.m_originalBody ? row.m_contactNormal*bodyB.m_invMass*bodyB.m_linearFactor : zero);
+		btBatchSetVector3(batch.m_angularComponentA,lane,bodyA.m_originalBody ? row.m_angularComponentA*bodyA.m_angularFactor : zero);
+		btBatchSetVector3(batch.m_angularComponentB,lane,bodyB.m_originalBody ? row.m_angularComponentB*bodyB.m_angularFactor : zero);
+		batch.m_appliedImpulse[lane] = row.m_appliedImpulse;
+		batch.m_jacDiagABInv[lane] = row.m_jacDiagABInv;
+		batch.m_rhs[lane] = row.m_rhs;
+		batch.m_cfm[lane] = row.m_cfm;
+		batch.m_lowerLimit[lane] = row.m_lowerLimit;
+		batch.m_upperLimit[lane] = row.m_upperLimit;
+		batch.m_friction[lane] = row.m_friction;
+		batch.m_solverBodyIdA[lane] = row.m_solverBodyIdA;
+		batch.m_solverBodyIdB[lane] = row.m_solverBodyIdB;
+		batch.m_dynamicBodyIdA[lane] = dynamicBodyIdA;
+		batch.m_dynamicBodyIdB[lane] = dynamicBodyIdB;
+		batch.m_rowIndex[lane] = i;
+		rowToBatchLane[i] = b*BT_SOLVER_BATCH_WIDTH+lane;
+
+		while (firstOpenBatch<batches.size() && (batches[firstOpenBatch].m_numRows==BT_SOLVER_BATCH_WIDTH || batches.size()-firstOpenBatch > maxOpenBatches))
+		{
+			firstOpenBatch++;
+		}
+	}
+}
+
+void btSequentialImpulseConstraintSolver::writeBackConstraintBatches(btConstraintArray& rows, const btConstraintBatchArray& batches, const btAlignedObjectArray<int>& rowToBatchLane)
+{
+	for (int i=0;i<rows.size();i++)
+	{
+		int batchLane = rowToBatchLane[i];
+		rows[i].m_appliedImpulse = batches[batchLane/BT_SOLVER_BATCH_WIDTH].m_appliedImpulse[batchLane%BT_SOLVER_BATCH_WIDTH];
+	}
+}
+
 // Project Gauss Seidel or the equivalent Sequential Impulse
 void btSequentialImpulseConstraintSolver::resolveSingleConstraintRowGenericSIMD(btSolverBody& body1,btSolverBody& body2,const btSolverConstraint& c)
 {
@@ -181,7 +409,11 @@ void	btSequentialImpulseConstraintSolver::resolveSplitPenetrationImpulseCacheFri
 {
 		if (c.m_rhsPenetration)
         {
+#if BT_THREADSAFE
+			btAtomicFetchAdd(&gNumSplitImpulseRecoveries,1);
+#else
 			gNumSplitImpulseRecoveries++;
+#endif
 			btScalar deltaImpulse = c.m_rhsPenetration-btScalar(c.m_appliedPushImpulse)*c.m_cfm;
 			const btScalar deltaVel1Dotn	=	c.m_contactNormal.dot(body1.internalGetPushVelocity()) 	+ c.m_relpos1CrossNormal.dot(body1.internalGetTurnVelocity());
 			const btScalar deltaVel2Dotn	=	-c.m_contactNormal.dot(body2.internalGetPushVelocity()) + c.m_relpos2CrossNormal.dot(body2.internalGetTurnVelocity());
@@ -209,7 +441,11 @@ void	btSequentialImpulseConstraintSolver::resolveSplitPenetrationImpulseCacheFri
 	if (!c.m_rhsPenetration)
 		return;
 
+#if BT_THREADSAFE
+	btAtomicFetchAdd(&gNumSplitImpulseRecoveries,1);
+#else
 	gNumSplitImpulseRecoveries++;
+#endif
 
 	__m128 cpAppliedImp = _mm_set1_ps(c.m_appliedPushImpulse);
 	__m128	lowerLimit1 = _mm_set1_ps(c.m_lowerLimit);
@@ -518,6 +754,22 @@ int	btSequentialImpulseConstraintSolver::getOrInitSolverBody(btCollisionObject&
 
 	int solverBodyIdA = -1;
 
+	btRigidBody* kinematicBody = btRigidBody::upcast(&body);
+	if (kinematicBody && kinematicBody->isKinematicObject())
+	{
+		///kinematic bodies can touch several islands that are solved concurrently (see btDiscreteDynamicsWorldMt),
+		///so their solver body index is kept by this solver instead of in the shared companion id
+		int* solverBodyIdPtr = m_kinematicBodyToSolverBody.find(btHashPtr(&body));
+		if (solverBodyIdPtr)
+			return *solverBodyIdPtr;
+
+		solverBodyIdA = m_tmpSolverBodyPool.size();
+		btSolverBody& solverBody = m_tmpSolverBodyPool.expand();
+		initSolverBody(&solverBody,&body);
+		m_kinematicBodyToSolverBody.insert(btHashPtr(&body),solverBodyIdA);
+		return solverBodyIdA;
+	}
+
 	if (body.getCompanionId() >= 0)
 	{
 		//body has already been converted
@@ -907,7 +1159,6 @@ void	btSequentialImpulseConstraintSolver::convertContact(btPersistentManifold* m
 btScalar btSequentialImpulseConstraintSolver::solveGroupCacheFriendlySetup(btCollisionObject** bodies, int numBodies, btPersistentManifold** manifoldPtr, int numManifolds,btTypedConstraint** constraints,int numConstraints,const btContactSolverInfo& infoGlobal,btIDebugDraw* debugDrawer,btStackAlloc* stackAlloc)
 {
 	BT_PROFILE("solveGroupCacheFriendlySetup");
-	(void)stackAlloc;
 	(void)debugDrawer;
 
 	m_maxOverrideNumSolverIterations = 0;
@@ -988,8 +1239,28 @@ btScalar btSequentialImpulseConstraintSolver::solveGroupCacheFriendlySetup(btCol
 	}
 
 
-	m_tmpSolverBodyPool.reserve(numBodies+1);
+	if (stackAlloc)
+	{
+		//the pools draw from the stack allocator of the calling thread, with room for the worst case, see solveGroup
+		int numContacts = 0;
+		for (int i=0;i<numManifolds;i++)
+		{
+			numContacts += manifoldPtr[i]->getNumContacts();
+		}
+		//the fixed body, the bodies of the island, and the static and kinematic bodies they touch
+		initializeFromStackAlloc(m_tmpSolverBodyPool,stackAlloc,1+numBodies+2*numManifolds+2*numConstraints);
+		initializeFromStackAlloc(m_tmpSolverContactConstraintPool,stackAlloc,numContacts);
+		initializeFromStackAlloc(m_tmpSolverContactFrictionConstraintPool,stackAlloc,numContacts*2);
+		//convertContact adds at most 3 rolling friction rows per manifold
+		initializeFromStackAlloc(m_tmpSolverContactRollingFrictionConstraintPool,stackAlloc,numManifolds*3);
+		initializeFromStackAlloc(m_tmpConstraintSizesPool,stackAlloc,numConstraints);
+	} else
+	{
+		m_tmpSolverBodyPool.reserve(numBodies+1);
+	}
 	m_tmpSolverBodyPool.resize(0);
+	if (m_kinematicBodyToSolverBody.size())
+		m_kinematicBodyToSolverBody.clear();
 
 	btSolverBody& fixedBody = m_tmpSolverBodyPool.expand();
     initSolverBody(&fixedBody,0);
@@ -1060,6 +1331,10 @@ btScalar btSequentialImpulseConstraintSolver::solveGroupCacheFriendlySetup(btCol
 				}
 				totalNumRows += info1.m_numConstraintRows;
 			}
+			if (stackAlloc)
+			{
+				initializeFromStackAlloc(m_tmpSolverNonContactConstraintPool,stackAlloc,totalNumRows);
+			}
 			m_tmpSolverNonContactConstraintPool.resizeNoInitialize(totalNumRows);
 
 			
@@ -1222,7 +1497,12 @@ btScalar btSequentialImpulseConstraintSolver::solveGroupCacheFriendlySetup(btCol
 	int numConstraintPool = m_tmpSolverContactConstraintPool.size();
 	int numFrictionPool = m_tmpSolverContactFrictionConstraintPool.size();
 
-	///@todo: use stack allocator for such temporarily memory, same for solver bodies/constraints
+	if (stackAlloc)
+	{
+		initializeFromStackAlloc(m_orderNonContactConstraintPool,stackAlloc,numNonContactPool);
+		initializeFromStackAlloc(m_orderTmpConstraintPool,stackAlloc,numConstraintPool*2);
+		initializeFromStackAlloc(m_orderFrictionConstraintPool,stackAlloc,numFrictionPool);
+	}
 	m_orderNonContactConstraintPool.resizeNoInitialize(numNonContactPool);
 	if ((infoGlobal.m_solverMode & SOLVER_USE_2_FRICTION_DIRECTIONS))
 		m_orderTmpConstraintPool.resizeNoInitialize(numConstraintPool*2);
@@ -1290,6 +1570,11 @@ btScalar btSequentialImpulseConstraintSolver::solveSingleIteration(int iteration
 		}
 	}
 
+	if (infoGlobal.m_solverMode & SOLVER_BATCH_CONTACT_CONSTRAINTS)
+	{
+		return solveSingleIterationBatched(iteration,constraints,numConstraints,infoGlobal);
+	}
+
 	if (infoGlobal.m_solverMode & SOLVER_SIMD)
 	{
 		///solve all joint constraints, using SIMD, if available
@@ -1487,6 +1772,90 @@ btScalar btSequentialImpulseConstraintSolver::solveSingleIteration(int iteration
 }
 
 
+btScalar btSequentialImpulseConstraintSolver::solveSingleIterationBatched(int iteration, btTypedConstraint** constraints,int numConstraints,const btContactSolverInfo& infoGlobal)
+{
+	///solve all joint constraints, they are not batched
+	for (int j=0;j<m_tmpSolverNonContactConstraintPool.size();j++)
+	{
+		btSolverConstraint& constraint = m_tmpSolverNonContactConstraintPool[m_orderNonContactConstraintPool[j]];
+		if (iteration < constraint.m_overrideNumSolverIterations)
+		{
+			if (infoGlobal.m_solverMode & SOLVER_SIMD)
+				resolveSingleConstraintRowGenericSIMD(m_tmpSolverBodyPool[constraint.m_solverBodyIdA],m_tmpSolverBodyPool[constraint.m_solverBodyIdB],constraint);
+			else
+				resolveSingleConstraintRowGeneric(m_tmpSolverBodyPool[constraint.m_solverBodyIdA],m_tmpSolverBodyPool[constraint.m_solverBodyIdB],constraint);
+		}
+	}
+
+	if (iteration< infoGlobal.m_numIterations)
+	{
+		int j;
+		for (j=0;j<numConstraints;j++)
+		{
+			if (constraints[j]->isEnabled())
+			{
+				int bodyAid = getOrInitSolverBody(constraints[j]->getRigidBodyA());
+				int bodyBid = getOrInitSolverBody(constraints[j]->getRigidBodyB());
+				btSolverBody& bodyA = m_tmpSolverBodyPool[bodyAid];
+				btSolverBody& bodyB = m_tmpSolverBodyPool[bodyBid];
+				constraints[j]->solveConstraintObsolete(bodyA,bodyB,infoGlobal.m_timeStep);
+			}
+		}
+
+		///solve all contact constraints, one batch at a time
+		for (j=0;j<m_contactConstraintBatches.size();j++)
+		{
+			resolveConstraintBatch(m_contactConstraintBatches[j]);
+		}
+
+		///solve all friction constraints, limited by the impulse of their contact row
+		for (j=0;j<m_frictionConstraintBatches.size();j++)
+		{
+			btSolverConstraintBatch& batch = m_frictionConstraintBatches[j];
+			for (int lane=0;lane<batch.m_numRows;lane++)
+			{
+				int contactLane = batch.m_frictionIndex[lane];
+				btScalar totalImpulse = m_contactConstraintBatches[contactLane/BT_SOLVER_BATCH_WIDTH].m_appliedImpulse[contactLane%BT_SOLVER_BATCH_WIDTH];
+				if (totalImpulse>btScalar(0))
+				{
+					batch.m_lowerLimit[lane] = -(batch.m_friction[lane]*totalImpulse);
+					batch.m_upperLimit[lane] = batch.m_friction[lane]*totalImpulse;
+				} else
+				{
+					//keep the applied impulse, like the unbatched solver skips the row
+					batch.m_lowerLimit[lane] = batch.m_appliedImpulse[lane];
+					batch.m_upperLimit[lane] = batch.m_appliedImpulse[lane];
+				}
+			}
+			resolveConstraintBatch(batch);
+		}
+
+		int numRollingFrictionPoolConstraints = m_tmpSolverContactRollingFrictionConstraintPool.size();
+		for (j=0;j<numRollingFrictionPoolConstraints;j++)
+		{
+			btSolverConstraint& rollingFrictionConstraint = m_tmpSolverContactRollingFrictionConstraintPool[j];
+			int contactLane = m_contactRowToBatchLane[rollingFrictionConstraint.m_frictionIndex];
+			btScalar totalImpulse = m_contactConstraintBatches[contactLane/BT_SOLVER_BATCH_WIDTH].m_appliedImpulse[contactLane%BT_SOLVER_BATCH_WIDTH];
+			if (totalImpulse>btScalar(0))
+			{
+				btScalar rollingFrictionMagnitude = rollingFrictionConstraint.m_friction*totalImpulse;
+				if (rollingFrictionMagnitude>rollingFrictionConstraint.m_friction)
+					rollingFrictionMagnitude = rollingFrictionConstraint.m_friction;
+
+				rollingFrictionConstraint.m_lowerLimit = -rollingFrictionMagnitude;
+				rollingFrictionConstraint.m_upperLimit = rollingFrictionMagnitude;
+
+				if (infoGlobal.m_solverMode & SOLVER_SIMD)
+					resolveSingleConstraintRowGenericSIMD(m_tmpSolverBodyPool[rollingFrictionConstraint.m_solverBodyIdA],m_tmpSolverBodyPool[rollingFrictionConstraint.m_solverBodyIdB],rollingFrictionConstraint);
+				else
+					resolveSingleConstraintRowGeneric(m_tmpSolverBodyPool[rollingFrictionConstraint.m_solverBodyIdA],m_tmpSolverBodyPool[rollingFrictionConstraint.m_solverBodyIdB],rollingFrictionConstraint);
+			}
+		}
+	}
+	return 0.f;
+}
+
+
 void btSequentialImpulseConstraintSolver::solveGroupCacheFriendlySplitImpulseIterations(btCollisionObject** bodies,int numBodies,btPersistentManifold** manifoldPtr, int numManifolds,btTypedConstraint** constraints,int numConstraints,const btContactSolverInfo& infoGlobal,btIDebugDraw* debugDrawer,btStackAlloc* stackAlloc)
 {
 	int iteration;
@@ -1537,12 +1906,30 @@ btScalar btSequentialImpulseConstraintSolver::solveGroupCacheFriendlyIterations(
 
 		int maxIterations = m_maxOverrideNumSolverIterations > infoGlobal.m_numIterations? m_maxOverrideNumSolverIterations : infoGlobal.m_numIterations;
 
+		if (infoGlobal.m_solverMode & SOLVER_BATCH_CONTACT_CONSTRAINTS)
+		{
+			BT_PROFILE("setupConstraintBatches");
+			setupConstraintBatches(m_tmpSolverContactConstraintPool,m_contactConstraintBatches,m_contactRowToBatchLane);
+			setupConstraintBatches(m_tmpSolverContactFrictionConstraintPool,m_frictionConstraintBatches,m_frictionRowToBatchLane);
+			for (int i=0;i<m_tmpSolverContactFrictionConstraintPool.size();i++)
+			{
+				int batchLane = m_frictionRowToBatchLane[i];
+				m_frictionConstraintBatches[batchLane/BT_SOLVER_BATCH_WIDTH].m_frictionIndex[batchLane%BT_SOLVER_BATCH_WIDTH] = m_contactRowToBatchLane[m_tmpSolverContactFrictionConstraintPool[i].m_frictionIndex];
+			}
+		}
+
 		for ( int iteration = 0 ; iteration< maxIterations ; iteration++)
 		//for ( int iteration = maxIterations-1  ; iteration >= 0;iteration--)
 		{			
 			solveSingleIteration(iteration, bodies ,numBodies,manifoldPtr, numManifolds,constraints,numConstraints,infoGlobal,debugDrawer,stackAlloc);
 		}
-		
+
+		if (infoGlobal.m_solverMode & SOLVER_BATCH_CONTACT_CONSTRAINTS)
+		{
+			//the applied impulses are used for warmstarting, in solveGroupCacheFriendlyFinish
+			writeBackConstraintBatches(m_tmpSolverContactConstraintPool,m_contactConstraintBatches,m_contactRowToBatchLane);
+			writeBackConstraintBatches(m_tmpSolverContactFrictionConstraintPool,m_frictionConstraintBatches,m_frictionRowToBatchLane);
+		}
 	}
 	return 0.f;
 }
@@ -1599,7 +1986,8 @@ btScalar btSequentialImpulseConstraintSolver::solveGroupCacheFriendlyFinish(btCo
 	for ( i=0;i<m_tmpSolverBodyPool.size();i++)
 	{
 		btRigidBody* body = m_tmpSolverBodyPool[i].m_originalBody;
-		if (body)
+		//the solver cannot change kinematic bodies, and they may be shared with islands solved on other threads
+		if (body && !body->isKinematicObject())
 		{
 			if (infoGlobal.m_splitImpulse)
 				m_tmpSolverBodyPool[i].writebackVelocityAndTransform(infoGlobal.m_timeStep, infoGlobal.m_splitImpulseTurnErp);
@@ -1633,11 +2021,28 @@ btScalar btSequentialImpulseConstraintSolver::solveGroup(btCollisionObject** bod
 	BT_PROFILE("solveGroup");
 	//you need to provide at least some bodies
 	
+	//the temporary pools that solveGroupCacheFriendlySetup takes from the stack allocator are released at the end of the block
+	btBlock* block = stackAlloc ? stackAlloc->beginBlock() : 0;
+
 	solveGroupCacheFriendlySetup( bodies, numBodies, manifoldPtr,  numManifolds,constraints, numConstraints,infoGlobal,debugDrawer, stackAlloc);
 
 	solveGroupCacheFriendlyIterations(bodies, numBodies, manifoldPtr,  numManifolds,constraints, numConstraints,infoGlobal,debugDrawer, stackAlloc);
 
 	solveGroupCacheFriendlyFinish(bodies, numBodies, infoGlobal);
+
+	if (block)
+	{
+		m_tmpSolverBodyPool.initializeFromBuffer(0,0,0);
+		m_tmpSolverContactConstraintPool.initializeFromBuffer(0,0,0);
+		m_tmpSolverNonContactConstraintPool.initializeFromBuffer(0,0,0);
+		m_tmpSolverContactFrictionConstraintPool.initializeFromBuffer(0,0,0);
+		m_tmpSolverContactRollingFrictionConstraintPool.initializeFromBuffer(0,0,0);
+		m_orderTmpConstraintPool.initializeFromBuffer(0,0,0);
+		m_orderNonContactConstraintPool.initializeFromBuffer(0,0,0);
+		m_orderFrictionConstraintPool.initializeFromBuffer(0,0,0);
+		m_tmpConstraintSizesPool.initializeFromBuffer(0,0,0);
+		stackAlloc->endBlock(block);
+	}
 	
 	return 0.f;
 }
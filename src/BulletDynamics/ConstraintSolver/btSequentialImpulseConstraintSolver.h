@@ -27,6 +27,7 @@ class btCollisionObject;
 #include "BulletDynamics/ConstraintSolver/btSolverConstraint.h"
 #include "BulletCollision/NarrowPhaseCollision/btManifoldPoint.h"
 #include "BulletDynamics/ConstraintSolver/btConstraintSolver.h"
+#include "LinearMath/btHashMap.h"
 
 ///The btSequentialImpulseConstraintSolver is a fast SIMD implementation of the Projected Gauss Seidel (iterative LCP) method.
 ATTRIBUTE_ALIGNED16(class) btSequentialImpulseConstraintSolver : public btConstraintSolver
@@ -42,6 +43,12 @@ protected:
 	btAlignedObjectArray<int>	m_orderNonContactConstraintPool;
 	btAlignedObjectArray<int>	m_orderFrictionConstraintPool;
 	btAlignedObjectArray<btTypedConstraint::btConstraintInfo1> m_tmpConstraintSizesPool;
+	btHashMap<btHashPtr,int>	m_kinematicBodyToSolverBody;
+	///SoA copies of the contact and friction rows, used for SOLVER_BATCH_CONTACT_CONSTRAINTS
+	btConstraintBatchArray		m_contactConstraintBatches;
+	btConstraintBatchArray		m_frictionConstraintBatches;
+	btAlignedObjectArray<int>	m_contactRowToBatchLane;
+	btAlignedObjectArray<int>	m_frictionRowToBatchLane;
 	int							m_maxOverrideNumSolverIterations;
 
 	void setupFrictionConstraint(	btSolverConstraint& solverConstraint, const btVector3& normalAxis,int solverBodyIdA,int  solverBodyIdB,
@@ -93,6 +100,14 @@ protected:
 	void	resolveSingleConstraintRowLowerLimit(btSolverBody& bodyA,btSolverBody& bodyB,const btSolverConstraint& contactConstraint);
 	
 	void	resolveSingleConstraintRowLowerLimitSIMD(btSolverBody& bodyA,btSolverBody& bodyB,const btSolverConstraint& contactConstraint);
+
+	///solves the rows of a btSolverConstraintBatch together, see SOLVER_BATCH_CONTACT_CONSTRAINTS
+	void	resolveConstraintBatch(btSolverConstraintBatch& batch);
+
+	bool	isSharedSolverBody(int solverBodyId) const;
+	///greedy colouring of the rows into batches that don't share a dynamic solver body
+	void	setupConstraintBatches(const btConstraintArray& rows, btConstraintBatchArray& batches, btAlignedObjectArray<int>& rowToBatchLane);
+	void	writeBackConstraintBatches(btConstraintArray& rows, const btConstraintBatchArray& batches, const btAlignedObjectArray<int>& rowToBatchLane);
 		
 protected:
 	
@@ -100,6 +115,7 @@ protected:
 	virtual void solveGroupCacheFriendlySplitImpulseIterations(btCollisionObject** bodies,int numBodies,btPersistentManifold** manifoldPtr, int numManifolds,btTypedConstraint** constraints,int numConstraints,const btContactSolverInfo& infoGlobal,btIDebugDraw* debugDrawer,btStackAlloc* stackAlloc);
 	virtual btScalar solveGroupCacheFriendlyFinish(btCollisionObject** bodies,int numBodies,const btContactSolverInfo& infoGlobal);
 	btScalar solveSingleIteration(int iteration, btCollisionObject** bodies ,int numBodies,btPersistentManifold** manifoldPtr, int numManifolds,btTypedConstraint** constraints,int numConstraints,const btContactSolverInfo& infoGlobal,btIDebugDraw* debugDrawer,btStackAlloc* stackAlloc);
+	btScalar solveSingleIterationBatched(int iteration, btTypedConstraint** constraints,int numConstraints,const btContactSolverInfo& infoGlobal);
 
 	virtual btScalar solveGroupCacheFriendlySetup(btCollisionObject** bodies,int numBodies,btPersistentManifold** manifoldPtr, int numManifolds,btTypedConstraint** constraints,int numConstraints,const btContactSolverInfo& infoGlobal,btIDebugDraw* debugDrawer,btStackAlloc* stackAlloc);
 	virtual btScalar solveGroupCacheFriendlyIterations(btCollisionObject** bodies,int numBodies,btPersistentManifold** manifoldPtr, int numManifolds,btTypedConstraint** constraints,int numConstraints,const btContactSolverInfo& infoGlobal,btIDebugDraw* debugDrawer,btStackAlloc* stackAlloc);
@@ -73,6 +73,46 @@ ATTRIBUTE_ALIGNED16 (struct)	btSolverConstraint
 typedef btAlignedObjectArray<btSolverConstraint>	btConstraintArray;
 
 
+#define BT_SOLVER_BATCH_WIDTH 4
+
+///btSolverConstraintBatch packs BT_SOLVER_BATCH_WIDTH btSolverConstraint rows in SoA layout, so they can be solved together using SIMD.
+///The rows of a batch don't share a dynamic btSolverBody (see SOLVER_BATCH_CONTACT_CONSTRAINTS). Unused lanes have a solver body id of -1.
+ATTRIBUTE_ALIGNED16 (struct)	btSolverConstraintBatch
+{
+	BT_DECLARE_ALIGNED_ALLOCATOR();
+
+	btScalar	m_contactNormal[3][BT_SOLVER_BATCH_WIDTH];
+	btScalar	m_relpos1CrossNormal[3][BT_SOLVER_BATCH_WIDTH];
+	btScalar	m_relpos2CrossNormal[3][BT_SOLVER_BATCH_WIDTH];
+	btScalar	m_linearComponentA[3][BT_SOLVER_BATCH_WIDTH];
+	btScalar	m_linearComponentB[3][BT_SOLVER_BATCH_WIDTH];
+	btScalar	m_angularComponentA[3][BT_SOLVER_BATCH_WIDTH];
+	btScalar	m_angularComponentB[3][BT_SOLVER_BATCH_WIDTH];
+
+	btScalar	m_appliedImpulse[BT_SOLVER_BATCH_WIDTH];
+	btScalar	m_jacDiagABInv[BT_SOLVER_BATCH_WIDTH];
+	btScalar	m_rhs[BT_SOLVER_BATCH_WIDTH];
+	btScalar	m_cfm[BT_SOLVER_BATCH_WIDTH];
+	btScalar	m_lowerLimit[BT_SOLVER_BATCH_WIDTH];
+	btScalar	m_upperLimit[BT_SOLVER_BATCH_WIDTH];
+	btScalar	m_friction[BT_SOLVER_BATCH_WIDTH];
+
+	int			m_solverBodyIdA[BT_SOLVER_BATCH_WIDTH];
+	int			m_solverBodyIdB[BT_SOLVER_BATCH_WIDTH];
+	///dynamic bodies used by the rows, -1 for static/kinematic bodies that can be shared within a batch
+	int			m_dynamicBodyIdA[BT_SOLVER_BATCH_WIDTH];
+	int			m_dynamicBodyIdB[BT_SOLVER_BATCH_WIDTH];
+	///index of the row in the constraint pool
+	int			m_rowIndex[BT_SOLVER_BATCH_WIDTH];
+	///for friction rows: the lane (batchIndex*BT_SOLVER_BATCH_WIDTH+lane) of the contact row that limits the friction
+	int			m_frictionIndex[BT_SOLVER_BATCH_WIDTH];
+
+	int			m_numRows;
+};
+
+typedef btAlignedObjectArray<btSolverConstraintBatch>	btConstraintBatchArray;
+
+
 #endif //BT_SOLVER_CONSTRAINT_H
 
 
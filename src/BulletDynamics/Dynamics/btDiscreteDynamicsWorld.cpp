@@ -22,11 +22,13 @@ subject to the following restrictions:
 #include "BulletCollision/BroadphaseCollision/btCollisionAlgorithm.h"
 #include "BulletCollision/CollisionShapes/btCollisionShape.h"
 #include "BulletCollision/CollisionDispatch/btSimulationIslandManager.h"
+#include "BulletCollision/NarrowPhaseCollision/btManifoldReduction.h"
 #include "LinearMath/btTransformUtil.h"
 #include "LinearMath/btQuickprof.h"
 
 //rigidbody & constraints
 #include "BulletDynamics/Dynamics/btRigidBody.h"
+#include "BulletDynamics/Dynamics/btRigidBodyStatePool.h"
 #include "BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolver.h"
 #include "BulletDynamics/ConstraintSolver/btContactSolverInfo.h"
 #include "BulletDynamics/ConstraintSolver/btTypedConstraint.h"
@@ -47,6 +49,7 @@ subject to the following restrictions:
 #include "LinearMath/btMotionState.h"
 
 #include "LinearMath/btSerializer.h"
+#include "LinearMath/btThreads.h"
 
 #if 0
 btAlignedObjectArray<btVector3> debugContacts;
@@ -89,10 +92,12 @@ struct InplaceSolverIslandCallback : public btSimulationIslandManager::IslandCal
 	btIDebugDraw*			m_debugDrawer;
 	btStackAlloc*			m_stackAlloc;
 	btDispatcher*			m_dispatcher;
+	const btManifoldReduction*	m_manifoldReduction;
 	
 	btAlignedObjectArray<btCollisionObject*> m_bodies;
 	btAlignedObjectArray<btPersistentManifold*> m_manifolds;
 	btAlignedObjectArray<btTypedConstraint*> m_constraints;
+	btAlignedObjectArray<btPersistentManifold*> m_reducedManifolds;
 
 
 	InplaceSolverIslandCallback(
@@ -105,7 +110,8 @@ struct InplaceSolverIslandCallback : public btSimulationIslandManager::IslandCal
 		m_numConstraints(0),
 		m_debugDrawer(NULL),
 		m_stackAlloc(stackAlloc),
-		m_dispatcher(dispatcher)
+		m_dispatcher(dispatcher),
+		m_manifoldReduction(NULL)
 	{
 
 	}
@@ -117,13 +123,14 @@ struct InplaceSolverIslandCallback : public btSimulationIslandManager::IslandCal
 		return *this;
 	}
 
-	SIMD_FORCE_INLINE void setup ( btContactSolverInfo* solverInfo, btTypedConstraint** sortedConstraints,	int	numConstraints,	btIDebugDraw* debugDrawer)
+	SIMD_FORCE_INLINE void setup ( btContactSolverInfo* solverInfo, btTypedConstraint** sortedConstraints,	int	numConstraints,	btIDebugDraw* debugDrawer, const btManifoldReduction* manifoldReduction)
 	{
 		btAssert(solverInfo);
 		m_solverInfo = solverInfo;
 		m_sortedConstraints = sortedConstraints;
 		m_numConstraints = numConstraints;
 		m_debugDrawer = debugDrawer;
+		m_manifoldReduction = manifoldReduction;
 		m_bodies.resize (0);
 		m_manifolds.resize (0);
 		m_constraints.resize (0);
@@ -132,6 +139,14 @@ struct InplaceSolverIslandCallback : public btSimulationIslandManager::IslandCal
 	
 	virtual	void	processIsland(btCollisionObject** bodies,int numBodies,btPersistentManifold**	manifolds,int numManifolds, int islandId)
 	{
+		if (m_manifoldReduction)
+		{
+			m_reducedManifolds.resize(0);
+			m_manifoldReduction->substituteManifolds(manifolds,numManifolds,m_reducedManifolds);
+			manifolds = m_reducedManifolds.size() ? &m_reducedManifolds[0] : 0;
+			numManifolds = m_reducedManifolds.size();
+		}
+
 		if (islandId<0)
 		{
 			///we don't split islands, so all constraints/contact manifolds/bodies are passed into the solver regardless the island id
@@ -210,7 +225,10 @@ m_gravity(0,-10,0),
 m_localTime(0),
 m_synchronizeAllMotionStates(false),
 m_applySpeculativeContactRestitution(false),
-m_profileTimings(0)
+m_profileTimings(0),
+m_bodyStatePool(0),
+m_manifoldReduction(0),
+m_useBatchedCcd(false)
 
 {
 	if (!m_constraintSolver)
@@ -256,6 +274,40 @@ btDiscreteDynamicsWorld::~btDiscreteDynamicsWorld()
 		m_constraintSolver->~btConstraintSolver();
 		btAlignedFree(m_constraintSolver);
 	}
+	setUseBodyStatePool(false);
+	setUseManifoldReduction(false);
+}
+
+void	btDiscreteDynamicsWorld::setUseBodyStatePool(bool useBodyStatePool)
+{
+	if (useBodyStatePool && !m_bodyStatePool)
+	{
+		void* mem = btAlignedAlloc(sizeof(btRigidBodyStatePool),16);
+		m_bodyStatePool = new (mem) btRigidBodyStatePool();
+	}
+	if (!useBodyStatePool && m_bodyStatePool)
+	{
+		m_bodyStatePool->~btRigidBodyStatePool();
+		btAlignedFree(m_bodyStatePool);
+		m_bodyStatePool = 0;
+	}
+}
+
+void	btDiscreteDynamicsWorld::setUseManifoldReduction(bool useManifoldReduction)
+{
+	if (useManifoldReduction && !m_manifoldReduction)
+	{
+		void* mem = btAlignedAlloc(sizeof(btManifoldReduction),16);
+		m_manifoldReduction = new (mem) btManifoldReduction();
+		m_dispatcher1->setManifoldReduction(m_manifoldReduction);
+	}
+	if (!useManifoldReduction && m_manifoldReduction)
+	{
+		m_dispatcher1->setManifoldReduction(0);
+		m_manifoldReduction->~btManifoldReduction();
+		btAlignedFree(m_manifoldReduction);
+		m_manifoldReduction = 0;
+	}
 }
 
 void	btDiscreteDynamicsWorld::saveKinematicState(btScalar timeStep)
@@ -456,6 +508,10 @@ int	btDiscreteDynamicsWorld::stepSimulation( btScalar timeStep,int maxSubSteps,
 
 	clearForces();
 
+	//the AABBs set during the step (soft bodies, parallel collide mode) are refitted here, so that the const queries
+	//between steps don't modify the broadphase and can run on several threads
+	getBroadphase()->refitIfNeeded();
+
 #ifndef BT_NO_PROFILE
 	CProfileManager::Increment_Frame_Counter();
 #endif //BT_NO_PROFILE
@@ -716,7 +772,13 @@ void	btDiscreteDynamicsWorld::solveConstraints(btContactSolverInfo& solverInfo)
 	
 	btTypedConstraint** constraintsPtr = getNumConstraints() ? &m_sortedConstraints[0] : 0;
 	
-	m_solverIslandCallback->setup(&solverInfo,constraintsPtr,m_sortedConstraints.size(),getDebugDrawer());
+	if (m_manifoldReduction)
+	{
+		btDispatcher* dispatcher = getCollisionWorld()->getDispatcher();
+		m_manifoldReduction->reduceManifolds(dispatcher->getInternalManifoldPointer(),dispatcher->getNumManifolds());
+	}
+
+	m_solverIslandCallback->setup(&solverInfo,constraintsPtr,m_sortedConstraints.size(),getDebugDrawer(),m_manifoldReduction);
 	m_constraintSolver->prepareSolve(getCollisionWorld()->getNumCollisionObjects(), getCollisionWorld()->getDispatcher()->getNumManifolds());
 	
 	/// solve all the constraints for this island
@@ -893,6 +955,7 @@ void	btDiscreteDynamicsWorld::createPredictiveContacts(btScalar timeStep)
 	}
 
 	btTransform predictedTrans;
+	m_ccdMotions.resizeNoInitialize(0);
 	for ( int i=0;i<m_nonStaticRigidBodies.size();i++)
 	{
 		btRigidBody* body = m_nonStaticRigidBodies[i];
@@ -911,6 +974,16 @@ void	btDiscreteDynamicsWorld::createPredictiveContacts(btScalar timeStep)
 				if (body->getCollisionShape()->isConvex())
 				{
 					gNumClampedCcdMotions++;
+#ifndef PREDICTIVE_CONTACT_USE_STATIC_ONLY
+					if (m_useBatchedCcd)
+					{
+						btCcdMotion& motion = m_ccdMotions.expandNonInitializing();
+						motion.m_body = body;
+						motion.m_predictedTrans = predictedTrans;
+						motion.m_poolIndex = -1;
+						continue;
+					}
+#endif
 #ifdef PREDICTIVE_CONTACT_USE_STATIC_ONLY
 					class StaticOnlyCallback : public btClosestNotMeConvexResultCallback
 					{
@@ -946,137 +1019,352 @@ void	btDiscreteDynamicsWorld::createPredictiveContacts(btScalar timeStep)
 					convexSweepTest(&tmpSphere,body->getWorldTransform(),modifiedPredictedTrans,sweepResults);
 					if (sweepResults.hasHit() && (sweepResults.m_closestHitFraction < 1.f))
 					{
-					
-						btVector3 distVec = (predictedTrans.getOrigin()-body->getWorldTransform().getOrigin())*sweepResults.m_closestHitFraction;
-						btScalar distance = distVec.dot(-sweepResults.m_hitNormalWorld);
-
-						
-						btPersistentManifold* manifold = m_dispatcher1->getNewManifold(body,sweepResults.m_hitCollisionObject);
-						m_predictiveManifolds.push_back(manifold);
-						
-						btVector3 worldPointB = body->getWorldTransform().getOrigin()+distVec;
-						btVector3 localPointB = sweepResults.m_hitCollisionObject->getWorldTransform().inverse()*worldPointB;
-
-						btManifoldPoint newPoint(btVector3(0,0,0), localPointB,sweepResults.m_hitNormalWorld,distance);
-
-						bool isPredictive = true;
-						int index = manifold->addManifoldPoint(newPoint, isPredictive);
-						btManifoldPoint& pt = manifold->getContactPoint(index);
-						pt.m_combinedRestitution = 0;
-						pt.m_combinedFriction = btManifoldResult::calculateCombinedFriction(body,sweepResults.m_hitCollisionObject);
-						pt.m_positionWorldOnA = body->getWorldTransform().getOrigin();
-						pt.m_positionWorldOnB = worldPointB;
-
+						addPredictiveContact(body,predictedTrans,sweepResults.m_closestHitFraction,sweepResults.m_hitNormalWorld,sweepResults.m_hitCollisionObject);
 					}
 				}
 			}
 		}
 	}
+
+	if (m_ccdMotions.size())
+	{
+		BT_PROFILE("predictive sweeps (batched)");
+		sweepCcdMotions();
+		//the hits are staged per body, the manifolds are taken from the dispatcher in the order of the bodies, on this thread
+		for (int i=0;i<m_ccdMotions.size();i++)
+		{
+			const btCcdMotion& motion = m_ccdMotions[i];
+			if (motion.m_hitFraction < btScalar(1.))
+			{
+				addPredictiveContact(motion.m_body,motion.m_predictedTrans,motion.m_hitFraction,motion.m_hitNormalWorld,motion.m_hitObject);
+			}
+		}
+	}
 }
-void	btDiscreteDynamicsWorld::integrateTransforms(btScalar timeStep)
+
+void	btDiscreteDynamicsWorld::addPredictiveContact(btRigidBody* body, const btTransform& predictedTrans, btScalar hitFraction, const btVector3& hitNormalWorld, const btCollisionObject* hitObject)
 {
-	BT_PROFILE("integrateTransforms");
-	btTransform predictedTrans;
-	for ( int i=0;i<m_nonStaticRigidBodies.size();i++)
-	{
-		btRigidBody* body = m_nonStaticRigidBodies[i];
-		body->setHitFraction(1.f);
+	btVector3 distVec = (predictedTrans.getOrigin()-body->getWorldTransform().getOrigin())*hitFraction;
+	btScalar distance = distVec.dot(-hitNormalWorld);
 
-		if (body->isActive() && (!body->isStaticOrKinematicObject()))
-		{
+	btPersistentManifold* manifold = m_dispatcher1->getNewManifold(body,hitObject);
+	m_predictiveManifolds.push_back(manifold);
 
-			body->predictIntegratedTransform(timeStep, predictedTrans);
-			
-			btScalar squareMotion = (predictedTrans.getOrigin()-body->getWorldTransform().getOrigin()).length2();
+	btVector3 worldPointB = body->getWorldTransform().getOrigin()+distVec;
+	btVector3 localPointB = hitObject->getWorldTransform().inverse()*worldPointB;
 
-			
+	btManifoldPoint newPoint(btVector3(0,0,0), localPointB,hitNormalWorld,distance);
 
-			if (getDispatchInfo().m_useContinuous && body->getCcdSquareMotionThreshold() && body->getCcdSquareMotionThreshold() < squareMotion)
-			{
-				BT_PROFILE("CCD motion clamping");
-				if (body->getCollisionShape()->isConvex())
-				{
-					gNumClampedCcdMotions++;
+	bool isPredictive = true;
+	int index = manifold->addManifoldPoint(newPoint, isPredictive);
+	btManifoldPoint& pt = manifold->getContactPoint(index);
+	pt.m_combinedRestitution = 0;
+	pt.m_combinedFriction = btManifoldResult::calculateCombinedFriction(body,hitObject);
+	pt.m_positionWorldOnA = body->getWorldTransform().getOrigin();
+	pt.m_positionWorldOnB = worldPointB;
+}
+
+bool	btDiscreteDynamicsWorld::clampMotionCcd(btRigidBody* body, btScalar timeStep, const btTransform& predictedTrans)
+{
+	BT_PROFILE("CCD motion clamping");
+	if (body->getCollisionShape()->isConvex())
+	{
+		gNumClampedCcdMotions++;
 #ifdef USE_STATIC_ONLY
-					class StaticOnlyCallback : public btClosestNotMeConvexResultCallback
-					{
-					public:
+		class StaticOnlyCallback : public btClosestNotMeConvexResultCallback
+		{
+		public:
 
-						StaticOnlyCallback (btCollisionObject* me,const btVector3& fromA,const btVector3& toA,btOverlappingPairCache* pairCache,btDispatcher* dispatcher) : 
-						  btClosestNotMeConvexResultCallback(me,fromA,toA,pairCache,dispatcher)
-						{
-						}
+			StaticOnlyCallback (btCollisionObject* me,const btVector3& fromA,const btVector3& toA,btOverlappingPairCache* pairCache,btDispatcher* dispatcher) : 
+			  btClosestNotMeConvexResultCallback(me,fromA,toA,pairCache,dispatcher)
+			{
+			}
 
-					  	virtual bool needsCollision(btBroadphaseProxy* proxy0) const
-						{
-							btCollisionObject* otherObj = (btCollisionObject*) proxy0->m_clientObject;
-							if (!otherObj->isStaticOrKinematicObject())
-								return false;
-							return btClosestNotMeConvexResultCallback::needsCollision(proxy0);
-						}
-					};
+		  	virtual bool needsCollision(btBroadphaseProxy* proxy0) const
+			{
+				btCollisionObject* otherObj = (btCollisionObject*) proxy0->m_clientObject;
+				if (!otherObj->isStaticOrKinematicObject())
+					return false;
+				return btClosestNotMeConvexResultCallback::needsCollision(proxy0);
+			}
+		};
 
-					StaticOnlyCallback sweepResults(body,body->getWorldTransform().getOrigin(),predictedTrans.getOrigin(),getBroadphase()->getOverlappingPairCache(),getDispatcher());
+		StaticOnlyCallback sweepResults(body,body->getWorldTransform().getOrigin(),predictedTrans.getOrigin(),getBroadphase()->getOverlappingPairCache(),getDispatcher());
 #else
-					btClosestNotMeConvexResultCallback sweepResults(body,body->getWorldTransform().getOrigin(),predictedTrans.getOrigin(),getBroadphase()->getOverlappingPairCache(),getDispatcher());
+		btClosestNotMeConvexResultCallback sweepResults(body,body->getWorldTransform().getOrigin(),predictedTrans.getOrigin(),getBroadphase()->getOverlappingPairCache(),getDispatcher());
 #endif
-					//btConvexShape* convexShape = static_cast<btConvexShape*>(body->getCollisionShape());
-					btSphereShape tmpSphere(body->getCcdSweptSphereRadius());//btConvexShape* convexShape = static_cast<btConvexShape*>(body->getCollisionShape());
-					sweepResults.m_allowedPenetration=getDispatchInfo().m_allowedCcdPenetration;
+		//btConvexShape* convexShape = static_cast<btConvexShape*>(body->getCollisionShape());
+		btSphereShape tmpSphere(body->getCcdSweptSphereRadius());//btConvexShape* convexShape = static_cast<btConvexShape*>(body->getCollisionShape());
+		sweepResults.m_allowedPenetration=getDispatchInfo().m_allowedCcdPenetration;
 
-					sweepResults.m_collisionFilterGroup = body->getBroadphaseProxy()->m_collisionFilterGroup;
-					sweepResults.m_collisionFilterMask  = body->getBroadphaseProxy()->m_collisionFilterMask;
-					btTransform modifiedPredictedTrans = predictedTrans;
-					modifiedPredictedTrans.setBasis(body->getWorldTransform().getBasis());
+		sweepResults.m_collisionFilterGroup = body->getBroadphaseProxy()->m_collisionFilterGroup;
+		sweepResults.m_collisionFilterMask  = body->getBroadphaseProxy()->m_collisionFilterMask;
+		btTransform modifiedPredictedTrans = predictedTrans;
+		modifiedPredictedTrans.setBasis(body->getWorldTransform().getBasis());
 
-					convexSweepTest(&tmpSphere,body->getWorldTransform(),modifiedPredictedTrans,sweepResults);
-					if (sweepResults.hasHit() && (sweepResults.m_closestHitFraction < 1.f))
-					{
-						
-						//printf("clamped integration to hit fraction = %f\n",fraction);
-						body->setHitFraction(sweepResults.m_closestHitFraction);
-						body->predictIntegratedTransform(timeStep*body->getHitFraction(), predictedTrans);
-						body->setHitFraction(0.f);
-						body->proceedToTransform( predictedTrans);
+		convexSweepTest(&tmpSphere,body->getWorldTransform(),modifiedPredictedTrans,sweepResults);
+		if (sweepResults.hasHit() && (sweepResults.m_closestHitFraction < 1.f))
+		{
+			
+			//printf("clamped integration to hit fraction = %f\n",fraction);
+			btTransform clampedTrans;
+			body->setHitFraction(sweepResults.m_closestHitFraction);
+			body->predictIntegratedTransform(timeStep*body->getHitFraction(), clampedTrans);
+			body->setHitFraction(0.f);
+			body->proceedToTransform( clampedTrans);
 
 #if 0
-						btVector3 linVel = body->getLinearVelocity();
+			btVector3 linVel = body->getLinearVelocity();
 
-						btScalar maxSpeed = body->getCcdMotionThreshold()/getSolverInfo().m_timeStep;
-						btScalar maxSpeedSqr = maxSpeed*maxSpeed;
-						if (linVel.length2()>maxSpeedSqr)
-						{
-							linVel.normalize();
-							linVel*= maxSpeed;
-							body->setLinearVelocity(linVel);
-							btScalar ms2 = body->getLinearVelocity().length2();
-							body->predictIntegratedTransform(timeStep, predictedTrans);
-
-							btScalar sm2 = (predictedTrans.getOrigin()-body->getWorldTransform().getOrigin()).length2();
-							btScalar smt = body->getCcdSquareMotionThreshold();
-							printf("sm2=%f\n",sm2);
-						}
+			btScalar maxSpeed = body->getCcdMotionThreshold()/getSolverInfo().m_timeStep;
+			btScalar maxSpeedSqr = maxSpeed*maxSpeed;
+			if (linVel.length2()>maxSpeedSqr)
+			{
+				linVel.normalize();
+				linVel*= maxSpeed;
+				body->setLinearVelocity(linVel);
+				btScalar ms2 = body->getLinearVelocity().length2();
+				body->predictIntegratedTransform(timeStep, predictedTrans);
+
+				btScalar sm2 = (predictedTrans.getOrigin()-body->getWorldTransform().getOrigin()).length2();
+				btScalar smt = body->getCcdSquareMotionThreshold();
+				printf("sm2=%f\n",sm2);
+			}
 #else
-						
-						//don't apply the collision response right now, it will happen next frame
-						//if you really need to, you can uncomment next 3 lines. Note that is uses zero restitution.
-						//btScalar appliedImpulse = 0.f;
-						//btScalar depth = 0.f;
-						//appliedImpulse = resolveSingleCollision(body,(btCollisionObject*)sweepResults.m_hitCollisionObject,sweepResults.m_hitPointWorld,sweepResults.m_hitNormalWorld,getSolverInfo(), depth);
-						
+			
+			//don't apply the collision response right now, it will happen next frame
+			//if you really need to, you can uncomment next 3 lines. Note that is uses zero restitution.
+			//btScalar appliedImpulse = 0.f;
+			//btScalar depth = 0.f;
+			//appliedImpulse = resolveSingleCollision(body,(btCollisionObject*)sweepResults.m_hitCollisionObject,sweepResults.m_hitPointWorld,sweepResults.m_hitNormalWorld,getSolverInfo(), depth);
+			
 
 #endif
 
-        				continue;
-					}
+			return true;
+		}
+	}
+	return false;
+}
+
+///collects the objects that overlap the swept volumes of the CCD motions
+struct btCcdCandidateCollector : public btBroadphaseAabbBatchCallback
+{
+	btAlignedObjectArray<btCcdCandidate>*	m_candidates;
+
+	virtual void	process(const btBroadphaseProxy* proxy, int boxIndex)
+	{
+		btCcdCandidate& candidate = m_candidates->expandNonInitializing();
+		candidate.m_proxy = proxy;
+		candidate.m_motion = boxIndex;
+		candidate.m_proxyUid = proxy->getUid();
+	}
+};
+
+struct btCcdCandidateSortPredicate
+{
+	bool operator() ( const btCcdCandidate& a, const btCcdCandidate& b ) const
+	{
+		if (a.m_motion != b.m_motion)
+			return a.m_motion < b.m_motion;
+		return a.m_proxyUid < b.m_proxyUid;
+	}
+};
+
+///sweeps a sphere along each motion, against its candidates. The same tests as clampMotionCcd, without changing any body.
+struct btCcdSweepLoop : public btIParallelForBody
+{
+	btCcdMotion*	m_motions;
+	const btCcdCandidate*	m_candidates;
+	btOverlappingPairCache*	m_pairCache;
+	btDispatcher*	m_dispatcher;
+	btScalar	m_allowedCcdPenetration;
+
+	void	forLoop(int iBegin, int iEnd) const
+	{
+		for (int i=iBegin;i<iEnd;i++)
+		{
+			btCcdMotion& motion = m_motions[i];
+			btRigidBody* body = motion.m_body;
+			const btTransform& fromTrans = body->getWorldTransform();
+			btClosestNotMeConvexResultCallback sweepResults(body,fromTrans.getOrigin(),motion.m_predictedTrans.getOrigin(),m_pairCache,m_dispatcher);
+			btSphereShape tmpSphere(body->getCcdSweptSphereRadius());
+			sweepResults.m_allowedPenetration = m_allowedCcdPenetration;
+			sweepResults.m_collisionFilterGroup = body->getBroadphaseProxy()->m_collisionFilterGroup;
+			sweepResults.m_collisionFilterMask  = body->getBroadphaseProxy()->m_collisionFilterMask;
+			btTransform modifiedPredictedTrans = motion.m_predictedTrans;
+			modifiedPredictedTrans.setBasis(fromTrans.getBasis());
+
+			for (int c=motion.m_firstCandidate;c<motion.m_firstCandidate+motion.m_numCandidates;c++)
+			{
+				if (sweepResults.m_closestHitFraction == btScalar(0.f))
+					break;
+				btBroadphaseProxy* proxy = const_cast<btBroadphaseProxy*>(m_candidates[c].m_proxy);
+				if (sweepResults.needsCollision(proxy))
+				{
+					btCollisionObject* collisionObject = (btCollisionObject*)proxy->m_clientObject;
+					btCollisionWorld::objectQuerySingle(&tmpSphere,fromTrans,modifiedPredictedTrans,
+						collisionObject,collisionObject->getCollisionShape(),collisionObject->getWorldTransform(),
+						sweepResults,btScalar(0.));
 				}
 			}
-			
+			motion.m_hitFraction = sweepResults.hasHit() ? sweepResults.m_closestHitFraction : btScalar(1.);
+			motion.m_hitNormalWorld = sweepResults.m_hitNormalWorld;
+			motion.m_hitObject = sweepResults.m_hitCollisionObject;
+		}
+	}
+};
 
-			body->proceedToTransform( predictedTrans);
-		
+void	btDiscreteDynamicsWorld::sweepCcdMotions()
+{
+	int numMotions = m_ccdMotions.size();
+
+	//the swept volume of the sphere of each motion
+	m_ccdSweptAabbs.resize(numMotions*2);
+	for (int i=0;i<numMotions;i++)
+	{
+		const btCcdMotion& motion = m_ccdMotions[i];
+		const btVector3& from = motion.m_body->getWorldTransform().getOrigin();
+		const btVector3& to = motion.m_predictedTrans.getOrigin();
+		btVector3 radius(motion.m_body->getCcdSweptSphereRadius(),motion.m_body->getCcdSweptSphereRadius(),motion.m_body->getCcdSweptSphereRadius());
+		btVector3 aabbMin = from;
+		btVector3 aabbMax = from;
+		aabbMin.setMin(to);
+		aabbMax.setMax(to);
+		m_ccdSweptAabbs[i] = aabbMin-radius;
+		m_ccdSweptAabbs[numMotions+i] = aabbMax+radius;
+	}
+
+	//one broadphase pass for all of them, the candidates of each motion are sorted so that the results don't depend on the broadphase traversal
+	m_ccdCandidates.resize(0);
+	btCcdCandidateCollector collector;
+	collector.m_candidates = &m_ccdCandidates;
+	getBroadphase()->refitIfNeeded();
+	getBroadphase()->aabbTestBatch(&m_ccdSweptAabbs[0],&m_ccdSweptAabbs[numMotions],numMotions,collector);
+	m_ccdCandidates.quickSort(btCcdCandidateSortPredicate());
+	int c = 0;
+	for (int i=0;i<numMotions;i++)
+	{
+		btCcdMotion& motion = m_ccdMotions[i];
+		motion.m_firstCandidate = c;
+		while (c<m_ccdCandidates.size() && m_ccdCandidates[c].m_motion==i)
+			c++;
+		motion.m_numCandidates = c-motion.m_firstCandidate;
+	}
+
+	btCcdSweepLoop loop;
+	loop.m_motions = &m_ccdMotions[0];
+	loop.m_candidates = m_ccdCandidates.size() ? &m_ccdCandidates[0] : 0;
+	loop.m_pairCache = getBroadphase()->getOverlappingPairCache();
+	loop.m_dispatcher = getDispatcher();
+	loop.m_allowedCcdPenetration = getDispatchInfo().m_allowedCcdPenetration;
+	btParallelFor(0,numMotions,1,loop);
+}
+
+void	btDiscreteDynamicsWorld::clampMotionsCcd(btScalar timeStep)
+{
+	BT_PROFILE("CCD motion clamping (batched)");
+	sweepCcdMotions();
+
+	//move the bodies, in order
+	for (int i=0;i<m_ccdMotions.size();i++)
+	{
+		const btCcdMotion& motion = m_ccdMotions[i];
+		btRigidBody* body = motion.m_body;
+		gNumClampedCcdMotions++;
+		if (motion.m_hitFraction < btScalar(1.))
+		{
+			btTransform clampedTrans;
+			body->setHitFraction(motion.m_hitFraction);
+			body->predictIntegratedTransform(timeStep*body->getHitFraction(), clampedTrans);
+			body->setHitFraction(0.f);
+			body->proceedToTransform( clampedTrans);
+		} else if (motion.m_poolIndex >= 0)
+		{
+			m_bodyStatePool->storeIntegratedTransform(motion.m_poolIndex);
+		} else
+		{
+			body->proceedToTransform( motion.m_predictedTrans);
 		}
+	}
+}
 
+void	btDiscreteDynamicsWorld::integrateTransforms(btScalar timeStep)
+{
+	BT_PROFILE("integrateTransforms");
+	btTransform predictedTrans;
+	m_ccdMotions.resizeNoInitialize(0);
+	if (m_bodyStatePool)
+	{
+		m_bodyStatePoolBodies.resize(0);
+		for ( int i=0;i<m_nonStaticRigidBodies.size();i++)
+		{
+			btRigidBody* body = m_nonStaticRigidBodies[i];
+			body->setHitFraction(1.f);
+			if (body->isActive() && (!body->isStaticOrKinematicObject()))
+				m_bodyStatePoolBodies.push_back(body);
+		}
+		if (m_bodyStatePoolBodies.size())
+		{
+			m_bodyStatePool->loadBodies(&m_bodyStatePoolBodies[0],m_bodyStatePoolBodies.size());
+			m_bodyStatePool->integrate(timeStep);
+			m_bodyStatePool->updateBasis();
+		}
+		for (int i=0;i<m_bodyStatePoolBodies.size();i++)
+		{
+			btRigidBody* body = m_bodyStatePoolBodies[i];
+			if (getDispatchInfo().m_useContinuous && body->getCcdSquareMotionThreshold() && body->getCcdSquareMotionThreshold() < m_bodyStatePool->getSquareMotion(i))
+			{
+				m_bodyStatePool->getPredictedTransform(i,predictedTrans);
+				if (m_useBatchedCcd && body->getCollisionShape()->isConvex())
+				{
+					btCcdMotion& motion = m_ccdMotions.expandNonInitializing();
+					motion.m_body = body;
+					motion.m_predictedTrans = predictedTrans;
+					motion.m_poolIndex = i;
+					continue;
+				}
+				if (clampMotionCcd(body,timeStep,predictedTrans))
+					continue;
+			}
+			m_bodyStatePool->storeIntegratedTransform(i);
+		}
+	} else
+	{
+		for ( int i=0;i<m_nonStaticRigidBodies.size();i++)
+		{
+			btRigidBody* body = m_nonStaticRigidBodies[i];
+			body->setHitFraction(1.f);
+
+			if (body->isActive() && (!body->isStaticOrKinematicObject()))
+			{
+
+				body->predictIntegratedTransform(timeStep, predictedTrans);
+				
+				btScalar squareMotion = (predictedTrans.getOrigin()-body->getWorldTransform().getOrigin()).length2();
+
+				if (getDispatchInfo().m_useContinuous && body->getCcdSquareMotionThreshold() && body->getCcdSquareMotionThreshold() < squareMotion)
+				{
+					if (m_useBatchedCcd && body->getCollisionShape()->isConvex())
+					{
+						btCcdMotion& motion = m_ccdMotions.expandNonInitializing();
+						motion.m_body = body;
+						motion.m_predictedTrans = predictedTrans;
+						motion.m_poolIndex = -1;
+						continue;
+					}
+					if (clampMotionCcd(body,timeStep,predictedTrans))
+						continue;
+				}
+
+				body->proceedToTransform( predictedTrans);
+			}
+		}
+	}
+
+	if (m_ccdMotions.size())
+	{
+		clampMotionsCcd(timeStep);
 	}
 
 	///this should probably be switched on by default, but it is not well tested yet
@@ -1124,6 +1412,30 @@ void	btDiscreteDynamicsWorld::integrateTransforms(btScalar timeStep)
 void	btDiscreteDynamicsWorld::predictUnconstraintMotion(btScalar timeStep)
 {
 	BT_PROFILE("predictUnconstraintMotion");
+	if (m_bodyStatePool)
+	{
+		m_bodyStatePoolBodies.resize(0);
+		for ( int i=0;i<m_nonStaticRigidBodies.size();i++)
+		{
+			btRigidBody* body = m_nonStaticRigidBodies[i];
+			if (!body->isStaticOrKinematicObject())
+				m_bodyStatePoolBodies.push_back(body);
+		}
+		if (!m_bodyStatePoolBodies.size())
+			return;
+
+		m_bodyStatePool->loadBodies(&m_bodyStatePoolBodies[0],m_bodyStatePoolBodies.size());
+		m_bodyStatePool->applyDamping(timeStep);
+		m_bodyStatePool->integrate(timeStep);
+		m_bodyStatePool->updateBasis();
+		for (int i=0;i<m_bodyStatePoolBodies.size();i++)
+		{
+			m_bodyStatePool->storeVelocities(i);
+			m_bodyStatePool->getPredictedTransform(i,m_bodyStatePoolBodies[i]->getInterpolationWorldTransform());
+		}
+		return;
+	}
+
 	for ( int i=0;i<m_nonStaticRigidBodies.size();i++)
 	{
 		btRigidBody* body = m_nonStaticRigidBodies[i];
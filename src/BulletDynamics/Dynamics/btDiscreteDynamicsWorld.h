@@ -27,10 +27,33 @@ class btTypedConstraint;
 class btActionInterface;
 class btPersistentManifold;
 class btIDebugDraw;
+class btRigidBodyStatePool;
+class btManifoldReduction;
 struct InplaceSolverIslandCallback;
 
 #include "LinearMath/btAlignedObjectArray.h"
 
+///the motion of a fast moving body, swept by the batched CCD stage of btDiscreteDynamicsWorld (see setUseBatchedCcd)
+ATTRIBUTE_ALIGNED16(struct) btCcdMotion
+{
+	btTransform		m_predictedTrans;
+	btVector3		m_hitNormalWorld;
+	btRigidBody*	m_body;
+	const btCollisionObject*	m_hitObject;
+	int				m_poolIndex;	///< index in the btRigidBodyStatePool, or -1
+	int				m_firstCandidate;
+	int				m_numCandidates;
+	btScalar		m_hitFraction;
+};
+
+///an object whose broadphase AABB overlaps the swept volume of a btCcdMotion
+struct btCcdCandidate
+{
+	const btBroadphaseProxy*	m_proxy;
+	int		m_motion;
+	int		m_proxyUid;
+};
+
 
 ///btDiscreteDynamicsWorld provides discrete rigid body simulation
 ///those classes replace the obsolete CcdPhysicsEnvironment/CcdPhysicsController
@@ -66,9 +89,31 @@ protected:
 
 	btAlignedObjectArray<btPersistentManifold*>	m_predictiveManifolds;
 
+	btRigidBodyStatePool*	m_bodyStatePool;
+	btAlignedObjectArray<btRigidBody*>	m_bodyStatePoolBodies;
+
+	btManifoldReduction*	m_manifoldReduction;
+
+	bool	m_useBatchedCcd;
+	btAlignedObjectArray<btCcdMotion>	m_ccdMotions;
+	btAlignedObjectArray<btCcdCandidate>	m_ccdCandidates;
+	btAlignedObjectArray<btVector3>	m_ccdSweptAabbs;
+
 	virtual void	predictUnconstraintMotion(btScalar timeStep);
 	
 	virtual void	integrateTransforms(btScalar timeStep);
+
+	///sweep a sphere along the predicted motion of a fast moving body, if it hits something the body is moved to the time of impact and true is returned
+	bool	clampMotionCcd(btRigidBody* body, btScalar timeStep, const btTransform& predictedTrans);
+
+	///one broadphase query for the swept volumes of all m_ccdMotions, then the sphere sweeps in parallel. Only the m_ccdMotions are written.
+	void	sweepCcdMotions();
+
+	///the batched CCD stage of integrateTransforms: sweepCcdMotions, then the bodies are moved
+	void	clampMotionsCcd(btScalar timeStep);
+
+	///adds a manifold with a single predictive contact between the body and the object its swept sphere hits
+	void	addPredictiveContact(btRigidBody* body, const btTransform& predictedTrans, btScalar hitFraction, const btVector3& hitNormalWorld, const btCollisionObject* hitObject);
 		
 	virtual void	calculateSimulationIslands();
 
@@ -213,6 +258,39 @@ public:
 		return m_applySpeculativeContactRestitution;
 	}
 
+	///damp and integrate the bodies using a btRigidBodyStatePool (SoA copy of the body state, processed with SIMD), off by default.
+	///The copy in and out of the pool makes it slower than the per-body code in the benchmark scenes, see btRigidBodyStatePool
+	void	setUseBodyStatePool(bool useBodyStatePool);
+
+	bool	getUseBodyStatePool() const
+	{
+		return m_bodyStatePool != 0;
+	}
+
+	///merge the contact manifolds of each pair of objects into one manifold with a few representative points before solving, off by default.
+	///This mostly helps compound shapes, which create a manifold per child shape. See btManifoldReduction.
+	///The dispatcher reports the manifolds it releases to the reduction, so the dispatcher must outlive the world, as usual.
+	void	setUseManifoldReduction(bool useManifoldReduction);
+
+	btManifoldReduction*	getManifoldReduction()
+	{
+		return m_manifoldReduction;
+	}
+
+	///sweep the fast moving bodies in separate stages, with the sphere sweeps done in parallel, off by default.
+	///The predictive contacts are staged per body and added in the order of the bodies, so they are the same as without batching.
+	///The motions are clamped after the integration: all sweeps see the other bodies after their integration, except the fast moving bodies,
+	///which are seen where they started. The results don't depend on the number of threads, but they can differ from the default,
+	///where each body sees the bodies integrated before it.
+	void	setUseBatchedCcd(bool useBatchedCcd)
+	{
+		m_useBatchedCcd = useBatchedCcd;
+	}
+	bool	getUseBatchedCcd() const
+	{
+		return m_useBatchedCcd;
+	}
+
 	///Preliminary serialization test for Bullet 2.76. Loading those files requires a separate parser (see Bullet/Demos/SerializeDemo)
 	virtual	void	serialize(btSerializer* serializer);
 
@@ -0,0 +1,283 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "btDiscreteDynamicsWorldMt.h"
+
+//collision detection
+#include "BulletCollision/BroadphaseCollision/btDispatcher.h"
+#include "BulletCollision/CollisionDispatch/btCollisionWorld.h"
+#include "btSimulationIslandManagerMt.h"
+#include "BulletCollision/NarrowPhaseCollision/btManifoldReduction.h"
+#include "LinearMath/btQuickprof.h"
+#include "LinearMath/btStackAlloc.h"
+
+//rigidbody & constraints
+#include "BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolver.h"
+#include "BulletDynamics/ConstraintSolver/btContactSolverInfo.h"
+#include "BulletDynamics/ConstraintSolver/btTypedConstraint.h"
+
+
+struct InplaceSolverIslandCallbackMt : public btSimulationIslandManagerMt::IslandCallback
+{
+	btContactSolverInfo*	m_solverInfo;
+	btConstraintSolver*		m_solver;
+	btIDebugDraw*			m_debugDrawer;
+	btStackAlloc*			m_stackAlloc;
+	btThreadStackAlloc*		m_threadStackAlloc;
+	btDispatcher*			m_dispatcher;
+	const btManifoldReduction*	m_manifoldReduction;
+
+	InplaceSolverIslandCallbackMt(
+		btConstraintSolver*	solver,
+		btStackAlloc* stackAlloc,
+		btThreadStackAlloc* threadStackAlloc,
+		btDispatcher* dispatcher)
+		:m_solverInfo(NULL),
+		m_solver(solver),
+		m_debugDrawer(NULL),
+		m_stackAlloc(stackAlloc),
+		m_threadStackAlloc(threadStackAlloc),
+		m_dispatcher(dispatcher),
+		m_manifoldReduction(NULL)
+	{
+
+	}
+
+	InplaceSolverIslandCallbackMt& operator=(InplaceSolverIslandCallbackMt& other)
+	{
+		btAssert(0);
+		(void)other;
+		return *this;
+	}
+
+	SIMD_FORCE_INLINE void setup ( btContactSolverInfo* solverInfo, btConstraintSolver* solver, btIDebugDraw* debugDrawer, const btManifoldReduction* manifoldReduction)
+	{
+		btAssert(solverInfo);
+		m_solverInfo = solverInfo;
+		m_solver = solver;
+		m_debugDrawer = debugDrawer;
+		m_manifoldReduction = manifoldReduction;
+	}
+
+	virtual	void	processIsland(btCollisionObject** bodies,int numBodies,btPersistentManifold** manifolds,int numManifolds,btTypedConstraint** constraints,int numConstraints,int islandId)
+	{
+		(void)islandId;
+		//islands are processed concurrently, each thread solves with its own stack allocator
+		btStackAlloc* stackAlloc = m_threadStackAlloc ? m_threadStackAlloc->getStackAlloc() : m_stackAlloc;
+		if (m_manifoldReduction)
+		{
+			//the substituted list is local as well
+			btAlignedObjectArray<btPersistentManifold*> reducedManifolds;
+			btBlock* block = stackAlloc ? stackAlloc->beginBlock() : 0;
+			if (block)
+			{
+				reducedManifolds.initializeFromBuffer(stackAlloc->allocate(sizeof(btPersistentManifold*)*numManifolds),0,numManifolds);
+			}
+			m_manifoldReduction->substituteManifolds(manifolds,numManifolds,reducedManifolds);
+			btPersistentManifold** reducedPtr = reducedManifolds.size() ? &reducedManifolds[0] : 0;
+			m_solver->solveGroup( bodies,numBodies,reducedPtr,reducedManifolds.size(),constraints,numConstraints,*m_solverInfo,m_debugDrawer,stackAlloc,m_dispatcher);
+			if (block)
+			{
+				reducedManifolds.initializeFromBuffer(0,0,0);
+				stackAlloc->endBlock(block);
+			}
+			return;
+		}
+		m_solver->solveGroup( bodies,numBodies,manifolds,numManifolds,constraints,numConstraints,*m_solverInfo,m_debugDrawer,stackAlloc,m_dispatcher);
+	}
+};
+
+
+btConstraintSolverPoolMt::btConstraintSolverPoolMt(int numSolvers)
+{
+	btAssert(numSolvers>0);
+	m_ownsSolvers = true;
+	growSolvers(numSolvers);
+}
+
+btConstraintSolverPoolMt::btConstraintSolverPoolMt(btConstraintSolver** solvers, int numSolvers)
+{
+	init(solvers,numSolvers);
+	m_ownsSolvers = false;
+}
+
+btConstraintSolverPoolMt::~btConstraintSolverPoolMt()
+{
+	if (m_ownsSolvers)
+	{
+		for (int i=0;i<m_solvers.size();i++)
+		{
+			m_solvers[i].solver->~btConstraintSolver();
+			btAlignedFree(m_solvers[i].solver);
+		}
+	}
+}
+
+void btConstraintSolverPoolMt::init(btConstraintSolver** solvers, int numSolvers)
+{
+	btAssert(numSolvers>0);
+	m_solvers.resize(numSolvers);
+	for (int i=0;i<numSolvers;i++)
+	{
+		m_solvers[i].solver = solvers[i];
+	}
+}
+
+void btConstraintSolverPoolMt::growSolvers(int numSolvers)
+{
+	if (!m_ownsSolvers)
+		return;
+	while (m_solvers.size()<numSolvers)
+	{
+		void* mem = btAlignedAlloc(sizeof(btSequentialImpulseConstraintSolver),16);
+		ThreadSolver& ts = m_solvers.expand();
+		ts.solver = new (mem) btSequentialImpulseConstraintSolver();
+	}
+}
+
+btConstraintSolverPoolMt::ThreadSolver* btConstraintSolverPoolMt::getAndLockThreadSolver()
+{
+	//start looking at the solver of this thread, so that without contention each thread keeps using the same (warm) solver
+	int i = int(btGetCurrentThreadIndex() % unsigned(m_solvers.size()));
+	for (;;)
+	{
+		ThreadSolver& solver = m_solvers[i];
+		if (btMutexTryLock(&solver.mutex))
+		{
+			return &solver;
+		}
+		i = (i+1) % m_solvers.size();
+	}
+}
+
+void btConstraintSolverPoolMt::prepareSolve(int numBodies, int numManifolds)
+{
+	for (int i=0;i<m_solvers.size();i++)
+	{
+		m_solvers[i].solver->prepareSolve(numBodies,numManifolds);
+	}
+}
+
+btScalar btConstraintSolverPoolMt::solveGroup(btCollisionObject** bodies,int numBodies,btPersistentManifold** manifolds,int numManifolds,btTypedConstraint** constraints,int numConstraints,const btContactSolverInfo& info,btIDebugDraw* debugDrawer,btStackAlloc* stackAlloc,btDispatcher* dispatcher)
+{
+	ThreadSolver* ts = getAndLockThreadSolver();
+	ts->solver->solveGroup(bodies,numBodies,manifolds,numManifolds,constraints,numConstraints,info,debugDrawer,stackAlloc,dispatcher);
+	btMutexUnlock(&ts->mutex);
+	return 0.f;
+}
+
+void btConstraintSolverPoolMt::allSolved(const btContactSolverInfo& info,btIDebugDraw* debugDrawer,btStackAlloc* stackAlloc)
+{
+	for (int i=0;i<m_solvers.size();i++)
+	{
+		m_solvers[i].solver->allSolved(info,debugDrawer,stackAlloc);
+	}
+}
+
+void btConstraintSolverPoolMt::reset()
+{
+	for (int i=0;i<m_solvers.size();i++)
+	{
+		m_solvers[i].solver->reset();
+	}
+}
+
+
+static btConstraintSolverPoolMt* btCreateConstraintSolverPool()
+{
+	void* mem = btAlignedAlloc(sizeof(btConstraintSolverPoolMt),16);
+	return new (mem) btConstraintSolverPoolMt(btGetTaskScheduler()->getMaxNumThreads());
+}
+
+btDiscreteDynamicsWorldMt::btDiscreteDynamicsWorldMt(btDispatcher* dispatcher,btBroadphaseInterface* pairCache,btConstraintSolverPoolMt* solverPool,btCollisionConfiguration* collisionConfiguration)
+:btDiscreteDynamicsWorld(dispatcher,pairCache,solverPool ? solverPool : btCreateConstraintSolverPool(),collisionConfiguration),
+m_solverIslandCallbackMt(NULL)
+{
+	m_ownsConstraintSolver = (solverPool == NULL);
+
+	if (m_ownsIslandManager)
+	{
+		m_islandManager->~btSimulationIslandManager();
+		btAlignedFree( m_islandManager);
+	}
+	{
+		void* mem = btAlignedAlloc(sizeof(btSimulationIslandManagerMt),16);
+		m_islandManager = new (mem) btSimulationIslandManagerMt();
+		m_ownsIslandManager = true;
+	}
+	{
+		void* mem = btAlignedAlloc(sizeof(InplaceSolverIslandCallbackMt),16);
+		m_solverIslandCallbackMt = new (mem) InplaceSolverIslandCallbackMt(m_constraintSolver, m_stackAlloc, m_dispatchInfo.m_threadStackAllocator, dispatcher);
+	}
+}
+
+void	btDiscreteDynamicsWorldMt::setConstraintSolver(btConstraintSolver* solver)
+{
+	if (solver == m_constraintSolver)
+		return;
+	void* mem = btAlignedAlloc(sizeof(btConstraintSolverPoolMt),16);
+	btConstraintSolverPoolMt* solverPool = new (mem) btConstraintSolverPoolMt(&solver,1);
+	setConstraintSolverPool(solverPool);
+	m_ownsConstraintSolver = true;
+}
+
+void	btDiscreteDynamicsWorldMt::setConstraintSolverPool(btConstraintSolverPoolMt* solverPool)
+{
+	//btDiscreteDynamicsWorld::setConstraintSolver frees the solver it owns without destroying it
+	if (m_ownsConstraintSolver)
+	{
+		m_constraintSolver->~btConstraintSolver();
+		btAlignedFree(m_constraintSolver);
+		m_ownsConstraintSolver = false;
+	}
+	btDiscreteDynamicsWorld::setConstraintSolver(solverPool);
+}
+
+btDiscreteDynamicsWorldMt::~btDiscreteDynamicsWorldMt()
+{
+	if (m_solverIslandCallbackMt)
+	{
+		m_solverIslandCallbackMt->~InplaceSolverIslandCallbackMt();
+		btAlignedFree(m_solverIslandCallbackMt);
+	}
+}
+
+
+void	btDiscreteDynamicsWorldMt::solveConstraints(btContactSolverInfo& solverInfo)
+{
+	BT_PROFILE("solveConstraints");
+
+	//the islands are solved concurrently, so m_constraintSolver must be able to run several solveGroup at once (see btConstraintSolverPoolMt)
+	if (m_manifoldReduction)
+	{
+		btDispatcher* dispatcher = getCollisionWorld()->getDispatcher();
+		m_manifoldReduction->reduceManifolds(dispatcher->getInternalManifoldPointer(),dispatcher->getNumManifolds());
+	}
+
+	//the task scheduler may have more threads than when the pool was created
+	btConstraintSolverPoolMt* solverPool = static_cast<btConstraintSolverPoolMt*>(m_constraintSolver);
+	solverPool->growSolvers(btGetTaskScheduler()->getNumThreads());
+
+	m_solverIslandCallbackMt->setup(&solverInfo,m_constraintSolver,getDebugDrawer(),m_manifoldReduction);
+	m_constraintSolver->prepareSolve(getCollisionWorld()->getNumCollisionObjects(), getCollisionWorld()->getDispatcher()->getNumManifolds());
+
+	/// solve all the constraints for this island
+	btSimulationIslandManagerMt* islandManager = static_cast<btSimulationIslandManagerMt*>(m_islandManager);
+	islandManager->setMinimumSolverBatchSize(solverInfo.m_minimumSolverBatchSize);
+	islandManager->buildAndProcessIslands(getCollisionWorld()->getDispatcher(),getCollisionWorld(),m_constraints,m_solverIslandCallbackMt);
+
+	m_constraintSolver->allSolved(solverInfo, m_debugDrawer, m_stackAlloc);
+}
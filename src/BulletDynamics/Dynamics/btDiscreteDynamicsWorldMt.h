@@ -0,0 +1,97 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef BT_DISCRETE_DYNAMICS_WORLD_MT_H
+#define BT_DISCRETE_DYNAMICS_WORLD_MT_H
+
+#include "btDiscreteDynamicsWorld.h"
+#include "BulletDynamics/ConstraintSolver/btConstraintSolver.h"
+#include "LinearMath/btThreads.h"
+
+struct InplaceSolverIslandCallbackMt;
+
+
+///btConstraintSolverPoolMt masquerades as a single constraint solver, but owns a pool of solvers,
+///so that several islands can be solved at the same time. Each solveGroup call grabs a solver that is not in use.
+class btConstraintSolverPoolMt : public btConstraintSolver
+{
+	struct ThreadSolver
+	{
+		btConstraintSolver*	solver;
+		btSpinMutex			mutex;
+	};
+	btAlignedObjectArray<ThreadSolver>	m_solvers;
+	bool	m_ownsSolvers;
+
+	ThreadSolver*	getAndLockThreadSolver();
+	void	init(btConstraintSolver** solvers, int numSolvers);
+
+public:
+	///creates numSolvers btSequentialImpulseConstraintSolver, use the number of threads of the task scheduler
+	btConstraintSolverPoolMt(int numSolvers);
+
+	///uses the given solvers, which are not owned
+	btConstraintSolverPoolMt(btConstraintSolver** solvers, int numSolvers);
+
+	virtual ~btConstraintSolverPoolMt();
+
+	int		getNumSolvers() const
+	{
+		return m_solvers.size();
+	}
+
+	///adds btSequentialImpulseConstraintSolvers until there are numSolvers, when the pool created its solvers.
+	///A pool of given solvers keeps its size, the islands wait for a free solver. Only call it while nothing is being solved.
+	void	growSolvers(int numSolvers);
+
+	virtual void prepareSolve(int numBodies, int numManifolds);
+
+	virtual btScalar solveGroup(btCollisionObject** bodies,int numBodies,btPersistentManifold** manifolds,int numManifolds,btTypedConstraint** constraints,int numConstraints,const btContactSolverInfo& info,btIDebugDraw* debugDrawer,btStackAlloc* stackAlloc,btDispatcher* dispatcher);
+
+	virtual void allSolved(const btContactSolverInfo& info,btIDebugDraw* debugDrawer,btStackAlloc* stackAlloc);
+
+	virtual	void	reset();
+};
+
+
+///btDiscreteDynamicsWorldMt solves the simulation islands in parallel, using btParallelFor and the task scheduler set with btSetTaskScheduler.
+///The islands are built with btSimulationIslandManagerMt, and each one is solved by a solver from a btConstraintSolverPoolMt.
+///The results are identical to those of a single threaded run, as long as SOLVER_RANDMIZE_ORDER is not used.
+ATTRIBUTE_ALIGNED16(class) btDiscreteDynamicsWorldMt : public btDiscreteDynamicsWorld
+{
+protected:
+	InplaceSolverIslandCallbackMt*	m_solverIslandCallbackMt;
+
+	virtual void	solveConstraints(btContactSolverInfo& solverInfo);
+
+public:
+
+	BT_DECLARE_ALIGNED_ALLOCATOR();
+
+	///when solverPool is NULL, a pool with one btSequentialImpulseConstraintSolver per thread of the task scheduler is created.
+	///The pool grows when a task scheduler with more threads is set later.
+	btDiscreteDynamicsWorldMt(btDispatcher* dispatcher,btBroadphaseInterface* pairCache,btConstraintSolverPoolMt* solverPool,btCollisionConfiguration* collisionConfiguration);
+
+	virtual ~btDiscreteDynamicsWorldMt();
+
+	///the islands are solved at the same time, which a single solver can't do: solver is wrapped in a pool of one solver,
+	///that solves one island at a time. Use setConstraintSolverPool to solve the islands in parallel.
+	virtual void	setConstraintSolver(btConstraintSolver* solver);
+
+	void	setConstraintSolverPool(btConstraintSolverPoolMt* solverPool);
+};
+
+#endif //BT_DISCRETE_DYNAMICS_WORLD_MT_H
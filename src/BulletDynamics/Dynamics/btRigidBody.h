@@ -94,6 +94,8 @@ class btRigidBody  : public btCollisionObject
 	
 	int				m_debugBodyId;
 	
+	///btRigidBodyStatePool loads and stores the integration state directly
+	friend class btRigidBodyStatePool;
 
 protected:
 
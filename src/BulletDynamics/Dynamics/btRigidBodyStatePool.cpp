@@ -0,0 +1,343 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btRigidBodyStatePool.h"
+#include "btRigidBody.h"
+#include "LinearMath/btTransformUtil.h"
+
+///btBodyLanes holds one btScalar for each body of a btRigidBodyStateBlock
+#if defined (BT_USE_SSE) && !defined (BT_USE_DOUBLE_PRECISION)
+#include <emmintrin.h>
+typedef __m128	btBodyLanes;
+static SIMD_FORCE_INLINE btBodyLanes btLanesLoad(const btScalar* ptr) { return _mm_load_ps(ptr); }
+static SIMD_FORCE_INLINE void btLanesStore(btScalar* ptr, const btBodyLanes& v) { _mm_store_ps(ptr,v); }
+static SIMD_FORCE_INLINE btBodyLanes btLanesSplat(btScalar s) { return _mm_set1_ps(s); }
+static SIMD_FORCE_INLINE btBodyLanes btLanesAdd(const btBodyLanes& a, const btBodyLanes& b) { return _mm_add_ps(a,b); }
+static SIMD_FORCE_INLINE btBodyLanes btLanesSub(const btBodyLanes& a, const btBodyLanes& b) { return _mm_sub_ps(a,b); }
+static SIMD_FORCE_INLINE btBodyLanes btLanesMul(const btBodyLanes& a, const btBodyLanes& b) { return _mm_mul_ps(a,b); }
+static SIMD_FORCE_INLINE btBodyLanes btLanesDiv(const btBodyLanes& a, const btBodyLanes& b) { return _mm_div_ps(a,b); }
+static SIMD_FORCE_INLINE btBodyLanes btLanesSqrt(const btBodyLanes& a) { return _mm_sqrt_ps(a); }
+#elif defined (BT_USE_NEON) && !defined (BT_USE_DOUBLE_PRECISION)
+typedef float32x4_t	btBodyLanes;
+static SIMD_FORCE_INLINE btBodyLanes btLanesLoad(const btScalar* ptr) { return vld1q_f32(ptr); }
+static SIMD_FORCE_INLINE void btLanesStore(btScalar* ptr, const btBodyLanes& v) { vst1q_f32(ptr,v); }
+static SIMD_FORCE_INLINE btBodyLanes btLanesSplat(btScalar s) { return vdupq_n_f32(s); }
+static SIMD_FORCE_INLINE btBodyLanes btLanesAdd(const btBodyLanes& a, const btBodyLanes& b) { return vaddq_f32(a,b); }
+static SIMD_FORCE_INLINE btBodyLanes btLanesSub(const btBodyLanes& a, const btBodyLanes& b) { return vsubq_f32(a,b); }
+static SIMD_FORCE_INLINE btBodyLanes btLanesMul(const btBodyLanes& a, const btBodyLanes& b) { return vmulq_f32(a,b); }
+#ifdef __aarch64__
+static SIMD_FORCE_INLINE btBodyLanes btLanesDiv(const btBodyLanes& a, const btBodyLanes& b) { return vdivq_f32(a,b); }
+static SIMD_FORCE_INLINE btBodyLanes btLanesSqrt(const btBodyLanes& a) { return vsqrtq_f32(a); }
+#else
+//32-bit NEON has no divide and square root, the estimates are refined with two Newton-Raphson steps
+static SIMD_FORCE_INLINE btBodyLanes btLanesDiv(const btBodyLanes& a, const btBodyLanes& b)
+{
+	float32x4_t r = vrecpeq_f32(b);
+	r = vmulq_f32(vrecpsq_f32(b,r),r);
+	r = vmulq_f32(vrecpsq_f32(b,r),r);
+	return vmulq_f32(a,r);
+}
+static SIMD_FORCE_INLINE btBodyLanes btLanesSqrt(const btBodyLanes& a)
+{
+	//sqrt(a) = a/sqrt(a), clamping the reciprocal square root keeps the zero lanes zero
+	float32x4_t x = vmaxq_f32(a,vdupq_n_f32(FLT_MIN));
+	float32x4_t r = vrsqrteq_f32(x);
+	r = vmulq_f32(vrsqrtsq_f32(vmulq_f32(x,r),r),r);
+	r = vmulq_f32(vrsqrtsq_f32(vmulq_f32(x,r),r),r);
+	return vmulq_f32(a,r);
+}
+#endif //__aarch64__
+#else
+struct btBodyLanes
+{
+	btScalar	m_lanes[BT_BODY_STATE_BLOCK_WIDTH];
+};
+static SIMD_FORCE_INLINE btBodyLanes btLanesLoad(const btScalar* ptr) { btBodyLanes r; for (int i=0;i<BT_BODY_STATE_BLOCK_WIDTH;i++) r.m_lanes[i] = ptr[i]; return r; }
+static SIMD_FORCE_INLINE void btLanesStore(btScalar* ptr, const btBodyLanes& v) { for (int i=0;i<BT_BODY_STATE_BLOCK_WIDTH;i++) ptr[i] = v.m_lanes[i]; }
+static SIMD_FORCE_INLINE btBodyLanes btLanesSplat(btScalar s) { btBodyLanes r; for (int i=0;i<BT_BODY_STATE_BLOCK_WIDTH;i++) r.m_lanes[i] = s; return r; }
+static SIMD_FORCE_INLINE btBodyLanes btLanesAdd(const btBodyLanes& a, const btBodyLanes& b) { btBodyLanes r; for (int i=0;i<BT_BODY_STATE_BLOCK_WIDTH;i++) r.m_lanes[i] = a.m_lanes[i]+b.m_lanes[i]; return r; }
+static SIMD_FORCE_INLINE btBodyLanes btLanesSub(const btBodyLanes& a, const btBodyLanes& b) { btBodyLanes r; for (int i=0;i<BT_BODY_STATE_BLOCK_WIDTH;i++) r.m_lanes[i] = a.m_lanes[i]-b.m_lanes[i]; return r; }
+static SIMD_FORCE_INLINE btBodyLanes btLanesMul(const btBodyLanes& a, const btBodyLanes& b) { btBodyLanes r; for (int i=0;i<BT_BODY_STATE_BLOCK_WIDTH;i++) r.m_lanes[i] = a.m_lanes[i]*b.m_lanes[i]; return r; }
+static SIMD_FORCE_INLINE btBodyLanes btLanesDiv(const btBodyLanes& a, const btBodyLanes& b) { btBodyLanes r; for (int i=0;i<BT_BODY_STATE_BLOCK_WIDTH;i++) r.m_lanes[i] = a.m_lanes[i]/b.m_lanes[i]; return r; }
+static SIMD_FORCE_INLINE btBodyLanes btLanesSqrt(const btBodyLanes& a) { btBodyLanes r; for (int i=0;i<BT_BODY_STATE_BLOCK_WIDTH;i++) r.m_lanes[i] = btSqrt(a.m_lanes[i]); return r; }
+#endif
+
+static SIMD_FORCE_INLINE btBodyLanes btLanesDot3(const btScalar a[3][BT_BODY_STATE_BLOCK_WIDTH], const btScalar b[3][BT_BODY_STATE_BLOCK_WIDTH])
+{
+	btBodyLanes result = btLanesMul(btLanesLoad(a[0]),btLanesLoad(b[0]));
+	result = btLanesAdd(result,btLanesMul(btLanesLoad(a[1]),btLanesLoad(b[1])));
+	return btLanesAdd(result,btLanesMul(btLanesLoad(a[2]),btLanesLoad(b[2])));
+}
+
+static SIMD_FORCE_INLINE void btLanesSetVector3(btScalar v[3][BT_BODY_STATE_BLOCK_WIDTH], int lane, const btVector3& value)
+{
+	v[0][lane] = value.getX();
+	v[1][lane] = value.getY();
+	v[2][lane] = value.getZ();
+}
+
+static SIMD_FORCE_INLINE btVector3 btLanesGetVector3(const btScalar v[3][BT_BODY_STATE_BLOCK_WIDTH], int lane)
+{
+	return btVector3(v[0][lane],v[1][lane],v[2][lane]);
+}
+
+void	btRigidBodyStatePool::loadBodies(btRigidBody* const* bodies, int numBodies)
+{
+	m_bodies.resize(numBodies);
+	m_blocks.resize((numBodies+BT_BODY_STATE_BLOCK_WIDTH-1)/BT_BODY_STATE_BLOCK_WIDTH);
+	m_additionalDampingBodies.resize(0);
+
+	for (int i=0;i<numBodies;i++)
+	{
+		const btRigidBody* body = bodies[i];
+		m_bodies[i] = bodies[i];
+		int lane;
+		btRigidBodyStateBlock& block = getBlock(i,lane);
+
+		const btTransform& tr = body->getWorldTransform();
+		btQuaternion orn;
+		tr.getBasis().getRotation(orn);
+		btLanesSetVector3(block.m_position,lane,tr.getOrigin());
+		block.m_orientation[0][lane] = orn.getX();
+		block.m_orientation[1][lane] = orn.getY();
+		block.m_orientation[2][lane] = orn.getZ();
+		block.m_orientation[3][lane] = orn.getW();
+		btLanesSetVector3(block.m_linearVelocity,lane,body->m_linearVelocity);
+		btLanesSetVector3(block.m_angularVelocity,lane,body->m_angularVelocity);
+		btLanesSetVector3(block.m_invInertiaLocal,lane,body->m_invInertiaLocal);
+		block.m_linearDamping[lane] = body->m_linearDamping;
+		block.m_angularDamping[lane] = body->m_angularDamping;
+		if (body->m_additionalDamping)
+			m_additionalDampingBodies.push_back(i);
+	}
+
+	//padding lanes: at rest, identity orientation
+	for (int i=numBodies;i<m_blocks.size()*BT_BODY_STATE_BLOCK_WIDTH;i++)
+	{
+		int lane;
+		btRigidBodyStateBlock& block = getBlock(i,lane);
+		for (int j=0;j<3;j++)
+		{
+			block.m_position[j][lane] = btScalar(0.);
+			block.m_linearVelocity[j][lane] = btScalar(0.);
+			block.m_angularVelocity[j][lane] = btScalar(0.);
+			block.m_invInertiaLocal[j][lane] = btScalar(0.);
+		}
+		for (int j=0;j<3;j++)
+			block.m_orientation[j][lane] = btScalar(0.);
+		block.m_orientation[3][lane] = btScalar(1.);
+		block.m_linearDamping[lane] = btScalar(0.);
+		block.m_angularDamping[lane] = btScalar(0.);
+	}
+}
+
+void	btRigidBodyStatePool::applyDamping(btScalar timeStep)
+{
+	for (int b=0;b<m_blocks.size();b++)
+	{
+		btRigidBodyStateBlock& block = m_blocks[b];
+		ATTRIBUTE_ALIGNED16(btScalar) linearFactor[BT_BODY_STATE_BLOCK_WIDTH];
+		ATTRIBUTE_ALIGNED16(btScalar) angularFactor[BT_BODY_STATE_BLOCK_WIDTH];
+		for (int lane=0;lane<BT_BODY_STATE_BLOCK_WIDTH;lane++)
+		{
+			linearFactor[lane] = btPow(btScalar(1)-block.m_linearDamping[lane], timeStep);
+			angularFactor[lane] = btPow(btScalar(1)-block.m_angularDamping[lane], timeStep);
+		}
+		btBodyLanes linF = btLanesLoad(linearFactor);
+		btBodyLanes angF = btLanesLoad(angularFactor);
+		for (int j=0;j<3;j++)
+		{
+			btLanesStore(block.m_linearVelocity[j],btLanesMul(btLanesLoad(block.m_linearVelocity[j]),linF));
+			btLanesStore(block.m_angularVelocity[j],btLanesMul(btLanesLoad(block.m_angularVelocity[j]),angF));
+		}
+	}
+
+	//the additional damping depends on the speed of each body, leave it to the body, starting from the undamped velocities
+	for (int i=0;i<m_additionalDampingBodies.size();i++)
+	{
+		int bodyIndex = m_additionalDampingBodies[i];
+		btRigidBody* body = m_bodies[bodyIndex];
+		body->applyDamping(timeStep);
+		int lane;
+		btRigidBodyStateBlock& block = getBlock(bodyIndex,lane);
+		btLanesSetVector3(block.m_linearVelocity,lane,body->m_linearVelocity);
+		btLanesSetVector3(block.m_angularVelocity,lane,body->m_angularVelocity);
+	}
+}
+
+void	btRigidBodyStatePool::integrate(btScalar timeStep)
+{
+	btBodyLanes dt = btLanesSplat(timeStep);
+	for (int b=0;b<m_blocks.size();b++)
+	{
+		btRigidBodyStateBlock& block = m_blocks[b];
+
+		btBodyLanes squareMotion = btLanesSplat(btScalar(0.));
+		for (int j=0;j<3;j++)
+		{
+			btBodyLanes pos = btLanesLoad(block.m_position[j]);
+			btBodyLanes predicted = btLanesAdd(pos,btLanesMul(btLanesLoad(block.m_linearVelocity[j]),dt));
+			btLanesStore(block.m_predictedPosition[j],predicted);
+			btBodyLanes motion = btLanesSub(predicted,pos);
+			squareMotion = btLanesAdd(squareMotion,btLanesMul(motion,motion));
+		}
+		btLanesStore(block.m_squareMotion,squareMotion);
+
+		//exponential map, the sine and cosine are evaluated per body
+		ATTRIBUTE_ALIGNED16(btScalar) angle[BT_BODY_STATE_BLOCK_WIDTH];
+		ATTRIBUTE_ALIGNED16(btScalar) axisScale[BT_BODY_STATE_BLOCK_WIDTH];
+		ATTRIBUTE_ALIGNED16(btScalar) halfAngleCos[BT_BODY_STATE_BLOCK_WIDTH];
+		btLanesStore(angle,btLanesSqrt(btLanesDot3(block.m_angularVelocity,block.m_angularVelocity)));
+		for (int lane=0;lane<BT_BODY_STATE_BLOCK_WIDTH;lane++)
+		{
+			btScalar fAngle = angle[lane];
+			//limit the angular motion
+			if (fAngle*timeStep > ANGULAR_MOTION_THRESHOLD)
+			{
+				fAngle = ANGULAR_MOTION_THRESHOLD / timeStep;
+			}
+			if ( fAngle < btScalar(0.001) )
+			{
+				// use Taylor's expansions of sync function
+				axisScale[lane] = btScalar(0.5)*timeStep-(timeStep*timeStep*timeStep)*(btScalar(0.020833333333))*fAngle*fAngle;
+			} else
+			{
+				axisScale[lane] = btSin(btScalar(0.5)*fAngle*timeStep)/fAngle;
+			}
+			halfAngleCos[lane] = btCos( fAngle*timeStep*btScalar(0.5) );
+		}
+
+		//predicted orientation = dorn * orn0
+		btBodyLanes s = btLanesLoad(axisScale);
+		btBodyLanes dx = btLanesMul(btLanesLoad(block.m_angularVelocity[0]),s);
+		btBodyLanes dy = btLanesMul(btLanesLoad(block.m_angularVelocity[1]),s);
+		btBodyLanes dz = btLanesMul(btLanesLoad(block.m_angularVelocity[2]),s);
+		btBodyLanes dw = btLanesLoad(halfAngleCos);
+		btBodyLanes ox = btLanesLoad(block.m_orientation[0]);
+		btBodyLanes oy = btLanesLoad(block.m_orientation[1]);
+		btBodyLanes oz = btLanesLoad(block.m_orientation[2]);
+		btBodyLanes ow = btLanesLoad(block.m_orientation[3]);
+		btBodyLanes qx = btLanesSub(btLanesAdd(btLanesAdd(btLanesMul(dw,ox),btLanesMul(dx,ow)),btLanesMul(dy,oz)),btLanesMul(dz,oy));
+		btBodyLanes qy = btLanesSub(btLanesAdd(btLanesAdd(btLanesMul(dw,oy),btLanesMul(dy,ow)),btLanesMul(dz,ox)),btLanesMul(dx,oz));
+		btBodyLanes qz = btLanesSub(btLanesAdd(btLanesAdd(btLanesMul(dw,oz),btLanesMul(dz,ow)),btLanesMul(dx,oy)),btLanesMul(dy,ox));
+		btBodyLanes qw = btLanesSub(btLanesSub(btLanesSub(btLanesMul(dw,ow),btLanesMul(dx,ox)),btLanesMul(dy,oy)),btLanesMul(dz,oz));
+
+		//normalize
+		btBodyLanes length2 = btLanesAdd(btLanesAdd(btLanesAdd(btLanesMul(qx,qx),btLanesMul(qy,qy)),btLanesMul(qz,qz)),btLanesMul(qw,qw));
+		btBodyLanes length = btLanesSqrt(length2);
+		btLanesStore(block.m_predictedOrientation[0],btLanesDiv(qx,length));
+		btLanesStore(block.m_predictedOrientation[1],btLanesDiv(qy,length));
+		btLanesStore(block.m_predictedOrientation[2],btLanesDiv(qz,length));
+		btLanesStore(block.m_predictedOrientation[3],btLanesDiv(qw,length));
+	}
+}
+
+void	btRigidBodyStatePool::updateBasis()
+{
+	btBodyLanes one = btLanesSplat(btScalar(1.));
+	btBodyLanes two = btLanesSplat(btScalar(2.));
+	for (int b=0;b<m_blocks.size();b++)
+	{
+		btRigidBodyStateBlock& block = m_blocks[b];
+
+		//same as btMatrix3x3::setRotation
+		btBodyLanes x = btLanesLoad(block.m_predictedOrientation[0]);
+		btBodyLanes y = btLanesLoad(block.m_predictedOrientation[1]);
+		btBodyLanes z = btLanesLoad(block.m_predictedOrientation[2]);
+		btBodyLanes w = btLanesLoad(block.m_predictedOrientation[3]);
+		btBodyLanes d = btLanesAdd(btLanesAdd(btLanesAdd(btLanesMul(x,x),btLanesMul(y,y)),btLanesMul(z,z)),btLanesMul(w,w));
+		btBodyLanes s = btLanesDiv(two,d);
+		btBodyLanes xs = btLanesMul(x,s), ys = btLanesMul(y,s), zs = btLanesMul(z,s);
+		btBodyLanes wx = btLanesMul(w,xs), wy = btLanesMul(w,ys), wz = btLanesMul(w,zs);
+		btBodyLanes xx = btLanesMul(x,xs), xy = btLanesMul(x,ys), xz = btLanesMul(x,zs);
+		btBodyLanes yy = btLanesMul(y,ys), yz = btLanesMul(y,zs), zz = btLanesMul(z,zs);
+
+		btBodyLanes m[9];
+		m[0] = btLanesSub(one,btLanesAdd(yy,zz));
+		m[1] = btLanesSub(xy,wz);
+		m[2] = btLanesAdd(xz,wy);
+		m[3] = btLanesAdd(xy,wz);
+		m[4] = btLanesSub(one,btLanesAdd(xx,zz));
+		m[5] = btLanesSub(yz,wx);
+		m[6] = btLanesSub(xz,wy);
+		m[7] = btLanesAdd(yz,wx);
+		m[8] = btLanesSub(one,btLanesAdd(xx,yy));
+		for (int j=0;j<9;j++)
+			btLanesStore(block.m_basis[j],m[j]);
+
+		//invInertiaWorld = basis * diag(invInertiaLocal) * basis^T, which is symmetric
+		btBodyLanes invI[3];
+		for (int k=0;k<3;k++)
+			invI[k] = btLanesLoad(block.m_invInertiaLocal[k]);
+		for (int r=0;r<3;r++)
+		{
+			btBodyLanes scaledRow[3];
+			for (int k=0;k<3;k++)
+				scaledRow[k] = btLanesMul(m[r*3+k],invI[k]);
+			for (int c=r;c<3;c++)
+			{
+				btBodyLanes sum = btLanesMul(scaledRow[0],m[c*3+0]);
+				sum = btLanesAdd(sum,btLanesMul(scaledRow[1],m[c*3+1]));
+				sum = btLanesAdd(sum,btLanesMul(scaledRow[2],m[c*3+2]));
+				btLanesStore(block.m_invInertiaWorld[r*3+c],sum);
+				btLanesStore(block.m_invInertiaWorld[c*3+r],sum);
+			}
+		}
+	}
+}
+
+btScalar	btRigidBodyStatePool::getSquareMotion(int bodyIndex) const
+{
+	int lane;
+	const btRigidBodyStateBlock& block = getBlock(bodyIndex,lane);
+	return block.m_squareMotion[lane];
+}
+
+void	btRigidBodyStatePool::getPredictedTransform(int bodyIndex, btTransform& predictedTransform) const
+{
+	int lane;
+	const btRigidBodyStateBlock& block = getBlock(bodyIndex,lane);
+	predictedTransform.getOrigin() = btLanesGetVector3(block.m_predictedPosition,lane);
+	predictedTransform.getBasis().setValue(
+		block.m_basis[0][lane],block.m_basis[1][lane],block.m_basis[2][lane],
+		block.m_basis[3][lane],block.m_basis[4][lane],block.m_basis[5][lane],
+		block.m_basis[6][lane],block.m_basis[7][lane],block.m_basis[8][lane]);
+}
+
+void	btRigidBodyStatePool::storeVelocities(int bodyIndex) const
+{
+	int lane;
+	const btRigidBodyStateBlock& block = getBlock(bodyIndex,lane);
+	btRigidBody* body = m_bodies[bodyIndex];
+	body->m_linearVelocity = btLanesGetVector3(block.m_linearVelocity,lane);
+	body->m_angularVelocity = btLanesGetVector3(block.m_angularVelocity,lane);
+}
+
+void	btRigidBodyStatePool::storeIntegratedTransform(int bodyIndex) const
+{
+	int lane;
+	const btRigidBodyStateBlock& block = getBlock(bodyIndex,lane);
+	btRigidBody* body = m_bodies[bodyIndex];
+	btAssert(!body->isKinematicObject());
+
+	getPredictedTransform(bodyIndex,body->m_worldTransform);
+	body->m_interpolationWorldTransform = body->m_worldTransform;
+	body->m_interpolationLinearVelocity = body->m_linearVelocity;
+	body->m_interpolationAngularVelocity = body->m_angularVelocity;
+	body->m_invInertiaTensorWorld.setValue(
+		block.m_invInertiaWorld[0][lane],block.m_invInertiaWorld[1][lane],block.m_invInertiaWorld[2][lane],
+		block.m_invInertiaWorld[3][lane],block.m_invInertiaWorld[4][lane],block.m_invInertiaWorld[5][lane],
+		block.m_invInertiaWorld[6][lane],block.m_invInertiaWorld[7][lane],block.m_invInertiaWorld[8][lane]);
+}
@@ -0,0 +1,112 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_RIGID_BODY_STATE_POOL_H
+#define BT_RIGID_BODY_STATE_POOL_H
+
+#include "LinearMath/btScalar.h"
+#include "LinearMath/btTransform.h"
+#include "LinearMath/btAlignedObjectArray.h"
+
+class btRigidBody;
+
+#define BT_BODY_STATE_BLOCK_WIDTH 4
+
+///btRigidBodyStateBlock holds the integration state of BT_BODY_STATE_BLOCK_WIDTH rigid bodies in SoA layout
+ATTRIBUTE_ALIGNED16(struct) btRigidBodyStateBlock
+{
+	btScalar	m_position[3][BT_BODY_STATE_BLOCK_WIDTH];
+	btScalar	m_orientation[4][BT_BODY_STATE_BLOCK_WIDTH];
+	btScalar	m_linearVelocity[3][BT_BODY_STATE_BLOCK_WIDTH];
+	btScalar	m_angularVelocity[3][BT_BODY_STATE_BLOCK_WIDTH];
+	btScalar	m_invInertiaLocal[3][BT_BODY_STATE_BLOCK_WIDTH];
+	btScalar	m_linearDamping[BT_BODY_STATE_BLOCK_WIDTH];
+	btScalar	m_angularDamping[BT_BODY_STATE_BLOCK_WIDTH];
+
+	//results of integrate and updateBasis
+	btScalar	m_predictedPosition[3][BT_BODY_STATE_BLOCK_WIDTH];
+	btScalar	m_predictedOrientation[4][BT_BODY_STATE_BLOCK_WIDTH];
+	btScalar	m_squareMotion[BT_BODY_STATE_BLOCK_WIDTH];
+	btScalar	m_basis[9][BT_BODY_STATE_BLOCK_WIDTH];
+	btScalar	m_invInertiaWorld[9][BT_BODY_STATE_BLOCK_WIDTH];
+};
+
+///btRigidBodyStatePool is a structure-of-arrays copy of the rigid body state that the integration loops of btDiscreteDynamicsWorld use:
+///transform, velocities, damping and local inverse inertia. The loops over it (damping, exponential map integration,
+///quaternion to basis and world inverse inertia) process BT_BODY_STATE_BLOCK_WIDTH bodies at a time using SSE or NEON.
+///The btRigidBody objects stay the owners of their state: a pass loads the bodies into the pool, runs the loops and stores the results back.
+///Bodies that use additional damping are damped one by one by btRigidBody::applyDamping.
+///The results match the per-body code up to rounding.
+///
+///The bodies are not moved into the pool for good, because the broadphase proxies, the contact manifolds, the constraints,
+///the solver bodies and the motion states all keep references to btRigidBody::m_worldTransform and the velocities.
+///The cost of that decision is that the state is copied in and out, and loaded twice per step: the solver, and split impulse
+///in particular, writes the velocities and transforms between predictUnconstraintMotion and integrateTransforms.
+///That copy costs more than the SIMD loops save. With AppHeadlessBenchmark --body-state-pool (SSE, release build, 300 steps)
+///integrateTransforms goes from 0.30 to 0.42 ms and predictUnconstraintMotion from 0.27 to 0.37 ms per frame in the 3000 fall scene,
+///and the two phases are 12 to 18% slower in the 136 ragdolls scene. This is why btDiscreteDynamicsWorld doesn't use the pool by default.
+class btRigidBodyStatePool
+{
+	btAlignedObjectArray<btRigidBodyStateBlock>	m_blocks;
+	btAlignedObjectArray<btRigidBody*>			m_bodies;
+	btAlignedObjectArray<int>					m_additionalDampingBodies;
+
+	btRigidBodyStateBlock&	getBlock(int bodyIndex, int& lane)
+	{
+		lane = bodyIndex % BT_BODY_STATE_BLOCK_WIDTH;
+		return m_blocks[bodyIndex / BT_BODY_STATE_BLOCK_WIDTH];
+	}
+	const btRigidBodyStateBlock&	getBlock(int bodyIndex, int& lane) const
+	{
+		lane = bodyIndex % BT_BODY_STATE_BLOCK_WIDTH;
+		return m_blocks[bodyIndex / BT_BODY_STATE_BLOCK_WIDTH];
+	}
+
+public:
+
+	///copy the state of the bodies into the pool, the padding lanes of the last block get a valid identity state
+	void	loadBodies(btRigidBody* const* bodies, int numBodies);
+
+	int		getNumBodies() const
+	{
+		return m_bodies.size();
+	}
+	btRigidBody*	getBody(int bodyIndex) const
+	{
+		return m_bodies[bodyIndex];
+	}
+
+	///same as btRigidBody::applyDamping on the velocities in the pool
+	void	applyDamping(btScalar timeStep);
+
+	///same as btTransformUtil::integrateTransform, the result is the predicted transform and the squared linear motion of every body
+	void	integrate(btScalar timeStep);
+
+	///compute the basis and the world inverse inertia tensor of the predicted orientations
+	void	updateBasis();
+
+	btScalar	getSquareMotion(int bodyIndex) const;
+
+	///the predicted transform, valid after integrate and updateBasis
+	void	getPredictedTransform(int bodyIndex, btTransform& predictedTransform) const;
+
+	///store the velocities in the pool back into the body
+	void	storeVelocities(int bodyIndex) const;
+
+	///same as btRigidBody::proceedToTransform with the predicted transform, using the inverse inertia tensor computed by updateBasis
+	void	storeIntegratedTransform(int bodyIndex) const;
+};
+
+#endif //BT_RIGID_BODY_STATE_POOL_H
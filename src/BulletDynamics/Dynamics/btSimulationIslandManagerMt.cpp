@@ -0,0 +1,293 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "LinearMath/btScalar.h"
+#include "LinearMath/btThreads.h"
+#include "btSimulationIslandManagerMt.h"
+#include "BulletCollision/BroadphaseCollision/btDispatcher.h"
+#include "BulletCollision/NarrowPhaseCollision/btPersistentManifold.h"
+#include "BulletCollision/CollisionDispatch/btCollisionObject.h"
+#include "BulletCollision/CollisionDispatch/btCollisionWorld.h"
+#include "BulletDynamics/ConstraintSolver/btTypedConstraint.h"
+
+#include "LinearMath/btQuickprof.h"
+
+
+SIMD_FORCE_INLINE	int	btGetConstraintIslandId(const btTypedConstraint* lhs)
+{
+	const btCollisionObject& rcolObj0 = lhs->getRigidBodyA();
+	const btCollisionObject& rcolObj1 = lhs->getRigidBodyB();
+	return rcolObj0.getIslandTag()>=0?rcolObj0.getIslandTag():rcolObj1.getIslandTag();
+}
+
+SIMD_FORCE_INLINE	int	btGetManifoldIslandId(const btPersistentManifold* lhs)
+{
+	const btCollisionObject* rcolObj0 = static_cast<const btCollisionObject*>(lhs->getBody0());
+	const btCollisionObject* rcolObj1 = static_cast<const btCollisionObject*>(lhs->getBody1());
+	return rcolObj0->getIslandTag()>=0?rcolObj0->getIslandTag():rcolObj1->getIslandTag();
+}
+
+SIMD_FORCE_INLINE	int	btCalcIslandBatchCost(const btSimulationIslandManagerMt::Island* island)
+{
+	return island->manifoldArray.size()+island->constraintArray.size();
+}
+
+///sorts islands from the most to the least expensive, ties are broken on the island id to keep the order deterministic
+class btIslandBatchCostSortPredicate
+{
+public:
+	bool operator() ( const btSimulationIslandManagerMt::Island* lhs, const btSimulationIslandManagerMt::Island* rhs ) const
+	{
+		int lCost = btCalcIslandBatchCost(lhs);
+		int rCost = btCalcIslandBatchCost(rhs);
+		if (lCost != rCost)
+			return lCost > rCost;
+		return lhs->id < rhs->id;
+	}
+};
+
+
+void btSimulationIslandManagerMt::Island::append(const Island& other)
+{
+	int i;
+	for (i=0;i<other.bodyArray.size();i++)
+		bodyArray.push_back(other.bodyArray[i]);
+	for (i=0;i<other.manifoldArray.size();i++)
+		manifoldArray.push_back(other.manifoldArray[i]);
+	for (i=0;i<other.constraintArray.size();i++)
+		constraintArray.push_back(other.constraintArray[i]);
+}
+
+
+btSimulationIslandManagerMt::btSimulationIslandManagerMt()
+:m_minimumSolverBatchSize(128)
+{
+}
+
+btSimulationIslandManagerMt::~btSimulationIslandManagerMt()
+{
+	for (int i=0;i<m_allocatedIslands.size();i++)
+	{
+		m_allocatedIslands[i]->~Island();
+		btAlignedFree(m_allocatedIslands[i]);
+	}
+}
+
+
+btSimulationIslandManagerMt::Island* btSimulationIslandManagerMt::allocateIsland(int id, int numBodies)
+{
+	Island* island = 0;
+	if (m_freeIslands.size())
+	{
+		island = m_freeIslands[m_freeIslands.size()-1];
+		m_freeIslands.pop_back();
+	} else
+	{
+		void* mem = btAlignedAlloc(sizeof(Island),16);
+		island = new (mem) Island();
+		m_allocatedIslands.push_back(island);
+	}
+	island->id = id;
+	island->bodyArray.reserve(numBodies);
+	m_activeIslands.push_back(island);
+	m_lookupIslandFromId[id] = island;
+	return island;
+}
+
+void btSimulationIslandManagerMt::initIslandPools()
+{
+	//every island goes back to the free list, the arrays keep their capacity so the next step doesn't allocate
+	m_activeIslands.resize(0);
+	m_freeIslands.resize(0);
+	int i;
+	for (i=0;i<m_allocatedIslands.size();i++)
+	{
+		Island* island = m_allocatedIslands[i];
+		island->bodyArray.resize(0);
+		island->manifoldArray.resize(0);
+		island->constraintArray.resize(0);
+		island->id = -1;
+		m_freeIslands.push_back(island);
+	}
+
+	int numElem = getUnionFind().getNumElements();
+	m_lookupIslandFromId.resize(numElem);
+	for (i=0;i<numElem;i++)
+	{
+		m_lookupIslandFromId[i] = 0;
+	}
+}
+
+
+void btSimulationIslandManagerMt::addBodiesToIslands(btCollisionWorld* collisionWorld)
+{
+	btCollisionObjectArray& collisionObjects = collisionWorld->getCollisionObjectArray();
+	int endIslandIndex=1;
+	int startIslandIndex;
+	int numElem = getUnionFind().getNumElements();
+
+	//the union find elements have been sorted on island id by buildIslands, so each island is a contiguous range
+	for ( startIslandIndex=0;startIslandIndex<numElem;startIslandIndex = endIslandIndex)
+	{
+		int islandId = getUnionFind().getElement(startIslandIndex).m_id;
+		bool islandSleeping = true;
+		for (endIslandIndex = startIslandIndex;(endIslandIndex<numElem) && (getUnionFind().getElement(endIslandIndex).m_id == islandId);endIslandIndex++)
+		{
+			int i = getUnionFind().getElement(endIslandIndex).m_sz;
+			btCollisionObject* colObj0 = collisionObjects[i];
+			if (colObj0->isActive())
+				islandSleeping = false;
+		}
+
+		//sleeping islands are not solved, so they don't get an island
+		if (!islandSleeping)
+		{
+			Island* island = allocateIsland(islandId,endIslandIndex-startIslandIndex);
+			for (int idx=startIslandIndex;idx<endIslandIndex;idx++)
+			{
+				int i = getUnionFind().getElement(idx).m_sz;
+				island->bodyArray.push_back(collisionObjects[i]);
+			}
+		}
+	}
+}
+
+void btSimulationIslandManagerMt::addManifoldsToIslands(btDispatcher* dispatcher)
+{
+	(void)dispatcher;
+	//m_islandmanifold is in dispatcher order, which keeps the manifold order within an island deterministic
+	for (int i=0;i<m_islandmanifold.size();i++)
+	{
+		btPersistentManifold* manifold = m_islandmanifold[i];
+		int islandId = btGetManifoldIslandId(manifold);
+		if (islandId>=0 && islandId<m_lookupIslandFromId.size())
+		{
+			Island* island = m_lookupIslandFromId[islandId];
+			if (island)
+			{
+				island->manifoldArray.push_back(manifold);
+			}
+		}
+	}
+}
+
+void btSimulationIslandManagerMt::addConstraintsToIslands(btAlignedObjectArray<btTypedConstraint*>& constraints)
+{
+	for (int i=0;i<constraints.size();i++)
+	{
+		btTypedConstraint* constraint = constraints[i];
+		int islandId = btGetConstraintIslandId(constraint);
+		if (islandId>=0 && islandId<m_lookupIslandFromId.size())
+		{
+			Island* island = m_lookupIslandFromId[islandId];
+			if (island)
+			{
+				island->constraintArray.push_back(constraint);
+			}
+		}
+	}
+}
+
+void btSimulationIslandManagerMt::mergeIslands()
+{
+	int numIslands = m_activeIslands.size();
+	m_activeIslands.quickSort(btIslandBatchCostSortPredicate());
+
+	//find the first island that is too small to be solved on its own
+	int destIslandIndex = numIslands;
+	int i;
+	for (i=0;i<numIslands;i++)
+	{
+		if (btCalcIslandBatchCost(m_activeIslands[i]) < m_minimumSolverBatchSize)
+		{
+			destIslandIndex = i;
+			break;
+		}
+	}
+
+	//grow it with the smallest islands from the end of the array, until it is big enough, then move on to the next one
+	int lastIndex = numIslands-1;
+	while (destIslandIndex < lastIndex)
+	{
+		Island* island = m_activeIslands[destIslandIndex];
+		int batchCost = btCalcIslandBatchCost(island);
+		while (batchCost < m_minimumSolverBatchSize && destIslandIndex < lastIndex)
+		{
+			Island* src = m_activeIslands[lastIndex];
+			island->append(*src);
+			batchCost += btCalcIslandBatchCost(src);
+			lastIndex--;
+		}
+		destIslandIndex++;
+	}
+	//the merged islands go back to the free list in the next initIslandPools
+	m_activeIslands.resize(lastIndex+1);
+}
+
+
+struct btUpdateIslandDispatcher : public btIParallelForBody
+{
+	btAlignedObjectArray<btSimulationIslandManagerMt::Island*>*	m_islandsPtr;
+	btSimulationIslandManagerMt::IslandCallback*	m_callback;
+
+	void	forLoop(int iBegin, int iEnd) const
+	{
+		for (int i=iBegin;i<iEnd;i++)
+		{
+			btSimulationIslandManagerMt::Island* island = (*m_islandsPtr)[i];
+			btCollisionObject** bodies = island->bodyArray.size() ? &island->bodyArray[0] : 0;
+			btPersistentManifold** manifolds = island->manifoldArray.size() ? &island->manifoldArray[0] : 0;
+			btTypedConstraint** constraints = island->constraintArray.size() ? &island->constraintArray[0] : 0;
+			m_callback->processIsland(bodies,island->bodyArray.size(),manifolds,island->manifoldArray.size(),constraints,island->constraintArray.size(),island->id);
+		}
+	}
+};
+
+void btSimulationIslandManagerMt::processIslands(IslandCallback* callback)
+{
+	btUpdateIslandDispatcher dispatcher;
+	dispatcher.m_islandsPtr = &m_activeIslands;
+	dispatcher.m_callback = callback;
+	//one island per task, the scheduler balances the load by stealing
+	btParallelFor(0,m_activeIslands.size(),1,dispatcher);
+}
+
+
+void btSimulationIslandManagerMt::buildAndProcessIslands(btDispatcher* dispatcher,btCollisionWorld* collisionWorld,btAlignedObjectArray<btTypedConstraint*>& constraints,IslandCallback* callback)
+{
+	btCollisionObjectArray& collisionObjects = collisionWorld->getCollisionObjectArray();
+
+	buildIslands(dispatcher,collisionWorld);
+
+	BT_PROFILE("processIslands");
+
+	if(!m_splitIslands)
+	{
+		btPersistentManifold** manifolds = dispatcher->getInternalManifoldPointer();
+		int maxNumManifolds = dispatcher->getNumManifolds();
+		btTypedConstraint** constraintsPtr = constraints.size() ? &constraints[0] : 0;
+		callback->processIsland(&collisionObjects[0],collisionObjects.size(),manifolds,maxNumManifolds,constraintsPtr,constraints.size(),-1);
+	}
+	else
+	{
+		initIslandPools();
+		addBodiesToIslands(collisionWorld);
+		addManifoldsToIslands(dispatcher);
+		addConstraintsToIslands(constraints);
+		mergeIslands();
+		processIslands(callback);
+	}
+}
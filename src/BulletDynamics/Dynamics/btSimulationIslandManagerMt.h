@@ -0,0 +1,82 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_SIMULATION_ISLAND_MANAGER_MT_H
+#define BT_SIMULATION_ISLAND_MANAGER_MT_H
+
+#include "BulletCollision/CollisionDispatch/btSimulationIslandManager.h"
+
+class btTypedConstraint;
+
+
+///btSimulationIslandManagerMt gathers the bodies, contact manifolds and constraints of each active island,
+///and hands the islands to the callback in parallel, using btParallelFor.
+///Islands are processed largest first, and small islands are merged into batches of at least
+///m_minimumSolverBatchSize manifolds+constraints so a task is never too small to be worth scheduling.
+///The content and order of every island only depends on the simulation state, so results do not depend on the number of threads.
+class btSimulationIslandManagerMt : public btSimulationIslandManager
+{
+public:
+	struct Island
+	{
+		btAlignedObjectArray<btCollisionObject*>	bodyArray;
+		btAlignedObjectArray<btPersistentManifold*>	manifoldArray;
+		btAlignedObjectArray<btTypedConstraint*>	constraintArray;
+		int		id;			///< island id of the first island in a batch
+
+		void	append(const Island& other);
+	};
+
+	struct	IslandCallback
+	{
+		virtual ~IslandCallback() {};
+
+		///processIsland can be called from several threads at once, but never twice for the same body
+		virtual	void	processIsland(btCollisionObject** bodies,int numBodies,btPersistentManifold** manifolds,int numManifolds,btTypedConstraint** constraints,int numConstraints,int islandId) = 0;
+	};
+
+protected:
+	btAlignedObjectArray<Island*>	m_allocatedIslands;	///< owner of all islands
+	btAlignedObjectArray<Island*>	m_activeIslands;	///< islands to be solved this step
+	btAlignedObjectArray<Island*>	m_freeIslands;		///< recycled islands
+	btAlignedObjectArray<Island*>	m_lookupIslandFromId;	///< indexed by island id
+	int	m_minimumSolverBatchSize;
+
+	Island*	allocateIsland(int id, int numBodies);
+	void	initIslandPools();
+
+	virtual	void	addBodiesToIslands(btCollisionWorld* collisionWorld);
+	virtual	void	addManifoldsToIslands(btDispatcher* dispatcher);
+	virtual	void	addConstraintsToIslands(btAlignedObjectArray<btTypedConstraint*>& constraints);
+	virtual	void	mergeIslands();
+	virtual	void	processIslands(IslandCallback* callback);
+
+public:
+	btSimulationIslandManagerMt();
+	virtual ~btSimulationIslandManagerMt();
+
+	void	buildAndProcessIslands(btDispatcher* dispatcher,btCollisionWorld* collisionWorld,btAlignedObjectArray<btTypedConstraint*>& constraints,IslandCallback* callback);
+
+	int		getMinimumSolverBatchSize() const
+	{
+		return m_minimumSolverBatchSize;
+	}
+	void	setMinimumSolverBatchSize(int sz)
+	{
+		m_minimumSolverBatchSize = sz;
+	}
+};
+
+#endif //BT_SIMULATION_ISLAND_MANAGER_MT_H
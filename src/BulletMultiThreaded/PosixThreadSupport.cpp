@@ -21,6 +21,7 @@ subject to the following restrictions:
 
 #include "SpuCollisionTaskProcess.h"
 #include "SpuNarrowPhaseCollisionTask/SpuGatheringCollisionTask.h"
+#include "LinearMath/btThreads.h"
 
 #define checkPThreadFunction(returnValue) \
     if(0 != returnValue) { \
@@ -102,9 +103,10 @@ static void *threadFunction(void *argument)
 		{
 			btAssert(status->m_status);
 			status->m_userThreadFunc(userPtr,status->m_lsMemory);
-			status->m_status = 2;
-			checkPThreadFunction(sem_post(mainSemaphore));
 	                status->threadUsed++;
+			//waitForResponse looks for a finished thread while others are still running
+			btAtomicStore((volatile int*)&status->m_status,2);
+			checkPThreadFunction(sem_post(mainSemaphore));
 		} else {
 			//exit Thread
 			status->m_status = 3;
@@ -174,7 +176,7 @@ void PosixThreadSupport::waitForResponse(unsigned int *puiArgument0, unsigned in
         size_t last = -1;
         
         for(size_t t=0; t < size_t(m_activeSpuStatus.size()); ++t) {
-            if(2 == m_activeSpuStatus[t].m_status) {
+            if(2 == btAtomicLoad((volatile int*)&m_activeSpuStatus[t].m_status)) {
                 last = t;
                 break;
             }
@@ -238,7 +240,6 @@ void PosixThreadSupport::stopSPU()
 	for(size_t t=0; t < size_t(m_activeSpuStatus.size()); ++t) 
 	{
             btSpuStatus&	spuStatus = m_activeSpuStatus[t];
-            printf("%s: Thread %i used: %ld\n", __FUNCTION__, int(t), spuStatus.threadUsed);
 
 	spuStatus.m_userPtr = 0;       
  	checkPThreadFunction(sem_post(spuStatus.startSemaphore));
@@ -248,11 +249,18 @@ void PosixThreadSupport::stopSPU()
             destroySem(spuStatus.startSemaphore);
             printf("semaphore destroyed\n");
 		checkPThreadFunction(pthread_join(spuStatus.thread,0));
+		//the thread stopped, so threadUsed can be read safely
+		printf("%s: Thread %i used: %ld\n", __FUNCTION__, int(t), spuStatus.threadUsed);
 
         }
-	printf("destroy main semaphore\n");
-        destroySem(mainSemaphore);
-	printf("main semaphore destroyed\n");
+	//the destructor calls stopSPU again, after MiniCLTaskScheduler did
+	if (mainSemaphore)
+	{
+		printf("destroy main semaphore\n");
+		destroySem(mainSemaphore);
+		mainSemaphore = 0;
+		printf("main semaphore destroyed\n");
+	}
 	m_activeSpuStatus.clear();
 }
 
@@ -48,6 +48,7 @@ subject to the following restrictions:
 #include "BulletCollision/CollisionDispatch/btBoxBoxDetector.h"
 #include "BulletCollision/NarrowPhaseCollision/btGjkEpaPenetrationDepthSolver.h"
 #include "BulletCollision/CollisionShapes/btTriangleShape.h"
+#include "LinearMath/btThreads.h"
 
 #ifdef __SPU__
 ///Software caching from the IBM Cell SDK, it reduces 25% SPU time for our test cases
@@ -106,8 +107,6 @@ int g_CacheHits=0;
 
 #endif // USE_SOFTWARE_CACHE
 
-bool gUseEpa = false;
-
 #ifdef USE_SN_TUNER
 #include <LibSN_SPU.h>
 #endif //USE_SN_TUNER
@@ -155,6 +154,9 @@ struct	CollisionTask_LocalStoreMemory
 
 	bool	needsDmaPutContactManifoldAlgo;
 
+	///the tasks of a btThreadSupportInterface run concurrently, so the settings of the task live here rather than in globals
+	bool	m_useEpa;
+
 	btCollisionObject* getColObj0()
 	{
 		return m_lsColObj0Ptr;
@@ -674,7 +676,7 @@ void	ProcessSpuConvexConvexCollision(SpuCollisionPairInput* wuInput, CollisionTa
 		
 		//SpuMinkowskiPenetrationDepthSolver	minkowskiPenetrationSolver;
 #ifdef ENABLE_EPA
-		if (gUseEpa)
+		if (lsMemPtr->m_useEpa)
 		{
 			penetrationSolver = &epaPenetrationSolver2;
 		} else
@@ -1064,7 +1066,7 @@ void	processCollisionTask(void* userPtr, void* lsMemPtr)
 	CollisionTask_LocalStoreMemory*	colMemPtr = (CollisionTask_LocalStoreMemory*)lsMemPtr;
 	CollisionTask_LocalStoreMemory& lsMem = *(colMemPtr);
 
-	gUseEpa = taskDesc.m_useEpa;
+	lsMem.m_useEpa = taskDesc.m_useEpa;
 
 	//	spu_printf("taskDescPtr=%llx\n",taskDescPtr);
 
@@ -1360,10 +1362,10 @@ void	processCollisionTask(void* userPtr, void* lsMemPtr)
 											btScalar sepDist2 = distance+spuManifold->getContactBreakingThreshold();
 											lsMem.getlocalCollisionAlgorithm()->m_sepDistance.initSeparatingDistance(normalInB,sepDist2,collisionPairInput.m_worldTransform0,collisionPairInput.m_worldTransform1);
 #endif //USE_SEPDISTANCE_UTIL
-											gProcessedCol++;
+											btAtomicFetchAdd(&gProcessedCol,1);
 										} else
 										{
-											gSkippedCol++;
+											btAtomicFetchAdd(&gSkippedCol,1);
 										}
 
 										spuContacts.flush();
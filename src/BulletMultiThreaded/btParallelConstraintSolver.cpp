@@ -23,6 +23,7 @@ subject to the following restrictions:
 #include "BulletMultiThreaded/vectormath2bullet.h"
 
 #include "LinearMath/btQuickprof.h"
+#include "LinearMath/btThreads.h"
 #include "BulletMultiThreaded/btThreadSupportInterface.h"
 #ifdef PFX_USE_FREE_VECTORMATH
 #include "vecmath/vmInclude.h"
@@ -1141,7 +1142,20 @@ btConstraintSolverIO* createSolverIO(int numThreads)
 	return new btConstraintSolverIO[numThreads];
 }
 
+btParallelConstraintSolver::btParallelConstraintSolver()
+:m_memoryCache(0),
+m_solverThreadSupport(0),
+m_solverIO(0),
+m_barrier(0),
+m_criticalSection(0),
+m_minGroupsPerPhase(16),
+m_groupGrainSize(8)
+{
+}
+
 btParallelConstraintSolver::btParallelConstraintSolver(btThreadSupportInterface* solverThreadSupport)
+:m_minGroupsPerPhase(16),
+m_groupGrainSize(8)
 {
 	
 	m_solverThreadSupport = solverThreadSupport;//createSolverThreadSupport(maxNumThreads);
@@ -1155,16 +1169,311 @@ btParallelConstraintSolver::btParallelConstraintSolver(btThreadSupportInterface*
 	
 btParallelConstraintSolver::~btParallelConstraintSolver()
 {
-	delete m_memoryCache;
-	delete m_solverIO;
-	m_solverThreadSupport->deleteBarrier(m_barrier);
-	m_solverThreadSupport->deleteCriticalSection(m_criticalSection);
+	if (m_solverThreadSupport)
+	{
+		delete m_memoryCache;
+		delete[] m_solverIO;
+		m_solverThreadSupport->deleteBarrier(m_barrier);
+		m_solverThreadSupport->deleteCriticalSection(m_criticalSection);
+	}
+}
+
+
+void	btParallelConstraintSolver::setupSolverPhases(const btConstraintArray& rows, btSolverPhases& phases)
+{
+	//consecutive rows between the same bodies
+	m_tmpGroups.resize(0);
+	for (int i=0;i<rows.size();i++)
+	{
+		const btSolverConstraint& row = rows[i];
+		if (i && row.m_solverBodyIdA==rows[i-1].m_solverBodyIdA && row.m_solverBodyIdB==rows[i-1].m_solverBodyIdB)
+		{
+			m_tmpGroups[m_tmpGroups.size()-1].m_numRows++;
+			continue;
+		}
+		btSolverRowGroup& group = m_tmpGroups.expandNonInitializing();
+		group.m_firstRow = i;
+		group.m_numRows = 1;
+		group.m_dynamicBodyIdA = isSharedSolverBody(row.m_solverBodyIdA) ? -1 : row.m_solverBodyIdA;
+		group.m_dynamicBodyIdB = isSharedSolverBody(row.m_solverBodyIdB) ? -1 : row.m_solverBodyIdB;
+	}
+
+	//the same groups as in the previous solveGroup, e.g. of joints or resting contacts, give the same phases
+	bool sameGroups = m_tmpGroups.size()==phases.m_rowGroups.size() && m_minGroupsPerPhase==phases.m_minGroupsPerPhase;
+	for (int i=0;i<m_tmpGroups.size() && sameGroups;i++)
+	{
+		const btSolverRowGroup& group = m_tmpGroups[i];
+		const btSolverRowGroup& previous = phases.m_rowGroups[i];
+		sameGroups = group.m_firstRow==previous.m_firstRow && group.m_numRows==previous.m_numRows &&
+			group.m_dynamicBodyIdA==previous.m_dynamicBodyIdA && group.m_dynamicBodyIdB==previous.m_dynamicBodyIdB;
+	}
+	if (sameGroups)
+		return;
+	phases.m_rowGroups.copyFromArray(m_tmpGroups);
+	phases.m_minGroupsPerPhase = m_minGroupsPerPhase;
+
+	phases.m_groups.resize(0);
+	phases.m_phaseStarts.resize(0);
+	phases.m_numParallelPhases = 0;
+	if (!m_tmpGroups.size())
+		return;
+
+	//greedy colouring: each pass takes the pending groups that don't share a dynamic body with a group taken before in that pass
+	m_bodyPhases.resize(0);
+	m_bodyPhases.resize(m_tmpSolverBodyPool.size(),-1);
+	m_pendingGroups.resize(m_tmpGroups.size());
+	for (int i=0;i<m_tmpGroups.size();i++)
+		m_pendingGroups[i] = i;
+
+	for (int phase=0;m_pendingGroups.size();phase++)
+	{
+		int phaseStart = phases.m_groups.size();
+		m_deferredGroups.resize(0);
+		for (int i=0;i<m_pendingGroups.size();i++)
+		{
+			const btSolverRowGroup& group = m_tmpGroups[m_pendingGroups[i]];
+			int idA = group.m_dynamicBodyIdA;
+			int idB = group.m_dynamicBodyIdB;
+			if ((idA>=0 && m_bodyPhases[idA]==phase) || (idB>=0 && m_bodyPhases[idB]==phase))
+			{
+				m_deferredGroups.push_back(m_pendingGroups[i]);
+				continue;
+			}
+			if (idA>=0)
+				m_bodyPhases[idA] = phase;
+			if (idB>=0)
+				m_bodyPhases[idB] = phase;
+			phases.m_groups.push_back(group);
+		}
+
+		if (phases.m_groups.size()-phaseStart < m_minGroupsPerPhase && m_deferredGroups.size())
+		{
+			//too small to be worth a parallel phase, the rest is solved in order
+			phases.m_groups.resize(phaseStart);
+			for (int i=0;i<m_pendingGroups.size();i++)
+				phases.m_groups.push_back(m_tmpGroups[m_pendingGroups[i]]);
+			phases.m_phaseStarts.push_back(phaseStart);
+			break;
+		}
+		phases.m_phaseStarts.push_back(phaseStart);
+		phases.m_numParallelPhases++;
+		m_pendingGroups.copyFromArray(m_deferredGroups);
+	}
+	phases.m_phaseStarts.push_back(phases.m_groups.size());
+}
+
+
+struct btSolverPhaseLoop : public btIParallelForBody
+{
+	btParallelConstraintSolver*	m_solver;
+	const btParallelConstraintSolver::btSolverRowGroup*	m_groups;
+	btParallelConstraintSolver::btSolverStage	m_stage;
+	int		m_iteration;
+	const btContactSolverInfo*	m_infoGlobal;
+
+	void	forLoop(int iBegin, int iEnd) const
+	{
+		m_solver->solveRowGroups(m_groups,iBegin,iEnd,m_stage,m_iteration,*m_infoGlobal,true);
+	}
+};
+
+void	btParallelConstraintSolver::solvePhases(const btSolverPhases& phases, btSolverStage stage, int iteration, const btContactSolverInfo& infoGlobal)
+{
+	btSolverPhaseLoop loop;
+	loop.m_solver = this;
+	loop.m_groups = phases.m_groups.size() ? &phases.m_groups[0] : 0;
+	loop.m_stage = stage;
+	loop.m_iteration = iteration;
+	loop.m_infoGlobal = &infoGlobal;
+	for (int phase=0;phase<phases.getNumPhases();phase++)
+	{
+		int iBegin = phases.m_phaseStarts[phase];
+		int iEnd = phases.m_phaseStarts[phase+1];
+		if (phase<phases.m_numParallelPhases)
+			btParallelFor(iBegin,iEnd,m_groupGrainSize,loop);
+		else
+			solveRowGroups(loop.m_groups,iBegin,iEnd,stage,iteration,infoGlobal,false);
+	}
+}
+
+void	btParallelConstraintSolver::solveRowGroups(const btSolverRowGroup* groups, int iBegin, int iEnd, btSolverStage stage, int iteration, const btContactSolverInfo& infoGlobal, bool concurrent)
+{
+	bool useSimd = (infoGlobal.m_solverMode & SOLVER_SIMD)!=0;
+	btSolverBody sharedBodyA;
+	btSolverBody sharedBodyB;
+	for (int g=iBegin;g<iEnd;g++)
+	{
+		const btSolverRowGroup& group = groups[g];
+		btConstraintArray& rows = stage==SOLVER_STAGE_JOINTS ? m_tmpSolverNonContactConstraintPool :
+			stage==SOLVER_STAGE_FRICTION ? m_tmpSolverContactFrictionConstraintPool :
+			stage==SOLVER_STAGE_ROLLING_FRICTION ? m_tmpSolverContactRollingFrictionConstraintPool : m_tmpSolverContactConstraintPool;
+		const btSolverConstraint& firstRow = rows[group.m_firstRow];
+		btSolverBody* bodyA = &m_tmpSolverBodyPool[firstRow.m_solverBodyIdA];
+		btSolverBody* bodyB = &m_tmpSolverBodyPool[firstRow.m_solverBodyIdB];
+		//the rows write to static and kinematic bodies too, without changing them. Other threads may use the same body, so use a copy.
+		if (concurrent && group.m_dynamicBodyIdA<0)
+		{
+			sharedBodyA = *bodyA;
+			bodyA = &sharedBodyA;
+		}
+		if (concurrent && group.m_dynamicBodyIdB<0)
+		{
+			sharedBodyB = *bodyB;
+			bodyB = &sharedBodyB;
+		}
+
+		for (int i=group.m_firstRow;i<group.m_firstRow+group.m_numRows;i++)
+		{
+			btSolverConstraint& row = rows[i];
+			switch (stage)
+			{
+			case SOLVER_STAGE_JOINTS:
+				if (iteration < row.m_overrideNumSolverIterations)
+				{
+					if (useSimd)
+						resolveSingleConstraintRowGenericSIMD(*bodyA,*bodyB,row);
+					else
+						resolveSingleConstraintRowGeneric(*bodyA,*bodyB,row);
+				}
+				break;
+			case SOLVER_STAGE_CONTACTS:
+				if (useSimd)
+					resolveSingleConstraintRowLowerLimitSIMD(*bodyA,*bodyB,row);
+				else
+					resolveSingleConstraintRowLowerLimit(*bodyA,*bodyB,row);
+				break;
+			case SOLVER_STAGE_INTERLEAVED_CONTACTS:
+				{
+					resolveSingleConstraintRowLowerLimitSIMD(*bodyA,*bodyB,row);
+					btScalar totalImpulse = row.m_appliedImpulse;
+					int multiplier = (infoGlobal.m_solverMode & SOLVER_USE_2_FRICTION_DIRECTIONS)? 2 : 1;
+					for (int f=0;f<multiplier;f++)
+					{
+						btSolverConstraint& frictionRow = m_tmpSolverContactFrictionConstraintPool[m_orderFrictionConstraintPool[i*multiplier+f]];
+						if (totalImpulse>btScalar(0))
+						{
+							frictionRow.m_lowerLimit = -(frictionRow.m_friction*totalImpulse);
+							frictionRow.m_upperLimit = frictionRow.m_friction*totalImpulse;
+							resolveSingleConstraintRowGenericSIMD(*bodyA,*bodyB,frictionRow);
+						}
+					}
+				}
+				break;
+			case SOLVER_STAGE_FRICTION:
+				{
+					btScalar totalImpulse = m_tmpSolverContactConstraintPool[row.m_frictionIndex].m_appliedImpulse;
+					if (totalImpulse>btScalar(0))
+					{
+						row.m_lowerLimit = -(row.m_friction*totalImpulse);
+						row.m_upperLimit = row.m_friction*totalImpulse;
+						if (useSimd)
+							resolveSingleConstraintRowGenericSIMD(*bodyA,*bodyB,row);
+						else
+							resolveSingleConstraintRowGeneric(*bodyA,*bodyB,row);
+					}
+				}
+				break;
+			case SOLVER_STAGE_ROLLING_FRICTION:
+				{
+					btScalar totalImpulse = m_tmpSolverContactConstraintPool[row.m_frictionIndex].m_appliedImpulse;
+					if (totalImpulse>btScalar(0))
+					{
+						btScalar rollingFrictionMagnitude = row.m_friction*totalImpulse;
+						if (rollingFrictionMagnitude>row.m_friction)
+							rollingFrictionMagnitude = row.m_friction;
+						row.m_lowerLimit = -rollingFrictionMagnitude;
+						row.m_upperLimit = rollingFrictionMagnitude;
+						if (useSimd)
+							resolveSingleConstraintRowGenericSIMD(*bodyA,*bodyB,row);
+						else
+							resolveSingleConstraintRowGeneric(*bodyA,*bodyB,row);
+					}
+				}
+				break;
+			case SOLVER_STAGE_SPLIT_IMPULSE:
+				if (useSimd)
+					resolveSplitPenetrationSIMD(*bodyA,*bodyB,row);
+				else
+					resolveSplitPenetrationImpulseCacheFriendly(*bodyA,*bodyB,row);
+				break;
+			}
+		}
+	}
+}
+
+void btParallelConstraintSolver::solveGroupCacheFriendlySplitImpulseIterations(btCollisionObject** /*bodies*/,int /*numBodies*/,btPersistentManifold** /*manifoldPtr*/, int /*numManifolds*/,btTypedConstraint** /*constraints*/,int /*numConstraints*/,const btContactSolverInfo& infoGlobal,btIDebugDraw* /*debugDrawer*/,btStackAlloc* /*stackAlloc*/)
+{
+	if (infoGlobal.m_splitImpulse)
+	{
+		for (int iteration=0;iteration<infoGlobal.m_numIterations;iteration++)
+			solvePhases(m_contactPhases,SOLVER_STAGE_SPLIT_IMPULSE,iteration,infoGlobal);
+	}
+}
+
+btScalar btParallelConstraintSolver::solveGroupCacheFriendlyIterations(btCollisionObject** bodies,int numBodies,btPersistentManifold** manifoldPtr, int numManifolds,btTypedConstraint** constraints,int numConstraints,const btContactSolverInfo& infoGlobal,btIDebugDraw* debugDrawer,btStackAlloc* stackAlloc)
+{
+	BT_PROFILE("solveGroupCacheFriendlyIterations (parallel)");
+
+	//btDiscreteDynamicsWorld ends each step with a solveGroup without rows, keep the phases for the next step
+	if (!numConstraints && !m_tmpSolverContactConstraintPool.size())
+		return 0.f;
+
+	//the interleaved friction rows follow the order of the contact rows, like in btSequentialImpulseConstraintSolver
+	bool interleave = (infoGlobal.m_solverMode & SOLVER_SIMD) && (infoGlobal.m_solverMode & SOLVER_INTERLEAVE_CONTACT_AND_FRICTION_CONSTRAINTS);
+	{
+		BT_PROFILE("setupSolverPhases");
+		setupSolverPhases(m_tmpSolverNonContactConstraintPool,m_jointPhases);
+		setupSolverPhases(m_tmpSolverContactConstraintPool,m_contactPhases);
+		setupSolverPhases(m_tmpSolverContactFrictionConstraintPool,m_frictionPhases);
+		setupSolverPhases(m_tmpSolverContactRollingFrictionConstraintPool,m_rollingFrictionPhases);
+	}
+
+	///this is a special step to resolve penetrations (just for contacts)
+	solveGroupCacheFriendlySplitImpulseIterations(bodies,numBodies,manifoldPtr,numManifolds,constraints,numConstraints,infoGlobal,debugDrawer,stackAlloc);
+
+	int maxIterations = m_maxOverrideNumSolverIterations > infoGlobal.m_numIterations? m_maxOverrideNumSolverIterations : infoGlobal.m_numIterations;
+	for (int iteration=0;iteration<maxIterations;iteration++)
+	{
+		solvePhases(m_jointPhases,SOLVER_STAGE_JOINTS,iteration,infoGlobal);
+
+		if (iteration < infoGlobal.m_numIterations)
+		{
+			//serial, like in btSequentialImpulseConstraintSolver: only btConeTwistConstraint in its obsolete mode does anything here
+			for (int j=0;j<numConstraints;j++)
+			{
+				if (constraints[j]->isEnabled())
+				{
+					int bodyAid = getOrInitSolverBody(constraints[j]->getRigidBodyA());
+					int bodyBid = getOrInitSolverBody(constraints[j]->getRigidBodyB());
+					btSolverBody& bodyA = m_tmpSolverBodyPool[bodyAid];
+					btSolverBody& bodyB = m_tmpSolverBodyPool[bodyBid];
+					constraints[j]->solveConstraintObsolete(bodyA,bodyB,infoGlobal.m_timeStep);
+				}
+			}
+
+			if (interleave)
+			{
+				solvePhases(m_contactPhases,SOLVER_STAGE_INTERLEAVED_CONTACTS,iteration,infoGlobal);
+			} else
+			{
+				solvePhases(m_contactPhases,SOLVER_STAGE_CONTACTS,iteration,infoGlobal);
+				solvePhases(m_frictionPhases,SOLVER_STAGE_FRICTION,iteration,infoGlobal);
+				solvePhases(m_rollingFrictionPhases,SOLVER_STAGE_ROLLING_FRICTION,iteration,infoGlobal);
+			}
+		}
+	}
+	return 0.f;
 }
 
 
 
 btScalar btParallelConstraintSolver::solveGroup(btCollisionObject** bodies1,int numRigidBodies,btPersistentManifold** manifoldPtr,int numManifolds,btTypedConstraint** constraints,int numConstraints,const btContactSolverInfo& infoGlobal, btIDebugDraw* debugDrawer, btStackAlloc* stackAlloc,btDispatcher* dispatcher)
 {
+	if (!m_solverThreadSupport)
+	{
+		//the multicore solver, see solveGroupCacheFriendlyIterations
+		return btSequentialImpulseConstraintSolver::solveGroup(bodies1,numRigidBodies,manifoldPtr,numManifolds,constraints,numConstraints,infoGlobal,debugDrawer,stackAlloc,dispatcher);
+	}
 	
 /*	int sz = sizeof(PfxSolverBody);
 	int sz2 = sizeof(vmVector3);
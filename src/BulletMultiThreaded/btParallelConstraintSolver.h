@@ -260,9 +260,52 @@ void	SolverThreadFunc(void* userPtr,void* lsMemory);
 void*	SolverlsMemoryFunc();
 ///The btParallelConstraintSolver performs computations on constraint rows in parallel
 ///Using the cross-platform threading it supports Windows, Linux, Mac OSX and PlayStation 3 Cell SPUs
+///
+///Constructed without a btThreadSupportInterface, it is a multicore version of btSequentialImpulseConstraintSolver that runs on the
+///task scheduler (see btParallelFor). The rows are set up by btSequentialImpulseConstraintSolver, so every btTypedConstraint,
+///split impulse and restitution are supported. The consecutive rows between the same two bodies (the rows of a contact manifold or
+///of a constraint) form a group, the groups are sorted into phases of groups that don't share a dynamic body (a greedy graph colouring),
+///and the groups of a phase are solved in parallel. Once a phase would get fewer than getMinGroupsPerPhase() groups, the remaining
+///groups are solved in their original order by one thread, so small islands give the same results as btSequentialImpulseConstraintSolver.
+///The phases don't depend on the number of threads, neither do the results.
+///SOLVER_RANDMIZE_ORDER and SOLVER_BATCH_CONTACT_CONSTRAINTS are ignored. Use it with setSplitIslands(false) on the
+///btSimulationIslandManager of the btDiscreteDynamicsWorld, so all islands are solved by one call.
 class btParallelConstraintSolver : public btSequentialImpulseConstraintSolver
 {
-	
+public:
+
+	///consecutive rows of a row pool between the same two bodies
+	struct btSolverRowGroup
+	{
+		int		m_firstRow;
+		int		m_numRows;
+		int		m_dynamicBodyIdA;	///< -1 when the body is static or kinematic, see isSharedSolverBody
+		int		m_dynamicBodyIdB;
+	};
+
+	///the groups of a row pool, sorted by phase. The groups of the phases from m_numParallelPhases on are solved in order, by one thread.
+	///The arrays are kept from one solveGroup to the next and only grow.
+	struct btSolverPhases
+	{
+		btAlignedObjectArray<btSolverRowGroup>	m_groups;
+		btAlignedObjectArray<int>	m_phaseStarts;	///< the first group of each phase, followed by the number of groups
+		int		m_numParallelPhases;
+		///the groups in row order and the m_minGroupsPerPhase they were coloured with, the colouring is reused while they don't change
+		btAlignedObjectArray<btSolverRowGroup>	m_rowGroups;
+		int		m_minGroupsPerPhase;
+
+		btSolverPhases()
+			:m_numParallelPhases(0),
+			m_minGroupsPerPhase(-1)
+		{
+		}
+
+		int		getNumPhases() const
+		{
+			return m_phaseStarts.size() ? m_phaseStarts.size()-1 : 0;
+		}
+	};
+
 protected:
 	struct btParallelSolverMemoryCache*	m_memoryCache;
 
@@ -272,13 +315,82 @@ protected:
 	class btBarrier*			m_barrier;
 	class btCriticalSection*	m_criticalSection;
 
+	enum btSolverStage
+	{
+		SOLVER_STAGE_JOINTS,
+		SOLVER_STAGE_CONTACTS,
+		SOLVER_STAGE_INTERLEAVED_CONTACTS,	///< contacts followed by their friction, for SOLVER_INTERLEAVE_CONTACT_AND_FRICTION_CONSTRAINTS
+		SOLVER_STAGE_FRICTION,
+		SOLVER_STAGE_ROLLING_FRICTION,
+		SOLVER_STAGE_SPLIT_IMPULSE
+	};
+
+	btSolverPhases	m_jointPhases;
+	btSolverPhases	m_contactPhases;
+	btSolverPhases	m_frictionPhases;
+	btSolverPhases	m_rollingFrictionPhases;
+	btAlignedObjectArray<btSolverRowGroup>	m_tmpGroups;
+	btAlignedObjectArray<int>	m_pendingGroups;
+	btAlignedObjectArray<int>	m_deferredGroups;
+	btAlignedObjectArray<int>	m_bodyPhases;	///< the last phase that got a group of each solver body, used by the colouring
+	int		m_minGroupsPerPhase;
+	int		m_groupGrainSize;
+
+	void	setupSolverPhases(const btConstraintArray& rows, btSolverPhases& phases);
+
+	void	solvePhases(const btSolverPhases& phases, btSolverStage stage, int iteration, const btContactSolverInfo& infoGlobal);
+
+	///concurrent is true when other threads solve groups of the same phase, the static and kinematic bodies are copied then
+	void	solveRowGroups(const btSolverRowGroup* groups, int iBegin, int iEnd, btSolverStage stage, int iteration, const btContactSolverInfo& infoGlobal, bool concurrent);
+
+	virtual void solveGroupCacheFriendlySplitImpulseIterations(btCollisionObject** bodies,int numBodies,btPersistentManifold** manifoldPtr, int numManifolds,btTypedConstraint** constraints,int numConstraints,const btContactSolverInfo& infoGlobal,btIDebugDraw* debugDrawer,btStackAlloc* stackAlloc);
+	virtual btScalar solveGroupCacheFriendlyIterations(btCollisionObject** bodies,int numBodies,btPersistentManifold** manifoldPtr, int numManifolds,btTypedConstraint** constraints,int numConstraints,const btContactSolverInfo& infoGlobal,btIDebugDraw* debugDrawer,btStackAlloc* stackAlloc);
+
+	friend struct btSolverPhaseLoop;
 
 public:
 
+	///the multicore solver, running on the task scheduler
+	btParallelConstraintSolver();
+
+	///the solver of the PlayStation 3 port, running on the btThreadSupportInterface (single precision only)
 	btParallelConstraintSolver(class btThreadSupportInterface* solverThreadSupport);
 	
 	virtual ~btParallelConstraintSolver();
 
+	///phases with fewer groups are not solved in parallel: they and all later phases are merged into one phase, solved by one thread
+	void	setMinGroupsPerPhase(int minGroups)
+	{
+		m_minGroupsPerPhase = minGroups;
+	}
+
+	int		getMinGroupsPerPhase() const
+	{
+		return m_minGroupsPerPhase;
+	}
+
+	///the number of groups of a phase that are solved by one task
+	void	setGroupGrainSize(int grainSize)
+	{
+		m_groupGrainSize = grainSize;
+	}
+
+	int		getGroupGrainSize() const
+	{
+		return m_groupGrainSize;
+	}
+
+	///the phases of the contact rows of the last solveGroup that had rows
+	const btSolverPhases&	getContactPhases() const
+	{
+		return m_contactPhases;
+	}
+
+	const btSolverPhases&	getJointPhases() const
+	{
+		return m_jointPhases;
+	}
+
 	virtual btScalar solveGroup(btCollisionObject** bodies,int numBodies,btPersistentManifold** manifold,int numManifolds,btTypedConstraint** constraints,int numConstraints,const btContactSolverInfo& info, btIDebugDraw* debugDrawer, btStackAlloc* stackAlloc,btDispatcher* dispatcher);
 
 };
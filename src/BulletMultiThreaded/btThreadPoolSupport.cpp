@@ -0,0 +1,680 @@
+/*
+Copyright (c) 2003-2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btThreadPoolSupport.h"
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btAlignedAllocator.h"
+#include "LinearMath/btMinMax.h"
+#include <new>
+#include <limits.h>
+
+#if defined (_WIN32)
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+#else //_WIN32
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#if defined (__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#define BT_USE_FUTEX
+#endif //__linux__
+
+#endif //_WIN32
+
+///the number of tasks a worker can have queued, a power of two
+#define BT_THREAD_POOL_QUEUE_SIZE 64
+
+///positions in the queues wrap around, unsigned arithmetic keeps that defined
+static SIMD_FORCE_INLINE int btWrapAdd(int a, int b)
+{
+	return int(unsigned(a) + unsigned(b));
+}
+
+static SIMD_FORCE_INLINE int btWrapSub(int a, int b)
+{
+	return int(unsigned(a) - unsigned(b));
+}
+
+///btAtomicExchange stores value in *ptr and returns the previous value (full memory barrier)
+static SIMD_FORCE_INLINE int btAtomicExchange(volatile int* ptr, int value)
+{
+	int prev = btAtomicLoad(ptr);
+	for (;;)
+	{
+		int actual = btAtomicCompareExchange(ptr, prev, value);
+		if (actual == prev)
+			return prev;
+		prev = actual;
+	}
+}
+
+///btParkingLot lets threads sleep until a word changes from the value they saw.
+///A waiter registers in m_numWaiters before it checks the word, and a waker changes the word with a full barrier before it checks m_numWaiters,
+///so one of them always sees the other, and wake() is a single load while nobody sleeps.
+struct btParkingLot
+{
+	volatile int			m_numWaiters;
+#if defined (BT_USE_FUTEX)
+#elif defined (_WIN32)
+	CRITICAL_SECTION		m_mutex;
+	CONDITION_VARIABLE		m_condition;
+#else
+	pthread_mutex_t			m_mutex;
+	pthread_cond_t			m_condition;
+#endif
+
+	btParkingLot()
+		:m_numWaiters(0)
+	{
+#if defined (BT_USE_FUTEX)
+#elif defined (_WIN32)
+		InitializeCriticalSection(&m_mutex);
+		InitializeConditionVariable(&m_condition);
+#else
+		pthread_mutex_init(&m_mutex, 0);
+		pthread_cond_init(&m_condition, 0);
+#endif
+	}
+
+	~btParkingLot()
+	{
+#if defined (BT_USE_FUTEX)
+#elif defined (_WIN32)
+		DeleteCriticalSection(&m_mutex);
+#else
+		pthread_cond_destroy(&m_condition);
+		pthread_mutex_destroy(&m_mutex);
+#endif
+	}
+
+	///sleeps while *word equals expected
+	void	wait(volatile int* word, int expected)
+	{
+		btAtomicFetchAdd(&m_numWaiters, 1);
+#if defined (BT_USE_FUTEX)
+		while (btAtomicLoad(word) == expected)
+		{
+			syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, expected, 0, 0, 0);
+		}
+#elif defined (_WIN32)
+		EnterCriticalSection(&m_mutex);
+		while (btAtomicLoad(word) == expected)
+		{
+			SleepConditionVariableCS(&m_condition, &m_mutex, INFINITE);
+		}
+		LeaveCriticalSection(&m_mutex);
+#else
+		pthread_mutex_lock(&m_mutex);
+		while (btAtomicLoad(word) == expected)
+		{
+			pthread_cond_wait(&m_condition, &m_mutex);
+		}
+		pthread_mutex_unlock(&m_mutex);
+#endif
+		btAtomicFetchAdd(&m_numWaiters, -1);
+	}
+
+	///wakes the threads waiting on word, call it after changing word with a full barrier
+	void	wake(volatile int* word)
+	{
+		if (btAtomicLoad(&m_numWaiters) == 0)
+			return;
+#if defined (BT_USE_FUTEX)
+		syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, INT_MAX, 0, 0, 0);
+#elif defined (_WIN32)
+		(void)word;
+		EnterCriticalSection(&m_mutex);
+		WakeAllConditionVariable(&m_condition);
+		LeaveCriticalSection(&m_mutex);
+#else
+		(void)word;
+		pthread_mutex_lock(&m_mutex);
+		pthread_cond_broadcast(&m_condition);
+		pthread_mutex_unlock(&m_mutex);
+#endif
+	}
+};
+
+
+struct btThreadPoolTask
+{
+	void*		m_userPtr;
+	uint32_t	m_commandId;
+	uint32_t	m_taskId;
+};
+
+///btThreadPoolWorker is one thread with a single producer, single consumer queue of tasks.
+///The main thread pushes at m_tail, the worker pops at m_head and parks on m_tail when the queue stays empty.
+struct btThreadPoolWorker
+{
+	btThreadPoolTask		m_queue[BT_THREAD_POOL_QUEUE_SIZE];
+	volatile int			m_head;
+	char					m_padding0[64 - sizeof(int)];
+	volatile int			m_tail;
+	char					m_padding1[64 - sizeof(int)];
+	btParkingLot			m_parkingLot;
+
+	btThreadPoolFunc		m_userThreadFunc;
+	void*					m_lsMemory;
+	btThreadPoolCompletionQueue*	m_completionQueue;
+	int						m_spinCount;
+	volatile int			m_numTasksRun;
+	int						m_processor;
+#if defined (_WIN32)
+	HANDLE					m_thread;
+#else
+	pthread_t				m_thread;
+#endif
+
+	btThreadPoolWorker()
+		:m_head(0),
+		m_tail(0),
+		m_userThreadFunc(0),
+		m_lsMemory(0),
+		m_completionQueue(0),
+		m_spinCount(0),
+		m_numTasksRun(0),
+		m_processor(-1)
+	{
+	}
+
+	void	push(const btThreadPoolTask& task)
+	{
+		//only the main thread writes m_tail
+		int tail = m_tail;
+		while (btWrapSub(tail, btAtomicLoad(&m_head)) >= BT_THREAD_POOL_QUEUE_SIZE)
+		{
+			btSpinPause();
+		}
+		m_queue[tail & (BT_THREAD_POOL_QUEUE_SIZE-1)] = task;
+		btAtomicFetchAdd(&m_tail, 1);
+		m_parkingLot.wake(&m_tail);
+	}
+
+	void	run();
+};
+
+///btThreadPoolCompletionQueue is a bounded multiple producer, single consumer queue of finished task ids.
+///Every slot has a sequence number that tells whether it is free for the producer at that position or holds a task id for the consumer.
+struct btThreadPoolCompletionQueue
+{
+	btAlignedObjectArray<int>	m_taskIds;
+	btAlignedObjectArray<int>	m_sequence;
+	int						m_mask;
+	volatile int			m_tail;
+	char					m_padding0[64 - sizeof(int)];
+	int						m_head;
+	volatile int			m_numCompleted;
+	btParkingLot			m_parkingLot;
+
+	btThreadPoolCompletionQueue(int capacity)
+		:m_tail(0),
+		m_head(0),
+		m_numCompleted(0)
+	{
+		int size = 1;
+		while (size < capacity)
+			size *= 2;
+		m_mask = size-1;
+		m_taskIds.resize(size, 0);
+		m_sequence.resize(size, 0);
+		for (int i=0;i<size;i++)
+		{
+			m_sequence[i] = i;
+		}
+	}
+
+	void	push(int taskId)
+	{
+		int pos = btAtomicFetchAdd(&m_tail, 1);
+		int slot = pos & m_mask;
+		//the queue holds every task that can be outstanding, so the slot is free already
+		while (btAtomicLoad(&m_sequence[slot]) != pos)
+		{
+			btSpinPause();
+		}
+		m_taskIds[slot] = taskId;
+		btAtomicStore(&m_sequence[slot], btWrapAdd(pos, 1));
+		btAtomicFetchAdd(&m_numCompleted, 1);
+		m_parkingLot.wake(&m_numCompleted);
+	}
+
+	int		capacity() const
+	{
+		return m_mask+1;
+	}
+
+	bool	pop(int& taskId)
+	{
+		int slot = m_head & m_mask;
+		if (btAtomicLoad(&m_sequence[slot]) != btWrapAdd(m_head, 1))
+			return false;
+		taskId = m_taskIds[slot];
+		btAtomicStore(&m_sequence[slot], btWrapAdd(m_head, m_mask+1));
+		m_head = btWrapAdd(m_head, 1);
+		return true;
+	}
+};
+
+void	btThreadPoolWorker::run()
+{
+	int head = 0;
+	for (;;)
+	{
+		int spinCount = 0;
+		while (btAtomicLoad(&m_tail) == head)
+		{
+			if (spinCount++ < m_spinCount)
+			{
+				btSpinPause();
+			} else
+			{
+				m_parkingLot.wait(&m_tail, head);
+			}
+		}
+
+		//copy the task, the slot is reused once m_head moves on
+		btThreadPoolTask task = m_queue[head & (BT_THREAD_POOL_QUEUE_SIZE-1)];
+		head = btWrapAdd(head, 1);
+		btAtomicStore(&m_head, head);
+		if (!task.m_userPtr)
+			break;
+
+		m_userThreadFunc(task.m_userPtr, m_lsMemory);
+		btAtomicFetchAdd(&m_numTasksRun, 1);
+		m_completionQueue->push(int(task.m_taskId));
+	}
+}
+
+#if defined (_WIN32)
+static DWORD WINAPI btThreadPoolFunction(LPVOID argument)
+#else
+static void* btThreadPoolFunction(void* argument)
+#endif
+{
+	btThreadPoolWorker* worker = (btThreadPoolWorker*)argument;
+	worker->run();
+	return 0;
+}
+
+///returns the index-th processor the process may run on, modulo their number, or -1 if the platform can't pin threads
+static int btGetAllowedProcessor(int index)
+{
+#if defined (_WIN32)
+	DWORD_PTR processMask = 0;
+	DWORD_PTR systemMask = 0;
+	if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask) || !processMask)
+		return -1;
+	int numAllowed = 0;
+	for (int cpu=0;cpu<int(sizeof(DWORD_PTR)*8);cpu++)
+	{
+		if (processMask & (DWORD_PTR(1)<<cpu))
+			numAllowed++;
+	}
+	index %= numAllowed;
+	for (int cpu=0;cpu<int(sizeof(DWORD_PTR)*8);cpu++)
+	{
+		if ((processMask & (DWORD_PTR(1)<<cpu)) && index-- == 0)
+			return cpu;
+	}
+	return -1;
+#elif defined (__linux__) && defined (CPU_SET)
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+		return -1;
+	int numAllowed = CPU_COUNT(&allowed);
+	if (!numAllowed)
+		return -1;
+	index %= numAllowed;
+	for (int cpu=0;cpu<CPU_SETSIZE;cpu++)
+	{
+		if (CPU_ISSET(cpu, &allowed) && index-- == 0)
+			return cpu;
+	}
+	return -1;
+#else
+	(void)index;
+	return -1;
+#endif
+}
+
+static bool btPinThread(btThreadPoolWorker& worker, int processor)
+{
+#if defined (_WIN32)
+	return SetThreadAffinityMask(worker.m_thread, DWORD_PTR(1)<<processor) != 0;
+#elif defined (__linux__) && defined (CPU_SET)
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	CPU_SET(processor, &cpus);
+	return pthread_setaffinity_np(worker.m_thread, sizeof(cpus), &cpus) == 0;
+#else
+	(void)worker;
+	(void)processor;
+	return false;
+#endif
+}
+
+
+///btThreadPoolBarrier spins, then parks on the generation, which the last thread to arrive moves on
+class btThreadPoolBarrier : public btBarrier
+{
+	volatile int	m_count;
+	volatile int	m_generation;
+	int				m_maxCount;
+	int				m_spinCount;
+	btParkingLot	m_parkingLot;
+
+public:
+	btThreadPoolBarrier(int spinCount)
+		:m_count(0),
+		m_generation(0),
+		m_maxCount(0),
+		m_spinCount(spinCount)
+	{
+	}
+
+	virtual void sync()
+	{
+		int generation = btAtomicLoad(&m_generation);
+		if (btAtomicFetchAdd(&m_count, 1) == m_maxCount-1)
+		{
+			btAtomicStore(&m_count, 0);
+			btAtomicFetchAdd(&m_generation, 1);
+			m_parkingLot.wake(&m_generation);
+			return;
+		}
+		int spinCount = 0;
+		while (btAtomicLoad(&m_generation) == generation)
+		{
+			if (spinCount++ < m_spinCount)
+			{
+				btSpinPause();
+			} else
+			{
+				m_parkingLot.wait(&m_generation, generation);
+			}
+		}
+	}
+
+	virtual void setMaxCount(int numThreads)
+	{
+		m_maxCount = numThreads;
+		m_count = 0;
+	}
+
+	virtual int  getMaxCount()
+	{
+		return m_maxCount;
+	}
+};
+
+///btThreadPoolCriticalSection is a spin-then-park mutex: 0 is unlocked, 1 locked, 2 locked with threads parked on it
+class btThreadPoolCriticalSection : public btCriticalSection
+{
+	volatile int	m_state;
+	int				m_spinCount;
+	btParkingLot	m_parkingLot;
+
+public:
+	btThreadPoolCriticalSection(int spinCount)
+		:m_state(0),
+		m_spinCount(spinCount)
+	{
+	}
+
+	virtual unsigned int getSharedParam(int i)
+	{
+		return mCommonBuff[i];
+	}
+
+	virtual void setSharedParam(int i,unsigned int p)
+	{
+		mCommonBuff[i] = p;
+	}
+
+	virtual void lock()
+	{
+		for (int i=0;i<m_spinCount;i++)
+		{
+			if (btAtomicLoad(&m_state) == 0 && btAtomicCompareExchange(&m_state, 0, 1) == 0)
+				return;
+			btSpinPause();
+		}
+		int state = btAtomicCompareExchange(&m_state, 0, 1);
+		if (state == 0)
+			return;
+		if (state != 2)
+			state = btAtomicExchange(&m_state, 2);
+		while (state != 0)
+		{
+			m_parkingLot.wait(&m_state, 2);
+			state = btAtomicExchange(&m_state, 2);
+		}
+	}
+
+	virtual void unlock()
+	{
+		if (btAtomicFetchAdd(&m_state, -1) != 1)
+		{
+			btAtomicExchange(&m_state, 0);
+			m_parkingLot.wake(&m_state);
+		}
+	}
+};
+
+
+btThreadPoolSupport::btThreadPoolSupport(const ThreadConstructionInfo& threadConstructionInfo)
+:m_completionQueue(0),
+m_userThreadFunc(threadConstructionInfo.m_userThreadFunc),
+m_spinCount(btMax(threadConstructionInfo.m_spinCount, 0)),
+m_pinThreads(threadConstructionInfo.m_pinThreads),
+m_threadStackSize(threadConstructionInfo.m_threadStackSize),
+m_numOutstandingTasks(0),
+m_firstCompletedTask(0)
+{
+	int numThreads = btMax(threadConstructionInfo.m_numThreads, 1);
+	m_lsMemory.resize(numThreads, 0);
+	for (int i=0;i<numThreads;i++)
+	{
+		m_lsMemory[i] = threadConstructionInfo.m_lsMemoryFunc();
+	}
+
+	void* mem = btAlignedAlloc(sizeof(btThreadPoolCompletionQueue), 64);
+	m_completionQueue = new(mem) btThreadPoolCompletionQueue(numThreads*BT_THREAD_POOL_QUEUE_SIZE);
+
+	startSPU();
+}
+
+btThreadPoolSupport::~btThreadPoolSupport()
+{
+	stopSPU();
+	m_completionQueue->~btThreadPoolCompletionQueue();
+	btAlignedFree(m_completionQueue);
+}
+
+void btThreadPoolSupport::sendRequest(uint32_t uiCommand, ppu_address_t uiArgument0, uint32_t taskId)
+{
+	btAssert(isStarted());
+	btAssert(uiArgument0);
+
+	//a worker can't finish a task while the completion queue is full, and the main thread would wait for it in push(),
+	//so the tasks that finished are moved out of the completion queue before it can fill up
+	while (m_numOutstandingTasks - (m_completedTasks.size()-m_firstCompletedTask) >= m_completionQueue->capacity())
+	{
+		m_completedTasks.push_back(popCompletedTask());
+	}
+
+	btThreadPoolTask task;
+	task.m_userPtr = (void*)uiArgument0;
+	task.m_commandId = uiCommand;
+	task.m_taskId = taskId;
+	m_workers[int(taskId % uint32_t(m_workers.size()))]->push(task);
+	m_numOutstandingTasks++;
+}
+
+int btThreadPoolSupport::popCompletedTask()
+{
+	int taskId = 0;
+	int spinCount = 0;
+	while (!m_completionQueue->pop(taskId))
+	{
+		if (spinCount++ < m_spinCount)
+		{
+			btSpinPause();
+			continue;
+		}
+		int numCompleted = btAtomicLoad(&m_completionQueue->m_numCompleted);
+		if (m_completionQueue->pop(taskId))
+			break;
+		m_completionQueue->m_parkingLot.wait(&m_completionQueue->m_numCompleted, numCompleted);
+	}
+	return taskId;
+}
+
+void btThreadPoolSupport::waitForResponse(unsigned int *puiArgument0, unsigned int *puiArgument1)
+{
+	btAssert(m_numOutstandingTasks > 0);
+
+	//the tasks sendRequest took out of the completion queue finished first
+	int taskId;
+	if (m_firstCompletedTask < m_completedTasks.size())
+	{
+		taskId = m_completedTasks[m_firstCompletedTask++];
+		if (m_firstCompletedTask == m_completedTasks.size())
+		{
+			m_completedTasks.resize(0);
+			m_firstCompletedTask = 0;
+		}
+	} else
+	{
+		taskId = popCompletedTask();
+	}
+	m_numOutstandingTasks--;
+
+	*puiArgument0 = unsigned(taskId);
+	*puiArgument1 = 0;
+}
+
+void btThreadPoolSupport::startSPU()
+{
+	if (isStarted())
+		return;
+
+	for (int i=0;i<m_lsMemory.size();i++)
+	{
+		void* mem = btAlignedAlloc(sizeof(btThreadPoolWorker), 64);
+		btThreadPoolWorker* worker = new(mem) btThreadPoolWorker;
+		worker->m_userThreadFunc = m_userThreadFunc;
+		worker->m_lsMemory = m_lsMemory[i];
+		worker->m_completionQueue = m_completionQueue;
+		worker->m_spinCount = m_spinCount;
+
+#if defined (_WIN32)
+		worker->m_thread = CreateThread(0, SIZE_T(btMax(m_threadStackSize, 0)), btThreadPoolFunction, worker, 0, 0);
+		btAssert(worker->m_thread);
+#else
+		pthread_attr_t attr;
+		pthread_attr_init(&attr);
+		if (m_threadStackSize > 0)
+		{
+			pthread_attr_setstacksize(&attr, size_t(btMax(m_threadStackSize, int(PTHREAD_STACK_MIN))));
+		}
+		int result = pthread_create(&worker->m_thread, &attr, btThreadPoolFunction, worker);
+		pthread_attr_destroy(&attr);
+		btAssert(result == 0);
+		(void)result;
+#endif
+
+		if (m_pinThreads)
+		{
+			//worker i goes to the (i+1)-th processor, the main thread usually runs on the first one
+			int processor = btGetAllowedProcessor(i+1);
+			if (processor >= 0 && btPinThread(*worker, processor))
+			{
+				worker->m_processor = processor;
+			}
+		}
+		m_workers.push_back(worker);
+	}
+}
+
+void btThreadPoolSupport::stopSPU()
+{
+	btAssert(m_numOutstandingTasks == 0);
+
+	//an empty task tells a worker to exit, after the tasks queued before it
+	btThreadPoolTask quit;
+	quit.m_userPtr = 0;
+	quit.m_commandId = 0;
+	quit.m_taskId = 0;
+	for (int i=0;i<m_workers.size();i++)
+	{
+		m_workers[i]->push(quit);
+	}
+	for (int i=0;i<m_workers.size();i++)
+	{
+		btThreadPoolWorker* worker = m_workers[i];
+#if defined (_WIN32)
+		WaitForSingleObject(worker->m_thread, INFINITE);
+		CloseHandle(worker->m_thread);
+#else
+		pthread_join(worker->m_thread, 0);
+#endif
+		worker->~btThreadPoolWorker();
+		btAlignedFree(worker);
+	}
+	m_workers.clear();
+}
+
+int btThreadPoolSupport::getNumTasksRun(int taskId) const
+{
+	if (!isStarted())
+		return 0;
+	return btAtomicLoad(&m_workers[taskId % m_workers.size()]->m_numTasksRun);
+}
+
+int btThreadPoolSupport::getThreadProcessor(int taskId) const
+{
+	if (!isStarted())
+		return -1;
+	return m_workers[taskId % m_workers.size()]->m_processor;
+}
+
+btBarrier* btThreadPoolSupport::createBarrier()
+{
+	btThreadPoolBarrier* barrier = new btThreadPoolBarrier(m_spinCount);
+	barrier->setMaxCount(getNumTasks());
+	return barrier;
+}
+
+btCriticalSection* btThreadPoolSupport::createCriticalSection()
+{
+	return new btThreadPoolCriticalSection(m_spinCount);
+}
+
+void btThreadPoolSupport::deleteBarrier(btBarrier* barrier)
+{
+	delete barrier;
+}
+
+void btThreadPoolSupport::deleteCriticalSection(btCriticalSection* criticalSection)
+{
+	delete criticalSection;
+}
@@ -0,0 +1,148 @@
+/*
+Copyright (c) 2003-2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_THREAD_POOL_SUPPORT_H
+#define BT_THREAD_POOL_SUPPORT_H
+
+#include "LinearMath/btScalar.h"
+#include "LinearMath/btAlignedObjectArray.h"
+
+#include "btThreadSupportInterface.h"
+
+typedef void (*btThreadPoolFunc)(void* userPtr,void* lsMemory);
+typedef void* (*btThreadPoolLsMemorySetupFunc)();
+
+struct btThreadPoolWorker;
+struct btThreadPoolCompletionQueue;
+
+///btThreadPoolSupport runs the tasks of a btThreadSupportInterface on persistent worker threads, without a semaphore handshake per task.
+///sendRequest pushes the task on a lock-free queue of worker taskId % getNumTasks(), waitForResponse pops finished tasks from a lock-free completion queue.
+///Idle workers, and the main thread in waitForResponse, spin for a while before they park (on a futex on Linux, a condition variable elsewhere).
+///It takes the same thread and local store functions as PosixThreadSupport and Win32ThreadSupport, so the collision dispatcher,
+///the parallel constraint solver and MiniCL can use it unchanged. Tasks that share a worker run one after another,
+///so code that syncs its tasks on a btBarrier must not use more than getNumTasks() task ids.
+class btThreadPoolSupport : public btThreadSupportInterface
+{
+public:
+
+	struct	ThreadConstructionInfo
+	{
+		ThreadConstructionInfo(const char* uniqueName,
+									btThreadPoolFunc userThreadFunc,
+									btThreadPoolLsMemorySetupFunc lsMemoryFunc,
+									int numThreads=1,
+									int spinCount=4096,
+									bool pinThreads=false,
+									int threadStackSize=0
+									)
+									:m_uniqueName(uniqueName),
+									m_userThreadFunc(userThreadFunc),
+									m_lsMemoryFunc(lsMemoryFunc),
+									m_numThreads(numThreads),
+									m_spinCount(spinCount),
+									m_pinThreads(pinThreads),
+									m_threadStackSize(threadStackSize)
+		{
+
+		}
+
+		const char*					m_uniqueName;
+		btThreadPoolFunc			m_userThreadFunc;
+		btThreadPoolLsMemorySetupFunc	m_lsMemoryFunc;
+		int							m_numThreads;
+		///the number of busy-wait iterations before an idle thread parks
+		int							m_spinCount;
+		///pins worker i to the (i+1)-th processor the process may run on, where the platform supports it
+		bool						m_pinThreads;
+		///0 uses the default stack size of the platform
+		int							m_threadStackSize;
+	};
+
+private:
+
+	btAlignedObjectArray<btThreadPoolWorker*>	m_workers;
+	btAlignedObjectArray<void*>				m_lsMemory;
+	btThreadPoolCompletionQueue*			m_completionQueue;
+	btThreadPoolFunc						m_userThreadFunc;
+	int										m_spinCount;
+	bool									m_pinThreads;
+	int										m_threadStackSize;
+	int										m_numOutstandingTasks;
+	///finished tasks that sendRequest took out of the completion queue, waitForResponse returns them from m_firstCompletedTask on
+	btAlignedObjectArray<int>				m_completedTasks;
+	int										m_firstCompletedTask;
+
+	///spins, then parks until a worker finishes a task, returns its id
+	int		popCompletedTask();
+
+public:
+
+	btThreadPoolSupport(const ThreadConstructionInfo& threadConstructionInfo);
+
+	virtual	~btThreadPoolSupport();
+
+	///queues the task on worker taskId % getNumTasks(), uiArgument0 is passed to the thread function as userPtr and must not be 0.
+	///Any number of tasks can be outstanding, when the queues are full sendRequest waits for a task to finish.
+	virtual	void sendRequest(uint32_t uiCommand, ppu_address_t uiArgument0, uint32_t taskId);
+
+	///returns the task id of a finished task in puiArgument0, in the order the tasks finished
+	virtual	void waitForResponse(unsigned int *puiArgument0, unsigned int *puiArgument1);
+
+	///starts the worker threads again after stopSPU, the constructor already starts them
+	virtual	void startSPU();
+
+	///stops and joins the worker threads, the thread local memory is kept
+	virtual	void stopSPU();
+
+	virtual void setNumTasks(int numTasks)
+	{
+		(void)numTasks;
+	}
+
+	virtual int getNumTasks() const
+	{
+		return m_lsMemory.size();
+	}
+
+	virtual btBarrier* createBarrier();
+
+	virtual btCriticalSection* createCriticalSection();
+
+	virtual void deleteBarrier(btBarrier* barrier);
+
+	virtual void deleteCriticalSection(btCriticalSection* criticalSection);
+
+	virtual void*	getThreadLocalMemory(int taskId)
+	{
+		return m_lsMemory[taskId % m_lsMemory.size()];
+	}
+
+	bool	isStarted() const
+	{
+		return m_workers.size() != 0;
+	}
+
+	///the number of tasks worker taskId ran since it started
+	int		getNumTasksRun(int taskId) const;
+
+	///the processor worker taskId is pinned to, or -1
+	int		getThreadProcessor(int taskId) const;
+
+	int		getSpinCount() const
+	{
+		return m_spinCount;
+	}
+};
+
+#endif //BT_THREAD_POOL_SUPPORT_H
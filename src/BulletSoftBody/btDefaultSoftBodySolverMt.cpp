@@ -0,0 +1,338 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btDefaultSoftBodySolverMt.h"
+#include "BulletCollision/BroadphaseCollision/btBroadphaseInterface.h"
+#include "BulletDynamics/Dynamics/btRigidBody.h"
+#include "LinearMath/btHashMap.h"
+#include "LinearMath/btThreads.h"
+
+
+///solves the links [iBegin,iEnd) of one batch
+struct btSoftBodyLinkBatchLoop : public btIParallelForBody
+{
+	btSoftBody*	m_softBody;
+	btScalar	m_kst;
+	bool		m_velocities;
+
+	void forLoop( int iBegin, int iEnd ) const
+	{
+		if (m_velocities)
+			btSoftBody::VSolve_LinkRange(m_softBody,m_kst,iBegin,iEnd);
+		else
+			btSoftBody::PSolve_LinkRange(m_softBody,m_kst,iBegin,iEnd);
+	}
+};
+
+///solves the links of a soft body batch by batch
+struct btSoftBodyLinkBatchSolver : public btSoftBody::ILinkSolver
+{
+	const btDefaultSoftBodySolverMt::btSoftBodyLinkBatches*	m_batches;
+	int		m_grainSize;
+
+	void	solveBatches(btSoftBody* psb,btScalar kst,bool velocities)
+	{
+		btSoftBodyLinkBatchLoop loop;
+		loop.m_softBody = psb;
+		loop.m_kst = kst;
+		loop.m_velocities = velocities;
+		for (int i=0;i<m_batches->m_numBatches;i++)
+		{
+			int begin = m_batches->m_batchStarts[i];
+			int end = m_batches->m_batchStarts[i+1];
+			//the links of the last batch can share nodes
+			if (i==btDefaultSoftBodySolverMt::MAX_LINK_BATCHES)
+				loop.forLoop(begin,end);
+			else
+				btParallelFor(begin,end,m_grainSize,loop);
+		}
+	}
+
+	virtual void	solveLinkPositions(btSoftBody* psb,btScalar kst)
+	{
+		solveBatches(psb,kst,false);
+	}
+
+	virtual void	solveLinkVelocities(btSoftBody* psb,btScalar kst)
+	{
+		solveBatches(psb,kst,true);
+	}
+};
+
+struct btSoftBodyPredictMotionLoop : public btIParallelForBody
+{
+	btSoftBody* const*	m_softBodies;
+	btScalar	m_timeStep;
+
+	void forLoop( int iBegin, int iEnd ) const
+	{
+		for (int i=iBegin;i<iEnd;i++)
+			m_softBodies[i]->predictMotion(m_timeStep);
+	}
+};
+
+struct btSoftBodySolveConstraintsLoop : public btIParallelForBody
+{
+	btSoftBody* const*	m_softBodies;
+
+	void forLoop( int iBegin, int iEnd ) const
+	{
+		for (int i=iBegin;i<iEnd;i++)
+			m_softBodies[i]->solveConstraints();
+	}
+};
+
+struct btSoftBodyIntegrateMotionLoop : public btIParallelForBody
+{
+	btSoftBody* const*	m_softBodies;
+
+	void forLoop( int iBegin, int iEnd ) const
+	{
+		for (int i=iBegin;i<iEnd;i++)
+			m_softBodies[i]->integrateMotion();
+	}
+};
+
+
+btDefaultSoftBodySolverMt::btDefaultSoftBodySolverMt()
+:m_minLinksForBatching(1024),
+m_linkGrainSize(256)
+{
+}
+
+btDefaultSoftBodySolverMt::~btDefaultSoftBodySolverMt()
+{
+}
+
+void btDefaultSoftBodySolverMt::optimize( btAlignedObjectArray< btSoftBody * > &softBodies , bool forceUpdate)
+{
+	bool changed = forceUpdate || softBodies.size()!=m_softBodySet.size();
+	for (int i=0;i<softBodies.size() && !changed;i++)
+		changed = softBodies[i]!=m_softBodySet[i];
+
+	if (changed)
+	{
+		//keep the batches of the soft bodies that are still there
+		btHashMap<btHashPtr,int> previous;
+		if (!forceUpdate)
+		{
+			for (int i=0;i<m_softBodySet.size();i++)
+				previous.insert(m_softBodySet[i],i);
+		}
+		btAlignedObjectArray<btSoftBodyLinkBatches> linkBatches;
+		linkBatches.resize(softBodies.size());
+		for (int i=0;i<softBodies.size();i++)
+		{
+			const int* index = previous.find(softBodies[i]);
+			if (index)
+			{
+				linkBatches[i] = m_linkBatches[*index];
+			} else
+			{
+				linkBatches[i].m_links = 0;
+				linkBatches[i].m_nodes = 0;
+				linkBatches[i].m_numLinks = -1;
+				linkBatches[i].m_numNodes = -1;
+				linkBatches[i].m_numBatches = 0;
+			}
+		}
+		m_linkBatches.copyFromArray(linkBatches);
+	}
+	btDefaultSoftBodySolver::optimize(softBodies,forceUpdate);
+}
+
+bool btDefaultSoftBodySolverMt::isIndependent(const btSoftBody* psb)
+{
+	//anchors and contacts with dynamic rigid bodies apply impulses to the rigid body, soft contacts move the nodes of the other soft body
+	if (psb->m_anchors.size() || psb->m_scontacts.size())
+		return false;
+	for (int i=0;i<psb->m_rcontacts.size();i++)
+	{
+		const btRigidBody* body = btRigidBody::upcast(psb->m_rcontacts[i].m_cti.m_colObj);
+		if (body && body->getInvMass()!=btScalar(0.))
+			return false;
+	}
+	return true;
+}
+
+void btDefaultSoftBodySolverMt::updateLinkBatches(btSoftBody* psb, btSoftBodyLinkBatches& batches)
+{
+	int numLinks = psb->m_links.size();
+	int numNodes = psb->m_nodes.size();
+	const btSoftBody::Link* links = numLinks ? &psb->m_links[0] : 0;
+	const btSoftBody::Node* nodes = numNodes ? &psb->m_nodes[0] : 0;
+	if (batches.m_links==links && batches.m_nodes==nodes && batches.m_numLinks==numLinks && batches.m_numNodes==numNodes)
+		return;
+
+	//greedy colouring: each link gets the first batch that none of the links at its two nodes is in
+	m_nodeBatchMasks.resize(numNodes);
+	m_linkBatchIndices.resize(numLinks);
+	int i;
+	for (i=0;i<numNodes;i++)
+		m_nodeBatchMasks[i] = 0;
+	int batchSizes[MAX_LINK_BATCHES+1];
+	for (i=0;i<=MAX_LINK_BATCHES;i++)
+		batchSizes[i] = 0;
+	for (i=0;i<numLinks;i++)
+	{
+		const btSoftBody::Link& l = psb->m_links[i];
+		int node0 = int(l.m_n[0]-nodes);
+		int node1 = int(l.m_n[1]-nodes);
+		unsigned int used = m_nodeBatchMasks[node0] | m_nodeBatchMasks[node1];
+		int batch = 0;
+		while (batch<MAX_LINK_BATCHES && (used & (1u<<batch)))
+			batch++;
+		if (batch<MAX_LINK_BATCHES)
+		{
+			m_nodeBatchMasks[node0] |= 1u<<batch;
+			m_nodeBatchMasks[node1] |= 1u<<batch;
+		}
+		m_linkBatchIndices[i] = batch;
+		batchSizes[batch]++;
+	}
+
+	//sort the links on batch, keeping their order within a batch
+	batches.m_numBatches = 0;
+	int start = 0;
+	for (i=0;i<=MAX_LINK_BATCHES;i++)
+	{
+		batches.m_batchStarts[i] = start;
+		start += batchSizes[i];
+		if (batchSizes[i])
+			batches.m_numBatches = i+1;
+	}
+	batches.m_batchStarts[MAX_LINK_BATCHES+1] = start;
+	int offsets[MAX_LINK_BATCHES+1];
+	for (i=0;i<=MAX_LINK_BATCHES;i++)
+		offsets[i] = batches.m_batchStarts[i];
+	m_sortedLinks.resize(numLinks);
+	for (i=0;i<numLinks;i++)
+		m_sortedLinks[offsets[m_linkBatchIndices[i]]++] = psb->m_links[i];
+	for (i=0;i<numLinks;i++)
+		psb->m_links[i] = m_sortedLinks[i];
+
+	batches.m_links = links;
+	batches.m_nodes = nodes;
+	batches.m_numLinks = numLinks;
+	batches.m_numNodes = numNodes;
+}
+
+const btDefaultSoftBodySolverMt::btSoftBodyLinkBatches*	btDefaultSoftBodySolverMt::getLinkBatches(const btSoftBody* psb) const
+{
+	for (int i=0;i<m_softBodySet.size();i++)
+	{
+		if (m_softBodySet[i]==psb)
+			return m_linkBatches[i].m_numLinks>=0 ? &m_linkBatches[i] : 0;
+	}
+	return 0;
+}
+
+void btDefaultSoftBodySolverMt::predictMotion( float timeStep )
+{
+	m_parallelBodies.resize(0);
+	m_broadphaseHandles.resize(0);
+	for (int i=0;i<m_softBodySet.size();i++)
+	{
+		btSoftBody* psb = m_softBodySet[i];
+		if (psb->isActive())
+		{
+			//the broadphase is not thread safe, so the soft bodies update their AABB in the broadphase afterwards
+			m_parallelBodies.push_back(psb);
+			m_broadphaseHandles.push_back(psb->getBroadphaseHandle());
+			psb->setBroadphaseHandle(0);
+		}
+	}
+	if (!m_parallelBodies.size())
+		return;
+
+	btSoftBodyPredictMotionLoop loop;
+	loop.m_softBodies = &m_parallelBodies[0];
+	loop.m_timeStep = timeStep;
+	btParallelFor(0,m_parallelBodies.size(),1,loop);
+
+	for (int i=0;i<m_parallelBodies.size();i++)
+	{
+		btSoftBody* psb = m_parallelBodies[i];
+		btBroadphaseProxy* handle = m_broadphaseHandles[i];
+		psb->setBroadphaseHandle(handle);
+		if (handle && psb->m_ndbvt.m_root)
+		{
+			psb->m_worldInfo->m_broadphase->setAabb(handle,psb->m_bounds[0],psb->m_bounds[1],psb->m_worldInfo->m_dispatcher);
+		}
+	}
+}
+
+void btDefaultSoftBodySolverMt::solveConstraints( float solverdt )
+{
+	m_parallelBodies.resize(0);
+	m_sequentialBodies.resize(0);
+	for (int i=0;i<m_softBodySet.size();i++)
+	{
+		btSoftBody* psb = m_softBodySet[i];
+		if (!psb->isActive())
+			continue;
+		if (psb->m_links.size()>=m_minLinksForBatching)
+		{
+			//large soft bodies are solved one at a time, their link batches in parallel
+			updateLinkBatches(psb,m_linkBatches[i]);
+			m_sequentialBodies.push_back(i);
+		} else if (isIndependent(psb))
+		{
+			m_parallelBodies.push_back(psb);
+		} else
+		{
+			m_sequentialBodies.push_back(i);
+		}
+	}
+
+	if (m_parallelBodies.size())
+	{
+		btSoftBodySolveConstraintsLoop loop;
+		loop.m_softBodies = &m_parallelBodies[0];
+		btParallelFor(0,m_parallelBodies.size(),1,loop);
+	}
+
+	for (int i=0;i<m_sequentialBodies.size();i++)
+	{
+		int index = m_sequentialBodies[i];
+		btSoftBody* psb = m_softBodySet[index];
+		if (psb->m_links.size()>=m_minLinksForBatching)
+		{
+			btSoftBodyLinkBatchSolver linkSolver;
+			linkSolver.m_batches = &m_linkBatches[index];
+			linkSolver.m_grainSize = m_linkGrainSize;
+			psb->solveConstraints(&linkSolver);
+		} else
+		{
+			psb->solveConstraints();
+		}
+	}
+}
+
+void btDefaultSoftBodySolverMt::updateSoftBodies( )
+{
+	m_parallelBodies.resize(0);
+	for (int i=0;i<m_softBodySet.size();i++)
+	{
+		if (m_softBodySet[i]->isActive())
+			m_parallelBodies.push_back(m_softBodySet[i]);
+	}
+	if (m_parallelBodies.size())
+	{
+		btSoftBodyIntegrateMotionLoop loop;
+		loop.m_softBodies = &m_parallelBodies[0];
+		btParallelFor(0,m_parallelBodies.size(),1,loop);
+	}
+}
@@ -0,0 +1,109 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_SOFT_BODY_DEFAULT_SOLVER_MT_H
+#define BT_SOFT_BODY_DEFAULT_SOLVER_MT_H
+
+#include "btDefaultSoftBodySolver.h"
+#include "btSoftBody.h"
+
+///btDefaultSoftBodySolverMt is a CPU soft body solver that uses btParallelFor.
+///predictMotion and updateSoftBodies process the active soft bodies in parallel, the broadphase AABBs are updated afterwards, in order.
+///solveConstraints solves the soft bodies that only touch static or kinematic objects in parallel. The soft bodies with anchors,
+///soft-soft contacts or contacts with dynamic rigid bodies are solved afterwards, one at a time.
+///The links of a soft body with at least getMinLinksForBatching() links are sorted into batches of links that don't share a node
+///(a greedy graph colouring, like the OpenCL and DX11 solvers do), the links of each batch are solved with btParallelFor.
+///The sort changes the order of btSoftBody::m_links, so the results of such a soft body differ from btDefaultSoftBodySolver,
+///but they don't depend on the number of threads. Call optimize with forceUpdate after changing the links of a soft body in place.
+class btDefaultSoftBodySolverMt : public btDefaultSoftBodySolver
+{
+public:
+	enum
+	{
+		MAX_LINK_BATCHES = 32	///< links that don't fit in one of the batches go to a last batch, which is solved sequentially
+	};
+
+	struct	btSoftBodyLinkBatches
+	{
+		const btSoftBody::Link*	m_links;	///< the link and node arrays the batches were made for, to detect changes
+		const btSoftBody::Node*	m_nodes;
+		int		m_numLinks;
+		int		m_numNodes;
+		int		m_numBatches;
+		int		m_batchStarts[MAX_LINK_BATCHES+2];
+	};
+
+protected:
+	btAlignedObjectArray<btSoftBodyLinkBatches>	m_linkBatches;	///< one per soft body of m_softBodySet
+	btAlignedObjectArray<btSoftBody*>			m_parallelBodies;
+	btAlignedObjectArray<int>					m_sequentialBodies;
+	btAlignedObjectArray<btBroadphaseProxy*>	m_broadphaseHandles;
+	btAlignedObjectArray<unsigned int>			m_nodeBatchMasks;
+	btAlignedObjectArray<int>					m_linkBatchIndices;
+	btAlignedObjectArray<btSoftBody::Link>		m_sortedLinks;
+	int		m_minLinksForBatching;
+	int		m_linkGrainSize;
+
+	///true when solving the soft body doesn't write to other soft bodies or to rigid bodies
+	static bool	isIndependent(const btSoftBody* psb);
+
+	///sort the links of the soft body into batches, unless the batches are still valid
+	void	updateLinkBatches(btSoftBody* psb, btSoftBodyLinkBatches& batches);
+
+public:
+	btDefaultSoftBodySolverMt();
+
+	virtual ~btDefaultSoftBodySolverMt();
+
+	virtual SolverTypes getSolverType() const
+	{
+		return CPU_SOLVER;
+	}
+
+	virtual void optimize( btAlignedObjectArray< btSoftBody * > &softBodies,bool forceUpdate=false );
+
+	virtual void updateSoftBodies( );
+
+	virtual void solveConstraints( float solverdt );
+
+	virtual void predictMotion( float solverdt );
+
+	///soft bodies with fewer links are solved by a single thread
+	void	setMinLinksForBatching(int minLinks)
+	{
+		m_minLinksForBatching = minLinks;
+	}
+
+	int		getMinLinksForBatching() const
+	{
+		return m_minLinksForBatching;
+	}
+
+	///the number of links of a batch that are solved by one task
+	void	setLinkGrainSize(int grainSize)
+	{
+		m_linkGrainSize = grainSize;
+	}
+
+	int		getLinkGrainSize() const
+	{
+		return m_linkGrainSize;
+	}
+
+	///the batches of the soft body, 0 when its links are not batched (yet)
+	const btSoftBodyLinkBatches*	getLinkBatches(const btSoftBody* psb) const;
+};
+
+#endif //BT_SOFT_BODY_DEFAULT_SOLVER_MT_H
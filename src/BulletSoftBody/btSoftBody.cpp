@@ -1829,6 +1829,12 @@ void			btSoftBody::predictMotion(btScalar dt)
 
 //
 void			btSoftBody::solveConstraints()
+{
+	solveConstraints(0);
+}
+
+//
+void			btSoftBody::solveConstraints(ILinkSolver* linkSolver)
 {
 
 	/* Apply clusters		*/ 
@@ -1865,7 +1871,10 @@ void			btSoftBody::solveConstraints()
 		{
 			for(int iseq=0;iseq<m_cfg.m_vsequence.size();++iseq)
 			{
-				getSolver(m_cfg.m_vsequence[iseq])(this,1);
+				if(linkSolver&&(m_cfg.m_vsequence[iseq]==eVSolver::Linear))
+					linkSolver->solveLinkVelocities(this,1);
+				else
+					getSolver(m_cfg.m_vsequence[iseq])(this,1);
 			}
 		}
 		/* Update			*/ 
@@ -1883,7 +1892,10 @@ void			btSoftBody::solveConstraints()
 			const btScalar ti=isolve/(btScalar)m_cfg.piterations;
 			for(int iseq=0;iseq<m_cfg.m_psequence.size();++iseq)
 			{
-				getSolver(m_cfg.m_psequence[iseq])(this,1,ti);
+				if(linkSolver&&(m_cfg.m_psequence[iseq]==ePSolver::Linear))
+					linkSolver->solveLinkPositions(this,1);
+				else
+					getSolver(m_cfg.m_psequence[iseq])(this,1,ti);
 			}
 		}
 		const btScalar	vc=m_sst.isdt*(1-m_cfg.kDP);
@@ -1907,7 +1919,10 @@ void			btSoftBody::solveConstraints()
 		{
 			for(int iseq=0;iseq<m_cfg.m_dsequence.size();++iseq)
 			{
-				getSolver(m_cfg.m_dsequence[iseq])(this,1,0);
+				if(linkSolver&&(m_cfg.m_dsequence[iseq]==ePSolver::Linear))
+					linkSolver->solveLinkPositions(this,1);
+				else
+					getSolver(m_cfg.m_dsequence[iseq])(this,1,0);
 			}
 		}
 		for(int i=0,ni=m_nodes.size();i<ni;++i)
@@ -3066,7 +3081,13 @@ void				btSoftBody::PSolve_SContacts(btSoftBody* psb,btScalar,btScalar ti)
 //
 void				btSoftBody::PSolve_Links(btSoftBody* psb,btScalar kst,btScalar ti)
 {
-	for(int i=0,ni=psb->m_links.size();i<ni;++i)
+	PSolve_LinkRange(psb,kst,0,psb->m_links.size());
+}
+
+//
+void				btSoftBody::PSolve_LinkRange(btSoftBody* psb,btScalar kst,int begin,int end)
+{
+	for(int i=begin;i<end;++i)
 	{			
 		Link&	l=psb->m_links[i];
 		if(l.m_c0>0)
@@ -3088,7 +3109,13 @@ void				btSoftBody::PSolve_Links(btSoftBody* psb,btScalar kst,btScalar ti)
 //
 void				btSoftBody::VSolve_Links(btSoftBody* psb,btScalar kst)
 {
-	for(int i=0,ni=psb->m_links.size();i<ni;++i)
+	VSolve_LinkRange(psb,kst,0,psb->m_links.size());
+}
+
+//
+void				btSoftBody::VSolve_LinkRange(btSoftBody* psb,btScalar kst,int begin,int end)
+{
+	for(int i=begin;i<end;++i)
 	{			
 		Link&			l=psb->m_links[i];
 		Node**			n=l.m_n;
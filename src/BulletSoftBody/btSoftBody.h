@@ -172,6 +172,16 @@ public:
 		virtual btScalar	Eval(const btVector3& x)=0;
 	};
 
+	/* ILinkSolver	*/ 
+	///replaces the link solvers (ePSolver::Linear, eVSolver::Linear) in solveConstraints,
+	///so that a soft body solver can process batches of links that don't share nodes in parallel
+	struct	ILinkSolver
+	{
+		virtual ~ILinkSolver() {}
+		virtual void		solveLinkPositions(btSoftBody* psb,btScalar kst)=0;
+		virtual void		solveLinkVelocities(btSoftBody* psb,btScalar kst)=0;
+	};
+
 	//
 	// Internal types
 	//
@@ -867,6 +877,7 @@ public:
 	void				predictMotion(btScalar dt);
 	/* solveConstraints														*/ 
 	void				solveConstraints();
+	void				solveConstraints(ILinkSolver* linkSolver);
 	/* staticSolve															*/ 
 	void				staticSolve(int iterations);
 	/* solveCommonConstraints												*/ 
@@ -978,6 +989,8 @@ public:
 	static void			PSolve_SContacts(btSoftBody* psb,btScalar,btScalar ti);
 	static void			PSolve_Links(btSoftBody* psb,btScalar kst,btScalar ti);
 	static void			VSolve_Links(btSoftBody* psb,btScalar kst);
+	static void			PSolve_LinkRange(btSoftBody* psb,btScalar kst,int begin,int end);
+	static void			VSolve_LinkRange(btSoftBody* psb,btScalar kst,int begin,int end);
 	static psolver_t	getSolver(ePSolver::_ solver);
 	static vsolver_t	getSolver(eVSolver::_ solver);
 
@@ -280,6 +280,19 @@ void	btSoftRigidDynamicsWorld::rayTest(const btVector3& rayFromWorld, const btVe
 }
 
 
+void	btSoftRigidDynamicsWorld::rayTestBatch(const btVector3* rayFromWorld, const btVector3* rayToWorld, int numRays, RayTestBatchResult* results,
+									  short int collisionFilterGroup, short int collisionFilterMask) const
+{
+	//btSoftBody::rayTest builds the face tree on first use, build it here before the rays are tested from several threads
+	for (int i=0;i<m_softBodies.size();i++)
+	{
+		btSoftBody* psb = m_softBodies[i];
+		if (psb->m_faces.size() && psb->m_fdbvt.empty())
+			psb->initializeFaceTree();
+	}
+	rayTestBatchInternal(rayFromWorld,rayToWorld,numRays,results,collisionFilterGroup,collisionFilterMask,&btSoftRigidDynamicsWorld::rayTestSingle);
+}
+
 void	btSoftRigidDynamicsWorld::rayTestSingle(const btTransform& rayFromTrans,const btTransform& rayToTrans,
 					  btCollisionObject* collisionObject,
 					  const btCollisionShape* collisionShape,
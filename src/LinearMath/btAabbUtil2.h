@@ -177,6 +177,88 @@ SIMD_FORCE_INLINE bool btRayAabb(const btVector3& rayFrom,
 	return false;
 }
 
+#define BT_RAY_PACKET_SIZE 4
+
+///btRayPacket holds up to BT_RAY_PACKET_SIZE ray segments in SoA layout, so that btRayPacketAabb tests all of them against an AABB at once.
+///The hit fractions are relative to the segment from rayFrom to rayTo, m_lambdaMax is the hit fraction limit of each ray (the closest hit so far).
+ATTRIBUTE_ALIGNED16(struct) btRayPacket
+{
+	btScalar	m_rayFrom[3][BT_RAY_PACKET_SIZE];
+	btScalar	m_rayDirectionInverse[3][BT_RAY_PACKET_SIZE];
+	btScalar	m_lambdaMax[BT_RAY_PACKET_SIZE];
+	///bit i is set when ray i is used
+	unsigned int	m_rayMask;
+
+	btRayPacket()
+	{
+		clear();
+	}
+
+	void	clear()
+	{
+		for (int i=0;i<BT_RAY_PACKET_SIZE;i++)
+		{
+			for (int j=0;j<3;j++)
+			{
+				m_rayFrom[j][i] = btScalar(0.);
+				m_rayDirectionInverse[j][i] = btScalar(1.);
+			}
+			//unused rays don't hit anything
+			m_lambdaMax[i] = btScalar(-1.);
+		}
+		m_rayMask = 0;
+	}
+
+	void	setRay(int i, const btVector3& rayFrom, const btVector3& rayTo, btScalar lambdaMax = btScalar(1.))
+	{
+		btVector3 rayDirection = rayTo-rayFrom;
+		for (int j=0;j<3;j++)
+		{
+			m_rayFrom[j][i] = rayFrom[j];
+			//like btDbvt::rayTest, use BT_LARGE_FLOAT instead of dividing by zero
+			m_rayDirectionInverse[j][i] = rayDirection[j] == btScalar(0.0) ? btScalar(BT_LARGE_FLOAT) : btScalar(1.0) / rayDirection[j];
+		}
+		m_lambdaMax[i] = lambdaMax;
+		m_rayMask |= 1u<<i;
+	}
+};
+
+///returns the mask of the rays of the packet that intersect the AABB at a hit fraction between 0 and their m_lambdaMax
+SIMD_FORCE_INLINE unsigned int btRayPacketAabb(const btRayPacket& packet, const btVector3& aabbMin, const btVector3& aabbMax)
+{
+#if defined (BT_USE_SSE) && !defined (BT_USE_DOUBLE_PRECISION) && (BT_RAY_PACKET_SIZE == 4)
+	__m128 tmin = _mm_setzero_ps();
+	__m128 tmax = _mm_load_ps(packet.m_lambdaMax);
+	for (int j=0;j<3;j++)
+	{
+		__m128 from = _mm_load_ps(packet.m_rayFrom[j]);
+		__m128 invDir = _mm_load_ps(packet.m_rayDirectionInverse[j]);
+		__m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(aabbMin[j]),from),invDir);
+		__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(aabbMax[j]),from),invDir);
+		tmin = _mm_max_ps(tmin,_mm_min_ps(t0,t1));
+		tmax = _mm_min_ps(tmax,_mm_max_ps(t0,t1));
+	}
+	return (unsigned int)_mm_movemask_ps(_mm_cmple_ps(tmin,tmax)) & packet.m_rayMask;
+#else
+	unsigned int mask = 0;
+	for (int i=0;i<BT_RAY_PACKET_SIZE;i++)
+	{
+		btScalar tmin = btScalar(0.);
+		btScalar tmax = packet.m_lambdaMax[i];
+		for (int j=0;j<3;j++)
+		{
+			btScalar t0 = (aabbMin[j]-packet.m_rayFrom[j][i])*packet.m_rayDirectionInverse[j][i];
+			btScalar t1 = (aabbMax[j]-packet.m_rayFrom[j][i])*packet.m_rayDirectionInverse[j][i];
+			tmin = btMax(tmin,btMin(t0,t1));
+			tmax = btMin(tmax,btMax(t0,t1));
+		}
+		if (tmin <= tmax)
+			mask |= 1u<<i;
+	}
+	return mask & packet.m_rayMask;
+#endif
+}
+
 
 
 SIMD_FORCE_INLINE	void btTransformAabb(const btVector3& halfExtents, btScalar margin,const btTransform& t,btVector3& aabbMinOut,btVector3& aabbMaxOut)
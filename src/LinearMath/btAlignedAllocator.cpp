@@ -14,6 +14,7 @@ subject to the following restrictions:
 */
 
 #include "btAlignedAllocator.h"
+#include "btThreads.h"
 
 int gNumAlignedAllocs = 0;
 int gNumAlignedFree = 0;
@@ -158,7 +159,11 @@ void    btAlignedFreeInternal   (void* ptr,int line,char* filename)
 
 void*	btAlignedAllocInternal	(size_t size, int alignment)
 {
+#if BT_THREADSAFE
+	btAtomicFetchAdd(&gNumAlignedAllocs, 1);
+#else
 	gNumAlignedAllocs++;
+#endif
 	void* ptr;
 	ptr = sAlignedAllocFunc(size, alignment);
 //	printf("btAlignedAllocInternal %d, %x\n",size,ptr);
@@ -172,7 +177,11 @@ void	btAlignedFreeInternal	(void* ptr)
 		return;
 	}
 
+#if BT_THREADSAFE
+	btAtomicFetchAdd(&gNumAlignedFree, 1);
+#else
 	gNumAlignedFree++;
+#endif
 //	printf("btAlignedFreeInternal %x\n",ptr);
 	sAlignedFreeFunc(ptr);
 }
@@ -0,0 +1,143 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btMappedFile.h"
+
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+#else //_WIN32
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#endif //_WIN32
+
+btMappedFile::btMappedFile()
+:m_data(0),
+m_size(0),
+m_mode(MAP_READ_ONLY)
+#ifdef _WIN32
+,m_fileHandle(0),
+m_mappingHandle(0)
+#endif //_WIN32
+{
+}
+
+btMappedFile::~btMappedFile()
+{
+	close();
+}
+
+#ifdef _WIN32
+
+bool	btMappedFile::open(const char* fileName, btMapMode mode)
+{
+	close();
+
+	HANDLE file = CreateFileA(fileName,GENERIC_READ,FILE_SHARE_READ,0,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,0);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file,&fileSize) || fileSize.QuadPart == 0 || fileSize.HighPart != 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file,0,mode == MAP_COPY_ON_WRITE ? PAGE_WRITECOPY : PAGE_READONLY,0,0,0);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	void* data = MapViewOfFile(mapping,mode == MAP_COPY_ON_WRITE ? FILE_MAP_COPY : FILE_MAP_READ,0,0,0);
+	if (!data)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	m_fileHandle = file;
+	m_mappingHandle = mapping;
+	m_data = data;
+	m_size = fileSize.LowPart;
+	m_mode = mode;
+	return true;
+}
+
+void	btMappedFile::close()
+{
+	if (m_data)
+	{
+		UnmapViewOfFile(m_data);
+		CloseHandle((HANDLE)m_mappingHandle);
+		CloseHandle((HANDLE)m_fileHandle);
+		m_data = 0;
+		m_size = 0;
+		m_fileHandle = 0;
+		m_mappingHandle = 0;
+	}
+}
+
+#else //_WIN32
+
+bool	btMappedFile::open(const char* fileName, btMapMode mode)
+{
+	close();
+
+	int fd = ::open(fileName,O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat fileStat;
+	if (fstat(fd,&fileStat) != 0 || fileStat.st_size <= 0 || (unsigned long long)fileStat.st_size > 0xffffffffull)
+	{
+		::close(fd);
+		return false;
+	}
+
+	int protection = mode == MAP_COPY_ON_WRITE ? (PROT_READ | PROT_WRITE) : PROT_READ;
+	void* data = mmap(0,(size_t)fileStat.st_size,protection,MAP_PRIVATE,fd,0);
+	//the mapping stays valid after the file descriptor is closed
+	::close(fd);
+	if (data == MAP_FAILED)
+		return false;
+
+	m_data = data;
+	m_size = (unsigned int)fileStat.st_size;
+	m_mode = mode;
+	return true;
+}
+
+void	btMappedFile::close()
+{
+	if (m_data)
+	{
+		munmap(m_data,m_size);
+		m_data = 0;
+		m_size = 0;
+	}
+}
+
+#endif //_WIN32
@@ -0,0 +1,81 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_MAPPED_FILE_H
+#define BT_MAPPED_FILE_H
+
+#include "btScalar.h"
+
+///btMappedFile maps a whole file into memory (mmap on POSIX, a file mapping object on Windows).
+///The pages are loaded on demand and are shared through the page cache with all the other processes that map the same file.
+///The mapping starts at a page boundary, so it is suitably aligned for data written with serializeInPlace.
+///The file must not be truncated or rewritten while it is mapped, the pages that were not copied would change or become invalid.
+class btMappedFile
+{
+public:
+
+	enum btMapMode
+	{
+		MAP_READ_ONLY=0,
+		///writes go to private copies of the touched pages, they are never written back to the file
+		MAP_COPY_ON_WRITE
+	};
+
+private:
+
+	void*			m_data;
+	unsigned int	m_size;
+	btMapMode		m_mode;
+#ifdef _WIN32
+	void*			m_fileHandle;
+	void*			m_mappingHandle;
+#endif //_WIN32
+
+	btMappedFile(const btMappedFile&);
+	btMappedFile& operator=(const btMappedFile&);
+
+public:
+
+	btMappedFile();
+
+	virtual ~btMappedFile();
+
+	///returns false if the file can't be opened or is empty
+	bool	open(const char* fileName, btMapMode mode = MAP_READ_ONLY);
+
+	void	close();
+
+	bool	isOpen() const
+	{
+		return m_data != 0;
+	}
+
+	void*	getData() const
+	{
+		return m_data;
+	}
+
+	unsigned int	getSize() const
+	{
+		return m_size;
+	}
+
+	btMapMode	getMode() const
+	{
+		return m_mode;
+	}
+};
+
+#endif //BT_MAPPED_FILE_H
@@ -18,8 +18,10 @@ subject to the following restrictions:
 
 #include "btScalar.h"
 #include "btAlignedAllocator.h"
+#include "btThreads.h"
 
 ///The btPoolAllocator class allows to efficiently allocate a large pool of objects, instead of dynamically allocating them separately.
+///In a BT_THREADSAFE build allocate and freeMemory can be called from several threads, they are serialized by a spin-mutex.
 class btPoolAllocator
 {
 	int				m_elemSize;
@@ -27,6 +29,7 @@ class btPoolAllocator
 	int				m_freeCount;
 	void*			m_firstFree;
 	unsigned char*	m_pool;
+	mutable btSpinMutex	m_mutex;
 
 public:
 
@@ -54,7 +57,10 @@ public:
 
 	int	getFreeCount() const
 	{
-		return m_freeCount;
+		btMutexLock(&m_mutex);
+		int freeCount = m_freeCount;
+		btMutexUnlock(&m_mutex);
+		return freeCount;
 	}
 
 	int getUsedCount() const
@@ -72,10 +78,12 @@ public:
 		// release mode fix
 		(void)size;
 		btAssert(!size || size<=m_elemSize);
+		btMutexLock(&m_mutex);
 		btAssert(m_freeCount>0);
         void* result = m_firstFree;
         m_firstFree = *(void**)m_firstFree;
         --m_freeCount;
+		btMutexUnlock(&m_mutex);
         return result;
 	}
 
@@ -95,9 +103,11 @@ public:
 		 if (ptr) {
             btAssert((unsigned char*)ptr >= m_pool && (unsigned char*)ptr < m_pool + m_maxElements * m_elemSize);
 
+			btMutexLock(&m_mutex);
             *(void**)ptr = m_firstFree;
             m_firstFree = ptr;
             ++m_freeCount;
+			btMutexUnlock(&m_mutex);
         }
 	}
 
@@ -14,6 +14,7 @@
 // Ogre (www.ogre3d.org).
 
 #include "btQuickprof.h"
+#include "btThreads.h"
 
 #ifndef BT_NO_PROFILE
 
@@ -50,8 +51,13 @@ static btClock gProfileClock;
 
 #else //_WIN32
 #include <sys/time.h>
+#include <time.h>
 #endif //_WIN32
 
+#ifdef __APPLE__
+#include <mach/mach_time.h>
+#endif
+
 #define mymin(a,b) (a > b ? a : b)
 
 struct btClockData
@@ -425,6 +431,35 @@ void	CProfileIterator::Enter_Parent( void )
 CProfileNode	CProfileManager::Root( "Root", NULL );
 CProfileNode *	CProfileManager::CurrentNode = &CProfileManager::Root;
 int				CProfileManager::FrameCounter = 0;
+bool			CProfileManager::Enabled = true;
+bool			CProfileSample::s_enabled = true;
+
+static void	btUpdateProfileSampleEnabled()
+{
+	CProfileSample::s_enabled = CProfileManager::Is_Enabled() || btProfileTimeline::isEnabled();
+}
+
+void	CProfileSample::begin( const char * name )
+{
+	if (btProfileTimeline::isEnabled())
+		btProfileTimeline::recordEvent( name, btProfileTimeline::BT_PROFILE_EVENT_BEGIN );
+	if (CProfileManager::Is_Enabled())
+		CProfileManager::Start_Profile( name );
+}
+
+void	CProfileSample::end( const char * name )
+{
+	if (CProfileManager::Is_Enabled())
+		CProfileManager::Stop_Profile();
+	if (btProfileTimeline::isEnabled())
+		btProfileTimeline::recordEvent( name, btProfileTimeline::BT_PROFILE_EVENT_END );
+}
+
+void	CProfileManager::Set_Enabled( bool enabled )
+{
+	Enabled = enabled;
+	btUpdateProfileSampleEnabled();
+}
 unsigned long int			CProfileManager::ResetTime = 0;
 
 
@@ -443,6 +478,10 @@ unsigned long int			CProfileManager::ResetTime = 0;
  *=============================================================================================*/
 void	CProfileManager::Start_Profile( const char * name )
 {
+	//the profile tree is not thread safe, samples taken on worker threads are dropped
+	if (!btIsMainThread())
+		return;
+
 	if (name != CurrentNode->Get_Name()) {
 		CurrentNode = CurrentNode->Get_Sub_Node( name );
 	} 
@@ -456,6 +495,9 @@ void	CProfileManager::Start_Profile( const char * name )
  *=============================================================================================*/
 void	CProfileManager::Stop_Profile( void )
 {
+	if (!btIsMainThread())
+		return;
+
 	// Return will indicate whether we should back up to our parent (we may
 	// be profiling a recursive function)
 	if (CurrentNode->Return()) {
@@ -485,6 +527,8 @@ void	CProfileManager::Reset( void )
 void CProfileManager::Increment_Frame_Counter( void )
 {
 	FrameCounter++;
+	if (btProfileTimeline::isEnabled())
+		btProfileTimeline::recordEvent( "Frame", btProfileTimeline::BT_PROFILE_EVENT_FRAME );
 }
 
 
@@ -562,5 +606,213 @@ void	CProfileManager::dumpAll()
 
 
 
+/***************************************************************************************************
+**
+** btProfileTimeline
+**
+***************************************************************************************************/
+
+unsigned long long int	btGetProfileTicks()
+{
+#ifdef BT_USE_WINDOWS_TIMERS
+	LARGE_INTEGER ticks;
+	QueryPerformanceCounter(&ticks);
+	return (unsigned long long int)ticks.QuadPart;
+#elif defined (__APPLE__)
+	return mach_absolute_time();
+#elif defined (__CELLOS_LV2__)
+	uint64_t ticks;
+	SYS_TIMEBASE_GET( ticks );
+	return ticks;
+#elif defined (CLOCK_MONOTONIC)
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long int)ts.tv_sec*1000000000ull + (unsigned long long int)ts.tv_nsec;
+#else
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return (unsigned long long int)tv.tv_sec*1000000ull + (unsigned long long int)tv.tv_usec;
+#endif
+}
+
+unsigned long long int	btGetProfileTickFrequency()
+{
+#ifdef BT_USE_WINDOWS_TIMERS
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	return (unsigned long long int)frequency.QuadPart;
+#elif defined (__APPLE__)
+	mach_timebase_info_data_t timebase;
+	mach_timebase_info(&timebase);
+	return 1000000000ull*timebase.denom/timebase.numer;
+#elif defined (__CELLOS_LV2__)
+	return sys_time_get_timebase_frequency();
+#elif defined (CLOCK_MONOTONIC)
+	return 1000000000ull;
+#else
+	return 1000000ull;
+#endif
+}
+
+///the ring buffer of one thread, it is only written by its own thread
+struct	btProfileThreadBuffer
+{
+	btProfileEvent*			m_events;
+	unsigned int			m_mask;		///< capacity-1, the capacity is a power of two
+	unsigned int			m_numWritten;
+};
+
+static btProfileThreadBuffer	gProfileThreadBuffers[BT_MAX_THREAD_COUNT];
+static unsigned int				gProfileBufferCapacity = 0;
+bool	btProfileTimeline::s_enabled = false;
+
+void	btProfileTimeline::enable(int eventsPerThread)
+{
+	unsigned int capacity = 1;
+	while (capacity < (unsigned int)eventsPerThread)
+		capacity <<= 1;
+	if (capacity != gProfileBufferCapacity)
+	{
+		releaseMemory();
+		gProfileBufferCapacity = capacity;
+	}
+	s_enabled = true;
+	btUpdateProfileSampleEnabled();
+}
+
+void	btProfileTimeline::disable()
+{
+	s_enabled = false;
+	btUpdateProfileSampleEnabled();
+}
+
+void	btProfileTimeline::clear()
+{
+	for (int i=0;i<BT_MAX_THREAD_COUNT;i++)
+	{
+		gProfileThreadBuffers[i].m_numWritten = 0;
+	}
+}
+
+void	btProfileTimeline::releaseMemory()
+{
+	disable();
+	for (int i=0;i<BT_MAX_THREAD_COUNT;i++)
+	{
+		btProfileThreadBuffer& buffer = gProfileThreadBuffers[i];
+		if (buffer.m_events)
+		{
+			btAlignedFree(buffer.m_events);
+			buffer.m_events = 0;
+		}
+		buffer.m_mask = 0;
+		buffer.m_numWritten = 0;
+	}
+	gProfileBufferCapacity = 0;
+}
+
+void	btProfileTimeline::recordEvent(const char* name, int type)
+{
+	btProfileThreadBuffer& buffer = gProfileThreadBuffers[btGetCurrentThreadIndex()];
+	if (!buffer.m_events)
+	{
+		//allocated on first use, so threads that never profile anything don't cost memory
+		buffer.m_events = (btProfileEvent*)btAlignedAlloc(sizeof(btProfileEvent)*gProfileBufferCapacity, 16);
+		buffer.m_mask = gProfileBufferCapacity-1;
+		buffer.m_numWritten = 0;
+	}
+	btProfileEvent& ev = buffer.m_events[buffer.m_numWritten & buffer.m_mask];
+	ev.m_name = name;
+	ev.m_type = type;
+	ev.m_ticks = btGetProfileTicks();
+	buffer.m_numWritten++;
+}
+
+int		btProfileTimeline::getNumEvents(int threadIndex)
+{
+	const btProfileThreadBuffer& buffer = gProfileThreadBuffers[threadIndex];
+	if (!buffer.m_events)
+		return 0;
+	return buffer.m_numWritten > buffer.m_mask ? int(buffer.m_mask+1) : int(buffer.m_numWritten);
+}
+
+const btProfileEvent&	btProfileTimeline::getEvent(int threadIndex, int eventIndex)
+{
+	const btProfileThreadBuffer& buffer = gProfileThreadBuffers[threadIndex];
+	btAssert(eventIndex>=0 && eventIndex<getNumEvents(threadIndex));
+	unsigned int first = buffer.m_numWritten - (unsigned int)getNumEvents(threadIndex);
+	return buffer.m_events[(first + (unsigned int)eventIndex) & buffer.m_mask];
+}
+
+static void	writeJsonString(FILE* file, const char* str)
+{
+	fputc('"', file);
+	for (;*str;str++)
+	{
+		if (*str=='"' || *str=='\\')
+			fputc('\\', file);
+		if ((unsigned char)*str >= 0x20)
+			fputc(*str, file);
+	}
+	fputc('"', file);
+}
+
+bool	btProfileTimeline::writeChromeTrace(const char* fileName)
+{
+	FILE* file = fopen(fileName, "w");
+	if (!file)
+		return false;
+
+	//timestamps are written in microseconds, relative to the oldest recorded event
+	unsigned long long int startTicks = 0;
+	bool hasEvents = false;
+	int t;
+	for (t=0;t<BT_MAX_THREAD_COUNT;t++)
+	{
+		if (getNumEvents(t) && (!hasEvents || getEvent(t,0).m_ticks < startTicks))
+		{
+			startTicks = getEvent(t,0).m_ticks;
+			hasEvents = true;
+		}
+	}
+	double ticksToMicroseconds = 1000000.0/double(btGetProfileTickFrequency());
+
+	fprintf(file, "{\"traceEvents\":[");
+	bool first = true;
+	for (t=0;t<BT_MAX_THREAD_COUNT;t++)
+	{
+		int numEvents = getNumEvents(t);
+		//the oldest begin events may have been overwritten, skip the end events that have no begin
+		int depth = 0;
+		for (int i=0;i<numEvents;i++)
+		{
+			const btProfileEvent& ev = getEvent(t,i);
+			const char* phase = "B";
+			if (ev.m_type == BT_PROFILE_EVENT_END)
+			{
+				if (depth == 0)
+					continue;
+				depth--;
+				phase = "E";
+			} else if (ev.m_type == BT_PROFILE_EVENT_FRAME)
+			{
+				phase = "i";
+			} else
+			{
+				depth++;
+			}
+			fprintf(file, "%s\n{\"name\":", first ? "" : ",");
+			writeJsonString(file, ev.m_name);
+			fprintf(file, ",\"ph\":\"%s\",\"pid\":0,\"tid\":%d,\"ts\":%.3f%s}", phase, t,
+				double(ev.m_ticks-startTicks)*ticksToMicroseconds,
+				ev.m_type == BT_PROFILE_EVENT_FRAME ? ",\"s\":\"g\"" : "");
+			first = false;
+		}
+	}
+	fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+	bool ok = (ferror(file) == 0);
+	fclose(file);
+	return ok;
+}
 
 #endif //BT_NO_PROFILE
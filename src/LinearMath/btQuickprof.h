@@ -143,6 +143,11 @@ public:
 	static	void						Start_Profile( const char * name );
 	static	void						Stop_Profile( void );
 
+	///the profile tree records the BT_PROFILE scopes of the main thread, it is enabled by default.
+	///Only switch it outside of any BT_PROFILE scope (for example in between two stepSimulation calls).
+	static	void						Set_Enabled( bool enabled );
+	static	bool						Is_Enabled( void )		{ return Enabled; }
+
 	static	void						CleanupMemory(void)
 	{
 		Root.CleanupMemory();
@@ -169,21 +174,88 @@ private:
 	static	CProfileNode *			CurrentNode;
 	static	int						FrameCounter;
 	static	unsigned long int					ResetTime;
+	static	bool					Enabled;
+};
+
+
+///btGetProfileTicks reads a cheap monotonic counter (QueryPerformanceCounter, mach_absolute_time or clock_gettime),
+///btGetProfileTickFrequency returns the number of ticks per second
+unsigned long long int	btGetProfileTicks();
+unsigned long long int	btGetProfileTickFrequency();
+
+///btProfileEvent is an entry in the per-thread event buffers of btProfileTimeline
+struct	btProfileEvent
+{
+	const char*				m_name;
+	unsigned long long int	m_ticks;
+	int						m_type;
 };
 
+///btProfileTimeline records the begin and end of every BT_PROFILE scope, on all threads, into a ring buffer per thread.
+///Unlike the CProfileManager tree, which only sees the main thread, it shows how the work of the worker threads overlaps.
+///Recording is off by default. With the CProfileManager tree disabled as well, a BT_PROFILE scope only tests a flag when it starts and when it ends.
+///Only call enable, disable, clear and the accessors while no btParallelFor is running (for example in between two stepSimulation calls).
+///The buffers are indexed with btGetCurrentThreadIndex, so threads that are not created by the task scheduler get a buffer of their own.
+class	btProfileTimeline {
+public:
+	enum btProfileEventType
+	{
+		BT_PROFILE_EVENT_BEGIN,
+		BT_PROFILE_EVENT_END,
+		BT_PROFILE_EVENT_FRAME
+	};
+
+	///start recording, every thread keeps the last eventsPerThread events (rounded up to a power of two)
+	static	void	enable(int eventsPerThread = 16384);
+	static	void	disable();
+	static	bool	isEnabled()
+	{
+		return s_enabled;
+	}
+	///forget all recorded events
+	static	void	clear();
+	///free the event buffers, this also disables recording
+	static	void	releaseMemory();
+
+	static	void	recordEvent(const char* name, int type);
+
+	///number of events currently held in the buffer of the given thread, oldest first
+	static	int		getNumEvents(int threadIndex);
+	static	const btProfileEvent&	getEvent(int threadIndex, int eventIndex);
+
+	///write the recorded events in the Chrome trace event format (load it in chrome://tracing), returns false if the file can't be written
+	static	bool	writeChromeTrace(const char* fileName);
+
+private:
+	static	bool	s_enabled;
+};
 
 ///ProfileSampleClass is a simple way to profile a function's scope
 ///Use the BT_PROFILE macro at the start of scope to time
 class	CProfileSample {
+	const char*	m_name;		///< 0 when the sample was taken with profiling disabled
+
+	static	void	begin( const char * name );
+	static	void	end( const char * name );
+
 public:
+	///true while the CProfileManager tree or the btProfileTimeline records
+	static	bool	s_enabled;
+
 	CProfileSample( const char * name )
+		:m_name(0)
 	{ 
-		CProfileManager::Start_Profile( name ); 
+		if (s_enabled)
+		{
+			m_name = name;
+			begin( name );
+		}
 	}
 
 	~CProfileSample( void )					
 	{ 
-		CProfileManager::Stop_Profile(); 
+		if (m_name)
+			end( m_name );
 	}
 };
 
@@ -22,15 +22,30 @@ Nov.2006
 
 #include "btScalar.h" //for btAssert
 #include "btAlignedAllocator.h"
+#include "btThreads.h"
+#include <new> //for placement new
+
+struct btStackAllocOverflow;
 
 ///The btBlock class is an internal structure for the btStackAlloc memory allocator.
 struct btBlock
 {
 	btBlock*			previous;
 	unsigned char*		address;
+	btStackAllocOverflow*	overflow;
+	unsigned int		usedsize;
+};
+
+///The btStackAllocOverflow class is an internal structure for the btStackAlloc memory allocator, it heads a heap allocation made when the stack was full.
+struct btStackAllocOverflow
+{
+	btStackAllocOverflow*	previous;
+	unsigned int			size;
 };
 
 ///The StackAlloc class provides some fast stack-based memory allocator (LIFO last-in first-out)
+///When the stack is full, allocate falls back to the heap. reset grows the stack to the peak usage since the previous reset,
+///so an allocator that is reset once per frame stops touching the heap after the first frames.
 class btStackAlloc
 {
 public:
@@ -46,43 +61,87 @@ public:
 	}
 	inline void		destroy()
 	{
-		btAssert(usedsize==0);
+		btAssert(usedsize==0 && overflow==0);
 		//Raise(L"StackAlloc is still in use");
 
 		if(usedsize==0)
 		{
+			releaseOverflow(0);
 			if(!ischild && data)		
 				btAlignedFree(data);
 
 			data				=	0;
+			totalsize			=	0;
 			usedsize			=	0;
 		}
 		
 	}
 
+	///releases all allocations, and grows the stack to the peak usage since the previous reset. Call it when no block is open, for example once per frame.
+	inline void		reset()
+	{
+		btAssert(current==0);
+		//Raise(L"StackAlloc is still in use");
+
+		releaseOverflow(0);
+		usedsize	=	0;
+		current		=	0;
+		if(peaksize>totalsize && !ischild)
+		{
+			if(data)
+				btAlignedFree(data);
+			data		=	(unsigned char*) btAlignedAlloc(peaksize,16);
+			totalsize	=	peaksize;
+		}
+		peaksize	=	0;
+	}
+
 	int	getAvailableMemory() const
 	{
 		return static_cast<int>(totalsize - usedsize);
 	}
 
+	///the memory that didn't fit in the stack, and is allocated on the heap
+	int	getOverflowMemory() const
+	{
+		return static_cast<int>(overflowsize);
+	}
+
+	///the highest usage, stack and heap, since the previous reset
+	int	getPeakMemory() const
+	{
+		return static_cast<int>(peaksize);
+	}
+
+	///the allocations are 16 byte aligned
 	unsigned char*			allocate(unsigned int size)
 	{
+		size = (size+15)&~15u;
 		const unsigned int	nus(usedsize+size);
-		if(nus<totalsize)
+		if(nus<=totalsize)
 		{
 			usedsize=nus;
+			updatePeak();
 			return(data+(usedsize-size));
 		}
-		btAssert(0);
-		//&& (L"Not enough memory"));
 		
-		return(0);
+		btStackAllocOverflow*	po = (btStackAllocOverflow*)btAlignedAlloc(overflowHeaderSize()+size,16);
+		po->previous	=	overflow;
+		po->size		=	size;
+		overflow		=	po;
+		overflowsize	+=	size;
+		updatePeak();
+		return((unsigned char*)po+overflowHeaderSize());
 	}
 	SIMD_FORCE_INLINE btBlock*		beginBlock()
 	{
+		const unsigned int		prevusedsize = usedsize;
+		btStackAllocOverflow*	prevoverflow = overflow;
 		btBlock*	pb = (btBlock*)allocate(sizeof(btBlock));
 		pb->previous	=	current;
 		pb->address		=	data+usedsize;
+		pb->overflow	=	prevoverflow;
+		pb->usedsize	=	prevusedsize;
 		current			=	pb;
 		return(pb);
 	}
@@ -93,7 +152,9 @@ public:
 		if(block==current)
 		{
 			current		=	block->previous;
-			usedsize	=	(unsigned int)((block->address-data)-sizeof(btBlock));
+			usedsize	=	block->usedsize;
+			//the block itself can be one of the overflow allocations
+			releaseOverflow(block->overflow);
 		}
 	}
 
@@ -103,14 +164,99 @@ private:
 		data		=	0;
 		totalsize	=	0;
 		usedsize	=	0;
+		peaksize	=	0;
+		overflowsize=	0;
+		overflow	=	0;
 		current		=	0;
 		ischild		=	false;
 	}
+	static unsigned int	overflowHeaderSize()
+	{
+		return (sizeof(btStackAllocOverflow)+15)&~15u;
+	}
+	void		updatePeak()
+	{
+		if(usedsize+overflowsize>peaksize)
+			peaksize = usedsize+overflowsize;
+	}
+	void		releaseOverflow(btStackAllocOverflow* until)
+	{
+		while(overflow!=until)
+		{
+			btStackAllocOverflow*	po = overflow;
+			overflow		=	po->previous;
+			overflowsize	-=	po->size;
+			btAlignedFree(po);
+		}
+	}
 	unsigned char*		data;
 	unsigned int		totalsize;
 	unsigned int		usedsize;
+	unsigned int		peaksize;
+	unsigned int		overflowsize;
+	btStackAllocOverflow*	overflow;
 	btBlock*	current;
 	bool		ischild;
 };
 
+///btThreadStackAlloc gives each thread its own btStackAlloc, so that collision detection and constraint solving
+///can draw temporary memory from it on several threads at once. Thread 0 (see btGetCurrentThreadIndex) uses the stack allocator
+///passed to the constructor. The stack allocators of the other threads are created by these threads on first use.
+class btThreadStackAlloc
+{
+	btStackAlloc*	m_stackAllocs[BT_MAX_THREAD_COUNT];
+	unsigned int	m_threadStackSize;
+
+public:
+
+	btThreadStackAlloc(btStackAlloc* mainStackAlloc, unsigned int threadStackSize=0)
+		:m_threadStackSize(threadStackSize)
+	{
+		m_stackAllocs[0] = mainStackAlloc;
+		for (int i=1;i<BT_MAX_THREAD_COUNT;i++)
+			m_stackAllocs[i] = 0;
+	}
+
+	~btThreadStackAlloc()
+	{
+		for (int i=1;i<BT_MAX_THREAD_COUNT;i++)
+		{
+			if (m_stackAllocs[i])
+			{
+				m_stackAllocs[i]->~btStackAlloc();
+				btAlignedFree(m_stackAllocs[i]);
+			}
+		}
+	}
+
+	///the stack allocator of the calling thread
+	btStackAlloc*	getStackAlloc()
+	{
+		unsigned int threadIndex = btGetCurrentThreadIndex();
+		btAssert(threadIndex < BT_MAX_THREAD_COUNT);
+		if (!m_stackAllocs[threadIndex])
+		{
+			void* mem = btAlignedAlloc(sizeof(btStackAlloc),16);
+			m_stackAllocs[threadIndex] = new (mem) btStackAlloc(m_threadStackSize);
+		}
+		return m_stackAllocs[threadIndex];
+	}
+
+	///the stack allocator of thread threadIndex, or 0 if that thread didn't use one yet
+	btStackAlloc*	getStackAlloc(int threadIndex) const
+	{
+		return m_stackAllocs[threadIndex];
+	}
+
+	///resets the stack allocators of all threads, see btStackAlloc::reset. Only call it while no task is running.
+	void	reset()
+	{
+		for (int i=0;i<BT_MAX_THREAD_COUNT;i++)
+		{
+			if (m_stackAllocs[i])
+				m_stackAllocs[i]->reset();
+		}
+	}
+};
+
 #endif //BT_STACK_ALLOC
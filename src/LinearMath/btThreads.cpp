@@ -0,0 +1,585 @@
+/*
+Copyright (c) 2003-2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "btThreads.h"
+#include "btMinMax.h"
+#include <new>
+
+#if BT_THREADSAFE
+
+#if defined (_WIN32)
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#define BT_THREAD_LOCAL __declspec(thread)
+
+#else //_WIN32
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#define BT_THREAD_LOCAL __thread
+
+#endif //_WIN32
+
+///the index of a thread that didn't call btGetCurrentThreadIndex yet
+#define BT_THREAD_INDEX_UNASSIGNED 0xffffffffu
+
+static BT_THREAD_LOCAL unsigned int gThreadIndex = BT_THREAD_INDEX_UNASSIGNED;
+static BT_THREAD_LOCAL bool gOwnsThreadIndex = false;
+
+///gThreadIndexInUse[i] is 1 while a thread holds index i
+static volatile int gThreadIndexInUse[BT_MAX_THREAD_COUNT];
+///one more than the highest index handed out so far
+static volatile int gNumThreadIndices = 0;
+
+///the calling thread takes the lowest free index, so the indices stay small when the worker threads come and go
+static void btAcquireThreadIndex()
+{
+	for (int i=0;i<BT_MAX_THREAD_COUNT;i++)
+	{
+		if (btAtomicCompareExchange(&gThreadIndexInUse[i], 0, 1) == 0)
+		{
+			int numIndices = btAtomicLoad(&gNumThreadIndices);
+			while (numIndices < i+1)
+			{
+				int prev = btAtomicCompareExchange(&gNumThreadIndices, numIndices, i+1);
+				if (prev == numIndices)
+					break;
+				numIndices = prev;
+			}
+			gThreadIndex = unsigned(i);
+			gOwnsThreadIndex = true;
+			return;
+		}
+	}
+	//more than BT_MAX_THREAD_COUNT threads at the same time, the others share the last index
+	btAssert(0);
+	gThreadIndex = BT_MAX_THREAD_COUNT-1;
+	gOwnsThreadIndex = false;
+}
+
+static void btReleaseThreadIndex()
+{
+	if (gOwnsThreadIndex)
+	{
+		btAtomicStore(&gThreadIndexInUse[gThreadIndex], 0);
+	}
+	gThreadIndex = BT_THREAD_INDEX_UNASSIGNED;
+	gOwnsThreadIndex = false;
+}
+
+#endif //BT_THREADSAFE
+
+static volatile int gThreadsRunning = 0;
+
+unsigned int btGetCurrentThreadIndex()
+{
+#if BT_THREADSAFE
+	if (gThreadIndex == BT_THREAD_INDEX_UNASSIGNED)
+	{
+		btAcquireThreadIndex();
+	}
+	return gThreadIndex;
+#else
+	return 0;
+#endif
+}
+
+int btGetNumThreadIndices()
+{
+#if BT_THREADSAFE
+	//the calling thread takes part in the next loop, count it too
+	btGetCurrentThreadIndex();
+	return btAtomicLoad(&gNumThreadIndices);
+#else
+	return 1;
+#endif
+}
+
+bool btIsMainThread()
+{
+	return btGetCurrentThreadIndex() == 0;
+}
+
+bool btThreadsAreRunning()
+{
+	return btAtomicLoad(&gThreadsRunning) != 0;
+}
+
+
+btITaskScheduler::btITaskScheduler(const char* name)
+:m_name(name),
+m_isActive(false)
+{
+}
+
+void btITaskScheduler::activate()
+{
+	m_isActive = true;
+}
+
+void btITaskScheduler::deactivate()
+{
+	m_isActive = false;
+}
+
+
+///btTaskSchedulerSequential runs every loop on the calling thread
+class btTaskSchedulerSequential : public btITaskScheduler
+{
+public:
+	btTaskSchedulerSequential() : btITaskScheduler("Sequential") {}
+
+	virtual int		getMaxNumThreads() const	{ return 1; }
+	virtual int		getNumThreads() const		{ return 1; }
+	virtual void	setNumThreads(int numThreads) { (void)numThreads; }
+
+	virtual void	parallelFor(int iBegin, int iEnd, int grainSize, const btIParallelForBody& body)
+	{
+		(void)grainSize;
+		body.forLoop(iBegin, iEnd);
+	}
+};
+
+
+#if BT_THREADSAFE
+
+///the maximum number of busy-wait iterations before an idle worker goes to sleep
+#define BT_WORKER_SPIN_COUNT 4096
+
+///btChunkRange is the deque of one thread: the owner takes chunks from the front, thieves split off the back half.
+///It is padded to a cache line so the ranges of different threads don't share one.
+struct btChunkRange
+{
+	btSpinMutex		m_mutex;
+	int				m_begin;
+	int				m_end;
+	char			m_padding[64 - sizeof(btSpinMutex) - 2*sizeof(int)];
+};
+
+class btTaskSchedulerDefault;
+
+struct btWorkerThreadInfo
+{
+	btTaskSchedulerDefault*	m_scheduler;
+	int						m_threadIndex;
+#if defined (_WIN32)
+	HANDLE					m_thread;
+#else
+	pthread_t				m_thread;
+#endif
+};
+
+///btTaskSchedulerDefault is a persistent pool of worker threads with per-thread chunk deques and work stealing.
+///The calling thread takes part in every loop with the chunks of worker slot 0. Idle workers spin briefly and then sleep on a condition variable.
+class btTaskSchedulerDefault : public btITaskScheduler
+{
+	btChunkRange			m_ranges[BT_MAX_THREAD_COUNT];
+	btWorkerThreadInfo		m_workers[BT_MAX_THREAD_COUNT];
+	int						m_numWorkerThreads;
+	int						m_numThreads;
+
+	const btIParallelForBody*	m_body;
+	int						m_iBegin;
+	int						m_iEnd;
+	int						m_grainSize;
+
+	volatile int			m_generation;
+	volatile int			m_numChunksRemaining;
+	volatile int			m_numActiveWorkers;
+	volatile int			m_numStartedWorkers;
+	volatile int			m_quit;
+
+#if defined (_WIN32)
+	CRITICAL_SECTION		m_wakeMutex;
+	CONDITION_VARIABLE		m_wakeCondition;
+#else
+	pthread_mutex_t			m_wakeMutex;
+	pthread_cond_t			m_wakeCondition;
+#endif
+
+	bool	popChunk(int threadIndex, int& chunk)
+	{
+		btChunkRange& range = m_ranges[threadIndex];
+		range.m_mutex.lock();
+		bool found = range.m_begin < range.m_end;
+		if (found)
+		{
+			chunk = range.m_begin++;
+		}
+		range.m_mutex.unlock();
+		return found;
+	}
+
+	bool	stealChunk(int threadIndex, int& chunk)
+	{
+		for (int i=1;i<m_numThreads;i++)
+		{
+			btChunkRange& victim = m_ranges[(threadIndex+i)%m_numThreads];
+			victim.m_mutex.lock();
+			int remaining = victim.m_end - victim.m_begin;
+			int stolenBegin = victim.m_end;
+			int numStolen = (remaining+1)/2;
+			victim.m_end -= numStolen;
+			stolenBegin -= numStolen;
+			victim.m_mutex.unlock();
+
+			if (numStolen>0)
+			{
+				chunk = stolenBegin;
+				if (numStolen>1)
+				{
+					btChunkRange& range = m_ranges[threadIndex];
+					range.m_mutex.lock();
+					range.m_begin = stolenBegin+1;
+					range.m_end = stolenBegin+numStolen;
+					range.m_mutex.unlock();
+				}
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void	wakeWorkers()
+	{
+#if defined (_WIN32)
+		EnterCriticalSection(&m_wakeMutex);
+		WakeAllConditionVariable(&m_wakeCondition);
+		LeaveCriticalSection(&m_wakeMutex);
+#else
+		pthread_mutex_lock(&m_wakeMutex);
+		pthread_cond_broadcast(&m_wakeCondition);
+		pthread_mutex_unlock(&m_wakeMutex);
+#endif
+	}
+
+	int		waitForWork(int lastGeneration)
+	{
+		for (int i=0;i<BT_WORKER_SPIN_COUNT;i++)
+		{
+			int generation = btAtomicLoad(&m_generation);
+			if (generation != lastGeneration)
+				return generation;
+			btSpinPause();
+		}
+#if defined (_WIN32)
+		EnterCriticalSection(&m_wakeMutex);
+		while (btAtomicLoad(&m_generation) == lastGeneration)
+		{
+			SleepConditionVariableCS(&m_wakeCondition, &m_wakeMutex, INFINITE);
+		}
+		LeaveCriticalSection(&m_wakeMutex);
+#else
+		pthread_mutex_lock(&m_wakeMutex);
+		while (btAtomicLoad(&m_generation) == lastGeneration)
+		{
+			pthread_cond_wait(&m_wakeCondition, &m_wakeMutex);
+		}
+		pthread_mutex_unlock(&m_wakeMutex);
+#endif
+		return btAtomicLoad(&m_generation);
+	}
+
+	static void	yieldThread()
+	{
+#if defined (_WIN32)
+		SwitchToThread();
+#else
+		sched_yield();
+#endif
+	}
+
+public:
+
+	void	runChunks(int threadIndex)
+	{
+		int chunk;
+		while (popChunk(threadIndex, chunk) || stealChunk(threadIndex, chunk))
+		{
+			int iBegin = m_iBegin + chunk*m_grainSize;
+			int iEnd = btMin(iBegin + m_grainSize, m_iEnd);
+			m_body->forLoop(iBegin, iEnd);
+			btAtomicFetchAdd(&m_numChunksRemaining, -1);
+		}
+	}
+
+	///threadIndex is the index of the worker in this scheduler, btGetCurrentThreadIndex can be another one
+	void	workerLoop(int threadIndex)
+	{
+		//take a thread index before the first loop, so that it is counted by btGetNumThreadIndices
+		btGetCurrentThreadIndex();
+		btAtomicFetchAdd(&m_numStartedWorkers, 1);
+		int lastGeneration = 0;
+		for (;;)
+		{
+			lastGeneration = waitForWork(lastGeneration);
+			if (btAtomicLoad(&m_quit))
+				break;
+
+			btAtomicFetchAdd(&m_numActiveWorkers, 1);
+			if (threadIndex < m_numThreads)
+			{
+				runChunks(threadIndex);
+			}
+			btAtomicFetchAdd(&m_numActiveWorkers, -1);
+		}
+		btReleaseThreadIndex();
+	}
+
+	btTaskSchedulerDefault(int numThreads);
+
+	virtual ~btTaskSchedulerDefault();
+
+	virtual int		getMaxNumThreads() const
+	{
+		return m_numWorkerThreads + 1;
+	}
+
+	virtual int		getNumThreads() const
+	{
+		return m_numThreads;
+	}
+
+	virtual void	setNumThreads(int numThreads)
+	{
+		btAssert(!btThreadsAreRunning());
+		m_numThreads = btMax(1, btMin(numThreads, getMaxNumThreads()));
+	}
+
+	virtual void	parallelFor(int iBegin, int iEnd, int grainSize, const btIParallelForBody& body)
+	{
+		btAssert(grainSize>0);
+		int numChunks = (iEnd - iBegin + grainSize - 1)/grainSize;
+		if (m_numThreads <= 1 || numChunks <= 1)
+		{
+			body.forLoop(iBegin, iEnd);
+			return;
+		}
+
+		m_body = &body;
+		m_iBegin = iBegin;
+		m_iEnd = iEnd;
+		m_grainSize = grainSize;
+		btAtomicStore(&m_numChunksRemaining, numChunks);
+
+		//hand every thread a contiguous slice of the chunks, idle threads steal from the busy ones
+		int numThreads = btMin(m_numThreads, numChunks);
+		for (int t=0;t<m_numThreads;t++)
+		{
+			btChunkRange& range = m_ranges[t];
+			range.m_mutex.lock();
+			if (t<numThreads)
+			{
+				range.m_begin = (numChunks*t)/numThreads;
+				range.m_end = (numChunks*(t+1))/numThreads;
+			} else
+			{
+				range.m_begin = 0;
+				range.m_end = 0;
+			}
+			range.m_mutex.unlock();
+		}
+
+		btAtomicFetchAdd(&m_generation, 1);
+		wakeWorkers();
+
+		runChunks(0);
+
+		int spinCount = 0;
+		while (btAtomicLoad(&m_numChunksRemaining) > 0 || btAtomicLoad(&m_numActiveWorkers) > 0)
+		{
+			if (++spinCount < BT_WORKER_SPIN_COUNT)
+			{
+				btSpinPause();
+			} else
+			{
+				yieldThread();
+			}
+		}
+		m_body = 0;
+	}
+};
+
+#if defined (_WIN32)
+static DWORD WINAPI btWorkerThreadFunc(LPVOID argument)
+#else
+static void* btWorkerThreadFunc(void* argument)
+#endif
+{
+	btWorkerThreadInfo* info = (btWorkerThreadInfo*)argument;
+	info->m_scheduler->workerLoop(info->m_threadIndex);
+	return 0;
+}
+
+static int btGetNumHardwareThreads()
+{
+#if defined (_WIN32)
+	SYSTEM_INFO sysInfo;
+	GetSystemInfo(&sysInfo);
+	return int(sysInfo.dwNumberOfProcessors);
+#elif defined (_SC_NPROCESSORS_ONLN)
+	return int(sysconf(_SC_NPROCESSORS_ONLN));
+#else
+	return 1;
+#endif
+}
+
+btTaskSchedulerDefault::btTaskSchedulerDefault(int numThreads)
+:btITaskScheduler("WorkStealing"),
+m_numWorkerThreads(0),
+m_numThreads(1),
+m_body(0),
+m_iBegin(0),
+m_iEnd(0),
+m_grainSize(1),
+m_generation(0),
+m_numChunksRemaining(0),
+m_numActiveWorkers(0),
+m_numStartedWorkers(0),
+m_quit(0)
+{
+	//the calling thread, which takes part in the loops, gets its index before the workers
+	btGetCurrentThreadIndex();
+
+	if (numThreads<=0)
+	{
+		numThreads = btGetNumHardwareThreads();
+	}
+	numThreads = btMax(1, btMin(numThreads, int(BT_MAX_THREAD_COUNT)));
+
+	for (int t=0;t<BT_MAX_THREAD_COUNT;t++)
+	{
+		m_ranges[t].m_begin = 0;
+		m_ranges[t].m_end = 0;
+	}
+
+#if defined (_WIN32)
+	InitializeCriticalSection(&m_wakeMutex);
+	InitializeConditionVariable(&m_wakeCondition);
+#else
+	pthread_mutex_init(&m_wakeMutex, 0);
+	pthread_cond_init(&m_wakeCondition, 0);
+#endif
+
+	for (int t=1;t<numThreads;t++)
+	{
+		btWorkerThreadInfo& info = m_workers[t];
+		info.m_scheduler = this;
+		info.m_threadIndex = t;
+#if defined (_WIN32)
+		info.m_thread = CreateThread(0, 0, btWorkerThreadFunc, &info, 0, 0);
+		if (!info.m_thread)
+			break;
+#else
+		if (pthread_create(&info.m_thread, 0, btWorkerThreadFunc, &info) != 0)
+			break;
+#endif
+		m_numWorkerThreads++;
+	}
+	m_numThreads = m_numWorkerThreads + 1;
+
+	//wait for the workers to take their thread indices, the per-thread arrays are sized with btGetNumThreadIndices before a loop
+	while (btAtomicLoad(&m_numStartedWorkers) < m_numWorkerThreads)
+	{
+		yieldThread();
+	}
+}
+
+btTaskSchedulerDefault::~btTaskSchedulerDefault()
+{
+	btAtomicStore(&m_quit, 1);
+	btAtomicFetchAdd(&m_generation, 1);
+	wakeWorkers();
+
+	for (int t=1;t<=m_numWorkerThreads;t++)
+	{
+#if defined (_WIN32)
+		WaitForSingleObject(m_workers[t].m_thread, INFINITE);
+		CloseHandle(m_workers[t].m_thread);
+#else
+		pthread_join(m_workers[t].m_thread, 0);
+#endif
+	}
+
+#if defined (_WIN32)
+	DeleteCriticalSection(&m_wakeMutex);
+#else
+	pthread_cond_destroy(&m_wakeCondition);
+	pthread_mutex_destroy(&m_wakeMutex);
+#endif
+}
+
+#endif //BT_THREADSAFE
+
+
+static btTaskSchedulerSequential gSequentialTaskScheduler;
+static btITaskScheduler* gTaskScheduler = &gSequentialTaskScheduler;
+
+void btSetTaskScheduler(btITaskScheduler* ts)
+{
+	btAssert(!btThreadsAreRunning());
+	if (!ts)
+	{
+		ts = &gSequentialTaskScheduler;
+	}
+	if (gTaskScheduler)
+	{
+		gTaskScheduler->deactivate();
+	}
+	gTaskScheduler = ts;
+	ts->activate();
+}
+
+btITaskScheduler* btGetTaskScheduler()
+{
+	return gTaskScheduler;
+}
+
+btITaskScheduler* btGetSequentialTaskScheduler()
+{
+	return &gSequentialTaskScheduler;
+}
+
+btITaskScheduler* btCreateDefaultTaskScheduler(int numThreads)
+{
+#if BT_THREADSAFE
+	return new btTaskSchedulerDefault(numThreads);
+#else
+	(void)numThreads;
+	return 0;
+#endif
+}
+
+void btParallelFor(int iBegin, int iEnd, int grainSize, const btIParallelForBody& body)
+{
+	if (iBegin >= iEnd)
+		return;
+
+#if BT_THREADSAFE
+	//only one loop at a time goes to the scheduler, nested loops and loops started by other threads meanwhile run inline
+	if (btAtomicCompareExchange(&gThreadsRunning, 0, 1) != 0)
+	{
+		body.forLoop(iBegin, iEnd);
+		return;
+	}
+	gTaskScheduler->parallelFor(iBegin, iEnd, btMax(grainSize, 1), body);
+	btAtomicStore(&gThreadsRunning, 0);
+#else
+	(void)grainSize;
+	body.forLoop(iBegin, iEnd);
+#endif
+}
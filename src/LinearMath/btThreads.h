@@ -0,0 +1,250 @@
+/*
+Copyright (c) 2003-2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+
+#ifndef BT_THREADS_H
+#define BT_THREADS_H
+
+#include "btScalar.h" // has definitions like SIMD_FORCE_INLINE
+
+///BT_THREADSAFE is set by the build system (see the BULLET2_MULTITHREADING option).
+///When it is 0, btParallelFor runs every loop on the calling thread and the mutex calls compile away.
+#ifndef BT_THREADSAFE
+#define BT_THREADSAFE 0
+#endif
+
+#if defined (_MSC_VER)
+#include <intrin.h>
+#pragma intrinsic(_InterlockedExchangeAdd, _InterlockedCompareExchange, _ReadWriteBarrier)
+#endif
+
+///maximum number of threads (including the main thread) that use Bullet at the same time, see btGetCurrentThreadIndex
+#define BT_MAX_THREAD_COUNT 64
+
+///btAtomicFetchAdd adds value to *ptr and returns the previous value (full memory barrier)
+SIMD_FORCE_INLINE int btAtomicFetchAdd(volatile int* ptr, int value)
+{
+#if defined (_MSC_VER)
+	return _InterlockedExchangeAdd((volatile long*)ptr, value);
+#elif defined (__GNUC__)
+	return __sync_fetch_and_add(ptr, value);
+#else
+	int prev = *ptr;
+	*ptr = prev + value;
+	return prev;
+#endif
+}
+
+///btAtomicCompareExchange stores desired in *ptr if *ptr equals expected, and returns the previous value (full memory barrier)
+SIMD_FORCE_INLINE int btAtomicCompareExchange(volatile int* ptr, int expected, int desired)
+{
+#if defined (_MSC_VER)
+	return _InterlockedCompareExchange((volatile long*)ptr, desired, expected);
+#elif defined (__GNUC__)
+	return __sync_val_compare_and_swap(ptr, expected, desired);
+#else
+	int prev = *ptr;
+	if (prev == expected)
+		*ptr = desired;
+	return prev;
+#endif
+}
+
+///btAtomicLoad reads *ptr with acquire semantics
+SIMD_FORCE_INLINE int btAtomicLoad(const volatile int* ptr)
+{
+#if defined (_MSC_VER)
+	int value = *ptr;
+	_ReadWriteBarrier();
+	return value;
+#elif defined (__ATOMIC_ACQUIRE)
+	return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+#elif defined (__GNUC__)
+	int value = *ptr;
+	__sync_synchronize();
+	return value;
+#else
+	return *ptr;
+#endif
+}
+
+///btAtomicStore writes *ptr with release semantics
+SIMD_FORCE_INLINE void btAtomicStore(volatile int* ptr, int value)
+{
+#if defined (_MSC_VER)
+	_ReadWriteBarrier();
+	*ptr = value;
+#elif defined (__ATOMIC_RELEASE)
+	__atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+#elif defined (__GNUC__)
+	__sync_synchronize();
+	*ptr = value;
+#else
+	*ptr = value;
+#endif
+}
+
+///btSpinPause is a hint to the processor that the caller is busy-waiting
+SIMD_FORCE_INLINE void btSpinPause()
+{
+#if defined (_MSC_VER) && (defined (_M_IX86) || defined (_M_X64))
+	_mm_pause();
+#elif defined (__GNUC__) && (defined (__i386__) || defined (__x86_64__))
+	__asm__ __volatile__ ("pause");
+#elif defined (__GNUC__) && (defined (__arm__) || defined (__aarch64__)) && !defined (__thumb__)
+	__asm__ __volatile__ ("yield");
+#endif
+}
+
+
+///btSpinMutex is a lightweight spin-mutex, meant for critical sections of a few dozen instructions.
+///It is not recursive and does not yield to the OS, so don't hold it while doing real work.
+class btSpinMutex
+{
+	volatile int	m_lock;
+
+public:
+	btSpinMutex()
+		:m_lock(0)
+	{
+	}
+
+	void	lock()
+	{
+		while (btAtomicCompareExchange(&m_lock, 0, 1) != 0)
+		{
+			while (btAtomicLoad(&m_lock))
+			{
+				btSpinPause();
+			}
+		}
+	}
+
+	void	unlock()
+	{
+		btAtomicStore(&m_lock, 0);
+	}
+
+	bool	tryLock()
+	{
+		return btAtomicCompareExchange(&m_lock, 0, 1) == 0;
+	}
+};
+
+///the btMutex* helpers only lock when the library was built with BT_THREADSAFE, so single-threaded builds pay nothing
+SIMD_FORCE_INLINE void btMutexLock(btSpinMutex* mutex)
+{
+#if BT_THREADSAFE
+	mutex->lock();
+#else
+	(void)mutex;
+#endif
+}
+
+SIMD_FORCE_INLINE void btMutexUnlock(btSpinMutex* mutex)
+{
+#if BT_THREADSAFE
+	mutex->unlock();
+#else
+	(void)mutex;
+#endif
+}
+
+SIMD_FORCE_INLINE bool btMutexTryLock(btSpinMutex* mutex)
+{
+#if BT_THREADSAFE
+	return mutex->tryLock();
+#else
+	(void)mutex;
+	return true;
+#endif
+}
+
+
+///returns the index of the calling thread, below BT_MAX_THREAD_COUNT. Every thread takes the lowest free index on its first call:
+///the thread that creates the task scheduler gets 0 (when it is the first thread to use Bullet), the workers of btCreateDefaultTaskScheduler
+///get the next ones and give them back when they exit. Other threads keep their index until the program ends.
+unsigned int	btGetCurrentThreadIndex();
+
+///returns one more than the highest index btGetCurrentThreadIndex handed out so far, size per-thread arrays with it before a btParallelFor.
+///A task scheduler that runs the loops on threads of its own has to call btGetCurrentThreadIndex on them before the first loop.
+int		btGetNumThreadIndices();
+
+bool	btIsMainThread();
+
+///returns true while a btParallelFor is being executed by the task scheduler
+bool	btThreadsAreRunning();
+
+
+///btIParallelForBody is the loop body passed to btParallelFor.
+///forLoop is called with disjoint sub-ranges, possibly from several threads at once.
+class btIParallelForBody
+{
+public:
+	virtual ~btIParallelForBody() {}
+
+	virtual void	forLoop(int iBegin, int iEnd) const = 0;
+};
+
+
+///btITaskScheduler is the interface of the task schedulers used by btParallelFor.
+///Bullet ships a sequential scheduler and a work-stealing thread pool (see btCreateDefaultTaskScheduler),
+///but an application can also plug in its own job system (TBB, PPL, ...) by implementing this interface.
+class btITaskScheduler
+{
+public:
+	btITaskScheduler(const char* name);
+	virtual ~btITaskScheduler() {}
+
+	const char*	getName() const
+	{
+		return m_name;
+	}
+
+	virtual int		getMaxNumThreads() const = 0;
+	virtual int		getNumThreads() const = 0;
+	virtual void	setNumThreads(int numThreads) = 0;
+
+	///split [iBegin,iEnd) into chunks of roughly grainSize iterations and run body.forLoop on them, returns when all chunks are done
+	virtual void	parallelFor(int iBegin, int iEnd, int grainSize, const btIParallelForBody& body) = 0;
+
+	///activate/deactivate are called by btSetTaskScheduler when the scheduler is (un)installed
+	virtual void	activate();
+	virtual void	deactivate();
+
+protected:
+	const char*	m_name;
+	bool		m_isActive;
+};
+
+///install a task scheduler, pass 0 to go back to the sequential scheduler. The scheduler is not owned.
+void	btSetTaskScheduler(btITaskScheduler* ts);
+
+btITaskScheduler*	btGetTaskScheduler();
+
+///the sequential scheduler runs every loop on the calling thread, it is the default
+btITaskScheduler*	btGetSequentialTaskScheduler();
+
+///create the built-in work-stealing thread pool (use delete to destroy it).
+///numThreads includes the calling thread, 0 means one thread per logical processor.
+///Returns 0 when the library was built without BT_THREADSAFE.
+btITaskScheduler*	btCreateDefaultTaskScheduler(int numThreads = 0);
+
+///run body over [iBegin,iEnd) using the current task scheduler.
+///Nested calls (from inside a loop body) run sequentially on the calling thread.
+void	btParallelFor(int iBegin, int iEnd, int grainSize, const btIParallelForBody& body);
+
+
+#endif //BT_THREADS_H
@@ -23,7 +23,7 @@ subject to the following restrictions:
 
 #include "BulletMultiThreaded/PlatformDefinitions.h"
 #ifdef USE_PTHREADS
-#include "BulletMultiThreaded/PosixThreadSupport.h"
+#include "BulletMultiThreaded/btThreadPoolSupport.h"
 #endif
 
 
@@ -31,6 +31,7 @@ subject to the following restrictions:
 #include "MiniCLTaskScheduler.h"
 #include "MiniCLTask/MiniCLTask.h"
 #include "LinearMath/btMinMax.h"
+#include "LinearMath/btThreads.h"
 #include <stdio.h>
 #include <stddef.h>
 
@@ -431,7 +432,7 @@ CL_API_ENTRY cl_int CL_API_CALL clEnqueueNDRangeKernel(cl_command_queue /* comma
                        cl_uint           work_dim ,
                        const size_t *   /* global_work_offset */,
                        const size_t *    global_work_size ,
-                       const size_t *   /* local_work_size */,
+                       const size_t *    local_work_size ,
                        cl_uint          /* num_events_in_wait_list */,
                        const cl_event * /* event_wait_list */,
                        cl_event *       /* event */) CL_API_SUFFIX__VERSION_1_0
@@ -444,16 +445,31 @@ CL_API_ENTRY cl_int CL_API_CALL clEnqueueNDRangeKernel(cl_command_queue /* comma
 		int maxTask = kernel->m_scheduler->getMaxNumOutstandingTasks();
 		int numWorkItems = global_work_size[ii];
 
+		bool hasLocalSize = local_work_size && local_work_size[ii];
+
+		if (!kernel->m_scheduler->getThreadSupportInterface())
+		{
+			//work groups of local_work_size work items, or a few groups per thread of the task scheduler
+			int localSize = hasLocalSize ? int(local_work_size[ii]) :
+				btMax(64,numWorkItems / (btGetTaskScheduler()->getNumThreads()*4));
+			kernel->m_scheduler->runKernel(kernel,numWorkItems,localSize);
+			continue;
+		}
+
 //		//at minimum 64 work items per task
 //		int numWorkItemsPerTask = btMax(64,numWorkItems / maxTask);
 		int numWorkItemsPerTask = numWorkItems / maxTask;
 		if (!numWorkItemsPerTask) numWorkItemsPerTask = 1;
 
+		//without local_work_size, each task is one work group, otherwise the tasks are made of whole work groups
+		int localSize = hasLocalSize ? int(local_work_size[ii]) : numWorkItemsPerTask;
+		numWorkItemsPerTask = btMax(numWorkItemsPerTask/localSize,1)*localSize;
+
 		for (int t=0;t<numWorkItems;)
 		{
 			//Performance Hint: tweak this number during benchmarking
 			int endIndex = (t+numWorkItemsPerTask) < numWorkItems ? t+numWorkItemsPerTask : numWorkItems;
-			kernel->m_scheduler->issueTask(t, endIndex, kernel);
+			kernel->m_scheduler->issueTask(t, endIndex, kernel, localSize);
 			t = endIndex;
 		}
 	}
@@ -469,40 +485,19 @@ CL_API_ENTRY cl_int CL_API_CALL clEnqueueNDRangeKernel(cl_command_queue /* comma
 	return 0;
 }
 
-#define LOCAL_BUF_SIZE 32768
-static int sLocalMemBuf[LOCAL_BUF_SIZE * 4 + 16];
-static int* spLocalBufCurr = NULL;
-static int sLocalBufUsed = LOCAL_BUF_SIZE; // so it will be reset at the first call
-static void* localBufMalloc(int size)
-{
-	int size16 = (size + 15) >> 4; // in 16-byte units
-	if((sLocalBufUsed + size16) > LOCAL_BUF_SIZE)
-	{ // reset
-		spLocalBufCurr = sLocalMemBuf;
-		while((size_t)spLocalBufCurr & 0x0F) spLocalBufCurr++; // align to 16 bytes
-		sLocalBufUsed = 0;
-	}
-	void* ret = spLocalBufCurr;
-	spLocalBufCurr += size16 * 4;
-	sLocalBufUsed += size;
-	return ret;
-}
-
-
-
 CL_API_ENTRY cl_int CL_API_CALL clSetKernelArg(cl_kernel    clKernel ,
                cl_uint      arg_index ,
                size_t       arg_size ,
                const void *  arg_value ) CL_API_SUFFIX__VERSION_1_0
 {
 	MiniCLKernel* kernel = (MiniCLKernel* ) clKernel;
-	btAssert(arg_size <= MINICL_MAX_ARGLENGTH);
-	if (arg_index>MINI_CL_MAX_ARG)
+	btAssert(arg_size <= MINICL_MAX_ARGLENGTH || !arg_value);
+	if (arg_index>=MINI_CL_MAX_ARG)
 	{
 		printf("error: clSetKernelArg arg_index (%u) exceeds %u\n",arg_index,MINI_CL_MAX_ARG);
 	} else
 	{
-		if (arg_size>MINICL_MAX_ARGLENGTH)
+		if (arg_size>MINICL_MAX_ARGLENGTH && arg_value)
 		//if (arg_size != MINICL_MAX_ARGLENGTH)
 		{
 			printf("error: clSetKernelArg argdata too large: %zu (maximum is %zu)\n",arg_size,MINICL_MAX_ARGLENGTH);
@@ -510,13 +505,14 @@ CL_API_ENTRY cl_int CL_API_CALL clSetKernelArg(cl_kernel    clKernel ,
 		else
 		{
 			if(arg_value == NULL)
-			{	// this is only for __local memory qualifier
-				void* ptr = localBufMalloc(arg_size);
-				kernel->m_argData[arg_index] = ptr;
+			{	// this is only for __local memory qualifier, each work group gets arg_size bytes when the kernel runs
+				kernel->m_argData[arg_index] = 0;
+				kernel->m_argIsLocal[arg_index] = true;
 			}
 			else
 			{
 				memcpy(&(kernel->m_argData[arg_index]), arg_value, arg_size);
+				kernel->m_argIsLocal[arg_index] = false;
 			}
 			kernel->m_argSizes[arg_index] = arg_size;
 			if(arg_index >= kernel->m_numArgs)
@@ -675,6 +671,10 @@ CL_API_ENTRY cl_context CL_API_CALL clCreateContextFromType(const cl_context_pro
 	{
 		SequentialThreadSupport::SequentialThreadConstructionInfo stc("MiniCL",processMiniCLTask,createMiniCLLocalStoreMemory);
 		threadSupport = new SequentialThreadSupport(stc);
+	} else if (btGetTaskScheduler() != btGetSequentialTaskScheduler())
+	{
+		//a thread pool is installed (see btSetTaskScheduler), the kernels run on its threads with btParallelFor
+		threadSupport = 0;
 	} else
 	{
 
@@ -690,11 +690,12 @@ CL_API_ENTRY cl_context CL_API_CALL clCreateContextFromType(const cl_context_pro
 #else
 
 #ifdef USE_PTHREADS
-		PosixThreadSupport::ThreadConstructionInfo constructionInfo("PosixThreads",
+		//the workers stay awake between the kernels of a queue instead of a semaphore handshake per task
+		btThreadPoolSupport::ThreadConstructionInfo constructionInfo("MiniCL",
 																	processMiniCLTask,
 																	createMiniCLLocalStoreMemory,
 																	maxNumOutstandingTasks);
-		threadSupport = new PosixThreadSupport(constructionInfo);
+		threadSupport = new btThreadPoolSupport(constructionInfo);
 
 #else
 	///todo: add posix thread support for other platforms
@@ -0,0 +1,297 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef MINICL_RANGE_LAUNCHER_H
+#define MINICL_RANGE_LAUNCHER_H
+
+///miniCLLaunchRange runs a kernel for the work items [firstWorkItem,lastWorkItem).
+///MINICL_REGISTER instantiates it for every kernel, with the kernel as a constant, so the compiler can inline
+///the kernel into the loop over the work items and vectorize it, instead of calling it through a function pointer for each work item.
+///The arguments are unpacked with their declared types, so float and int arguments are passed correctly.
+
+template <class T>
+inline T miniCLArg(void* const* argData, int index)
+{
+	return *reinterpret_cast<const T*>(&argData[index]);
+}
+
+inline void miniCLLaunchRange(void (*kernel)(int), void* const* argData, int firstWorkItem, int lastWorkItem)
+{
+	(void)argData;
+	for (int guid=firstWorkItem;guid<lastWorkItem;guid++)
+		kernel(guid);
+}
+
+template <class A0>
+inline void miniCLLaunchRange(void (*kernel)(A0,int), void* const* argData, int firstWorkItem, int lastWorkItem)
+{
+	A0 a0 = miniCLArg<A0>(argData,0);
+	for (int guid=firstWorkItem;guid<lastWorkItem;guid++)
+		kernel(a0,guid);
+}
+
+template <class A0, class A1>
+inline void miniCLLaunchRange(void (*kernel)(A0,A1,int), void* const* argData, int firstWorkItem, int lastWorkItem)
+{
+	A0 a0 = miniCLArg<A0>(argData,0);
+	A1 a1 = miniCLArg<A1>(argData,1);
+	for (int guid=firstWorkItem;guid<lastWorkItem;guid++)
+		kernel(a0,a1,guid);
+}
+
+template <class A0, class A1, class A2>
+inline void miniCLLaunchRange(void (*kernel)(A0,A1,A2,int), void* const* argData, int firstWorkItem, int lastWorkItem)
+{
+	A0 a0 = miniCLArg<A0>(argData,0);
+	A1 a1 = miniCLArg<A1>(argData,1);
+	A2 a2 = miniCLArg<A2>(argData,2);
+	for (int guid=firstWorkItem;guid<lastWorkItem;guid++)
+		kernel(a0,a1,a2,guid);
+}
+
+template <class A0, class A1, class A2, class A3>
+inline void miniCLLaunchRange(void (*kernel)(A0,A1,A2,A3,int), void* const* argData, int firstWorkItem, int lastWorkItem)
+{
+	A0 a0 = miniCLArg<A0>(argData,0);
+	A1 a1 = miniCLArg<A1>(argData,1);
+	A2 a2 = miniCLArg<A2>(argData,2);
+	A3 a3 = miniCLArg<A3>(argData,3);
+	for (int guid=firstWorkItem;guid<lastWorkItem;guid++)
+		kernel(a0,a1,a2,a3,guid);
+}
+
+template <class A0, class A1, class A2, class A3, class A4>
+inline void miniCLLaunchRange(void (*kernel)(A0,A1,A2,A3,A4,int), void* const* argData, int firstWorkItem, int lastWorkItem)
+{
+	A0 a0 = miniCLArg<A0>(argData,0);
+	A1 a1 = miniCLArg<A1>(argData,1);
+	A2 a2 = miniCLArg<A2>(argData,2);
+	A3 a3 = miniCLArg<A3>(argData,3);
+	A4 a4 = miniCLArg<A4>(argData,4);
+	for (int guid=firstWorkItem;guid<lastWorkItem;guid++)
+		kernel(a0,a1,a2,a3,a4,guid);
+}
+
+template <class A0, class A1, class A2, class A3, class A4, class A5>
+inline void miniCLLaunchRange(void (*kernel)(A0,A1,A2,A3,A4,A5,int), void* const* argData, int firstWorkItem, int lastWorkItem)
+{
+	A0 a0 = miniCLArg<A0>(argData,0);
+	A1 a1 = miniCLArg<A1>(argData,1);
+	A2 a2 = miniCLArg<A2>(argData,2);
+	A3 a3 = miniCLArg<A3>(argData,3);
+	A4 a4 = miniCLArg<A4>(argData,4);
+	A5 a5 = miniCLArg<A5>(argData,5);
+	for (int guid=firstWorkItem;guid<lastWorkItem;guid++)
+		kernel(a0,a1,a2,a3,a4,a5,guid);
+}
+
+template <class A0, class A1, class A2, class A3, class A4, class A5, class A6>
+inline void miniCLLaunchRange(void (*kernel)(A0,A1,A2,A3,A4,A5,A6,int), void* const* argData, int firstWorkItem, int lastWorkItem)
+{
+	A0 a0 = miniCLArg<A0>(argData,0);
+	A1 a1 = miniCLArg<A1>(argData,1);
+	A2 a2 = miniCLArg<A2>(argData,2);
+	A3 a3 = miniCLArg<A3>(argData,3);
+	A4 a4 = miniCLArg<A4>(argData,4);
+	A5 a5 = miniCLArg<A5>(argData,5);
+	A6 a6 = miniCLArg<A6>(argData,6);
+	for (int guid=firstWorkItem;guid<lastWorkItem;guid++)
+		kernel(a0,a1,a2,a3,a4,a5,a6,guid);
+}
+
+template <class A0, class A1, class A2, class A3, class A4, class A5, class A6, class A7>
+inline void miniCLLaunchRange(void (*kernel)(A0,A1,A2,A3,A4,A5,A6,A7,int), void* const* argData, int firstWorkItem, int lastWorkItem)
+{
+	A0 a0 = miniCLArg<A0>(argData,0);
+	A1 a1 = miniCLArg<A1>(argData,1);
+	A2 a2 = miniCLArg<A2>(argData,2);
+	A3 a3 = miniCLArg<A3>(argData,3);
+	A4 a4 = miniCLArg<A4>(argData,4);
+	A5 a5 = miniCLArg<A5>(argData,5);
+	A6 a6 = miniCLArg<A6>(argData,6);
+	A7 a7 = miniCLArg<A7>(argData,7);
+	for (int guid=firstWorkItem;guid<lastWorkItem;guid++)
+		kernel(a0,a1,a2,a3,a4,a5,a6,a7,guid);
+}
+
+template <class A0, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8>
+inline void miniCLLaunchRange(void (*kernel)(A0,A1,A2,A3,A4,A5,A6,A7,A8,int), void* const* argData, int firstWorkItem, int lastWorkItem)
+{
+	A0 a0 = miniCLArg<A0>(argData,0);
+	A1 a1 = miniCLArg<A1>(argData,1);
+	A2 a2 = miniCLArg<A2>(argData,2);
+	A3 a3 = miniCLArg<A3>(argData,3);
+	A4 a4 = miniCLArg<A4>(argData,4);
+	A5 a5 = miniCLArg<A5>(argData,5);
+	A6 a6 = miniCLArg<A6>(argData,6);
+	A7 a7 = miniCLArg<A7>(argData,7);
+	A8 a8 = miniCLArg<A8>(argData,8);
+	for (int guid=firstWorkItem;guid<lastWorkItem;guid++)
+		kernel(a0,a1,a2,a3,a4,a5,a6,a7,a8,guid);
+}
+
+template <class A0, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8, class A9>
+inline void miniCLLaunchRange(void (*kernel)(A0,A1,A2,A3,A4,A5,A6,A7,A8,A9,int), void* const* argData, int firstWorkItem, int lastWorkItem)
+{
+	A0 a0 = miniCLArg<A0>(argData,0);
+	A1 a1 = miniCLArg<A1>(argData,1);
+	A2 a2 = miniCLArg<A2>(argData,2);
+	A3 a3 = miniCLArg<A3>(argData,3);
+	A4 a4 = miniCLArg<A4>(argData,4);
+	A5 a5 = miniCLArg<A5>(argData,5);
+	A6 a6 = miniCLArg<A6>(argData,6);
+	A7 a7 = miniCLArg<A7>(argData,7);
+	A8 a8 = miniCLArg<A8>(argData,8);
+	A9 a9 = miniCLArg<A9>(argData,9);
+	for (int guid=firstWorkItem;guid<lastWorkItem;guid++)
+		kernel(a0,a1,a2,a3,a4,a5,a6,a7,a8,a9,guid);
+}
+
+template <class A0, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8, class A9, class A10>
+inline void miniCLLaunchRange(void (*kernel)(A0,A1,A2,A3,A4,A5,A6,A7,A8,A9,A10,int), void* const* argData, int firstWorkItem, int lastWorkItem)
+{
+	A0 a0 = miniCLArg<A0>(argData,0);
+	A1 a1 = miniCLArg<A1>(argData,1);
+	A2 a2 = miniCLArg<A2>(argData,2);
+	A3 a3 = miniCLArg<A3>(argData,3);
+	A4 a4 = miniCLArg<A4>(argData,4);
+	A5 a5 = miniCLArg<A5>(argData,5);
+	A6 a6 = miniCLArg<A6>(argData,6);
+	A7 a7 = miniCLArg<A7>(argData,7);
+	A8 a8 = miniCLArg<A8>(argData,8);
+	A9 a9 = miniCLArg<A9>(argData,9);
+	A10 a10 = miniCLArg<A10>(argData,10);
+	for (int guid=firstWorkItem;guid<lastWorkItem;guid++)
+		kernel(a0,a1,a2,a3,a4,a5,a6,a7,a8,a9,a10,guid);
+}
+
+template <class A0, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8, class A9, class A10, class A11>
+inline void miniCLLaunchRange(void (*kernel)(A0,A1,A2,A3,A4,A5,A6,A7,A8,A9,A10,A11,int), void* const* argData, int firstWorkItem, int lastWorkItem)
+{
+	A0 a0 = miniCLArg<A0>(argData,0);
+	A1 a1 = miniCLArg<A1>(argData,1);
+	A2 a2 = miniCLArg<A2>(argData,2);
+	A3 a3 = miniCLArg<A3>(argData,3);
+	A4 a4 = miniCLArg<A4>(argData,4);
+	A5 a5 = miniCLArg<A5>(argData,5);
+	A6 a6 = miniCLArg<A6>(argData,6);
+	A7 a7 = miniCLArg<A7>(argData,7);
+	A8 a8 = miniCLArg<A8>(argData,8);
+	A9 a9 = miniCLArg<A9>(argData,9);
+	A10 a10 = miniCLArg<A10>(argData,10);
+	A11 a11 = miniCLArg<A11>(argData,11);
+	for (int guid=firstWorkItem;guid<lastWorkItem;guid++)
+		kernel(a0,a1,a2,a3,a4,a5,a6,a7,a8,a9,a10,a11,guid);
+}
+
+template <class A0, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8, class A9, class A10, class A11, class A12>
+inline void miniCLLaunchRange(void (*kernel)(A0,A1,A2,A3,A4,A5,A6,A7,A8,A9,A10,A11,A12,int), void* const* argData, int firstWorkItem, int lastWorkItem)
+{
+	A0 a0 = miniCLArg<A0>(argData,0);
+	A1 a1 = miniCLArg<A1>(argData,1);
+	A2 a2 = miniCLArg<A2>(argData,2);
+	A3 a3 = miniCLArg<A3>(argData,3);
+	A4 a4 = miniCLArg<A4>(argData,4);
+	A5 a5 = miniCLArg<A5>(argData,5);
+	A6 a6 = miniCLArg<A6>(argData,6);
+	A7 a7 = miniCLArg<A7>(argData,7);
+	A8 a8 = miniCLArg<A8>(argData,8);
+	A9 a9 = miniCLArg<A9>(argData,9);
+	A10 a10 = miniCLArg<A10>(argData,10);
+	A11 a11 = miniCLArg<A11>(argData,11);
+	A12 a12 = miniCLArg<A12>(argData,12);
+	for (int guid=firstWorkItem;guid<lastWorkItem;guid++)
+		kernel(a0,a1,a2,a3,a4,a5,a6,a7,a8,a9,a10,a11,a12,guid);
+}
+
+template <class A0, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8, class A9, class A10, class A11, class A12, class A13>
+inline void miniCLLaunchRange(void (*kernel)(A0,A1,A2,A3,A4,A5,A6,A7,A8,A9,A10,A11,A12,A13,int), void* const* argData, int firstWorkItem, int lastWorkItem)
+{
+	A0 a0 = miniCLArg<A0>(argData,0);
+	A1 a1 = miniCLArg<A1>(argData,1);
+	A2 a2 = miniCLArg<A2>(argData,2);
+	A3 a3 = miniCLArg<A3>(argData,3);
+	A4 a4 = miniCLArg<A4>(argData,4);
+	A5 a5 = miniCLArg<A5>(argData,5);
+	A6 a6 = miniCLArg<A6>(argData,6);
+	A7 a7 = miniCLArg<A7>(argData,7);
+	A8 a8 = miniCLArg<A8>(argData,8);
+	A9 a9 = miniCLArg<A9>(argData,9);
+	A10 a10 = miniCLArg<A10>(argData,10);
+	A11 a11 = miniCLArg<A11>(argData,11);
+	A12 a12 = miniCLArg<A12>(argData,12);
+	A13 a13 = miniCLArg<A13>(argData,13);
+	for (int guid=firstWorkItem;guid<lastWorkItem;guid++)
+		kernel(a0,a1,a2,a3,a4,a5,a6,a7,a8,a9,a10,a11,a12,a13,guid);
+}
+
+template <class A0, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8, class A9, class A10, class A11, class A12, class A13, class A14>
+inline void miniCLLaunchRange(void (*kernel)(A0,A1,A2,A3,A4,A5,A6,A7,A8,A9,A10,A11,A12,A13,A14,int), void* const* argData, int firstWorkItem, int lastWorkItem)
+{
+	A0 a0 = miniCLArg<A0>(argData,0);
+	A1 a1 = miniCLArg<A1>(argData,1);
+	A2 a2 = miniCLArg<A2>(argData,2);
+	A3 a3 = miniCLArg<A3>(argData,3);
+	A4 a4 = miniCLArg<A4>(argData,4);
+	A5 a5 = miniCLArg<A5>(argData,5);
+	A6 a6 = miniCLArg<A6>(argData,6);
+	A7 a7 = miniCLArg<A7>(argData,7);
+	A8 a8 = miniCLArg<A8>(argData,8);
+	A9 a9 = miniCLArg<A9>(argData,9);
+	A10 a10 = miniCLArg<A10>(argData,10);
+	A11 a11 = miniCLArg<A11>(argData,11);
+	A12 a12 = miniCLArg<A12>(argData,12);
+	A13 a13 = miniCLArg<A13>(argData,13);
+	A14 a14 = miniCLArg<A14>(argData,14);
+	for (int guid=firstWorkItem;guid<lastWorkItem;guid++)
+		kernel(a0,a1,a2,a3,a4,a5,a6,a7,a8,a9,a10,a11,a12,a13,a14,guid);
+}
+
+template <class A0, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8, class A9, class A10, class A11, class A12, class A13, class A14, class A15>
+inline void miniCLLaunchRange(void (*kernel)(A0,A1,A2,A3,A4,A5,A6,A7,A8,A9,A10,A11,A12,A13,A14,A15,int), void* const* argData, int firstWorkItem, int lastWorkItem)
+{
+	A0 a0 = miniCLArg<A0>(argData,0);
+	A1 a1 = miniCLArg<A1>(argData,1);
+	A2 a2 = miniCLArg<A2>(argData,2);
+	A3 a3 = miniCLArg<A3>(argData,3);
+	A4 a4 = miniCLArg<A4>(argData,4);
+	A5 a5 = miniCLArg<A5>(argData,5);
+	A6 a6 = miniCLArg<A6>(argData,6);
+	A7 a7 = miniCLArg<A7>(argData,7);
+	A8 a8 = miniCLArg<A8>(argData,8);
+	A9 a9 = miniCLArg<A9>(argData,9);
+	A10 a10 = miniCLArg<A10>(argData,10);
+	A11 a11 = miniCLArg<A11>(argData,11);
+	A12 a12 = miniCLArg<A12>(argData,12);
+	A13 a13 = miniCLArg<A13>(argData,13);
+	A14 a14 = miniCLArg<A14>(argData,14);
+	A15 a15 = miniCLArg<A15>(argData,15);
+	for (int guid=firstWorkItem;guid<lastWorkItem;guid++)
+		kernel(a0,a1,a2,a3,a4,a5,a6,a7,a8,a9,a10,a11,a12,a13,a14,a15,guid);
+}
+
+///MiniCLWorkGroup is the work group that the calling thread runs, see miniCLRunWorkGroups in MiniCLTask.h.
+///The work group macros of cl_MiniCL_Defs.h read it.
+struct MiniCLWorkGroup
+{
+	int	m_localSize;
+	int	m_resumePoint;		///< the barrier that the work items continue after, 0 in the first phase
+	int	m_nextResumePoint;	///< the barrier that the work items stopped at, 0 when they returned
+};
+
+///returns the work group of the calling thread
+MiniCLWorkGroup*	miniCLGetWorkGroup();
+
+#endif //MINICL_RANGE_LAUNCHER_H
@@ -20,6 +20,7 @@ subject to the following restrictions:
 #include "LinearMath/btMinMax.h"
 #include "MiniCLTask.h"
 #include "MiniCL/MiniCLTaskScheduler.h"
+#include "MiniCL/MiniCLRangeLauncher.h"
 
 
 #ifdef __SPU__
@@ -31,6 +32,73 @@ subject to the following restrictions:
 
 int gMiniCLNumOutstandingTasks = 0;
 
+#if defined(_MSC_VER)
+#define MINICL_THREAD_LOCAL __declspec(thread)
+#else
+#define MINICL_THREAD_LOCAL __thread
+#endif
+
+static MINICL_THREAD_LOCAL MiniCLWorkGroup gMiniCLWorkGroup;
+
+MiniCLWorkGroup*	miniCLGetWorkGroup()
+{
+	return &gMiniCLWorkGroup;
+}
+
+void	miniCLRunWorkGroups(const MiniCLTaskDesc& taskDesc, int firstWorkUnit, int lastWorkUnit)
+{
+	MiniCLKernel* kernel = taskDesc.m_kernel;
+	MiniCLTaskDesc groupDesc = taskDesc;
+
+	//the groups of this call run one after the other and reuse the memory of the __local arguments,
+	//groups on other threads have their own
+	int localMemSize = 0;
+	for (unsigned int i=0;i<kernel->m_numArgs;i++)
+	{
+		if (taskDesc.m_argIsLocal[i])
+			localMemSize += (taskDesc.m_argSizes[i]+15) & ~15;
+	}
+	char* localMem = localMemSize ? (char*)btAlignedAlloc(localMemSize,16) : 0;
+	char* localArg = localMem;
+	for (unsigned int i=0;i<kernel->m_numArgs;i++)
+	{
+		if (taskDesc.m_argIsLocal[i])
+		{
+			groupDesc.m_argData[i] = localArg;
+			localArg += (taskDesc.m_argSizes[i]+15) & ~15;
+		}
+	}
+
+	MiniCLWorkGroup* group = miniCLGetWorkGroup();
+	int localSize = btMax(int(taskDesc.m_localSize),1);
+	group->m_localSize = localSize;
+	for (int groupFirst=firstWorkUnit;groupFirst<lastWorkUnit;groupFirst+=localSize)
+	{
+		int groupLast = btMin(groupFirst+localSize,lastWorkUnit);
+		//a barrier ends a phase, the next phase resumes all work items after it
+		group->m_resumePoint = 0;
+		do
+		{
+			group->m_nextResumePoint = 0;
+			if (kernel->m_pRangeLauncher)
+			{
+				//a single loop over the work items, the kernel can be inlined into it
+				kernel->m_pRangeLauncher(groupDesc.m_argData,groupFirst,groupLast);
+			} else
+			{
+				for (int i=groupFirst;i<groupLast;i++)
+				{
+					kernel->m_launcher(&groupDesc, i);
+				}
+			}
+			group->m_resumePoint = group->m_nextResumePoint;
+		} while (group->m_resumePoint);
+	}
+
+	if (localMem)
+		btAlignedFree(localMem);
+}
+
 struct MiniCLTask_LocalStoreMemory
 {
 	
@@ -47,10 +115,7 @@ void processMiniCLTask(void* userPtr, void* lsMemory)
 	MiniCLTaskDesc* taskDescPtr = (MiniCLTaskDesc*)userPtr;
 	MiniCLTaskDesc& taskDesc = *taskDescPtr;
 
-	for (unsigned int i=taskDesc.m_firstWorkUnit;i<taskDesc.m_lastWorkUnit;i++)
-	{
-		taskDesc.m_kernel->m_launcher(&taskDesc, i);
-	}
+	miniCLRunWorkGroups(taskDesc,taskDesc.m_firstWorkUnit,taskDesc.m_lastWorkUnit);
 
 //	printf("Compute Unit[%d] executed kernel %d work items [%d..%d)\n",taskDesc.m_taskId,taskDesc.m_kernelProgramId,taskDesc.m_firstWorkUnit,taskDesc.m_lastWorkUnit);
 	
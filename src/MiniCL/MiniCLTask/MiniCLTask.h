@@ -37,24 +37,35 @@ ATTRIBUTE_ALIGNED16(struct) MiniCLTaskDesc
 		for (int i=0;i<MINI_CL_MAX_ARG;i++)
 		{
 			m_argSizes[i]=0;
+			m_argIsLocal[i]=false;
 		}
+		m_localSize=1;
 	}
 
 	uint32_t		m_taskId;
 
 	uint32_t		m_firstWorkUnit;
 	uint32_t		m_lastWorkUnit;
+	///work items per work group, m_firstWorkUnit is a multiple of it
+	uint32_t		m_localSize;
 
 	MiniCLKernel*	m_kernel;
 
 	void*			m_argData[MINI_CL_MAX_ARG];
 	int				m_argSizes[MINI_CL_MAX_ARG];
+	///the __local arguments, m_argSizes bytes of memory for each work group
+	bool			m_argIsLocal[MINI_CL_MAX_ARG];
 };
 
 extern "C" int gMiniCLNumOutstandingTasks;
 
 
 void	processMiniCLTask(void* userPtr, void* lsMemory);
+
+///runs the work groups of the work items [firstWorkUnit,lastWorkUnit) on the calling thread, one group after the other.
+///firstWorkUnit is the first work item of a group. Each group gets its own memory for the __local arguments, and the kernel
+///runs once for each phase between its barriers, so all work items of the group reach a barrier before any continues after it.
+void	miniCLRunWorkGroups(const MiniCLTaskDesc& taskDesc, int firstWorkUnit, int lastWorkUnit);
 void*	createMiniCLLocalStoreMemory();
 
 
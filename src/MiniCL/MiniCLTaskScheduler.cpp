@@ -45,6 +45,7 @@ void*	SamplelsMemoryFunc()
 
 
 #include "BulletMultiThreaded/btThreadSupportInterface.h"
+#include "LinearMath/btThreads.h"
 
 //#	include "SPUAssert.h"
 #include <string.h>
@@ -75,14 +76,16 @@ m_maxNumOutstandingTasks(maxNumOutstandingTasks)
 
 	m_initialized = false;
 
-	m_threadInterface->startSPU();
+	if (m_threadInterface)
+		m_threadInterface->startSPU();
 
 
 }
 
 MiniCLTaskScheduler::~MiniCLTaskScheduler()
 {
-	m_threadInterface->stopSPU();
+	if (m_threadInterface)
+		m_threadInterface->stopSPU();
 	
 }
 
@@ -105,21 +108,19 @@ void	MiniCLTaskScheduler::initialize()
 }
 
 
-void MiniCLTaskScheduler::issueTask(int firstWorkUnit, int lastWorkUnit, MiniCLKernel* kernel)
+void MiniCLTaskScheduler::issueTask(int firstWorkUnit, int lastWorkUnit, MiniCLKernel* kernel, int localSize)
 {
 
 #ifdef DEBUG_SPU_TASK_SCHEDULING
 	printf("MiniCLTaskScheduler::issueTask (m_currentTask= %d\)n", m_currentTask);
 #endif //DEBUG_SPU_TASK_SCHEDULING
 
-	m_taskBusy[m_currentTask] = true;
-	m_numBusyTasks++;
-
 	MiniCLTaskDesc& taskDesc = m_spuSampleTaskDesc[m_currentTask];
 	{
 		// send task description in event message
 		taskDesc.m_firstWorkUnit = firstWorkUnit;
 		taskDesc.m_lastWorkUnit = lastWorkUnit;
+		taskDesc.m_localSize = localSize;
 		taskDesc.m_kernel = kernel;
 		//some bookkeeping to recognize finished tasks
 		taskDesc.m_taskId = m_currentTask;
@@ -128,6 +129,7 @@ void MiniCLTaskScheduler::issueTask(int firstWorkUnit, int lastWorkUnit, MiniCLK
 		for (unsigned int i=0; i < kernel->m_numArgs; i++)
 		{
 			taskDesc.m_argSizes[i] = kernel->m_argSizes[i];
+			taskDesc.m_argIsLocal[i] = kernel->m_argIsLocal[i];
 			if (taskDesc.m_argSizes[i])
 			{
 				taskDesc.m_argData[i] = kernel->m_argData[i];
@@ -136,6 +138,16 @@ void MiniCLTaskScheduler::issueTask(int firstWorkUnit, int lastWorkUnit, MiniCLK
 		}
 	}
 
+	if (!m_threadInterface)
+	{
+		//no threads of its own, run the work units now (runKernel spreads them over the task scheduler)
+		processMiniCLTask(&taskDesc,0);
+		return;
+	}
+
+	m_taskBusy[m_currentTask] = true;
+	m_numBusyTasks++;
+
 
 	m_threadInterface->sendRequest(1, (ppu_address_t) &taskDesc, m_currentTask);
 
@@ -177,6 +189,48 @@ void MiniCLTaskScheduler::issueTask(int firstWorkUnit, int lastWorkUnit, MiniCLK
 }
 
 
+///runs the work groups of a kernel on the threads of the task scheduler
+struct MiniCLKernelLoop : public btIParallelForBody
+{
+	const MiniCLTaskDesc*	m_taskDesc;
+
+	void forLoop( int iBegin, int iEnd ) const
+	{
+		int localSize = m_taskDesc->m_localSize;
+		int lastWorkUnit = btMin(iEnd*localSize,int(m_taskDesc->m_lastWorkUnit));
+		miniCLRunWorkGroups(*m_taskDesc,iBegin*localSize,lastWorkUnit);
+	}
+};
+
+void MiniCLTaskScheduler::runKernel(MiniCLKernel* kernel, int numWorkItems, int localSize)
+{
+	//earlier kernels complete first, like an in-order command queue
+	flush();
+
+	MiniCLTaskDesc taskDesc;
+	taskDesc.m_taskId = 0;
+	taskDesc.m_firstWorkUnit = 0;
+	taskDesc.m_lastWorkUnit = numWorkItems;
+	taskDesc.m_localSize = btMax(localSize,1);
+	taskDesc.m_kernel = kernel;
+	for (unsigned int i=0; i < kernel->m_numArgs; i++)
+	{
+		taskDesc.m_argSizes[i] = kernel->m_argSizes[i];
+		taskDesc.m_argIsLocal[i] = kernel->m_argIsLocal[i];
+		if (taskDesc.m_argSizes[i])
+		{
+			taskDesc.m_argData[i] = kernel->m_argData[i];
+		}
+	}
+
+	//the tasks are made of whole work groups, a group can't be split over threads because of its barriers and __local memory
+	int numGroups = (numWorkItems+taskDesc.m_localSize-1)/taskDesc.m_localSize;
+	MiniCLKernelLoop loop;
+	loop.m_taskDesc = &taskDesc;
+	btParallelFor(0,numGroups,1,loop);
+}
+
+
 ///Optional PPU-size post processing for each task
 void MiniCLTaskScheduler::postProcess(int taskId, int outputSize)
 {
@@ -479,11 +533,12 @@ struct MiniCLKernelDescEntry
 {
 	void* pCode;
 	const char* pName;
+	MiniCLRangeLauncher pRangeLauncher;
 };
 static MiniCLKernelDescEntry spKernelDesc[256];
 static int sNumKernelDesc = 0;
 
-MiniCLKernelDesc::MiniCLKernelDesc(void* pCode, const char* pName)
+MiniCLKernelDesc::MiniCLKernelDesc(void* pCode, const char* pName, MiniCLRangeLauncher pRangeLauncher)
 {
 	for(int i = 0; i < sNumKernelDesc; i++)
 	{
@@ -495,6 +550,7 @@ MiniCLKernelDesc::MiniCLKernelDesc(void* pCode, const char* pName)
 	}
 	spKernelDesc[sNumKernelDesc].pCode = pCode;
 	spKernelDesc[sNumKernelDesc].pName = pName;
+	spKernelDesc[sNumKernelDesc].pRangeLauncher = pRangeLauncher;
 	sNumKernelDesc++;
 }
 
@@ -507,6 +563,7 @@ MiniCLKernel* MiniCLKernel::registerSelf()
 		if(!strcmp(m_name, spKernelDesc[i].pName))
 		{
 			m_pCode = spKernelDesc[i].pCode;
+			m_pRangeLauncher = spKernelDesc[i].pRangeLauncher;
 			return this;
 		}
 	}
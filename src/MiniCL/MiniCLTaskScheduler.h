@@ -29,6 +29,7 @@ subject to the following restrictions:
 
 
 #include "MiniCLTask/MiniCLTask.h"
+#include "MiniCL/cl_platform.h"
 
 //just add your commands here, try to keep them globally unique for debugging purposes
 #define CMD_SAMPLE_TASK_COMMAND 10
@@ -38,6 +39,7 @@ struct MiniCLKernel;
 /// MiniCLTaskScheduler handles SPU processing of collision pairs.
 /// When PPU issues a task, it will look for completed task buffers
 /// PPU will do postprocessing, dependent on workunit output (not likely)
+/// Without a btThreadSupportInterface, the kernels run with btParallelFor on the current task scheduler (see runKernel).
 class MiniCLTaskScheduler
 {
 	// track task buffers that are being used, and total busy tasks
@@ -71,7 +73,12 @@ public:
 	///call initialize in the beginning of the frame, before addCollisionPairToTask
 	void initialize();
 
-	void issueTask(int firstWorkUnit, int lastWorkUnit, MiniCLKernel* kernel);
+	///issue the work groups of localSize work items in [firstWorkUnit,lastWorkUnit), firstWorkUnit is a multiple of localSize
+	void issueTask(int firstWorkUnit, int lastWorkUnit, MiniCLKernel* kernel, int localSize);
+
+	///run the work items [0,numWorkItems) in work groups of localSize work items with btParallelFor, and wait for them.
+	///Each work group runs on one thread, see miniCLRunWorkGroups.
+	void runKernel(MiniCLKernel* kernel, int numWorkItems, int localSize);
 
 	///call flush to submit potential outstanding work to SPUs and wait for all involved SPUs to be finished
 	void flush();
@@ -106,11 +113,13 @@ struct	MiniCLKernel
 	unsigned int	m_numArgs;
 	kernelLauncherCB	m_launcher;
 	void* m_pCode;
+	MiniCLRangeLauncher	m_pRangeLauncher;	///< runs a range of work items, 0 when the kernel was registered without one
 	void updateLauncher();
 	MiniCLKernel* registerSelf();
 
 	void*	m_argData[MINI_CL_MAX_ARG];
 	int				m_argSizes[MINI_CL_MAX_ARG];
+	bool			m_argIsLocal[MINI_CL_MAX_ARG];	///< set by clSetKernelArg without a value
 };
 
 
@@ -18,15 +18,18 @@ subject to the following restrictions:
 #include "LinearMath/btScalar.h"
 
 #include "MiniCL/cl.h"
+#include "MiniCL/MiniCLRangeLauncher.h"
 
 
+//A work group runs on one thread, its work items one after the other, with its own memory for the __local kernel arguments
+//(set with clSetKernelArg without a value). __local arrays declared inside a kernel are private to each work item.
 #define __kernel
 #define __global
 #define __local
 #define get_global_id(a)	__guid_arg
-#define get_local_id(a)		((__guid_arg) % gMiniCLNumOutstandingTasks)
-#define get_local_size(a)	(gMiniCLNumOutstandingTasks)
-#define get_group_id(a)		((__guid_arg) / gMiniCLNumOutstandingTasks)
+#define get_local_size(a)	(miniCLGetWorkGroup()->m_localSize)
+#define get_local_id(a)		((__guid_arg) % get_local_size(a))
+#define get_group_id(a)		((__guid_arg) / get_local_size(a))
 
 //static unsigned int as_uint(float val) { return *((unsigned int*)&val); }
 
@@ -34,10 +37,21 @@ subject to the following restrictions:
 #define CLK_LOCAL_MEM_FENCE		0x01
 #define CLK_GLOBAL_MEM_FENCE	0x02
 
+//A kernel that calls barrier puts its body between MINICL_BARRIER_BEGIN and MINICL_BARRIER_END. The kernel is split at
+//its barriers: all work items of the group run up to the first barrier, then all of them continue after it, and so on.
+//Each phase is a new call of the kernel, so private variables don't live across a barrier (keep such values in __local
+//memory or compute them again), each phase needs its own braces, and barriers can't be inside a loop or a branch.
+//Kernels that are shared with OpenCL define the two macros as empty for the OpenCL compiler.
+//Define MINICL_IGNORE_BARRIERS for kernels that call barrier but don't run on MiniCL, barrier does nothing then.
+#ifdef MINICL_IGNORE_BARRIERS
 static void barrier(unsigned int a)
 {
-	// TODO : implement
 }
+#else
+#define MINICL_BARRIER_BEGIN	switch (miniCLGetWorkGroup()->m_resumePoint) { case 0:
+#define MINICL_BARRIER_END		}
+#define barrier(a)	do { miniCLGetWorkGroup()->m_nextResumePoint = __LINE__; return; case __LINE__: ; } while (0)
+#endif //MINICL_IGNORE_BARRIERS
 
 //ATTRIBUTE_ALIGNED16(struct) float8
 struct float8
@@ -360,6 +374,8 @@ static float min(float a, float b)
 	return (a <= b) ? a : b;
 }
 
+#if __cplusplus < 201103L
+//C++11 math.h already has the float overloads
 static float fmax(float a, float b) 
 {
 	return (a >= b) ? a : b;
@@ -369,6 +385,7 @@ static float fmin(float a, float b)
 {
 	return (a <= b) ? a : b;
 }
+#endif
 
 struct int2
 {
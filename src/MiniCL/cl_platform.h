@@ -26,12 +26,20 @@
 
 #define CL_PLATFORM_MINI_CL  0x12345
 
+///runs the work items [firstWorkItem,lastWorkItem) of a kernel, see miniCLLaunchRange in MiniCLRangeLauncher.h
+typedef void (*MiniCLRangeLauncher)(void* const* argData, int firstWorkItem, int lastWorkItem);
+
 struct MiniCLKernelDesc
 {
-	MiniCLKernelDesc(void* pCode, const char* pName);
+	MiniCLKernelDesc(void* pCode, const char* pName, MiniCLRangeLauncher pRangeLauncher = 0);
 };
 
-#define MINICL_REGISTER(__kernel_func) static MiniCLKernelDesc __kernel_func##Desc((void*)__kernel_func, #__kernel_func);
+#define MINICL_REGISTER(__kernel_func) \
+	static void __kernel_func##RangeLauncher(void* const* argData, int firstWorkItem, int lastWorkItem) \
+	{ \
+		miniCLLaunchRange(__kernel_func, argData, firstWorkItem, lastWorkItem); \
+	} \
+	static MiniCLKernelDesc __kernel_func##Desc((void*)__kernel_func, #__kernel_func, __kernel_func##RangeLauncher);
 
 
 #ifdef __APPLE__